@@ -54,6 +54,14 @@ typedef struct edgex_device_commandrequest
   const edgex_deviceresource *devobj;
 } edgex_device_commandrequest;
 
+/**
+ * @brief Function called to return a buffer lent by a driver in a result.
+ * @param ctx The release_ctx given with the result.
+ * @param buf The string_result or binary_result.bytes of the result.
+ */
+
+typedef void (*edgex_device_release_fn) (void *ctx, void *buf);
+
 /**
  * @brief Structure containing a parameter (for set) or a result (for get).
  */
@@ -69,6 +77,17 @@ typedef struct edgex_device_commandresult
   edgex_propertytype type;
   /** The value of the parameter or result. */
   edgex_device_resultvalue value;
+  /**
+   * For a String or Binary result, the SDK normally takes ownership of the
+   * string or byte array, and frees it. A driver may instead lend a buffer
+   * which it owns, such as a mapped frame, by setting release: the SDK
+   * serializes the value without copying it, and calls release once it is
+   * no longer needed. Results passed to a get handler are zeroed; results
+   * given to edgex_device_post_readings should be zero-initialized likewise.
+   */
+  edgex_device_release_fn release;
+  /** Passed to release. */
+  void *release_ctx;
 } edgex_device_commandresult;
 
 /* Callback functions */
@@ -92,8 +111,9 @@ typedef bool (*edgex_device_device_initialize)
 
 /**
  * @brief Request to dynamically discover devices. If the implementation is
- *        capable of doing so, it should detect devices and register them
- *        using the edgex_device_add_device API call.
+ *        capable of doing so, it should detect devices and report them
+ *        using the edgex_device_discovered API call, or register them
+ *        directly using edgex_device_add_device.
  * @param impl The context data passed in when the service was created.
  */
 
@@ -222,6 +242,108 @@ void edgex_device_service_start
   edgex_error *err
 );
 
+/* Asynchronous drivers */
+
+struct edgex_device_async_request;
+typedef struct edgex_device_async_request edgex_device_async_request;
+
+/**
+ * @brief Callback issued to start a GET request for device readings, as an
+ *        alternative to edgex_device_handle_get. The implementation should
+ *        not wait for the device: it retains the token and, once the readings
+ *        are available, fills them in and calls edgex_device_async_complete.
+ *        This may be done from any thread.
+ * @param impl The context data passed in when the service was created.
+ * @param devaddr The address of the device to be queried.
+ * @param nreadings The number of readings requested.
+ * @param requests An array specifying the readings that have been requested.
+ * @param readings An array in which to return the requested readings.
+ * @param token Identifies the request on completion. The devaddr, requests
+ *              and readings remain valid until then.
+ */
+
+typedef void (*edgex_device_handle_get_async)
+(
+  void *impl,
+  const edgex_addressable *devaddr,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *readings,
+  edgex_device_async_request *token
+);
+
+/**
+ * @brief Callback issued to start a PUT request for setting device values,
+ *        as an alternative to edgex_device_handle_put. The request is
+ *        completed by calling edgex_device_async_complete.
+ * @param impl The context data passed in when the service was created.
+ * @param devaddr The address of the device to be written to.
+ * @param nvalues The number of set operations requested.
+ * @param requests An array specifying the resources to which to write.
+ * @param values An array specifying the values to be written.
+ * @param token Identifies the request on completion. The devaddr, requests
+ *              and values remain valid until then.
+ */
+
+typedef void (*edgex_device_handle_put_async)
+(
+  void *impl,
+  const edgex_addressable *devaddr,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values,
+  edgex_device_async_request *token
+);
+
+/**
+ * @brief Use asynchronous handlers for GET and/or PUT requests. Where set,
+ *        these are called instead of the gethandler and puthandler given in
+ *        edgex_device_callbacks. This must be called before the service is
+ *        started.
+ * @param svc The device service.
+ * @param gethandler Handler for GET requests, or NULL.
+ * @param puthandler Handler for PUT requests, or NULL.
+ */
+
+void edgex_device_service_set_async_handlers
+(
+  edgex_device_service *svc,
+  edgex_device_handle_get_async gethandler,
+  edgex_device_handle_put_async puthandler
+);
+
+/**
+ * @brief Complete an asynchronous request. This must be called exactly once
+ *        for each request started, including when the service is stopping:
+ *        the service does not stop until all requests have completed.
+ * @param token The token passed when the request was started.
+ * @param ok true if the operation was successful, false otherwise.
+ */
+
+void edgex_device_async_complete (edgex_device_async_request *token, bool ok);
+
+/**
+ * @brief Find the time remaining before a request's deadline, as set by the
+ *        Service/RequestTimeout configuration. A driver may use this to
+ *        bound its own wait for the device.
+ * @param token The token passed when the request was started.
+ * @return The time remaining in milliseconds, zero if the deadline has
+ *         passed, or UINT64_MAX if the request has no deadline.
+ */
+
+uint64_t edgex_device_async_remaining
+  (const edgex_device_async_request *token);
+
+/**
+ * @brief Check whether a request has been cancelled: its deadline passed
+ *        and its reply has been sent as a timeout. The driver should
+ *        abandon the operation, but must still complete the request.
+ * @param token The token passed when the request was started.
+ * @return true if the request has been cancelled.
+ */
+
+bool edgex_device_async_cancelled (const edgex_device_async_request *token);
+
 /**
  * @brief Post readings to the core-data service. This method allows readings
  *        to be generated other than in response to a device GET invocation.
@@ -233,7 +355,7 @@ void edgex_device_service_start
  * @param values An array of readings. These will be combined into an Event
  *        and submitted to core-data. For readings of String or Binary type,
  *        the SDK takes ownership of the memory containing the string or
- *        byte array.
+ *        byte array, unless it is lent with a release function.
  */
 
 void edgex_device_post_readings
@@ -288,6 +410,72 @@ char * edgex_device_add_device
   edgex_error *err
 );
 
+/**
+ * @brief A device to be added by edgex_device_add_devices. The fields up to
+ *        address correspond to the parameters of edgex_device_add_device; id
+ *        and err are set by the call.
+ */
+
+typedef struct edgex_device_add_request
+{
+  const char *name;
+  const char *description;
+  const edgex_strings *labels;
+  const char *profile_name;
+  edgex_addressable *address;
+  char *id;
+  edgex_error err;
+} edgex_device_add_request;
+
+/**
+ * @brief Add a number of devices to the EdgeX system. This has the effect of
+ *        calling edgex_device_add_device for each, but the requests to
+ *        core-metadata for different devices are made concurrently, each
+ *        device profile is looked up once, and the devices become available
+ *        to the service together.
+ * @param svc The device service.
+ * @param count The number of devices to add.
+ * @param devices The devices. On return, the id of each device is set to that
+ *        of the newly created or existing device (to be freed by the caller),
+ *        or NULL if it could not be added, in which case its err is set.
+ * @param err Set to the first error which occurred, if any.
+ */
+
+void edgex_device_add_devices
+(
+  edgex_device_service *svc,
+  unsigned count,
+  edgex_device_add_request *devices,
+  edgex_error *err
+);
+
+/**
+ * @brief Report a device found by discovery. The device is matched against
+ *        the service's provision watchers, and if one matches, it is added
+ *        to EdgeX with that watcher's device profile. Devices are added in
+ *        batches, concurrently with further discovery; when called from the
+ *        discover callback, all are added by the time the discovery request
+ *        completes. This function may be called from any thread.
+ * @param svc The device service.
+ * @param name The name of the device. Devices which already exist are
+ *        ignored.
+ * @param description Optional description of the device.
+ * @param labels Optional labels for the device.
+ * @param address Addressable for this device, as for edgex_device_add_device.
+ * @param identifiers Protocol-specific properties of the device, against
+ *        which watchers are matched.
+ */
+
+void edgex_device_discovered
+(
+  edgex_device_service *svc,
+  const char *name,
+  const char *description,
+  const edgex_strings *labels,
+  edgex_addressable *address,
+  const edgex_nvpairs *identifiers
+);
+
 /**
  * @brief Remove a device from EdgeX. The device will be deleted from the
  *        device service and from core-metadata.
@@ -376,6 +564,40 @@ edgex_device * edgex_device_get_device_byname
 
 void edgex_device_free_device (edgex_device *e);
 
+/**
+ * @brief Obtain read-only access to a device without copying it. The device
+ *        remains valid, and unchanged, until it is released, even if it is
+ *        updated or removed in the meantime; retrieve it again to see any
+ *        updates.
+ * @param svc The device service.
+ * @param id The device id.
+ * @returns The requested device or null if the device was not found.
+ */
+
+const edgex_device * edgex_device_acquire_device
+  (edgex_device_service *svc, const char *id);
+
+/**
+ * @brief Obtain read-only access to a device without copying it, as for
+ *        edgex_device_acquire_device.
+ * @param svc The device service.
+ * @param name The device name.
+ * @returns The requested device or null if the device was not found.
+ */
+
+const edgex_device * edgex_device_acquire_device_byname
+  (edgex_device_service *svc, const char *name);
+
+/**
+ * @brief Release a device obtained by edgex_device_acquire_device or
+ *        edgex_device_acquire_device_byname.
+ * @param svc The device service.
+ * @param dev The device.
+ */
+
+void edgex_device_release_device
+  (edgex_device_service *svc, const edgex_device *dev);
+
 /**
  * @brief Retrieve the device profiles currently known in the SDK.
  * @param svc The device service.
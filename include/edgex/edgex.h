@@ -119,6 +119,8 @@ typedef struct
   edgex_transformArg base;
   char *assertion;
   char *precision;
+  edgex_transformArg assertval;
+  uint16_t xform;
 } edgex_propertyvalue;
 
 typedef struct
@@ -191,6 +193,8 @@ typedef struct
   edgex_command *commands;
   edgex_deviceresource *device_resources;
   edgex_profileresource *resources;
+  struct edgex_cmdplan *cmdplan;
+  uint32_t refs;
 } edgex_deviceprofile;
 
 typedef struct edgex_device
@@ -210,6 +214,8 @@ typedef struct edgex_device
   edgex_deviceservice *service;
   edgex_deviceprofile *profile;
   struct edgex_device *next;
+  uint32_t refs;
+  struct edgex_stats_device *stats;
 } edgex_device;
 
 #endif
@@ -12,7 +12,11 @@
 #include "edgex/os.h"
 #include "iot/logging.h"
 
-/* Built-in logger: post to an EdgeX logging service */
+/*
+ * Built-in logger: post to an EdgeX logging service. The device service
+ * queues entries for its configured logging service and sends them from a
+ * background thread; entries for other destinations are posted directly.
+ */
 
 extern bool edgex_log_torest
 (
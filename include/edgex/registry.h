@@ -71,6 +71,53 @@ typedef void (*edgex_registry_put_config_impl)
   edgex_error *err
 );
 
+/**
+ * @brief Wait for configuration values in the registry to change.
+ * @param lc A logging client to use.
+ * @param location The address of the registry service.
+ * @param servicename The name of this device service.
+ * @param profile The name of the configuration profile (may be NULL).
+ * @param index On entry, a registry-specific index identifying the version of
+ *        the configuration last seen, or zero if there is none. On return, the
+ *        index of the version now held by the registry.
+ * @param stop The wait is abandoned if this becomes true.
+ * @param err Nonzero reason codes may be set here in the event of errors.
+ * @returns The configuration values which have been changed since the version
+ *          identified by index (all values if index was zero), or NULL if
+ *          there are none. The wait may end without a change.
+ */
+
+typedef edgex_nvpairs *(*edgex_registry_watch_config_impl)
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  const char *profile,
+  uint64_t *index,
+  const bool *stop,
+  edgex_error *err
+);
+
+/**
+ * @brief Find the healthy instances of a service.
+ * @param lc A logging client to use.
+ * @param location The address of the registry service.
+ * @param servicename The name of the service to find.
+ * @param count Set to the number of instances found.
+ * @param err Nonzero reason codes may be set here in the event of errors.
+ * @returns An array of the addresses of the instances, or NULL if there are
+ *          none. The caller frees each host and the array.
+ */
+
+typedef struct edgex_registry_hostport *(*edgex_registry_query_service_impl)
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  unsigned *count,
+  edgex_error *err
+);
+
 /**
  * @brief Register the current service in the registry.
  * @param lc A logging client to use.
@@ -120,11 +167,15 @@ typedef struct edgex_registry_impl
   edgex_registry_register_service_impl register_service;
   edgex_registry_parse_location_impl parser;
   edgex_registry_free_location_impl free_location;
+  /* May be NULL if the registry does not support watching configuration */
+  edgex_registry_watch_config_impl watch_config;
+  /* May be NULL if the registry does not support finding services */
+  edgex_registry_query_service_impl query_service;
 } edgex_registry_impl;
 
 /* Implementation for registries which are addressed as name://host:port */
 
-typedef struct
+typedef struct edgex_registry_hostport
 {
   char *host;
   uint16_t port;
@@ -206,6 +257,56 @@ void edgex_registry_put_config
   edgex_error *err
 );
 
+/**
+ * @brief Wait for configuration values in the registry to change.
+ * @param registry The registry instance.
+ * @param servicename The name of this device service.
+ * @param profile The name of the configuration profile (may be NULL).
+ * @param index The version of the configuration last seen, updated on return.
+ *        See edgex_registry_watch_config_impl.
+ * @param stop The wait is abandoned if this becomes true.
+ * @param err Nonzero reason codes will be set here in the event of errors.
+ * @returns The configuration values which have changed, or NULL if there are
+ *          none.
+ */
+
+edgex_nvpairs *edgex_registry_watch_config
+(
+  edgex_registry *registry,
+  const char *servicename,
+  const char *profile,
+  uint64_t *index,
+  const bool *stop,
+  edgex_error *err
+);
+
+/**
+ * @brief Determine whether a registry supports watching configuration.
+ * @param registry The registry instance.
+ * @returns true if edgex_registry_watch_config may be used.
+ */
+
+bool edgex_registry_can_watch (edgex_registry *registry);
+
+/**
+ * @brief Find the healthy instances of a service.
+ * @param registry The registry instance.
+ * @param servicename The name of the service to find.
+ * @param count Set to the number of instances found.
+ * @param err Nonzero reason codes will be set here in the event of errors,
+ *        including when the registry does not support finding services.
+ * @returns An array of the addresses of the instances, or NULL if there are
+ *          none. The caller frees each host and the array.
+ */
+
+edgex_registry_hostport *edgex_registry_query_service
+(
+  edgex_registry *registry,
+  const char *servicename,
+  unsigned *count,
+  edgex_error *err
+);
+
 /**
  * @brief Register the current service in the registry.
  * @param registry The registry instance.
@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "aggregate.h"
+#include "map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#define AGG_KEYSEP '\x1f'
+
+typedef enum
+{
+  AGG_COUNT,
+  AGG_MIN,
+  AGG_MAX,
+  AGG_MEAN,
+  AGG_STDDEV,
+  AGG_PERCENTILE
+} agg_stat;
+
+typedef struct agg_spec
+{
+  uint64_t window;       // In units of origins
+  uint32_t samples;
+  uint32_t nstats;
+  agg_stat stats[EDGEX_AGG_MAXSTATS];
+  double pct[EDGEX_AGG_MAXSTATS];
+  char names[EDGEX_AGG_MAXSTATS][EDGEX_AGG_NAMELEN];
+  bool percentiles;
+} agg_spec;
+
+/*
+ * The state of one resource's window. The attribute strings its spec was
+ * parsed from are kept, so that a change to the profile is noticed. The
+ * count, mean and sum of squared deviations are maintained incrementally
+ * (Welford's method); samples for percentiles are kept in a ring, holding
+ * the most recent if the window has more than it can hold.
+ */
+
+typedef struct agg_window
+{
+  char *conf;
+  bool valid;
+  agg_spec spec;
+  uint64_t start;
+  uint64_t last;
+  uint64_t count;
+  double min;
+  double max;
+  double mean;
+  double m2;
+  float *ring;
+  uint32_t ringsize;
+  uint32_t ringpos;
+} agg_window;
+
+struct edgex_aggregator
+{
+  pthread_mutex_t lock;
+  edgex_map_void windows;
+  uint64_t unit;
+  uint64_t samples;
+  uint64_t summaries;
+};
+
+static const char *agg_attr (const edgex_nvpairs *attrs, const char *name)
+{
+  for (; attrs; attrs = attrs->next)
+  {
+    if (strcmp (attrs->name, name) == 0)
+    {
+      return attrs->value;
+    }
+  }
+  return NULL;
+}
+
+bool edgex_aggregate_wanted (const edgex_deviceresource *res)
+{
+  return agg_attr (res->attributes, "aggregate") != NULL;
+}
+
+bool edgex_aggregate_any (uint32_t n, const edgex_device_commandrequest *reqs)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (edgex_aggregate_wanted (reqs[i].devobj))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool agg_parse_window (const char *s, uint64_t *ms)
+{
+  char *end;
+  errno = 0;
+  double val = strtod (s, &end);
+  if (errno || end == s || val <= 0.0)
+  {
+    return false;
+  }
+  if (*end == '\0' || strcmp (end, "ms") == 0)
+  {
+    *ms = val;
+  }
+  else if (strcmp (end, "s") == 0)
+  {
+    *ms = val * 1000;
+  }
+  else if (strcmp (end, "m") == 0)
+  {
+    *ms = val * 60000;
+  }
+  else
+  {
+    return false;
+  }
+  return *ms > 0;
+}
+
+static bool agg_parse_stat (agg_spec *spec, const char *s, size_t len)
+{
+  static const char *names[] = { "count", "min", "max", "mean", "stddev" };
+  uint32_t i = spec->nstats;
+
+  if (len == 0 || len >= EDGEX_AGG_NAMELEN || i == EDGEX_AGG_MAXSTATS)
+  {
+    return false;
+  }
+  memcpy (spec->names[i], s, len);
+  spec->names[i][len] = '\0';
+  for (agg_stat st = AGG_COUNT; st < AGG_PERCENTILE; st++)
+  {
+    if (strcasecmp (spec->names[i], names[st]) == 0)
+    {
+      spec->stats[i] = st;
+      spec->nstats++;
+      return true;
+    }
+  }
+  if (spec->names[i][0] == 'p' || spec->names[i][0] == 'P')
+  {
+    char *end;
+    double p = strtod (spec->names[i] + 1, &end);
+    if (end != spec->names[i] + 1 && *end == '\0' && p > 0.0 && p <= 100.0)
+    {
+      spec->stats[i] = AGG_PERCENTILE;
+      spec->pct[i] = p;
+      spec->percentiles = true;
+      spec->nstats++;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool agg_parse
+  (agg_spec *spec, const char *stats, const char *window, const char *samples)
+{
+  memset (spec, 0, sizeof (*spec));
+  while (*stats)
+  {
+    size_t len = strcspn (stats, ",");
+    const char *s = stats;
+    stats += len;
+    if (*stats)
+    {
+      stats++;
+    }
+    while (len && *s == ' ')
+    {
+      s++;
+      len--;
+    }
+    while (len && s[len - 1] == ' ')
+    {
+      len--;
+    }
+    if (!agg_parse_stat (spec, s, len))
+    {
+      return false;
+    }
+  }
+  if (window && !agg_parse_window (window, &spec->window))
+  {
+    return false;
+  }
+  if (samples)
+  {
+    char *end;
+    unsigned long n = strtoul (samples, &end, 10);
+    if (*samples == '-' || end == samples || *end || n < 2 || n > UINT32_MAX)
+    {
+      return false;
+    }
+    spec->samples = n;
+  }
+  return spec->nstats && (spec->window || spec->samples);
+}
+
+/* The attributes concerned, as one string, to compare with the last seen */
+
+static char *agg_conf
+  (const char *stats, const char *window, const char *samples, char *buf,
+   size_t size)
+{
+  size_t len = strlen (stats) + 3 +
+    (window ? strlen (window) : 0) + (samples ? strlen (samples) : 0);
+  char *conf = (len < size) ? buf : malloc (len);
+  strcpy (conf, stats);
+  strcat (conf, "\n");
+  strcat (conf, window ? window : "");
+  strcat (conf, "\n");
+  strcat (conf, samples ? samples : "");
+  return conf;
+}
+
+static void agg_reset (agg_window *w)
+{
+  w->count = 0;
+  w->mean = 0.0;
+  w->m2 = 0.0;
+  w->ringpos = 0;
+}
+
+static void agg_configure (agg_window *w, const char *conf, uint64_t unit)
+{
+  const char *window = strchr (conf, '\n') + 1;
+  const char *samples = strchr (window, '\n') + 1;
+  char *stats = strndup (conf, window - conf - 1);
+  char *wstr = strndup (window, samples - window - 1);
+
+  free (w->conf);
+  free (w->ring);
+  w->conf = strdup (conf);
+  w->ring = NULL;
+  w->ringsize = 0;
+  w->valid = agg_parse
+    (&w->spec, stats, *wstr ? wstr : NULL, *samples ? samples : NULL);
+  w->spec.window *= unit;
+  if (w->valid && w->spec.percentiles)
+  {
+    w->ringsize = w->spec.samples ? w->spec.samples : EDGEX_AGG_DEFSAMPLES;
+    if (w->ringsize > EDGEX_AGG_MAXSAMPLES)
+    {
+      w->ringsize = EDGEX_AGG_MAXSAMPLES;
+    }
+    w->ring = malloc (w->ringsize * sizeof (float));
+  }
+  agg_reset (w);
+  free (stats);
+  free (wstr);
+}
+
+static int agg_cmp (const void *a, const void *b)
+{
+  float x = *(const float *) a;
+  float y = *(const float *) b;
+  return (x > y) - (x < y);
+}
+
+static void agg_summarize (agg_window *w, edgex_aggregate_summary *sum)
+{
+  float *sorted = NULL;
+  uint32_t nsorted = 0;
+
+  if (w->ring)
+  {
+    nsorted = (w->count < w->ringsize) ? w->count : w->ringsize;
+    sorted = malloc (nsorted * sizeof (float));
+    memcpy (sorted, w->ring, nsorted * sizeof (float));
+    qsort (sorted, nsorted, sizeof (float), agg_cmp);
+  }
+
+  sum->n = w->spec.nstats;
+  sum->origin = w->last;
+  for (uint32_t i = 0; i < w->spec.nstats; i++)
+  {
+    double v = 0.0;
+    switch (w->spec.stats[i])
+    {
+      case AGG_COUNT:
+        v = w->count;
+        break;
+      case AGG_MIN:
+        v = w->min;
+        break;
+      case AGG_MAX:
+        v = w->max;
+        break;
+      case AGG_MEAN:
+        v = w->mean;
+        break;
+      case AGG_STDDEV:
+        v = sqrt (w->m2 / w->count);
+        break;
+      case AGG_PERCENTILE:
+      {
+        /* Nearest rank */
+        uint32_t rank = ceil (w->spec.pct[i] / 100.0 * nsorted);
+        v = sorted[rank ? rank - 1 : 0];
+        break;
+      }
+    }
+    strcpy (sum->stats[i].name, w->spec.names[i]);
+    sum->stats[i].value = v;
+    sum->stats[i].integer = (w->spec.stats[i] == AGG_COUNT);
+  }
+  free (sorted);
+  agg_reset (w);
+}
+
+static void agg_sample (agg_window *w, double value, uint64_t origin)
+{
+  if (w->count == 0)
+  {
+    w->min = w->max = value;
+    w->start = w->spec.window ? origin - origin % w->spec.window : origin;
+  }
+  w->count++;
+  w->last = origin;
+  if (value < w->min)
+  {
+    w->min = value;
+  }
+  if (value > w->max)
+  {
+    w->max = value;
+  }
+  double delta = value - w->mean;
+  w->mean += delta / w->count;
+  w->m2 += delta * (value - w->mean);
+  if (w->ring)
+  {
+    w->ring[w->ringpos] = value;
+    w->ringpos = (w->ringpos + 1) % w->ringsize;
+  }
+}
+
+edgex_aggregator *edgex_aggregator_create (uint64_t unit)
+{
+  edgex_aggregator *a = calloc (1, sizeof (edgex_aggregator));
+  a->unit = unit;
+  pthread_mutex_init (&a->lock, NULL);
+  edgex_map_init (&a->windows);
+  return a;
+}
+
+edgex_aggregate_result edgex_aggregator_add
+(
+  edgex_aggregator *a,
+  const char *device,
+  const edgex_deviceresource *res,
+  double value,
+  uint64_t origin,
+  edgex_aggregate_summary *sum
+)
+{
+  char kbuf[256];
+  char cbuf[128];
+  edgex_aggregate_result result = EDGEX_AGG_HELD;
+  const char *stats = agg_attr (res->attributes, "aggregate");
+
+  if (stats == NULL)
+  {
+    return EDGEX_AGG_PASS;
+  }
+  char *conf = agg_conf
+  (
+    stats, agg_attr (res->attributes, "aggregateWindow"),
+    agg_attr (res->attributes, "aggregateSamples"), cbuf, sizeof (cbuf)
+  );
+  size_t dlen = strlen (device);
+  size_t klen = dlen + strlen (res->name) + 2;
+  char *key = (klen <= sizeof (kbuf)) ? kbuf : malloc (klen);
+  memcpy (key, device, dlen);
+  key[dlen] = AGG_KEYSEP;
+  strcpy (key + dlen + 1, res->name);
+
+  pthread_mutex_lock (&a->lock);
+  void **wp = edgex_map_get (&a->windows, key);
+  agg_window *w = wp ? *wp : NULL;
+  if (w == NULL)
+  {
+    w = calloc (1, sizeof (agg_window));
+    edgex_map_set (&a->windows, key, w);
+  }
+  if (w->conf == NULL || strcmp (w->conf, conf))
+  {
+    agg_configure (w, conf, a->unit);
+  }
+
+  if (!w->valid)
+  {
+    result = EDGEX_AGG_PASS;
+  }
+  else
+  {
+    if (w->count && w->spec.window && origin >= w->start + w->spec.window)
+    {
+      agg_summarize (w, sum);
+      result = EDGEX_AGG_SUMMARY;
+    }
+    agg_sample (w, value, origin);
+    if (result == EDGEX_AGG_HELD && w->count == w->spec.samples)
+    {
+      agg_summarize (w, sum);
+      result = EDGEX_AGG_SUMMARY;
+    }
+    a->samples++;
+    if (result == EDGEX_AGG_SUMMARY)
+    {
+      a->summaries++;
+    }
+  }
+  pthread_mutex_unlock (&a->lock);
+
+  if (key != kbuf)
+  {
+    free (key);
+  }
+  if (conf != cbuf)
+  {
+    free (conf);
+  }
+  return result;
+}
+
+static void agg_window_free (agg_window *w)
+{
+  free (w->conf);
+  free (w->ring);
+  free (w);
+}
+
+void edgex_aggregator_forget (edgex_aggregator *a, const char *device)
+{
+  const char *key;
+  size_t dlen = strlen (device);
+  unsigned n = 0;
+
+  if (a == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&a->lock);
+  char **keys = malloc ((edgex_map_count (&a->windows) + 1) * sizeof (char *));
+  edgex_map_iter i = edgex_map_iter (&a->windows);
+  while ((key = edgex_map_next (&a->windows, &i)))
+  {
+    if (strncmp (key, device, dlen) == 0 && key[dlen] == AGG_KEYSEP)
+    {
+      keys[n++] = strdup (key);
+    }
+  }
+  while (n--)
+  {
+    agg_window_free (*edgex_map_get (&a->windows, keys[n]));
+    edgex_map_remove (&a->windows, keys[n]);
+    free (keys[n]);
+  }
+  pthread_mutex_unlock (&a->lock);
+  free (keys);
+}
+
+void edgex_aggregator_getstats
+  (edgex_aggregator *a, edgex_aggregator_stats *stats)
+{
+  pthread_mutex_lock (&a->lock);
+  stats->windows = edgex_map_count (&a->windows);
+  stats->samples = a->samples;
+  stats->summaries = a->summaries;
+  pthread_mutex_unlock (&a->lock);
+}
+
+void edgex_aggregator_free (edgex_aggregator *a)
+{
+  if (a)
+  {
+    const char *key;
+    edgex_map_iter i = edgex_map_iter (&a->windows);
+    while ((key = edgex_map_next (&a->windows, &i)))
+    {
+      agg_window_free (*edgex_map_get (&a->windows, key));
+    }
+    edgex_map_deinit (&a->windows);
+    pthread_mutex_destroy (&a->lock);
+    free (a);
+  }
+}
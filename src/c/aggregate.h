@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_AGGREGATE_H_
+#define _EDGEX_DEVICE_AGGREGATE_H_ 1
+
+#include "edgex/devsdk.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Aggregation of high-rate numeric readings over tumbling windows. Instead
+ * of each reading, summary readings such as the mean and maximum are sent
+ * to core-data when a window completes. A device resource is aggregated if
+ * its attributes include:
+ *
+ *   aggregate          Comma-separated statistics: count, min, max, mean,
+ *                      stddev, and percentiles written pNN (eg p50, p99.9)
+ *   aggregateWindow    Window duration: milliseconds, or with a suffix of
+ *                      ms, s or m. Windows are aligned to multiples of it.
+ *   aggregateSamples   Number of readings per window
+ *
+ * At least one of aggregateWindow and aggregateSamples must be given; with
+ * both, a window completes on whichever comes first. A timed window is
+ * completed by the first reading that falls outside it.
+ */
+
+#define EDGEX_AGG_MAXSTATS 8
+#define EDGEX_AGG_NAMELEN 16
+
+/* Percentiles are taken over at most this many of a window's samples */
+
+#define EDGEX_AGG_MAXSAMPLES 65536
+#define EDGEX_AGG_DEFSAMPLES 1024
+
+typedef struct edgex_aggregator edgex_aggregator;
+
+typedef enum
+{
+  EDGEX_AGG_PASS,      // Not aggregated: the reading should be sent as is
+  EDGEX_AGG_HELD,      // Added to the current window
+  EDGEX_AGG_SUMMARY    // Added, and a window completed
+} edgex_aggregate_result;
+
+typedef struct edgex_aggregate_summary
+{
+  uint32_t n;
+  uint64_t origin;     // Origin of the last reading in the window
+  struct
+  {
+    char name[EDGEX_AGG_NAMELEN];   // Statistic, as given in aggregate
+    double value;
+    bool integer;                   // True for the count
+  } stats[EDGEX_AGG_MAXSTATS];
+} edgex_aggregate_summary;
+
+/* Create an aggregator for readings whose origins have unit per millisecond */
+
+extern edgex_aggregator *edgex_aggregator_create (uint64_t unit);
+
+/* True if a device resource is configured for aggregation */
+
+extern bool edgex_aggregate_wanted (const edgex_deviceresource *res);
+
+/* True if any of n requests is for an aggregated resource */
+
+extern bool edgex_aggregate_any
+  (uint32_t n, const edgex_device_commandrequest *reqs);
+
+/*
+ * Add a reading of a resource to its window. If the window completes, its
+ * summary is written to sum. Returns EDGEX_AGG_PASS if the resource is not
+ * aggregated, or its configuration is not valid.
+ */
+
+extern edgex_aggregate_result edgex_aggregator_add
+(
+  edgex_aggregator *a,
+  const char *device,
+  const edgex_deviceresource *res,
+  double value,
+  uint64_t origin,
+  edgex_aggregate_summary *sum
+);
+
+/* Discard the windows of a device */
+
+extern void edgex_aggregator_forget (edgex_aggregator *a, const char *device);
+
+typedef struct edgex_aggregator_stats
+{
+  uint64_t windows;    // Windows in progress
+  uint64_t samples;    // Readings aggregated
+  uint64_t summaries;  // Windows completed
+} edgex_aggregator_stats;
+
+extern void edgex_aggregator_getstats
+  (edgex_aggregator *a, edgex_aggregator_stats *stats);
+
+extern void edgex_aggregator_free (edgex_aggregator *a);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_BLOCK_MIN 4096
+
+typedef struct edgex_arena_block
+{
+  struct edgex_arena_block *next;
+  size_t size;
+  size_t used;
+} edgex_arena_block;
+
+#define ARENA_HDR ARENA_ROUND (sizeof (edgex_arena_block))
+
+struct edgex_arena
+{
+  edgex_arena_block *first;
+  edgex_arena_block *current;
+};
+
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+
+static void arena_free (void *p)
+{
+  edgex_arena *a = (edgex_arena *) p;
+  while (a->first)
+  {
+    edgex_arena_block *next = a->first->next;
+    free (a->first);
+    a->first = next;
+  }
+  free (a);
+}
+
+static void arena_init (void)
+{
+  pthread_key_create (&arena_key, arena_free);
+}
+
+edgex_arena *edgex_arena_local (void)
+{
+  pthread_once (&arena_once, arena_init);
+  edgex_arena *a = pthread_getspecific (arena_key);
+  if (a == NULL)
+  {
+    a = malloc (sizeof (edgex_arena));
+    a->first = NULL;
+    a->current = NULL;
+    pthread_setspecific (arena_key, a);
+  }
+  return a;
+}
+
+edgex_arena_mark edgex_arena_getmark (edgex_arena *a)
+{
+  edgex_arena_mark m;
+  m.block = a->current;
+  m.used = a->current ? a->current->used : 0;
+  return m;
+}
+
+void edgex_arena_rewind (edgex_arena *a, edgex_arena_mark mark)
+{
+  a->current = mark.block ? mark.block : a->first;
+  if (a->current)
+  {
+    a->current->used = mark.used;
+  }
+}
+
+void *edgex_arena_alloc (edgex_arena *a, size_t size)
+{
+  edgex_arena_block *b = a->current;
+  edgex_arena_block *last = NULL;
+
+  size = ARENA_ROUND (size);
+
+  /* Blocks following the current one are free for reuse */
+
+  while (b && b->used + size > b->size)
+  {
+    last = b;
+    b = b->next;
+    if (b)
+    {
+      b->used = 0;
+    }
+  }
+  if (b == NULL)
+  {
+    size_t bsize = last ? last->size * 2 : ARENA_BLOCK_MIN;
+    while (bsize < size)
+    {
+      bsize *= 2;
+    }
+    b = malloc (ARENA_HDR + bsize);
+    b->next = NULL;
+    b->size = bsize;
+    b->used = 0;
+    if (last)
+    {
+      last->next = b;
+    }
+    else
+    {
+      a->first = b;
+    }
+  }
+  a->current = b;
+  void *result = (char *) b + ARENA_HDR + b->used;
+  b->used += size;
+  return result;
+}
+
+void *edgex_arena_calloc (edgex_arena *a, size_t n, size_t size)
+{
+  void *result = edgex_arena_alloc (a, n * size);
+  memset (result, 0, n * size);
+  return result;
+}
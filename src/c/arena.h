@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_ARENA_H_
+#define _EDGEX_DEVICE_ARENA_H_ 1
+
+#include <stddef.h>
+
+/*
+ * Region allocator for short-lived data. Memory allocated from an arena is
+ * not freed individually; instead a mark is taken at the start of an
+ * operation and the arena is rewound to it when the operation completes.
+ * Blocks are retained across rewinds, so in steady state no heap calls are
+ * made. Each thread has its own arena, so no locking is required.
+ */
+
+typedef struct edgex_arena edgex_arena;
+
+typedef struct edgex_arena_mark
+{
+  struct edgex_arena_block *block;
+  size_t used;
+} edgex_arena_mark;
+
+/* Return the calling thread's arena */
+
+extern edgex_arena *edgex_arena_local (void);
+
+extern edgex_arena_mark edgex_arena_getmark (edgex_arena *a);
+
+/* Release everything allocated since the mark was taken */
+
+extern void edgex_arena_rewind (edgex_arena *a, edgex_arena_mark mark);
+
+extern void *edgex_arena_alloc (edgex_arena *a, size_t size);
+
+/* As edgex_arena_alloc, but the memory is zeroed */
+
+extern void *edgex_arena_calloc (edgex_arena *a, size_t n, size_t size);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "atoms.h"
+#include "map.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ * Each atom is allocated with a header holding its reference count and hash,
+ * and the table is an open-addressed (linear probing) array of pointers to
+ * them. An atom is removed when its last reference is released, so the
+ * strings of devices which come and go are reclaimed.
+ */
+
+typedef struct edgex_atom_hdr
+{
+  uint32_t refs;
+  uint32_t hash;
+  char str[];
+} edgex_atom_hdr;
+
+#define ATOM_HDR(s) \
+  ((edgex_atom_hdr *) ((char *) (s) - offsetof (edgex_atom_hdr, str)))
+
+#define ATOMS_MINSLOTS 256
+
+/* Resize when more than 3/4 full */
+
+#define ATOMS_FULL(n, slots) ((n) * 4 > (slots) * 3)
+
+static pthread_mutex_t atoms_lock = PTHREAD_MUTEX_INITIALIZER;
+static edgex_atom_hdr **atoms_slots = NULL;
+static unsigned atoms_nslots = 0;
+static unsigned atoms_count = 0;
+
+static unsigned atoms_vacant (edgex_atom_hdr **slots, unsigned n, uint32_t h)
+{
+  unsigned i = h & (n - 1);
+  while (slots[i])
+  {
+    i = (i + 1) & (n - 1);
+  }
+  return i;
+}
+
+static void atoms_grow (void)
+{
+  unsigned n = atoms_nslots ? atoms_nslots * 2 : ATOMS_MINSLOTS;
+  edgex_atom_hdr **slots = calloc (n, sizeof (edgex_atom_hdr *));
+
+  for (unsigned i = 0; i < atoms_nslots; i++)
+  {
+    edgex_atom_hdr *a = atoms_slots[i];
+    if (a)
+    {
+      slots[atoms_vacant (slots, n, a->hash)] = a;
+    }
+  }
+  free (atoms_slots);
+  atoms_slots = slots;
+  atoms_nslots = n;
+}
+
+/* Empty slot i, moving back any later entries that would become unreachable */
+
+static void atoms_remove (unsigned i)
+{
+  unsigned mask = atoms_nslots - 1;
+  unsigned j = i;
+  edgex_atom_hdr *a;
+
+  atoms_slots[i] = NULL;
+  while ((a = atoms_slots[j = (j + 1) & mask]))
+  {
+    unsigned home = a->hash & mask;
+    if (((j - home) & mask) >= ((j - i) & mask))
+    {
+      atoms_slots[i] = a;
+      atoms_slots[j] = NULL;
+      i = j;
+    }
+  }
+  atoms_count--;
+}
+
+char *edgex_atom (const char *s)
+{
+  uint32_t hash = edgex_map_hash (s);
+  edgex_atom_hdr *a = NULL;
+
+  pthread_mutex_lock (&atoms_lock);
+  if (atoms_nslots)
+  {
+    unsigned mask = atoms_nslots - 1;
+    for (unsigned i = hash & mask; (a = atoms_slots[i]); i = (i + 1) & mask)
+    {
+      if (a->hash == hash && (a->str == s || strcmp (a->str, s) == 0))
+      {
+        a->refs++;
+        break;
+      }
+    }
+  }
+  if (a == NULL)
+  {
+    size_t len = strlen (s) + 1;
+    if (atoms_nslots == 0 || ATOMS_FULL (atoms_count + 1, atoms_nslots))
+    {
+      atoms_grow ();
+    }
+    a = malloc (sizeof (edgex_atom_hdr) + len);
+    a->refs = 1;
+    a->hash = hash;
+    memcpy (a->str, s, len);
+    atoms_slots[atoms_vacant (atoms_slots, atoms_nslots, hash)] = a;
+    atoms_count++;
+  }
+  pthread_mutex_unlock (&atoms_lock);
+  return a->str;
+}
+
+void edgex_atom_free (char *s)
+{
+  uint32_t hash;
+  edgex_atom_hdr *a;
+  bool atom = false;
+
+  if (s == NULL)
+  {
+    return;
+  }
+  hash = edgex_map_hash (s);
+  pthread_mutex_lock (&atoms_lock);
+  if (atoms_nslots)
+  {
+    unsigned mask = atoms_nslots - 1;
+    for (unsigned i = hash & mask; (a = atoms_slots[i]); i = (i + 1) & mask)
+    {
+      if (a->str == s)
+      {
+        atom = true;
+        if (--a->refs == 0)
+        {
+          atoms_remove (i);
+          free (a);
+        }
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock (&atoms_lock);
+  if (!atom)
+  {
+    free (s);
+  }
+}
+
+uint32_t edgex_atom_hash (const char *atom)
+{
+  return ATOM_HDR (atom)->hash;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_ATOMS_H_
+#define _EDGEX_DEVICE_ATOMS_H_ 1
+
+#include <stdint.h>
+
+/*
+ * Interned strings. Names, ids and resource keys recur across every device
+ * and profile, so a single reference-counted copy of each is shared. Two
+ * atoms are equal only if they are the same pointer, and the hash of an atom
+ * (as computed by edgex_map_hash) is held with it.
+ *
+ * Atoms must not be modified, and are released with edgex_atom_free, which
+ * also accepts (and frees) strings that were not interned.
+ */
+
+/* Return the atom for a string, taking a reference to it */
+
+extern char *edgex_atom (const char *s);
+
+/* Release a reference to an atom, or free a string which is not an atom */
+
+extern void edgex_atom_free (char *s);
+
+/* The hash of a string returned by edgex_atom */
+
+extern uint32_t edgex_atom_hash (const char *atom);
+
+#endif
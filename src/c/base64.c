@@ -10,6 +10,15 @@
 
 #include <string.h>
 #include <inttypes.h>
+#include <pthread.h>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define B64_X86 1
+#include <immintrin.h>
+#elif defined (__aarch64__)
+#define B64_NEON 1
+#include <arm_neon.h>
+#endif
 
 #define WHITESPACE 64
 #define EQUALS     65
@@ -36,6 +45,327 @@ static const unsigned char dec[] =
 static const char enc[] =
   "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/*
+ * Block kernels. Each converts as much of its input as it can in whole
+ * blocks, leaving any remainder to be processed by the generic code. An
+ * encoding kernel returns the number of bytes consumed, a multiple of three,
+ * having written four characters for every three bytes. A decoding kernel
+ * returns the number of characters consumed, a multiple of four, having
+ * written three bytes for every four characters; it stops at whitespace,
+ * padding or an invalid character, and never writes more than outLen bytes.
+ */
+
+typedef size_t (*b64_enc_kernel) (const uint8_t *in, size_t inLen, char *out);
+typedef size_t (*b64_dec_kernel)
+  (const char *in, size_t inLen, uint8_t *out, size_t outLen);
+
+static size_t enc_scalar (const uint8_t *in, size_t inLen, char *out)
+{
+  size_t x;
+  for (x = 0; x + 3 <= inLen; x += 3)
+  {
+    uint32_t n = (uint32_t) in[x] << 16 | (uint32_t) in[x + 1] << 8 | in[x + 2];
+    *out++ = enc[n >> 18];
+    *out++ = enc[(n >> 12) & 63];
+    *out++ = enc[(n >> 6) & 63];
+    *out++ = enc[n & 63];
+  }
+  return x;
+}
+
+static size_t dec_scalar
+  (const char *in, size_t inLen, uint8_t *out, size_t outLen)
+{
+  size_t x;
+  for (x = 0; x + 4 <= inLen && x / 4 * 3 + 3 <= outLen; x += 4)
+  {
+    uint32_t c0 = dec[(unsigned char) in[x]];
+    uint32_t c1 = dec[(unsigned char) in[x + 1]];
+    uint32_t c2 = dec[(unsigned char) in[x + 2]];
+    uint32_t c3 = dec[(unsigned char) in[x + 3]];
+    if ((c0 | c1 | c2 | c3) & 64)
+    {
+      break;
+    }
+    uint32_t n = c0 << 18 | c1 << 12 | c2 << 6 | c3;
+    *out++ = n >> 16;
+    *out++ = (n >> 8) & 255;
+    *out++ = n & 255;
+  }
+  return x;
+}
+
+#ifdef B64_X86
+
+/*
+ * SSSE3 and AVX2 kernels, after the methods described by Wojciech Mula and
+ * Daniel Lemire ("Faster Base64 Encoding and Decoding Using AVX2
+ * Instructions", ACM TOW 2018). The AVX2 versions process the two 128-bit
+ * lanes independently, as the byte shuffles do not cross lanes.
+ */
+
+#define B64_ENC_SHUFFLE \
+  10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+
+#define B64_ENC_SHIFT \
+  0, 0, 'A', '/' - 63, '+' - 62, '0' - 52, '0' - 52, '0' - 52, \
+  '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, \
+  'a' - 26
+
+#define B64_DEC_LUT_LO \
+  0x1a, 0x1b, 0x1b, 0x1b, 0x1a, 0x13, 0x11, 0x11, \
+  0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x15
+
+#define B64_DEC_LUT_HI \
+  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, \
+  0x08, 0x04, 0x08, 0x04, 0x02, 0x01, 0x10, 0x10
+
+#define B64_DEC_ROLL \
+  0, 0, 0, 0, 0, 0, 0, 0, -71, -71, -65, -65, 4, 19, 16, 0
+
+#define B64_DEC_PACK \
+  -1, -1, -1, -1, 12, 13, 14, 8, 9, 10, 4, 5, 6, 0, 1, 2
+
+__attribute__ ((target ("ssse3")))
+static size_t enc_ssse3 (const uint8_t *in, size_t inLen, char *out)
+{
+  const __m128i shuf = _mm_set_epi8 (B64_ENC_SHUFFLE);
+  const __m128i shift = _mm_set_epi8 (B64_ENC_SHIFT);
+  size_t x;
+
+  /* Twelve bytes are used from each sixteen loaded */
+
+  for (x = 0; x + 16 <= inLen; x += 12)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (in + x));
+    v = _mm_shuffle_epi8 (v, shuf);
+    __m128i t0 = _mm_mulhi_epu16
+      (_mm_and_si128 (v, _mm_set1_epi32 (0x0fc0fc00)), _mm_set1_epi32 (0x04000040));
+    __m128i t1 = _mm_mullo_epi16
+      (_mm_and_si128 (v, _mm_set1_epi32 (0x003f03f0)), _mm_set1_epi32 (0x01000010));
+    __m128i idx = _mm_or_si128 (t0, t1);
+    __m128i r = _mm_subs_epu8 (idx, _mm_set1_epi8 (51));
+    __m128i lt = _mm_cmpgt_epi8 (_mm_set1_epi8 (26), idx);
+    r = _mm_or_si128 (r, _mm_and_si128 (lt, _mm_set1_epi8 (13)));
+    r = _mm_add_epi8 (_mm_shuffle_epi8 (shift, r), idx);
+    _mm_storeu_si128 ((__m128i *) out, r);
+    out += 16;
+  }
+  return x;
+}
+
+__attribute__ ((target ("ssse3")))
+static size_t dec_ssse3
+  (const char *in, size_t inLen, uint8_t *out, size_t outLen)
+{
+  const __m128i lutlo = _mm_set_epi8 (B64_DEC_LUT_LO);
+  const __m128i luthi = _mm_set_epi8 (B64_DEC_LUT_HI);
+  const __m128i roll = _mm_set_epi8 (B64_DEC_ROLL);
+  const __m128i pack = _mm_set_epi8 (B64_DEC_PACK);
+  const __m128i nibble = _mm_set1_epi8 (0x0f);
+  size_t x;
+
+  /* Sixteen bytes are stored for every twelve produced */
+
+  for (x = 0; x + 16 <= inLen && x / 4 * 3 + 16 <= outLen; x += 16)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (in + x));
+    __m128i hi = _mm_and_si128 (_mm_srli_epi32 (v, 4), nibble);
+    __m128i lo = _mm_and_si128 (v, nibble);
+    __m128i bad = _mm_and_si128
+      (_mm_shuffle_epi8 (lutlo, lo), _mm_shuffle_epi8 (luthi, hi));
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (bad, _mm_setzero_si128 ())) != 0xffff)
+    {
+      break;
+    }
+    __m128i slash = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('/'));
+    v = _mm_add_epi8 (v, _mm_shuffle_epi8 (roll, _mm_add_epi8 (slash, hi)));
+    v = _mm_maddubs_epi16 (v, _mm_set1_epi32 (0x01400140));
+    v = _mm_madd_epi16 (v, _mm_set1_epi32 (0x00011000));
+    _mm_storeu_si128 ((__m128i *) out, _mm_shuffle_epi8 (v, pack));
+    out += 12;
+  }
+  return x;
+}
+
+__attribute__ ((target ("avx2")))
+static size_t enc_avx2 (const uint8_t *in, size_t inLen, char *out)
+{
+  const __m256i shuf = _mm256_set_epi8 (B64_ENC_SHUFFLE, B64_ENC_SHUFFLE);
+  const __m256i shift = _mm256_set_epi8 (B64_ENC_SHIFT, B64_ENC_SHIFT);
+  size_t x;
+
+  /* Each lane takes twelve bytes, of sixteen loaded */
+
+  for (x = 0; x + 28 <= inLen; x += 24)
+  {
+    __m256i v = _mm256_inserti128_si256
+    (
+      _mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) (in + x))),
+      _mm_loadu_si128 ((const __m128i *) (in + x + 12)),
+      1
+    );
+    v = _mm256_shuffle_epi8 (v, shuf);
+    __m256i t0 = _mm256_mulhi_epu16
+    (
+      _mm256_and_si256 (v, _mm256_set1_epi32 (0x0fc0fc00)),
+      _mm256_set1_epi32 (0x04000040)
+    );
+    __m256i t1 = _mm256_mullo_epi16
+    (
+      _mm256_and_si256 (v, _mm256_set1_epi32 (0x003f03f0)),
+      _mm256_set1_epi32 (0x01000010)
+    );
+    __m256i idx = _mm256_or_si256 (t0, t1);
+    __m256i r = _mm256_subs_epu8 (idx, _mm256_set1_epi8 (51));
+    __m256i lt = _mm256_cmpgt_epi8 (_mm256_set1_epi8 (26), idx);
+    r = _mm256_or_si256 (r, _mm256_and_si256 (lt, _mm256_set1_epi8 (13)));
+    r = _mm256_add_epi8 (_mm256_shuffle_epi8 (shift, r), idx);
+    _mm256_storeu_si256 ((__m256i *) out, r);
+    out += 32;
+  }
+  return x;
+}
+
+__attribute__ ((target ("avx2")))
+static size_t dec_avx2
+  (const char *in, size_t inLen, uint8_t *out, size_t outLen)
+{
+  const __m256i lutlo = _mm256_set_epi8 (B64_DEC_LUT_LO, B64_DEC_LUT_LO);
+  const __m256i luthi = _mm256_set_epi8 (B64_DEC_LUT_HI, B64_DEC_LUT_HI);
+  const __m256i roll = _mm256_set_epi8 (B64_DEC_ROLL, B64_DEC_ROLL);
+  const __m256i pack = _mm256_set_epi8 (B64_DEC_PACK, B64_DEC_PACK);
+  const __m256i nibble = _mm256_set1_epi8 (0x0f);
+  size_t x;
+
+  /* Thirty-two bytes are stored for every twenty-four produced */
+
+  for (x = 0; x + 32 <= inLen && x / 4 * 3 + 32 <= outLen; x += 32)
+  {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) (in + x));
+    __m256i hi = _mm256_and_si256 (_mm256_srli_epi32 (v, 4), nibble);
+    __m256i lo = _mm256_and_si256 (v, nibble);
+    __m256i bad = _mm256_and_si256
+      (_mm256_shuffle_epi8 (lutlo, lo), _mm256_shuffle_epi8 (luthi, hi));
+    if (!_mm256_testz_si256 (bad, bad))
+    {
+      break;
+    }
+    __m256i slash = _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('/'));
+    v = _mm256_add_epi8
+      (v, _mm256_shuffle_epi8 (roll, _mm256_add_epi8 (slash, hi)));
+    v = _mm256_maddubs_epi16 (v, _mm256_set1_epi32 (0x01400140));
+    v = _mm256_madd_epi16 (v, _mm256_set1_epi32 (0x00011000));
+    v = _mm256_shuffle_epi8 (v, pack);
+    v = _mm256_permutevar8x32_epi32 (v, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 7, 7));
+    _mm256_storeu_si256 ((__m256i *) out, v);
+    out += 24;
+  }
+  return x;
+}
+
+#endif
+
+#ifdef B64_NEON
+
+/* NEON kernels, using the de-interleaving loads and 64-byte table lookups */
+
+static size_t enc_neon (const uint8_t *in, size_t inLen, char *out)
+{
+  const uint8x16_t mask = vdupq_n_u8 (63);
+  uint8x16x4_t tbl;
+  size_t x;
+
+  for (unsigned i = 0; i < 4; i++)
+  {
+    tbl.val[i] = vld1q_u8 ((const uint8_t *) enc + 16 * i);
+  }
+  for (x = 0; x + 48 <= inLen; x += 48)
+  {
+    uint8x16x3_t v = vld3q_u8 (in + x);
+    uint8x16x4_t r;
+    r.val[0] = vshrq_n_u8 (v.val[0], 2);
+    r.val[1] = vandq_u8
+      (vorrq_u8 (vshrq_n_u8 (v.val[1], 4), vshlq_n_u8 (v.val[0], 4)), mask);
+    r.val[2] = vandq_u8
+      (vorrq_u8 (vshrq_n_u8 (v.val[2], 6), vshlq_n_u8 (v.val[1], 2)), mask);
+    r.val[3] = vandq_u8 (v.val[2], mask);
+    for (unsigned i = 0; i < 4; i++)
+    {
+      r.val[i] = vqtbl4q_u8 (tbl, r.val[i]);
+    }
+    vst4q_u8 ((uint8_t *) out, r);
+    out += 64;
+  }
+  return x;
+}
+
+static size_t dec_neon
+  (const char *in, size_t inLen, uint8_t *out, size_t outLen)
+{
+  const uint8x16_t invalid = vdupq_n_u8 (64);
+  uint8x16x4_t tlo;
+  uint8x16x4_t thi;
+  size_t x;
+
+  for (unsigned i = 0; i < 4; i++)
+  {
+    tlo.val[i] = vld1q_u8 (dec + 16 * i);
+    thi.val[i] = vld1q_u8 (dec + 64 + 16 * i);
+  }
+  for (x = 0; x + 64 <= inLen && x / 4 * 3 + 48 <= outLen; x += 64)
+  {
+    uint8x16x4_t v = vld4q_u8 ((const uint8_t *) in + x);
+    uint8x16_t bad = vdupq_n_u8 (0);
+    for (unsigned i = 0; i < 4; i++)
+    {
+      uint8x16_t c = v.val[i];
+      v.val[i] = vqtbx4q_u8 (vqtbl4q_u8 (tlo, c), thi, vsubq_u8 (c, invalid));
+      bad = vorrq_u8 (bad, vcgeq_u8 (v.val[i], invalid));
+      bad = vorrq_u8 (bad, vcgeq_u8 (c, vdupq_n_u8 (128)));
+    }
+    if (vmaxvq_u8 (bad))
+    {
+      break;
+    }
+    uint8x16x3_t r;
+    r.val[0] = vorrq_u8 (vshlq_n_u8 (v.val[0], 2), vshrq_n_u8 (v.val[1], 4));
+    r.val[1] = vorrq_u8 (vshlq_n_u8 (v.val[1], 4), vshrq_n_u8 (v.val[2], 2));
+    r.val[2] = vorrq_u8 (vshlq_n_u8 (v.val[2], 6), v.val[3]);
+    vst3q_u8 (out, r);
+    out += 48;
+  }
+  return x;
+}
+
+#endif
+
+/* The fastest kernels supported by the CPU, chosen on first use */
+
+static b64_enc_kernel enc_fast = NULL;
+static b64_dec_kernel dec_fast = NULL;
+static pthread_once_t b64_once = PTHREAD_ONCE_INIT;
+
+static void b64_select (void)
+{
+#if defined (B64_X86)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    enc_fast = enc_avx2;
+    dec_fast = dec_avx2;
+  }
+  else if (__builtin_cpu_supports ("ssse3"))
+  {
+    enc_fast = enc_ssse3;
+    dec_fast = dec_ssse3;
+  }
+#elif defined (B64_NEON)
+  enc_fast = enc_neon;
+  dec_fast = dec_neon;
+#endif
+}
+
 size_t edgex_b64_encodesize (size_t binsize)
 {
   size_t result = binsize / 3 * 4;    // Four chars per three bytes
@@ -59,6 +389,20 @@ bool edgex_b64_decode (const char *in, void *outv, size_t *outLen)
   int iter = 0;
   uint32_t buf = 0;
   size_t len = 0;
+  size_t inLen = strlen (in);
+  size_t done = 0;
+
+  /* Whole blocks first; whitespace and padding are left to the loop below */
+
+  pthread_once (&b64_once, b64_select);
+  if (dec_fast)
+  {
+    done = dec_fast (in, inLen, out, *outLen);
+  }
+  done += dec_scalar (in + done, inLen - done, out + done / 4 * 3, *outLen - done / 4 * 3);
+  in += done;
+  len = done / 4 * 3;
+  out += len;
 
   while (*in)
   {
@@ -98,70 +442,55 @@ bool edgex_b64_decode (const char *in, void *outv, size_t *outLen)
   return true;
 }
 
-bool edgex_b64_encode (const void *in, size_t inLen, char *out, size_t outLen)
+/* Encode, returning the number of characters written (not including '\0') */
+
+static size_t b64_encode (const uint8_t *data, size_t inLen, char *out)
 {
-  const uint8_t *data = (const uint8_t *) in;
-  size_t resultIndex = 0;
-  size_t x;
-  uint32_t n = 0;
-  uint8_t n0, n1, n2, n3;
+  size_t x = 0;
 
-  if (outLen < edgex_b64_encodesize (inLen))
+  pthread_once (&b64_once, b64_select);
+  if (enc_fast)
   {
-    return false;
+    x = enc_fast (data, inLen, out);
   }
+  x += enc_scalar (data + x, inLen - x, out + x / 3 * 4);
+  size_t resultIndex = x / 3 * 4;
 
-  /* iterate over the length of the string, three characters at a time */
-  for (x = 0; x < inLen; x += 3)
-  {
-    /* combine up to three bytes into 24 bits */
-
-    n = ((uint32_t) data[x]) << 16;
-    if ((x + 1) < inLen)
-    {
-      n += ((uint32_t) data[x + 1]) << 8;
-    }
-    if ((x + 2) < inLen)
-    {
-      n += data[x + 2];
-    }
-
-    /* split into four 6-bit numbers */
-
-    n0 = (uint8_t) (n >> 18) & 63;
-    n1 = (uint8_t) (n >> 12) & 63;
-    n2 = (uint8_t) (n >> 6) & 63;
-    n3 = (uint8_t) n & 63;
-
-    /* One byte -> two characters */
-
-    out[resultIndex++] = enc[n0];
-    out[resultIndex++] = enc[n1];
-
-    /* Two bytes -> three characters */
-
-    if ((x + 1) < inLen)
-    {
-      out[resultIndex++] = enc[n2];
-    }
+  /* One trailing byte -> two characters, two -> three. Pad to four */
 
-    /* Three bytes -> four characters */
-
-    if ((x + 2) < inLen)
+  if (x < inLen)
+  {
+    uint32_t n = (uint32_t) data[x] << 16;
+    if (x + 1 < inLen)
     {
-      out[resultIndex++] = enc[n3];
+      n |= (uint32_t) data[x + 1] << 8;
     }
-  }
-
-  /* Pad to multiple of four characters */
-
-  while (resultIndex % 4)
-  {
+    out[resultIndex++] = enc[n >> 18];
+    out[resultIndex++] = enc[(n >> 12) & 63];
+    out[resultIndex++] = (x + 1 < inLen) ? enc[(n >> 6) & 63] : '=';
     out[resultIndex++] = '=';
   }
 
   /* Terminate string */
 
   out[resultIndex] = 0;
+  return resultIndex;
+}
+
+bool edgex_b64_encode (const void *in, size_t inLen, char *out, size_t outLen)
+{
+  if (outLen < edgex_b64_encodesize (inLen))
+  {
+    return false;
+  }
+  b64_encode ((const uint8_t *) in, inLen, out);
   return true;
 }
+
+void edgex_b64_encode_append
+  (edgex_strbuf *buf, const void *in, size_t inLen)
+{
+  size_t sz = edgex_b64_encodesize (inLen);
+  edgex_strbuf_reserve (buf, sz);
+  buf->len += b64_encode ((const uint8_t *) in, inLen, buf->data + buf->len);
+}
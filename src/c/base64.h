@@ -9,6 +9,8 @@
 #ifndef _EDGEX_DEVICE_BASE64_H
 #define _EDGEX_DEVICE_BASE64_H 1
 
+#include "strbuf.h"
+
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -21,5 +23,10 @@ extern bool edgex_b64_decode (const char *in, void *out, size_t *outLen);
 extern bool edgex_b64_encode
   (const void *in, size_t inLen, char *out, size_t outLen);
 
+/* Encode straight into the end of a buffer */
+
+extern void edgex_b64_encode_append
+  (edgex_strbuf *buf, const void *in, size_t inLen);
+
 #endif
 
@@ -0,0 +1,221 @@
+#include "chainmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The original chained implementation of edgex_map, kept as a baseline for
+ * the map benchmark. Based on rxi's type-safe hashmap implementation
+ */
+
+/**
+ * Copyright (c) 2014 rxi
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the MIT license. See LICENSE for details.
+ */
+
+typedef struct chain_map_node
+{
+  unsigned hash;
+  void *value;
+  chain_map_node *next;
+} chain_map_node;
+
+static unsigned chain_hash (const char *str)
+{
+  unsigned hash = 5381u;
+  while (*str)
+  {
+    hash = ((hash << 5) + hash) ^ *str++;
+  }
+  return hash;
+}
+
+static chain_map_node *chain_map_newnode
+  (const char *key, void *value, int vsize)
+{
+  chain_map_node *node;
+  int ksize = strlen (key) + 1;
+  int voffset = ksize + ((sizeof (void *) - ksize) % sizeof (void *));
+  node = malloc (sizeof (*node) + voffset + vsize);
+  if (!node)
+  { return NULL; }
+  memcpy (node + 1, key, ksize);
+  node->hash = chain_hash (key);
+  node->value = ((char *) (node + 1)) + voffset;
+  memcpy (node->value, value, vsize);
+  return node;
+}
+
+static int chain_map_bucketidx (chain_map_base *m, unsigned hash)
+{
+  /* If the implementation is changed to allow a non-power-of-2 bucket count,
+   * the line below should be changed to use mod instead of AND
+   */
+  return hash & (m->nbuckets - 1);
+}
+
+static void chain_map_addnode (chain_map_base *m, chain_map_node *node)
+{
+  int n = chain_map_bucketidx (m, node->hash);
+  node->next = m->buckets[n];
+  m->buckets[n] = node;
+}
+
+static int chain_map_resize (chain_map_base *m, int nbuckets)
+{
+  chain_map_node *nodes, *node, *next;
+  chain_map_node **buckets;
+  int i;
+  /* Chain all nodes together */
+  nodes = NULL;
+  i = m->nbuckets;
+  while (i--)
+  {
+    node = (m->buckets)[i];
+    while (node)
+    {
+      next = node->next;
+      node->next = nodes;
+      nodes = node;
+      node = next;
+    }
+  }
+  /* Reset buckets */
+  buckets = realloc (m->buckets, sizeof (*m->buckets) * nbuckets);
+  if (buckets != NULL)
+  {
+    m->buckets = buckets;
+    m->nbuckets = nbuckets;
+  }
+  if (m->buckets)
+  {
+    memset (m->buckets, 0, sizeof (*m->buckets) * m->nbuckets);
+    /* Re-add nodes to buckets */
+    node = nodes;
+    while (node)
+    {
+      next = node->next;
+      chain_map_addnode (m, node);
+      node = next;
+    }
+  }
+  /* Return error code if realloc() failed */
+  return (buckets == NULL) ? -1 : 0;
+}
+
+static chain_map_node **chain_map_getref (chain_map_base *m, const char *key)
+{
+  unsigned hash = chain_hash (key);
+  if (m->nbuckets > 0)
+  {
+    chain_map_node **next = &m->buckets[chain_map_bucketidx (m, hash)];
+    while (*next)
+    {
+      if ((*next)->hash == hash && !strcmp ((char *) (*next + 1), key))
+      {
+        return next;
+      }
+      next = &(*next)->next;
+    }
+  }
+  return NULL;
+}
+
+void chain_map_deinit_ (chain_map_base *m)
+{
+  chain_map_node *next, *node;
+  int i;
+  i = m->nbuckets;
+  while (i--)
+  {
+    node = m->buckets[i];
+    while (node)
+    {
+      next = node->next;
+      free (node);
+      node = next;
+    }
+  }
+  free (m->buckets);
+}
+
+void *chain_map_get_ (chain_map_base *m, const char *key)
+{
+  chain_map_node **next = chain_map_getref (m, key);
+  return next ? (*next)->value : NULL;
+}
+
+int chain_map_set_ (chain_map_base *m, const char *key, void *value, int vsize)
+{
+  int n, err;
+  chain_map_node **next, *node;
+  /* Find & replace existing node */
+  next = chain_map_getref (m, key);
+  if (next)
+  {
+    memcpy ((*next)->value, value, vsize);
+    return 0;
+  }
+  /* Add new node */
+  node = chain_map_newnode (key, value, vsize);
+  if (node == NULL)
+  { goto fail; }
+  if (m->nnodes >= m->nbuckets)
+  {
+    n = (m->nbuckets > 0) ? (m->nbuckets << 1) : 1;
+    err = chain_map_resize (m, n);
+    if (err)
+    { goto fail; }
+  }
+  chain_map_addnode (m, node);
+  m->nnodes++;
+  return 0;
+  fail:
+  if (node)
+  { free (node); }
+  return -1;
+}
+
+void chain_map_remove_ (chain_map_base *m, const char *key)
+{
+  chain_map_node **next = chain_map_getref (m, key);
+  if (next)
+  {
+    chain_map_node *node = *next;
+    *next = (*next)->next;
+    free (node);
+    m->nnodes--;
+  }
+}
+
+chain_map_iter chain_map_iter_ (void)
+{
+  chain_map_iter iter;
+  iter.bucketidx = -1;
+  iter.node = NULL;
+  return iter;
+}
+
+const char *chain_map_next_ (chain_map_base *m, chain_map_iter *iter)
+{
+  if (iter->node)
+  {
+    iter->node = iter->node->next;
+    if (iter->node == NULL)
+    { goto nextBucket; }
+  }
+  else
+  {
+    nextBucket:
+    do
+    {
+      if (++iter->bucketidx >= m->nbuckets)
+      {
+        return NULL;
+      }
+      iter->node = m->buckets[iter->bucketidx];
+    } while (iter->node == NULL);
+  }
+  return (char *) (iter->node + 1);
+}
@@ -0,0 +1,68 @@
+#ifndef _EDGEX_BENCH_CHAINMAP_H_
+#define _EDGEX_BENCH_CHAINMAP_H_ 1
+
+/* Based on rxi's type-safe hashmap implementation */
+
+/**
+ * Copyright (c) 2014 rxi
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the MIT license. See LICENSE for details.
+ */
+
+struct chain_map_node;
+typedef struct chain_map_node chain_map_node;
+
+typedef struct
+{
+  chain_map_node **buckets;
+  unsigned nbuckets;
+  unsigned nnodes;
+} chain_map_base;
+
+typedef struct
+{
+  unsigned bucketidx;
+  chain_map_node *node;
+} chain_map_iter;
+
+#define chain_map(T) \
+struct \
+{ \
+  chain_map_base base; \
+  T * ref; \
+  T tmp; \
+}
+
+#define chain_map_init(m) memset(m, 0, sizeof(*(m)))
+
+#define chain_map_deinit(m) chain_map_deinit_(&(m)->base)
+
+#define chain_map_get(m, key) ((m)->ref = chain_map_get_(&(m)->base, key))
+
+#define chain_map_set(m, key, value) \
+  ((m)->tmp = (value), \
+  chain_map_set_(&(m)->base, key, &(m)->tmp, sizeof((m)->tmp)) )
+
+#define chain_map_remove(m, key) chain_map_remove_ (&(m)->base, key)
+
+#define chain_map_iter(m) chain_map_iter_ ()
+
+#define chain_map_next(m, iter) chain_map_next_ (&(m)->base, iter)
+
+extern void chain_map_deinit_ (chain_map_base *m);
+
+extern void *chain_map_get_ (chain_map_base *m, const char *key);
+
+extern int chain_map_set_
+  (chain_map_base *m, const char *key, void *value, int vsize);
+
+extern void chain_map_remove_ (chain_map_base *m, const char *key);
+
+extern chain_map_iter chain_map_iter_ (void);
+
+extern const char *chain_map_next_ (chain_map_base *m, chain_map_iter *iter);
+
+typedef chain_map(void *) chain_map_void;
+
+#endif
@@ -0,0 +1,689 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * End-to-end benchmark. A device service with a synthetic driver is started
+ * against a mock core-data and core-metadata served in-process, which holds
+ * a generated set of devices and profiles. The benchmark then measures:
+ *
+ *   - startup: the time taken by edgex_device_service_start
+ *   - latency: sequential device commands over REST, each posting an event
+ *   - throughput: commands and events per second from concurrent clients
+ *   - memory: resident set size after startup, and at its peak
+ *
+ * Results are written as a single JSON object, to standard output or to the
+ * file given with -o, so that runs may be compared.
+ */
+
+#include "edgex/devsdk.h"
+#include "../rest.h"
+#include "../errorlist.h"
+#include "../strbuf.h"
+#include "../parson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <microhttpd.h>
+
+#define DEFAULT_DEVICES 10
+#define DEFAULT_RESOURCES 10
+#define DEFAULT_REQUESTS 1000
+#define DEFAULT_THREADS 4
+#define DEFAULT_SECONDS 5
+#define DEFAULT_PORT 59990
+#define MAX_PROFILES 4
+#define DRAIN_WAIT 2.0
+
+#if MHD_VERSION >= 0x00095300
+#define BENCH_MHD_FLAGS MHD_USE_INTERNAL_POLLING_THREAD
+#else
+#define BENCH_MHD_FLAGS MHD_USE_SELECT_INTERNALLY
+#endif
+
+typedef struct bench_options
+{
+  unsigned devices;
+  unsigned resources;
+  unsigned requests;
+  unsigned threads;
+  unsigned seconds;
+  unsigned port;
+  const char *output;
+} bench_options;
+
+static bench_options opts =
+{
+  DEFAULT_DEVICES, DEFAULT_RESOURCES, DEFAULT_REQUESTS, DEFAULT_THREADS,
+  DEFAULT_SECONDS, DEFAULT_PORT, NULL
+};
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read a size in kB, eg VmRSS, from /proc/self/status */
+
+static unsigned long proc_status_kb (const char *field)
+{
+  char line[128];
+  unsigned long result = 0;
+  size_t len = strlen (field);
+  FILE *f = fopen ("/proc/self/status", "r");
+  if (f)
+  {
+    while (fgets (line, sizeof (line), f))
+    {
+      if (strncmp (line, field, len) == 0 && line[len] == ':')
+      {
+        result = strtoul (line + len + 1, NULL, 10);
+        break;
+      }
+    }
+    fclose (f);
+  }
+  return result;
+}
+
+/* Synthetic driver: every resource reads as a Float32 count */
+
+typedef struct bench_driver
+{
+  uint64_t reads;
+} bench_driver;
+
+static bool bench_init
+  (void *impl, struct iot_logging_client *lc, const edgex_nvpairs *config)
+{
+  return true;
+}
+
+static void bench_discover (void *impl) {}
+
+static bool bench_get_handler
+(
+  void *impl,
+  const edgex_addressable *devaddr,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *requests,
+  edgex_device_commandresult *readings
+)
+{
+  bench_driver *driver = (bench_driver *) impl;
+  uint64_t n = __atomic_add_fetch (&driver->reads, 1, __ATOMIC_RELAXED);
+  for (uint32_t i = 0; i < nreadings; i++)
+  {
+    readings[i].type = Float32;
+    readings[i].value.f32_result = (float) (n % 1000);
+  }
+  return true;
+}
+
+static bool bench_put_handler
+(
+  void *impl,
+  const edgex_addressable *devaddr,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+)
+{
+  return true;
+}
+
+static bool bench_disconnect (void *impl, edgex_addressable *device)
+{
+  return true;
+}
+
+static void bench_stop (void *impl, bool force) {}
+
+/*
+ * Mock core-data and core-metadata. The service finds no registration of
+ * itself, so creates one; its devices, with their profiles, are listed from
+ * generated JSON. Posted events are counted.
+ */
+
+static struct
+{
+  struct MHD_Daemon *daemon;
+  char *devices;
+  char **profiles;
+  unsigned nprofiles;
+  uint64_t events;
+  uint64_t requests;
+} mock;
+
+static void add_profile (edgex_strbuf *b, unsigned p, unsigned nres)
+{
+  char buf[512];
+
+  sprintf
+  (
+    buf,
+    "{\"id\":\"7d1a4ac8-0000-4000-8000-%012u\",\"name\":\"Profile-%u\","
+    "\"description\":\"Generated profile\",\"created\":1550000000000,"
+    "\"modified\":1550000000000,\"origin\":0,\"manufacturer\":\"IoTech\","
+    "\"model\":\"Model-%u\",\"labels\":[\"bench\"],\"deviceResources\":[",
+    p, p, p
+  );
+  edgex_strbuf_appendstr (b, buf);
+  for (unsigned r = 0; r < nres; r++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"name\":\"Resource%u\",\"description\":\"Sensor reading %u\","
+      "\"properties\":{\"value\":{\"type\":\"Float32\",\"readWrite\":\"RW\","
+      "\"minimum\":\"0\",\"maximum\":\"1000\",\"defaultValue\":\"0\"},"
+      "\"units\":{\"type\":\"String\",\"readWrite\":\"R\","
+      "\"defaultValue\":\"degC\"}},\"attributes\":{\"register\":\"%u\"}}",
+      r ? "," : "", r, r, 40000 + r
+    );
+    edgex_strbuf_appendstr (b, buf);
+  }
+  edgex_strbuf_appendstr (b, "],\"resources\":[");
+  for (unsigned r = 0; r < nres; r++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"name\":\"Resource%u\",\"get\":[{\"index\":\"1\","
+      "\"operation\":\"get\",\"object\":\"Resource%u\","
+      "\"parameter\":\"Resource%u\"}],\"set\":[]}",
+      r ? "," : "", r, r, r
+    );
+    edgex_strbuf_appendstr (b, buf);
+  }
+  edgex_strbuf_appendstr (b, "],\"commands\":[]}");
+}
+
+static void mock_generate (void)
+{
+  edgex_strbuf b;
+  char buf[1024];
+
+  mock.nprofiles = opts.devices < MAX_PROFILES ? opts.devices : MAX_PROFILES;
+  mock.profiles = calloc (mock.nprofiles, sizeof (char *));
+  for (unsigned p = 0; p < mock.nprofiles; p++)
+  {
+    edgex_strbuf_init (&b);
+    add_profile (&b, p, opts.resources);
+    mock.profiles[p] = b.data;
+  }
+
+  edgex_strbuf_init (&b);
+  edgex_strbuf_appendchar (&b, '[');
+  for (unsigned i = 0; i < opts.devices; i++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"id\":\"5c6f3ab1-0000-4000-8000-%012u\",\"name\":\"Device-%u\","
+      "\"description\":\"Generated device\",\"adminState\":\"UNLOCKED\","
+      "\"operatingState\":\"ENABLED\",\"lastConnected\":0,"
+      "\"lastReported\":0,\"labels\":[\"bench\"],\"origin\":1550000000000,"
+      "\"created\":1550000000000,\"modified\":1550000000000,"
+      "\"addressable\":{\"id\":\"a-%u\",\"name\":\"Address-%u\","
+      "\"protocol\":\"TCP\",\"address\":\"10.0.%u.%u\",\"port\":502,"
+      "\"path\":\"\",\"created\":0,\"modified\":0,\"origin\":0},"
+      "\"service\":{\"id\":\"s-1\",\"name\":\"device-bench\","
+      "\"adminState\":\"UNLOCKED\",\"operatingState\":\"ENABLED\","
+      "\"labels\":[],\"addressable\":{\"name\":\"device-bench\","
+      "\"protocol\":\"HTTP\",\"address\":\"localhost\",\"port\":%u}},"
+      "\"profile\":%s}",
+      i ? "," : "", i, i, i, i, (i >> 8) & 0xff, i & 0xff, opts.port,
+      mock.profiles[i % mock.nprofiles]
+    );
+    edgex_strbuf_appendstr (&b, buf);
+  }
+  edgex_strbuf_appendchar (&b, ']');
+  mock.devices = b.data;
+}
+
+static bool has_prefix (const char *s, const char *prefix)
+{
+  return strncmp (s, prefix, strlen (prefix)) == 0;
+}
+
+static const char *mock_profile (const char *name)
+{
+  for (unsigned p = 0; p < mock.nprofiles; p++)
+  {
+    char pname[32];
+    sprintf (pname, "Profile-%u", p);
+    if (strcmp (name, pname) == 0)
+    {
+      return mock.profiles[p];
+    }
+  }
+  return NULL;
+}
+
+static int mock_handler
+(
+  void *cls,
+  struct MHD_Connection *conn,
+  const char *url,
+  const char *method,
+  const char *version,
+  const char *upload_data,
+  size_t *upload_data_size,
+  void **context
+)
+{
+  const char *body = "";
+  const char *type = "application/json";
+  unsigned status = MHD_HTTP_OK;
+
+  /* The first call starts a request; upload data follows in later calls */
+
+  if (*context == NULL)
+  {
+    *context = conn;
+    return MHD_YES;
+  }
+  if (*upload_data_size)
+  {
+    *upload_data_size = 0;
+    return MHD_YES;
+  }
+
+  __atomic_add_fetch (&mock.requests, 1, __ATOMIC_RELAXED);
+  if (strcmp (method, "GET") == 0)
+  {
+    if (strcmp (url, "/api/v1/ping") == 0)
+    {
+      body = "pong";
+      type = "text/plain";
+    }
+    else if (has_prefix (url, "/api/v1/device/servicename/"))
+    {
+      body = mock.devices;
+    }
+    else if (has_prefix (url, "/api/v1/deviceprofile/name/"))
+    {
+      body = mock_profile (url + strlen ("/api/v1/deviceprofile/name/"));
+      if (body == NULL)
+      {
+        body = "";
+        status = MHD_HTTP_NOT_FOUND;
+      }
+    }
+    else if
+    (
+      has_prefix (url, "/api/v1/deviceservice/name/") ||
+      has_prefix (url, "/api/v1/addressable/name/") ||
+      has_prefix (url, "/api/v1/schedule/name/")
+    )
+    {
+      status = MHD_HTTP_NOT_FOUND;
+    }
+    else
+    {
+      body = "[]";
+    }
+  }
+  else if (strcmp (method, "POST") == 0)
+  {
+    if (strcmp (url, "/api/v1/event") == 0)
+    {
+      __atomic_add_fetch (&mock.events, 1, __ATOMIC_RELAXED);
+    }
+    body = "5c6f3ab1-0000-4000-8000-ffffffffffff";
+    type = "text/plain";
+  }
+
+  struct MHD_Response *response = MHD_create_response_from_buffer
+    (strlen (body), (void *) body, MHD_RESPMEM_PERSISTENT);
+  MHD_add_response_header (response, "Content-Type", type);
+  int ret = MHD_queue_response (conn, status, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+static bool mock_start (void)
+{
+  mock_generate ();
+  mock.daemon = MHD_start_daemon
+  (
+    BENCH_MHD_FLAGS, opts.port + 1, NULL, NULL, mock_handler, NULL,
+    MHD_OPTION_THREAD_POOL_SIZE, DEFAULT_THREADS, MHD_OPTION_END
+  );
+  return mock.daemon != NULL;
+}
+
+static void mock_stop (void)
+{
+  MHD_stop_daemon (mock.daemon);
+  for (unsigned p = 0; p < mock.nprofiles; p++)
+  {
+    free (mock.profiles[p]);
+  }
+  free (mock.profiles);
+  free (mock.devices);
+}
+
+static bool write_config (const char *dir)
+{
+  char path[512];
+  snprintf (path, sizeof (path), "%s/configuration.toml", dir);
+  FILE *f = fopen (path, "w");
+  if (f == NULL)
+  {
+    return false;
+  }
+  fprintf
+  (
+    f,
+    "[Service]\n"
+    "  Host = \"localhost\"\n"
+    "  Port = %u\n"
+    "  Timeout = 1000\n"
+    "  ConnectRetries = 3\n"
+    "  StartupMsg = \"Benchmark device service started\"\n"
+    "  CheckInterval = \"10s\"\n"
+    "[Clients]\n"
+    "  [Clients.Data]\n"
+    "    Host = \"localhost\"\n"
+    "    Port = %u\n"
+    "  [Clients.Metadata]\n"
+    "    Host = \"localhost\"\n"
+    "    Port = %u\n"
+    "[Device]\n"
+    "  DataTransform = true\n"
+    "  Discovery = false\n"
+    "  MaxCmdOps = 128\n"
+    "  MaxCmdResultLen = 256\n"
+    "[Logging]\n"
+    "  File = \"%s/bench.log\"\n",
+    opts.port, opts.port + 1, opts.port + 1, dir
+  );
+  fclose (f);
+  return true;
+}
+
+/* Run a device command, returning whether it succeeded */
+
+static bool command (unsigned n)
+{
+  edgex_ctx ctx;
+  edgex_error err = EDGEX_OK;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (ctx));
+  snprintf
+  (
+    url, sizeof (url), "http://localhost:%u/api/v1/device/name/Device-%u/"
+    "Resource%u", opts.port, n % opts.devices,
+    (n / opts.devices) % opts.resources
+  );
+  long status = edgex_http_get
+    (iot_log_default, &ctx, url, edgex_http_write_cb, &err);
+  free (ctx.buff);
+  return status == MHD_HTTP_OK;
+}
+
+static int cmp_double (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+static void measure_latency (JSON_Object *result)
+{
+  double *samples = malloc (opts.requests * sizeof (double));
+  double total = 0.0;
+  unsigned failed = 0;
+
+  for (unsigned i = 0; i < opts.requests; i++)
+  {
+    double t = now ();
+    failed += !command (i);
+    samples[i] = (now () - t) * 1e6;
+    total += samples[i];
+  }
+  qsort (samples, opts.requests, sizeof (double), cmp_double);
+
+  JSON_Value *lval = json_value_init_object ();
+  JSON_Object *lobj = json_value_get_object (lval);
+  json_object_set_number (lobj, "requests", opts.requests);
+  json_object_set_number (lobj, "failed", failed);
+  json_object_set_number (lobj, "mean_us", total / opts.requests);
+  json_object_set_number (lobj, "p50_us", samples[opts.requests / 2]);
+  json_object_set_number (lobj, "p90_us", samples[opts.requests * 9 / 10]);
+  json_object_set_number (lobj, "p99_us", samples[opts.requests * 99 / 100]);
+  json_object_set_number (lobj, "max_us", samples[opts.requests - 1]);
+  json_object_set_value (result, "latency", lval);
+  free (samples);
+}
+
+typedef struct load_worker
+{
+  pthread_t thread;
+  unsigned id;
+  double until;
+  uint64_t done;
+  uint64_t failed;
+} load_worker;
+
+static void *load_thread (void *p)
+{
+  load_worker *w = (load_worker *) p;
+  for (unsigned n = w->id; now () < w->until; n += opts.threads)
+  {
+    if (command (n))
+    {
+      w->done++;
+    }
+    else
+    {
+      w->failed++;
+    }
+  }
+  return NULL;
+}
+
+static void measure_throughput (JSON_Object *result)
+{
+  load_worker *workers = calloc (opts.threads, sizeof (load_worker));
+  uint64_t done = 0;
+  uint64_t failed = 0;
+
+  uint64_t events = __atomic_load_n (&mock.events, __ATOMIC_RELAXED);
+  double start = now ();
+  for (unsigned i = 0; i < opts.threads; i++)
+  {
+    workers[i].id = i;
+    workers[i].until = start + opts.seconds;
+    pthread_create (&workers[i].thread, NULL, load_thread, &workers[i]);
+  }
+  for (unsigned i = 0; i < opts.threads; i++)
+  {
+    pthread_join (workers[i].thread, NULL);
+    done += workers[i].done;
+    failed += workers[i].failed;
+  }
+  double elapsed = now () - start;
+
+  /* Allow queued events to reach the mock before counting them */
+
+  uint64_t posted = __atomic_load_n (&mock.events, __ATOMIC_RELAXED);
+  for (double t = now (); now () - t < DRAIN_WAIT && posted - events < done;)
+  {
+    usleep (10000);
+    posted = __atomic_load_n (&mock.events, __ATOMIC_RELAXED);
+  }
+  double drained = now () - start;
+
+  JSON_Value *tval = json_value_init_object ();
+  JSON_Object *tobj = json_value_get_object (tval);
+  json_object_set_number (tobj, "threads", opts.threads);
+  json_object_set_number (tobj, "seconds", elapsed);
+  json_object_set_number (tobj, "commands", done);
+  json_object_set_number (tobj, "failed", failed);
+  json_object_set_number (tobj, "commands_per_sec", done / elapsed);
+  json_object_set_number (tobj, "events", posted - events);
+  json_object_set_number (tobj, "events_per_sec", (posted - events) / drained);
+  json_object_set_value (result, "throughput", tval);
+  free (workers);
+}
+
+static void usage (void)
+{
+  printf ("Options:\n");
+  printf ("   -h, --help           : Show this text\n");
+  printf ("   -d, --devices <n>    : Number of devices (10)\n");
+  printf ("   -r, --resources <n>  : Resources per profile (10)\n");
+  printf ("   -n, --requests <n>   : Commands timed for latency (1000)\n");
+  printf ("   -t, --threads <n>    : Clients for throughput (4)\n");
+  printf ("   -s, --seconds <n>    : Duration of throughput run (5)\n");
+  printf ("   -p, --port <n>       : Service port, mock on next (59990)\n");
+  printf ("   -o, --output <file>  : Write results to a file\n");
+}
+
+static bool parse_args (int argc, char *argv[])
+{
+  static const struct { const char *s; const char *l; unsigned *v; } nums[] =
+  {
+    { "-d", "--devices", &opts.devices },
+    { "-r", "--resources", &opts.resources },
+    { "-n", "--requests", &opts.requests },
+    { "-t", "--threads", &opts.threads },
+    { "-s", "--seconds", &opts.seconds },
+    { "-p", "--port", &opts.port }
+  };
+
+  for (int n = 1; n < argc; n++)
+  {
+    bool found = false;
+    if (strcmp (argv[n], "-h") == 0 || strcmp (argv[n], "--help") == 0)
+    {
+      usage ();
+      return false;
+    }
+    if (n + 1 == argc)
+    {
+      printf ("Missing value for %s\n", argv[n]);
+      return false;
+    }
+    if (strcmp (argv[n], "-o") == 0 || strcmp (argv[n], "--output") == 0)
+    {
+      opts.output = argv[++n];
+      continue;
+    }
+    for (unsigned i = 0; i < sizeof (nums) / sizeof (nums[0]); i++)
+    {
+      if (strcmp (argv[n], nums[i].s) == 0 || strcmp (argv[n], nums[i].l) == 0)
+      {
+        *nums[i].v = strtoul (argv[++n], NULL, 10);
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      printf ("Unknown option %s\n", argv[n]);
+      usage ();
+      return false;
+    }
+  }
+  if (!opts.devices || !opts.resources || !opts.requests || !opts.threads)
+  {
+    printf ("Counts must be nonzero\n");
+    return false;
+  }
+  return true;
+}
+
+int main (int argc, char *argv[])
+{
+  char dir[] = "/tmp/csdk-bench-XXXXXX";
+  char path[sizeof (dir) + 32];
+  bench_driver driver = { 0 };
+  edgex_error e = EDGEX_OK;
+  int rc = 1;
+
+  if (!parse_args (argc, argv))
+  {
+    return 1;
+  }
+  if (mkdtemp (dir) == NULL || !write_config (dir) || !mock_start ())
+  {
+    fprintf (stderr, "Unable to set up benchmark environment\n");
+    return 1;
+  }
+
+  edgex_device_callbacks bench_impls =
+  {
+    bench_init,
+    bench_discover,
+    bench_get_handler,
+    bench_put_handler,
+    bench_disconnect,
+    bench_stop
+  };
+  edgex_device_service *service = edgex_device_service_new
+    ("device-bench", "1.0", &driver, bench_impls, &e);
+
+  JSON_Value *rval = json_value_init_object ();
+  JSON_Object *result = json_value_get_object (rval);
+  json_object_set_number (result, "devices", opts.devices);
+  json_object_set_number (result, "resources", opts.resources);
+
+  double t = now ();
+  if (e.code == 0)
+  {
+    edgex_device_service_start (service, NULL, NULL, dir, &e);
+  }
+  if (e.code == 0)
+  {
+    json_object_set_number (result, "startup_ms", (now () - t) * 1e3);
+    json_object_set_number (result, "rss_startup_kb", proc_status_kb ("VmRSS"));
+
+    measure_latency (result);
+    measure_throughput (result);
+
+    json_object_set_number (result, "rss_kb", proc_status_kb ("VmRSS"));
+    json_object_set_number (result, "rss_peak_kb", proc_status_kb ("VmHWM"));
+    json_object_set_number (result, "mock_requests", mock.requests);
+    edgex_device_service_stop (service, true, &e);
+
+    char *json = json_serialize_to_string (rval);
+    FILE *out = opts.output ? fopen (opts.output, "w") : stdout;
+    if (out)
+    {
+      fprintf (out, "%s\n", json);
+      if (out != stdout)
+      {
+        fclose (out);
+      }
+      rc = 0;
+    }
+    json_free_serialized_string (json);
+  }
+  else
+  {
+    fprintf (stderr, "Error: %d: %s\n", e.code, e.reason);
+  }
+  json_value_free (rval);
+  mock_stop ();
+
+  snprintf (path, sizeof (path), "%s/configuration.toml", dir);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/bench.log", dir);
+  unlink (path);
+  rmdir (dir);
+  return rc;
+}
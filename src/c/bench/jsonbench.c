@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * Compare reading a device list from metadata with the pull reader against
+ * parsing it with parson, for lists of devices sharing a few profiles. The
+ * devices read each way are also checked to be the same.
+ */
+
+#include "../edgex_rest.h"
+#include "../strbuf.h"
+#include "../parson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROFILES 4
+#define RESOURCES 20
+#define RUNS 5
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void add_profile (edgex_strbuf *b, unsigned p)
+{
+  char buf[512];
+
+  sprintf
+  (
+    buf,
+    "{\"id\":\"7d1a4ac8-0000-4000-8000-%012u\",\"name\":\"Profile-%u\","
+    "\"description\":\"Generated profile\",\"created\":1550000000000,"
+    "\"modified\":1550000000%03u,\"origin\":0,\"manufacturer\":\"IoTech\","
+    "\"model\":\"Model-%u\",\"labels\":[\"bench\",\"hvac\"],"
+    "\"deviceResources\":[",
+    p, p, p, p
+  );
+  edgex_strbuf_appendstr (b, buf);
+  for (unsigned r = 0; r < RESOURCES; r++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"name\":\"Resource%u\",\"description\":\"Sensor reading %u\","
+      "\"properties\":{\"value\":{\"type\":\"Float32\",\"readWrite\":\"RW\","
+      "\"minimum\":\"-100\",\"maximum\":\"100\",\"defaultValue\":\"0\"},"
+      "\"units\":{\"type\":\"String\",\"readWrite\":\"R\","
+      "\"defaultValue\":\"degC\"}},\"attributes\":{\"register\":\"%u\","
+      "\"width\":\"2\"}}",
+      r ? "," : "", r, r, 40000 + r
+    );
+    edgex_strbuf_appendstr (b, buf);
+  }
+  edgex_strbuf_appendstr (b, "],\"resources\":[");
+  for (unsigned r = 0; r < RESOURCES; r++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"name\":\"Resource%u\",\"get\":[{\"index\":\"1\","
+      "\"operation\":\"get\",\"object\":\"Resource%u\","
+      "\"parameter\":\"Resource%u\"}],\"set\":[]}",
+      r ? "," : "", r, r, r
+    );
+    edgex_strbuf_appendstr (b, buf);
+  }
+  edgex_strbuf_appendstr (b, "],\"commands\":[]}");
+}
+
+static char *make_list (unsigned n)
+{
+  edgex_strbuf b;
+  char buf[1024];
+
+  edgex_strbuf_init (&b);
+  edgex_strbuf_appendchar (&b, '[');
+  for (unsigned i = 0; i < n; i++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"id\":\"5c6f3ab1-0000-4000-8000-%012u\",\"name\":\"Device-%u\","
+      "\"description\":\"Generated device \\\"%u\\\"\",\"adminState\":"
+      "\"UNLOCKED\",\"operatingState\":\"ENABLED\",\"lastConnected\":0,"
+      "\"lastReported\":0,\"labels\":[\"bench\",\"floor-%u\"],"
+      "\"origin\":1550000000000,\"created\":1550000000000,"
+      "\"modified\":1550000001000,\"addressable\":{\"id\":\"a-%u\","
+      "\"name\":\"Address-%u\",\"protocol\":\"TCP\",\"address\":\"10.0.%u.%u\","
+      "\"port\":502,\"path\":\"\",\"created\":0,\"modified\":0,\"origin\":0},"
+      "\"service\":{\"id\":\"s-1\",\"name\":\"device-bench\","
+      "\"adminState\":\"UNLOCKED\",\"operatingState\":\"ENABLED\","
+      "\"labels\":[],\"addressable\":{\"name\":\"device-bench\","
+      "\"protocol\":\"HTTP\",\"address\":\"localhost\",\"port\":49999}},"
+      "\"profile\":",
+      i ? "," : "", i, i, i, i % 10, i, i, (i >> 8) & 0xff, i & 0xff
+    );
+    edgex_strbuf_appendstr (&b, buf);
+    add_profile (&b, i % PROFILES);
+    edgex_strbuf_appendchar (&b, '}');
+  }
+  edgex_strbuf_appendchar (&b, ']');
+  return b.data;
+}
+
+static edgex_device *read_parson (const char *json)
+{
+  JSON_Value *val = json_parse_string (json);
+  edgex_device *result = edgex_devices_read_value (NULL, val);
+  json_value_free (val);
+  return result;
+}
+
+static bool same (edgex_device *a, edgex_device *b)
+{
+  for (; a && b; a = a->next, b = b->next)
+  {
+    char *ja = edgex_device_write (a, false);
+    char *jb = edgex_device_write (b, false);
+    bool eq = strcmp (ja, jb) == 0;
+    json_free_serialized_string (ja);
+    json_free_serialized_string (jb);
+    if (!eq)
+    {
+      return false;
+    }
+  }
+  return a == NULL && b == NULL;
+}
+
+static void bench (unsigned n)
+{
+  char *json = make_list (n);
+  double tparson = 0.0;
+  double tpull = 0.0;
+  double t;
+
+  printf ("\n%u devices, %zu bytes\n", n, strlen (json));
+  for (unsigned run = 0; run < RUNS; run++)
+  {
+    t = now ();
+    edgex_device *a = read_parson (json);
+    tparson += now () - t;
+
+    t = now ();
+    edgex_device *b = edgex_devices_read (NULL, json);
+    tpull += now () - t;
+
+    if (run == 0 && !same (a, b))
+    {
+      printf ("MISMATCH between parson and pull readers\n");
+    }
+    edgex_device_free (a);
+    edgex_device_free (b);
+  }
+  printf ("%-8s %10.2f ms\n", "parson", tparson * 1e3 / RUNS);
+  printf ("%-8s %10.2f ms\n", "pull", tpull * 1e3 / RUNS);
+  free (json);
+}
+
+int main (void)
+{
+  bench (1000);
+  bench (10000);
+  return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * Compare edgex_map with the chained implementation it replaced, using
+ * UUID-style keys as for device ids.
+ */
+
+#include "../map.h"
+#include "chainmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEYLEN 37
+#define LOOKUPS 1000000
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static uint64_t rnd (void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void makekey (char *buf)
+{
+  uint64_t a = rnd ();
+  uint64_t b = rnd ();
+  sprintf
+  (
+    buf, "%08x-%04x-%04x-%04x-%012llx",
+    (unsigned) (a >> 32), (unsigned) (a >> 16) & 0xffff, (unsigned) a & 0xffff,
+    (unsigned) (b >> 48), (unsigned long long) b & 0xffffffffffffULL
+  );
+}
+
+static void report (const char *impl, const char *op, double secs, unsigned n)
+{
+  printf ("%-8s %-10s %8.1f ns/op\n", impl, op, secs * 1e9 / n);
+}
+
+static void bench (unsigned n)
+{
+  char *keys = malloc ((size_t) n * KEYLEN);
+  char *misses = malloc ((size_t) n * KEYLEN);
+  unsigned *order = malloc (LOOKUPS * sizeof (unsigned));
+  volatile uintptr_t sink = 0;
+  double t;
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    makekey (keys + (size_t) i * KEYLEN);
+    makekey (misses + (size_t) i * KEYLEN);
+  }
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    order[i] = rnd () % n;
+  }
+
+  printf ("\n%u entries\n", n);
+
+  edgex_map_void om;
+  edgex_map_init (&om);
+  t = now ();
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_map_set (&om, keys + (size_t) i * KEYLEN, keys);
+  }
+  report ("edgex", "insert", now () - t, n);
+
+  t = now ();
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    sink += (uintptr_t) edgex_map_get (&om, keys + (size_t) order[i] * KEYLEN);
+  }
+  report ("edgex", "hit", now () - t, LOOKUPS);
+
+  t = now ();
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    sink += (uintptr_t) edgex_map_get (&om, misses + (size_t) order[i] * KEYLEN);
+  }
+  report ("edgex", "miss", now () - t, LOOKUPS);
+
+  uint32_t *hashes = malloc (LOOKUPS * sizeof (uint32_t));
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    hashes[i] = edgex_map_hash (keys + (size_t) order[i] * KEYLEN);
+  }
+  t = now ();
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    sink += (uintptr_t) edgex_map_get_hashed
+      (&om, keys + (size_t) order[i] * KEYLEN, hashes[i]);
+  }
+  report ("edgex", "prehashed", now () - t, LOOKUPS);
+  free (hashes);
+
+  const char *key;
+  edgex_map_iter oi = edgex_map_iter (om);
+  t = now ();
+  while ((key = edgex_map_next (&om, &oi)))
+  {
+    sink += (uintptr_t) key;
+  }
+  report ("edgex", "iterate", now () - t, n);
+
+  t = now ();
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_map_remove (&om, keys + (size_t) i * KEYLEN);
+  }
+  report ("edgex", "remove", now () - t, n);
+  edgex_map_deinit (&om);
+
+  edgex_map_init (&om);
+  t = now ();
+  edgex_map_reserve (&om, n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_map_set (&om, keys + (size_t) i * KEYLEN, keys);
+  }
+  report ("edgex", "reserved", now () - t, n);
+  edgex_map_deinit (&om);
+
+  chain_map_void cm;
+  memset (&cm, 0, sizeof (cm));
+  t = now ();
+  for (unsigned i = 0; i < n; i++)
+  {
+    chain_map_set (&cm, keys + (size_t) i * KEYLEN, keys);
+  }
+  report ("chained", "insert", now () - t, n);
+
+  t = now ();
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    sink += (uintptr_t) chain_map_get (&cm, keys + (size_t) order[i] * KEYLEN);
+  }
+  report ("chained", "hit", now () - t, LOOKUPS);
+
+  t = now ();
+  for (unsigned i = 0; i < LOOKUPS; i++)
+  {
+    sink += (uintptr_t) chain_map_get (&cm, misses + (size_t) order[i] * KEYLEN);
+  }
+  report ("chained", "miss", now () - t, LOOKUPS);
+
+  chain_map_iter ci = chain_map_iter (cm);
+  t = now ();
+  while ((key = chain_map_next (&cm, &ci)))
+  {
+    sink += (uintptr_t) key;
+  }
+  report ("chained", "iterate", now () - t, n);
+
+  t = now ();
+  for (unsigned i = 0; i < n; i++)
+  {
+    chain_map_remove (&cm, keys + (size_t) i * KEYLEN);
+  }
+  report ("chained", "remove", now () - t, n);
+  chain_map_deinit (&cm);
+
+  free (order);
+  free (misses);
+  free (keys);
+}
+
+int main (void)
+{
+  bench (10000);
+  bench (100000);
+  return 0;
+}
@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * Microbenchmarks for the primitives which account for most of the time in
+ * command handling: map lookups, value transforms and formatting, event
+ * generation and serialization, base64, URL dispatch and device copies. Each
+ * is timed over many iterations, reporting time, cycles and allocations per
+ * operation. Cycles are taken from the timestamp counter where there is one.
+ * Allocations are counted by wrapping the C library's malloc, calloc and
+ * realloc.
+ */
+
+#include "../map.h"
+#include "../data.h"
+#include "../device.h"
+#include "../transform.h"
+#include "../base64.h"
+#include "../router.h"
+#include "../edgex_rest.h"
+#include "../strbuf.h"
+#include "../parson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define DEFAULT_ITERS 1000000
+#define KEYLEN 37
+#define RESOURCES 10
+
+static unsigned iters = DEFAULT_ITERS;
+
+/* Allocation counting */
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static uint64_t allocs;
+
+void *malloc (size_t size)
+{
+  __atomic_add_fetch (&allocs, 1, __ATOMIC_RELAXED);
+  return __libc_malloc (size);
+}
+
+void *calloc (size_t n, size_t size)
+{
+  __atomic_add_fetch (&allocs, 1, __ATOMIC_RELAXED);
+  return __libc_calloc (n, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+  __atomic_add_fetch (&allocs, 1, __ATOMIC_RELAXED);
+  return __libc_realloc (ptr, size);
+}
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles (void)
+{
+#ifdef HAVE_TSC
+  return __rdtsc ();
+#else
+  return 0;
+#endif
+}
+
+/* Run fn n times after a warmup, and report the cost of each call */
+
+typedef void (*bench_fn) (void *arg, unsigned i);
+
+static void run (const char *name, bench_fn fn, void *arg, unsigned n)
+{
+  for (unsigned i = 0; i < n / 10; i++)
+  {
+    fn (arg, i);
+  }
+  uint64_t a = __atomic_load_n (&allocs, __ATOMIC_RELAXED);
+  double t = now ();
+  uint64_t c = cycles ();
+  for (unsigned i = 0; i < n; i++)
+  {
+    fn (arg, i);
+  }
+  c = cycles () - c;
+  t = now () - t;
+  a = __atomic_load_n (&allocs, __ATOMIC_RELAXED) - a;
+  printf
+  (
+    "%-28s %9.1f ns/op %9.1f cycles/op %7.2f allocs/op\n",
+    name, t * 1e9 / n, (double) c / n, (double) a / n
+  );
+}
+
+/* edgex_map with UUID-style keys */
+
+typedef struct map_bench
+{
+  edgex_map_int map;
+  char *keys;
+  unsigned n;
+} map_bench;
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static uint64_t rnd (void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+static void makekey (char *buf)
+{
+  uint64_t a = rnd ();
+  uint64_t b = rnd ();
+  sprintf
+  (
+    buf, "%08x-%04x-%04x-%04x-%012llx",
+    (unsigned) (a >> 32), (unsigned) (a >> 16) & 0xffff, (unsigned) a & 0xffff,
+    (unsigned) (b >> 48), (unsigned long long) b & 0xffffffffffffULL
+  );
+}
+
+static void map_get (void *arg, unsigned i)
+{
+  map_bench *m = (map_bench *) arg;
+  volatile int *v = edgex_map_get (&m->map, m->keys + (i % m->n) * KEYLEN);
+  (void) v;
+}
+
+static void map_set (void *arg, unsigned i)
+{
+  map_bench *m = (map_bench *) arg;
+  edgex_map_set (&m->map, m->keys + (i % m->n) * KEYLEN, i);
+}
+
+static void bench_map (unsigned n)
+{
+  char name[64];
+  map_bench m;
+
+  m.n = n;
+  m.keys = malloc ((size_t) n * KEYLEN);
+  edgex_map_init (&m.map);
+  for (unsigned i = 0; i < n; i++)
+  {
+    makekey (m.keys + (size_t) i * KEYLEN);
+    edgex_map_set (&m.map, m.keys + (size_t) i * KEYLEN, i);
+  }
+  sprintf (name, "map_get (%u)", n);
+  run (name, map_get, &m, iters);
+  sprintf (name, "map_set (%u)", n);
+  run (name, map_set, &m, iters);
+  edgex_map_deinit (&m.map);
+  free (m.keys);
+}
+
+/*
+ * A device whose resources alternate between Float32 with scale and offset,
+ * and Int32 with mask and shift. Readings are made for all of its resources.
+ */
+
+typedef struct event_bench
+{
+  edgex_device *dev;
+  edgex_device_commandrequest reqs[RESOURCES];
+  edgex_device_commandresult results[RESOURCES];
+  uint32_t nchanged;
+  edgex_strbuf buf;
+  JSON_Value *event;
+} event_bench;
+
+static char *make_device (void)
+{
+  edgex_strbuf b;
+  char buf[512];
+
+  edgex_strbuf_init (&b);
+  edgex_strbuf_appendstr
+  (
+    &b,
+    "[{\"id\":\"5c6f3ab1-0000-4000-8000-000000000001\",\"name\":\"Device-1\","
+    "\"description\":\"Generated device\",\"adminState\":\"UNLOCKED\","
+    "\"operatingState\":\"ENABLED\",\"labels\":[\"bench\"],"
+    "\"addressable\":{\"id\":\"a-1\",\"name\":\"Address-1\","
+    "\"protocol\":\"TCP\",\"address\":\"10.0.0.1\",\"port\":502,"
+    "\"path\":\"\"},\"service\":{\"id\":\"s-1\",\"name\":\"device-bench\","
+    "\"adminState\":\"UNLOCKED\",\"operatingState\":\"ENABLED\","
+    "\"addressable\":{\"name\":\"device-bench\",\"protocol\":\"HTTP\","
+    "\"address\":\"localhost\",\"port\":49999}},\"profile\":{"
+    "\"id\":\"7d1a4ac8-0000-4000-8000-000000000001\",\"name\":\"Profile-1\","
+    "\"manufacturer\":\"IoTech\",\"model\":\"Model-1\",\"labels\":[],"
+    "\"deviceResources\":["
+  );
+  for (unsigned r = 0; r < RESOURCES; r++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"name\":\"Resource%u\",\"description\":\"Reading %u\","
+      "\"properties\":{\"value\":{%s},\"units\":{\"type\":\"String\","
+      "\"readWrite\":\"R\",\"defaultValue\":\"degC\"}},"
+      "\"attributes\":{\"register\":\"%u\"}}",
+      r ? "," : "", r, r,
+      (r % 2) ?
+        "\"type\":\"Int32\",\"readWrite\":\"R\",\"mask\":\"4095\","
+        "\"shift\":\"-2\"" :
+        "\"type\":\"Float32\",\"readWrite\":\"R\",\"scale\":\"0.5\","
+        "\"offset\":\"10\"",
+      40000 + r
+    );
+    edgex_strbuf_appendstr (&b, buf);
+  }
+  edgex_strbuf_appendstr (&b, "],\"resources\":[");
+  for (unsigned r = 0; r < RESOURCES; r++)
+  {
+    sprintf
+    (
+      buf,
+      "%s{\"name\":\"Resource%u\",\"get\":[{\"index\":\"1\","
+      "\"operation\":\"get\",\"object\":\"Resource%u\","
+      "\"parameter\":\"Resource%u\"}],\"set\":[]}",
+      r ? "," : "", r, r, r
+    );
+    edgex_strbuf_appendstr (&b, buf);
+  }
+  edgex_strbuf_appendstr (&b, "],\"commands\":[]}}]");
+  return b.data;
+}
+
+static bool event_setup (event_bench *e)
+{
+  char *json = make_device ();
+  e->dev = edgex_devices_read (NULL, json);
+  free (json);
+  if (e->dev == NULL)
+  {
+    return false;
+  }
+
+  edgex_deviceresource *dr = e->dev->profile->device_resources;
+  edgex_profileresource *pr = e->dev->profile->resources;
+  for (unsigned r = 0; r < RESOURCES && dr && pr; r++)
+  {
+    e->reqs[r].devobj = dr;
+    e->reqs[r].ro = pr->get;
+    e->results[r].origin = 0;
+    e->results[r].type = dr->properties->value->type;
+    if (e->results[r].type == Float32)
+    {
+      e->results[r].value.f32_result = 20.5f + r;
+    }
+    else
+    {
+      e->results[r].value.i32_result = 0x1234 + r;
+    }
+    dr = dr->next;
+    pr = pr->next;
+  }
+  edgex_strbuf_init (&e->buf);
+  edgex_data_write_event
+  (
+    &e->buf, NULL, NULL, NULL, NULL, NULL, e->dev->name, RESOURCES,
+    e->reqs, e->results, true, &e->nchanged
+  );
+  e->event = json_parse_string (e->buf.data);
+  return e->event != NULL;
+}
+
+static void event_free (event_bench *e)
+{
+  json_value_free (e->event);
+  edgex_strbuf_fini (&e->buf);
+  edgex_device_free (e->dev);
+}
+
+static void transform_float (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  edgex_device_resultvalue v = e->results[0].value;
+  edgex_transform_value (&v, e->reqs[0].devobj->properties->value);
+}
+
+static void transform_int (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  edgex_device_resultvalue v = e->results[1].value;
+  edgex_transform_value (&v, e->reqs[1].devobj->properties->value);
+}
+
+static void kernel_float (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  edgex_device_resultvalue v = e->results[0].value;
+  const edgex_propertyvalue *pv = e->reqs[0].devobj->properties->value;
+  edgex_transform_kernels[pv->xform] (&v, pv);
+}
+
+static void kernel_int (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  edgex_device_resultvalue v = e->results[1].value;
+  const edgex_propertyvalue *pv = e->reqs[1].devobj->properties->value;
+  edgex_transform_kernels[pv->xform] (&v, pv);
+}
+
+static void transform_batch (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  edgex_device_resultvalue v[RESOURCES];
+  bool ok[RESOURCES];
+  for (unsigned r = 0; r < RESOURCES; r++)
+  {
+    v[r] = e->results[r].value;
+  }
+  edgex_transform_batch (RESOURCES, e->reqs, v, ok);
+}
+
+static void tostring_float (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  free
+  (
+    edgex_value_tostring
+      (e->results[0].value, true, e->reqs[0].devobj->properties->value, NULL)
+  );
+}
+
+static void tostring_int (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  free
+  (
+    edgex_value_tostring
+      (e->results[1].value, true, e->reqs[1].devobj->properties->value, NULL)
+  );
+}
+
+static void write_event (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  e->buf.len = 0;
+  edgex_data_write_event
+  (
+    &e->buf, NULL, NULL, NULL, NULL, NULL, e->dev->name, RESOURCES,
+    e->reqs, e->results, true, &e->nchanged
+  );
+}
+
+static void serialize_event (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  json_free_serialized_string (json_serialize_to_string (e->event));
+}
+
+static void device_dup (void *arg, unsigned i)
+{
+  event_bench *e = (event_bench *) arg;
+  edgex_device_free (edgex_device_dup (e->dev));
+}
+
+static void bench_events (void)
+{
+  event_bench e;
+  if (!event_setup (&e))
+  {
+    printf ("Unable to set up event benchmarks\n");
+    return;
+  }
+  run ("transform_value (float)", transform_float, &e, iters);
+  run ("transform_value (int)", transform_int, &e, iters);
+  run ("transform_kernel (float)", kernel_float, &e, iters);
+  run ("transform_kernel (int)", kernel_int, &e, iters);
+  run ("transform_batch (10)", transform_batch, &e, iters / 10);
+  run ("value_tostring (float)", tostring_float, &e, iters);
+  run ("value_tostring (int)", tostring_int, &e, iters);
+  run ("data_write_event (10)", write_event, &e, iters / 10);
+  run ("json_serialize (event)", serialize_event, &e, iters / 10);
+  run ("device_dup", device_dup, &e, iters / 100);
+  event_free (&e);
+}
+
+/* base64 of a typical Binary reading */
+
+typedef struct b64_bench
+{
+  unsigned char in[256];
+  char out[400];
+} b64_bench;
+
+static void b64_encode (void *arg, unsigned i)
+{
+  b64_bench *b = (b64_bench *) arg;
+  edgex_b64_encode (b->in, sizeof (b->in), b->out, sizeof (b->out));
+}
+
+static void bench_b64 (void)
+{
+  b64_bench b;
+  for (unsigned i = 0; i < sizeof (b.in); i++)
+  {
+    b.in[i] = (unsigned char) rnd ();
+  }
+  run ("b64_encode (256)", b64_encode, &b, iters);
+}
+
+/* URL dispatch, with the routes registered by a device service */
+
+static const char *routes[] =
+{
+  "/api/v1/ping", "/api/v1/trace", "/api/v1/discovery",
+  "/api/v1/device/{id}/{command}", "/api/v1/device/name/{name}/{command}",
+  "/api/v1/device/all/{command}", "/api/v1/callback", "/api/v1/config",
+  "/api/v1/metrics", "/api/version"
+};
+
+static void route (void *arg, unsigned i)
+{
+  char path[] = "/api/v1/device/name/Device-1/Resource3";
+  edgex_http_params params;
+  volatile void *h = edgex_router_find ((edgex_router *) arg, path, &params);
+  (void) h;
+}
+
+static void bench_router (void)
+{
+  edgex_router *r = edgex_router_create ();
+  for (unsigned i = 0; i < sizeof (routes) / sizeof (routes[0]); i++)
+  {
+    edgex_router_add (r, routes[i], (void *) routes[i]);
+  }
+  run ("router_find", route, r, iters);
+  edgex_router_free (r);
+}
+
+int main (int argc, char *argv[])
+{
+  if (argc > 1)
+  {
+    iters = strtoul (argv[1], NULL, 10);
+    if (iters < 100)
+    {
+      printf ("Usage: %s [iterations]\n", argv[0]);
+      return 1;
+    }
+  }
+#ifndef HAVE_TSC
+  printf ("No timestamp counter: cycles are not measured\n");
+#endif
+  bench_map (16);
+  bench_map (1024);
+  bench_map (65536);
+  bench_events ();
+  bench_b64 ();
+  bench_router ();
+  return 0;
+}
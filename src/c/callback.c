@@ -16,20 +16,321 @@
 
 #include <microhttpd.h>
 
+/*
+ * Device notifications from metadata are queued by id, so that a burst of
+ * them for the same device is handled once. A task takes all the pending
+ * notifications, fetches the devices concurrently, and applies the changes to
+ * the registry in one update.
+ */
+
+#define FETCH_TASKS 8
+
+typedef edgex_map(edgex_http_method) edgex_map_method;
+
+struct edgex_device_updates
+{
+  edgex_device_service *svc;
+  pthread_mutex_t lock;
+  edgex_map_method pending;
+  bool scheduled;
+};
+
+typedef struct device_update
+{
+  const char *id;
+  edgex_http_method method;
+  uint64_t modified;
+  edgex_device *dev;
+  edgex_deviceprofile *newer;
+  edgex_error err;
+} device_update;
+
+typedef struct device_updates
+{
+  edgex_device_service *svc;
+  device_update *updates;
+} device_updates;
+
+edgex_device_updates *edgex_device_updates_create (edgex_device_service *svc)
+{
+  edgex_device_updates *u = calloc (1, sizeof (edgex_device_updates));
+  u->svc = svc;
+  pthread_mutex_init (&u->lock, NULL);
+  edgex_map_init (&u->pending);
+  return u;
+}
+
+void edgex_device_updates_free (edgex_device_updates *u)
+{
+  if (u)
+  {
+    edgex_map_deinit (&u->pending);
+    pthread_mutex_destroy (&u->lock);
+    free (u);
+  }
+}
+
+static void update_fetch (void *arg, unsigned i)
+{
+  device_updates *all = (device_updates *) arg;
+  device_update *u = &all->updates[i];
+  edgex_device_service *svc = all->svc;
+
+  bool unchanged;
+
+  /*
+   * For an update to a device already held, metadata need not send it again
+   * if it has not been modified since our copy.
+   */
+
+  u->err = EDGEX_OK;
+  u->dev = edgex_metadata_client_get_device_since
+  (
+    svc->logger, &svc->config.endpoints, u->id, u->modified, &unchanged,
+    &u->err
+  );
+  if (unchanged)
+  {
+    iot_log_debug (svc->logger, "callback: Device %s is unchanged", u->id);
+  }
+  else if (u->dev == NULL)
+  {
+    iot_log_error
+      (svc->logger, "callback: Unable to retrieve device %s", u->id);
+  }
+}
+
+/*
+ * Give a device fetched from metadata its profile. The shared profile is
+ * used if it is the same version; otherwise the version supplied with the
+ * device replaces it, and is returned so that the other devices using the
+ * profile may be moved to it.
+ */
+
+static bool update_profile
+  (edgex_device_service *svc, edgex_device *dev, edgex_deviceprofile **newer)
+{
+  edgex_deviceprofile *profile = NULL;
+  edgex_error err = EDGEX_OK;
+  bool cached;
+
+  pthread_mutex_lock (&svc->profileslock);
+  edgex_deviceprofile **dpp =
+    edgex_map_get (&svc->profiles, dev->profile->name);
+  cached = (dpp != NULL);
+  if (cached)
+  {
+    if
+    (
+      (*dpp)->modified != dev->profile->modified &&
+      dev->profile->device_resources
+    )
+    {
+      iot_log_info
+      (
+        svc->logger, "callback: Device profile %s updated", dev->profile->name
+      );
+      edgex_deviceprofile_free (*dpp);
+      *dpp = edgex_deviceprofile_ref (dev->profile);
+      *newer = edgex_deviceprofile_ref (dev->profile);
+    }
+    else
+    {
+      profile = edgex_deviceprofile_ref (*dpp);
+    }
+  }
+  pthread_mutex_unlock (&svc->profileslock);
+
+  if (!cached)
+  {
+    profile = edgex_deviceprofile_get (svc, dev->profile->name, &err);
+    if (profile == NULL)
+    {
+      iot_log_error
+      (
+        svc->logger,
+        "callback: No device profile %s found, device %s unavailable",
+        dev->profile->name,
+        dev->name
+      );
+      return false;
+    }
+  }
+  if (profile)
+  {
+    edgex_deviceprofile_free (dev->profile);
+    dev->profile = profile;
+  }
+  return true;
+}
+
+static void updates_apply (edgex_device_service *svc, edgex_map_method *batch)
+{
+  const char *id;
+  edgex_map_iter iter;
+  device_update *updates;
+  device_updates all;
+  unsigned n;
+  unsigned nfetch = 0;
+
+  updates = calloc (edgex_map_count (batch) + 1, sizeof (device_update));
+
+  /* Devices added by this service are registered as they are created, and
+   * deletions need nothing from metadata. Those to be fetched go first.
+   */
+
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  iter = edgex_map_iter (*batch);
+  while ((id = edgex_map_next (batch, &iter)))
+  {
+    edgex_http_method method = *edgex_map_get (batch, id);
+    if (method == POST && edgex_devmap_find (devices, id))
+    {
+      iot_log_debug (svc->logger, "callback: Device %s already present", id);
+    }
+    else if (method != DELETE)
+    {
+      const edgex_device *held =
+        (method == PUT) ? edgex_devmap_find (devices, id) : NULL;
+      updates[nfetch].id = id;
+      updates[nfetch].modified = held ? held->modified : 0;
+      updates[nfetch++].method = method;
+    }
+  }
+  edgex_devreg_release (svc->devices);
+  n = nfetch;
+  iter = edgex_map_iter (*batch);
+  while ((id = edgex_map_next (batch, &iter)))
+  {
+    if (*edgex_map_get (batch, id) == DELETE)
+    {
+      updates[n].id = id;
+      updates[n++].method = DELETE;
+    }
+  }
+
+  all.svc = svc;
+  all.updates = updates;
+  edgex_executor_forall
+  (
+    svc->executor, EDGEX_EXEC_COMMAND, nfetch, FETCH_TASKS, update_fetch, &all
+  );
+  for (unsigned i = 0; i < nfetch; i++)
+  {
+    if
+    (
+      updates[i].dev &&
+      !update_profile (svc, updates[i].dev, &updates[i].newer)
+    )
+    {
+      edgex_device_free (updates[i].dev);
+      updates[i].dev = NULL;
+    }
+  }
+
+  edgex_devmap *update = edgex_devreg_begin (svc->devices);
+  for (unsigned i = 0; i < n; i++)
+  {
+    device_update *u = &updates[i];
+    if (u->method != DELETE && u->dev == NULL)
+    {
+      continue;
+    }
+    edgex_device *ourdev = edgex_devmap_find (update, u->id);
+    if (ourdev)
+    {
+      iot_log_info
+      (
+        svc->logger, "callback: %s device %s",
+        u->method == DELETE ? "Delete" : "Update", ourdev->name
+      );
+      edgex_lvcache_forget (svc->lvcache, ourdev->name);
+      edgex_aggregator_forget (svc->aggregator, ourdev->name);
+      edgex_history_forget (svc->history, ourdev->name);
+      edgex_readcache_forget (svc->readcache, ourdev->name);
+      edgex_devmap_remove (update, ourdev);
+    }
+    else if (u->method == DELETE)
+    {
+      iot_log_error
+      (
+        svc->logger, "callback: DELETE request for unknown device %s", u->id
+      );
+    }
+    else
+    {
+      iot_log_info (svc->logger, "callback: New device %s", u->dev->name);
+    }
+    if (u->dev)
+    {
+      edgex_devmap_add (update, u->dev);
+    }
+  }
+  for (unsigned i = 0; i < nfetch; i++)
+  {
+    if (updates[i].newer)
+    {
+      edgex_deviceprofile_move_users (update, updates[i].newer);
+      edgex_deviceprofile_free (updates[i].newer);
+    }
+  }
+  edgex_devreg_commit (svc->devices, update);
+  free (updates);
+}
+
+static void updates_task (void *arg)
+{
+  edgex_device_updates *u = (edgex_device_updates *) arg;
+  edgex_map_method batch;
+
+  pthread_mutex_lock (&u->lock);
+  while (edgex_map_count (&u->pending))
+  {
+    batch = u->pending;
+    edgex_map_init (&u->pending);
+    pthread_mutex_unlock (&u->lock);
+
+    updates_apply (u->svc, &batch);
+    edgex_map_deinit (&batch);
+
+    pthread_mutex_lock (&u->lock);
+  }
+  u->scheduled = false;
+  pthread_mutex_unlock (&u->lock);
+}
+
+/*
+ * Combine a notification with one pending for the same device. A device
+ * deleted and created again, or created and then updated, is fetched.
+ */
+
+static edgex_http_method updates_merge
+  (const edgex_http_method *prev, edgex_http_method method)
+{
+  if (prev == NULL || method == DELETE)
+  {
+    return method;
+  }
+  if (*prev == POST && method == POST)
+  {
+    return POST;
+  }
+  return PUT;
+}
+
 int edgex_device_handler_callback
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
-  edgex_error err = EDGEX_OK;
   int status = MHD_HTTP_OK;
   edgex_device_service *svc = (edgex_device_service *) ctx;
+  edgex_device_updates *u = svc->updates;
 
   JSON_Value *jval = json_parse_string (upload_data);
   if (jval == NULL)
@@ -40,137 +341,27 @@ int edgex_device_handler_callback
   JSON_Object *jobj = json_value_get_object (jval);
 
   const char *action = json_object_get_string (jobj, "type");
+  const char *id = json_object_get_string (jobj, "id");
   if (action && strcmp (action, "DEVICE") == 0)
   {
-    const char *id = json_object_get_string (jobj, "id");
-    pthread_rwlock_rdlock (&svc->deviceslock);
-    edgex_device **ourdev = edgex_map_get (&svc->devices, id);
-    pthread_rwlock_unlock (&svc->deviceslock);
-    edgex_device *newdev = edgex_metadata_client_get_device
-      (svc->logger, &svc->config.endpoints, id, &err);
-    if (newdev)
+    if (id)
     {
-      if (ourdev)
-      {
-        if (method == PUT)
-        {
-          iot_log_info
-            (svc->logger, "callback: Update device %s", newdev->name);
-          edgex_deviceprofile *profile = edgex_deviceprofile_get
-            (svc, newdev->profile->name, &err);
-          if (profile)
-          {
-            edgex_deviceprofile_free (newdev->profile);
-            newdev->profile = profile;
-          }
-          pthread_rwlock_wrlock (&svc->deviceslock);
-          edgex_map_remove (&svc->name_to_id, (*ourdev)->name);
-          edgex_map_remove (&svc->devices, id);
-          edgex_map_set (&svc->devices, newdev->id, newdev);
-          edgex_map_set (&svc->name_to_id, newdev->name, newdev->id);
-          pthread_rwlock_unlock (&svc->deviceslock);
-          edgex_device_free (*ourdev);
-          if (!profile)
-          {
-            status = MHD_HTTP_NOT_FOUND;
-            iot_log_error
-            (
-              svc->logger,
-              "callback: No device profile %s found, device %s unavailable",
-              newdev->profile->name,
-              newdev->name
-            );
-            edgex_device_free (newdev);
-          }
-        }
-        else
-        {
-          status = MHD_HTTP_BAD_REQUEST;
-          iot_log_error
-          (
-            svc->logger,
-            "callback: Ignoring non-PUT request for existing device %s",
-            newdev->name
-          );
-        }
-        edgex_device_free (newdev);
-      }
-      else
+      pthread_mutex_lock (&u->lock);
+      edgex_http_method merged =
+        updates_merge (edgex_map_get (&u->pending, id), method);
+      edgex_map_set (&u->pending, id, merged);
+      if (!u->scheduled)
       {
-        if (method == POST)
-        {
-          iot_log_info (svc->logger, "callback: New device %s", newdev->name);
-          edgex_deviceprofile *profile = edgex_deviceprofile_get
-            (svc, newdev->profile->name, &err);
-          if (profile)
-          {
-            edgex_deviceprofile_free (newdev->profile);
-            newdev->profile = profile;
-            pthread_rwlock_wrlock (&svc->deviceslock);
-            edgex_map_set (&svc->devices, newdev->id, newdev);
-            edgex_map_set (&svc->name_to_id, newdev->name, newdev->id);
-            pthread_rwlock_unlock (&svc->deviceslock);
-          }
-          else
-          {
-            status = MHD_HTTP_NOT_FOUND;
-            iot_log_error
-            (
-              svc->logger,
-              "callback: No device profile %s found, device %s unavailable",
-              newdev->profile->name,
-              newdev->name
-            );
-            edgex_device_free (newdev);
-          }
-        }
-        else
-        {
-          status = MHD_HTTP_BAD_REQUEST;
-          iot_log_error
-          (
-            svc->logger,
-            "callback: Ignoring non-POST request for new device %s",
-            newdev->name
-          );
-        }
+        u->scheduled = true;
+        edgex_executor_submit
+          (svc->executor, EDGEX_EXEC_COMMAND, updates_task, u);
       }
+      pthread_mutex_unlock (&u->lock);
     }
     else
     {
-      if (method == DELETE)
-      {
-        if (ourdev)
-        {
-          iot_log_info
-            (svc->logger, "callback: Delete device %s", (*ourdev)->name);
-          pthread_rwlock_wrlock (&svc->deviceslock);
-          edgex_map_remove (&svc->name_to_id, (*ourdev)->name);
-          edgex_map_remove (&svc->devices, id);
-          pthread_rwlock_unlock (&svc->deviceslock);
-          edgex_device_free (*ourdev);
-        }
-        else
-        {
-          status = MHD_HTTP_NOT_FOUND;
-          iot_log_error
-          (
-            svc->logger,
-            "callback: DELETE request for unknown device %s",
-            id
-          );
-        }
-      }
-      else
-      {
-        status = MHD_HTTP_BAD_REQUEST;;
-        iot_log_error
-        (
-          svc->logger,
-          "callback: Ignoring non-DELETE request for missing device %s",
-          ourdev ? (*ourdev)->name : id
-        );
-      }
+      status = MHD_HTTP_BAD_REQUEST;
+      iot_log_error (svc->logger, "callback: No device id specified");
     }
   }
   else
@@ -9,17 +9,26 @@
 #ifndef _EDGEX_DEVICE_CALLBACK_H_
 #define _EDGEX_DEVICE_CALLBACK_H_ 1
 
+#include "edgex/devsdk.h"
 #include "rest_server.h"
 
+typedef struct edgex_device_updates edgex_device_updates;
+
+/* Create the queue of device notifications from metadata */
+
+extern edgex_device_updates *edgex_device_updates_create
+  (edgex_device_service *svc);
+
+extern void edgex_device_updates_free (edgex_device_updates *u);
+
 extern int edgex_device_handler_callback
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 );
 
 #endif
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "cbor.h"
+
+#include <string.h>
+
+#define CBOR_UINT 0
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xff
+
+/* Write the head of an item: its major type and argument, big-endian */
+
+static void cbor_head (edgex_strbuf *b, unsigned major, uint64_t val)
+{
+  uint8_t head[9];
+  unsigned n;
+
+  if (val < 24)
+  {
+    head[0] = (major << 5) | val;
+    n = 0;
+  }
+  else if (val <= UINT8_MAX)
+  {
+    head[0] = (major << 5) | 24;
+    n = 1;
+  }
+  else if (val <= UINT16_MAX)
+  {
+    head[0] = (major << 5) | 25;
+    n = 2;
+  }
+  else if (val <= UINT32_MAX)
+  {
+    head[0] = (major << 5) | 26;
+    n = 4;
+  }
+  else
+  {
+    head[0] = (major << 5) | 27;
+    n = 8;
+  }
+  for (unsigned i = 0; i < n; i++)
+  {
+    head[n - i] = (val >> (8 * i)) & 0xff;
+  }
+  edgex_strbuf_append (b, (const char *) head, n + 1);
+}
+
+void edgex_cbor_uint (edgex_strbuf *b, uint64_t val)
+{
+  cbor_head (b, CBOR_UINT, val);
+}
+
+void edgex_cbor_text (edgex_strbuf *b, const char *s)
+{
+  size_t len = strlen (s);
+  cbor_head (b, CBOR_TEXT, len);
+  edgex_strbuf_append (b, s, len);
+}
+
+void edgex_cbor_bytes (edgex_strbuf *b, const uint8_t *bytes, size_t len)
+{
+  cbor_head (b, CBOR_BYTES, len);
+  edgex_strbuf_append (b, (const char *) bytes, len);
+}
+
+void edgex_cbor_map (edgex_strbuf *b, uint64_t n)
+{
+  cbor_head (b, CBOR_MAP, n);
+}
+
+void edgex_cbor_array_open (edgex_strbuf *b)
+{
+  edgex_strbuf_appendchar (b, (CBOR_ARRAY << 5) | CBOR_INDEFINITE);
+}
+
+void edgex_cbor_break (edgex_strbuf *b)
+{
+  edgex_strbuf_appendchar (b, (char) CBOR_BREAK);
+}
+
+static bool cbor_read_head
+  (edgex_cbor_reader *r, unsigned major, uint64_t *val)
+{
+  if (r->pos >= r->len || (r->data[r->pos] >> 5) != major)
+  {
+    return false;
+  }
+  unsigned info = r->data[r->pos] & 0x1f;
+  unsigned n;
+  if (info < 24)
+  {
+    *val = info;
+    r->pos++;
+    return true;
+  }
+  switch (info)
+  {
+    case 24: n = 1; break;
+    case 25: n = 2; break;
+    case 26: n = 4; break;
+    case 27: n = 8; break;
+    default: return false;
+  }
+  if (r->len - r->pos < n + 1)
+  {
+    return false;
+  }
+  *val = 0;
+  for (unsigned i = 1; i <= n; i++)
+  {
+    *val = (*val << 8) | r->data[r->pos + i];
+  }
+  r->pos += n + 1;
+  return true;
+}
+
+bool edgex_cbor_read_uint (edgex_cbor_reader *r, uint64_t *val)
+{
+  return cbor_read_head (r, CBOR_UINT, val);
+}
+
+bool edgex_cbor_read_text (edgex_cbor_reader *r, const char **s, size_t *len)
+{
+  uint64_t n;
+  size_t pos = r->pos;
+  if (!cbor_read_head (r, CBOR_TEXT, &n) || n > r->len - r->pos)
+  {
+    r->pos = pos;
+    return false;
+  }
+  *s = (const char *) r->data + r->pos;
+  *len = n;
+  r->pos += n;
+  return true;
+}
+
+bool edgex_cbor_read_map (edgex_cbor_reader *r, uint64_t *n)
+{
+  return cbor_read_head (r, CBOR_MAP, n);
+}
+
+bool edgex_cbor_read_array_open (edgex_cbor_reader *r)
+{
+  if (r->pos < r->len && r->data[r->pos] == ((CBOR_ARRAY << 5) | CBOR_INDEFINITE))
+  {
+    r->pos++;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CBOR_H_
+#define _EDGEX_DEVICE_CBOR_H_ 1
+
+#include "strbuf.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Encoding of the CBOR (RFC 7049) data items used for events */
+
+extern void edgex_cbor_uint (edgex_strbuf *b, uint64_t val);
+
+extern void edgex_cbor_text (edgex_strbuf *b, const char *s);
+
+extern void edgex_cbor_bytes (edgex_strbuf *b, const uint8_t *bytes, size_t len);
+
+/* Start a map of n pairs */
+
+extern void edgex_cbor_map (edgex_strbuf *b, uint64_t n);
+
+/* Start an array of unspecified length, which is ended by edgex_cbor_break */
+
+extern void edgex_cbor_array_open (edgex_strbuf *b);
+
+extern void edgex_cbor_break (edgex_strbuf *b);
+
+/*
+ * Decoding. A reader consumes data items from a buffer; each function
+ * returns false if the next item is not of the type expected or the data
+ * is truncated.
+ */
+
+typedef struct edgex_cbor_reader
+{
+  const uint8_t *data;
+  size_t len;
+  size_t pos;
+} edgex_cbor_reader;
+
+extern bool edgex_cbor_read_uint (edgex_cbor_reader *r, uint64_t *val);
+
+/* Text is returned by pointer into the buffer, and is not terminated */
+
+extern bool edgex_cbor_read_text
+  (edgex_cbor_reader *r, const char **s, size_t *len);
+
+extern bool edgex_cbor_read_map (edgex_cbor_reader *r, uint64_t *n);
+
+/* Read the start of an array of unspecified length */
+
+extern bool edgex_cbor_read_array_open (edgex_cbor_reader *r);
+
+#endif
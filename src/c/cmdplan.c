@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "cmdplan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct edgex_cmdplan_slot
+{
+  uint32_t hash;
+  const edgex_cmdplan_cmd *cmd;
+} edgex_cmdplan_slot;
+
+struct edgex_cmdplan
+{
+  uint32_t ncmds;
+  uint32_t mask;
+  edgex_cmdplan_cmd *cmds;
+  edgex_cmdplan_slot *slots;
+  edgex_device_commandrequest *reqs;
+  edgex_stats_calls *stats;
+};
+
+static uint32_t cmdplan_hash (const char *s)
+{
+  uint32_t h = 2166136261u;
+  while (*s)
+  {
+    h = (h ^ (unsigned char) *s++) * 16777619u;
+  }
+  return h;
+}
+
+static const edgex_deviceresource *findDevResource
+  (const edgex_deviceresource *list, const char *name)
+{
+  while (list && list->name != name && strcmp (list->name, name))
+  {
+    list = list->next;
+  }
+  return list;
+}
+
+static const edgex_profileresource *findProfileResource
+  (const edgex_profileresource *list, const char *name)
+{
+  while (list && list->name != name && strcmp (list->name, name))
+  {
+    list = list->next;
+  }
+  return list;
+}
+
+static uint32_t countOps (const edgex_resourceoperation *op)
+{
+  uint32_t n = 0;
+  for (; op; op = op->next)
+  {
+    n++;
+  }
+  return n;
+}
+
+static edgex_device_commandrequest *compileOp
+(
+  const edgex_deviceprofile *prof,
+  const edgex_resourceoperation *ops,
+  bool isget,
+  edgex_cmdplan_op *result,
+  edgex_device_commandrequest *reqs
+)
+{
+  result->found = true;
+  result->reqs = reqs;
+  for (const edgex_resourceoperation *op = ops; op; op = op->next)
+  {
+    const edgex_deviceresource *devobj =
+      findDevResource (prof->device_resources, op->object);
+    if (devobj == NULL)
+    {
+      if (result->missing == NULL)
+      {
+        result->missing = op->object;
+      }
+      continue;
+    }
+    if
+    (
+      result->denied == NULL &&
+      !(isget ? devobj->properties->value->readable :
+        devobj->properties->value->writable)
+    )
+    {
+      result->denied = devobj->name;
+    }
+    reqs[result->nreqs].ro = op;
+    reqs[result->nreqs].devobj = devobj;
+    result->nreqs++;
+  }
+  return reqs + result->nreqs;
+}
+
+static edgex_cmdplan *cmdplan_compile (const edgex_deviceprofile *prof)
+{
+  edgex_cmdplan *plan = calloc (1, sizeof (edgex_cmdplan));
+  const edgex_command *cmd;
+  uint32_t nslots = 4;
+  uint32_t nreqs = 0;
+
+  for (cmd = prof->commands; cmd; cmd = cmd->next)
+  {
+    const edgex_profileresource *res =
+      findProfileResource (prof->resources, cmd->name);
+    if (res)
+    {
+      nreqs += countOps (res->get) + countOps (res->set);
+    }
+    plan->ncmds++;
+  }
+
+  /* Keep the table at most half full */
+  while (nslots < plan->ncmds * 2)
+  {
+    nslots <<= 1;
+  }
+  plan->mask = nslots - 1;
+  plan->slots = calloc (nslots, sizeof (edgex_cmdplan_slot));
+  plan->cmds = calloc (plan->ncmds ? plan->ncmds : 1, sizeof (edgex_cmdplan_cmd));
+  plan->reqs = calloc (nreqs ? nreqs : 1, sizeof (edgex_device_commandrequest));
+  plan->stats = calloc (plan->ncmds * 2 + 1, sizeof (edgex_stats_calls));
+
+  edgex_device_commandrequest *next = plan->reqs;
+  edgex_cmdplan_cmd *c = plan->cmds;
+  for (cmd = prof->commands; cmd; cmd = cmd->next, c++)
+  {
+    const edgex_profileresource *res =
+      findProfileResource (prof->resources, cmd->name);
+    c->command = cmd;
+    c->get.stats = &plan->stats[(c - plan->cmds) * 2];
+    c->set.stats = &plan->stats[(c - plan->cmds) * 2 + 1];
+    if (res)
+    {
+      next = compileOp (prof, res->get, true, &c->get, next);
+      next = compileOp (prof, res->set, false, &c->set, next);
+    }
+
+    uint32_t h = cmdplan_hash (cmd->name);
+    uint32_t i = h & plan->mask;
+    while (plan->slots[i].cmd)
+    {
+      if
+      (
+        plan->slots[i].hash == h &&
+        (
+          plan->slots[i].cmd->command->name == cmd->name ||
+          strcmp (plan->slots[i].cmd->command->name, cmd->name) == 0
+        )
+      )
+      {
+        break;
+      }
+      i = (i + 1) & plan->mask;
+    }
+
+    /* As with a list search, the first of any duplicate names is used */
+    if (plan->slots[i].cmd == NULL)
+    {
+      plan->slots[i].hash = h;
+      plan->slots[i].cmd = c;
+    }
+  }
+  return plan;
+}
+
+const edgex_cmdplan *edgex_cmdplan_get (edgex_deviceprofile *prof)
+{
+  edgex_cmdplan *plan = __atomic_load_n (&prof->cmdplan, __ATOMIC_ACQUIRE);
+  if (plan == NULL)
+  {
+    edgex_cmdplan *expected = NULL;
+    plan = cmdplan_compile (prof);
+    if
+    (
+      !__atomic_compare_exchange_n
+        (&prof->cmdplan, &expected, plan, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+    )
+    {
+      /* Another thread compiled the profile first */
+      edgex_cmdplan_free (plan);
+      plan = expected;
+    }
+  }
+  return plan;
+}
+
+const edgex_cmdplan_cmd *edgex_cmdplan_find
+  (const edgex_cmdplan *plan, const char *name)
+{
+  uint32_t h = cmdplan_hash (name);
+  for (uint32_t i = h & plan->mask; plan->slots[i].cmd; i = (i + 1) & plan->mask)
+  {
+    if
+      (plan->slots[i].hash == h && strcmp (plan->slots[i].cmd->command->name, name) == 0)
+    {
+      return plan->slots[i].cmd;
+    }
+  }
+  return NULL;
+}
+
+uint32_t edgex_cmdplan_size (const edgex_cmdplan *plan)
+{
+  return plan->ncmds;
+}
+
+const edgex_cmdplan_cmd *edgex_cmdplan_at
+  (const edgex_cmdplan *plan, uint32_t i)
+{
+  return &plan->cmds[i];
+}
+
+void edgex_cmdplan_free (edgex_cmdplan *plan)
+{
+  if (plan)
+  {
+    free (plan->stats);
+    free (plan->slots);
+    free (plan->cmds);
+    free (plan->reqs);
+    free (plan);
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CMDPLAN_H_
+#define _EDGEX_DEVICE_CMDPLAN_H_ 1
+
+#include "edgex/devsdk.h"
+#include "stats.h"
+
+/*
+ * A command plan is an immutable, compiled form of a device profile's
+ * commands. Commands are found through a hash table, and for each of the get
+ * and set operations the device resources are resolved in advance into a
+ * contiguous array of requests, ready to be copied and passed to the driver.
+ * Each operation also has counters of the calls made to the driver for it,
+ * which are the only part of a plan to change once it is compiled.
+ */
+
+typedef struct edgex_cmdplan_op
+{
+  /* False if the profile has no resource for this command */
+  bool found;
+  /* Operation naming a device resource which does not exist, if any */
+  const char *missing;
+  /* First device resource which is not readable (get) or writable (set) */
+  const char *denied;
+  uint32_t nreqs;
+  edgex_device_commandrequest *reqs;
+  edgex_stats_calls *stats;
+} edgex_cmdplan_op;
+
+typedef struct edgex_cmdplan_cmd
+{
+  const edgex_command *command;
+  edgex_cmdplan_op get;
+  edgex_cmdplan_op set;
+} edgex_cmdplan_cmd;
+
+typedef struct edgex_cmdplan edgex_cmdplan;
+
+/* Return the plan for a profile, compiling it on first use */
+
+extern const edgex_cmdplan *edgex_cmdplan_get (edgex_deviceprofile *prof);
+
+/* Find a command in a plan. Returns NULL if there is no such command */
+
+extern const edgex_cmdplan_cmd *edgex_cmdplan_find
+  (const edgex_cmdplan *plan, const char *name);
+
+/* The number of commands in a plan, and the command at a given index */
+
+extern uint32_t edgex_cmdplan_size (const edgex_cmdplan *plan);
+
+extern const edgex_cmdplan_cmd *edgex_cmdplan_at
+  (const edgex_cmdplan *plan, uint32_t i);
+
+extern void edgex_cmdplan_free (edgex_cmdplan *plan);
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "confcache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * File layout: the header, then the records. A record is its kind and its
+ * number of strings, then each string as its length and its bytes followed
+ * by a NUL. A NULL string has the length CONFCACHE_NULL and no bytes. All
+ * numbers are in native byte order, as a snapshot is only read on the host
+ * which wrote it.
+ */
+
+#define CONFCACHE_MAGIC "EDGXCFG"
+#define CONFCACHE_VERSION 1
+#define CONFCACHE_NULL UINT32_MAX
+
+typedef struct confcache_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t count;
+  uint64_t hash;
+  uint64_t size;
+} confcache_header;
+
+uint64_t edgex_confcache_hash (uint64_t h, const void *data, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) data;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+void edgex_confcache_writer_init (edgex_confcache_writer *w)
+{
+  edgex_strbuf_init (&w->buf);
+  w->count = 0;
+}
+
+static void confcache_put32 (edgex_strbuf *b, uint32_t val)
+{
+  edgex_strbuf_append (b, (const char *) &val, sizeof (val));
+}
+
+void edgex_confcache_add
+(
+  edgex_confcache_writer *w,
+  uint32_t kind,
+  unsigned n,
+  const char *const *strs
+)
+{
+  confcache_put32 (&w->buf, kind);
+  confcache_put32 (&w->buf, n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (strs[i])
+    {
+      size_t len = strlen (strs[i]);
+      confcache_put32 (&w->buf, len);
+      edgex_strbuf_append (&w->buf, strs[i], len + 1);
+    }
+    else
+    {
+      confcache_put32 (&w->buf, CONFCACHE_NULL);
+    }
+  }
+  w->count++;
+}
+
+bool edgex_confcache_write
+  (edgex_confcache_writer *w, const char *path, uint64_t hash)
+{
+  confcache_header hdr;
+  bool ok = false;
+  char *tmp = malloc (strlen (path) + sizeof (".tmp"));
+
+  memset (&hdr, 0, sizeof (hdr));
+  strcpy (hdr.magic, CONFCACHE_MAGIC);
+  hdr.version = CONFCACHE_VERSION;
+  hdr.count = w->count;
+  hdr.hash = hash;
+  hdr.size = sizeof (hdr) + w->buf.len;
+
+  strcpy (tmp, path);
+  strcat (tmp, ".tmp");
+  FILE *fp = fopen (tmp, "wb");
+  if (fp)
+  {
+    ok = fwrite (&hdr, sizeof (hdr), 1, fp) == 1 &&
+      fwrite (w->buf.data, 1, w->buf.len, fp) == w->buf.len;
+    ok = (fclose (fp) == 0) && ok;
+    ok = ok && rename (tmp, path) == 0;
+    if (!ok)
+    {
+      unlink (tmp);
+    }
+  }
+  free (tmp);
+  edgex_strbuf_fini (&w->buf);
+  return ok;
+}
+
+bool edgex_confcache_open
+  (edgex_confcache *c, const char *path, uint64_t hash)
+{
+  confcache_header hdr;
+  struct stat st;
+  int fd;
+
+  memset (c, 0, sizeof (edgex_confcache));
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  if (fstat (fd, &st) == 0 && st.st_size >= (off_t) sizeof (hdr))
+  {
+    c->map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (c->map == MAP_FAILED)
+    {
+      c->map = NULL;
+    }
+  }
+  close (fd);
+  if (c->map == NULL)
+  {
+    return false;
+  }
+
+  c->size = st.st_size;
+  memcpy (&hdr, c->map, sizeof (hdr));
+  if
+  (
+    memcmp (hdr.magic, CONFCACHE_MAGIC, sizeof (CONFCACHE_MAGIC)) != 0 ||
+    hdr.version != CONFCACHE_VERSION || hdr.hash != hash ||
+    hdr.size != c->size
+  )
+  {
+    edgex_confcache_close (c);
+    return false;
+  }
+  c->next = (const char *) c->map + sizeof (hdr);
+  c->remaining = hdr.count;
+
+  /* Check the records, so that reading them later cannot fail */
+
+  edgex_confcache check = *c;
+  uint32_t kind;
+  unsigned n;
+  while (edgex_confcache_next (&check, &kind, &n, NULL, 0));
+  if (check.next != (const char *) c->map + c->size)
+  {
+    edgex_confcache_close (c);
+    return false;
+  }
+  return true;
+}
+
+static bool confcache_get32
+  (edgex_confcache *c, const char *end, uint32_t *val)
+{
+  if ((size_t) (end - c->next) < sizeof (uint32_t))
+  {
+    return false;
+  }
+  memcpy (val, c->next, sizeof (uint32_t));
+  c->next += sizeof (uint32_t);
+  return true;
+}
+
+bool edgex_confcache_next
+(
+  edgex_confcache *c,
+  uint32_t *kind,
+  unsigned *n,
+  const char **strs,
+  unsigned max
+)
+{
+  const char *end = (const char *) c->map + c->size;
+  uint32_t count;
+
+  if (c->remaining == 0)
+  {
+    return false;
+  }
+  c->remaining--;
+  if (!confcache_get32 (c, end, kind) || !confcache_get32 (c, end, &count))
+  {
+    c->remaining = 0;
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t len;
+    const char *s = NULL;
+    if (!confcache_get32 (c, end, &len))
+    {
+      c->remaining = 0;
+      return false;
+    }
+    if (len != CONFCACHE_NULL)
+    {
+      if ((size_t) (end - c->next) <= len || c->next[len] != '\0')
+      {
+        c->remaining = 0;
+        return false;
+      }
+      s = c->next;
+      c->next += len + 1;
+    }
+    if (i < max)
+    {
+      strs[i] = s;
+    }
+  }
+  *n = (count < max) ? count : max;
+  return true;
+}
+
+void edgex_confcache_close (edgex_confcache *c)
+{
+  if (c->map)
+  {
+    munmap (c->map, c->size);
+    c->map = NULL;
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CONFCACHE_H_
+#define _EDGEX_DEVICE_CONFCACHE_H_ 1
+
+#include "strbuf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A binary snapshot of a configuration, stored as a sequence of records
+ * each holding a kind and a number of strings (any of which may be NULL).
+ * The snapshot carries the hash of the source it was made from. It is read
+ * by mapping it read-only, so that the strings are used in place and the
+ * pages are shared by all the processes reading it.
+ */
+
+#define EDGEX_CONFCACHE_MAXSTRINGS 64
+
+typedef struct edgex_confcache_writer
+{
+  edgex_strbuf buf;
+  uint32_t count;
+} edgex_confcache_writer;
+
+typedef struct edgex_confcache
+{
+  void *map;
+  size_t size;
+  const char *next;
+  uint32_t remaining;
+} edgex_confcache;
+
+/*
+ * FNV-1a hash of the source data. Start with EDGEX_CONFCACHE_HASH_INIT; a
+ * hash may be continued over further data by passing it as h.
+ */
+
+#define EDGEX_CONFCACHE_HASH_INIT 14695981039346656037ULL
+
+extern uint64_t edgex_confcache_hash
+  (uint64_t h, const void *data, size_t len);
+
+extern void edgex_confcache_writer_init (edgex_confcache_writer *w);
+
+extern void edgex_confcache_add
+(
+  edgex_confcache_writer *w,
+  uint32_t kind,
+  unsigned n,
+  const char *const *strs
+);
+
+/*
+ * Write the records to path, replacing any existing file atomically, and
+ * free the writer. Returns false if the file could not be written.
+ */
+
+extern bool edgex_confcache_write
+  (edgex_confcache_writer *w, const char *path, uint64_t hash);
+
+/*
+ * Map the snapshot at path. Returns false if it does not exist, is not
+ * valid, or was made from a source with a different hash.
+ */
+
+extern bool edgex_confcache_open
+  (edgex_confcache *c, const char *path, uint64_t hash);
+
+/*
+ * Read the next record into kind, n and strs (which has room for max
+ * strings). The strings remain valid until the snapshot is closed. Returns
+ * false once all records are read.
+ */
+
+extern bool edgex_confcache_next
+(
+  edgex_confcache *c,
+  uint32_t *kind,
+  unsigned *n,
+  const char **strs,
+  unsigned max
+);
+
+extern void edgex_confcache_close (edgex_confcache *c);
+
+#endif
@@ -10,36 +10,38 @@
 #include "service.h"
 #include "errorlist.h"
 #include "edgex_rest.h"
+#include "numfmt.h"
+#include "confcache.h"
+#include "edgex/csdk-defs.h"
 
 #include <microhttpd.h>
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
+#include <inttypes.h>
 
 static void toml_rtos2 (const char *s, char **ret);
 
 #define ERRBUFSZ 1024
 
-toml_table_t *edgex_device_loadConfig
-(
-  iot_logging_client *lc,
-  const char *dir,
-  const char *profile,
-  edgex_error *err
-)
-{
-  toml_table_t *result = NULL;
-  FILE *fp;
-  char errbuf[ERRBUFSZ];
-  char *filename;
+/* Kinds of record in a configuration snapshot */
 
-  int pathlen = strlen (dir) + 1 + strlen ("configuration.toml") + 1;
+#define CACHE_PAIR 1
+#define CACHE_SCHEDULE 2
+#define CACHE_SCHEDULEEVENT 3
+#define CACHE_WATCHER 4
+
+static char *configFileName
+  (const char *dir, const char *profile, const char *ext)
+{
+  int pathlen = strlen (dir) + 1 + strlen ("configuration") + strlen (ext) + 1;
   if (profile && *profile)
   {
     pathlen += (strlen (profile) + 1);
   }
-  filename = malloc (pathlen);
+  char *filename = malloc (pathlen);
   strcpy (filename, dir);
   strcat (filename, "/");
   strcat (filename, "configuration");
@@ -48,31 +50,289 @@ toml_table_t *edgex_device_loadConfig
     strcat (filename, "-");
     strcat (filename, profile);
   }
-  strcat (filename, ".toml");
+  strcat (filename, ext);
+  return filename;
+}
 
-  fp = fopen (filename, "r");
+static char *readConfigFile
+  (iot_logging_client *lc, const char *filename, size_t *len, edgex_error *err)
+{
+  char *result = NULL;
+  FILE *fp = fopen (filename, "r");
   if (fp)
   {
-    result = toml_parse_file (fp, errbuf, ERRBUFSZ);
-    fclose (fp);
-    if (result == NULL)
+    if (fseek (fp, 0, SEEK_END) == 0)
     {
-      iot_log_error (lc, "Configuration file parse error: %s", errbuf);
-      *err = EDGEX_CONF_PARSE_ERROR;
+      long size = ftell (fp);
+      rewind (fp);
+      if (size >= 0)
+      {
+        result = malloc (size + 1);
+        *len = fread (result, 1, size, fp);
+        result[*len] = '\0';
+      }
     }
+    fclose (fp);
   }
-  else
+  if (result == NULL)
   {
     iot_log_error
       (lc, "Cant open file %s : %s", filename, strerror (errno));
     *err = EDGEX_NO_CONF_FILE;
   }
+  return result;
+}
+
+/* Record the configuration, as populated from the file, in a snapshot */
 
+static void saveConfigCache
+  (edgex_device_service *svc, const char *filename, uint64_t hash)
+{
+  edgex_confcache_writer w;
+  edgex_nvpairs *pairs = edgex_device_getConfig (svc);
+  const char *strs[EDGEX_CONFCACHE_MAXSTRINGS];
+  edgex_map_iter i;
+  const char *key;
+
+  edgex_confcache_writer_init (&w);
+  for (const edgex_nvpairs *p = pairs; p; p = p->next)
+  {
+    strs[0] = p->name;
+    strs[1] = p->value;
+    edgex_confcache_add (&w, CACHE_PAIR, 2, strs);
+  }
+  edgex_nvpairs_free (pairs);
+
+  i = edgex_map_iter (svc->config.schedules);
+  while ((key = edgex_map_next (&svc->config.schedules, &i)))
+  {
+    strs[0] = key;
+    strs[1] = *edgex_map_get (&svc->config.schedules, key);
+    edgex_confcache_add (&w, CACHE_SCHEDULE, 2, strs);
+  }
+
+  i = edgex_map_iter (svc->config.scheduleevents);
+  while ((key = edgex_map_next (&svc->config.scheduleevents, &i)))
+  {
+    edgex_device_scheduleeventinfo *info =
+      edgex_map_get (&svc->config.scheduleevents, key);
+    strs[0] = key;
+    strs[1] = info->schedule;
+    strs[2] = info->path;
+    edgex_confcache_add (&w, CACHE_SCHEDULEEVENT, 3, strs);
+  }
+
+  i = edgex_map_iter (svc->config.watchers);
+  while ((key = edgex_map_next (&svc->config.watchers, &i)))
+  {
+    edgex_device_watcherinfo *watcher =
+      edgex_map_get (&svc->config.watchers, key);
+    unsigned n = 0;
+    strs[n++] = key;
+    strs[n++] = watcher->profile;
+    strs[n++] = watcher->key;
+    strs[n++] = watcher->matchstring;
+    for (int j = 0; watcher->ids[j]; j++)
+    {
+      if (n == EDGEX_CONFCACHE_MAXSTRINGS)
+      {
+        iot_log_info
+        (
+          svc->logger, "Watcher %s has too many Identifiers for a snapshot",
+          key
+        );
+        edgex_strbuf_fini (&w.buf);
+        return;
+      }
+      strs[n++] = watcher->ids[j];
+    }
+    edgex_confcache_add (&w, CACHE_WATCHER, n, strs);
+  }
+
+  if (edgex_confcache_write (&w, filename, hash))
+  {
+    iot_log_info (svc->logger, "Saved configuration snapshot %s", filename);
+  }
+  else
+  {
+    iot_log_warning
+    (
+      svc->logger, "Unable to save configuration snapshot %s: %s",
+      filename, strerror (errno)
+    );
+  }
+}
+
+static char *dupOrNull (const char *s)
+{
+  return s ? strdup (s) : NULL;
+}
+
+/*
+ * Populate the configuration from a snapshot made from a file with the given
+ * hash. Returns false if there is no such snapshot.
+ */
+
+static bool loadConfigCache
+(
+  edgex_device_service *svc,
+  const char *filename,
+  uint64_t hash,
+  edgex_error *err
+)
+{
+  edgex_confcache c;
+  const char *strs[EDGEX_CONFCACHE_MAXSTRINGS];
+  uint32_t kind;
+  unsigned n;
+  unsigned npairs = 0;
+
+  if (!edgex_confcache_open (&c, filename, hash))
+  {
+    return false;
+  }
+
+  /* The pairs refer to the strings in the snapshot, which are not copied */
+
+  edgex_confcache count = c;
+  while (edgex_confcache_next (&count, &kind, &n, strs, 0))
+  {
+    npairs += (kind == CACHE_PAIR);
+  }
+  edgex_nvpairs *pairs = calloc (npairs ? npairs : 1, sizeof (edgex_nvpairs));
+  npairs = 0;
+
+  svc->config.device.discovery = true;
+  svc->config.device.datatransform = true;
+  svc->config.device.mergeschedules = true;
+
+  while (edgex_confcache_next (&c, &kind, &n, strs, EDGEX_CONFCACHE_MAXSTRINGS))
+  {
+    switch (kind)
+    {
+      case CACHE_PAIR:
+        if (n == 2 && strs[0] && strs[1])
+        {
+          pairs[npairs].name = (char *) strs[0];
+          pairs[npairs].value = (char *) strs[1];
+          pairs[npairs].next = npairs ? &pairs[npairs - 1] : NULL;
+          npairs++;
+        }
+        break;
+      case CACHE_SCHEDULE:
+        if (n == 2 && strs[0] && strs[1])
+        {
+          edgex_map_set (&svc->config.schedules, strs[0], strdup (strs[1]));
+        }
+        break;
+      case CACHE_SCHEDULEEVENT:
+        if (n == 3 && strs[0] && strs[1] && strs[2])
+        {
+          edgex_device_scheduleeventinfo info;
+          info.schedule = strdup (strs[1]);
+          info.path = strdup (strs[2]);
+          edgex_map_set (&svc->config.scheduleevents, strs[0], info);
+        }
+        break;
+      case CACHE_WATCHER:
+        if (n >= 4 && strs[0] && strs[1] && strs[2])
+        {
+          edgex_device_watcherinfo watcher;
+          watcher.profile = strdup (strs[1]);
+          watcher.key = strdup (strs[2]);
+          watcher.matchstring = dupOrNull (strs[3]);
+          watcher.ids = malloc (sizeof (char *) * (n - 3));
+          for (unsigned j = 4; j < n; j++)
+          {
+            watcher.ids[j - 4] = dupOrNull (strs[j]);
+          }
+          watcher.ids[n - 4] = NULL;
+          edgex_map_set (&svc->config.watchers, strs[0], watcher);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  edgex_device_populateConfigNV
+    (svc, npairs ? &pairs[npairs - 1] : NULL, err);
+  free (pairs);
+  edgex_confcache_close (&c);
+  return true;
+}
+
+toml_table_t *edgex_device_loadConfig
+(
+  edgex_device_service *svc,
+  const char *dir,
+  const char *profile,
+  edgex_error *err
+)
+{
+  toml_table_t *result = NULL;
+  char errbuf[ERRBUFSZ];
+  size_t len = 0;
+
+  char *filename = configFileName (dir, profile, ".toml");
+  char *contents = readConfigFile (svc->logger, filename, &len, err);
   free (filename);
+  if (contents == NULL)
+  {
+    return NULL;
+  }
+
+  /*
+   * A snapshot is only valid for the SDK version which made it, as a later
+   * version may read settings from the file which the snapshot lacks
+   */
+
+  uint64_t hash = edgex_confcache_hash
+    (EDGEX_CONFCACHE_HASH_INIT, CSDK_VERSION_STR, strlen (CSDK_VERSION_STR));
+  hash = edgex_confcache_hash (hash, contents, len);
+  char *cachename = configFileName (dir, profile, ".cache");
+  if (loadConfigCache (svc, cachename, hash, err))
+  {
+    iot_log_info
+      (svc->logger, "Configuration read from snapshot %s", cachename);
+  }
+  else
+  {
+    result = toml_parse (contents, errbuf, ERRBUFSZ);
+    if (result == NULL)
+    {
+      iot_log_error (svc->logger, "Configuration file parse error: %s", errbuf);
+      *err = EDGEX_CONF_PARSE_ERROR;
+    }
+    else
+    {
+      edgex_device_populateConfig (svc, result, err);
+      if (err->code == 0 && svc->config.device.configcache)
+      {
+        if (toml_array_in (result, "DeviceList"))
+        {
+          iot_log_info
+          (
+            svc->logger,
+            "Configuration has a DeviceList, snapshot not saved"
+          );
+        }
+        else
+        {
+          saveConfigCache (svc, cachename, hash);
+        }
+      }
+    }
+  }
+  free (cachename);
+  free (contents);
   return result;
 }
 
-/* Extract a frequency in seconds from an ISO8601 period */
+/*
+ * Extract a frequency in nanoseconds from an ISO8601 period. The seconds
+ * component may have a decimal fraction, eg "PT0.1S".
+ */
 
 typedef struct pmap
 {
@@ -97,10 +357,11 @@ static const pmap times[] =
   {0,   0}
 };
 
-const char *edgex_device_config_parse8601 (const char *str, int *result)
+const char *edgex_device_config_parse8601 (const char *str, uint64_t *result)
 {
   char *endptr;
-  int component;
+  uint64_t component;
+  uint64_t fraction;
   const pmap *curmap = dates;
   const char *iter = str;
 
@@ -124,16 +385,30 @@ const char *edgex_device_config_parse8601 (const char *str, int *result)
         return "Time separator 'T' can only be used once";
       }
     }
-    component = strtol (iter, &endptr, 10);
+    component = strtoull (iter, &endptr, 10);
     if (endptr == iter)
     {
       return "Unable to parse decimal";
     }
+    fraction = 0;
+    if (*endptr == '.' || *endptr == ',')
+    {
+      uint64_t scale = 100000000;
+      for (endptr++; *endptr >= '0' && *endptr <= '9'; endptr++)
+      {
+        fraction += (*endptr - '0') * scale;
+        scale /= 10;
+      }
+      if (curmap != times || *endptr != 'S')
+      {
+        return "Only the seconds component may have a fraction";
+      }
+    }
     for (int i = 0; curmap[i].p; i++)
     {
       if (*endptr == curmap[i].p)
       {
-        *result += component * curmap[i].factor;
+        *result += component * curmap[i].factor * 1000000000ULL + fraction;
         iter = endptr + 1;
         break;
       }
@@ -173,6 +448,27 @@ static void toml_rtob2 (const char *raw, bool *ret)
   }
 }
 
+static void toml_rtod2
+  (const char *raw, double *ret, iot_logging_client *lc, edgex_error *err)
+{
+  if (raw)
+  {
+    int64_t ival;
+    if (toml_rtod (raw, ret) != 0)
+    {
+      if (toml_rtoi (raw, &ival) == 0)
+      {
+        *ret = ival;
+      }
+      else
+      {
+        iot_log_error (lc, "Unable to parse %s as double", raw);
+        *err = EDGEX_BAD_CONFIG;
+      }
+    }
+  }
+}
+
 /* Wrap toml_rtoi for uint16, uint32. */
 
 static void toml_rtoui16
@@ -223,6 +519,49 @@ toml_rtoui32 (toml_raw_in(table, #KEY), &svc->config.ELEMENT, svc->logger, err);
 #define GET_CONFIG_BOOL(KEY, ELEMENT) \
 toml_rtob2 (toml_raw_in(table, #KEY), &svc->config.ELEMENT);
 
+#define GET_CONFIG_DOUBLE(KEY, ELEMENT) \
+toml_rtod2 (toml_raw_in(table, #KEY), &svc->config.ELEMENT, svc->logger, err);
+
+/* Read a table of simple name-value pairs, such as the Driver table */
+
+static bool get_config_nvtable
+(
+  iot_logging_client *lc,
+  toml_table_t *config,
+  const char *name,
+  edgex_nvpairs **list
+)
+{
+  const char *raw;
+  toml_table_t *table = toml_table_in (config, name);
+  if (table)
+  {
+    const char *key;
+    for (int i = 0; 0 != (key = toml_key_in (table, i)); i++)
+    {
+      raw = toml_raw_in (table, key);
+      if (raw)
+      {
+        edgex_nvpairs *pair = malloc (sizeof (edgex_nvpairs));
+        pair->name = strdup (key);
+        if (toml_rtos (raw, &pair->value) == -1)
+        {
+          pair->value = strdup (raw);
+        }
+        pair->next = *list;
+        *list = pair;
+      }
+      else
+      {
+        iot_log_error
+          (lc, "Arrays and subtables not supported in %s table", name);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 void edgex_device_populateConfig
   (edgex_device_service *svc, toml_table_t *config, edgex_error *err)
 {
@@ -234,6 +573,9 @@ void edgex_device_populateConfig
 
   svc->config.device.discovery = true;
   svc->config.device.datatransform = true;
+  svc->config.device.mergeschedules = true;
+  svc->config.messagequeue.qos = 1;
+  svc->config.messagequeue.keepalive = 60;
 
   table = toml_table_in (config, "Service");
   if (table)
@@ -241,10 +583,22 @@ void edgex_device_populateConfig
     GET_CONFIG_STRING(Host, service.host);
     GET_CONFIG_UINT16(Port, service.port);
     GET_CONFIG_UINT32(Timeout, service.timeout);
+    GET_CONFIG_UINT32(RequestTimeout, service.requesttimeout);
     GET_CONFIG_UINT32(ConnectRetries, service.connectretries);
+    GET_CONFIG_UINT32(BackoffLimit, service.backofflimit);
+    GET_CONFIG_UINT32(CircuitThreshold, service.circuitthreshold);
+    GET_CONFIG_BOOL(Http2, service.http2);
     GET_CONFIG_STRING(StartupMsg, service.startupmsg);
     GET_CONFIG_UINT32(ReadMaxLimit, service.readmaxlimit);
     GET_CONFIG_STRING(CheckInterval, service.checkinterval);
+    GET_CONFIG_UINT32(ServerThreads, service.serverthreads);
+    GET_CONFIG_UINT32(MaxConnections, service.maxconnections);
+    GET_CONFIG_UINT32(MaxConnectionsPerIp, service.maxconnectionsperip);
+    GET_CONFIG_UINT32(ConnectionTimeout, service.connectiontimeout);
+    GET_CONFIG_UINT32(ListenBacklog, service.listenbacklog);
+    GET_CONFIG_UINT32(MaxRequestSize, service.maxrequestsize);
+    GET_CONFIG_UINT32(WorkerThreads, service.workerthreads);
+    GET_CONFIG_STRING(WorkerCPUs, service.workercpus);
     int n = 0;
     arr = toml_array_in (table, "Labels");
     if (arr)
@@ -269,12 +623,14 @@ void edgex_device_populateConfig
     {
       GET_CONFIG_STRING(Host, endpoints.data.host);
       GET_CONFIG_UINT16(Port, endpoints.data.port);
+      GET_CONFIG_STRING(Name, endpoints.data.name);
     }
     table = toml_table_in (subtable, "Metadata");
     if (table)
     {
       GET_CONFIG_STRING(Host, endpoints.metadata.host);
       GET_CONFIG_UINT16(Port, endpoints.metadata.port);
+      GET_CONFIG_STRING(Name, endpoints.metadata.name);
     }
   }
 
@@ -291,34 +647,46 @@ void edgex_device_populateConfig
     GET_CONFIG_STRING(RemoveCmdArgs, device.removecmdargs);
     GET_CONFIG_STRING(ProfilesDir, device.profilesdir);
     GET_CONFIG_BOOL(SendReadingsOnChanged, device.sendreadingsonchanged);
+    GET_CONFIG_DOUBLE(OnChangeDeadband, device.onchangedeadband);
+    GET_CONFIG_DOUBLE(OnChangePercent, device.onchangepercent);
+    GET_CONFIG_UINT32(OnChangeRefresh, device.onchangerefresh);
+    GET_CONFIG_UINT32(EventBatchSize, device.eventbatchsize);
+    GET_CONFIG_UINT32(EventBatchTimeout, device.eventbatchtimeout);
+    GET_CONFIG_UINT32(EventQueueSize, device.eventqueuesize);
+    GET_CONFIG_STRING(EventQueuePolicy, device.eventqueuepolicy);
+    GET_CONFIG_STRING(EventEncoding, device.eventencoding);
+    GET_CONFIG_STRING(EventCompression, device.eventcompression);
+    GET_CONFIG_UINT32(EventCompressionMin, device.eventcompressionmin);
+    GET_CONFIG_STRING(EventQueueSpillDir, device.eventqueuespilldir);
+    GET_CONFIG_STRING(EventLogDir, device.eventlogdir);
+    GET_CONFIG_UINT32(EventLogLimit, device.eventloglimit);
+    GET_CONFIG_UINT32(EventLogRate, device.eventlograte);
+    GET_CONFIG_STRING(SnapshotFile, device.snapshotfile);
+    GET_CONFIG_STRING(Clock, device.clock);
+    GET_CONFIG_UINT32(EventQueueThreads, device.eventqueuethreads);
+    GET_CONFIG_UINT32(AllCommandThreads, device.allcommandthreads);
+    GET_CONFIG_UINT32(AllCommandTimeout, device.allcommandtimeout);
+    GET_CONFIG_BOOL(MergeSchedules, device.mergeschedules);
+    GET_CONFIG_BOOL(CombineScheduledEvents, device.combinescheduledevents);
+    GET_CONFIG_BOOL(PutBatching, device.putbatching);
+    GET_CONFIG_UINT32(PutBatchWindow, device.putbatchwindow);
+    GET_CONFIG_BOOL(SerializeCommands, device.serializecommands);
+    GET_CONFIG_BOOL(ConfigCache, device.configcache);
+    GET_CONFIG_UINT32(HistorySize, device.historysize);
+    GET_CONFIG_UINT32(StatusInterval, device.statusinterval);
+    GET_CONFIG_BOOL(UpdateLastConnected, device.updatelastconnected);
+    GET_CONFIG_BOOL(WatchProfiles, device.watchprofiles);
+    GET_CONFIG_BOOL(OriginNanos, device.originnanos);
   }
 
-  table = toml_table_in (config, "Driver");
-  if (table)
+  if
+  (
+    !get_config_nvtable (svc->logger, config, "Driver", &svc->config.driverconf) ||
+    !get_config_nvtable (svc->logger, config, "ReadCache", &svc->config.readcache)
+  )
   {
-    const char *key;
-    for (int i = 0; 0 != (key = toml_key_in (table, i)); i++)
-    {
-      raw = toml_raw_in (table, key);
-      if (raw)
-      {
-        edgex_nvpairs *pair = malloc (sizeof (edgex_nvpairs));
-        pair->name = strdup (key);
-        if (toml_rtos (raw, &pair->value) == -1)
-        {
-          pair->value = strdup (raw);
-        }
-        pair->next = svc->config.driverconf;
-        svc->config.driverconf = pair;
-      }
-      else
-      {
-        iot_log_error
-          (svc->logger, "Arrays and subtables not supported in Driver table");
-        *err = EDGEX_BAD_CONFIG;
-        return;
-      }
-    }
+    *err = EDGEX_BAD_CONFIG;
+    return;
   }
 
   table = toml_table_in (config, "Logging");
@@ -326,6 +694,24 @@ void edgex_device_populateConfig
   {
     GET_CONFIG_STRING(RemoteURL, logging.remoteurl);
     GET_CONFIG_STRING(File, logging.file);
+    GET_CONFIG_UINT32(QueueSize, logging.queuesize);
+    GET_CONFIG_UINT32(MaxBatch, logging.maxbatch);
+    GET_CONFIG_UINT32(RateLimit, logging.ratelimit);
+  }
+
+  table = toml_table_in (config, "MessageQueue");
+  if (table)
+  {
+    GET_CONFIG_STRING(Type, messagequeue.type);
+    GET_CONFIG_STRING(Host, messagequeue.host);
+    GET_CONFIG_UINT16(Port, messagequeue.port);
+    GET_CONFIG_STRING(Topic, messagequeue.topic);
+    GET_CONFIG_STRING(ClientId, messagequeue.clientid);
+    GET_CONFIG_STRING(Username, messagequeue.username);
+    GET_CONFIG_STRING(Password, messagequeue.password);
+    GET_CONFIG_UINT32(Qos, messagequeue.qos);
+    GET_CONFIG_UINT32(KeepAlive, messagequeue.keepalive);
+    GET_CONFIG_UINT32(MaxInFlight, messagequeue.maxinflight);
   }
 
   arr = toml_array_in (config, "Schedules");
@@ -336,7 +722,7 @@ void edgex_device_populateConfig
     {
       char *freqstr = NULL;
       namestr = NULL;
-      int interval = 0;
+      uint64_t interval = 0;
       toml_rtos2 (toml_raw_in (table, "Frequency"), &freqstr);
       toml_rtos2 (toml_raw_in (table, "Name"), &namestr);
       if (namestr && freqstr)
@@ -539,6 +925,37 @@ static uint16_t get_nv_config_uint16
   return 0;
 }
 
+static double get_nv_config_double
+(
+  iot_logging_client *lc,
+  const edgex_nvpairs *config,
+  const char *key,
+  edgex_error *err
+)
+{
+  for (const edgex_nvpairs *iter = config; iter; iter = iter->next)
+  {
+    if (strcasecmp (iter->name, key) == 0)
+    {
+      char *end;
+      double tmp;
+      errno = 0;
+      tmp = strtod (iter->value, &end);
+      if (errno == 0 && end != iter->value && *end == '\0')
+      {
+        return tmp;
+      }
+      else
+      {
+        *err = EDGEX_BAD_CONFIG;
+        iot_log_error (lc, "Unable to parse %s as double", iter->value);
+        return 0.0;
+      }
+    }
+  }
+  return 0.0;
+}
+
 static bool get_nv_config_bool
   (const edgex_nvpairs *config, const char *key, bool dfl)
 {
@@ -560,14 +977,38 @@ void edgex_device_populateConfigNV
     get_nv_config_uint16 (svc->logger, config, "Service/Port", err);
   svc->config.service.timeout =
     get_nv_config_uint32 (svc->logger, config, "Service/Timeout", err);
+  svc->config.service.requesttimeout =
+    get_nv_config_uint32 (svc->logger, config, "Service/RequestTimeout", err);
   svc->config.service.connectretries =
     get_nv_config_uint32 (svc->logger, config, "Service/ConnectRetries", err);
+  svc->config.service.backofflimit =
+    get_nv_config_uint32 (svc->logger, config, "Service/BackoffLimit", err);
+  svc->config.service.circuitthreshold =
+    get_nv_config_uint32 (svc->logger, config, "Service/CircuitThreshold", err);
+  svc->config.service.http2 =
+    get_nv_config_bool (config, "Service/Http2", false);
   svc->config.service.startupmsg =
     get_nv_config_string (config, "Service/StartupMsg");
   svc->config.service.readmaxlimit =
     get_nv_config_uint32 (svc->logger, config, "Service/ReadMaxLimit", err);
   svc->config.service.checkinterval =
     get_nv_config_string (config, "Service/CheckInterval");
+  svc->config.service.serverthreads =
+    get_nv_config_uint32 (svc->logger, config, "Service/ServerThreads", err);
+  svc->config.service.maxconnections =
+    get_nv_config_uint32 (svc->logger, config, "Service/MaxConnections", err);
+  svc->config.service.maxconnectionsperip = get_nv_config_uint32
+    (svc->logger, config, "Service/MaxConnectionsPerIp", err);
+  svc->config.service.connectiontimeout = get_nv_config_uint32
+    (svc->logger, config, "Service/ConnectionTimeout", err);
+  svc->config.service.listenbacklog =
+    get_nv_config_uint32 (svc->logger, config, "Service/ListenBacklog", err);
+  svc->config.service.maxrequestsize =
+    get_nv_config_uint32 (svc->logger, config, "Service/MaxRequestSize", err);
+  svc->config.service.workerthreads =
+    get_nv_config_uint32 (svc->logger, config, "Service/WorkerThreads", err);
+  svc->config.service.workercpus =
+    get_nv_config_string (config, "Service/WorkerCPUs");
 
   char *lstr = get_nv_config_string (config, "Service/Labels");
   if (lstr)
@@ -602,10 +1043,14 @@ void edgex_device_populateConfigNV
     get_nv_config_string (config, "Clients/Data/Host");
   svc->config.endpoints.data.port =
     get_nv_config_uint16 (svc->logger, config, "Clients/Data/Port", err);
+  svc->config.endpoints.data.name =
+    get_nv_config_string (config, "Clients/Data/Name");
   svc->config.endpoints.metadata.host =
     get_nv_config_string (config, "Clients/Metadata/Host");
   svc->config.endpoints.metadata.port =
     get_nv_config_uint16 (svc->logger, config, "Clients/Metadata/Port", err);
+  svc->config.endpoints.metadata.name =
+    get_nv_config_string (config, "Clients/Metadata/Name");
 
   svc->config.device.datatransform =
     get_nv_config_bool (config, "Device/DataTransform", true);
@@ -626,6 +1071,66 @@ void edgex_device_populateConfigNV
     get_nv_config_string (config, "Device/ProfilesDir");
   svc->config.device.sendreadingsonchanged =
     get_nv_config_bool (config, "Device/SendReadingsOnChanged", false);
+  svc->config.device.onchangedeadband =
+    get_nv_config_double (svc->logger, config, "Device/OnChangeDeadband", err);
+  svc->config.device.onchangepercent =
+    get_nv_config_double (svc->logger, config, "Device/OnChangePercent", err);
+  svc->config.device.onchangerefresh =
+    get_nv_config_uint32 (svc->logger, config, "Device/OnChangeRefresh", err);
+  svc->config.device.eventbatchsize =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventBatchSize", err);
+  svc->config.device.eventbatchtimeout =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventBatchTimeout", err);
+  svc->config.device.eventqueuesize =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventQueueSize", err);
+  svc->config.device.eventqueuepolicy =
+    get_nv_config_string (config, "Device/EventQueuePolicy");
+  svc->config.device.eventencoding =
+    get_nv_config_string (config, "Device/EventEncoding");
+  svc->config.device.eventcompression =
+    get_nv_config_string (config, "Device/EventCompression");
+  svc->config.device.eventcompressionmin = get_nv_config_uint32
+    (svc->logger, config, "Device/EventCompressionMin", err);
+  svc->config.device.eventqueuespilldir =
+    get_nv_config_string (config, "Device/EventQueueSpillDir");
+  svc->config.device.eventlogdir =
+    get_nv_config_string (config, "Device/EventLogDir");
+  svc->config.device.eventloglimit =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventLogLimit", err);
+  svc->config.device.eventlograte =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventLogRate", err);
+  svc->config.device.snapshotfile =
+    get_nv_config_string (config, "Device/SnapshotFile");
+  svc->config.device.clock =
+    get_nv_config_string (config, "Device/Clock");
+  svc->config.device.eventqueuethreads =
+    get_nv_config_uint32 (svc->logger, config, "Device/EventQueueThreads", err);
+  svc->config.device.allcommandthreads =
+    get_nv_config_uint32 (svc->logger, config, "Device/AllCommandThreads", err);
+  svc->config.device.allcommandtimeout =
+    get_nv_config_uint32 (svc->logger, config, "Device/AllCommandTimeout", err);
+  svc->config.device.mergeschedules =
+    get_nv_config_bool (config, "Device/MergeSchedules", true);
+  svc->config.device.combinescheduledevents =
+    get_nv_config_bool (config, "Device/CombineScheduledEvents", false);
+  svc->config.device.putbatching =
+    get_nv_config_bool (config, "Device/PutBatching", false);
+  svc->config.device.putbatchwindow =
+    get_nv_config_uint32 (svc->logger, config, "Device/PutBatchWindow", err);
+  svc->config.device.serializecommands =
+    get_nv_config_bool (config, "Device/SerializeCommands", false);
+  svc->config.device.configcache =
+    get_nv_config_bool (config, "Device/ConfigCache", false);
+  svc->config.device.historysize =
+    get_nv_config_uint32 (svc->logger, config, "Device/HistorySize", err);
+  svc->config.device.statusinterval =
+    get_nv_config_uint32 (svc->logger, config, "Device/StatusInterval", err);
+  svc->config.device.updatelastconnected =
+    get_nv_config_bool (config, "Device/UpdateLastConnected", false);
+  svc->config.device.watchprofiles =
+    get_nv_config_bool (config, "Device/WatchProfiles", false);
+  svc->config.device.originnanos =
+    get_nv_config_bool (config, "Device/OriginNanos", false);
 
   for (const edgex_nvpairs *iter = config; iter; iter = iter->next)
   {
@@ -634,11 +1139,43 @@ void edgex_device_populateConfigNV
       svc->config.driverconf = makepair
         (iter->name + strlen ("Driver/"), iter->value, svc->config.driverconf);
     }
+    else if (strncmp (iter->name, "ReadCache/", strlen ("ReadCache/")) == 0)
+    {
+      svc->config.readcache = makepair
+        (iter->name + strlen ("ReadCache/"), iter->value, svc->config.readcache);
+    }
   }
 
   svc->config.logging.remoteurl =
     get_nv_config_string (config, "Logging/RemoteURL");
   svc->config.logging.file = get_nv_config_string (config, "Logging/File");
+  svc->config.logging.queuesize =
+    get_nv_config_uint32 (svc->logger, config, "Logging/QueueSize", err);
+  svc->config.logging.maxbatch =
+    get_nv_config_uint32 (svc->logger, config, "Logging/MaxBatch", err);
+  svc->config.logging.ratelimit =
+    get_nv_config_uint32 (svc->logger, config, "Logging/RateLimit", err);
+
+  svc->config.messagequeue.type =
+    get_nv_config_string (config, "MessageQueue/Type");
+  svc->config.messagequeue.host =
+    get_nv_config_string (config, "MessageQueue/Host");
+  svc->config.messagequeue.port =
+    get_nv_config_uint16 (svc->logger, config, "MessageQueue/Port", err);
+  svc->config.messagequeue.topic =
+    get_nv_config_string (config, "MessageQueue/Topic");
+  svc->config.messagequeue.clientid =
+    get_nv_config_string (config, "MessageQueue/ClientId");
+  svc->config.messagequeue.username =
+    get_nv_config_string (config, "MessageQueue/Username");
+  svc->config.messagequeue.password =
+    get_nv_config_string (config, "MessageQueue/Password");
+  svc->config.messagequeue.qos =
+    get_nv_config_uint32 (svc->logger, config, "MessageQueue/Qos", err);
+  svc->config.messagequeue.keepalive =
+    get_nv_config_uint32 (svc->logger, config, "MessageQueue/KeepAlive", err);
+  svc->config.messagequeue.maxinflight = get_nv_config_uint32
+    (svc->logger, config, "MessageQueue/MaxInFlight", err);
 }
 
 #define PUT_CONFIG_STRING(X,Y) \
@@ -649,6 +1186,8 @@ void edgex_device_populateConfigNV
   sprintf (buf, "%lu", (unsigned long)svc->config.Y); result = makepair (#X, buf, result)
 #define PUT_CONFIG_BOOL(X,Y) \
   result = makepair (#X, svc->config.Y ? "true" : "false", result)
+#define PUT_CONFIG_DOUBLE(X,Y) \
+  edgex_fmt_double (svc->config.Y, buf); result = makepair (#X, buf, result)
 
 edgex_nvpairs *edgex_device_getConfig (const edgex_device_service *svc)
 {
@@ -658,10 +1197,22 @@ edgex_nvpairs *edgex_device_getConfig (const edgex_device_service *svc)
   PUT_CONFIG_STRING(Service/Host, service.host);
   PUT_CONFIG_UINT(Service/Port, service.port);
   PUT_CONFIG_UINT(Service/Timeout, service.timeout);
+  PUT_CONFIG_UINT(Service/RequestTimeout, service.requesttimeout);
   PUT_CONFIG_UINT(Service/ConnectRetries, service.connectretries);
+  PUT_CONFIG_UINT(Service/BackoffLimit, service.backofflimit);
+  PUT_CONFIG_UINT(Service/CircuitThreshold, service.circuitthreshold);
+  PUT_CONFIG_BOOL(Service/Http2, service.http2);
   PUT_CONFIG_STRING(Service/StartupMsg, service.startupmsg);
   PUT_CONFIG_UINT(Service/ReadMaxLimit, service.readmaxlimit);
   PUT_CONFIG_STRING(Service/CheckInterval, service.checkinterval);
+  PUT_CONFIG_UINT(Service/ServerThreads, service.serverthreads);
+  PUT_CONFIG_UINT(Service/WorkerThreads, service.workerthreads);
+  PUT_CONFIG_STRING(Service/WorkerCPUs, service.workercpus);
+  PUT_CONFIG_UINT(Service/MaxConnections, service.maxconnections);
+  PUT_CONFIG_UINT(Service/MaxConnectionsPerIp, service.maxconnectionsperip);
+  PUT_CONFIG_UINT(Service/ConnectionTimeout, service.connectiontimeout);
+  PUT_CONFIG_UINT(Service/ListenBacklog, service.listenbacklog);
+  PUT_CONFIG_UINT(Service/MaxRequestSize, service.maxrequestsize);
 
   int labellen = 0;
   for (int i = 0; svc->config.service.labels[i]; i++)
@@ -686,8 +1237,10 @@ edgex_nvpairs *edgex_device_getConfig (const edgex_device_service *svc)
 
   PUT_CONFIG_STRING(Clients/Data/Host, endpoints.data.host);
   PUT_CONFIG_UINT(Clients/Data/Port, endpoints.data.port);
+  PUT_CONFIG_STRING(Clients/Data/Name, endpoints.data.name);
   PUT_CONFIG_STRING(Clients/Metadata/Host, endpoints.metadata.host);
   PUT_CONFIG_UINT(Clients/Metadata/Port, endpoints.metadata.port);
+  PUT_CONFIG_STRING(Clients/Metadata/Name, endpoints.metadata.name);
 
   PUT_CONFIG_BOOL(Device/DataTransform, device.datatransform);
   PUT_CONFIG_BOOL(Device/Discovery, device.discovery);
@@ -699,6 +1252,36 @@ edgex_nvpairs *edgex_device_getConfig (const edgex_device_service *svc)
   PUT_CONFIG_STRING(Device/RemoveCmdArgs, device.removecmdargs);
   PUT_CONFIG_STRING(Device/ProfilesDir, device.profilesdir);
   PUT_CONFIG_BOOL(Device/SendReadingsOnChanged, device.sendreadingsonchanged);
+  PUT_CONFIG_DOUBLE(Device/OnChangeDeadband, device.onchangedeadband);
+  PUT_CONFIG_DOUBLE(Device/OnChangePercent, device.onchangepercent);
+  PUT_CONFIG_UINT(Device/OnChangeRefresh, device.onchangerefresh);
+  PUT_CONFIG_UINT(Device/EventBatchSize, device.eventbatchsize);
+  PUT_CONFIG_UINT(Device/EventBatchTimeout, device.eventbatchtimeout);
+  PUT_CONFIG_UINT(Device/EventQueueSize, device.eventqueuesize);
+  PUT_CONFIG_STRING(Device/EventQueuePolicy, device.eventqueuepolicy);
+  PUT_CONFIG_STRING(Device/EventEncoding, device.eventencoding);
+  PUT_CONFIG_STRING(Device/EventCompression, device.eventcompression);
+  PUT_CONFIG_UINT(Device/EventCompressionMin, device.eventcompressionmin);
+  PUT_CONFIG_STRING(Device/EventQueueSpillDir, device.eventqueuespilldir);
+  PUT_CONFIG_STRING(Device/EventLogDir, device.eventlogdir);
+  PUT_CONFIG_UINT(Device/EventLogLimit, device.eventloglimit);
+  PUT_CONFIG_UINT(Device/EventLogRate, device.eventlograte);
+  PUT_CONFIG_STRING(Device/SnapshotFile, device.snapshotfile);
+  PUT_CONFIG_STRING(Device/Clock, device.clock);
+  PUT_CONFIG_UINT(Device/EventQueueThreads, device.eventqueuethreads);
+  PUT_CONFIG_UINT(Device/AllCommandThreads, device.allcommandthreads);
+  PUT_CONFIG_UINT(Device/AllCommandTimeout, device.allcommandtimeout);
+  PUT_CONFIG_BOOL(Device/MergeSchedules, device.mergeschedules);
+  PUT_CONFIG_BOOL(Device/CombineScheduledEvents, device.combinescheduledevents);
+  PUT_CONFIG_BOOL(Device/PutBatching, device.putbatching);
+  PUT_CONFIG_UINT(Device/PutBatchWindow, device.putbatchwindow);
+  PUT_CONFIG_BOOL(Device/SerializeCommands, device.serializecommands);
+  PUT_CONFIG_BOOL(Device/ConfigCache, device.configcache);
+  PUT_CONFIG_UINT(Device/HistorySize, device.historysize);
+  PUT_CONFIG_UINT(Device/StatusInterval, device.statusinterval);
+  PUT_CONFIG_BOOL(Device/UpdateLastConnected, device.updatelastconnected);
+  PUT_CONFIG_BOOL(Device/WatchProfiles, device.watchprofiles);
+  PUT_CONFIG_BOOL(Device/OriginNanos, device.originnanos);
 
   for (edgex_nvpairs *iter = svc->config.driverconf; iter; iter = iter->next)
   {
@@ -710,12 +1293,131 @@ edgex_nvpairs *edgex_device_getConfig (const edgex_device_service *svc)
     result = pair;
   }
 
+  for (edgex_nvpairs *iter = svc->config.readcache; iter; iter = iter->next)
+  {
+    edgex_nvpairs *pair = malloc (sizeof (edgex_nvpairs));
+    pair->name = malloc (strlen (iter->name) + strlen ("ReadCache/") + 1);
+    sprintf (pair->name, "ReadCache/%s", iter->name);
+    pair->value = strdup (iter->value);
+    pair->next = result;
+    result = pair;
+  }
+
   PUT_CONFIG_STRING(Logging/RemoteURL, logging.remoteurl);
   PUT_CONFIG_STRING(Logging/File, logging.file);
+  PUT_CONFIG_UINT(Logging/QueueSize, logging.queuesize);
+  PUT_CONFIG_UINT(Logging/MaxBatch, logging.maxbatch);
+  PUT_CONFIG_UINT(Logging/RateLimit, logging.ratelimit);
+
+  PUT_CONFIG_STRING(MessageQueue/Type, messagequeue.type);
+  PUT_CONFIG_STRING(MessageQueue/Host, messagequeue.host);
+  PUT_CONFIG_UINT(MessageQueue/Port, messagequeue.port);
+  PUT_CONFIG_STRING(MessageQueue/Topic, messagequeue.topic);
+  PUT_CONFIG_STRING(MessageQueue/ClientId, messagequeue.clientid);
+  PUT_CONFIG_STRING(MessageQueue/Username, messagequeue.username);
+  PUT_CONFIG_STRING(MessageQueue/Password, messagequeue.password);
+  PUT_CONFIG_UINT(MessageQueue/Qos, messagequeue.qos);
+  PUT_CONFIG_UINT(MessageQueue/KeepAlive, messagequeue.keepalive);
+  PUT_CONFIG_UINT(MessageQueue/MaxInFlight, messagequeue.maxinflight);
 
   return result;
 }
 
+/*
+ * Settings which are read each time they are used may be changed while the
+ * service runs. Returns false if the named setting is not one of these.
+ */
+
+static bool update_config_setting
+  (edgex_device_service *svc, const edgex_nvpairs *pair, edgex_error *err)
+{
+  const char *name = pair->name;
+  iot_logging_client *lc = svc->logger;
+  bool *flag = NULL;
+  uint32_t *num = NULL;
+
+  if (strcasecmp (name, "Device/DataTransform") == 0)
+  {
+    flag = &svc->config.device.datatransform;
+  }
+  else if (strcasecmp (name, "Device/Discovery") == 0)
+  {
+    flag = &svc->config.device.discovery;
+  }
+  else if (strcasecmp (name, "Device/CombineScheduledEvents") == 0)
+  {
+    flag = &svc->config.device.combinescheduledevents;
+  }
+  else if (strcasecmp (name, "Device/MaxCmdOps") == 0)
+  {
+    num = &svc->config.device.maxcmdops;
+  }
+  else if (strcasecmp (name, "Device/MaxCmdResultLen") == 0)
+  {
+    num = &svc->config.device.maxcmdresultlen;
+  }
+  else if (strcasecmp (name, "Device/AllCommandTimeout") == 0)
+  {
+    num = &svc->config.device.allcommandtimeout;
+  }
+  else if (strcasecmp (name, "Service/ReadMaxLimit") == 0)
+  {
+    num = &svc->config.service.readmaxlimit;
+  }
+
+  if (flag)
+  {
+    bool val = get_nv_config_bool (pair, name, *flag);
+    __atomic_store_n (flag, val, __ATOMIC_RELAXED);
+  }
+  else if (num)
+  {
+    uint32_t val = get_nv_config_uint32 (lc, pair, name, err);
+    if (err->code == 0)
+    {
+      __atomic_store_n (num, val, __ATOMIC_RELAXED);
+    }
+  }
+  return flag || num;
+}
+
+void edgex_device_updateConfigNV
+  (edgex_device_service *svc, const edgex_nvpairs *config)
+{
+  edgex_nvpairs *current = edgex_device_getConfig (svc);
+
+  for (const edgex_nvpairs *iter = config; iter; iter = iter->next)
+  {
+    edgex_error err = EDGEX_OK;
+    char *was = get_nv_config_string (current, iter->name);
+    if (was && strcmp (was, iter->value) == 0)
+    {
+      free (was);
+      continue;
+    }
+    if (update_config_setting (svc, iter, &err))
+    {
+      if (err.code == 0)
+      {
+        __atomic_add_fetch (&svc->config.generation, 1, __ATOMIC_RELEASE);
+        iot_log_info
+          (svc->logger, "Configuration %s set to %s", iter->name, iter->value);
+      }
+    }
+    else
+    {
+      iot_log_info
+      (
+        svc->logger,
+        "Configuration %s changed to %s, will apply when the service restarts",
+        iter->name, iter->value
+      );
+    }
+    free (was);
+  }
+  edgex_nvpairs_free (current);
+}
+
 void edgex_device_validateConfig (edgex_device_service *svc, edgex_error *err)
 {
   if (svc->config.endpoints.data.host == 0)
@@ -738,6 +1440,74 @@ void edgex_device_validateConfig (edgex_device_service *svc, edgex_error *err)
     iot_log_error (svc->logger, "config: clients.metadata port unset");
     *err = EDGEX_BAD_CONFIG;
   }
+  const char *policy = svc->config.device.eventqueuepolicy;
+  if (policy && *policy && strcasecmp (policy, "Block") &&
+      strcasecmp (policy, "DropOldest") && strcasecmp (policy, "DropNewest") &&
+      strcasecmp (policy, "Spill"))
+  {
+    iot_log_error
+      (svc->logger, "config: device.eventqueuepolicy %s not recognised", policy);
+    *err = EDGEX_BAD_CONFIG;
+  }
+  const char *enc = svc->config.device.eventencoding;
+  if (enc && *enc && strcasecmp (enc, "JSON") && strcasecmp (enc, "CBOR"))
+  {
+    iot_log_error
+      (svc->logger, "config: device.eventencoding %s not recognised", enc);
+    *err = EDGEX_BAD_CONFIG;
+  }
+  const char *mqtype = svc->config.messagequeue.type;
+  if (mqtype && *mqtype && strcasecmp (mqtype, "HTTP"))
+  {
+    if (strcasecmp (mqtype, "MQTT"))
+    {
+      iot_log_error
+        (svc->logger, "config: messagequeue.type %s not recognised", mqtype);
+      *err = EDGEX_BAD_CONFIG;
+    }
+    else if
+      (svc->config.messagequeue.host == NULL || !*svc->config.messagequeue.host)
+    {
+      iot_log_error (svc->logger, "config: messagequeue.host unset");
+      *err = EDGEX_BAD_CONFIG;
+    }
+    if (svc->config.messagequeue.qos > 1)
+    {
+      iot_log_error (svc->logger, "config: messagequeue.qos must be 0 or 1");
+      *err = EDGEX_BAD_CONFIG;
+    }
+  }
+  const char *comp = svc->config.device.eventcompression;
+  if (comp && *comp && strcasecmp (comp, "None") && strcasecmp (comp, "Gzip"))
+  {
+    iot_log_error
+      (svc->logger, "config: device.eventcompression %s not recognised", comp);
+    *err = EDGEX_BAD_CONFIG;
+  }
+  if (policy && strcasecmp (policy, "Spill") == 0 &&
+      (svc->config.device.eventqueuespilldir == NULL ||
+       *svc->config.device.eventqueuespilldir == '\0'))
+  {
+    iot_log_error
+      (svc->logger, "config: Spill policy requires device.eventqueuespilldir");
+    *err = EDGEX_BAD_CONFIG;
+  }
+  if (svc->config.device.onchangedeadband < 0.0 ||
+      svc->config.device.onchangepercent < 0.0)
+  {
+    iot_log_error
+      (svc->logger, "config: device.onchange thresholds may not be negative");
+    *err = EDGEX_BAD_CONFIG;
+  }
+  if (svc->config.device.historysize > EDGEX_HISTORY_MAXSIZE)
+  {
+    iot_log_error
+    (
+      svc->logger, "config: device.historysize may not exceed %u",
+      EDGEX_HISTORY_MAXSIZE
+    );
+    *err = EDGEX_BAD_CONFIG;
+  }
   const edgex_device_scheduleeventinfo *evt;
   const char *key;
   edgex_map_iter i = edgex_map_iter (svc->config.scheduleevents);
@@ -785,6 +1555,7 @@ void dumpArray (iot_logging_client *log, const char *name, char **list)
 #define DUMP_UNS(TEXT, VAR) iot_log_debug (svc->logger, TEXT " = %u", svc->config.VAR)
 #define DUMP_LIT(TEXT) iot_log_debug (svc->logger, TEXT)
 #define DUMP_ARR(TEXT, VAR) dumpArray(svc->logger, TEXT, svc->config.VAR)
+#define DUMP_DBL(TEXT, VAR) iot_log_debug (svc->logger, TEXT " = %g", svc->config.VAR)
 #define DUMP_BOO(TEXT, VAR) iot_log_debug (svc->logger, TEXT " = %s", svc->config.VAR ? "true" : "false")
 
 void edgex_device_dumpConfig (edgex_device_service *svc)
@@ -799,20 +1570,47 @@ void edgex_device_dumpConfig (edgex_device_service *svc)
   DUMP_LIT ("   [Clients.Data]");
   DUMP_STR ("      Host", endpoints.data.host);
   DUMP_UNS ("      Port", endpoints.data.port);
+  DUMP_STR ("      Name", endpoints.data.name);
   DUMP_LIT ("   [Clients.Metadata]");
   DUMP_STR ("      Host", endpoints.metadata.host);
   DUMP_UNS ("      Port", endpoints.metadata.port);
+  DUMP_STR ("      Name", endpoints.metadata.name);
   DUMP_LIT ("[Logging]");
   DUMP_STR ("   RemoteURL", logging.remoteurl);
   DUMP_STR ("   File", logging.file);
+  DUMP_UNS ("   QueueSize", logging.queuesize);
+  DUMP_UNS ("   MaxBatch", logging.maxbatch);
+  DUMP_UNS ("   RateLimit", logging.ratelimit);
+  DUMP_LIT ("[MessageQueue]");
+  DUMP_STR ("   Type", messagequeue.type);
+  DUMP_STR ("   Host", messagequeue.host);
+  DUMP_UNS ("   Port", messagequeue.port);
+  DUMP_STR ("   Topic", messagequeue.topic);
+  DUMP_STR ("   ClientId", messagequeue.clientid);
+  DUMP_STR ("   Username", messagequeue.username);
+  DUMP_UNS ("   Qos", messagequeue.qos);
+  DUMP_UNS ("   KeepAlive", messagequeue.keepalive);
+  DUMP_UNS ("   MaxInFlight", messagequeue.maxinflight);
   DUMP_LIT ("[Service]");
   DUMP_STR ("   Host", service.host);
   DUMP_UNS ("   Port", service.port);
   DUMP_UNS ("   Timeout", service.timeout);
+  DUMP_UNS ("   RequestTimeout", service.requesttimeout);
   DUMP_UNS ("   ConnectRetries", service.connectretries);
+  DUMP_UNS ("   BackoffLimit", service.backofflimit);
+  DUMP_UNS ("   CircuitThreshold", service.circuitthreshold);
+  DUMP_BOO ("   Http2", service.http2);
   DUMP_STR ("   StartupMsg", service.startupmsg);
   DUMP_UNS ("   ReadMaxLimit", service.readmaxlimit);
   DUMP_STR ("   CheckInterval", service.checkinterval);
+  DUMP_UNS ("   ServerThreads", service.serverthreads);
+  DUMP_UNS ("   WorkerThreads", service.workerthreads);
+  DUMP_STR ("   WorkerCPUs", service.workercpus);
+  DUMP_UNS ("   MaxConnections", service.maxconnections);
+  DUMP_UNS ("   MaxConnectionsPerIp", service.maxconnectionsperip);
+  DUMP_UNS ("   ConnectionTimeout", service.connectiontimeout);
+  DUMP_UNS ("   ListenBacklog", service.listenbacklog);
+  DUMP_UNS ("   MaxRequestSize", service.maxrequestsize);
   DUMP_ARR ("   Labels", service.labels);
   DUMP_LIT ("[Device]");
   DUMP_BOO ("   DataTransform", device.datatransform);
@@ -825,6 +1623,36 @@ void edgex_device_dumpConfig (edgex_device_service *svc)
   DUMP_STR ("   RemoveCmdArgs", device.removecmdargs);
   DUMP_STR ("   ProfilesDir", device.profilesdir);
   DUMP_BOO ("   SendReadingsOnChanged", device.sendreadingsonchanged);
+  DUMP_DBL ("   OnChangeDeadband", device.onchangedeadband);
+  DUMP_DBL ("   OnChangePercent", device.onchangepercent);
+  DUMP_UNS ("   OnChangeRefresh", device.onchangerefresh);
+  DUMP_UNS ("   EventBatchSize", device.eventbatchsize);
+  DUMP_UNS ("   EventBatchTimeout", device.eventbatchtimeout);
+  DUMP_UNS ("   EventQueueSize", device.eventqueuesize);
+  DUMP_STR ("   EventQueuePolicy", device.eventqueuepolicy);
+  DUMP_STR ("   EventEncoding", device.eventencoding);
+  DUMP_STR ("   EventCompression", device.eventcompression);
+  DUMP_UNS ("   EventCompressionMin", device.eventcompressionmin);
+  DUMP_STR ("   EventQueueSpillDir", device.eventqueuespilldir);
+  DUMP_STR ("   EventLogDir", device.eventlogdir);
+  DUMP_UNS ("   EventLogLimit", device.eventloglimit);
+  DUMP_UNS ("   EventLogRate", device.eventlograte);
+  DUMP_STR ("   SnapshotFile", device.snapshotfile);
+  DUMP_STR ("   Clock", device.clock);
+  DUMP_UNS ("   EventQueueThreads", device.eventqueuethreads);
+  DUMP_UNS ("   AllCommandThreads", device.allcommandthreads);
+  DUMP_UNS ("   AllCommandTimeout", device.allcommandtimeout);
+  DUMP_BOO ("   MergeSchedules", device.mergeschedules);
+  DUMP_BOO ("   CombineScheduledEvents", device.combinescheduledevents);
+  DUMP_BOO ("   PutBatching", device.putbatching);
+  DUMP_UNS ("   PutBatchWindow", device.putbatchwindow);
+  DUMP_BOO ("   SerializeCommands", device.serializecommands);
+  DUMP_BOO ("   ConfigCache", device.configcache);
+  DUMP_UNS ("   HistorySize", device.historysize);
+  DUMP_UNS ("   StatusInterval", device.statusinterval);
+  DUMP_BOO ("   UpdateLastConnected", device.updatelastconnected);
+  DUMP_BOO ("   WatchProfiles", device.watchprofiles);
+  DUMP_BOO ("   OriginNanos", device.originnanos);
 
   edgex_nvpairs *iter = svc->config.driverconf;
   if (iter)
@@ -837,6 +1665,17 @@ void edgex_device_dumpConfig (edgex_device_service *svc)
     iter = iter->next;
   }
 
+  iter = svc->config.readcache;
+  if (iter)
+  {
+    DUMP_LIT ("[ReadCache]");
+  }
+  while (iter)
+  {
+    iot_log_debug (svc->logger, "  %s = %s", iter->name, iter->value);
+    iter = iter->next;
+  }
+
   edgex_map_iter i = edgex_map_iter (svc->config.schedules);
   while ((key = edgex_map_next (&svc->config.schedules, &i)))
   {
@@ -879,17 +1718,33 @@ void edgex_device_freeConfig (edgex_device_service *svc)
   const char *key;
 
   free (svc->config.endpoints.data.host);
+  free (svc->config.endpoints.data.name);
   free (svc->config.endpoints.metadata.host);
+  free (svc->config.endpoints.metadata.name);
   free (svc->config.logging.file);
   free (svc->config.logging.remoteurl);
+  free (svc->config.messagequeue.type);
+  free (svc->config.messagequeue.host);
+  free (svc->config.messagequeue.topic);
+  free (svc->config.messagequeue.clientid);
+  free (svc->config.messagequeue.username);
+  free (svc->config.messagequeue.password);
   free (svc->config.service.host);
   free (svc->config.service.startupmsg);
   free (svc->config.service.checkinterval);
+  free (svc->config.service.workercpus);
   free (svc->config.device.initcmd);
   free (svc->config.device.initcmdargs);
   free (svc->config.device.removecmd);
   free (svc->config.device.removecmdargs);
   free (svc->config.device.profilesdir);
+  free (svc->config.device.eventqueuepolicy);
+  free (svc->config.device.eventcompression);
+  free (svc->config.device.eventencoding);
+  free (svc->config.device.eventqueuespilldir);
+  free (svc->config.device.eventlogdir);
+  free (svc->config.device.snapshotfile);
+  free (svc->config.device.clock);
 
   for (int i = 0; svc->config.service.labels[i]; i++)
   {
@@ -898,6 +1753,10 @@ void edgex_device_freeConfig (edgex_device_service *svc)
   free (svc->config.service.labels);
 
   edgex_nvpairs_free (svc->config.driverconf);
+  edgex_nvpairs_free (svc->config.readcache);
+
+  free (svc->configreply.json);
+  svc->configreply.json = NULL;
 
   iter = edgex_map_iter (svc->config.schedules);
   while ((key = edgex_map_next (&svc->config.schedules, &iter)))
@@ -931,19 +1790,8 @@ void edgex_device_freeConfig (edgex_device_service *svc)
   edgex_map_deinit (&svc->config.watchers);
 }
 
-int edgex_device_handler_config
-(
-  void *ctx,
-  char *url,
-  edgex_http_method method,
-  const char *upload_data,
-  size_t upload_data_size,
-  char **reply,
-  const char **reply_type
-)
+static JSON_Value *configJson (edgex_device_service *svc)
 {
-  edgex_device_service *svc = (edgex_device_service *)ctx;
-
   JSON_Value *val = json_value_init_object ();
   JSON_Object *obj = json_value_get_object (val);
 
@@ -954,12 +1802,14 @@ int edgex_device_handler_config
   JSON_Object *mobj = json_value_get_object (mval);
   json_object_set_string (mobj, "Host", svc->config.endpoints.metadata.host);
   json_object_set_number (mobj, "Port", svc->config.endpoints.metadata.port);
+  json_object_set_string (mobj, "Name", svc->config.endpoints.metadata.name);
   json_object_set_value (cobj, "Metadata", mval);
 
   JSON_Value *dval = json_value_init_object ();
   JSON_Object *dobj = json_value_get_object (dval);
   json_object_set_string (dobj, "Host", svc->config.endpoints.data.host);
   json_object_set_number (dobj, "Port", svc->config.endpoints.data.port);
+  json_object_set_string (dobj, "Name", svc->config.endpoints.data.name);
   json_object_set_value (cobj, "Data", dval);
 
   json_object_set_value (obj, "Clients", cval);
@@ -968,20 +1818,60 @@ int edgex_device_handler_config
   JSON_Object *lobj = json_value_get_object (lval);
   json_object_set_string (lobj, "File", svc->config.logging.file);
   json_object_set_string (lobj, "RemoteURL", svc->config.logging.remoteurl);
+  json_object_set_number (lobj, "QueueSize", svc->config.logging.queuesize);
+  json_object_set_number (lobj, "MaxBatch", svc->config.logging.maxbatch);
+  json_object_set_number (lobj, "RateLimit", svc->config.logging.ratelimit);
   json_object_set_value (obj, "Logging", lval);
 
+  JSON_Value *qval = json_value_init_object ();
+  JSON_Object *qobj = json_value_get_object (qval);
+  const edgex_device_messagequeueinfo *mq = &svc->config.messagequeue;
+  json_object_set_string (qobj, "Type", mq->type);
+  json_object_set_string (qobj, "Host", mq->host);
+  json_object_set_number (qobj, "Port", mq->port);
+  json_object_set_string (qobj, "Topic", mq->topic);
+  json_object_set_string (qobj, "ClientId", mq->clientid);
+  json_object_set_string (qobj, "Username", mq->username);
+  json_object_set_number (qobj, "Qos", mq->qos);
+  json_object_set_number (qobj, "KeepAlive", mq->keepalive);
+  json_object_set_number (qobj, "MaxInFlight", mq->maxinflight);
+  json_object_set_value (obj, "MessageQueue", qval);
+
   JSON_Value *sval = json_value_init_object ();
   JSON_Object *sobj = json_value_get_object (sval);
   json_object_set_string (sobj, "Host", svc->config.service.host);
   json_object_set_number (sobj, "Port", svc->config.service.port);
   json_object_set_number (sobj, "Timeout", svc->config.service.timeout);
+  json_object_set_number
+    (sobj, "RequestTimeout", svc->config.service.requesttimeout);
   json_object_set_number
     (sobj, "ConnectRetries", svc->config.service.connectretries);
+  json_object_set_number
+    (sobj, "BackoffLimit", svc->config.service.backofflimit);
+  json_object_set_number
+    (sobj, "CircuitThreshold", svc->config.service.circuitthreshold);
+  json_object_set_boolean (sobj, "Http2", svc->config.service.http2);
   json_object_set_string (sobj, "StartupMsg", svc->config.service.startupmsg);
   json_object_set_number
     (sobj, "ReadMaxLimit", svc->config.service.readmaxlimit);
   json_object_set_string
     (sobj, "CheckInterval", svc->config.service.checkinterval);
+  json_object_set_number
+    (sobj, "ServerThreads", svc->config.service.serverthreads);
+  json_object_set_number
+    (sobj, "WorkerThreads", svc->config.service.workerthreads);
+  json_object_set_string
+    (sobj, "WorkerCPUs", svc->config.service.workercpus);
+  json_object_set_number
+    (sobj, "MaxConnections", svc->config.service.maxconnections);
+  json_object_set_number
+    (sobj, "MaxConnectionsPerIp", svc->config.service.maxconnectionsperip);
+  json_object_set_number
+    (sobj, "ConnectionTimeout", svc->config.service.connectiontimeout);
+  json_object_set_number
+    (sobj, "ListenBacklog", svc->config.service.listenbacklog);
+  json_object_set_number
+    (sobj, "MaxRequestSize", svc->config.service.maxrequestsize);
 
   lval = json_value_init_array ();
   JSON_Array *larr = json_value_get_array (lval);
@@ -1009,6 +1899,65 @@ int edgex_device_handler_config
   json_object_set_string (dobj, "ProfilesDir", svc->config.device.profilesdir);
   json_object_set_boolean
     (dobj, "SendReadingsOnChanged", svc->config.device.sendreadingsonchanged);
+  json_object_set_number
+    (dobj, "OnChangeDeadband", svc->config.device.onchangedeadband);
+  json_object_set_number
+    (dobj, "OnChangePercent", svc->config.device.onchangepercent);
+  json_object_set_number
+    (dobj, "OnChangeRefresh", svc->config.device.onchangerefresh);
+  json_object_set_number
+    (dobj, "EventBatchSize", svc->config.device.eventbatchsize);
+  json_object_set_number
+    (dobj, "EventBatchTimeout", svc->config.device.eventbatchtimeout);
+  json_object_set_number
+    (dobj, "EventQueueSize", svc->config.device.eventqueuesize);
+  json_object_set_string
+    (dobj, "EventQueuePolicy", svc->config.device.eventqueuepolicy);
+  json_object_set_string
+    (dobj, "EventEncoding", svc->config.device.eventencoding);
+  json_object_set_string
+    (dobj, "EventCompression", svc->config.device.eventcompression);
+  json_object_set_number
+    (dobj, "EventCompressionMin", svc->config.device.eventcompressionmin);
+  json_object_set_string
+    (dobj, "EventQueueSpillDir", svc->config.device.eventqueuespilldir);
+  json_object_set_string
+    (dobj, "EventLogDir", svc->config.device.eventlogdir);
+  json_object_set_number
+    (dobj, "EventLogLimit", svc->config.device.eventloglimit);
+  json_object_set_number
+    (dobj, "EventLogRate", svc->config.device.eventlograte);
+  json_object_set_string
+    (dobj, "SnapshotFile", svc->config.device.snapshotfile);
+  json_object_set_string (dobj, "Clock", svc->config.device.clock);
+  json_object_set_number
+    (dobj, "EventQueueThreads", svc->config.device.eventqueuethreads);
+  json_object_set_number
+    (dobj, "AllCommandThreads", svc->config.device.allcommandthreads);
+  json_object_set_number
+    (dobj, "AllCommandTimeout", svc->config.device.allcommandtimeout);
+  json_object_set_boolean
+    (dobj, "MergeSchedules", svc->config.device.mergeschedules);
+  json_object_set_boolean
+    (dobj, "CombineScheduledEvents", svc->config.device.combinescheduledevents);
+  json_object_set_boolean
+    (dobj, "PutBatching", svc->config.device.putbatching);
+  json_object_set_number
+    (dobj, "PutBatchWindow", svc->config.device.putbatchwindow);
+  json_object_set_boolean
+    (dobj, "SerializeCommands", svc->config.device.serializecommands);
+  json_object_set_boolean
+    (dobj, "ConfigCache", svc->config.device.configcache);
+  json_object_set_number
+    (dobj, "HistorySize", svc->config.device.historysize);
+  json_object_set_number
+    (dobj, "StatusInterval", svc->config.device.statusinterval);
+  json_object_set_boolean
+    (dobj, "UpdateLastConnected", svc->config.device.updatelastconnected);
+  json_object_set_boolean
+    (dobj, "WatchProfiles", svc->config.device.watchprofiles);
+  json_object_set_boolean
+    (dobj, "OriginNanos", svc->config.device.originnanos);
   json_object_set_value (obj, "Device", dval);
 
   edgex_nvpairs *iter = svc->config.driverconf;
@@ -1024,11 +1973,87 @@ int edgex_device_handler_config
     json_object_set_value (obj, "Driver", dval);
   }
 
-  *reply = json_serialize_to_string (val);
-  *reply_type = "application/json";
+  iter = svc->config.readcache;
+  if (iter)
+  {
+    dval = json_value_init_object ();
+    dobj = json_value_get_object (dval);
+    while (iter)
+    {
+      json_object_set_number (dobj, iter->name, strtoull (iter->value, NULL, 10));
+      iter = iter->next;
+    }
+    json_object_set_value (obj, "ReadCache", dval);
+  }
+
+  return val;
+}
+
+/* Serialize the configuration, with a tag from a hash of the text */
+
+static void updateConfigReply (edgex_device_service *svc, uint32_t gen)
+{
+  edgex_device_configreply *c = &svc->configreply;
+  JSON_Value *val = configJson (svc);
+  size_t sz = json_serialization_size (val);
+
+  free (c->json);
+  c->json = malloc (sz ? sz : 1);
+  if (sz == 0 || json_serialize_to_buffer (val, c->json, sz) != JSONSuccess)
+  {
+    sz = 1;
+    c->json[0] = '\0';
+  }
   json_value_free (val);
+  c->len = sz - 1;
+  c->generation = gen;
+  snprintf
+  (
+    c->etag, sizeof (c->etag), "\"%016" PRIx64 "\"",
+    edgex_confcache_hash (EDGEX_CONFCACHE_HASH_INIT, c->json, c->len)
+  );
+}
+
+int edgex_device_handler_config
+(
+  void *ctx,
+  const edgex_http_params *params,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_http_response *reply
+)
+{
+  edgex_device_service *svc = (edgex_device_service *)ctx;
+  edgex_device_configreply *c = &svc->configreply;
+  const char *match = edgex_http_request_header (reply, "If-None-Match");
+  int result = MHD_HTTP_OK;
+
+  /*
+   * The reply is rebuilt only if a setting has changed since it was last
+   * made. A change during the rebuild leaves the generation ahead of the
+   * reply, so it is rebuilt again on the next request.
+   */
+
+  uint32_t gen = __atomic_load_n (&svc->config.generation, __ATOMIC_ACQUIRE);
+  pthread_mutex_lock (&c->lock);
+  if (c->json == NULL || c->generation != gen)
+  {
+    updateConfigReply (svc, gen);
+  }
+  strcpy (reply->etag, c->etag);
+  reply->type = "application/json";
+  if (match && edgex_http_etag_match (match, c->etag))
+  {
+    result = MHD_HTTP_NOT_MODIFIED;
+  }
+  else
+  {
+    edgex_strbuf_append (&reply->body, c->json, c->len);
+  }
+  pthread_mutex_unlock (&c->lock);
 
-  return MHD_HTTP_OK;
+  return result;
 }
 
 void edgex_device_process_configured_devices
@@ -1038,7 +2063,7 @@ void edgex_device_process_configured_devices
   {
     char *devname;
     const char *raw;
-    char **existing;
+    bool existing;
     char *profile_name;
     char *description;
     edgex_addressable *address;
@@ -1047,98 +2072,119 @@ void edgex_device_process_configured_devices
     toml_table_t *table;
     toml_table_t *addtable;
     toml_array_t *arr;
+    edgex_error e = EDGEX_OK;
+    edgex_device_add_request *reqs = NULL;
+    unsigned nreqs = 0;
     int n = 0;
 
     while ((table = toml_table_at (devs, n++)))
     {
       raw = toml_raw_in (table, "Name");
       toml_rtos2 (raw, &devname);
-      pthread_rwlock_rdlock (&svc->deviceslock);
-      existing = edgex_map_get (&svc->name_to_id, devname);
-      pthread_rwlock_unlock (&svc->deviceslock);
-      if (existing == NULL)
+      existing = edgex_devmap_findbyname
+        (edgex_devreg_acquire (svc->devices), devname) != NULL;
+      edgex_devreg_release (svc->devices);
+      if (existing)
       {
-        /* Addressable */
+        free (devname);
+        continue;
+      }
 
-        addtable = toml_table_in (table, "Addressable");
-        if (addtable)
+      /* Addressable */
+
+      addtable = toml_table_in (table, "Addressable");
+      if (addtable == NULL)
+      {
+        iot_log_error
+          (svc->logger, "No Addressable section for device %s", devname);
+        e = EDGEX_BAD_CONFIG;
+        free (devname);
+        break;
+      }
+      address = malloc (sizeof (edgex_addressable));
+      memset (address, 0, sizeof (edgex_addressable));
+      raw = toml_raw_in (addtable, "Name");
+      toml_rtos2 (raw, &address->name);
+      raw = toml_raw_in (addtable, "Address");
+      toml_rtos2 (raw, &address->address);
+      raw = toml_raw_in (addtable, "Method");
+      toml_rtos2 (raw, &address->method);
+      raw = toml_raw_in (addtable, "Path");
+      toml_rtos2 (raw, &address->path);
+      raw = toml_raw_in (addtable, "User");
+      toml_rtos2 (raw, &address->user);
+      raw = toml_raw_in (addtable, "Password");
+      toml_rtos2 (raw, &address->password);
+      raw = toml_raw_in (addtable, "Protocol");
+      toml_rtos2 (raw, &address->protocol);
+      raw = toml_raw_in (addtable, "Publisher");
+      toml_rtos2 (raw, &address->publisher);
+      raw = toml_raw_in (addtable, "Topic");
+      toml_rtos2 (raw, &address->topic);
+      raw = toml_raw_in (addtable, "Port");
+      if (raw)
+      {
+        int64_t p;
+        toml_rtoi (raw, &p);
+        if (p > 0)
         {
-          address = malloc (sizeof (edgex_addressable));
-          memset (address, 0, sizeof (edgex_addressable));
-          raw = toml_raw_in (addtable, "Name");
-          toml_rtos2 (raw, &address->name);
-          raw = toml_raw_in (addtable, "Address");
-          toml_rtos2 (raw, &address->address);
-          raw = toml_raw_in (addtable, "Method");
-          toml_rtos2 (raw, &address->method);
-          raw = toml_raw_in (addtable, "Path");
-          toml_rtos2 (raw, &address->path);
-          raw = toml_raw_in (addtable, "User");
-          toml_rtos2 (raw, &address->user);
-          raw = toml_raw_in (addtable, "Password");
-          toml_rtos2 (raw, &address->password);
-          raw = toml_raw_in (addtable, "Protocol");
-          toml_rtos2 (raw, &address->protocol);
-          raw = toml_raw_in (addtable, "Publisher");
-          toml_rtos2 (raw, &address->publisher);
-          raw = toml_raw_in (addtable, "Topic");
-          toml_rtos2 (raw, &address->topic);
-          raw = toml_raw_in (addtable, "Port");
-          if (raw)
-          {
-            int64_t p;
-            toml_rtoi (raw, &p);
-            if (p > 0)
-            {
-              address->port = p;
-            }
-          }
+          address->port = p;
+        }
+      }
 
-          /* The rest of the device */
-
-          labels = NULL;
-          profile_name = NULL;
-          description = NULL;
-          raw = toml_raw_in (table, "Profile");
-          toml_rtos2 (raw, &profile_name);
-          raw = toml_raw_in (table, "Description");
-          toml_rtos2 (raw, &description);
-          arr = toml_array_in (table, "Labels");
-          if (arr)
-          {
-            for (int n = 0; (raw = toml_raw_at (arr, n)); n++)
-            {
-              newlabel = malloc (sizeof (edgex_strings));
-              newlabel->next = labels;
-              toml_rtos2 (raw, &newlabel->str);
-              labels = newlabel;
-            }
-          }
+      /* The rest of the device */
+
+      labels = NULL;
+      profile_name = NULL;
+      description = NULL;
+      raw = toml_raw_in (table, "Profile");
+      toml_rtos2 (raw, &profile_name);
+      raw = toml_raw_in (table, "Description");
+      toml_rtos2 (raw, &description);
+      arr = toml_array_in (table, "Labels");
+      if (arr)
+      {
+        for (int n = 0; (raw = toml_raw_at (arr, n)); n++)
+        {
+          newlabel = malloc (sizeof (edgex_strings));
+          newlabel->next = labels;
+          toml_rtos2 (raw, &newlabel->str);
+          labels = newlabel;
+        }
+      }
 
-          *err = EDGEX_OK;
-          free (edgex_device_add_device
-            (svc, devname, description, labels, profile_name, address, err));
+      reqs = realloc (reqs, (nreqs + 1) * sizeof (*reqs));
+      memset (&reqs[nreqs], 0, sizeof (*reqs));
+      reqs[nreqs].name = devname;
+      reqs[nreqs].description = description;
+      reqs[nreqs].labels = labels;
+      reqs[nreqs].profile_name = profile_name;
+      reqs[nreqs].address = address;
+      nreqs++;
+    }
 
-          edgex_strings_free (labels);
-          edgex_addressable_free (address);
-          free (profile_name);
-          free (description);
+    /* Add the devices read so far in one batch */
 
-          if (err->code)
-          {
-            iot_log_error (svc->logger, "Error registering device %s", devname);
-            break;
-          }
-        }
-        else
-        {
-          iot_log_error
-            (svc->logger, "No Addressable section for device %s", devname);
-          *err = EDGEX_BAD_CONFIG;
-          break;
-        }
+    *err = EDGEX_OK;
+    edgex_device_add_devices (svc, nreqs, reqs, err);
+    for (unsigned i = 0; i < nreqs; i++)
+    {
+      if (reqs[i].err.code)
+      {
+        iot_log_error
+          (svc->logger, "Error registering device %s", reqs[i].name);
       }
-      free (devname);
+      free (reqs[i].id);
+      free ((char *) reqs[i].name);
+      free ((char *) reqs[i].description);
+      free ((char *) reqs[i].profile_name);
+      edgex_strings_free ((edgex_strings *) reqs[i].labels);
+      edgex_addressable_free (reqs[i].address);
+    }
+    free (reqs);
+    if (err->code == 0)
+    {
+      *err = e;
     }
   }
 }
@@ -14,22 +14,39 @@
 #include "toml.h"
 #include "map.h"
 
+#include <pthread.h>
+
 typedef struct edgex_device_serviceinfo
 {
   char *host;
   uint16_t port;
   uint32_t connectretries;
+  uint32_t backofflimit;
+  uint32_t circuitthreshold;
+  bool http2;
   char **labels;
   char *startupmsg;
   uint32_t readmaxlimit;
   uint32_t timeout;
+  uint32_t requesttimeout;
   char *checkinterval;
+  uint32_t serverthreads;
+  uint32_t maxconnections;
+  uint32_t maxconnectionsperip;
+  uint32_t connectiontimeout;
+  uint32_t listenbacklog;
+  uint32_t maxrequestsize;
+  uint32_t workerthreads;
+  char *workercpus;
 } edgex_device_serviceinfo;
 
 typedef struct edgex_device_service_endpoint
 {
   char *host;
   uint16_t port;
+  char *name;
+  struct edgex_endpoint_pool *pool;
+  uint32_t compressmin;
 } edgex_device_service_endpoint;
 
 typedef struct edgex_service_endpoints
@@ -37,6 +54,7 @@ typedef struct edgex_service_endpoints
   edgex_device_service_endpoint data;
   edgex_device_service_endpoint metadata;
   edgex_device_service_endpoint command;
+  struct edgex_transport *transport;
 } edgex_service_endpoints;
 
 typedef struct edgex_device_deviceinfo
@@ -51,12 +69,59 @@ typedef struct edgex_device_deviceinfo
   char *removecmdargs;
   char *profilesdir;
   bool sendreadingsonchanged;
+  double onchangedeadband;
+  double onchangepercent;
+  uint32_t onchangerefresh;
+  uint32_t eventbatchsize;
+  uint32_t eventbatchtimeout;
+  uint32_t eventqueuesize;
+  char *eventqueuepolicy;
+  char *eventencoding;
+  char *eventcompression;
+  uint32_t eventcompressionmin;
+  char *eventqueuespilldir;
+  char *eventlogdir;
+  uint32_t eventloglimit;
+  uint32_t eventlograte;
+  uint32_t eventqueuethreads;
+  uint32_t allcommandthreads;
+  uint32_t allcommandtimeout;
+  bool mergeschedules;
+  bool combinescheduledevents;
+  bool putbatching;
+  uint32_t putbatchwindow;
+  bool serializecommands;
+  bool configcache;
+  uint32_t historysize;
+  uint32_t statusinterval;
+  bool updatelastconnected;
+  bool watchprofiles;
+  bool originnanos;
+  char *clock;
+  char *snapshotfile;
 } edgex_device_deviceinfo;
 
+typedef struct edgex_device_messagequeueinfo
+{
+  char *type;
+  char *host;
+  uint16_t port;
+  char *topic;
+  char *clientid;
+  char *username;
+  char *password;
+  uint32_t qos;
+  uint32_t keepalive;
+  uint32_t maxinflight;
+} edgex_device_messagequeueinfo;
+
 typedef struct edgex_device_logginginfo
 {
   char *file;
   char *remoteurl;
+  uint32_t queuesize;
+  uint32_t maxbatch;
+  uint32_t ratelimit;
 } edgex_device_logginginfo;
 
 typedef struct edgex_device_scheduleeventinfo
@@ -82,21 +147,50 @@ typedef struct edgex_device_config
   edgex_service_endpoints endpoints;
   edgex_device_deviceinfo device;
   edgex_device_logginginfo logging;
+  edgex_device_messagequeueinfo messagequeue;
   edgex_nvpairs *driverconf;
+  edgex_nvpairs *readcache;
   edgex_map_string schedules;
   edgex_map_device_scheduleeventinfo scheduleevents;
   edgex_map_device_watcherinfo watchers;
+
+  /* Incremented whenever a setting is changed while the service runs */
+
+  uint32_t generation;
 } edgex_device_config;
 
+/*
+ * The serialized reply to GET /config, with its entity tag, kept until the
+ * configuration generation changes.
+ */
+
+typedef struct edgex_device_configreply
+{
+  pthread_mutex_t lock;
+  char *json;
+  size_t len;
+  uint32_t generation;
+  char etag[EDGEX_HTTP_ETAG_SIZE];
+} edgex_device_configreply;
+
+/*
+ * Read the configuration file (configuration[-profile].toml) in dir and
+ * populate the service's configuration from it. Returns the parsed file, or
+ * NULL if the configuration was taken from a snapshot of an unchanged file
+ * (see Device/ConfigCache) rather than by parsing it.
+ */
+
 toml_table_t *edgex_device_loadConfig
 (
-  iot_logging_client *lc,
+  edgex_device_service *svc,
   const char *dir,
   const char *profile,
   edgex_error *err
 );
 
-const char *edgex_device_config_parse8601 (const char *str, int *result);
+/* Parse an ISO8601 period, giving its length in nanoseconds */
+
+const char *edgex_device_config_parse8601 (const char *str, uint64_t *result);
 
 void edgex_device_populateConfig
   (edgex_device_service *svc, toml_table_t *config, edgex_error *err);
@@ -104,6 +198,14 @@ void edgex_device_populateConfig
 void edgex_device_populateConfigNV
   (edgex_device_service *svc, const edgex_nvpairs *config, edgex_error *err);
 
+/*
+ * Apply configuration values changed while the service is running. Those
+ * which can not be changed at run time are logged, and apply on restart.
+ */
+
+void edgex_device_updateConfigNV
+  (edgex_device_service *svc, const edgex_nvpairs *config);
+
 void edgex_device_validateConfig (edgex_device_service *svc, edgex_error *err);
 
 edgex_nvpairs *edgex_device_getConfig (const edgex_device_service *svc);
@@ -118,12 +220,11 @@ void edgex_device_process_configured_devices
 int edgex_device_handler_config
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 );
 
 #endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "confwatch.h"
+#include "service.h"
+#include "config.h"
+#include "edgex_rest.h"
+#include "errorlist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Delay before retrying after a failed query, doubling up to a limit */
+
+#define RETRY_MIN 1
+#define RETRY_MAX 60
+
+struct edgex_confwatch
+{
+  edgex_device_service *svc;
+  edgex_registry *registry;
+  char *profile;
+  uint64_t index;
+  bool stop;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+};
+
+static void confwatch_pause (edgex_confwatch *w, unsigned secs)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_REALTIME, &ts);
+  ts.tv_sec += secs;
+  pthread_mutex_lock (&w->lock);
+  if (!w->stop)
+  {
+    pthread_cond_timedwait (&w->cond, &w->lock, &ts);
+  }
+  pthread_mutex_unlock (&w->lock);
+}
+
+static void *confwatch_thread (void *arg)
+{
+  edgex_confwatch *w = (edgex_confwatch *) arg;
+  edgex_device_service *svc = w->svc;
+  unsigned retry = RETRY_MIN;
+
+  while (!__atomic_load_n (&w->stop, __ATOMIC_ACQUIRE))
+  {
+    edgex_error err = EDGEX_OK;
+    uint64_t last = w->index;
+    edgex_nvpairs *changed = edgex_registry_watch_config
+      (w->registry, svc->name, w->profile, &w->index, &w->stop, &err);
+
+    if (err.code)
+    {
+      if (!__atomic_load_n (&w->stop, __ATOMIC_ACQUIRE))
+      {
+        iot_log_warning
+        (
+          svc->logger,
+          "Unable to watch configuration in registry, retry in %us", retry
+        );
+        confwatch_pause (w, retry);
+        retry = (retry * 2 > RETRY_MAX) ? RETRY_MAX : retry * 2;
+      }
+      continue;
+    }
+    retry = RETRY_MIN;
+
+    /* The first query only establishes the index, its values were read at
+     * startup.
+     */
+    if (changed && last)
+    {
+      edgex_device_updateConfigNV (svc, changed);
+    }
+    edgex_nvpairs_free (changed);
+  }
+  return NULL;
+}
+
+edgex_confwatch *edgex_confwatch_start
+  (edgex_device_service *svc, edgex_registry *registry, const char *profile)
+{
+  edgex_confwatch *w;
+
+  if (!edgex_registry_can_watch (registry))
+  {
+    return NULL;
+  }
+  w = calloc (1, sizeof (edgex_confwatch));
+  w->svc = svc;
+  w->registry = registry;
+  w->profile = profile ? strdup (profile) : NULL;
+  pthread_mutex_init (&w->lock, NULL);
+  pthread_cond_init (&w->cond, NULL);
+  if (pthread_create (&w->thread, NULL, confwatch_thread, w) != 0)
+  {
+    iot_log_error (svc->logger, "Unable to start configuration watcher");
+    pthread_cond_destroy (&w->cond);
+    pthread_mutex_destroy (&w->lock);
+    free (w->profile);
+    free (w);
+    return NULL;
+  }
+  return w;
+}
+
+void edgex_confwatch_stop (edgex_confwatch *w)
+{
+  if (w)
+  {
+    pthread_mutex_lock (&w->lock);
+    __atomic_store_n (&w->stop, true, __ATOMIC_RELEASE);
+    pthread_cond_signal (&w->cond);
+    pthread_mutex_unlock (&w->lock);
+    pthread_join (w->thread, NULL);
+
+    pthread_cond_destroy (&w->cond);
+    pthread_mutex_destroy (&w->lock);
+    free (w->profile);
+    free (w);
+  }
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_CONFWATCH_H_
+#define _EDGEX_DEVICE_CONFWATCH_H_ 1
+
+#include "edgex/devsdk.h"
+#include "edgex/registry.h"
+
+typedef struct edgex_confwatch edgex_confwatch;
+
+/*
+ * Start a thread which waits for the service's configuration in the registry
+ * to change, and applies the changes. The registry must remain valid until
+ * the watch is stopped. Returns NULL if the registry can not be watched.
+ */
+
+extern edgex_confwatch *edgex_confwatch_start
+  (edgex_device_service *svc, edgex_registry *registry, const char *profile);
+
+/* Stop watching, abandoning any wait in progress */
+
+extern void edgex_confwatch_stop (edgex_confwatch *w);
+
+#endif
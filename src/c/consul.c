@@ -15,12 +15,23 @@
 #include "parson.h"
 #include "base64.h"
 
+#include <inttypes.h>
+
 #define CONF_PREFIX "config/V2/"
 
+/* How long a blocking query waits for a change before returning */
+
+#define WATCH_WAIT "5m"
+
+/* Read configuration from a KV response, skipping values not modified since
+ * the given index (if nonzero).
+ */
+
 static edgex_nvpairs *read_pairs
 (
   iot_logging_client *lc,
   const char *json,
+  uint64_t since,
   edgex_error *err
 )
 {
@@ -40,6 +51,14 @@ static edgex_nvpairs *read_pairs
   for (size_t i = 0; i < nconfs; i++)
   {
     obj = json_array_get_object (configs, i);
+    if
+    (
+      since &&
+      (uint64_t) json_object_get_number (obj, "ModifyIndex") <= since
+    )
+    {
+      continue;
+    }
     pair = malloc (sizeof (edgex_nvpairs));
     key = json_object_get_string (obj, "Key");
     if (key)
@@ -108,21 +127,16 @@ static edgex_nvpairs *read_pairs
   return result;
 }
 
-edgex_nvpairs *edgex_consul_client_get_config
+/* The URL for a recursive read of a service's configuration */
+
+static void config_url
 (
-  iot_logging_client *lc,
-  void *location,
+  char *url,
+  const edgex_registry_hostport *endpoint,
   const char *servicename,
-  const char *profile,
-  edgex_error *err
+  const char *profile
 )
 {
-  edgex_ctx ctx;
-  char url[URL_BUF_SIZE];
-  edgex_nvpairs *result = NULL;
-  edgex_registry_hostport *endpoint = (edgex_registry_hostport *)location;
-
-  memset (&ctx, 0, sizeof (edgex_ctx));
   if (profile && *profile)
   {
     snprintf
@@ -142,11 +156,29 @@ edgex_nvpairs *edgex_consul_client_get_config
       endpoint->host, endpoint->port, servicename
     );
   }
+}
+
+edgex_nvpairs *edgex_consul_client_get_config
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  const char *profile,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+  edgex_nvpairs *result = NULL;
+  edgex_registry_hostport *endpoint = (edgex_registry_hostport *)location;
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  config_url (url, endpoint, servicename, profile);
   edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
 
   if (err->code == 0)
   {
-    result = read_pairs (lc, ctx.buff, err);
+    result = read_pairs (lc, ctx.buff, 0, err);
     if (err->code)
     {
       edgex_nvpairs_free (result);
@@ -158,6 +190,80 @@ edgex_nvpairs *edgex_consul_client_get_config
   return result;
 }
 
+/*
+ * Blocking query: consul replies when the index of the configuration passes
+ * the one given, or when the wait time expires. The whole tree is returned,
+ * but only the values which were modified since the previous index are
+ * decoded. The index reported by consul may go backwards (eg if its data is
+ * restored), in which case every value is taken as changed.
+ */
+
+edgex_nvpairs *edgex_consul_client_watch_config
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  const char *profile,
+  uint64_t *index,
+  const bool *stop,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+  size_t len;
+  uint64_t since = *index;
+  uint64_t latest;
+  edgex_nvpairs *result = NULL;
+  edgex_registry_hostport *endpoint = (edgex_registry_hostport *)location;
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  ctx.rsp_header = "X-Consul-Index";
+  ctx.cancel = stop;
+  config_url (url, endpoint, servicename, profile);
+  len = strlen (url);
+  snprintf
+  (
+    url + len, URL_BUF_SIZE - 1 - len,
+    "&index=%" PRIu64 "&wait=" WATCH_WAIT, since
+  );
+  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+
+  if (err->code == 0)
+  {
+    latest = ctx.rsp_value ? strtoull (ctx.rsp_value, NULL, 10) : 0;
+    if (latest == 0)
+    {
+      iot_log_error (lc, "No X-Consul-Index in response to %s", url);
+      *err = EDGEX_CONSUL_RESPONSE;
+    }
+    else
+    {
+      if (latest < since)
+      {
+        since = 0;
+      }
+      if (latest != since)
+      {
+        result = read_pairs (lc, ctx.buff, since, err);
+      }
+      if (err->code)
+      {
+        edgex_nvpairs_free (result);
+        result = NULL;
+      }
+      else
+      {
+        *index = latest;
+      }
+    }
+  }
+
+  free (ctx.buff);
+  free (ctx.rsp_value);
+  return result;
+}
+
 void edgex_consul_client_write_config
 (
   iot_logging_client *lc,
@@ -227,10 +333,76 @@ void edgex_consul_client_write_config
 
   edgex_http_put (lc, &ctx, url, json, edgex_http_write_cb, err);
 
-  free (json);
+  json_free_serialized_string (json);
   free (ctx.buff);
 }
 
+/*
+ * Only instances whose health checks are passing are returned. An instance
+ * registered without an address of its own is at the address of its node.
+ */
+
+edgex_registry_hostport *edgex_consul_client_query_service
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  unsigned *count,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+  edgex_registry_hostport *result = NULL;
+  edgex_registry_hostport *endpoint = (edgex_registry_hostport *)location;
+
+  *count = 0;
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  snprintf
+  (
+    url, URL_BUF_SIZE - 1, "http://%s:%u/v1/health/service/%s?passing",
+    endpoint->host, endpoint->port, servicename
+  );
+  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+
+  if (err->code == 0)
+  {
+    JSON_Value *val = json_parse_string (ctx.buff);
+    JSON_Array *entries = json_value_get_array (val);
+    size_t n = json_array_get_count (entries);
+    if (entries == NULL)
+    {
+      iot_log_error (lc, "Unable to parse response to %s", url);
+      *err = EDGEX_CONSUL_RESPONSE;
+    }
+    result = n ? malloc (n * sizeof (edgex_registry_hostport)) : NULL;
+    for (size_t i = 0; i < n; i++)
+    {
+      JSON_Object *entry = json_array_get_object (entries, i);
+      const char *host = json_object_dotget_string (entry, "Service.Address");
+      double port = json_object_dotget_number (entry, "Service.Port");
+      if (host == NULL || *host == '\0')
+      {
+        host = json_object_dotget_string (entry, "Node.Address");
+      }
+      if (host && *host && port > 0 && port <= UINT16_MAX)
+      {
+        result[*count].host = strdup (host);
+        result[(*count)++].port = (uint16_t) port;
+      }
+    }
+    json_value_free (val);
+    if (*count == 0)
+    {
+      free (result);
+      result = NULL;
+    }
+  }
+
+  free (ctx.buff);
+  return result;
+}
+
 void edgex_consul_client_register_service
 (
   iot_logging_client *lc,
@@ -280,7 +452,7 @@ void edgex_consul_client_register_service
   {
     iot_log_error (lc, "Register service failed: %s", ctx.buff);
   }
-  free (json);
+  json_free_serialized_string (json);
   free (ctx.buff);
 }
 
@@ -29,6 +29,17 @@ edgex_nvpairs *edgex_consul_client_get_config
   edgex_error *err
 );
 
+edgex_nvpairs *edgex_consul_client_watch_config
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  const char *profile,
+  uint64_t *index,
+  const bool *stop,
+  edgex_error *err
+);
+
 void edgex_consul_client_write_config
 (
   iot_logging_client *lc,
@@ -39,6 +50,15 @@ void edgex_consul_client_write_config
   edgex_error *err
 );
 
+struct edgex_registry_hostport *edgex_consul_client_query_service
+(
+  iot_logging_client *lc,
+  void *location,
+  const char *servicename,
+  unsigned *count,
+  edgex_error *err
+);
+
 void edgex_consul_client_register_service
 (
   iot_logging_client *lc,
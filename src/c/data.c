@@ -9,88 +9,830 @@
 #include "edgex_rest.h"
 #include "rest.h"
 #include "data.h"
+#include "transport.h"
 #include "errorlist.h"
 #include "config.h"
+#include "endpoints.h"
 #include "edgex_time.h"
 #include "device.h"
+#include "transform.h"
+#include "arena.h"
+#include "lvcache.h"
+#include "stats.h"
+#include "trace.h"
+#include "cbor.h"
+#include "base64.h"
+#include "memstats.h"
 
-JSON_Value *edgex_data_generate_event
+static void edgex_data_write_reading
 (
+  edgex_strbuf *buf,
+  bool first,
+  const char *name,
+  const char *reading,
+  uint64_t origin
+)
+{
+  if (!first)
+  {
+    edgex_strbuf_appendchar (buf, ',');
+  }
+  edgex_strbuf_appendstr (buf, "{\"name\":");
+  edgex_strbuf_appendjson (buf, name);
+  edgex_strbuf_appendstr (buf, ",\"value\":");
+  edgex_strbuf_appendjson (buf, reading);
+  edgex_strbuf_appendstr (buf, ",\"origin\":");
+  edgex_strbuf_appenduint (buf, origin);
+  edgex_strbuf_appendchar (buf, '}');
+}
+
+/* As above, with the value encoded directly from bytes */
+
+static void edgex_data_write_binary_reading
+(
+  edgex_strbuf *buf,
+  bool first,
+  const char *name,
+  const edgex_blob *blob,
+  uint64_t origin
+)
+{
+  if (!first)
+  {
+    edgex_strbuf_appendchar (buf, ',');
+  }
+  edgex_strbuf_appendstr (buf, "{\"name\":");
+  edgex_strbuf_appendjson (buf, name);
+  edgex_strbuf_appendstr (buf, ",\"value\":\"");
+  edgex_b64_encode_append (buf, blob->bytes, blob->size);
+  edgex_strbuf_appendstr (buf, "\",\"origin\":");
+  edgex_strbuf_appenduint (buf, origin);
+  edgex_strbuf_appendchar (buf, '}');
+}
+
+/*
+ * A CBOR reading. Binary values are given as bytes, others as their text.
+ */
+
+static void edgex_data_write_cbor_reading
+(
+  edgex_strbuf *buf,
+  const char *name,
+  const char *reading,
+  const edgex_blob *blob,
+  uint64_t origin
+)
+{
+  edgex_cbor_map (buf, 3);
+  edgex_cbor_text (buf, "name");
+  edgex_cbor_text (buf, name);
+  if (blob)
+  {
+    edgex_cbor_text (buf, "binaryValue");
+    edgex_cbor_bytes (buf, blob->bytes, blob->size);
+  }
+  else
+  {
+    edgex_cbor_text (buf, "value");
+    edgex_cbor_text (buf, reading);
+  }
+  edgex_cbor_text (buf, "origin");
+  edgex_cbor_uint (buf, origin);
+}
+
+/* Compare a reading with the assertion for its resource, in native type */
+
+static bool edgex_data_assertion_holds
+  (const edgex_propertyvalue *props, const edgex_device_resultvalue *val)
+{
+  int64_t i = props->assertval.value.ival;
+  double d = props->assertval.value.dval;
+
+  switch (props->type)
+  {
+    case Bool:
+      return val->bool_result == (i != 0);
+    case Uint8:
+      return val->ui8_result == (uint64_t) i;
+    case Uint16:
+      return val->ui16_result == (uint64_t) i;
+    case Uint32:
+      return val->ui32_result == (uint64_t) i;
+    case Uint64:
+      return val->ui64_result == (uint64_t) i;
+    case Int8:
+      return val->i8_result == i;
+    case Int16:
+      return val->i16_result == i;
+    case Int32:
+      return val->i32_result == i;
+    case Int64:
+      return val->i64_result == i;
+    case Float32:
+      return val->f32_result == (float) d;
+    case Float64:
+      return val->f64_result == d;
+    default:
+      return true;
+  }
+}
+
+/* Find the numeric value of a reading, for aggregation */
+
+static bool edgex_data_numeric
+  (edgex_propertytype type, const edgex_device_resultvalue *val, double *num)
+{
+  switch (type)
+  {
+    case Uint8:
+      *num = val->ui8_result;
+      break;
+    case Uint16:
+      *num = val->ui16_result;
+      break;
+    case Uint32:
+      *num = val->ui32_result;
+      break;
+    case Uint64:
+      *num = val->ui64_result;
+      break;
+    case Int8:
+      *num = val->i8_result;
+      break;
+    case Int16:
+      *num = val->i16_result;
+      break;
+    case Int32:
+      *num = val->i32_result;
+      break;
+    case Int64:
+      *num = val->i64_result;
+      break;
+    case Float32:
+      *num = val->f32_result;
+      break;
+    case Float64:
+      *num = val->f64_result;
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+/* Write the summary of a window as readings named <resource>_<statistic> */
+
+static void edgex_data_write_summary
+(
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_arena *arena,
+  const char *resource,
+  const edgex_aggregate_summary *sum,
+  uint32_t *nchanged
+)
+{
+  char vbuf[EDGEX_FMT_BUFSIZE];
+  size_t len = strlen (resource);
+  char *name = edgex_arena_alloc (arena, len + EDGEX_AGG_NAMELEN + 1);
+
+  memcpy (name, resource, len);
+  name[len] = '_';
+  for (uint32_t i = 0; i < sum->n; i++)
+  {
+    strcpy (name + len + 1, sum->stats[i].name);
+    if (sum->stats[i].integer)
+    {
+      edgex_fmt_uint (sum->stats[i].value, vbuf);
+    }
+    else
+    {
+      edgex_fmt_double (sum->stats[i].value, vbuf);
+    }
+    if (changed)
+    {
+      edgex_data_write_reading
+        (changed, *nchanged == 0, name, vbuf, sum->origin);
+    }
+    if (cbor)
+    {
+      edgex_data_write_cbor_reading (cbor, name, vbuf, NULL, sum->origin);
+    }
+    (*nchanged)++;
+  }
+}
+
+/*
+ * Write readings to buf and, if a filter is given, those which have changed
+ * to the changed buffer. Readings of aggregated resources are replaced in
+ * changed by the summaries of any windows they complete. The readings which
+ * would be in changed (all of them, with no filter or aggregator) are
+ * written to cbor in that form. Any buffer may be NULL. Unless first is set,
+ * buf already holds readings, which those written follow.
+ */
+
+static bool edgex_data_write_readings
+(
+  edgex_strbuf *buf,
+  bool first,
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
   const char *device_name,
+  uint64_t timenow,
   uint32_t nreadings,
   const edgex_device_commandrequest *sources,
   const edgex_device_commandresult *values,
-  bool doTransforms
+  bool doTransforms,
+  uint32_t *nchanged
 )
 {
-  uint64_t timenow = edgex_device_millitime ();
-  JSON_Value *jevent = json_value_init_object ();
-  JSON_Object *jobj = json_value_get_object (jevent);
-  JSON_Value *arrval = json_value_init_array ();
-  JSON_Array *jrdgs = json_value_get_array (arrval);
+  char vbuf[EDGEX_FMT_BUFSIZE];
+  bool result = true;
+  edgex_arena *arena = edgex_arena_local ();
+  edgex_arena_mark mark = edgex_arena_getmark (arena);
+  edgex_device_resultvalue *vals =
+    edgex_arena_alloc (arena, nreadings * sizeof (edgex_device_resultvalue));
+  bool *ok = NULL;
+
+  *nchanged = 0;
   for (uint32_t i = 0; i < nreadings; i++)
   {
-    char *reading = edgex_value_tostring
+    vals[i] = values[i].value;
+  }
+  if (doTransforms)
+  {
+    ok = edgex_arena_alloc (arena, nreadings * sizeof (bool));
+    edgex_transform_batch (nreadings, sources, vals, ok);
+  }
+
+  for (uint32_t i = 0; i < nreadings; i++)
+  {
+    char *reading;
+    const edgex_propertyvalue *props = sources[i].devobj->properties->value;
+    uint64_t origin = values[i].origin ? values[i].origin : timenow;
+    size_t cborstart = cbor ? cbor->len : 0;
+    bool binary = props->type == Binary && (ok == NULL || ok[i]);
+    bool lent = values[i].release != NULL;
+
+    /* Binary values are kept as bytes in CBOR, so are written before they
+     * are encoded for the other forms. Unless the text is needed for the
+     * filter or an assertion, the base64 is written straight into buf.
+     */
+
+    if (cbor && binary)
+    {
+      edgex_data_write_cbor_reading
+        (cbor, sources[i].devobj->name, NULL, &vals[i].binary_result, origin);
+    }
+    if
     (
-      values[i].value,
-      doTransforms,
-      sources[i].devobj->properties->value,
-      sources[i].ro->mappings
-    );
-    const char *assertion = sources[i].devobj->properties->value->assertion;
-    if (assertion && *assertion && strcmp (reading, assertion))
+      binary && !changed && !filter && !(props->assertion && *props->assertion)
+    )
+    {
+      if (buf)
+      {
+        edgex_data_write_binary_reading
+        (
+          buf, first && i == 0, sources[i].devobj->name,
+          &vals[i].binary_result, origin
+        );
+      }
+      if (!lent)
+      {
+        free (vals[i].binary_result.bytes);
+      }
+      (*nchanged)++;
+      continue;
+    }
+
+    bool valid = (ok == NULL || ok[i]);
+    if (valid && props->assertval.enabled)
+    {
+      if (!edgex_data_assertion_holds (props, &vals[i]))
+      {
+        result = false;
+        break;
+      }
+    }
+
+    if (!valid)
+    {
+      strcpy (vbuf, "overflow");
+      reading = vbuf;
+    }
+    else
+    {
+      reading = edgex_value_format
+      (
+        vals[i],
+        sources[i].devobj->properties->value,
+        doTransforms ? sources[i].ro->mappings : NULL,
+        vbuf,
+        !lent
+      );
+    }
+
+    /* A lent string is written in place, and released with the others */
+
+    bool freeit = reading != vbuf &&
+      !(lent && props->type == String && reading == vals[i].string_result);
+    const char *assertion = props->assertion;
+    if
+    (
+      assertion && *assertion && !(valid && props->assertval.enabled) &&
+      strcmp (reading, assertion)
+    )
+    {
+      if (freeit)
+      {
+        free (reading);
+      }
+      result = false;
+      break;
+    }
+
+    if (cbor && !binary)
+    {
+      edgex_data_write_cbor_reading
+        (cbor, sources[i].devobj->name, reading, NULL, origin);
+    }
+    if (buf)
     {
-       free (reading);
-       json_value_free (jevent);
-       return NULL;
+      edgex_data_write_reading
+        (buf, first && i == 0, sources[i].devobj->name, reading, origin);
     }
+    if (hist && valid && !binary)
+    {
+      edgex_history_add
+        (hist, device_name, sources[i].devobj->name, reading, origin);
+    }
+    edgex_aggregate_result aggr = EDGEX_AGG_PASS;
+    edgex_aggregate_summary sum;
+    double aval;
+    if (agg && valid && edgex_data_numeric (props->type, &vals[i], &aval))
+    {
+      aggr = edgex_aggregator_add
+        (agg, device_name, sources[i].devobj, aval, origin, &sum);
+    }
+
+    if (aggr != EDGEX_AGG_PASS)
+    {
+      if (cbor)
+      {
+        cbor->len = cborstart;
+      }
+      if (aggr == EDGEX_AGG_SUMMARY)
+      {
+        edgex_data_write_summary
+          (changed, cbor, arena, sources[i].devobj->name, &sum, nchanged);
+      }
+    }
+    else if (filter)
+    {
+      double num = 0.0;
+      bool isfloat = (ok == NULL || ok[i]) &&
+        (props->type == Float32 || props->type == Float64);
+      if (isfloat)
+      {
+        num = (props->type == Float32) ? vals[i].f32_result : vals[i].f64_result;
+      }
+      if
+      (
+        edgex_lvcache_update
+        (
+          filter, device_name, sources[i].devobj->name, reading,
+          isfloat ? &num : NULL, timenow
+        )
+      )
+      {
+        if (changed)
+        {
+          edgex_data_write_reading
+            (changed, *nchanged == 0, sources[i].devobj->name, reading, origin);
+        }
+        (*nchanged)++;
+      }
+      else if (cbor)
+      {
+        cbor->len = cborstart;
+      }
+    }
+    else
+    {
+      if (changed)
+      {
+        edgex_data_write_reading
+          (changed, *nchanged == 0, sources[i].devobj->name, reading, origin);
+      }
+      (*nchanged)++;
+    }
+    if (freeit)
+    {
+      free (reading);
+    }
+  }
+
+  /* Buffers lent by the driver are returned once all are written */
+
+  for (uint32_t i = 0; i < nreadings; i++)
+  {
+    edgex_value_release (&values[i]);
+  }
+  edgex_arena_rewind (arena, mark);
+  return result;
+}
+
+/* Copy a buffer's contents for an event */
+
+static char *event_readings (const edgex_strbuf *buf)
+{
+  char *result = edgex_mem_malloc (EDGEX_MEM_EVENTS, buf->len + 1);
+  if (buf->len)
+  {
+    memcpy (result, buf->data, buf->len);
+  }
+  result[buf->len] = '\0';
+  return result;
+}
+
+edgex_event_cooked *edgex_data_process_event
+(
+  const char *device_name,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *sources,
+  const edgex_device_commandresult *values,
+  bool doTransforms,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
+  edgex_event_encoding encoding
+)
+{
+  uint64_t timenow = edgex_device_origintime ();
+  edgex_strbuf *buf = edgex_strbuf_scratch ();
+  uint32_t nchanged;
+  bool json = (encoding == EDGEX_EVENT_JSON);
+  if (agg && !edgex_aggregate_any (nreadings, sources))
+  {
+    agg = NULL;
+  }
+  bool sep = filter || agg;
+
+  if
+  (
+    !edgex_data_write_readings
+    (
+      (json && !sep) ? buf : NULL, true, (json && sep) ? buf : NULL,
+      json ? NULL : buf, filter, agg, hist, device_name, timenow,
+      nreadings, sources, values, doTransforms, &nchanged
+    ) || nchanged == 0
+  )
+  {
+    return NULL;
+  }
+
+  edgex_event_cooked *result =
+    edgex_mem_malloc (EDGEX_MEM_EVENTS, sizeof (edgex_event_cooked));
+  result->device = edgex_mem_strdup (EDGEX_MEM_EVENTS, device_name);
+  result->origin = timenow;
+  result->encoding = encoding;
+  result->readings = event_readings (buf);
+  result->size = buf->len;
+  return result;
+}
+
+static void edgex_data_write_header
+  (edgex_strbuf *buf, const char *device_name, uint64_t timenow)
+{
+  edgex_strbuf_appendstr (buf, "{\"device\":");
+  edgex_strbuf_appendjson (buf, device_name);
+  edgex_strbuf_appendstr (buf, ",\"origin\":");
+  edgex_strbuf_appenduint (buf, timenow);
+  edgex_strbuf_appendstr (buf, ",\"readings\":[");
+}
+
+static void edgex_data_write_cbor_header
+  (edgex_strbuf *buf, const char *device_name, uint64_t timenow)
+{
+  edgex_cbor_map (buf, 3);
+  edgex_cbor_text (buf, "device");
+  edgex_cbor_text (buf, device_name);
+  edgex_cbor_text (buf, "origin");
+  edgex_cbor_uint (buf, timenow);
+  edgex_cbor_text (buf, "readings");
+  edgex_cbor_array_open (buf);
+}
+
+/*
+ * Write an event to changed and cbor, and either the same event or, if part
+ * is set, just its readings to buf.
+ */
+
+static bool edgex_data_write_event_common
+(
+  edgex_strbuf *buf,
+  bool part,
+  bool first,
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
+  const char *device_name,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *sources,
+  const edgex_device_commandresult *values,
+  bool doTransforms,
+  uint32_t *nchanged
+)
+{
+  uint64_t timenow = edgex_device_origintime ();
 
-    JSON_Value *rval = json_value_init_object ();
-    JSON_Object *robj = json_value_get_object (rval);
+  if (!part)
+  {
+    edgex_data_write_header (buf, device_name, timenow);
+  }
+  if (changed)
+  {
+    edgex_data_write_header (changed, device_name, timenow);
+  }
+  if (cbor)
+  {
+    edgex_data_write_cbor_header (cbor, device_name, timenow);
+  }
+  if
+  (
+    !edgex_data_write_readings
+    (
+      buf, first, changed, cbor, filter, agg, hist, device_name, timenow,
+      nreadings, sources, values, doTransforms, nchanged
+    )
+  )
+  {
+    return false;
+  }
+  if (!part)
+  {
+    edgex_strbuf_appendstr (buf, "]}");
+  }
+  if (changed)
+  {
+    edgex_strbuf_appendstr (changed, "]}");
+  }
+  if (cbor)
+  {
+    edgex_cbor_break (cbor);
+  }
+  return true;
+}
+
+bool edgex_data_write_event
+(
+  edgex_strbuf *buf,
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
+  const char *device_name,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *sources,
+  const edgex_device_commandresult *values,
+  bool doTransforms,
+  uint32_t *nchanged
+)
+{
+  return edgex_data_write_event_common
+  (
+    buf, false, true, changed, cbor, filter, agg, hist, device_name,
+    nreadings, sources, values, doTransforms, nchanged
+  );
+}
 
-    json_object_set_string (robj, "name", sources[i].devobj->name);
-    json_object_set_string (robj, "value", reading);
-    if (values[i].origin)
+void edgex_data_write_event_header (edgex_strbuf *buf, const char *device_name)
+{
+  edgex_data_write_header (buf, device_name, edgex_device_origintime ());
+}
+
+bool edgex_data_write_event_part
+(
+  edgex_strbuf *buf,
+  bool first,
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
+  const char *device_name,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *sources,
+  const edgex_device_commandresult *values,
+  bool doTransforms,
+  uint32_t *nchanged
+)
+{
+  return edgex_data_write_event_common
+  (
+    buf, true, first, changed, cbor, filter, agg, hist, device_name,
+    nreadings, sources, values, doTransforms, nchanged
+  );
+}
+
+void edgex_data_event_write (const edgex_event_cooked *e, edgex_strbuf *buf)
+{
+  edgex_strbuf_reserve (buf, e->size + strlen (e->device) + 64);
+  if (e->encoding == EDGEX_EVENT_CBOR)
+  {
+    edgex_data_write_cbor_header (buf, e->device, e->origin);
+    edgex_strbuf_append (buf, e->readings, e->size);
+    edgex_cbor_break (buf);
+    return;
+  }
+  edgex_strbuf_appendstr (buf, "{\"device\":");
+  edgex_strbuf_appendjson (buf, e->device);
+  edgex_strbuf_appendstr (buf, ",\"origin\":");
+  edgex_strbuf_appenduint (buf, e->origin);
+  edgex_strbuf_appendstr (buf, ",\"readings\":[");
+  edgex_strbuf_append (buf, e->readings, e->size);
+  edgex_strbuf_appendstr (buf, "]}");
+}
+
+edgex_event_cooked *edgex_data_event_fromjson (const JSON_Value *val)
+{
+  JSON_Object *obj = json_value_get_object (val);
+  const char *device = json_object_get_string (obj, "device");
+  JSON_Array *readings = json_object_get_array (obj, "readings");
+  if (device == NULL || readings == NULL)
+  {
+    return NULL;
+  }
+
+  edgex_strbuf *buf = edgex_strbuf_scratch ();
+  size_t n = json_array_get_count (readings);
+  for (size_t i = 0; i < n; i++)
+  {
+    char *r = json_serialize_to_string (json_array_get_value (readings, i));
+    if (i)
     {
-      json_object_set_number (robj, "origin", values[i].origin);
+      edgex_strbuf_appendchar (buf, ',');
     }
-    json_array_append_value (jrdgs, rval);
-    free (reading);
+    edgex_strbuf_appendstr (buf, r);
+    json_free_serialized_string (r);
+  }
+
+  edgex_event_cooked *result =
+    edgex_mem_malloc (EDGEX_MEM_EVENTS, sizeof (edgex_event_cooked));
+  result->device = edgex_mem_strdup (EDGEX_MEM_EVENTS, device);
+  result->origin = json_object_get_number (obj, "origin");
+  result->encoding = EDGEX_EVENT_JSON;
+  result->readings = event_readings (buf);
+  result->size = buf->len;
+  return result;
+}
+
+static bool edgex_data_cbor_key (edgex_cbor_reader *r, const char *key)
+{
+  const char *s;
+  size_t len;
+  return edgex_cbor_read_text (r, &s, &len) &&
+    len == strlen (key) && memcmp (s, key, len) == 0;
+}
+
+edgex_event_cooked *edgex_data_event_fromcbor (const uint8_t *data, size_t len)
+{
+  edgex_cbor_reader r = { data, len, 0 };
+  const char *device;
+  size_t devlen;
+  uint64_t n;
+  uint64_t origin;
+
+  /* The readings are last, so run to the break which ends the event */
+
+  if
+  (
+    !edgex_cbor_read_map (&r, &n) || n != 3 ||
+    !edgex_data_cbor_key (&r, "device") ||
+    !edgex_cbor_read_text (&r, &device, &devlen) ||
+    !edgex_data_cbor_key (&r, "origin") ||
+    !edgex_cbor_read_uint (&r, &origin) ||
+    !edgex_data_cbor_key (&r, "readings") ||
+    !edgex_cbor_read_array_open (&r) ||
+    r.pos >= len || data[len - 1] != 0xff
+  )
+  {
+    return NULL;
   }
 
-  json_object_set_string (jobj, "device", device_name);
-  json_object_set_number (jobj, "origin", timenow);
-  json_object_set_value (jobj, "readings", arrval);
-  return jevent;
+  edgex_event_cooked *result =
+    edgex_mem_malloc (EDGEX_MEM_EVENTS, sizeof (edgex_event_cooked));
+  result->device = edgex_mem_malloc (EDGEX_MEM_EVENTS, devlen + 1);
+  memcpy (result->device, device, devlen);
+  result->device[devlen] = '\0';
+  result->origin = origin;
+  result->encoding = EDGEX_EVENT_CBOR;
+  result->size = len - 1 - r.pos;
+  result->readings = edgex_mem_malloc (EDGEX_MEM_EVENTS, result->size + 1);
+  memcpy (result->readings, data + r.pos, result->size);
+  result->readings[result->size] = '\0';
+  return result;
+}
+
+void edgex_data_event_merge
+  (edgex_event_cooked *e, const edgex_event_cooked *other)
+{
+  if (other->size == 0)
+  {
+    return;
+  }
+  /* JSON readings are separated by commas, CBOR ones simply follow */
+
+  size_t sep = (e->size && e->encoding == EDGEX_EVENT_JSON) ? 1 : 0;
+  e->readings = edgex_mem_realloc
+    (EDGEX_MEM_EVENTS, e->readings, e->size + sep + other->size + 1);
+  if (sep)
+  {
+    e->readings[e->size] = ',';
+  }
+  memcpy (e->readings + e->size + sep, other->readings, other->size + 1);
+  e->size += sep + other->size;
+}
+
+void edgex_data_event_free (edgex_event_cooked *e)
+{
+  if (e)
+  {
+    edgex_mem_free (EDGEX_MEM_EVENTS, e->device);
+    edgex_mem_free (EDGEX_MEM_EVENTS, e->readings);
+    edgex_mem_free (EDGEX_MEM_EVENTS, e);
+  }
 }
 
 void edgex_data_client_add_event
 (
   iot_logging_client *lc,
   edgex_service_endpoints *endpoints,
-  JSON_Value *eventval,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding,
   edgex_error *err
 )
 {
   edgex_ctx ctx;
   char url[URL_BUF_SIZE];
-  char *json;
+
+  if (endpoints->transport)
+  {
+    uint64_t started = edgex_device_monotime ();
+    endpoints->transport->publish
+      (endpoints->transport->impl, event, size, encoding, err);
+    edgex_stats_time
+      (EDGEX_STATS_DATA_POST, edgex_device_monotime () - started);
+    if (err->code)
+    {
+      edgex_stats_count (EDGEX_STATS_DATA_POST_FAILURES, 1);
+    }
+    return;
+  }
+
+  if (!edgex_endpoint_available (&endpoints->data))
+  {
+    edgex_stats_count (EDGEX_STATS_DATA_POST_FAILURES, 1);
+    *err = EDGEX_REMOTE_SERVER_DOWN;
+    return;
+  }
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  ctx.compress_min = endpoints->data.compressmin;
+  edgex_endpoint_url
   (
+    &endpoints->data,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/event",
-    endpoints->data.host,
-    endpoints->data.port
+    "/api/v1/event"
   );
 
-  json = json_serialize_to_string (eventval);
-  edgex_http_post (lc, &ctx, url, json, edgex_http_write_cb, err);
+  uint64_t started = edgex_device_monotime ();
+  long status = edgex_http_post_data
+  (
+    lc, &ctx, url, event, size,
+    encoding == EDGEX_EVENT_CBOR ? "application/cbor" : "application/json",
+    edgex_http_write_cb, err
+  );
+  edgex_stats_time (EDGEX_STATS_DATA_POST, edgex_device_monotime () - started);
+  EDGEX_TRACE_SPAN (EDGEX_TRACE_POST, started, NULL);
+  if (err->code)
+  {
+    edgex_stats_count (EDGEX_STATS_DATA_POST_FAILURES, 1);
+    if (status >= 400 && status < 500)
+    {
+      *err = EDGEX_EVENT_REJECTED;
+    }
+  }
+  edgex_endpoint_result (&endpoints->data, url, status);
 
   free (ctx.buff);
-  free (json);
 }
 
 edgex_valuedescriptor *edgex_data_client_add_valuedescriptor
@@ -116,13 +858,11 @@ edgex_valuedescriptor *edgex_data_client_add_valuedescriptor
 
   memset (result, 0, sizeof (edgex_valuedescriptor));
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->data,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/valuedescriptor",
-    endpoints->data.host,
-    endpoints->data.port
+    "/api/v1/valuedescriptor"
   );
   result->origin = origin;
   result->name = strdup (name);
@@ -141,6 +881,70 @@ edgex_valuedescriptor *edgex_data_client_add_valuedescriptor
   return result;
 }
 
+void edgex_data_client_update_valuedescriptor
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const edgex_valuedescriptor *vd,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+  char *json;
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  edgex_endpoint_url
+  (
+    &endpoints->data,
+    url,
+    "/api/v1/valuedescriptor"
+  );
+  json = edgex_valuedescriptor_write (vd);
+  edgex_http_put (lc, &ctx, url, json, edgex_http_write_cb, err);
+  free (ctx.buff);
+  free (json);
+}
+
+void edgex_data_client_get_valuedescriptor_names
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  edgex_map_int *names,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  edgex_endpoint_url
+  (
+    &endpoints->data,
+    url,
+    "/api/v1/valuedescriptor"
+  );
+
+  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  if (err->code == 0)
+  {
+    JSON_Value *val = json_parse_string (ctx.buff);
+    JSON_Array *array = json_value_get_array (val);
+    size_t count = json_array_get_count (array);
+    for (size_t i = 0; i < count; i++)
+    {
+      const char *name =
+        json_object_get_string (json_array_get_object (array, i), "name");
+      if (name)
+      {
+        edgex_map_set (names, name, 1);
+      }
+    }
+    json_value_free (val);
+  }
+  free (ctx.buff);
+}
+
 bool edgex_data_client_ping
 (
   iot_logging_client *lc,
@@ -152,13 +956,11 @@ bool edgex_data_client_ping
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->data,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/ping",
-    endpoints->data.host,
-    endpoints->data.port
+    "/api/v1/ping"
   );
 
   edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
@@ -11,6 +11,11 @@
 
 #include "edgex/devsdk.h"
 #include "parson.h"
+#include "strbuf.h"
+#include "lvcache.h"
+#include "aggregate.h"
+#include "history.h"
+#include "map.h"
 
 typedef struct edgex_reading
 {
@@ -53,22 +58,145 @@ typedef struct
   char *uomLabel;
 } edgex_valuedescriptor;
 
+/*
+ * Events may be submitted to core-data as JSON or as CBOR. In CBOR, readings
+ * of Binary type carry their bytes in a binaryValue member instead of being
+ * base64-encoded.
+ */
+
+typedef enum
+{
+  EDGEX_EVENT_JSON,
+  EDGEX_EVENT_CBOR
+} edgex_event_encoding;
+
+/*
+ * An event ready for submission. The readings are held already serialized as
+ * the members of the event's readings array, so that events for the same
+ * device may be merged by concatenation. In CBOR the readings are binary, and
+ * size gives their length.
+ */
+
+typedef struct edgex_event_cooked
+{
+  char *device;
+  uint64_t origin;
+  edgex_event_encoding encoding;
+  char *readings;
+  size_t size;
+} edgex_event_cooked;
+
 typedef struct edgex_service_endpoints edgex_service_endpoints;
 
-JSON_Value *edgex_data_generate_event
+/*
+ * Create an event from readings. If a filter is given, readings whose value
+ * has not changed are left out. If an aggregator is given, readings of
+ * aggregated resources are replaced by the summaries of any windows they
+ * complete. If a history is given, the readings are recorded in it. Returns
+ * NULL if an assertion failed or there are no readings to send.
+ */
+
+edgex_event_cooked *edgex_data_process_event
+(
+  const char *device_name,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *sources,
+  const edgex_device_commandresult *values,
+  bool doTransforms,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
+  edgex_event_encoding encoding
+);
+
+/*
+ * Write a new event directly to a buffer in its JSON form, without creating
+ * an edgex_event_cooked. If changed is non-NULL, an event containing only
+ * the readings passed by the filter is written to it as well. With an
+ * aggregator, changed holds the summaries of windows completed in place of
+ * the readings of aggregated resources, which buf still holds. nchanged
+ * receives the number of readings in changed (all of them, if there is no
+ * filter or aggregator). If cbor is non-NULL, the CBOR form of the event
+ * that changed would hold is written to it. Readings are recorded in hist,
+ * if given. Returns false if an assertion failed.
+ */
+
+bool edgex_data_write_event
+(
+  edgex_strbuf *buf,
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
+  const char *device_name,
+  uint32_t nreadings,
+  const edgex_device_commandrequest *sources,
+  const edgex_device_commandresult *values,
+  bool doTransforms,
+  uint32_t *nchanged
+);
+
+/*
+ * An event may also be written to buf in parts. Its header is written with
+ * edgex_data_write_event_header, then the readings of each part with
+ * edgex_data_write_event_part, first being set for the first part, and the
+ * event is closed with "]}". Arguments are otherwise as for
+ * edgex_data_write_event; each part is written to changed and cbor as an
+ * event of its own.
+ */
+
+void edgex_data_write_event_header (edgex_strbuf *buf, const char *device_name);
+
+bool edgex_data_write_event_part
 (
+  edgex_strbuf *buf,
+  bool first,
+  edgex_strbuf *changed,
+  edgex_strbuf *cbor,
+  edgex_lvcache *filter,
+  edgex_aggregator *agg,
+  edgex_history *hist,
   const char *device_name,
   uint32_t nreadings,
   const edgex_device_commandrequest *sources,
   const edgex_device_commandresult *values,
-  bool doTransforms
+  bool doTransforms,
+  uint32_t *nchanged
 );
 
+/* Write the complete form of an event, in its encoding, to a buffer */
+
+void edgex_data_event_write (const edgex_event_cooked *e, edgex_strbuf *buf);
+
+/* Recreate an event from its JSON form */
+
+edgex_event_cooked *edgex_data_event_fromjson (const JSON_Value *val);
+
+/* Recreate an event from its CBOR form, as written by edgex_data_event_write */
+
+edgex_event_cooked *edgex_data_event_fromcbor (const uint8_t *data, size_t len);
+
+/* Append the readings of another event for the same device */
+
+void edgex_data_event_merge
+  (edgex_event_cooked *e, const edgex_event_cooked *other);
+
+void edgex_data_event_free (edgex_event_cooked *e);
+
+/*
+ * Submit an encoded event. If core-data refuses it with a 4xx status, err is
+ * EDGEX_EVENT_REJECTED; as resubmitting it would fail the same way, such an
+ * event is not kept in the event log.
+ */
+
 void edgex_data_client_add_event
 (
   iot_logging_client *lc,
   edgex_service_endpoints *endpoints,
-  JSON_Value *eventval,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding,
   edgex_error *err
 );
 
@@ -88,6 +216,26 @@ edgex_valuedescriptor *edgex_data_client_add_valuedescriptor
   edgex_error *err
 );
 
+/* Replace a value descriptor in core-data, identified by its name */
+
+void edgex_data_client_update_valuedescriptor
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const edgex_valuedescriptor *vd,
+  edgex_error *err
+);
+
+/* Add the names of the value descriptors known to core-data to a map */
+
+void edgex_data_client_get_valuedescriptor_names
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  edgex_map_int *names,
+  edgex_error *err
+);
+
 bool edgex_data_client_ping
 (
   iot_logging_client *lc,
@@ -11,31 +11,45 @@
 #include "errorlist.h"
 #include "parson.h"
 #include "data.h"
-#include "metadata.h"
 #include "edgex_rest.h"
 #include "edgex_time.h"
 #include "base64.h"
+#include "numfmt.h"
+#include "arena.h"
+#include "cmdplan.h"
+#include "transform.h"
+#include "readcache.h"
+#include "stats.h"
+#include "trace.h"
+#include "putbatch.h"
 
 #include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 #include <microhttpd.h>
-#include <math.h>
-#include <limits.h>
-#include <float.h>
-#include <assert.h>
 
 /* NOTES
  *
  * The entry point for the device command is edgex_device_handler_device. This
- * parses the device spec and command name out of the url path and calls either
- * oneCommand or allCommand.
+ * takes the device spec and command name from the parameters matched by the
+ * router and calls either oneCommand or allCommand.
  * Each of these two methods finds the relevant device(s), calls runOne to
  * perform the command(s), uploads any readings and constructs the appropriate
  * JSON response.
- * runOne locates profile resources and calls either runOneGet or runOnePut.
+ * The command and its profile resources are found through the profile's
+ * command plan (see cmdplan.h), which holds the pre-resolved requests.
+ * runOne checks the state of the device and calls either runOneGet or runOnePut.
+ * Concurrent reads of the same command on a device are coalesced, see
+ * readcache.h.
  * runOneGet and runOnePut construct the required parameters, perform the
  * conversions between strings and values, and call the device implementation.
+ * If the implementation is asynchronous, the reply to a single-device command
+ * is deferred and the command finished when the driver completes it; in
+ * other cases the driver is waited for.
+ * Given Service/RequestTimeout, each command carries a deadline. A command
+ * whose deadline has passed fails before the driver is called, and a
+ * deferred reply still awaiting its driver once the deadline passes is sent
+ * as a timeout by edgex_device_async_expire.
  */
 
 static const char *methStr (edgex_http_method method)
@@ -57,19 +71,18 @@ static const char *methStr (edgex_http_method method)
   }
 }
 
-static bool isNumericType (edgex_propertytype type)
-{
-  return (type != Bool && type != String && type != Binary);
-}
-
-static char *checkMapping (char *in, const edgex_nvpairs *map)
+static char *checkMapping
+  (char *in, const edgex_nvpairs *map, bool owned)
 {
   const edgex_nvpairs *pair = map;
   while (pair)
   {
     if (strcmp (in, pair->name) == 0)
     {
-      free (in);
+      if (owned)
+      {
+        free (in);
+      }
       return strdup (pair->value);
     }
     pair = pair->next;
@@ -77,210 +90,115 @@ static char *checkMapping (char *in, const edgex_nvpairs *map)
   return in;
 }
 
-static bool transformResult
-  (edgex_device_resultvalue *value, edgex_propertyvalue *props)
-{
-  if (props->type == Float64 || props->type == Float32)
-  {
-    long double result =
-      (props->type == Float64) ? value->f64_result : value->f32_result;
-    if (props->base.enabled) result = powl (props->base.value.dval, result);
-    if (props->scale.enabled) result *= props->scale.value.dval;
-    if (props->offset.enabled) result += props->offset.value.dval;
-    if (props->type == Float64)
-    {
-      if (result <= DBL_MAX && result >= -DBL_MAX)
-      {
-        value->f64_result = (double)result;
-        return true;
-      }
-      return false;
-    }
-    else
-    {
-      if (result <= FLT_MAX && result >= -FLT_MAX)
-      {
-        value->f32_result = (float)result;
-        return true;
-      }
-      return false;
-    }
-  }
-  else
-  {
-    long long int result = 0;
-    switch (props->type)
-    {
-      case Uint8: result = value->ui8_result; break;
-      case Uint16: result = value->ui16_result; break;
-      case Uint32: result = value->ui32_result; break;
-      case Uint64: result = value->ui64_result; break;
-      case Int8: result = value->i8_result; break;
-      case Int16: result = value->i16_result; break;
-      case Int32: result = value->i32_result; break;
-      case Int64: result = value->i64_result; break;
-      default: assert (0);
-    }
-    if (props->mask.enabled) result &= props->mask.value.ival;
-    if (props->shift.enabled)
-    {
-      if (props->shift.value.ival < 0)
-      {
-        result <<= -props->shift.value.ival;
-      }
-      else
-      {
-        result >>= props->shift.value.ival;
-      }
-    }
-    if (props->base.enabled) result = powl (props->base.value.ival, result);
-    if (props->scale.enabled) result *= props->scale.value.ival;
-    if (props->offset.enabled) result += props->offset.value.ival;
-
-    switch (props->type)
-    {
-      case Uint8:
-        if (result >= 0 && result <= UCHAR_MAX)
-        {
-          value->ui8_result = (uint8_t)result;
-          return true;
-        }
-        break;
-      case Uint16:
-        if (result >= 0 && result <= USHRT_MAX)
-        {
-          value->ui16_result = (uint16_t)result;
-          return true;
-        }
-        break;
-      case Uint32:
-        if (result >= 0 && result <= UINT_MAX)
-        {
-          value->ui32_result = (uint32_t)result;
-          return true;
-        }
-        break;
-      case Uint64:
-        if (result >= 0 && result <= ULLONG_MAX)
-        {
-          value->ui64_result = (uint64_t)result;
-          return true;
-        }
-        break;
-      case Int8:
-        if (result >= SCHAR_MIN && result <= SCHAR_MAX)
-        {
-          value->i8_result = (int8_t)result;
-          return true;
-        }
-        break;
-      case Int16:
-        if (result >= SHRT_MIN && result <= SHRT_MAX)
-        {
-          value->i16_result = (int16_t)result;
-          return true;
-        }
-        break;
-      case Int32:
-        if (result >= INT_MIN && result <= INT_MAX)
-        {
-          value->i32_result = (int32_t)result;
-          return true;
-        }
-        break;
-      case Int64:
-        if (result >= LLONG_MIN && result <= LLONG_MAX)
-        {
-          value->i64_result = (int64_t)result;
-          return true;
-        }
-        break;
-      default:
-        assert (0);
-    }
-  }
-  return false;
-}
-
-char *edgex_value_tostring
+char *edgex_value_format
 (
   edgex_device_resultvalue value,
-  bool xform,
   edgex_propertyvalue *props,
-  edgex_nvpairs *mappings
+  edgex_nvpairs *mappings,
+  char *buf,
+  bool owned
 )
 {
   size_t sz;
-  char *res = NULL;
-
-  if (isNumericType (props->type))
-  {
-    if (xform)
-    {
-      if (props->offset.enabled || props->scale.enabled ||
-          props->base.enabled || props->shift.enabled || props->mask.enabled)
-      {
-        if (!transformResult (&value, props))
-        {
-          return strdup ("overflow");
-        }
-      }
-    }
-
-    res = malloc (32);
-  }
+  char *res = buf;
 
   switch (props->type)
   {
     case Bool:
-      res = strdup (value.bool_result ? "true" : "false");
+      strcpy (buf, value.bool_result ? "true" : "false");
       break;
     case Uint8:
-      sprintf (res, "%" PRIu8, value.ui8_result);
+      edgex_fmt_uint (value.ui8_result, buf);
       break;
     case Uint16:
-      sprintf (res, "%" PRIu16, value.ui16_result);
+      edgex_fmt_uint (value.ui16_result, buf);
       break;
     case Uint32:
-      sprintf (res, "%" PRIu32, value.ui32_result);
+      edgex_fmt_uint (value.ui32_result, buf);
       break;
     case Uint64:
-      sprintf (res, "%" PRIu64, value.ui64_result);
+      edgex_fmt_uint (value.ui64_result, buf);
       break;
     case Int8:
-      sprintf (res, "%" PRIi8, value.i8_result);
+      edgex_fmt_int (value.i8_result, buf);
       break;
     case Int16:
-      sprintf (res, "%" PRIi16, value.i16_result);
+      edgex_fmt_int (value.i16_result, buf);
       break;
     case Int32:
-      sprintf (res, "%" PRIi32, value.i32_result);
+      edgex_fmt_int (value.i32_result, buf);
       break;
     case Int64:
-      sprintf (res, "%" PRIi64, value.i64_result);
+      edgex_fmt_int (value.i64_result, buf);
       break;
     case Float32:
-      sprintf (res, "%.8e", value.f32_result);
+      edgex_fmt_float (value.f32_result, buf);
       break;
     case Float64:
-      sprintf (res, "%.16e", value.f64_result);
+      edgex_fmt_double (value.f64_result, buf);
       break;
     case String:
-      res = xform ?
-        checkMapping (value.string_result, mappings) :
-        value.string_result;
+      res = checkMapping (value.string_result, mappings, owned);
       break;
     case Binary:
       sz = edgex_b64_encodesize (value.binary_result.size);
       res = malloc (sz);
       edgex_b64_encode
         (value.binary_result.bytes, value.binary_result.size, res, sz);
-      free (value.binary_result.bytes);
+      if (owned)
+      {
+        free (value.binary_result.bytes);
+      }
       break;
   }
   return res;
 }
 
+void edgex_value_release (const edgex_device_commandresult *res)
+{
+  if (res->release && res->type == String)
+  {
+    res->release (res->release_ctx, res->value.string_result);
+  }
+  else if (res->release && res->type == Binary)
+  {
+    res->release (res->release_ctx, res->value.binary_result.bytes);
+  }
+}
+
+char *edgex_value_tostring_r
+(
+  edgex_device_resultvalue value,
+  bool xform,
+  edgex_propertyvalue *props,
+  edgex_nvpairs *mappings,
+  char *buf
+)
+{
+  if (xform && props->xform)
+  {
+    if (!edgex_transform_kernels[props->xform] (&value, props))
+    {
+      strcpy (buf, "overflow");
+      return buf;
+    }
+  }
+  return edgex_value_format (value, props, xform ? mappings : NULL, buf, true);
+}
+
+char *edgex_value_tostring
+(
+  edgex_device_resultvalue value,
+  bool xform,
+  edgex_propertyvalue *props,
+  edgex_nvpairs *mappings
+)
+{
+  char buf[EDGEX_FMT_BUFSIZE];
+  char *res = edgex_value_tostring_r (value, xform, props, mappings, buf);
+  return (res == buf) ? strdup (buf) : res;
+}
+
 static bool populateValue
   (edgex_device_commandresult *cres, const char *val)
 {
@@ -332,288 +250,1167 @@ static bool populateValue
   return false;
 }
 
-static const edgex_command *findCommand
-  (const char *name, const edgex_command *cmd)
+/* Returned when the reply to a command will be sent on its completion */
+
+#define CMD_DEFERRED 0
+
+/*
+ * A request to an asynchronous driver, or to a synchronous one whose calls
+ * are serialized (Device/SerializeCommands). If the reply to the command can
+ * be deferred, the request holds everything needed to finish the command on
+ * completion; otherwise the caller waits for it.
+ *
+ * A deferred request with a deadline is kept on the service's pending list
+ * until it completes or its deadline passes; expired is set once its reply
+ * has been sent as a timeout. A serialized call whose deadline has passed
+ * before its turn is not made, and missed is set.
+ */
+
+struct edgex_device_async_request
 {
-  while (cmd && strcmp (cmd->name, name))
-  {
-    cmd = cmd->next;
-  }
-  return cmd;
+  edgex_device_service *svc;
+  edgex_device *dev;
+  bool isget;
+  uint32_t nreqs;
+  edgex_device_commandrequest *requests;
+  edgex_device_commandresult *results;
+  edgex_http_response *reply;
+  edgex_http_deferred *deferred;
+  edgex_readcache_entry *cached;
+  const edgex_cmdplan_op *plan;
+  uint64_t started;
+  uint64_t deadline;
+#if CSDK_BUILD_TRACE
+  uint64_t trace;
+#endif
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool done;
+  bool ok;
+  bool missed;
+  bool expired;
+  struct edgex_device_async_request *next;
+  struct edgex_device_async_request **pprev;
+};
+
+/*
+ * The deadline for a command started now, as a monotonic time in
+ * nanoseconds. Zero means that there is none.
+ */
+
+static uint64_t commandDeadline (const edgex_device_service *svc)
+{
+  uint32_t ms = svc->config.service.requesttimeout;
+  return ms ? edgex_device_monotime () + ms * 1000000ULL : 0;
 }
 
-static edgex_deviceresource *findDevResource
-  (edgex_deviceresource *list, const char *name)
+/* Check whether a command's deadline has passed, counting it if so */
+
+static bool deadlinePassed
+  (edgex_device_service *svc, const edgex_device *dev, uint64_t deadline)
 {
-  while (list && strcmp (list->name, name))
+  if (deadline && edgex_device_monotime () >= deadline)
   {
-    list = list->next;
+    edgex_stats_count (EDGEX_STATS_DEADLINE_MISSES, 1);
+    iot_log_error
+      (svc->logger, "Deadline passed for command on device %s", dev->name);
+    return true;
   }
-  return list;
+  return false;
 }
 
-static int runOnePut
+static edgex_device_async_request *asyncNew
 (
   edgex_device_service *svc,
   edgex_device *dev,
-  uint32_t nops,
-  edgex_resourceoperation *ops,
-  const char *data,
-  JSON_Value **reply
+  uint32_t nreqs,
+  bool isget,
+  uint64_t deadline
 )
 {
-  const char *value;
-  int retcode = MHD_HTTP_OK;
+  edgex_device_async_request *req = calloc
+  (
+    1, sizeof (*req) + nreqs *
+    (sizeof (edgex_device_commandrequest) + sizeof (edgex_device_commandresult))
+  );
+  req->svc = svc;
+  req->dev = dev;
+  req->isget = isget;
+  req->nreqs = nreqs;
+  req->deadline = deadline;
+  req->results = (edgex_device_commandresult *) (req + 1);
+  req->requests = (edgex_device_commandrequest *) (req->results + nreqs);
+  pthread_mutex_init (&req->lock, NULL);
+  pthread_cond_init (&req->cond, NULL);
+#if CSDK_BUILD_TRACE
+  req->trace = edgex_trace_current ();
+#endif
+  return req;
+}
 
-  JSON_Value *jval = json_parse_string (data);
-  if (jval == NULL)
+static void asyncFree (edgex_device_async_request *req)
+{
+  if (req)
   {
-    iot_log_error (svc->logger, "Payload did not parse as JSON");
-    return MHD_HTTP_BAD_REQUEST;
+    pthread_cond_destroy (&req->cond);
+    pthread_mutex_destroy (&req->lock);
+    free (req);
   }
+}
 
-  JSON_Object *jobj = json_value_get_object (jval);
+/* Make a serialized call to a synchronous driver */
 
-  edgex_device_commandrequest *reqs =
-    malloc (nops * sizeof (edgex_device_commandrequest));
-  memset (reqs, 0, nops * sizeof (edgex_device_commandrequest));
-  edgex_device_commandresult *results =
-    malloc (nops * sizeof (edgex_device_commandresult));
-  memset (results, 0, nops * sizeof (edgex_device_commandresult));
-  edgex_resourceoperation *op = ops;
-  for (int i = 0; i < nops; i++)
-  {
-    reqs[i].ro = op;
-    reqs[i].devobj =
-      findDevResource (dev->profile->device_resources, op->object);
-    if (!reqs[i].devobj->properties->value->writable)
-    {
-      iot_log_error
-      (
-        svc->logger,
-        "Attempt to write unwritable value %s",
-        reqs[i].devobj->name
-      );
-      retcode = MHD_HTTP_METHOD_NOT_ALLOWED;
-      break;
-    }
+static void serialCall (void *arg)
+{
+  edgex_device_async_request *req = (edgex_device_async_request *) arg;
+  edgex_device_service *svc = req->svc;
+  bool ok = false;
 
-    value = json_object_get_string (jobj, op->object);
-    if (value == NULL)
-    {
-      retcode = MHD_HTTP_BAD_REQUEST;
-      iot_log_error (svc->logger, "No value supplied for %s", op->object);
-      break;
-    }
-    results[i].type = reqs[i].devobj->properties->value->type;
-    if (!populateValue (&results[i], value))
-    {
-      retcode = MHD_HTTP_BAD_REQUEST;
-      iot_log_error
-        (svc->logger, "Unable to parse \"%s\" for %s", value, op->object);
-      break;
-    }
-    op = op->next;
+  if
+  (
+    edgex_device_async_cancelled (req) ||
+    deadlinePassed (svc, req->dev, req->deadline)
+  )
+  {
+    req->missed = true;
   }
-
-  if (retcode == MHD_HTTP_OK)
+  else if (req->isget)
   {
-    if (!svc->userfns.puthandler (svc->userdata, dev->addressable, nops, reqs, results))
-    {
-      retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
-      iot_log_error (svc->logger, "Driver for %s failed on PUT", dev->name);
-    }
+    ok = svc->userfns.gethandler
+    (
+      svc->userdata, req->dev->addressable, req->nreqs,
+      req->requests, req->results
+    );
   }
+  else
+  {
+    ok = svc->userfns.puthandler
+    (
+      svc->userdata, req->dev->addressable, req->nreqs,
+      req->requests, req->results
+    );
+  }
+  edgex_device_async_complete (req, ok);
+}
 
-  for (int i = 0; i < nops; i++)
+/* Remove a request from the pending list. Called with asynclock held */
+
+static void unlinkPending (edgex_device_async_request *req)
+{
+  if (req->pprev)
   {
-    if (results[i].type == String)
+    *req->pprev = req->next;
+    if (req->next)
     {
-      free (results[i].value.string_result);
-    }
-    else if (results[i].type == Binary)
-    {
-      free (results[i].value.binary_result.bytes);
+      req->next->pprev = req->pprev;
     }
+    req->pprev = NULL;
   }
-  free (reqs);
-  free (results);
-  json_value_free (jval);
+}
 
-  return retcode;
+/* Whether a request is made through asyncRun */
+
+static bool asyncUsed (const edgex_device_service *svc, bool isget)
+{
+  return
+    svc->serial || (isget ? svc->asyncget != NULL : svc->asyncput != NULL);
 }
 
-static int runOneGet
-(
-  edgex_device_service *svc,
-  edgex_device *dev,
-  uint32_t nops,
-  edgex_resourceoperation *ops,
-  JSON_Value **reply
-)
+/*
+ * Start a request to an asynchronous driver. If the reply can be deferred,
+ * the request is handed over, to be finished in edgex_device_async_complete,
+ * and false is returned. Otherwise waits for the driver and returns true,
+ * with the outcome in req->ok.
+ *
+ * Calls to a synchronous driver are serialized by addressable: queued, if
+ * the reply can be deferred, or otherwise made on this thread once no other
+ * call for the addressable is in progress.
+ */
+
+static bool asyncRun (edgex_device_async_request *req, edgex_http_response *reply)
 {
-  int retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
-  edgex_device_commandrequest *requests =
-    malloc (nops * sizeof (edgex_device_commandrequest));
-  memset (requests, 0, nops * sizeof (edgex_device_commandrequest));
-  edgex_device_commandresult *results =
-    malloc (nops * sizeof (edgex_device_commandresult));
-  memset (results, 0, nops * sizeof (edgex_device_commandresult));
-  edgex_resourceoperation *op = ops;
-  for (int i = 0; i < nops; i++)
-  {
-    requests[i].ro = op;
-    requests[i].devobj =
-      findDevResource (dev->profile->device_resources, op->object);
-    if (!requests[i].devobj->properties->value->readable)
-    {
-      iot_log_error
-      (
-        svc->logger,
-        "Attempt to read unreadable value %s",
-        requests[i].devobj->name
-      );
-      free (results);
-      free (requests);
-      return MHD_HTTP_METHOD_NOT_ALLOWED;
-    }
-    op = op->next;
-  }
+  edgex_device_service *svc = req->svc;
+  req->reply = reply;
+  req->deferred = reply ? edgex_http_response_defer (reply) : NULL;
 
-  if
-  (
-    svc->userfns.gethandler
-      (svc->userdata, dev->addressable, nops, requests, results)
-  )
-  {
-    *reply = edgex_data_generate_event
-      (dev->name, nops, requests, results, svc->config.device.datatransform);
+  /* The request may be completed, and freed, before the driver returns */
 
-    if (*reply)
+  bool deferred = (req->deferred != NULL);
+  if (deferred)
+  {
+    edgex_devreg_pin (req->dev);
+    if (req->deadline)
     {
-      edgex_error err = EDGEX_OK;
-      edgex_data_client_add_event
-        (svc->logger, &svc->config.endpoints, *reply, &err);
-      if (err.code == 0)
+      pthread_mutex_lock (&svc->asynclock);
+      req->next = svc->asyncpending;
+      req->pprev = &svc->asyncpending;
+      if (req->next)
       {
-        retcode = MHD_HTTP_OK;
+        req->next->pprev = &req->next;
       }
+      svc->asyncpending = req;
+      pthread_mutex_unlock (&svc->asynclock);
     }
-    else
+  }
+  if (req->isget ? svc->asyncget == NULL : svc->asyncput == NULL)
+  {
+    const char *key = req->dev->addressable->name ?
+      req->dev->addressable->name : req->dev->name;
+    if (deferred)
     {
-      edgex_error err = EDGEX_OK;
-      iot_log_error (svc->logger, "Assertion failed for device %s. Disabling.", dev->name);
-      edgex_metadata_client_set_device_opstate
-        (svc->logger, &svc->config.endpoints, dev->id, DISABLED, &err);
+      edgex_serial_submit (svc->serial, key, serialCall, req);
+      return false;
     }
+    edgex_serial_run (svc->serial, key, serialCall, req);
+  }
+  else if (req->isget)
+  {
+    svc->asyncget
+    (
+      svc->userdata, req->dev->addressable, req->nreqs,
+      req->requests, req->results, req
+    );
   }
   else
   {
-    iot_log_error
-      (svc->logger, "Driver for %s failed on GET", dev->name);
+    svc->asyncput
+    (
+      svc->userdata, req->dev->addressable, req->nreqs,
+      req->requests, req->results, req
+    );
   }
-  free (results);
-  free (requests);
-  return retcode;
+  if (deferred)
+  {
+    return false;
+  }
+  pthread_mutex_lock (&req->lock);
+  while (!req->done)
+  {
+    pthread_cond_wait (&req->cond, &req->lock);
+  }
+  pthread_mutex_unlock (&req->lock);
+  return true;
 }
 
-static int runOne
+/* Update the statistics for a call to the driver. Returns its duration */
+
+static uint64_t noteDriver
 (
   edgex_device_service *svc,
   edgex_device *dev,
-  const edgex_command *command,
-  edgex_http_method method,
-  const char *upload_data,
-  size_t upload_data_size,
-  JSON_Value **reply
+  const edgex_cmdplan_op *plan,
+  bool isget,
+  uint64_t started,
+  bool ok
 )
 {
-  if (dev->adminState == LOCKED)
+  uint64_t ns = edgex_device_monotime () - started;
+  edgex_stats_time (isget ? EDGEX_STATS_DRIVER_GET : EDGEX_STATS_DRIVER_PUT, ns);
+  EDGEX_TRACE_SPAN
+    (isget ? EDGEX_TRACE_DRIVER_GET : EDGEX_TRACE_DRIVER_PUT, started, dev->name);
+  if (!ok)
   {
-    iot_log_error
-    (
-      svc->logger,
-      "Can't run command %s on device %s as it is locked",
-      command->name, dev->name
-    );
-    return MHD_HTTP_LOCKED;
+    edgex_stats_count
+      (isget ? EDGEX_STATS_DRIVER_GET_FAILURES : EDGEX_STATS_DRIVER_PUT_FAILURES, 1);
   }
-
-  if (dev->operatingState == DISABLED)
+  if (plan)
   {
-    iot_log_error
-    (
-      svc->logger,
-      "Can't run command %s on device %s as it is disabled",
-      command->name, dev->name
-    );
-    return MHD_HTTP_LOCKED;
+    edgex_stats_calls_note (plan->stats, ok, ns);
   }
-
-  if
-  (
-    (method == GET && command->get == NULL) ||
-    (method != GET && command->put == NULL)
-  )
+  if (dev->stats)
   {
-    iot_log_error
-    (
-      svc->logger,
-      "Command %s found for device %s but no %s version",
-      command->name, dev->name, methStr (method)
-    );
-    return MHD_HTTP_METHOD_NOT_ALLOWED;
+    edgex_stats_calls_note
+      (isget ? &dev->stats->get : &dev->stats->put, ok, ns);
   }
-
-  edgex_profileresource *res = dev->profile->resources;
-  while (res)
+  if (ok && svc->config.device.updatelastconnected && svc->devstatus)
   {
-    if (strcmp (res->name, command->name) == 0)
-    { break; }
-    res = res->next;
+    edgex_devstatus_connected
+      (svc->devstatus, dev->id, edgex_device_millitime ());
   }
-  if (res == NULL)
-  {
+  return ns;
+}
+
+static void freeValues (uint32_t nvals, edgex_device_commandresult *values)
+{
+  for (uint32_t i = 0; i < nvals; i++)
+  {
+    if (values[i].release)
+    {
+      edgex_value_release (&values[i]);
+    }
+    else if (values[i].type == String)
+    {
+      free (values[i].value.string_result);
+    }
+    else if (values[i].type == Binary)
+    {
+      free (values[i].value.binary_result.bytes);
+    }
+  }
+}
+
+static int finishPut (edgex_device_service *svc, edgex_device *dev, bool ok)
+{
+  if (!ok)
+  {
+    iot_log_error (svc->logger, "Driver for %s failed on PUT", dev->name);
+    return MHD_HTTP_INTERNAL_SERVER_ERROR;
+  }
+  return MHD_HTTP_OK;
+}
+
+static const char *putSkip (const char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+  {
+    p++;
+  }
+  return p;
+}
+
+/* Find the extent of the string at p, if it has no escapes */
+
+static const char *putString (const char *p, size_t *len)
+{
+  const char *start = ++p;
+  while (*p != '"')
+  {
+    if (*p == '\\' || (unsigned char) *p < 0x20)
+    {
+      return NULL;
+    }
+    p++;
+  }
+  *len = p - start;
+  return start;
+}
+
+/*
+ * The body of a PUT is an object whose members are the string values to be
+ * written, keyed by resource. It is read in a single pass, finding the value
+ * for each request without building a DOM. Returns false if the body is not
+ * of this simple form (including where escapes are used), in which case it
+ * is left to parson.
+ */
+
+static bool scanPut
+(
+  edgex_arena *arena,
+  const char *p,
+  uint32_t nops,
+  const edgex_device_commandrequest *reqs,
+  const char **values
+)
+{
+  const char *key;
+  const char *val;
+  size_t klen;
+  size_t vlen;
+
+  memset (values, 0, nops * sizeof (char *));
+  p = putSkip (p);
+  if (*p != '{')
+  {
+    return false;
+  }
+  p = putSkip (p + 1);
+  while (*p != '}')
+  {
+    if (*p != '"' || (key = putString (p, &klen)) == NULL)
+    {
+      return false;
+    }
+    p = putSkip (key + klen + 1);
+    if (*p != ':')
+    {
+      return false;
+    }
+    p = putSkip (p + 1);
+    if (*p != '"' || (val = putString (p, &vlen)) == NULL)
+    {
+      return false;
+    }
+    p = putSkip (val + vlen + 1);
+
+    char *copy = NULL;
+    for (uint32_t i = 0; i < nops; i++)
+    {
+      const char *obj = reqs[i].ro->object;
+      if (strncmp (obj, key, klen) == 0 && obj[klen] == '\0')
+      {
+        if (values[i])
+        {
+          return false;
+        }
+        if (copy == NULL)
+        {
+          copy = edgex_arena_alloc (arena, vlen + 1);
+          memcpy (copy, val, vlen);
+          copy[vlen] = '\0';
+        }
+        values[i] = copy;
+      }
+    }
+
+    if (*p == ',')
+    {
+      p = putSkip (p + 1);
+      if (*p == '}')
+      {
+        return false;
+      }
+    }
+    else if (*p != '}')
+    {
+      return false;
+    }
+  }
+  return *putSkip (p + 1) == '\0';
+}
+
+static int runOnePut
+(
+  edgex_device_service *svc,
+  edgex_arena *arena,
+  edgex_device *dev,
+  const edgex_cmdplan_op *plan,
+  const char *data,
+  edgex_http_response *async,
+  uint64_t deadline
+)
+{
+  const char *value;
+  int retcode = MHD_HTTP_OK;
+  uint32_t nops = plan->nreqs;
+  edgex_device_async_request *req = NULL;
+  edgex_device_commandrequest *reqs;
+  edgex_device_commandresult *results;
+
+  if (plan->denied)
+  {
     iot_log_error
+      (svc->logger, "Attempt to write unwritable value %s", plan->denied);
+    return MHD_HTTP_METHOD_NOT_ALLOWED;
+  }
+
+  JSON_Value *jval = NULL;
+  const char **values = edgex_arena_alloc (arena, nops * sizeof (char *));
+  if (!scanPut (arena, data, nops, plan->reqs, values))
+  {
+    jval = json_parse_string (data);
+    if (jval == NULL)
+    {
+      iot_log_error (svc->logger, "Payload did not parse as JSON");
+      return MHD_HTTP_BAD_REQUEST;
+    }
+    JSON_Object *jobj = json_value_get_object (jval);
+    for (uint32_t i = 0; i < nops; i++)
+    {
+      values[i] = json_object_get_string (jobj, plan->reqs[i].ro->object);
+    }
+  }
+
+  /* A command of more than MaxCmdOps operations is written in several calls
+   * to the driver, which can then not be deferred.
+   */
+
+  uint32_t chunk = svc->config.device.maxcmdops;
+  if (chunk == 0 || chunk > nops)
+  {
+    chunk = nops;
+  }
+  bool useasync = asyncUsed (svc, false);
+  if (!useasync)
+  {
+    reqs =
+      edgex_arena_alloc (arena, chunk * sizeof (edgex_device_commandrequest));
+    results =
+      edgex_arena_alloc (arena, chunk * sizeof (edgex_device_commandresult));
+  }
+  for (uint32_t off = 0; off < nops && retcode == MHD_HTTP_OK; off += chunk)
+  {
+    uint32_t n = (nops - off < chunk) ? nops - off : chunk;
+    if (useasync)
+    {
+      req = asyncNew (svc, dev, n, false, deadline);
+      reqs = req->requests;
+      results = req->results;
+    }
+    else
+    {
+      memset (results, 0, n * sizeof (edgex_device_commandresult));
+    }
+    memcpy (reqs, plan->reqs + off, n * sizeof (edgex_device_commandrequest));
+    for (uint32_t i = 0; i < n; i++)
+    {
+      const edgex_resourceoperation *op = reqs[i].ro;
+      value = values[off + i];
+      if (value == NULL)
+      {
+        retcode = MHD_HTTP_BAD_REQUEST;
+        iot_log_error (svc->logger, "No value supplied for %s", op->object);
+        break;
+      }
+      results[i].type = reqs[i].devobj->properties->value->type;
+      if (!populateValue (&results[i], value))
+      {
+        retcode = MHD_HTTP_BAD_REQUEST;
+        iot_log_error
+          (svc->logger, "Unable to parse \"%s\" for %s", value, op->object);
+        break;
+      }
+    }
+    if (off + n == nops)
+    {
+      json_value_free (jval);
+      jval = NULL;
+    }
+    if (retcode == MHD_HTTP_OK && deadlinePassed (svc, dev, deadline))
+    {
+      retcode = MHD_HTTP_GATEWAY_TIMEOUT;
+    }
+
+    if (retcode == MHD_HTTP_OK)
+    {
+      bool ok;
+      uint64_t started = edgex_device_monotime ();
+      if (req)
+      {
+        req->plan = plan;
+        req->started = started;
+        if (!asyncRun (req, (n == nops) ? async : NULL))
+        {
+          return CMD_DEFERRED;
+        }
+        ok = req->ok;
+      }
+      else if (svc->putbatch)
+      {
+        ok = edgex_putbatch_run
+        (
+          svc->putbatch, dev->name, dev->addressable, n, reqs, results,
+          svc->config.device.maxcmdops, svc->userfns.puthandler,
+          svc->userdata
+        );
+      }
+      else
+      {
+        ok = svc->userfns.puthandler
+          (svc->userdata, dev->addressable, n, reqs, results);
+      }
+      if (req && req->missed)
+      {
+        retcode = MHD_HTTP_GATEWAY_TIMEOUT;
+      }
+      else
+      {
+        noteDriver (svc, dev, plan, false, started, ok);
+        retcode = finishPut (svc, dev, ok);
+      }
+    }
+
+    freeValues (n, results);
+    asyncFree (req);
+    req = NULL;
+  }
+  json_value_free (jval);
+  return retcode;
+}
+
+/* Check that the driver's String results are within MaxCmdResultLen */
+
+static bool resultsFit
+(
+  edgex_device_service *svc,
+  const edgex_device *dev,
+  uint32_t nops,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *results
+)
+{
+  uint32_t maxlen = svc->config.device.maxcmdresultlen;
+  for (uint32_t i = 0; maxlen && i < nops; i++)
+  {
+    if
     (
-      svc->logger,
-      "Profile resource %s not found for device %s",
-      command->name, dev->name
+      results[i].type == String && results[i].value.string_result &&
+      strlen (results[i].value.string_result) > maxlen
+    )
+    {
+      iot_log_error
+      (
+        svc->logger, "MaxCmdResultLen (%u) exceeded for dev: %s resource: %s",
+        maxlen, dev->name, requests[i].devobj->name
+      );
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Produce the event for a GET request once the driver has returned. If more
+ * is given, only the readings are added to the reply (following any already
+ * there, if *more is set) as part of an event; see edgex_data_write_event_part.
+ */
+
+static int finishGet
+(
+  edgex_device_service *svc,
+  edgex_device *dev,
+  uint32_t nops,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *results,
+  bool ok,
+  edgex_strbuf *reply,
+  bool *more
+)
+{
+  int retcode = MHD_HTTP_INTERNAL_SERVER_ERROR;
+
+  if (ok && !resultsFit (svc, dev, nops, requests, results))
+  {
+    freeValues (nops, (edgex_device_commandresult *) results);
+    return retcode;
+  }
+  if (ok)
+  {
+    size_t start = reply->len;
+    edgex_strbuf changed;
+    uint32_t nchanged;
+    edgex_strbuf_init (&changed);
+    EDGEX_TRACE_START (traced);
+    /* In CBOR, the event for core-data is written separately to changed,
+     * as it is when readings are filtered or aggregated
+     */
+
+    bool cbor = (svc->eventencoding == EDGEX_EVENT_CBOR);
+    edgex_aggregator *agg = edgex_aggregate_any (nops, requests) ?
+      svc->aggregator : NULL;
+    bool filtered = svc->lvcache || agg;
+
+    /* A part of an event is always written separately for core-data */
+
+    bool sep = filtered || cbor || more;
+    edgex_strbuf *chg = (sep && !cbor) ? &changed : NULL;
+    bool written = more ?
+      edgex_data_write_event_part
+      (
+        reply, !*more, chg, cbor ? &changed : NULL, svc->lvcache, agg,
+        svc->history, dev->name, nops, requests, results,
+        svc->config.device.datatransform, &nchanged
+      ) :
+      edgex_data_write_event
+      (
+        reply, chg, cbor ? &changed : NULL, svc->lvcache, agg,
+        svc->history, dev->name, nops, requests, results,
+        svc->config.device.datatransform, &nchanged
+      );
+    if (written)
+    {
+      if (more)
+      {
+        *more = true;
+      }
+      edgex_error err = EDGEX_OK;
+      EDGEX_TRACE_SPAN (EDGEX_TRACE_EVENT, traced, dev->name);
+      if (nchanged)
+      {
+        const char *event = sep ? changed.data : reply->data + start;
+        size_t size = sep ? changed.len : reply->len - start;
+        edgex_data_client_add_event
+        (
+          svc->logger, &svc->config.endpoints, event, size,
+          svc->eventencoding, &err
+        );
+
+        /*
+         * An event kept in the event log will be submitted later. One which
+         * core-data rejected would only be rejected again.
+         */
+
+        if
+        (
+          err.code && err.code != EDGEX_EVENT_REJECTED.code &&
+          edgex_forward_store (svc->forward, event, size, svc->eventencoding)
+        )
+        {
+          err = EDGEX_OK;
+        }
+      }
+      if (err.code == 0)
+      {
+        retcode = MHD_HTTP_OK;
+      }
+    }
+    else
+    {
+      reply->len = start;
+      reply->data[start] = '\0';
+      iot_log_error (svc->logger, "Assertion failed for device %s. Disabling.", dev->name);
+      edgex_devstatus_opstate (svc->devstatus, dev->id, DISABLED);
+    }
+    edgex_strbuf_fini (&changed);
+  }
+  else
+  {
+    iot_log_error
+      (svc->logger, "Driver for %s failed on GET", dev->name);
+  }
+  return retcode;
+}
+
+/*
+ * Run a GET of more than MaxCmdOps operations as calls to the driver of at
+ * most that many. The readings of each call are sent to core-data as an
+ * event of their own, so that only one call's results are held at a time,
+ * and are added in turn to a single event in the reply.
+ */
+
+static int runChunkedGet
+(
+  edgex_device_service *svc,
+  edgex_arena *arena,
+  edgex_device *dev,
+  const edgex_cmdplan_op *plan,
+  uint32_t chunk,
+  edgex_strbuf *reply,
+  uint64_t deadline
+)
+{
+  uint32_t nops = plan->nreqs;
+  bool useasync = asyncUsed (svc, true);
+  edgex_device_async_request *req = NULL;
+  edgex_device_commandrequest *requests = NULL;
+  edgex_device_commandresult *results = NULL;
+  size_t start = reply->len;
+  bool more = false;
+  int retcode = MHD_HTTP_OK;
+
+  edgex_data_write_event_header (reply, dev->name);
+  if (!useasync)
+  {
+    requests =
+      edgex_arena_alloc (arena, chunk * sizeof (edgex_device_commandrequest));
+    results =
+      edgex_arena_alloc (arena, chunk * sizeof (edgex_device_commandresult));
+  }
+  for (uint32_t off = 0; off < nops && retcode == MHD_HTTP_OK; off += chunk)
+  {
+    uint32_t n = (nops - off < chunk) ? nops - off : chunk;
+    bool ok;
+
+    if (deadlinePassed (svc, dev, deadline))
+    {
+      retcode = MHD_HTTP_GATEWAY_TIMEOUT;
+      break;
+    }
+    if (useasync)
+    {
+      req = asyncNew (svc, dev, n, true, deadline);
+      requests = req->requests;
+      results = req->results;
+    }
+    else
+    {
+      memset (results, 0, n * sizeof (edgex_device_commandresult));
+    }
+    memcpy
+      (requests, plan->reqs + off, n * sizeof (edgex_device_commandrequest));
+
+    uint64_t started = edgex_device_monotime ();
+    if (req)
+    {
+      req->plan = plan;
+      req->started = started;
+      asyncRun (req, NULL);
+      ok = req->ok;
+    }
+    else
+    {
+      ok = svc->userfns.gethandler
+        (svc->userdata, dev->addressable, n, requests, results);
+    }
+    if (req && req->missed)
+    {
+      retcode = MHD_HTTP_GATEWAY_TIMEOUT;
+    }
+    else
+    {
+      noteDriver (svc, dev, plan, true, started, ok);
+      retcode = finishGet (svc, dev, n, requests, results, ok, reply, &more);
+    }
+    asyncFree (req);
+    req = NULL;
+  }
+  if (retcode == MHD_HTTP_OK)
+  {
+    edgex_strbuf_appendstr (reply, "]}");
+  }
+  else
+  {
+    reply->len = start;
+    reply->data[start] = '\0';
+  }
+  return retcode;
+}
+
+static int runOneGet
+(
+  edgex_device_service *svc,
+  edgex_arena *arena,
+  edgex_device *dev,
+  const char *cmdname,
+  const edgex_cmdplan_op *plan,
+  edgex_strbuf *reply,
+  edgex_http_response *async,
+  uint64_t deadline
+)
+{
+  uint32_t nops = plan->nreqs;
+  edgex_device_async_request *req = NULL;
+  edgex_device_commandrequest *requests;
+  edgex_device_commandresult *results;
+  edgex_readcache_entry *cached;
+  int retcode;
+  bool ok;
+
+  if (plan->denied)
+  {
+    iot_log_error
+      (svc->logger, "Attempt to read unreadable value %s", plan->denied);
+    return MHD_HTTP_METHOD_NOT_ALLOWED;
+  }
+  if (deadlinePassed (svc, dev, deadline))
+  {
+    return MHD_HTTP_GATEWAY_TIMEOUT;
+  }
+
+  /* Share the result of a current or recent read of the command */
+
+  cached = edgex_readcache_begin
+    (svc->readcache, dev->name, cmdname, nops, plan->reqs, reply, &retcode);
+  if (cached == NULL)
+  {
+    return retcode;
+  }
+
+  uint32_t maxops = svc->config.device.maxcmdops;
+  if (maxops && nops > maxops)
+  {
+    size_t start = reply->len;
+    retcode =
+      runChunkedGet (svc, arena, dev, plan, maxops, reply, deadline);
+    edgex_readcache_end
+    (
+      svc->readcache, cached, reply->data + start, reply->len - start,
+      retcode
     );
-    return MHD_HTTP_NOT_FOUND;
+    return retcode;
   }
 
-  edgex_resourceoperation *op;
-  uint32_t n = 0;
-  for (op = (method == GET) ? res->get : res->set; op; op = op->next)
+  if (asyncUsed (svc, true))
+  {
+    req = asyncNew (svc, dev, nops, true, deadline);
+    req->cached = cached;
+    requests = req->requests;
+    results = req->results;
+  }
+  else
+  {
+    requests =
+      edgex_arena_alloc (arena, nops * sizeof (edgex_device_commandrequest));
+    results =
+      edgex_arena_calloc (arena, nops, sizeof (edgex_device_commandresult));
+  }
+  memcpy (requests, plan->reqs, nops * sizeof (edgex_device_commandrequest));
+
+  uint64_t started = edgex_device_monotime ();
+  if (req)
+  {
+    req->plan = plan;
+    req->started = started;
+    if (!asyncRun (req, async))
+    {
+      return CMD_DEFERRED;
+    }
+    ok = req->ok;
+  }
+  else
+  {
+    ok = svc->userfns.gethandler
+      (svc->userdata, dev->addressable, nops, requests, results);
+  }
+  size_t start = reply->len;
+  if (req && req->missed)
+  {
+    retcode = MHD_HTTP_GATEWAY_TIMEOUT;
+  }
+  else
+  {
+    noteDriver (svc, dev, plan, true, started, ok);
+    retcode = finishGet (svc, dev, nops, requests, results, ok, reply, NULL);
+  }
+  edgex_readcache_end
+    (svc->readcache, cached, reply->data + start, reply->len - start, retcode);
+  asyncFree (req);
+  return retcode;
+}
+
+void edgex_device_async_complete (edgex_device_async_request *req, bool ok)
+{
+  if (req->deferred == NULL)
+  {
+    pthread_mutex_lock (&req->lock);
+    req->ok = ok;
+    req->done = true;
+    pthread_cond_signal (&req->cond);
+    pthread_mutex_unlock (&req->lock);
+    return;
+  }
+
+  int status;
+  edgex_device_service *svc = req->svc;
+  edgex_http_response *reply = req->reply;
+  EDGEX_TRACE_RESUME (req->trace);
+
+  /* Take the request off the pending list, unless it has already expired */
+
+  bool expired = false;
+  if (req->deadline)
+  {
+    pthread_mutex_lock (&svc->asynclock);
+    expired = req->expired;
+    if (!expired)
+    {
+      unlinkPending (req);
+    }
+    pthread_mutex_unlock (&svc->asynclock);
+  }
+  if (!req->missed)
   {
-    if (findDevResource (dev->profile->device_resources, op->object) == NULL)
+    noteDriver (svc, req->dev, req->plan, req->isget, req->started, ok);
+  }
+  if (expired)
+  {
+    freeValues (req->nreqs, req->results);
+    edgex_devreg_unpin (req->dev);
+    asyncFree (req);
+    pthread_mutex_lock (&svc->asynclock);
+    if (--svc->asyncexpired == 0)
+    {
+      pthread_cond_broadcast (&svc->asynccond);
+    }
+    pthread_mutex_unlock (&svc->asynclock);
+    return;
+  }
+
+  if (req->missed)
+  {
+    status = MHD_HTTP_GATEWAY_TIMEOUT;
+    if (req->isget)
+    {
+      edgex_readcache_end (svc->readcache, req->cached, "", 0, status);
+    }
+    else
     {
+      freeValues (req->nreqs, req->results);
+    }
+  }
+  else if (req->isget)
+  {
+    size_t start = reply->body.len;
+    status = finishGet
+    (
+      svc, req->dev, req->nreqs, req->requests, req->results, ok,
+      &reply->body, NULL
+    );
+    edgex_readcache_end
+    (
+      svc->readcache, req->cached,
+      reply->body.data + start, reply->body.len - start, status
+    );
+    if (reply->body.len)
+    {
+      reply->type = "application/json";
+    }
+  }
+  else
+  {
+    status = finishPut (svc, req->dev, ok);
+    freeValues (req->nreqs, req->results);
+  }
+  EDGEX_TRACE_SPAN (EDGEX_TRACE_COMMAND, req->started, req->dev->name);
+  edgex_http_deferred_complete (req->deferred, status);
+  edgex_devreg_unpin (req->dev);
+  asyncFree (req);
+}
+
+void edgex_device_async_expire (void *p)
+{
+  edgex_device_service *svc = (edgex_device_service *) p;
+  uint64_t now = edgex_device_monotime ();
+
+  /*
+   * Replies are sent with the lock held, so that a request cannot be
+   * completed, and freed, by its driver meanwhile.
+   */
+
+  pthread_mutex_lock (&svc->asynclock);
+  edgex_device_async_request *req = svc->asyncpending;
+  while (req)
+  {
+    edgex_device_async_request *next = req->next;
+    if (req->deadline <= now)
+    {
+      unlinkPending (req);
+      __atomic_store_n (&req->expired, true, __ATOMIC_RELAXED);
+      svc->asyncexpired++;
+      edgex_stats_count (EDGEX_STATS_DEADLINE_MISSES, 1);
       iot_log_error
       (
-        svc->logger,
-        "No device resource %s for device %s",
-        op->object, dev->name
+        svc->logger, "Deadline passed awaiting driver for device %s",
+        req->dev->name
       );
-      return MHD_HTTP_NOT_FOUND;
+      if (req->isget)
+      {
+        edgex_readcache_end
+          (svc->readcache, req->cached, "", 0, MHD_HTTP_GATEWAY_TIMEOUT);
+      }
+      edgex_http_deferred_complete (req->deferred, MHD_HTTP_GATEWAY_TIMEOUT);
     }
-    n++;
+    req = next;
+  }
+  pthread_mutex_unlock (&svc->asynclock);
+}
+
+void edgex_device_async_drain (edgex_device_service *svc)
+{
+  pthread_mutex_lock (&svc->asynclock);
+  while (svc->asyncexpired)
+  {
+    pthread_cond_wait (&svc->asynccond, &svc->asynclock);
   }
-  if (n > svc->config.device.maxcmdops)
+  pthread_mutex_unlock (&svc->asynclock);
+}
+
+uint64_t edgex_device_async_remaining (const edgex_device_async_request *req)
+{
+  if (req->deadline == 0)
+  {
+    return UINT64_MAX;
+  }
+  uint64_t now = edgex_device_monotime ();
+  return (now < req->deadline) ? (req->deadline - now) / 1000000 : 0;
+}
+
+bool edgex_device_async_cancelled (const edgex_device_async_request *req)
+{
+  return __atomic_load_n (&req->expired, __ATOMIC_RELAXED);
+}
+
+/* Check that a command may be run on a device */
+
+static int checkCommand
+(
+  edgex_device_service *svc,
+  const edgex_device *dev,
+  const edgex_cmdplan_cmd *cmd,
+  edgex_http_method method
+)
+{
+  const edgex_command *command = cmd->command;
+  const edgex_cmdplan_op *plan = (method == GET) ? &cmd->get : &cmd->set;
+
+  if (dev->adminState == LOCKED)
   {
     iot_log_error
     (
       svc->logger,
-      "MaxCmdOps (%d) exceeded for dev: %s cmd: %s method: %s",
-      svc->config.device.maxcmdops, dev->name, command->name,
-      methStr (method)
+      "Can't run command %s on device %s as it is locked",
+      command->name, dev->name
     );
-    return MHD_HTTP_INTERNAL_SERVER_ERROR;
+    return MHD_HTTP_LOCKED;
   }
 
+  if (dev->operatingState == DISABLED)
+  {
+    iot_log_error
+    (
+      svc->logger,
+      "Can't run command %s on device %s as it is disabled",
+      command->name, dev->name
+    );
+    return MHD_HTTP_LOCKED;
+  }
+
+  if
+  (
+    (method == GET && command->get == NULL) ||
+    (method != GET && command->put == NULL)
+  )
+  {
+    iot_log_error
+    (
+      svc->logger,
+      "Command %s found for device %s but no %s version",
+      command->name, dev->name, methStr (method)
+    );
+    return MHD_HTTP_METHOD_NOT_ALLOWED;
+  }
+
+  if (!plan->found)
+  {
+    iot_log_error
+    (
+      svc->logger,
+      "Profile resource %s not found for device %s",
+      command->name, dev->name
+    );
+    return MHD_HTTP_NOT_FOUND;
+  }
+
+  if (plan->missing)
+  {
+    iot_log_error
+    (
+      svc->logger,
+      "No device resource %s for device %s",
+      plan->missing, dev->name
+    );
+    return MHD_HTTP_NOT_FOUND;
+  }
+  return MHD_HTTP_OK;
+}
+
+static int runOne
+(
+  edgex_device_service *svc,
+  edgex_arena *arena,
+  edgex_device *dev,
+  const edgex_cmdplan_cmd *cmd,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_strbuf *reply,
+  edgex_http_response *async,
+  uint64_t deadline
+)
+{
+  const edgex_command *command = cmd->command;
+  const edgex_cmdplan_op *plan = (method == GET) ? &cmd->get : &cmd->set;
+
+  int status = checkCommand (svc, dev, cmd, method);
+  if (status != MHD_HTTP_OK)
+  {
+    return status;
+  }
+
+  EDGEX_TRACE_START (traced);
   if (method == GET)
   {
-    return runOneGet (svc, dev, n, res->get, reply);
+    status = runOneGet
+      (svc, arena, dev, command->name, plan, reply, async, deadline);
   }
   else
   {
@@ -622,93 +1419,335 @@ static int runOne
       iot_log_error (svc->logger, "PUT command recieved with no data");
       return MHD_HTTP_BAD_REQUEST;
     }
-    return runOnePut (svc, dev, n, res->set, upload_data, reply);
+    status =
+      runOnePut (svc, arena, dev, plan, upload_data, async, deadline);
+  }
+
+  /* A deferred command's span is recorded when the driver completes it */
+
+  if (status != CMD_DEFERRED)
+  {
+    EDGEX_TRACE_SPAN (EDGEX_TRACE_COMMAND, traced, dev->name);
+  }
+  return status;
+}
+
+typedef struct devlist
+{
+   edgex_device *dev;
+   const edgex_cmdplan_cmd *cmd;
+   struct devlist *next;
+} devlist;
+
+/*
+ * With AllCommandThreads set, the devices addressed by an "all" command are
+ * run concurrently on a dedicated pool. Each task writes to its own buffer
+ * and the handler collects them in order. A task which overruns the timeout
+ * is abandoned: its device is reported as failed and the task, which cannot
+ * be interrupted, cleans up after itself when the driver eventually returns.
+ * Tasks hold a reference to their device for this reason.
+ */
+
+typedef struct allcmd_batch allcmd_batch;
+
+typedef struct allcmd_task
+{
+  allcmd_batch *batch;
+  edgex_device *dev;
+  const edgex_cmdplan_cmd *cmd;
+  edgex_strbuf out;
+  int status;
+  uint64_t started;
+  bool done;
+  bool abandoned;
+} allcmd_task;
+
+struct allcmd_batch
+{
+  edgex_device_service *svc;
+  edgex_http_method method;
+  char *upload_data;
+  size_t upload_data_size;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint64_t progress;
+  uint64_t deadline;
+  unsigned refs;
+  unsigned ntasks;
+  allcmd_task tasks[];
+};
+
+static void allcmd_batch_unref (allcmd_batch *b)
+{
+  if (--b->refs == 0)
+  {
+    pthread_mutex_unlock (&b->lock);
+    for (unsigned i = 0; i < b->ntasks; i++)
+    {
+      edgex_strbuf_fini (&b->tasks[i].out);
+      edgex_devreg_unpin (b->tasks[i].dev);
+    }
+    pthread_cond_destroy (&b->cond);
+    pthread_mutex_destroy (&b->lock);
+    free (b->upload_data);
+    free (b);
+  }
+  else
+  {
+    pthread_mutex_unlock (&b->lock);
+  }
+}
+
+static void allcmd_run (void *p)
+{
+  allcmd_task *t = (allcmd_task *) p;
+  allcmd_batch *b = t->batch;
+
+  pthread_mutex_lock (&b->lock);
+  bool skip = t->abandoned;
+  t->started = b->progress = edgex_device_monotime ();
+  pthread_mutex_unlock (&b->lock);
+
+  int status = MHD_HTTP_GATEWAY_TIMEOUT;
+  if (!skip)
+  {
+    edgex_arena *arena = edgex_arena_local ();
+    edgex_arena_mark mark = edgex_arena_getmark (arena);
+    status = runOne
+    (
+      b->svc, arena, t->dev, t->cmd, b->method,
+      b->upload_data, b->upload_data_size, &t->out, NULL, b->deadline
+    );
+    edgex_arena_rewind (arena, mark);
+  }
+
+  pthread_mutex_lock (&b->lock);
+  t->status = status;
+  t->done = true;
+  b->progress = edgex_device_monotime ();
+  pthread_cond_broadcast (&b->cond);
+  allcmd_batch_unref (b);
+}
+
+/*
+ * Wait for a task. It is given up on once it has run for longer than the
+ * timeout, or if it has not started and no task has started or finished for
+ * that long (the pool being occupied by devices which are not responding).
+ * Times are taken from the monotonic clock, in nanoseconds; the timeout is
+ * in milliseconds.
+ */
+
+static void allcmd_wait (allcmd_batch *b, allcmd_task *t, uint64_t timeout)
+{
+  timeout *= 1000000ULL;
+  while (!t->done)
+  {
+    if (timeout == 0)
+    {
+      pthread_cond_wait (&b->cond, &b->lock);
+      continue;
+    }
+    uint64_t from = t->started ? t->started : b->progress;
+    uint64_t now = edgex_device_monotime ();
+    if (now >= from + timeout)
+    {
+      t->abandoned = true;
+      t->status = MHD_HTTP_GATEWAY_TIMEOUT;
+      break;
+    }
+    struct timespec ts;
+    ts.tv_sec = (from + timeout) / 1000000000ULL;
+    ts.tv_nsec = (from + timeout) % 1000000000ULL;
+    pthread_cond_timedwait (&b->cond, &b->lock, &ts);
+  }
+}
+
+static allcmd_batch *allcmd_start
+(
+  edgex_device_service *svc,
+  devlist *devs,
+  unsigned ndevs,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  uint64_t deadline
+)
+{
+  allcmd_batch *b =
+    malloc (sizeof (allcmd_batch) + ndevs * sizeof (allcmd_task));
+  b->svc = svc;
+  b->method = method;
+  b->upload_data_size = upload_data_size;
+  b->upload_data = NULL;
+  if (upload_data)
+  {
+    b->upload_data = malloc (upload_data_size + 1);
+    memcpy (b->upload_data, upload_data, upload_data_size);
+    b->upload_data[upload_data_size] = '\0';
+  }
+  pthread_mutex_init (&b->lock, NULL);
+  pthread_condattr_t attr;
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&b->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  b->progress = edgex_device_monotime ();
+  b->deadline = deadline;
+  b->refs = ndevs + 1;
+  b->ntasks = ndevs;
+
+  unsigned i = 0;
+  for (devlist *d = devs; d; d = d->next, i++)
+  {
+    allcmd_task *t = &b->tasks[i];
+    t->batch = b;
+    t->dev = d->dev;
+    t->cmd = d->cmd;
+    t->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+    t->started = 0;
+    t->done = false;
+    t->abandoned = false;
+    edgex_strbuf_init (&t->out);
+    edgex_devreg_pin (t->dev);
   }
+  for (i = 0; i < ndevs; i++)
+  {
+    thpool_add_work (svc->cmdpool, allcmd_run, &b->tasks[i]);
+  }
+  return b;
 }
 
-typedef struct devlist
-{
-   edgex_device *dev;
-   const edgex_command *cmd;
-   struct devlist *next;
-} devlist;
-
 static int allCommand
 (
   edgex_device_service *svc,
+  edgex_arena *arena,
   const char *cmd,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
-  const char *key;
   edgex_device *dev;
-  const edgex_command *command;
+  const edgex_cmdplan_cmd *command;
   int ret = MHD_HTTP_NOT_FOUND;
   int retOne;
-  JSON_Value *jresult;
-  JSON_Array *jarray;
   devlist *devs = NULL;
   devlist *d;
+  unsigned ndevs = 0;
 
   iot_log_debug
     (svc->logger, "Incoming %s command %s for all", methStr (method), cmd);
 
-  jresult = json_value_init_array ();
-  jarray = json_value_get_array (jresult);
-
-  pthread_rwlock_rdlock (&svc->deviceslock);
-  edgex_map_iter iter = edgex_map_iter (svc->devices);
-  while ((key = edgex_map_next (&svc->devices, &iter)))
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_map_iter iter = edgex_map_iter (devices->devices);
+  while ((dev = edgex_devmap_next (devices, &iter)))
   {
-    dev = *edgex_map_get (&svc->devices, key);
     if (dev->operatingState == ENABLED && dev->adminState == UNLOCKED)
     {
-      command = findCommand (cmd, dev->profile->commands);
+      command = edgex_cmdplan_find (edgex_cmdplan_get (dev->profile), cmd);
       if (command)
       {
-        d = malloc (sizeof (devlist));
+        d = edgex_arena_alloc (arena, sizeof (devlist));
         d->dev = dev;
         d->cmd = command;
         d->next = devs;
         devs = d;
+        ndevs++;
       }
     }
   }
-  pthread_rwlock_unlock (&svc->deviceslock);
+
+  allcmd_batch *batch = NULL;
+  if (svc->cmdpool && ndevs > 1)
+  {
+    batch = allcmd_start
+    (
+      svc, devs, ndevs, method, upload_data, upload_data_size,
+      reply->deadline
+    );
+    pthread_mutex_lock (&batch->lock);
+  }
 
   uint32_t nret = 0;
   uint32_t maxret = svc->config.service.readmaxlimit;
+  uint64_t timeout = svc->config.device.allcommandtimeout;
+  edgex_strbuf *body = &reply->body;
+
+  /* Readings are written straight into the reply, or copied to it as each
+   * task is collected. Once ReadMaxLimit is reached, they are discarded.
+   */
 
-  for (d = devs; d; d = d->next)
+  edgex_strbuf_appendchar (body, '[');
+  unsigned i = 0;
+  for (d = devs; d; d = d->next, i++)
   {
-    JSON_Value *jreply = NULL;
-    retOne = runOne
-      (svc, d->dev, d->cmd, method, upload_data, upload_data_size, &jreply);
-    if (jreply && (maxret == 0 || nret++ < maxret))
+    bool keep = (maxret == 0 || nret < maxret);
+    edgex_strbuf *out = keep ? body : edgex_strbuf_scratch ();
+    size_t mark = out->len;
+    if (keep && nret)
+    {
+      edgex_strbuf_appendchar (out, ',');
+    }
+    size_t start = out->len;
+    if (batch)
+    {
+      allcmd_task *t = &batch->tasks[i];
+      allcmd_wait (batch, t, timeout);
+      retOne = t->status;
+      if (t->done && t->out.len)
+      {
+        edgex_strbuf_append (out, t->out.data, t->out.len);
+      }
+    }
+    else
+    {
+      retOne = runOne
+      (
+        svc, arena, d->dev, d->cmd, method,
+        upload_data, upload_data_size, out, NULL, reply->deadline
+      );
+    }
+    if (retOne != MHD_HTTP_OK)
+    {
+      iot_log_error
+      (
+        svc->logger, "Command %s for all: device %s failed with status %d",
+        cmd, d->dev->name, retOne
+      );
+    }
+    if (keep && out->len > start)
     {
-      json_array_append_value (jarray, jreply);
+      nret++;
+    }
+    else
+    {
+      out->len = mark;
+      if (out->data)
+      {
+        out->data[mark] = '\0';
+      }
     }
     if (ret != MHD_HTTP_OK)
     {
       ret = retOne;
     }
   }
+  edgex_strbuf_appendchar (body, ']');
+  if (batch)
+  {
+    allcmd_batch_unref (batch);
+  }
+  edgex_devreg_release (svc->devices);
 
   if (ret == MHD_HTTP_OK)
   {
-    *reply = json_serialize_to_string (jresult);
-    *reply_type = "application/json";
+    reply->type = "application/json";
   }
-  json_value_free (jresult);
-  while (devs)
+  else
   {
-    d = devs->next;
-    free (devs);
-    devs = d;
+    body->len = 0;
+    body->data[0] = '\0';
   }
   return ret;
 }
@@ -716,18 +1755,18 @@ static int allCommand
 static int oneCommand
 (
   edgex_device_service *svc,
+  edgex_arena *arena,
   const char *id,
   bool byName,
   const char *cmd,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
   int result = MHD_HTTP_NOT_FOUND;
-  edgex_device **dev = NULL;
+  edgex_device *dev;
 
   iot_log_debug
   (
@@ -736,108 +1775,545 @@ static int oneCommand
     id, cmd, methStr (method)
   );
 
-  pthread_rwlock_rdlock (&svc->deviceslock);
-  if (byName)
-  {
-    char **found = edgex_map_get (&svc->name_to_id, id);
-    if (found)
-    {
-      dev = edgex_map_get (&svc->devices, *found);
-    }
-  }
-  else
-  {
-    dev = edgex_map_get (&svc->devices, id);
-  }
-  pthread_rwlock_unlock (&svc->deviceslock);
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  dev = byName ?
+    edgex_devmap_findbyname (devices, id) : edgex_devmap_find (devices, id);
   if (dev)
   {
-    const edgex_command *command = findCommand (cmd, (*dev)->profile->commands);
+    const edgex_cmdplan_cmd *command =
+      edgex_cmdplan_find (edgex_cmdplan_get (dev->profile), cmd);
     if (command)
     {
-      JSON_Value *jreply = NULL;
       result = runOne
-        (svc, *dev, command, method, upload_data, upload_data_size, &jreply);
-      if (jreply)
+      (
+        svc, arena, dev, command, method,
+        upload_data, upload_data_size, &reply->body, reply, reply->deadline
+      );
+      if (result != CMD_DEFERRED && reply->body.len)
       {
-        *reply = json_serialize_to_string (jreply);
-        *reply_type = "application/json";
-        json_value_free (jreply);
+        reply->type = "application/json";
       }
     }
     else
     {
       iot_log_error
-        (svc->logger, "Command %s not found for device %s", cmd, (*dev)->name);
+        (svc->logger, "Command %s not found for device %s", cmd, dev->name);
     }
   }
   else
   {
     iot_log_error (svc->logger, "No such device {%s}", id);
   }
+  edgex_devreg_release (svc->devices);
   return result;
 }
 
 int edgex_device_handler_device
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
-  int result = MHD_HTTP_NOT_FOUND;
-  char *cmd;
+  int result;
   edgex_device_service *svc = (edgex_device_service *) ctx;
+  edgex_arena *arena = edgex_arena_local ();
+  edgex_arena_mark mark = edgex_arena_getmark (arena);
+  const char *cmd = edgex_http_param (params, "command");
+  const char *id = edgex_http_param (params, "id");
+  const char *name = edgex_http_param (params, "name");
 
-  if (strlen (url) == 0)
+  if (id || name)
   {
-    iot_log_error (svc->logger, "No device specified in url");
+    result = oneCommand
+    (
+      svc, arena,
+      id ? id : name, id == NULL, cmd, method,
+      upload_data, upload_data_size,
+      reply
+    );
   }
   else
   {
-    if (strncmp (url, "all/", 4) == 0)
+    result = allCommand
+    (
+      svc, arena, cmd, method,
+      upload_data, upload_data_size, reply
+    );
+  }
+  edgex_arena_rewind (arena, mark);
+  return result;
+}
+
+/* Parse an optional numeric argument of a history request */
+
+static bool historyArg
+  (const edgex_http_response *reply, const char *name, uint64_t *val)
+{
+  const char *arg = edgex_http_request_arg (reply, name);
+  char *end;
+
+  if (arg == NULL)
+  {
+    return true;
+  }
+  errno = 0;
+  *val = strtoull (arg, &end, 10);
+  return (*arg && *end == '\0' && *arg != '-' && errno == 0);
+}
+
+int edgex_device_handler_history
+(
+  void *ctx,
+  const edgex_http_params *params,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_http_response *reply
+)
+{
+  edgex_device_service *svc = (edgex_device_service *) ctx;
+  const char *cmd = edgex_http_param (params, "command");
+  const char *id = edgex_http_param (params, "id");
+  const char *name = edgex_http_param (params, "name");
+  uint64_t start = 0;
+  uint64_t end = UINT64_MAX;
+  uint64_t limit = UINT32_MAX;
+  int result = MHD_HTTP_NOT_FOUND;
+
+  if (svc->history == NULL)
+  {
+    iot_log_error (svc->logger, "History requested but HistorySize is 0");
+    return MHD_HTTP_NOT_FOUND;
+  }
+  if
+  (
+    !historyArg (reply, "start", &start) || !historyArg (reply, "end", &end) ||
+    !historyArg (reply, "limit", &limit) || limit > UINT32_MAX
+  )
+  {
+    return MHD_HTTP_BAD_REQUEST;
+  }
+  if (!edgex_http_request_arg (reply, "start") &&
+      !edgex_http_request_arg (reply, "end"))
+  {
+    limit = 1;
+  }
+
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_device *dev = name ?
+    edgex_devmap_findbyname (devices, name) : edgex_devmap_find (devices, id);
+  const edgex_cmdplan_cmd *command =
+    dev ? edgex_cmdplan_find (edgex_cmdplan_get (dev->profile), cmd) : NULL;
+  if (command && command->get.found && command->get.missing == NULL)
+  {
+    /* The entity tag is the sequence number of the latest reading, so it
+     * can be checked before any readings are written
+     */
+
+    const edgex_cmdplan_op *op = &command->get;
+    const char *match = edgex_http_request_header (reply, "If-None-Match");
+    uint64_t seq = 0;
+    for (uint32_t i = 0; i < op->nreqs; i++)
     {
-      cmd = url + 4;
-      if (strlen (cmd))
-      {
-        result = allCommand
-          (svc, cmd, method, upload_data, upload_data_size, reply, reply_type);
-      }
-      else
+      edgex_history_query
+      (
+        svc->history, dev->name, op->reqs[i].devobj->name,
+        0, 0, 0, NULL, true, &seq
+      );
+    }
+    snprintf (reply->etag, sizeof (reply->etag), "\"%" PRIx64 "\"", seq);
+    if (match && edgex_http_etag_match (match, reply->etag))
+    {
+      result = MHD_HTTP_NOT_MODIFIED;
+    }
+    else
+    {
+      edgex_strbuf *buf = &reply->body;
+      bool first = true;
+      seq = 0;
+      edgex_strbuf_appendstr (buf, "{\"device\":");
+      edgex_strbuf_appendjson (buf, dev->name);
+      edgex_strbuf_appendstr (buf, ",\"readings\":[");
+      for (uint32_t i = 0; i < op->nreqs; i++)
       {
-        iot_log_error (svc->logger, "No command specified in url");
+        if
+        (
+          edgex_history_query
+          (
+            svc->history, dev->name, op->reqs[i].devobj->name,
+            start, end, limit, buf, first, &seq
+          )
+        )
+        {
+          first = false;
+        }
       }
+      edgex_strbuf_appendstr (buf, "]}");
+      snprintf (reply->etag, sizeof (reply->etag), "\"%" PRIx64 "\"", seq);
+      reply->type = "application/json";
+      result = MHD_HTTP_OK;
     }
-    else
+  }
+  else if (dev)
+  {
+    iot_log_error
+      (svc->logger, "No GET command %s for device %s", cmd, dev->name);
+  }
+  else
+  {
+    iot_log_error (svc->logger, "No such device {%s}", name ? name : id);
+  }
+  edgex_devreg_release (svc->devices);
+  return result;
+}
+
+static void dupValue (edgex_device_commandresult *res)
+{
+  if (res->type == String)
+  {
+    res->value.string_result = strdup (res->value.string_result);
+  }
+  else if (res->type == Binary)
+  {
+    void *bytes = malloc (res->value.binary_result.size);
+    memcpy (bytes, res->value.binary_result.bytes, res->value.binary_result.size);
+    res->value.binary_result.bytes = bytes;
+  }
+  res->release = NULL;
+}
+
+static bool sameString (const char *a, const char *b)
+{
+  return (a && b) ? strcmp (a, b) == 0 : a == b;
+}
+
+/* Whether two resource operations would have the driver read the same way */
+
+static bool sameOperation
+  (const edgex_resourceoperation *a, const edgex_resourceoperation *b)
+{
+  const edgex_strings *as = a->secondary;
+  const edgex_strings *bs = b->secondary;
+  const edgex_nvpairs *am = a->mappings;
+  const edgex_nvpairs *bm = b->mappings;
+
+  if (a == b)
+  {
+    return true;
+  }
+  if
+  (
+    !sameString (a->object, b->object) ||
+    !sameString (a->property, b->property) ||
+    !sameString (a->parameter, b->parameter) ||
+    !sameString (a->resource, b->resource)
+  )
+  {
+    return false;
+  }
+  for (; as && bs; as = as->next, bs = bs->next)
+  {
+    if (!sameString (as->str, bs->str))
+    {
+      return false;
+    }
+  }
+  for (; am && bm; am = am->next, bm = bm->next)
+  {
+    if (!sameString (am->name, bm->name) || !sameString (am->value, bm->value))
+    {
+      return false;
+    }
+  }
+  return as == bs && am == bm;
+}
+
+/*
+ * Run several GET commands with one driver call. Each device resource is
+ * read once per distinct resource operation; a reading needed by more than
+ * one command is copied, as the value is consumed when its event is written.
+ */
+
+static void runMergedGet
+(
+  edgex_device_service *svc,
+  edgex_arena *arena,
+  edgex_device *dev,
+  unsigned nplans,
+  const edgex_cmdplan_op **plans,
+  bool combine,
+  uint64_t deadline
+)
+{
+  if (deadlinePassed (svc, dev, deadline))
+  {
+    return;
+  }
+
+  uint32_t total = 0;
+  for (unsigned k = 0; k < nplans; k++)
+  {
+    total += plans[k]->nreqs;
+  }
+
+  edgex_device_async_request *req = NULL;
+  edgex_device_commandrequest *requests;
+  edgex_device_commandresult *results;
+  if (asyncUsed (svc, true))
+  {
+    req = asyncNew (svc, dev, total, true, deadline);
+    requests = req->requests;
+    results = req->results;
+  }
+  else
+  {
+    requests =
+      edgex_arena_alloc (arena, total * sizeof (edgex_device_commandrequest));
+    results =
+      edgex_arena_calloc (arena, total, sizeof (edgex_device_commandresult));
+  }
+
+  /* Form the union of the requests, noting where each plan's readings are */
+
+  uint32_t nunion = 0;
+  uint32_t *where = edgex_arena_alloc (arena, total * sizeof (uint32_t));
+  uint32_t n = 0;
+  for (unsigned k = 0; k < nplans; k++)
+  {
+    for (uint32_t j = 0; j < plans[k]->nreqs; j++)
     {
-      bool byName = false;
-      if (strncmp (url, "name/", 4) == 0)
+      const edgex_device_commandrequest *r = &plans[k]->reqs[j];
+      uint32_t u;
+      for (u = 0; u < nunion; u++)
       {
-        byName = true;
-        url += 5;
+        if
+        (
+          requests[u].devobj == r->devobj &&
+          sameOperation (requests[u].ro, r->ro)
+        )
+        {
+          break;
+        }
       }
-      cmd = strchr (url, '/');
-      if (cmd == NULL || strlen (cmd + 1) == 0)
+      if (u == nunion)
       {
-        iot_log_error (svc->logger, "No command specified in url");
+        requests[nunion++] = *r;
       }
-      else
+      where[n++] = u;
+    }
+  }
+
+  bool ok;
+  uint64_t started = edgex_device_monotime ();
+  if (req)
+  {
+    req->nreqs = nunion;
+    asyncRun (req, NULL);
+    if (req->missed)
+    {
+      asyncFree (req);
+      return;
+    }
+    ok = req->ok;
+  }
+  else
+  {
+    ok = svc->userfns.gethandler
+      (svc->userdata, dev->addressable, nunion, requests, results);
+  }
+  uint64_t ns = noteDriver (svc, dev, NULL, true, started, ok);
+  for (unsigned k = 0; k < nplans; k++)
+  {
+    edgex_stats_calls_note (plans[k]->stats, ok, ns);
+  }
+
+  edgex_strbuf *reply = edgex_strbuf_scratch ();
+  if (!ok || combine)
+  {
+    finishGet (svc, dev, nunion, requests, results, ok, reply, NULL);
+  }
+  else
+  {
+    /* One clock read stamps the whole batch, though it becomes several
+     * events, each of which would otherwise read the clock.
+     */
+
+    uint64_t now = edgex_device_origintime ();
+    for (unsigned i = 0; i < nunion; i++)
+    {
+      if (results[i].origin == 0)
+      {
+        results[i].origin = now;
+      }
+    }
+
+    /* Distribute the readings before any is consumed */
+
+    edgex_device_commandrequest **reqs =
+      edgex_arena_alloc (arena, nplans * sizeof (edgex_device_commandrequest *));
+    edgex_device_commandresult **vals =
+      edgex_arena_alloc (arena, nplans * sizeof (edgex_device_commandresult *));
+    bool *used = edgex_arena_calloc (arena, nunion, sizeof (bool));
+    n = 0;
+    for (unsigned k = 0; k < nplans; k++)
+    {
+      uint32_t nreqs = plans[k]->nreqs;
+      reqs[k] = plans[k]->reqs;
+      vals[k] =
+        edgex_arena_alloc (arena, nreqs * sizeof (edgex_device_commandresult));
+      for (uint32_t j = 0; j < nreqs; j++, n++)
       {
-         *cmd = '\0';
-         result = oneCommand
-         (
-           svc,
-           url, byName, cmd + 1, method,
-           upload_data, upload_data_size,
-           reply, reply_type
-         );
-         *cmd = '/';
+        vals[k][j] = results[where[n]];
+        if (used[where[n]])
+        {
+          dupValue (&vals[k][j]);
+        }
+        used[where[n]] = true;
       }
     }
+    for (unsigned k = 0; k < nplans; k++)
+    {
+      reply->len = 0;
+      finishGet
+        (svc, dev, plans[k]->nreqs, reqs[k], vals[k], true, reply, NULL);
+    }
+  }
+  asyncFree (req);
+}
+
+void edgex_device_binding_init
+  (edgex_device_binding *b, const char *id, bool byName, const char *cmd)
+{
+  b->id = id;
+  b->byName = byName;
+  b->cmd = cmd;
+  b->generation = 0;
+  b->dev = NULL;
+  b->command = NULL;
+}
+
+/* Look up a binding's device and command if the device map has changed */
+
+static bool bindingResolve
+(
+  edgex_device_service *svc,
+  const edgex_devmap *devices,
+  edgex_device_binding *b
+)
+{
+  if (b->generation != devices->generation)
+  {
+    b->generation = devices->generation;
+    b->dev = b->byName ?
+      edgex_devmap_findbyname (devices, b->id) :
+      edgex_devmap_find (devices, b->id);
+    b->command = b->dev ?
+      edgex_cmdplan_find (edgex_cmdplan_get (b->dev->profile), b->cmd) : NULL;
+  }
+  if (b->dev == NULL)
+  {
+    iot_log_error (svc->logger, "No such device {%s}", b->id);
+    return false;
+  }
+  if (b->command == NULL)
+  {
+    iot_log_error
+      (svc->logger, "Command %s not found for device %s", b->cmd, b->dev->name);
+    return false;
+  }
+  return true;
+}
+
+int edgex_device_get_bound
+  (edgex_device_service *svc, edgex_device_binding *b)
+{
+  int result = MHD_HTTP_NOT_FOUND;
+  edgex_arena *arena = edgex_arena_local ();
+  edgex_arena_mark mark = edgex_arena_getmark (arena);
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+
+  if (bindingResolve (svc, devices, b))
+  {
+    result = checkCommand (svc, b->dev, b->command, GET);
+    if (result == MHD_HTTP_OK)
+    {
+      result = runOneGet
+      (
+        svc, arena, b->dev, b->cmd, &b->command->get,
+        edgex_strbuf_scratch (), NULL, commandDeadline (svc)
+      );
+    }
   }
+  edgex_devreg_release (svc->devices);
+  edgex_arena_rewind (arena, mark);
   return result;
 }
+
+void edgex_device_get_merged
+(
+  edgex_device_service *svc,
+  unsigned nbindings,
+  edgex_device_binding **bindings,
+  bool combine
+)
+{
+  edgex_arena *arena = edgex_arena_local ();
+  edgex_arena_mark mark = edgex_arena_getmark (arena);
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  const edgex_cmdplan_op **plans =
+    edgex_arena_alloc (arena, nbindings * sizeof (edgex_cmdplan_op *));
+  const char **names = edgex_arena_alloc (arena, nbindings * sizeof (char *));
+  edgex_device *dev = NULL;
+  unsigned nplans = 0;
+  uint32_t total = 0;
+  uint64_t deadline = commandDeadline (svc);
+
+  for (unsigned i = 0; i < nbindings; i++)
+  {
+    edgex_device_binding *b = bindings[i];
+    if (!bindingResolve (svc, devices, b))
+    {
+      continue;
+    }
+    dev = b->dev;
+    if (b->command->get.denied)
+    {
+      iot_log_error
+      (
+        svc->logger, "Attempt to read unreadable value %s",
+        b->command->get.denied
+      );
+    }
+    else if (checkCommand (svc, dev, b->command, GET) == MHD_HTTP_OK)
+    {
+      names[nplans] = b->cmd;
+      plans[nplans++] = &b->command->get;
+      total += b->command->get.nreqs;
+    }
+  }
+
+  uint32_t maxops = svc->config.device.maxcmdops;
+  if (nplans > 1 && (maxops == 0 || total <= maxops))
+  {
+    iot_log_debug
+      (svc->logger, "Reading %u commands on device %s", nplans, dev->name);
+    runMergedGet (svc, arena, dev, nplans, plans, combine, deadline);
+  }
+  else
+  {
+    for (unsigned k = 0; k < nplans; k++)
+    {
+      runOneGet
+      (
+        svc, arena, dev, names[k], plans[k], edgex_strbuf_scratch (), NULL,
+        deadline
+      );
+    }
+  }
+  edgex_devreg_release (svc->devices);
+  edgex_arena_rewind (arena, mark);
+}
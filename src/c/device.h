@@ -11,18 +11,97 @@
 
 #include "edgex/devsdk.h"
 #include "rest_server.h"
+#include "numfmt.h"
+#include "cmdplan.h"
 
 extern int edgex_device_handler_device
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 );
 
+/*
+ * Return the recent readings of a GET command's device resources from the
+ * history, without reading the device. With no start or end argument (in
+ * the units of origins) only the latest reading of each resource is returned, up to
+ * limit readings of each otherwise.
+ */
+
+extern int edgex_device_handler_history
+(
+  void *ctx,
+  const edgex_http_params *params,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_http_response *reply
+);
+
+/*
+ * A command on a device, for repeated use by scheduled events. The device
+ * and command are looked up on first use and again only when the set of
+ * devices has changed. A binding must not be used by two threads at once.
+ */
+
+typedef struct edgex_device_binding
+{
+  const char *id;
+  bool byName;
+  const char *cmd;
+  uint64_t generation;
+  edgex_device *dev;
+  const edgex_cmdplan_cmd *command;
+} edgex_device_binding;
+
+/* Initialize a binding. The strings are not copied */
+
+extern void edgex_device_binding_init
+  (edgex_device_binding *b, const char *id, bool byName, const char *cmd);
+
+/*
+ * Run a GET command on a bound device and submit the resulting event.
+ * Returns the HTTP status which the equivalent REST request would give.
+ */
+
+extern int edgex_device_get_bound
+  (edgex_device_service *svc, edgex_device_binding *b);
+
+/*
+ * Run GET commands on a device with a single call to the driver, covering
+ * the union of the commands' resources. The bindings must all be for the
+ * same device. The readings are submitted as one event per command or, if
+ * combine is set, as a single event.
+ */
+
+extern void edgex_device_get_merged
+(
+  edgex_device_service *svc,
+  unsigned nbindings,
+  edgex_device_binding **bindings,
+  bool combine
+);
+
+/*
+ * Send a timeout reply for each deferred command whose deadline has passed
+ * while awaiting its driver. Run periodically if Service/RequestTimeout is
+ * set.
+ */
+
+#define EDGEX_DEVICE_EXPIRE_PERIOD (100 * 1000000ULL)
+
+extern void edgex_device_async_expire (void *svc);
+
+/*
+ * Wait until the drivers have completed all commands whose replies were
+ * sent as timeouts.
+ */
+
+extern void edgex_device_async_drain (edgex_device_service *svc);
+
 extern char *edgex_value_tostring
 (
   edgex_device_resultvalue value,
@@ -31,4 +110,39 @@ extern char *edgex_value_tostring
   edgex_nvpairs *mappings
 );
 
+/*
+ * As edgex_value_tostring, but numeric and boolean values are formatted into
+ * buf, which must have space for EDGEX_FMT_BUFSIZE characters. The result
+ * should be freed only if it is not buf.
+ */
+
+extern char *edgex_value_tostring_r
+(
+  edgex_device_resultvalue value,
+  bool xform,
+  edgex_propertyvalue *props,
+  edgex_nvpairs *mappings,
+  char *buf
+);
+
+/*
+ * Format a value whose numeric transforms, if any, have already been applied.
+ * String values are translated through the mappings, which may be NULL. A
+ * string or byte array is freed if owned; otherwise it is left for its
+ * lender, and an unmapped string is returned as is, not to be freed.
+ */
+
+extern char *edgex_value_format
+(
+  edgex_device_resultvalue value,
+  edgex_propertyvalue *props,
+  edgex_nvpairs *mappings,
+  char *buf,
+  bool owned
+);
+
+/* Return the buffer of a result lent by a driver, if it has a release */
+
+extern void edgex_value_release (const edgex_device_commandresult *res);
+
 #endif
@@ -18,37 +18,72 @@
 
 /* Device (collection) management functions */
 
-char * edgex_device_add_device
-(
-  edgex_device_service *svc,
-  const char *name,
-  const char *description,
-  const edgex_strings *labels,
-  const char *profile_name,
-  edgex_addressable *address,
-  edgex_error *err
-)
+/*
+ * Devices are added in batches. The profiles named in a batch are looked up
+ * first, once each, then the requests to metadata for the devices are run
+ * concurrently on the executor. The devices added are entered into the
+ * registry in a single update.
+ */
+
+#define ADD_TASKS 8
+
+typedef edgex_map(unsigned) edgex_map_index;
+
+typedef struct profile_lookup
 {
-  const char *postfix = "_addr";
-  char **dev_id;
-  char *result = NULL;
+  const char *name;
+  edgex_deviceprofile *profile;
+  edgex_error err;
+} profile_lookup;
 
-  *err = EDGEX_OK;
-  pthread_rwlock_rdlock (&svc->deviceslock);
-  dev_id = edgex_map_get (&svc->name_to_id, name);
-  pthread_rwlock_unlock (&svc->deviceslock);
+typedef struct device_add
+{
+  edgex_device_add_request *req;
+  profile_lookup *lookup;
+  edgex_device *dev;
+} device_add;
+
+typedef struct device_batch
+{
+  edgex_device_service *svc;
+  profile_lookup *lookups;
+  device_add *adds;
+} device_batch;
+
+static void profile_lookup_run (void *arg, unsigned i)
+{
+  device_batch *b = (device_batch *) arg;
+  profile_lookup *l = &b->lookups[i];
 
-  if (dev_id)
+  l->err = EDGEX_OK;
+  l->profile = edgex_deviceprofile_get (b->svc, l->name, &l->err);
+  if (l->profile == NULL)
   {
-    iot_log_info (svc->logger, "Device %s already present", name);
-    return strdup (*dev_id);
+    iot_log_error (b->svc->logger, "Device profile %s not found", l->name);
+    l->err = EDGEX_NO_DEVICE_PROFILE;
   }
+}
 
-  edgex_addressable *newaddr = edgex_addressable_dup (address);
+static void device_add_run (void *arg, unsigned i)
+{
+  const char *postfix = "_addr";
+  device_batch *b = (device_batch *) arg;
+  device_add *a = &b->adds[i];
+  edgex_device_add_request *req = a->req;
+  edgex_device_service *svc = b->svc;
+  edgex_error *err = &req->err;
+
+  if (a->lookup->profile == NULL)
+  {
+    *err = a->lookup->err;
+    return;
+  }
+
+  edgex_addressable *newaddr = edgex_addressable_dup (req->address);
   if (newaddr->name == NULL)
   {
-    newaddr->name = malloc (strlen (name) + strlen (postfix) + 1);
-    strcpy (newaddr->name, name);
+    newaddr->name = malloc (strlen (req->name) + strlen (postfix) + 1);
+    strcpy (newaddr->name, req->name);
     strcat (newaddr->name, postfix);
   }
 
@@ -63,7 +98,9 @@ char * edgex_device_add_device
   if (existingaddr)
   {
     iot_log_info (svc->logger, "Addressable %s already exists", newaddr->name);
-    edgex_addressable_free (existingaddr);
+    existingaddr->origin = newaddr->origin;
+    edgex_addressable_free (newaddr);
+    newaddr = existingaddr;
   }
   else
   {
@@ -76,34 +113,187 @@ char * edgex_device_add_device
     iot_log_info (svc->logger, "New addressable %s created", newaddr->name);
   }
 
-  err->code = 0;
+  *err = EDGEX_OK;
   edgex_device *newdev = edgex_metadata_client_add_device
   (
     svc->logger,
     &svc->config.endpoints,
-    name,
-    description,
-    labels,
+    req->name,
+    req->description ? req->description : "",
+    req->labels,
     newaddr->origin,
     newaddr->name,
     svc->name,
-    profile_name,
+    req->profile_name,
     err
   );
 
   if (err->code == 0)
   {
-    result = strdup (newdev->id);
-    iot_log_info (svc->logger, "Device %s added with id %s", name, result);
+    req->id = strdup (newdev->id);
+    iot_log_info
+      (svc->logger, "Device %s added with id %s", req->name, req->id);
+
+    /* Complete the device for our registry */
+
+    edgex_addressable_free (newdev->addressable);
+    newdev->addressable = newaddr;
+    edgex_deviceprofile_free (newdev->profile);
+    newdev->profile = edgex_deviceprofile_ref (a->lookup->profile);
+    newdev->origin = newaddr->origin;
+    newdev->service->id = strdup ("");
+    newdev->service->description = strdup ("");
+    a->dev = newdev;
   }
   else
   {
     iot_log_error
       (svc->logger, "Failed to add Device in core-metadata: %s", err->reason);
+    edgex_device_free (newdev);
+    edgex_addressable_free (newaddr);
   }
-  edgex_device_free (newdev);
-  edgex_addressable_free (newaddr);
-  return result;
+}
+
+void edgex_device_add_devices
+(
+  edgex_device_service *svc,
+  unsigned count,
+  edgex_device_add_request *devices,
+  edgex_error *err
+)
+{
+  device_batch b;
+  edgex_map_index names;
+  edgex_map_index profiles;
+  unsigned *first;
+  unsigned nadds = 0;
+  unsigned nlookups = 0;
+
+  *err = EDGEX_OK;
+  b.svc = svc;
+  b.adds = calloc (count ? count : 1, sizeof (device_add));
+  b.lookups = calloc (count ? count : 1, sizeof (profile_lookup));
+  first = calloc (count ? count : 1, sizeof (unsigned));
+  edgex_map_init (&names);
+  edgex_map_init (&profiles);
+
+  /* Skip devices which are already present or repeated in the batch, and
+   * note the profiles needed for the others.
+   */
+
+  const edgex_devmap *current = edgex_devreg_acquire (svc->devices);
+  for (unsigned i = 0; i < count; i++)
+  {
+    edgex_device_add_request *req = &devices[i];
+    req->id = NULL;
+    req->err = EDGEX_OK;
+    first[i] = i;
+
+    unsigned *prev = edgex_map_get (&names, req->name);
+    if (prev)
+    {
+      first[i] = *prev;
+      continue;
+    }
+    edgex_map_set (&names, req->name, i);
+    edgex_device *existing = edgex_devmap_findbyname (current, req->name);
+    if (existing)
+    {
+      req->id = strdup (existing->id);
+      iot_log_info (svc->logger, "Device %s already present", req->name);
+      continue;
+    }
+
+    unsigned *l = edgex_map_get (&profiles, req->profile_name);
+    if (l == NULL)
+    {
+      b.lookups[nlookups].name = req->profile_name;
+      edgex_map_set (&profiles, req->profile_name, nlookups);
+      l = edgex_map_get (&profiles, req->profile_name);
+      nlookups++;
+    }
+    b.adds[nadds].req = req;
+    b.adds[nadds].lookup = &b.lookups[*l];
+    nadds++;
+  }
+  edgex_devreg_release (svc->devices);
+
+  edgex_executor_forall
+  (
+    svc->executor, EDGEX_EXEC_COMMAND, nlookups, ADD_TASKS,
+    profile_lookup_run, &b
+  );
+  edgex_executor_forall
+    (svc->executor, EDGEX_EXEC_COMMAND, nadds, ADD_TASKS, device_add_run, &b);
+
+  /* Metadata's callback for a new device may have been handled already, in
+   * which case that version is kept.
+   */
+
+  edgex_devmap *update = edgex_devreg_begin (svc->devices);
+  for (unsigned i = 0; i < nadds; i++)
+  {
+    edgex_device *dev = b.adds[i].dev;
+    if (dev)
+    {
+      if (edgex_devmap_findbyname (update, dev->name))
+      {
+        edgex_device_free (dev);
+      }
+      else
+      {
+        edgex_devmap_add (update, dev);
+      }
+    }
+  }
+  edgex_devreg_commit (svc->devices, update);
+
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (first[i] != i)
+    {
+      devices[i].err = devices[first[i]].err;
+      if (devices[first[i]].id)
+      {
+        devices[i].id = strdup (devices[first[i]].id);
+      }
+    }
+    if (devices[i].err.code && err->code == 0)
+    {
+      *err = devices[i].err;
+    }
+  }
+
+  for (unsigned i = 0; i < nlookups; i++)
+  {
+    if (b.lookups[i].profile)
+    {
+      edgex_deviceprofile_free (b.lookups[i].profile);
+    }
+  }
+  edgex_map_deinit (&profiles);
+  edgex_map_deinit (&names);
+  free (first);
+  free (b.lookups);
+  free (b.adds);
+}
+
+char * edgex_device_add_device
+(
+  edgex_device_service *svc,
+  const char *name,
+  const char *description,
+  const edgex_strings *labels,
+  const char *profile_name,
+  edgex_addressable *address,
+  edgex_error *err
+)
+{
+  edgex_device_add_request req =
+    { name, description, labels, profile_name, address, NULL, EDGEX_OK };
+
+  edgex_device_add_devices (svc, 1, &req, err);
+  return req.id;
 }
 
 edgex_device * edgex_device_devices
@@ -119,28 +309,31 @@ edgex_device * edgex_device_devices
     return NULL;
   }
 
-  pthread_rwlock_wrlock (&svc->deviceslock);
+  edgex_device *devs = NULL;
   for (edgex_device *d = result; d; d = d->next)
   {
-    if (edgex_map_get (&svc->name_to_id, d->name) == NULL)
-    {
-      edgex_device *dup = edgex_device_dup (d);
-      edgex_map_set (&svc->devices, dup->id, dup);
-      edgex_map_set (&svc->name_to_id, dup->name, dup->id);
-    }
+    edgex_device *dev = edgex_device_dup (d);
+    dev->profile = edgex_deviceprofile_intern (svc, dev->profile);
+    dev->next = devs;
+    devs = dev;
   }
-  pthread_rwlock_unlock (&svc->deviceslock);
 
-  pthread_mutex_lock (&svc->profileslock);
-  for (edgex_device *d = result; d; d = d->next)
+  edgex_devmap *update = edgex_devreg_begin (svc->devices);
+  while (devs)
   {
-    if (edgex_map_get (&svc->profiles, d->profile->name) == NULL)
+    edgex_device *dev = devs;
+    devs = dev->next;
+    dev->next = NULL;
+    if (edgex_devmap_findbyname (update, dev->name) == NULL)
     {
-      edgex_deviceprofile *dup = edgex_deviceprofile_dup (d->profile);
-      edgex_map_set (&svc->profiles, dup->name, dup);
+      edgex_devmap_add (update, dev);
+    }
+    else
+    {
+      edgex_device_free (dev);
     }
   }
-  pthread_mutex_unlock (&svc->profileslock);
+  edgex_devreg_commit (svc->devices, update);
 
   return result;
 }
@@ -149,13 +342,13 @@ edgex_device * edgex_device_get_device
   (edgex_device_service *svc, const char *id)
 {
   edgex_device *result = NULL;
-  pthread_rwlock_rdlock (&svc->deviceslock);
-  edgex_device **orig = edgex_map_get (&svc->devices, id);
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_device *orig = edgex_devmap_find (devices, id);
   if (orig)
   {
-    result = edgex_device_dup (*orig);
+    result = edgex_device_dup (orig);
   }
-  pthread_rwlock_unlock (&svc->deviceslock);
+  edgex_devreg_release (svc->devices);
   return result;
 }
 
@@ -163,16 +356,51 @@ edgex_device * edgex_device_get_device_byname
   (edgex_device_service *svc, const char *name)
 {
   edgex_device *result = NULL;
-  pthread_rwlock_rdlock (&svc->deviceslock);
-  char **id = edgex_map_get (&svc->name_to_id, name);
-  if (id)
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_device *orig = edgex_devmap_findbyname (devices, name);
+  if (orig)
   {
-    result = edgex_device_dup (*edgex_map_get (&svc->devices, *id));
+    result = edgex_device_dup (orig);
   }
-  pthread_rwlock_unlock (&svc->deviceslock);
+  edgex_devreg_release (svc->devices);
   return result;
 }
 
+const edgex_device * edgex_device_acquire_device
+  (edgex_device_service *svc, const char *id)
+{
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_device *result = edgex_devmap_find (devices, id);
+  if (result)
+  {
+    edgex_devreg_pin (result);
+  }
+  edgex_devreg_release (svc->devices);
+  return result;
+}
+
+const edgex_device * edgex_device_acquire_device_byname
+  (edgex_device_service *svc, const char *name)
+{
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_device *result = edgex_devmap_findbyname (devices, name);
+  if (result)
+  {
+    edgex_devreg_pin (result);
+  }
+  edgex_devreg_release (svc->devices);
+  return result;
+}
+
+void edgex_device_release_device
+  (edgex_device_service *svc, const edgex_device *dev)
+{
+  if (dev)
+  {
+    edgex_devreg_unpin ((edgex_device *) dev);
+  }
+}
+
 void edgex_device_remove_device
   (edgex_device_service *svc, const char *id, edgex_error *err)
 {
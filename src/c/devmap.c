@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "devmap.h"
+#include "edgex_rest.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ * Reclamation is epoch-based. The registry holds a global epoch, advanced on
+ * each commit. A reader records the epoch in its own slot on entry and clears
+ * it on exit; no locks or read-modify-write operations are needed. A writer
+ * publishes the new map, advances the epoch to E and puts the previous map in
+ * limbo tagged with E. Once every slot is either clear or holds an epoch of
+ * at least E, no reader can hold that map and it is freed. Limbo is checked
+ * on each commit, so writers never wait for readers (which may be blocked on
+ * a driver or on a request which itself causes a metadata callback).
+ *
+ * Devices are reference counted so that they can be pinned beyond a read-side
+ * section. The registry's own reference is dropped when a removed device
+ * leaves limbo; a reader can only pin a device before that point, so the count
+ * never rises from zero.
+ */
+
+typedef struct devreg_limbo
+{
+  uint64_t epoch;
+  edgex_devmap *map;
+  edgex_device **retired;
+  unsigned nretired;
+  struct devreg_limbo *next;
+} devreg_limbo;
+
+typedef struct devreg_reader
+{
+  uint64_t epoch;
+  unsigned depth;
+  bool inuse;
+  struct devreg_reader *next;
+} devreg_reader;
+
+struct edgex_devreg
+{
+  edgex_devmap *current;
+  uint64_t epoch;
+  pthread_mutex_t writelock;
+  pthread_mutex_t readerslock;
+  devreg_reader *readers;
+  devreg_limbo *limbo;
+  pthread_key_t key;
+};
+
+static edgex_devmap *devmap_new (void)
+{
+  edgex_devmap *m = malloc (sizeof (edgex_devmap));
+  edgex_map_init (&m->devices);
+  edgex_map_init (&m->names);
+  m->generation = 0;
+  m->retired = NULL;
+  m->nretired = 0;
+  return m;
+}
+
+static void devmap_free (edgex_devmap *m)
+{
+  edgex_map_deinit (&m->devices);
+  edgex_map_deinit (&m->names);
+  free (m->retired);
+  free (m);
+}
+
+void edgex_devreg_pin (edgex_device *dev)
+{
+  __atomic_add_fetch (&dev->refs, 1, __ATOMIC_RELAXED);
+}
+
+void edgex_devreg_unpin (edgex_device *dev)
+{
+  if (__atomic_sub_fetch (&dev->refs, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    edgex_stats_device_unref (dev->stats);
+    dev->stats = NULL;
+    edgex_device_free (dev);
+  }
+}
+
+static void devreg_limbo_free (devreg_limbo *l)
+{
+  devmap_free (l->map);
+  for (unsigned i = 0; i < l->nretired; i++)
+  {
+    edgex_devreg_unpin (l->retired[i]);
+  }
+  free (l->retired);
+  free (l);
+}
+
+static void devreg_thread_exit (void *p)
+{
+  devreg_reader *rd = (devreg_reader *) p;
+  __atomic_store_n (&rd->epoch, 0, __ATOMIC_RELEASE);
+  rd->depth = 0;
+  __atomic_store_n (&rd->inuse, false, __ATOMIC_RELEASE);
+}
+
+edgex_devreg *edgex_devreg_create (void)
+{
+  edgex_devreg *r = malloc (sizeof (edgex_devreg));
+  r->current = devmap_new ();
+  r->current->generation = 1;
+  r->epoch = 1;
+  r->readers = NULL;
+  r->limbo = NULL;
+  pthread_mutex_init (&r->writelock, NULL);
+  pthread_mutex_init (&r->readerslock, NULL);
+  pthread_key_create (&r->key, devreg_thread_exit);
+  return r;
+}
+
+void edgex_devreg_free (edgex_devreg *r)
+{
+  edgex_device *dev;
+  edgex_map_iter i = edgex_map_iter (r->current->devices);
+  while ((dev = edgex_devmap_next (r->current, &i)))
+  {
+    edgex_devreg_unpin (dev);
+  }
+  devmap_free (r->current);
+  while (r->limbo)
+  {
+    devreg_limbo *l = r->limbo;
+    r->limbo = l->next;
+    devreg_limbo_free (l);
+  }
+
+  pthread_key_delete (r->key);
+  while (r->readers)
+  {
+    devreg_reader *rd = r->readers;
+    r->readers = rd->next;
+    free (rd);
+  }
+  pthread_mutex_destroy (&r->writelock);
+  pthread_mutex_destroy (&r->readerslock);
+  free (r);
+}
+
+static devreg_reader *devreg_reader_get (edgex_devreg *r)
+{
+  devreg_reader *rd = pthread_getspecific (r->key);
+  if (rd == NULL)
+  {
+    pthread_mutex_lock (&r->readerslock);
+    for (rd = r->readers; rd; rd = rd->next)
+    {
+      if (!__atomic_load_n (&rd->inuse, __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+    }
+    if (rd == NULL)
+    {
+      rd = calloc (1, sizeof (devreg_reader));
+      rd->next = r->readers;
+      __atomic_store_n (&r->readers, rd, __ATOMIC_RELEASE);
+    }
+    rd->inuse = true;
+    pthread_mutex_unlock (&r->readerslock);
+    pthread_setspecific (r->key, rd);
+  }
+  return rd;
+}
+
+const edgex_devmap *edgex_devreg_acquire (edgex_devreg *r)
+{
+  devreg_reader *rd = devreg_reader_get (r);
+  if (rd->depth++ == 0)
+  {
+    uint64_t e = __atomic_load_n (&r->epoch, __ATOMIC_RELAXED);
+    __atomic_store_n (&rd->epoch, e, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  }
+  return __atomic_load_n (&r->current, __ATOMIC_ACQUIRE);
+}
+
+void edgex_devreg_release (edgex_devreg *r)
+{
+  devreg_reader *rd = pthread_getspecific (r->key);
+  if (--rd->depth == 0)
+  {
+    __atomic_store_n (&rd->epoch, 0, __ATOMIC_RELEASE);
+  }
+}
+
+edgex_device *edgex_devmap_find (const edgex_devmap *m, const char *id)
+{
+  edgex_device **dev =
+    edgex_map_get_ ((edgex_map_base *) &m->devices.base, id);
+  return dev ? *dev : NULL;
+}
+
+edgex_device *edgex_devmap_findbyname (const edgex_devmap *m, const char *name)
+{
+  edgex_device **dev =
+    edgex_map_get_ ((edgex_map_base *) &m->names.base, name);
+  return dev ? *dev : NULL;
+}
+
+edgex_device *edgex_devmap_next (const edgex_devmap *m, edgex_map_iter *iter)
+{
+  edgex_map_base *base = (edgex_map_base *) &m->devices.base;
+  const char *key = edgex_map_next_ (base, iter);
+  return key ? *(edgex_device **) edgex_map_get_ (base, key) : NULL;
+}
+
+static void devmap_insert (edgex_devmap *m, edgex_device *dev)
+{
+  edgex_map_set (&m->devices, dev->id, dev);
+  edgex_map_set (&m->names, dev->name, dev);
+}
+
+edgex_devmap *edgex_devreg_begin (edgex_devreg *r)
+{
+  edgex_device *dev;
+  pthread_mutex_lock (&r->writelock);
+  edgex_devmap *m = devmap_new ();
+  edgex_map_iter i = edgex_map_iter (r->current->devices);
+  while ((dev = edgex_devmap_next (r->current, &i)))
+  {
+    devmap_insert (m, dev);
+  }
+  return m;
+}
+
+void edgex_devmap_add (edgex_devmap *m, edgex_device *dev)
+{
+  dev->refs = 1;
+
+  /* A device replacing one removed in this update keeps its statistics */
+
+  for (unsigned i = 0; i < m->nretired && dev->stats == NULL; i++)
+  {
+    const char *id = m->retired[i]->id;
+    if ((id == dev->id || strcmp (id, dev->id) == 0) && m->retired[i]->stats)
+    {
+      dev->stats = edgex_stats_device_ref (m->retired[i]->stats);
+    }
+  }
+  if (dev->stats == NULL)
+  {
+    dev->stats = edgex_stats_device_new ();
+  }
+  devmap_insert (m, dev);
+}
+
+void edgex_devmap_remove (edgex_devmap *m, edgex_device *dev)
+{
+  edgex_map_remove (&m->devices, dev->id);
+  edgex_map_remove (&m->names, dev->name);
+  m->retired = realloc
+    (m->retired, (m->nretired + 1) * sizeof (edgex_device *));
+  m->retired[m->nretired++] = dev;
+}
+
+/* Free superseded maps and devices which no reader can still hold */
+
+static void devreg_reclaim (edgex_devreg *r)
+{
+  uint64_t oldest = __atomic_load_n (&r->epoch, __ATOMIC_SEQ_CST);
+  for
+  (
+    devreg_reader *rd = __atomic_load_n (&r->readers, __ATOMIC_ACQUIRE);
+    rd;
+    rd = rd->next
+  )
+  {
+    uint64_t re = __atomic_load_n (&rd->epoch, __ATOMIC_ACQUIRE);
+    if (re && re < oldest)
+    {
+      oldest = re;
+    }
+  }
+
+  devreg_limbo **lp = &r->limbo;
+  while (*lp)
+  {
+    devreg_limbo *l = *lp;
+    if (l->epoch <= oldest)
+    {
+      *lp = l->next;
+      devreg_limbo_free (l);
+    }
+    else
+    {
+      lp = &l->next;
+    }
+  }
+}
+
+void edgex_devreg_commit (edgex_devreg *r, edgex_devmap *m)
+{
+  devreg_limbo *l = malloc (sizeof (devreg_limbo));
+  l->map = r->current;
+  l->retired = m->retired;
+  l->nretired = m->nretired;
+  m->retired = NULL;
+  m->nretired = 0;
+  m->generation = r->epoch + 1;
+
+  __atomic_store_n (&r->current, m, __ATOMIC_RELEASE);
+  l->epoch = __atomic_add_fetch (&r->epoch, 1, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  l->next = r->limbo;
+  r->limbo = l;
+
+  devreg_reclaim (r);
+  pthread_mutex_unlock (&r->writelock);
+}
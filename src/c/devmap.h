@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_DEVMAP_H_
+#define _EDGEX_DEVICE_DEVMAP_H_ 1
+
+#include "edgex/edgex.h"
+#include "map.h"
+
+typedef edgex_map(edgex_device *) edgex_map_device;
+
+/*
+ * The set of devices known to the service, indexed by id and by name. Once
+ * published a devmap is never modified: writers copy the current map, change
+ * the copy and publish it in place of the original. Readers bracket their use
+ * of a map, and of the devices in it, with edgex_devreg_acquire and
+ * edgex_devreg_release. Superseded maps, and devices which have been removed,
+ * are freed once no reader can still be using them.
+ *
+ * A device may also be pinned so that it outlives the read-side section in
+ * which it was found. Each device carries a reference count, of which the
+ * registry holds one for as long as the device may be visible to readers.
+ */
+
+typedef struct edgex_devmap
+{
+  /* Distinct for each published map, so that lookups can be cached */
+  uint64_t generation;
+  edgex_map_device devices;
+  edgex_map_device names;
+  edgex_device **retired;
+  unsigned nretired;
+} edgex_devmap;
+
+typedef struct edgex_devreg edgex_devreg;
+
+extern edgex_devreg *edgex_devreg_create (void);
+
+/* Free the registry and all devices in it */
+
+extern void edgex_devreg_free (edgex_devreg *r);
+
+/*
+ * Obtain the current map. The map and its devices remain valid until the
+ * matching call to edgex_devreg_release. Calls may be nested.
+ */
+
+extern const edgex_devmap *edgex_devreg_acquire (edgex_devreg *r);
+
+extern void edgex_devreg_release (edgex_devreg *r);
+
+extern edgex_device *edgex_devmap_find (const edgex_devmap *m, const char *id);
+
+extern edgex_device *edgex_devmap_findbyname
+  (const edgex_devmap *m, const char *name);
+
+/*
+ * Take a reference to a device found in an acquired map. The device remains
+ * valid, and unchanged, until the reference is dropped with edgex_devreg_unpin
+ * even if it is meanwhile updated or removed.
+ */
+
+extern void edgex_devreg_pin (edgex_device *dev);
+
+extern void edgex_devreg_unpin (edgex_device *dev);
+
+/* Iterate over the devices in a map. Returns NULL at the end */
+
+extern edgex_device *edgex_devmap_next
+  (const edgex_devmap *m, edgex_map_iter *iter);
+
+/*
+ * Start an update. Updates are serialized; the returned map is a private
+ * copy of the current one which may be modified and then published with
+ * edgex_devreg_commit.
+ */
+
+extern edgex_devmap *edgex_devreg_begin (edgex_devreg *r);
+
+/* Add a new device. The registry takes ownership of it */
+
+extern void edgex_devmap_add (edgex_devmap *m, edgex_device *dev);
+
+/* Remove a device. It will be freed after the update is committed */
+
+extern void edgex_devmap_remove (edgex_devmap *m, edgex_device *dev);
+
+/*
+ * Publish an updated map. The previous map, and any removed devices, are
+ * freed once readers have finished with them.
+ */
+
+extern void edgex_devreg_commit (edgex_devreg *r, edgex_devmap *m);
+
+#endif
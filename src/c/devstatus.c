@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "devstatus.h"
+#include "service.h"
+#include "metadata.h"
+#include "errorlist.h"
+#include "map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define DS_OPSTATE 1
+#define DS_ADMINSTATE 2
+#define DS_CONNECTED 4
+
+typedef struct ds_pending
+{
+  unsigned kinds;
+  edgex_device_operatingstate opstate;
+  edgex_device_adminstate adminstate;
+  uint64_t connected;
+} ds_pending;
+
+typedef edgex_map(ds_pending) edgex_map_pending;
+
+struct edgex_devstatus
+{
+  edgex_device_service *svc;
+  pthread_mutex_t lock;
+  edgex_map_pending pending;
+  uint64_t sent;
+  uint64_t coalesced;
+  uint64_t failed;
+};
+
+edgex_devstatus *edgex_devstatus_create (edgex_device_service *svc)
+{
+  edgex_devstatus *q = calloc (1, sizeof (edgex_devstatus));
+  q->svc = svc;
+  pthread_mutex_init (&q->lock, NULL);
+  edgex_map_init (&q->pending);
+  return q;
+}
+
+/* Find or add the pending entry for a device. Called with the lock held */
+
+static ds_pending *ds_entry (edgex_devstatus *q, const char *id, unsigned kind)
+{
+  ds_pending *p = edgex_map_get (&q->pending, id);
+  if (p == NULL)
+  {
+    ds_pending empty = { 0 };
+    edgex_map_set (&q->pending, id, empty);
+    p = edgex_map_get (&q->pending, id);
+  }
+  if (p->kinds & kind)
+  {
+    q->coalesced++;
+  }
+  p->kinds |= kind;
+  return p;
+}
+
+void edgex_devstatus_opstate
+  (edgex_devstatus *q, const char *id, edgex_device_operatingstate state)
+{
+  pthread_mutex_lock (&q->lock);
+  ds_entry (q, id, DS_OPSTATE)->opstate = state;
+  pthread_mutex_unlock (&q->lock);
+}
+
+void edgex_devstatus_adminstate
+  (edgex_devstatus *q, const char *id, edgex_device_adminstate state)
+{
+  pthread_mutex_lock (&q->lock);
+  ds_entry (q, id, DS_ADMINSTATE)->adminstate = state;
+  pthread_mutex_unlock (&q->lock);
+}
+
+void edgex_devstatus_connected
+  (edgex_devstatus *q, const char *id, uint64_t time)
+{
+  pthread_mutex_lock (&q->lock);
+  ds_entry (q, id, DS_CONNECTED)->connected = time;
+  pthread_mutex_unlock (&q->lock);
+}
+
+/* Send the updates for one device, returning the number which failed */
+
+static unsigned ds_send
+  (edgex_device_service *svc, const char *id, const ds_pending *p)
+{
+  unsigned failed = 0;
+  edgex_error err;
+
+  if (p->kinds & DS_OPSTATE)
+  {
+    err = EDGEX_OK;
+    edgex_metadata_client_set_device_opstate
+      (svc->logger, &svc->config.endpoints, id, p->opstate, &err);
+    failed += (err.code != 0);
+  }
+  if (p->kinds & DS_ADMINSTATE)
+  {
+    err = EDGEX_OK;
+    edgex_metadata_client_set_device_adminstate
+      (svc->logger, &svc->config.endpoints, id, p->adminstate, &err);
+    failed += (err.code != 0);
+  }
+  if (p->kinds & DS_CONNECTED)
+  {
+    err = EDGEX_OK;
+    edgex_metadata_client_set_device_lastconnected
+      (svc->logger, &svc->config.endpoints, id, p->connected, &err);
+    failed += (err.code != 0);
+  }
+  return failed;
+}
+
+void edgex_devstatus_flush (void *arg)
+{
+  edgex_devstatus *q = (edgex_devstatus *) arg;
+  edgex_map_pending batch;
+  const char *id;
+  uint64_t sent = 0;
+  uint64_t failed = 0;
+
+  /* Updates queued while the batch is sent go into a new map */
+
+  pthread_mutex_lock (&q->lock);
+  if (edgex_map_count (&q->pending) == 0)
+  {
+    pthread_mutex_unlock (&q->lock);
+    return;
+  }
+  batch = q->pending;
+  edgex_map_init (&q->pending);
+  pthread_mutex_unlock (&q->lock);
+
+  edgex_map_iter i = edgex_map_iter (&batch);
+  while ((id = edgex_map_next (&batch, &i)))
+  {
+    const ds_pending *p = edgex_map_get (&batch, id);
+    unsigned n = ds_send (q->svc, id, p);
+    if (n)
+    {
+      iot_log_error
+        (q->svc->logger, "Unable to update status of device %s", id);
+    }
+    sent += __builtin_popcount (p->kinds);
+    failed += n;
+  }
+  edgex_map_deinit (&batch);
+
+  pthread_mutex_lock (&q->lock);
+  q->sent += sent;
+  q->failed += failed;
+  pthread_mutex_unlock (&q->lock);
+}
+
+void edgex_devstatus_getstats
+  (edgex_devstatus *q, edgex_devstatus_stats *stats)
+{
+  pthread_mutex_lock (&q->lock);
+  stats->pending = edgex_map_count (&q->pending);
+  stats->sent = q->sent;
+  stats->coalesced = q->coalesced;
+  stats->failed = q->failed;
+  pthread_mutex_unlock (&q->lock);
+}
+
+void edgex_devstatus_free (edgex_devstatus *q)
+{
+  if (q)
+  {
+    edgex_devstatus_flush (q);
+    edgex_map_deinit (&q->pending);
+    pthread_mutex_destroy (&q->lock);
+    free (q);
+  }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_DEVSTATUS_H_
+#define _EDGEX_DEVICE_DEVSTATUS_H_ 1
+
+#include "edgex/devsdk.h"
+
+#include <stdint.h>
+
+/*
+ * Updates of devices' states in metadata, queued so that they are not made
+ * on the request path. Updates are kept per device, a later value of the
+ * same kind replacing an earlier one, and sent in batches when the queue is
+ * flushed, normally by a periodic timer.
+ */
+
+typedef struct edgex_devstatus edgex_devstatus;
+
+/* Default interval between flushes, in milliseconds */
+
+#define EDGEX_DEVSTATUS_INTERVAL 1000
+
+extern edgex_devstatus *edgex_devstatus_create (edgex_device_service *svc);
+
+extern void edgex_devstatus_opstate
+  (edgex_devstatus *q, const char *id, edgex_device_operatingstate state);
+
+extern void edgex_devstatus_adminstate
+  (edgex_devstatus *q, const char *id, edgex_device_adminstate state);
+
+/* Record the time, in milliseconds, at which a device was last reached */
+
+extern void edgex_devstatus_connected
+  (edgex_devstatus *q, const char *id, uint64_t time);
+
+/* Send the queued updates. May be run as a task, with q as the argument */
+
+extern void edgex_devstatus_flush (void *q);
+
+typedef struct edgex_devstatus_stats
+{
+  uint64_t pending;    // Devices with updates queued
+  uint64_t sent;       // Updates sent to metadata
+  uint64_t coalesced;  // Updates replaced by a later one before sending
+  uint64_t failed;     // Updates which metadata did not accept
+} edgex_devstatus_stats;
+
+extern void edgex_devstatus_getstats
+  (edgex_devstatus *q, edgex_devstatus_stats *stats);
+
+/* Send any queued updates, then free the queue */
+
+extern void edgex_devstatus_free (edgex_devstatus *q);
+
+#endif
@@ -11,21 +11,321 @@
 #include "profiles.h"
 #include "metadata.h"
 #include "edgex_rest.h"
+#include "errorlist.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <regex.h>
 
 #include <microhttpd.h>
 
+/*
+ * Devices reported by the driver are matched against the provision watchers
+ * as they arrive, and those matched are collected into batches. A full batch
+ * is registered by a task on the executor while discovery continues; at the
+ * end of a run the discovery thread registers any batches not yet taken, so
+ * it never waits on tasks which cannot start.
+ */
+
+#define DISCOVERY_BATCH 64
+
+typedef struct disco_watcher
+{
+  const char *name;
+  const char *profile;
+  const char *key;
+  char **ids;
+  bool hasregex;
+  regex_t regex;
+} disco_watcher;
+
+typedef struct disco_batch
+{
+  edgex_device_add_request reqs[DISCOVERY_BATCH];
+  unsigned count;
+  struct disco_batch *next;
+} disco_batch;
+
+struct edgex_discovery
+{
+  edgex_device_service *svc;
+  disco_watcher *watchers;
+  unsigned nwatchers;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool running;
+  edgex_map_int found;
+  disco_batch *filling;
+  disco_batch *full;
+  disco_batch **tail;
+  unsigned busy;
+  unsigned matched;
+  unsigned added;
+};
+
+edgex_discovery *edgex_discovery_create (edgex_device_service *svc)
+{
+  const char *key;
+  edgex_map_iter iter;
+  unsigned n = 0;
+  edgex_discovery *d = calloc (1, sizeof (edgex_discovery));
+
+  d->svc = svc;
+  pthread_mutex_init (&d->lock, NULL);
+  pthread_cond_init (&d->cond, NULL);
+  edgex_map_init (&d->found);
+  d->tail = &d->full;
+
+  iter = edgex_map_iter (svc->config.watchers);
+  while (edgex_map_next (&svc->config.watchers, &iter))
+  {
+    n++;
+  }
+  d->watchers = calloc (n ? n : 1, sizeof (disco_watcher));
+
+  /* Patterns must match the whole of the identifier's value */
+
+  iter = edgex_map_iter (svc->config.watchers);
+  while ((key = edgex_map_next (&svc->config.watchers, &iter)))
+  {
+    edgex_device_watcherinfo *info = edgex_map_get (&svc->config.watchers, key);
+    disco_watcher *w = &d->watchers[d->nwatchers];
+    w->name = key;
+    w->profile = info->profile;
+    w->key = info->key;
+    w->ids = info->ids;
+    if (info->matchstring && *info->matchstring)
+    {
+      char *pattern = malloc (strlen (info->matchstring) + 5);
+      sprintf (pattern, "^(%s)$", info->matchstring);
+      int rc = regcomp (&w->regex, pattern, REG_EXTENDED | REG_NOSUB);
+      free (pattern);
+      if (rc != 0)
+      {
+        char msg[128];
+        regerror (rc, &w->regex, msg, sizeof (msg));
+        iot_log_error
+        (
+          svc->logger, "Watcher %s: invalid MatchString \"%s\": %s",
+          key, info->matchstring, msg
+        );
+        continue;
+      }
+      w->hasregex = true;
+    }
+    d->nwatchers++;
+  }
+  return d;
+}
+
+static void batch_free (disco_batch *b)
+{
+  for (unsigned i = 0; i < b->count; i++)
+  {
+    free ((char *) b->reqs[i].name);
+    free ((char *) b->reqs[i].description);
+    edgex_strings_free ((edgex_strings *) b->reqs[i].labels);
+    edgex_addressable_free (b->reqs[i].address);
+    free (b->reqs[i].id);
+  }
+  free (b);
+}
+
+void edgex_discovery_free (edgex_discovery *d)
+{
+  if (d)
+  {
+    while (d->full)
+    {
+      disco_batch *next = d->full->next;
+      batch_free (d->full);
+      d->full = next;
+    }
+    if (d->filling)
+    {
+      batch_free (d->filling);
+    }
+    for (unsigned i = 0; i < d->nwatchers; i++)
+    {
+      if (d->watchers[i].hasregex)
+      {
+        regfree (&d->watchers[i].regex);
+      }
+    }
+    free (d->watchers);
+    edgex_map_deinit (&d->found);
+    pthread_cond_destroy (&d->cond);
+    pthread_mutex_destroy (&d->lock);
+    free (d);
+  }
+}
+
+static const char *find_identifier (const edgex_nvpairs *ids, const char *name)
+{
+  for (; ids; ids = ids->next)
+  {
+    if (strcmp (ids->name, name) == 0)
+    {
+      return ids->value;
+    }
+  }
+  return NULL;
+}
+
+static const disco_watcher *find_watcher
+  (const edgex_discovery *d, const edgex_nvpairs *identifiers)
+{
+  for (unsigned i = 0; i < d->nwatchers; i++)
+  {
+    const disco_watcher *w = &d->watchers[i];
+    const char *value = find_identifier (identifiers, w->key);
+    if (value == NULL)
+    {
+      continue;
+    }
+    if (w->hasregex && regexec (&w->regex, value, 0, NULL, 0) != 0)
+    {
+      continue;
+    }
+    bool all = true;
+    for (int j = 0; w->ids && w->ids[j]; j++)
+    {
+      if (find_identifier (identifiers, w->ids[j]) == NULL)
+      {
+        all = false;
+        break;
+      }
+    }
+    if (all)
+    {
+      return w;
+    }
+  }
+  return NULL;
+}
+
+/* Register batches until none are waiting. Called with the lock held */
+
+static void discovery_claim (edgex_discovery *d)
+{
+  edgex_error err;
+  disco_batch *b;
+
+  while ((b = d->full))
+  {
+    d->full = b->next;
+    if (d->full == NULL)
+    {
+      d->tail = &d->full;
+    }
+    d->busy++;
+    pthread_mutex_unlock (&d->lock);
+
+    edgex_device_add_devices (d->svc, b->count, b->reqs, &err);
+    unsigned added = 0;
+    for (unsigned i = 0; i < b->count; i++)
+    {
+      if (b->reqs[i].id)
+      {
+        added++;
+      }
+    }
+    batch_free (b);
+
+    pthread_mutex_lock (&d->lock);
+    d->added += added;
+    if (--d->busy == 0)
+    {
+      pthread_cond_broadcast (&d->cond);
+    }
+  }
+}
+
+static void discovery_task (void *arg)
+{
+  edgex_discovery *d = (edgex_discovery *) arg;
+  pthread_mutex_lock (&d->lock);
+  discovery_claim (d);
+  pthread_mutex_unlock (&d->lock);
+}
+
+/* Queue the batch being filled. Called with the lock held */
+
+static void discovery_queue (edgex_discovery *d)
+{
+  if (d->filling)
+  {
+    *d->tail = d->filling;
+    d->tail = &d->filling->next;
+    d->filling = NULL;
+    edgex_executor_submit
+      (d->svc->executor, EDGEX_EXEC_DISCOVERY, discovery_task, d);
+  }
+}
+
+void edgex_device_discovered
+(
+  edgex_device_service *svc,
+  const char *name,
+  const char *description,
+  const edgex_strings *labels,
+  edgex_addressable *address,
+  const edgex_nvpairs *identifiers
+)
+{
+  edgex_discovery *d = svc->discovery;
+  const disco_watcher *w = find_watcher (d, identifiers);
+  if (w == NULL)
+  {
+    iot_log_debug
+      (svc->logger, "Discovered device %s matches no watcher", name);
+    return;
+  }
+
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  bool exists = (edgex_devmap_findbyname (devices, name) != NULL);
+  edgex_devreg_release (svc->devices);
+  if (exists)
+  {
+    return;
+  }
+
+  pthread_mutex_lock (&d->lock);
+  if (edgex_map_get (&d->found, name) == NULL)
+  {
+    iot_log_info
+      (svc->logger, "Discovered device %s matches watcher %s", name, w->name);
+    edgex_map_set (&d->found, name, 1);
+    d->matched++;
+    if (d->filling == NULL)
+    {
+      d->filling = calloc (1, sizeof (disco_batch));
+    }
+    edgex_device_add_request *req = &d->filling->reqs[d->filling->count++];
+    req->name = strdup (name);
+    req->description = strdup (description ? description : "");
+    req->labels = edgex_strings_dup (labels);
+    req->profile_name = w->profile;
+    req->address = edgex_addressable_dup (address);
+
+    /* Outside a discovery run there is no end to wait for */
+
+    if (d->filling->count == DISCOVERY_BATCH || !d->running)
+    {
+      discovery_queue (d);
+    }
+  }
+  pthread_mutex_unlock (&d->lock);
+}
+
 int edgex_device_handler_discovery
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
   edgex_device_service *svc = (edgex_device_service *) ctx;
@@ -37,26 +337,55 @@ int edgex_device_handler_discovery
 
   if (!svc->config.device.discovery)
   {
-    *reply = strdup ("Discovery disabled by configuration\n");
+    edgex_strbuf_appendstr
+      (&reply->body, "Discovery disabled by configuration\n");
     return MHD_HTTP_SERVICE_UNAVAILABLE;
   }
 
   if (pthread_mutex_trylock (&svc->discolock) == 0)
   {
-    thpool_add_work (svc->thpool, edgex_device_handler_do_discovery, svc);
+    edgex_executor_submit
+      (svc->executor, EDGEX_EXEC_DISCOVERY, edgex_device_handler_do_discovery, svc);
     pthread_mutex_unlock (&svc->discolock);
   }
   // else discovery was already running; ignore this request
 
-  *reply = strdup ("Running discovery\n");
+  edgex_strbuf_appendstr (&reply->body, "Running discovery\n");
   return MHD_HTTP_OK;
 }
 
 void edgex_device_handler_do_discovery (void *p)
 {
   edgex_device_service *svc = (edgex_device_service *) p;
+  edgex_discovery *d = svc->discovery;
 
   pthread_mutex_lock (&svc->discolock);
+  pthread_mutex_lock (&d->lock);
+  d->running = true;
+  d->matched = 0;
+  d->added = 0;
+  pthread_mutex_unlock (&d->lock);
+
   svc->userfns.discover (svc->userdata);
+
+  pthread_mutex_lock (&d->lock);
+  d->running = false;
+  discovery_queue (d);
+  discovery_claim (d);
+  while (d->busy)
+  {
+    pthread_cond_wait (&d->cond, &d->lock);
+  }
+  edgex_map_deinit (&d->found);
+  edgex_map_init (&d->found);
+  if (d->matched)
+  {
+    iot_log_info
+    (
+      svc->logger, "Discovery: %u devices matched watchers, %u added",
+      d->matched, d->added
+    );
+  }
+  pthread_mutex_unlock (&d->lock);
   pthread_mutex_unlock (&svc->discolock);
 }
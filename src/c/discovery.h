@@ -9,19 +9,27 @@
 #ifndef _EDGEX_DEVICE_DISCOVERY_H_
 #define _EDGEX_DEVICE_DISCOVERY_H_ 1
 
+#include "edgex/devsdk.h"
 #include "rest_server.h"
 
 #include <stddef.h>
 
+typedef struct edgex_discovery edgex_discovery;
+
+/* Compile the service's provision watchers, ready for discovery */
+
+extern edgex_discovery *edgex_discovery_create (edgex_device_service *svc);
+
+extern void edgex_discovery_free (edgex_discovery *d);
+
 extern int edgex_device_handler_discovery
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 );
 
 void edgex_device_handler_do_discovery (void *);
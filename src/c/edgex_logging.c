@@ -17,9 +17,75 @@
 #include "errorlist.h"
 #include "parson.h"
 #include "rest.h"
+#include "logqueue.h"
 
 static const char *levelstrs[] = {"INFO", "TRACE", "DEBUG", "WARNING", "ERROR"};
 
+/* Queues for logging services, by URL */
+
+typedef struct edgex_log_dest
+{
+  char *url;
+  edgex_logqueue *queue;
+  struct edgex_log_dest *next;
+} edgex_log_dest;
+
+static edgex_log_dest *dests = NULL;
+static pthread_rwlock_t destslock = PTHREAD_RWLOCK_INITIALIZER;
+
+static bool edgex_log_send (void *ctx, const char *json)
+{
+  edgex_ctx ectx;
+  edgex_error err = EDGEX_OK;
+
+  memset (&ectx, 0, sizeof (ectx));
+  long retcode = edgex_http_post
+    (iot_log_default, &ectx, (const char *) ctx, json, NULL, &err);
+  return (retcode == 202 && err.code == EDGEX_OK.code);
+}
+
+edgex_logqueue *edgex_log_rest_start
+  (const char *url, uint32_t size, uint32_t maxbatch, uint32_t ratelimit)
+{
+  edgex_log_dest *d = malloc (sizeof (edgex_log_dest));
+  d->url = strdup (url);
+  d->queue = edgex_logqueue_create
+    (edgex_log_send, d->url, size, maxbatch, ratelimit);
+  if (d->queue == NULL)
+  {
+    free (d->url);
+    free (d);
+    return NULL;
+  }
+  pthread_rwlock_wrlock (&destslock);
+  d->next = dests;
+  dests = d;
+  pthread_rwlock_unlock (&destslock);
+  return d->queue;
+}
+
+void edgex_log_rest_stop (edgex_logqueue *q)
+{
+  edgex_log_dest *d = NULL;
+  pthread_rwlock_wrlock (&destslock);
+  for (edgex_log_dest **p = &dests; *p; p = &(*p)->next)
+  {
+    if ((*p)->queue == q)
+    {
+      d = *p;
+      *p = d->next;
+      break;
+    }
+  }
+  pthread_rwlock_unlock (&destslock);
+  if (d)
+  {
+    edgex_logqueue_free (d->queue);
+    free (d->url);
+    free (d);
+  }
+}
+
 bool edgex_log_torest
 (
   const char *destination,
@@ -29,6 +95,20 @@ bool edgex_log_torest
   const char *message
 )
 {
+  pthread_rwlock_rdlock (&destslock);
+  for (edgex_log_dest *d = dests; d; d = d->next)
+  {
+    if (strcmp (d->url, destination) == 0)
+    {
+      bool queued = edgex_logqueue_add (d->queue, subsystem, l, timestamp, message);
+      pthread_rwlock_unlock (&destslock);
+      return queued;
+    }
+  }
+  pthread_rwlock_unlock (&destslock);
+
+  /* No queue has been started for this destination: post synchronously */
+
   long retcode;
   edgex_ctx ctx;
   char *json;
@@ -7,6 +7,12 @@
  */
 
 #include "edgex_rest.h"
+#include "cmdplan.h"
+#include "transform.h"
+#include "atoms.h"
+#include "jsonpull.h"
+#include "map.h"
+#include "memstats.h"
 #include "parson.h"
 #include <string.h>
 #include <stdlib.h>
@@ -18,16 +24,33 @@
 
 static const char *rwstrings[2][2] = { { "", "W" }, { "R", "RW" } };
 
+/* Serialize to a string which the caller frees with free () */
+
+static char *serialize (const JSON_Value *val)
+{
+  char *result = json_serialize_to_string (val);
+  edgex_mem_disown (EDGEX_MEM_JSON, result);
+  return result;
+}
+
 static char *get_string (const JSON_Object *obj, const char *name)
 {
   const char *str = json_object_get_string (obj, name);
   return strdup (str ? str : "");
 }
 
-static char *get_array_string (const JSON_Array *array, size_t index)
+/* Names, ids and resource keys are interned, see atoms.h */
+
+static char *get_atom (const JSON_Object *obj, const char *name)
+{
+  const char *str = json_object_get_string (obj, name);
+  return edgex_atom (str ? str : "");
+}
+
+static char *get_array_atom (const JSON_Array *array, size_t index)
 {
   const char *str = json_array_get_string (array, index);
-  return strdup (str ? str : "");
+  return edgex_atom (str ? str : "");
 }
 
 static edgex_strings *array_to_strings (const JSON_Array *array)
@@ -41,7 +64,7 @@ static edgex_strings *array_to_strings (const JSON_Array *array)
   for (i = 0; i < count; i++)
   {
     temp = (edgex_strings *) malloc (sizeof (edgex_strings));
-    temp->str = get_array_string (array, i);
+    temp->str = get_array_atom (array, i);
     temp->next = NULL;
     *last_ptr = temp;
     last_ptr = &(temp->next);
@@ -71,7 +94,7 @@ edgex_strings *edgex_strings_dup (const edgex_strings *strs)
   while (strs)
   {
     copy = malloc (sizeof (edgex_strings));
-    copy->str = strdup (strs->str);
+    copy->str = edgex_atom (strs->str);
     copy->next = NULL;
     *last = copy;
     last = &(copy->next);
@@ -86,7 +109,7 @@ void edgex_strings_free (edgex_strings *strs)
   while (strs)
   {
     edgex_strings *current = strs;
-    free (strs->str);
+    edgex_atom_free (strs->str);
     strs = strs->next;
     free (current);
   }
@@ -100,8 +123,8 @@ edgex_nvpairs *edgex_nvpairs_dup (edgex_nvpairs *p)
   while (p)
   {
     copy = malloc (sizeof (edgex_nvpairs));
-    copy->name = strdup (p->name);
-    copy->value = strdup (p->value);
+    copy->name = edgex_atom (p->name);
+    copy->value = edgex_atom (p->value);
     copy->next = NULL;
     *last = copy;
     last = &(copy->next);
@@ -115,8 +138,8 @@ void edgex_nvpairs_free (edgex_nvpairs *p)
   while (p)
   {
     edgex_nvpairs *current = p;
-    free (p->name);
-    free (p->value);
+    edgex_atom_free (p->name);
+    edgex_atom_free (p->value);
     p = p->next;
     free (current);
   }
@@ -253,6 +276,58 @@ if (strcmp (name, "base") == 0 && strcmp (str, "0") == 0) return true;
   return ok;
 }
 
+/*
+ * Parse an assertion as a value of the resource's type, so that readings
+ * can be checked without formatting them. Assertions which do not parse are
+ * left disabled, and are compared as text.
+ */
+
+static void get_assertion
+  (const char *str, edgex_propertytype type, edgex_transformArg *res)
+{
+  char *end = NULL;
+
+  res->enabled = false;
+  if (str == NULL || *str == '\0')
+  {
+    return;
+  }
+  errno = 0;
+  switch (type)
+  {
+    case Bool:
+      if (strcmp (str, "true") == 0 || strcmp (str, "false") == 0)
+      {
+        res->enabled = true;
+        res->value.ival = (*str == 't');
+      }
+      return;
+    case Int8:
+    case Int16:
+    case Int32:
+    case Int64:
+      res->value.ival = strtoll (str, &end, 10);
+      break;
+    case Uint8:
+    case Uint16:
+    case Uint32:
+    case Uint64:
+      if (*str == '-')
+      {
+        return;
+      }
+      res->value.ival = (int64_t) strtoull (str, &end, 10);
+      break;
+    case Float32:
+    case Float64:
+      res->value.dval = strtod (str, &end);
+      break;
+    default:
+      return;
+  }
+  res->enabled = (errno == 0 && end != str && *end == '\0');
+}
+
 static edgex_propertyvalue *propertyvalue_read
   (iot_logging_client *lc, const JSON_Object *obj)
 {
@@ -300,6 +375,8 @@ static edgex_propertyvalue *propertyvalue_read
     result->lsb = get_string (obj, "lsb");
     result->assertion = get_string (obj, "assertion");
     result->precision = get_string (obj, "precision");
+    get_assertion (result->assertion, pt, &result->assertval);
+    edgex_transform_select (result);
   }
   else
   {
@@ -372,6 +449,8 @@ static edgex_propertyvalue *propertyvalue_dup (edgex_propertyvalue *pv)
     result->base = pv->base;
     result->assertion = strdup (pv->assertion);
     result->precision = strdup (pv->precision);
+    result->assertval = pv->assertval;
+    result->xform = pv->xform;
   }
   return result;
 }
@@ -390,8 +469,8 @@ static void propertyvalue_free (edgex_propertyvalue *e)
 static edgex_units *units_read (const JSON_Object *obj)
 {
   edgex_units *result = malloc (sizeof (edgex_units));
-  result->type = get_string (obj, "type");
-  result->readwrite = get_string (obj, "readWrite");
+  result->type = get_atom (obj, "type");
+  result->readwrite = get_atom (obj, "readWrite");
   result->defaultvalue = get_string (obj, "defaultValue");
   return result;
 }
@@ -412,8 +491,8 @@ static edgex_units *units_dup (const edgex_units *u)
   if (u)
   {
     result = malloc (sizeof (edgex_units));
-    result->type = strdup (u->type);
-    result->readwrite = strdup (u->readwrite);
+    result->type = edgex_atom (u->type);
+    result->readwrite = edgex_atom (u->readwrite);
     result->defaultvalue = strdup (u->defaultvalue);
   }
   return result;
@@ -421,8 +500,8 @@ static edgex_units *units_dup (const edgex_units *u)
 
 static void units_free (edgex_units *e)
 {
-  free (e->type);
-  free (e->readwrite);
+  edgex_atom_free (e->type);
+  edgex_atom_free (e->readwrite);
   free (e->defaultvalue);
   free (e);
 }
@@ -477,7 +556,7 @@ static edgex_deviceresource *deviceresource_read
   edgex_deviceresource *result = NULL;
   edgex_profileproperty *pp = profileproperty_read
     (lc, json_object_get_object (obj, "properties"));
-  char *name = get_string (obj, "name");
+  char *name = get_atom (obj, "name");
 
   if (pp)
   {
@@ -486,7 +565,8 @@ static edgex_deviceresource *deviceresource_read
     edgex_nvpairs *nv;
     edgex_nvpairs **nv_last;
 
-    result = malloc (sizeof (edgex_deviceresource));
+    result = edgex_mem_malloc
+      (EDGEX_MEM_PROFILES, sizeof (edgex_deviceresource));
     result->name = name;
     result->description = get_string (obj, "description");
     result->tag = get_string (obj, "tag");
@@ -498,8 +578,8 @@ static edgex_deviceresource *deviceresource_read
     for (size_t i = 0; i < count; i++)
     {
       nv = malloc (sizeof (edgex_nvpairs));
-      nv->name = strdup (json_object_get_name (attributes_obj, i));
-      nv->value = strdup
+      nv->name = edgex_atom (json_object_get_name (attributes_obj, i));
+      nv->value = edgex_atom
         (json_value_get_string (json_object_get_value_at (attributes_obj, i)));
       nv->next = NULL;
       *nv_last = nv;
@@ -531,8 +611,9 @@ static edgex_deviceresource *edgex_deviceresource_dup (edgex_deviceresource *e)
   edgex_deviceresource *result = NULL;
   if (e)
   {
-    result = malloc (sizeof (edgex_deviceresource));
-    result->name = strdup (e->name);
+    result = edgex_mem_malloc
+      (EDGEX_MEM_PROFILES, sizeof (edgex_deviceresource));
+    result->name = edgex_atom (e->name);
     result->description = strdup (e->description);
     result->tag = strdup (e->tag);
     result->properties = profileproperty_dup (e->properties);
@@ -547,13 +628,13 @@ static void deviceresource_free (edgex_deviceresource *e)
   while (e)
   {
     edgex_deviceresource *current = e;
-    free (e->name);
+    edgex_atom_free (e->name);
     free (e->description);
     free (e->tag);
     profileproperty_free (e->properties);
     edgex_nvpairs_free (e->attributes);
     e = e->next;
-    free (current);
+    edgex_mem_free (EDGEX_MEM_PROFILES, current);
   }
 }
 
@@ -724,10 +805,11 @@ static void put_free (edgex_put *e)
 
 static edgex_command *command_read (const JSON_Object *obj)
 {
-  edgex_command *result = malloc (sizeof (edgex_command));
+  edgex_command *result =
+    edgex_mem_malloc (EDGEX_MEM_PROFILES, sizeof (edgex_command));
 
-  result->id = get_string (obj, "id");
-  result->name = get_string (obj, "name");
+  result->id = get_atom (obj, "id");
+  result->name = get_atom (obj, "name");
   result->created = (uint64_t) json_object_get_number (obj, "created");
   result->modified = (uint64_t) json_object_get_number (obj, "modified");
   result->origin = (uint64_t) json_object_get_number (obj, "origin");
@@ -756,9 +838,9 @@ static edgex_command *command_dup (edgex_command *c)
   edgex_command *result = NULL;
   if (c)
   {
-    result = malloc (sizeof (edgex_command));
-    result->id = strdup (c->id);
-    result->name = strdup (c->name);
+    result = edgex_mem_malloc (EDGEX_MEM_PROFILES, sizeof (edgex_command));
+    result->id = edgex_atom (c->id);
+    result->name = edgex_atom (c->name);
     result->created = c->created;
     result->modified = c->modified;
     result->origin = c->origin;
@@ -774,12 +856,12 @@ static void command_free (edgex_command *e)
   while (e)
   {
     edgex_command *current = e;
-    free (e->id);
-    free (e->name);
+    edgex_atom_free (e->id);
+    edgex_atom_free (e->name);
     get_free (e->get);
     put_free (e->put);
     e = e->next;
-    free (current);
+    edgex_mem_free (EDGEX_MEM_PROFILES, current);
   }
 }
 
@@ -791,12 +873,12 @@ static edgex_resourceoperation *resourceoperation_read (const JSON_Object *obj)
   edgex_nvpairs **nv_last = &result->mappings;
   JSON_Object *mappings_obj;
 
-  result->index = get_string (obj, "index");
-  result->operation = get_string (obj, "operation");
-  result->object = get_string (obj, "object");
-  result->property = get_string (obj, "property");
-  result->parameter = get_string (obj, "parameter");
-  result->resource = get_string (obj, "resource");
+  result->index = get_atom (obj, "index");
+  result->operation = get_atom (obj, "operation");
+  result->object = get_atom (obj, "object");
+  result->property = get_atom (obj, "property");
+  result->parameter = get_atom (obj, "parameter");
+  result->resource = get_atom (obj, "resource");
   result->secondary = array_to_strings
     (json_object_get_array (obj, "secondary"));
   result->mappings = NULL;
@@ -805,8 +887,8 @@ static edgex_resourceoperation *resourceoperation_read (const JSON_Object *obj)
   for (size_t i = 0; i < count; i++)
   {
     nv = malloc (sizeof (edgex_nvpairs));
-    nv->name = strdup (json_object_get_name (mappings_obj, i));
-    nv->value = strdup
+    nv->name = edgex_atom (json_object_get_name (mappings_obj, i));
+    nv->value = edgex_atom
       (json_value_get_string (json_object_get_value_at (mappings_obj, i)));
     nv->next = NULL;
     *nv_last = nv;
@@ -845,12 +927,12 @@ static edgex_resourceoperation *resourceoperation_dup
   if (ro)
   {
     result = malloc (sizeof (edgex_resourceoperation));
-    result->index = strdup (ro->index);
-    result->operation = strdup (ro->operation);
-    result->object = strdup (ro->object);
-    result->property = strdup (ro->property);
-    result->parameter = strdup (ro->parameter);
-    result->resource = strdup (ro->resource);
+    result->index = edgex_atom (ro->index);
+    result->operation = edgex_atom (ro->operation);
+    result->object = edgex_atom (ro->object);
+    result->property = edgex_atom (ro->property);
+    result->parameter = edgex_atom (ro->parameter);
+    result->resource = edgex_atom (ro->resource);
     result->secondary = edgex_strings_dup (ro->secondary);
     result->mappings = edgex_nvpairs_dup (ro->mappings);
     result->next = resourceoperation_dup (ro->next);
@@ -863,12 +945,12 @@ static void resourceoperation_free (edgex_resourceoperation *e)
   while (e)
   {
     edgex_resourceoperation *current = e;
-    free (e->index);
-    free (e->operation);
-    free (e->object);
-    free (e->property);
-    free (e->parameter);
-    free (e->resource);
+    edgex_atom_free (e->index);
+    edgex_atom_free (e->operation);
+    edgex_atom_free (e->object);
+    edgex_atom_free (e->property);
+    edgex_atom_free (e->parameter);
+    edgex_atom_free (e->resource);
     edgex_strings_free (e->secondary);
     edgex_nvpairs_free (e->mappings);
     e = e->next;
@@ -878,13 +960,14 @@ static void resourceoperation_free (edgex_resourceoperation *e)
 
 static edgex_profileresource *profileresource_read (const JSON_Object *obj)
 {
-  edgex_profileresource *result = malloc (sizeof (edgex_profileresource));
+  edgex_profileresource *result =
+    edgex_mem_malloc (EDGEX_MEM_PROFILES, sizeof (edgex_profileresource));
   size_t count;
   JSON_Array *array;
   edgex_resourceoperation **last_ptr = &result->set;
   edgex_resourceoperation **last_ptr2 = &result->get;
 
-  result->name = get_string (obj, "name");
+  result->name = get_atom (obj, "name");
   array = json_object_get_array (obj, "set");
   result->set = NULL;
   count = json_array_get_count (array);
@@ -940,8 +1023,9 @@ static edgex_profileresource *profileresource_dup (edgex_profileresource *pr)
   edgex_profileresource *result = NULL;
   if (pr)
   {
-    result = malloc (sizeof (edgex_profileresource));
-    result->name = strdup (pr->name);
+    result = edgex_mem_malloc
+      (EDGEX_MEM_PROFILES, sizeof (edgex_profileresource));
+    result->name = edgex_atom (pr->name);
     result->set = resourceoperation_dup (pr->set);
     result->get = resourceoperation_dup (pr->get);
     result->next = profileresource_dup (pr->next);
@@ -954,26 +1038,27 @@ static void profileresource_free (edgex_profileresource *e)
   while (e)
   {
     edgex_profileresource *current = e;
-    free (e->name);
+    edgex_atom_free (e->name);
     resourceoperation_free (e->set);
     resourceoperation_free (e->get);
     e = e->next;
-    free (current);
+    edgex_mem_free (EDGEX_MEM_PROFILES, current);
   }
 }
 
 static edgex_deviceprofile *deviceprofile_read
   (iot_logging_client *lc, const JSON_Object *obj)
 {
-  edgex_deviceprofile *result = malloc (sizeof (edgex_deviceprofile));
+  edgex_deviceprofile *result =
+    edgex_mem_malloc (EDGEX_MEM_PROFILES, sizeof (edgex_deviceprofile));
   size_t count;
   JSON_Array *array;
   edgex_deviceresource **last_ptr = &result->device_resources;
   edgex_command **last_ptr2 = &result->commands;
   edgex_profileresource **last_ptr3 = &result->resources;
 
-  result->id = get_string (obj, "id");
-  result->name = get_string (obj, "name");
+  result->id = get_atom (obj, "id");
+  result->name = get_atom (obj, "name");
   result->description = get_string (obj, "description");
   result->created = (uint64_t) json_object_get_number (obj, "created");
   result->modified = (uint64_t) json_object_get_number (obj, "modified");
@@ -985,6 +1070,8 @@ static edgex_deviceprofile *deviceprofile_read
   result->device_resources = NULL;
   result->commands = NULL;
   result->resources = NULL;
+  result->cmdplan = NULL;
+  result->refs = 0;
   count = json_array_get_count (array);
   for (size_t i = 0; i < count; i++)
   {
@@ -1099,6 +1186,41 @@ edgex_deviceprofile *edgex_deviceprofile_read
   return result;
 }
 
+edgex_deviceprofile **edgex_deviceprofiles_read_value
+  (iot_logging_client *lc, const JSON_Value *val, unsigned *count)
+{
+  edgex_deviceprofile **result = NULL;
+  JSON_Array *array = json_value_get_array (val);
+
+  *count = 0;
+  if (array)
+  {
+    size_t n = json_array_get_count (array);
+    result = malloc ((n ? n : 1) * sizeof (edgex_deviceprofile *));
+    for (size_t i = 0; i < n; i++)
+    {
+      const JSON_Object *obj = json_array_get_object (array, i);
+      edgex_deviceprofile *dp = obj ? deviceprofile_read (lc, obj) : NULL;
+      if (dp)
+      {
+        result[(*count)++] = dp;
+      }
+    }
+  }
+
+  return result;
+}
+
+edgex_deviceprofile **edgex_deviceprofiles_read
+  (iot_logging_client *lc, const char *json, unsigned *count)
+{
+  JSON_Value *val = json_parse_string (json);
+  edgex_deviceprofile **result =
+    edgex_deviceprofiles_read_value (lc, val, count);
+  json_value_free (val);
+  return result;
+}
+
 static edgex_addressable *addressable_read (const JSON_Object *obj)
 {
   edgex_addressable *result = malloc (sizeof (edgex_addressable));
@@ -1208,12 +1330,12 @@ static edgex_deviceservice *deviceservice_read (const JSON_Object *obj)
     (json_object_get_string (obj, "adminState"));
   result->created = json_object_get_number (obj, "created");
   result->description = get_string (obj, "description");
-  result->id = get_string (obj, "id");
+  result->id = get_atom (obj, "id");
   result->labels = array_to_strings (json_object_get_array (obj, "labels"));
   result->lastConnected = json_object_get_number (obj, "lastConnected");
   result->lastReported = json_object_get_number (obj, "lastReported");
   result->modified = json_object_get_number (obj, "modified");
-  result->name = get_string (obj, "name");
+  result->name = get_atom (obj, "name");
   result->operatingState = edgex_operatingstate_fromstring
     (json_object_get_string (obj, "operatingState"));
   result->origin = json_object_get_number (obj, "origin");
@@ -1263,8 +1385,8 @@ static JSON_Value *deviceservice_write_name (const edgex_deviceservice *e)
 edgex_deviceservice *edgex_deviceservice_dup (const edgex_deviceservice *e)
 {
   edgex_deviceservice *res = malloc (sizeof (edgex_deviceservice));
-  res->name = strdup (e->name);
-  res->id = strdup (e->id);
+  res->name = edgex_atom (e->name);
+  res->id = edgex_atom (e->id);
   res->description = strdup (e->description);
   res->labels = edgex_strings_dup (e->labels);
   res->addressable = edgex_addressable_dup (e->addressable);
@@ -1284,9 +1406,9 @@ void edgex_deviceservice_free (edgex_deviceservice *e)
   {
     edgex_addressable_free (e->addressable);
     free (e->description);
-    free (e->id);
+    edgex_atom_free (e->id);
     edgex_strings_free (e->labels);
-    free (e->name);
+    edgex_atom_free (e->name);
     free (e);
   }
 }
@@ -1297,7 +1419,7 @@ char *edgex_deviceprofile_write (const edgex_deviceprofile *e, bool create)
   JSON_Value *val;
 
   val = deviceprofile_write (e, create);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -1307,9 +1429,10 @@ edgex_deviceprofile *edgex_deviceprofile_dup (edgex_deviceprofile *dp)
   edgex_deviceprofile *result = NULL;
   if (dp)
   {
-    result = malloc (sizeof (edgex_deviceprofile));
-    result->id = strdup (dp->id);
-    result->name = strdup (dp->name);
+    result = edgex_mem_malloc
+      (EDGEX_MEM_PROFILES, sizeof (edgex_deviceprofile));
+    result->id = edgex_atom (dp->id);
+    result->name = edgex_atom (dp->name);
     result->description = strdup (dp->description);
     result->created = dp->created;
     result->modified = dp->modified;
@@ -1320,14 +1443,26 @@ edgex_deviceprofile *edgex_deviceprofile_dup (edgex_deviceprofile *dp)
     result->device_resources = edgex_deviceresource_dup (dp->device_resources);
     result->commands = command_dup (dp->commands);
     result->resources = profileresource_dup (dp->resources);
+    result->cmdplan = NULL;
+    result->refs = 0;
   }
   return result;
 }
 
+edgex_deviceprofile *edgex_deviceprofile_ref (edgex_deviceprofile *e)
+{
+  __atomic_add_fetch (&e->refs, 1, __ATOMIC_RELAXED);
+  return e;
+}
+
 void edgex_deviceprofile_free (edgex_deviceprofile *e)
 {
-  free (e->id);
-  free (e->name);
+  if (e == NULL || __atomic_fetch_sub (&e->refs, 1, __ATOMIC_ACQ_REL) != 0)
+  {
+    return;
+  }
+  edgex_atom_free (e->id);
+  edgex_atom_free (e->name);
   free (e->description);
   free (e->manufacturer);
   free (e->model);
@@ -1335,7 +1470,8 @@ void edgex_deviceprofile_free (edgex_deviceprofile *e)
   deviceresource_free (e->device_resources);
   command_free (e->commands);
   profileresource_free (e->resources);
-  free (e);
+  edgex_cmdplan_free (e->cmdplan);
+  edgex_mem_free (EDGEX_MEM_PROFILES, e);
 }
 
 edgex_deviceservice *edgex_deviceservice_read (const char *json)
@@ -1362,7 +1498,7 @@ char *edgex_deviceservice_write (const edgex_deviceservice *e, bool create)
   JSON_Value *val;
 
   val = deviceservice_write (e, create);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -1370,19 +1506,20 @@ char *edgex_deviceservice_write (const edgex_deviceservice *e, bool create)
 static edgex_device *device_read
   (iot_logging_client *lc, const JSON_Object *obj)
 {
-  edgex_device *result = malloc (sizeof (edgex_device));
+  edgex_device *result =
+    edgex_mem_malloc (EDGEX_MEM_DEVICES, sizeof (edgex_device));
   result->addressable = addressable_read
     (json_object_get_object (obj, "addressable"));;
   result->adminState = edgex_adminstate_fromstring
     (json_object_get_string (obj, "adminState"));
   result->created = json_object_get_number (obj, "created");
   result->description = get_string (obj, "description");
-  result->id = get_string (obj, "id");
+  result->id = get_atom (obj, "id");
   result->labels = array_to_strings (json_object_get_array (obj, "labels"));
   result->lastConnected = json_object_get_number (obj, "lastConnected");
   result->lastReported = json_object_get_number (obj, "lastReported");
   result->modified = json_object_get_number (obj, "modified");
-  result->name = get_string (obj, "name");
+  result->name = get_atom (obj, "name");
   result->operatingState = edgex_operatingstate_fromstring
     (json_object_get_string (obj, "operatingState"));
   result->origin = json_object_get_number (obj, "origin");
@@ -1391,6 +1528,8 @@ static edgex_device *device_read
   result->service = deviceservice_read
     (json_object_get_object (obj, "service"));
   result->next = NULL;
+  result->refs = 0;
+  result->stats = NULL;
 
   return result;
 }
@@ -1444,9 +1583,10 @@ static JSON_Value *device_write (const edgex_device *e, bool create)
 
 edgex_device *edgex_device_dup (const edgex_device *e)
 {
-  edgex_device *result = malloc (sizeof (edgex_device));
-  result->name = strdup (e->name);
-  result->id = strdup (e->id);
+  edgex_device *result =
+    edgex_mem_malloc (EDGEX_MEM_DEVICES, sizeof (edgex_device));
+  result->name = edgex_atom (e->name);
+  result->id = edgex_atom (e->id);
   result->description = strdup (e->description);
   result->labels = edgex_strings_dup (e->labels);
   result->addressable = edgex_addressable_dup (e->addressable);
@@ -1458,8 +1598,10 @@ edgex_device *edgex_device_dup (const edgex_device *e)
   result->lastConnected = e->lastConnected;
   result->lastReported = e->lastReported;
   result->service = edgex_deviceservice_dup (e->service);
-  result->profile = edgex_deviceprofile_dup (e->profile);
+  result->profile = edgex_deviceprofile_ref (e->profile);
   result->next = NULL;
+  result->refs = 0;
+  result->stats = NULL;
   return result;
 }
 
@@ -1470,13 +1612,13 @@ void edgex_device_free (edgex_device *e)
     edgex_device *current = e;
     edgex_addressable_free (e->addressable);
     free (e->description);
-    free (e->id);
+    edgex_atom_free (e->id);
     edgex_strings_free (e->labels);
-    free (e->name);
+    edgex_atom_free (e->name);
     edgex_deviceprofile_free (e->profile);
     edgex_deviceservice_free (e->service);
     e = e->next;
-    free (current);
+    edgex_mem_free (EDGEX_MEM_DEVICES, current);
   }
 }
 
@@ -1504,7 +1646,7 @@ char *edgex_device_write (const edgex_device *e, bool create)
   JSON_Value *val;
 
   val = device_write (e, create);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -1536,16 +1678,16 @@ char *edgex_device_write_sparse
     json_object_set_string (pobj, "name", profile_name);
     json_object_set_value (obj, "profile", pval);
   }
-  json = json_serialize_to_string (jval);
+  json = serialize (jval);
   json_value_free (jval);
 
   return json;
 }
 
-edgex_device *edgex_devices_read (iot_logging_client *lc, const char *json)
+edgex_device *edgex_devices_read_value
+  (iot_logging_client *lc, const JSON_Value *val)
 {
   edgex_device *result = NULL;
-  JSON_Value *val = json_parse_string (json);
   JSON_Array *array = json_value_get_array (val);
   edgex_device **last_ptr = &result;
 
@@ -1560,8 +1702,408 @@ edgex_device *edgex_devices_read (iot_logging_client *lc, const char *json)
     }
   }
 
-  json_value_free (val);
+  return result;
+}
+
+/*
+ * Device lists from metadata are read with the pull reader (see jsonpull.h),
+ * which fills in each device directly rather than building a DOM of the
+ * whole list. Every device carries its profile, but a list has few distinct
+ * profiles: each is parsed the first time it is seen, and shared by the
+ * devices which follow with the same version of it. The other objects within
+ * a device are small, and are parsed individually with parson.
+ */
+
+typedef edgex_map(edgex_deviceprofile *) edgex_map_profile;
+
+typedef struct pull_scratch
+{
+  char *buf;
+  size_t size;
+} pull_scratch;
+
+static char *pull_scratch_get (pull_scratch *sc, size_t len)
+{
+  if (sc->size < len + 1)
+  {
+    sc->size = len + 1;
+    sc->buf = realloc (sc->buf, sc->size);
+  }
+  return sc->buf;
+}
+
+/* Parse the object just skipped by the reader */
+
+static JSON_Value *pull_parse (const edgex_jsonpull *r, pull_scratch *sc)
+{
+  char *buf = pull_scratch_get (sc, r->toklen);
+  memcpy (buf, r->tok, r->toklen);
+  buf[r->toklen] = '\0';
+  return json_parse_string (buf);
+}
+
+static char *pull_atom (const edgex_jsonpull *r, pull_scratch *sc)
+{
+  char *buf = pull_scratch_get (sc, r->toklen);
+  edgex_jsonpull_decode (r, buf);
+  return edgex_atom (buf);
+}
+
+static bool pull_strings
+  (edgex_jsonpull *r, pull_scratch *sc, edgex_strings **result)
+{
+  edgex_strings **last_ptr = result;
+  edgex_json_token t;
+
+  while ((t = edgex_jsonpull_next (r)) != EDGEX_JSON_ARRAY_END)
+  {
+    edgex_strings *temp = malloc (sizeof (edgex_strings));
+    temp->next = NULL;
+    temp->str = (t == EDGEX_JSON_STRING) ? pull_atom (r, sc) : edgex_atom ("");
+    *last_ptr = temp;
+    last_ptr = &(temp->next);
+    if (!edgex_jsonpull_skip (r, t))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Find the name and modification time of a profile without reading it all */
+
+static const char *pull_profile_id
+  (edgex_jsonpull r, pull_scratch *sc, uint64_t *modified)
+{
+  const char *name = NULL;
+  edgex_json_token t;
+
+  *modified = 0;
+  while ((t = edgex_jsonpull_next (&r)) == EDGEX_JSON_KEY)
+  {
+    bool isname = edgex_jsonpull_is (&r, "name");
+    bool ismod = edgex_jsonpull_is (&r, "modified");
+    t = edgex_jsonpull_next (&r);
+    if (isname && t == EDGEX_JSON_STRING)
+    {
+      char *buf = pull_scratch_get (sc, r.toklen);
+      edgex_jsonpull_decode (&r, buf);
+      name = buf;
+    }
+    else if (ismod && t == EDGEX_JSON_NUMBER)
+    {
+      *modified = edgex_jsonpull_number (&r);
+    }
+    if ((name && *modified) || !edgex_jsonpull_skip (&r, t))
+    {
+      break;
+    }
+  }
+  return name;
+}
 
+/* Read a profile, which may be NULL if it is invalid */
+
+static bool pull_profile
+(
+  iot_logging_client *lc,
+  edgex_jsonpull *r,
+  pull_scratch *sc,
+  edgex_map_profile *seen,
+  edgex_deviceprofile **result
+)
+{
+  uint64_t modified;
+  const char *name = pull_profile_id (*r, sc, &modified);
+  edgex_deviceprofile **found = name ? edgex_map_get (seen, name) : NULL;
+  edgex_deviceprofile *shared = (found && (*found)->modified == modified) ?
+    *found : NULL;
+
+  if (!edgex_jsonpull_skip (r, EDGEX_JSON_OBJECT))
+  {
+    return false;
+  }
+  if (shared)
+  {
+    *result = edgex_deviceprofile_ref (shared);
+  }
+  else
+  {
+    JSON_Value *val = pull_parse (r, sc);
+    *result = deviceprofile_read (lc, json_value_get_object (val));
+    json_value_free (val);
+    if (*result)
+    {
+      edgex_map_set (seen, (*result)->name, *result);
+    }
+  }
+  return true;
+}
+
+static void pull_set_string (char **dst, char *str)
+{
+  free (*dst);
+  *dst = str;
+}
+
+static void pull_set_atom (char **dst, char *str)
+{
+  edgex_atom_free (*dst);
+  *dst = str;
+}
+
+static bool device_pull
+(
+  iot_logging_client *lc,
+  edgex_jsonpull *r,
+  pull_scratch *sc,
+  edgex_map_profile *seen,
+  edgex_device *result,
+  bool *profiled
+)
+{
+  edgex_json_token t;
+  JSON_Value *val;
+
+  result->adminState = UNLOCKED;
+  result->operatingState = ENABLED;
+  while ((t = edgex_jsonpull_next (r)) == EDGEX_JSON_KEY)
+  {
+    char key[16] = "";
+    if (r->toklen < sizeof (key))
+    {
+      edgex_jsonpull_decode (r, key);
+    }
+    t = edgex_jsonpull_next (r);
+    if (t == EDGEX_JSON_STRING)
+    {
+      if (strcmp (key, "name") == 0)
+      {
+        pull_set_atom (&result->name, pull_atom (r, sc));
+      }
+      else if (strcmp (key, "id") == 0)
+      {
+        pull_set_atom (&result->id, pull_atom (r, sc));
+      }
+      else if (strcmp (key, "description") == 0)
+      {
+        pull_set_string (&result->description, edgex_jsonpull_strdup (r));
+      }
+      else if (strcmp (key, "adminState") == 0)
+      {
+        result->adminState = edgex_jsonpull_is (r, adstatetypes[LOCKED]) ?
+          LOCKED : UNLOCKED;
+      }
+      else if (strcmp (key, "operatingState") == 0)
+      {
+        result->operatingState =
+          edgex_jsonpull_is (r, opstatetypes[DISABLED]) ? DISABLED : ENABLED;
+      }
+    }
+    else if (t == EDGEX_JSON_NUMBER)
+    {
+      uint64_t n = edgex_jsonpull_number (r);
+      if (strcmp (key, "created") == 0)
+      {
+        result->created = n;
+      }
+      else if (strcmp (key, "modified") == 0)
+      {
+        result->modified = n;
+      }
+      else if (strcmp (key, "origin") == 0)
+      {
+        result->origin = n;
+      }
+      else if (strcmp (key, "lastConnected") == 0)
+      {
+        result->lastConnected = n;
+      }
+      else if (strcmp (key, "lastReported") == 0)
+      {
+        result->lastReported = n;
+      }
+    }
+    else if (t == EDGEX_JSON_ARRAY && strcmp (key, "labels") == 0)
+    {
+      edgex_strings_free (result->labels);
+      result->labels = NULL;
+      if (!pull_strings (r, sc, &result->labels))
+      {
+        return false;
+      }
+      continue;
+    }
+    else if (t == EDGEX_JSON_OBJECT && strcmp (key, "profile") == 0)
+    {
+      if (*profiled && result->profile)
+      {
+        edgex_deviceprofile_free (result->profile);
+      }
+      result->profile = NULL;
+      *profiled = true;
+      if (!pull_profile (lc, r, sc, seen, &result->profile))
+      {
+        return false;
+      }
+      continue;
+    }
+    else if (t == EDGEX_JSON_OBJECT && strcmp (key, "addressable") == 0)
+    {
+      if (!edgex_jsonpull_skip (r, t))
+      {
+        return false;
+      }
+      val = pull_parse (r, sc);
+      edgex_addressable_free (result->addressable);
+      result->addressable = addressable_read (json_value_get_object (val));
+      json_value_free (val);
+      continue;
+    }
+    else if (t == EDGEX_JSON_OBJECT && strcmp (key, "service") == 0)
+    {
+      if (!edgex_jsonpull_skip (r, t))
+      {
+        return false;
+      }
+      val = pull_parse (r, sc);
+      edgex_deviceservice_free (result->service);
+      result->service = deviceservice_read (json_value_get_object (val));
+      json_value_free (val);
+      continue;
+    }
+    if (!edgex_jsonpull_skip (r, t))
+    {
+      return false;
+    }
+  }
+  return t == EDGEX_JSON_OBJECT_END;
+}
+
+/* Supply the values which device_read gives to members which are absent */
+
+static void device_pull_defaults
+  (iot_logging_client *lc, edgex_device *d, bool profiled)
+{
+  if (d->name == NULL)
+  {
+    d->name = edgex_atom ("");
+  }
+  if (d->id == NULL)
+  {
+    d->id = edgex_atom ("");
+  }
+  if (d->description == NULL)
+  {
+    d->description = strdup ("");
+  }
+  if (d->addressable == NULL)
+  {
+    d->addressable = addressable_read (NULL);
+  }
+  if (!profiled)
+  {
+    d->profile = deviceprofile_read (lc, NULL);
+  }
+  if (d->service == NULL)
+  {
+    d->service = deviceservice_read (NULL);
+  }
+}
+
+edgex_device *edgex_devices_read (iot_logging_client *lc, const char *json)
+{
+  edgex_device *result = NULL;
+  edgex_device **last_ptr = &result;
+  edgex_map_profile seen;
+  pull_scratch sc = { NULL, 0 };
+  edgex_jsonpull r;
+  edgex_json_token t = EDGEX_JSON_ERROR;
+  bool ok;
+
+  edgex_map_init (&seen);
+  edgex_jsonpull_init (&r, json, strlen (json));
+  ok = (edgex_jsonpull_next (&r) == EDGEX_JSON_ARRAY);
+  while (ok && (t = edgex_jsonpull_next (&r)) == EDGEX_JSON_OBJECT)
+  {
+    edgex_device *temp =
+      edgex_mem_calloc (EDGEX_MEM_DEVICES, 1, sizeof (edgex_device));
+    bool profiled = false;
+    *last_ptr = temp;
+    last_ptr = &(temp->next);
+    ok = device_pull (lc, &r, &sc, &seen, temp, &profiled);
+    device_pull_defaults (lc, temp, profiled);
+  }
+  ok = ok && t == EDGEX_JSON_ARRAY_END &&
+    edgex_jsonpull_next (&r) == EDGEX_JSON_END;
+
+  edgex_map_deinit (&seen);
+  free (sc.buf);
+  if (!ok)
+  {
+    edgex_device_free (result);
+    result = NULL;
+  }
+  return result;
+}
+
+struct edgex_devices_reader
+{
+  iot_logging_client *lc;
+  edgex_device *result;
+  edgex_device **last_ptr;
+  edgex_map_profile seen;
+  pull_scratch sc;
+  bool failed;
+};
+
+edgex_devices_reader *edgex_devices_reader_create (iot_logging_client *lc)
+{
+  edgex_devices_reader *rd = calloc (1, sizeof (edgex_devices_reader));
+  rd->lc = lc;
+  rd->last_ptr = &rd->result;
+  edgex_map_init (&rd->seen);
+  return rd;
+}
+
+bool edgex_devices_reader_add
+  (edgex_devices_reader *rd, const char *json, size_t len)
+{
+  edgex_jsonpull r;
+  bool profiled = false;
+  bool ok;
+
+  edgex_jsonpull_init (&r, json, len);
+  if (rd->failed || edgex_jsonpull_next (&r) != EDGEX_JSON_OBJECT)
+  {
+    rd->failed = true;
+    return false;
+  }
+  edgex_device *temp =
+    edgex_mem_calloc (EDGEX_MEM_DEVICES, 1, sizeof (edgex_device));
+  *rd->last_ptr = temp;
+  rd->last_ptr = &(temp->next);
+  ok = device_pull (rd->lc, &r, &rd->sc, &rd->seen, temp, &profiled);
+  device_pull_defaults (rd->lc, temp, profiled);
+  if (!ok || edgex_jsonpull_next (&r) != EDGEX_JSON_END)
+  {
+    rd->failed = true;
+  }
+  return !rd->failed;
+}
+
+edgex_device *edgex_devices_reader_finish (edgex_devices_reader *rd, bool ok)
+{
+  edgex_device *result = rd->result;
+
+  edgex_map_deinit (&rd->seen);
+  free (rd->sc.buf);
+  if (!ok || rd->failed)
+  {
+    edgex_device_free (result);
+    result = NULL;
+  }
+  free (rd);
   return result;
 }
 
@@ -1642,7 +2184,7 @@ char *edgex_scheduleevent_write (const edgex_scheduleevent *e, bool create)
   JSON_Value *val;
 
   val = scheduleevent_write (e, create);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -1723,7 +2265,7 @@ char *edgex_schedule_write (const edgex_schedule *e, bool create)
   JSON_Value *val;
 
   val = schedule_write (e, create);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -1764,7 +2306,7 @@ char *edgex_addressable_write (const edgex_addressable *e, bool create)
   JSON_Value *val;
 
   val = addressable_write (e, create);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -1849,7 +2391,7 @@ char *edgex_valuedescriptor_write (const edgex_valuedescriptor *e)
   JSON_Value *val;
 
   val = valuedescriptor_write (e);
-  result = json_serialize_to_string (val);
+  result = serialize (val);
   json_value_free (val);
   return result;
 }
@@ -21,8 +21,18 @@ void edgex_nvpairs_free (edgex_nvpairs *p);
 const char *edgex_propertytype_tostring (edgex_propertytype pt);
 bool edgex_propertytype_fromstring (edgex_propertytype *res, const char *str);
 edgex_deviceprofile *edgex_deviceprofile_read (iot_logging_client *lc, const char *json);
+edgex_deviceprofile **edgex_deviceprofiles_read (iot_logging_client *lc, const char *json, unsigned *count);
+edgex_deviceprofile **edgex_deviceprofiles_read_value (iot_logging_client *lc, const JSON_Value *val, unsigned *count);
 char *edgex_deviceprofile_write (const edgex_deviceprofile *e, bool create);
 edgex_deviceprofile *edgex_deviceprofile_dup (edgex_deviceprofile *e);
+
+/*
+ * Profiles are shared between devices, and must not be modified once
+ * shared. refs counts the holders other than the first; free releases a
+ * reference, and frees the profile when the last is released.
+ */
+
+edgex_deviceprofile *edgex_deviceprofile_ref (edgex_deviceprofile *e);
 void edgex_deviceprofile_free (edgex_deviceprofile *e);
 edgex_deviceservice *edgex_deviceservice_read (const char *json);
 char *edgex_deviceservice_write (const edgex_deviceservice *e, bool create);
@@ -34,6 +44,19 @@ char *edgex_device_write_sparse (const char *name, const char *id, const char *d
 edgex_device *edgex_device_dup (const edgex_device *e);
 void edgex_device_free (edgex_device *e);
 edgex_device *edgex_devices_read (iot_logging_client *lc, const char *json);
+edgex_device *edgex_devices_read_value (iot_logging_client *lc, const JSON_Value *val);
+
+/*
+ * Read a device list one device at a time, as the elements of a list
+ * streamed from metadata arrive. Profiles are shared between the devices as
+ * in edgex_devices_read. finish returns the list, or NULL if ok is false or
+ * any of the devices could not be read, and frees the reader.
+ */
+
+typedef struct edgex_devices_reader edgex_devices_reader;
+edgex_devices_reader *edgex_devices_reader_create (iot_logging_client *lc);
+bool edgex_devices_reader_add (edgex_devices_reader *rd, const char *json, size_t len);
+edgex_device *edgex_devices_reader_finish (edgex_devices_reader *rd, bool ok);
 edgex_scheduleevent *edgex_scheduleevents_read (const char *json);
 char *edgex_scheduleevent_write (const edgex_scheduleevent *e, bool create);
 void edgex_scheduleevent_free (edgex_scheduleevent *e);
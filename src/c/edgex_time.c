@@ -7,9 +7,140 @@
  */
 
 #include <time.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
 #include "edgex_time.h"
 
+/* The clock id of a PTP hardware clock, from its open device (see the
+ * kernel's testptp.c).
+ */
+
+#define FD_TO_CLOCKID(fd) ((~(clockid_t) (fd) << 3) | 3)
+
+/* With no clock set, the time is read in whole seconds with time() */
+
+static bool edgex_clock_set = false;
+static clockid_t edgex_clock = CLOCK_REALTIME;
+static int edgex_clock_fd = -1;
+static bool edgex_origin_nanos = false;
+
+bool edgex_device_setclock (const char *name)
+{
+  clockid_t clk = CLOCK_REALTIME;
+  int fd = -1;
+  struct timespec ts;
+
+  if (name == NULL || *name == '\0' || strcasecmp (name, "Seconds") == 0)
+  {
+    edgex_clock_set = false;
+  }
+  else
+  {
+    if (strcasecmp (name, "Coarse") == 0)
+    {
+      clk = CLOCK_REALTIME_COARSE;
+    }
+    else if (strcasecmp (name, "Realtime"))
+    {
+      fd = open (name, O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+      {
+        return false;
+      }
+      clk = FD_TO_CLOCKID (fd);
+    }
+    if (clock_gettime (clk, &ts) != 0)
+    {
+      if (fd >= 0)
+      {
+        close (fd);
+      }
+      return false;
+    }
+    edgex_clock_set = true;
+  }
+  edgex_clock = clk;
+  if (edgex_clock_fd >= 0)
+  {
+    close (edgex_clock_fd);
+  }
+  edgex_clock_fd = fd;
+  return true;
+}
+
+void edgex_device_setoriginnanos (bool nanos)
+{
+  edgex_origin_nanos = nanos;
+}
+
+uint64_t edgex_device_originunit (void)
+{
+  return edgex_origin_nanos ? 1000000 : 1;
+}
+
 uint64_t edgex_device_millitime()
 {
-  return (uint64_t)time (NULL) * EDGEX_MILLIS;
+  struct timespec ts;
+  if (!edgex_clock_set)
+  {
+    return (uint64_t)time (NULL) * EDGEX_MILLIS;
+  }
+  clock_gettime (edgex_clock, &ts);
+  return (uint64_t)ts.tv_sec * EDGEX_MILLIS + ts.tv_nsec / 1000000;
+}
+
+uint64_t edgex_device_nanotime (void)
+{
+  struct timespec ts;
+  if (!edgex_clock_set)
+  {
+    return (uint64_t)time (NULL) * 1000000000ULL;
+  }
+  clock_gettime (edgex_clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t edgex_device_origintime (void)
+{
+  return edgex_origin_nanos ?
+    edgex_device_nanotime () : edgex_device_millitime ();
+}
+
+uint64_t edgex_device_monotime ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t edgex_device_backoff (uint64_t *delay, uint64_t base, uint64_t limit)
+{
+  static __thread uint64_t seed = 0;
+
+  if (*delay == 0)
+  {
+    *delay = base;
+  }
+  else
+  {
+    *delay = (*delay > limit / 2) ? limit : *delay * 2;
+  }
+  if (*delay < base)
+  {
+    *delay = base;
+  }
+
+  /* xorshift64, seeded per thread from the clock */
+
+  if (seed == 0)
+  {
+    seed = edgex_device_monotime () | 1;
+  }
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  uint64_t jitter = *delay / 4;
+  return jitter ? *delay - seed % jitter : *delay;
 }
@@ -10,9 +10,51 @@
 #define _EDGEX_DEVICE_EX_TIME_H_ 1
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #define EDGEX_MILLIS 1000
 
+/*
+ * Select the clock from which the time of day is read. name is "Seconds"
+ * (the default: time() in whole seconds), "Coarse" (CLOCK_REALTIME_COARSE,
+ * read without a system call but only to the kernel's tick), "Realtime"
+ * (CLOCK_REALTIME), or the device of a PTP hardware clock such as /dev/ptp0.
+ * Returns false, leaving the clock unchanged, if the clock can not be read.
+ * To be called before the service's threads start.
+ */
+
+extern bool edgex_device_setclock (const char *name);
+
+/* Milliseconds and nanoseconds since the epoch, from the selected clock */
+
 extern uint64_t edgex_device_millitime(void);
 
+extern uint64_t edgex_device_nanotime (void);
+
+/*
+ * Origins given by the SDK to events and readings are in milliseconds, or
+ * in nanoseconds if set here. edgex_device_originunit is the number of
+ * units of an origin in a millisecond.
+ */
+
+extern void edgex_device_setoriginnanos (bool nanos);
+
+extern uint64_t edgex_device_originunit (void);
+
+extern uint64_t edgex_device_origintime (void);
+
+/* Nanoseconds from the monotonic clock, for measuring intervals */
+
+extern uint64_t edgex_device_monotime (void);
+
+/*
+ * The delay in nanoseconds before the next of a series of retries. *delay
+ * holds the current step, zero before the first retry: it starts at base and
+ * doubles each time, up to limit. Up to a quarter of the step is taken off
+ * at random, so that callers retrying together spread out.
+ */
+
+extern uint64_t edgex_device_backoff
+  (uint64_t *delay, uint64_t base, uint64_t limit);
+
 #endif
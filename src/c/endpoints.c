@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "endpoints.h"
+#include "edgex_time.h"
+#include "errorlist.h"
+#include "rest.h"
+#include "stats.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* How long the instances found in the registry are used before looking again,
+ * and how soon to look again if that failed.
+ */
+
+#define RESOLVE_TTL (30 * 1000000000ULL)
+#define RESOLVE_RETRY (5 * 1000000000ULL)
+
+/* How long an instance is avoided once a request to it has failed */
+
+#define INSTANCE_HOLDOFF (10 * 1000000000ULL)
+
+#define PREFIX_SIZE 128
+
+typedef struct endpoint_instance
+{
+  char prefix[PREFIX_SIZE];
+  size_t len;
+  uint64_t holdoff;
+} endpoint_instance;
+
+struct edgex_endpoint_pool
+{
+  pthread_mutex_t lock;
+  edgex_registry *registry;
+  iot_logging_client *lc;
+  endpoint_instance fallback;
+  endpoint_instance *instances;
+  unsigned ninstances;
+  unsigned next;
+  uint64_t expires;
+  bool resolving;
+  uint32_t threshold;
+  uint64_t base;
+  uint64_t limit;
+  uint32_t failures;
+  uint64_t delay;
+  uint64_t reopen;
+  bool open;
+  bool probing;
+};
+
+static void instance_init
+  (endpoint_instance *inst, const char *host, uint16_t port)
+{
+  int n = snprintf (inst->prefix, PREFIX_SIZE, "http://%s:%u", host, port);
+  inst->len = (n < PREFIX_SIZE) ? n : PREFIX_SIZE - 1;
+  inst->holdoff = 0;
+}
+
+void edgex_endpoint_init
+(
+  edgex_device_service_endpoint *ep,
+  edgex_registry *registry,
+  iot_logging_client *lc
+)
+{
+  edgex_endpoint_pool *pool = calloc (1, sizeof (edgex_endpoint_pool));
+  pthread_mutex_init (&pool->lock, NULL);
+  pool->lc = lc;
+  if (ep->name && *ep->name)
+  {
+    pool->registry = registry;
+  }
+  instance_init (&pool->fallback, ep->host ? ep->host : "", ep->port);
+  ep->pool = pool;
+}
+
+void edgex_endpoint_fini (edgex_device_service_endpoint *ep)
+{
+  if (ep->pool)
+  {
+    pthread_mutex_destroy (&ep->pool->lock);
+    free (ep->pool->instances);
+    free (ep->pool);
+    ep->pool = NULL;
+  }
+}
+
+/* Look for the instances of the service. Called without the lock held */
+
+static void endpoint_resolve (edgex_device_service_endpoint *ep)
+{
+  edgex_endpoint_pool *pool = ep->pool;
+  edgex_error err = EDGEX_OK;
+  endpoint_instance *instances = NULL;
+  unsigned count = 0;
+
+  edgex_registry_hostport *found =
+    edgex_registry_query_service (pool->registry, ep->name, &count, &err);
+  if (err.code == 0 && count)
+  {
+    instances = malloc (count * sizeof (endpoint_instance));
+    for (unsigned i = 0; i < count; i++)
+    {
+      instance_init (&instances[i], found[i].host, found[i].port);
+    }
+  }
+  for (unsigned i = 0; i < count; i++)
+  {
+    free (found[i].host);
+  }
+  free (found);
+
+  pthread_mutex_lock (&pool->lock);
+  if (err.code)
+  {
+    iot_log_warning
+      (pool->lc, "Unable to find instances of %s in registry", ep->name);
+    pool->expires = edgex_device_monotime () + RESOLVE_RETRY;
+  }
+  else
+  {
+    if (count != pool->ninstances)
+    {
+      iot_log_info
+        (pool->lc, "Found %u instances of %s in registry", count, ep->name);
+    }
+
+    /* Instances which are being avoided continue to be */
+
+    for (unsigned i = 0; i < count; i++)
+    {
+      for (unsigned j = 0; j < pool->ninstances; j++)
+      {
+        if (strcmp (instances[i].prefix, pool->instances[j].prefix) == 0)
+        {
+          instances[i].holdoff = pool->instances[j].holdoff;
+          break;
+        }
+      }
+    }
+    free (pool->instances);
+    pool->instances = instances;
+    pool->ninstances = count;
+    pool->expires = edgex_device_monotime () + RESOLVE_TTL;
+  }
+  pool->resolving = false;
+  pthread_mutex_unlock (&pool->lock);
+}
+
+/* Choose the next instance which is not being avoided. Called locked */
+
+static const endpoint_instance *endpoint_select (edgex_endpoint_pool *pool)
+{
+  uint64_t now = edgex_device_monotime ();
+  unsigned n = pool->ninstances;
+
+  for (unsigned i = 0; i < n; i++)
+  {
+    endpoint_instance *inst = &pool->instances[pool->next++ % n];
+    if (inst->holdoff <= now)
+    {
+      return inst;
+    }
+  }
+  return n ? &pool->instances[pool->next++ % n] : &pool->fallback;
+}
+
+void edgex_endpoint_url
+  (edgex_device_service_endpoint *ep, char *url, const char *fmt, ...)
+{
+  edgex_endpoint_pool *pool = ep->pool;
+  size_t len;
+  va_list args;
+
+  if (pool == NULL)
+  {
+    len = snprintf (url, URL_BUF_SIZE, "http://%s:%u", ep->host, ep->port);
+  }
+  else
+  {
+    if (pool->registry)
+    {
+      bool resolve = false;
+      pthread_mutex_lock (&pool->lock);
+      if (!pool->resolving && edgex_device_monotime () >= pool->expires)
+      {
+        pool->resolving = resolve = true;
+      }
+      pthread_mutex_unlock (&pool->lock);
+      if (resolve)
+      {
+        endpoint_resolve (ep);
+      }
+    }
+    pthread_mutex_lock (&pool->lock);
+    const endpoint_instance *inst = endpoint_select (pool);
+    len = inst->len;
+    memcpy (url, inst->prefix, len + 1);
+    pthread_mutex_unlock (&pool->lock);
+  }
+
+  if (len < URL_BUF_SIZE)
+  {
+    va_start (args, fmt);
+    vsnprintf (url + len, URL_BUF_SIZE - len, fmt, args);
+    va_end (args);
+  }
+}
+
+void edgex_endpoint_result
+  (edgex_device_service_endpoint *ep, const char *url, long status)
+{
+  edgex_endpoint_pool *pool = ep->pool;
+
+  if (pool == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&pool->lock);
+  if (status)
+  {
+    pool->failures = 0;
+    pthread_mutex_unlock (&pool->lock);
+    return;
+  }
+  uint64_t now = edgex_device_monotime ();
+  for (unsigned i = 0; i < pool->ninstances; i++)
+  {
+    endpoint_instance *inst = &pool->instances[i];
+    if
+    (
+      strncmp (url, inst->prefix, inst->len) == 0 &&
+      (url[inst->len] == '/' || url[inst->len] == '\0')
+    )
+    {
+      inst->holdoff = now + INSTANCE_HOLDOFF;
+      break;
+    }
+  }
+  pool->failures++;
+  if (pool->threshold && !pool->open && pool->failures >= pool->threshold)
+  {
+    __atomic_store_n (&pool->open, true, __ATOMIC_RELAXED);
+    pool->reopen =
+      now + edgex_device_backoff (&pool->delay, pool->base, pool->limit);
+    iot_log_warning
+    (
+      pool->lc, "Circuit for %s opened after %u failed requests",
+      ep->name && *ep->name ? ep->name : pool->fallback.prefix, pool->failures
+    );
+  }
+  pthread_mutex_unlock (&pool->lock);
+}
+
+void edgex_endpoint_breaker
+(
+  edgex_device_service_endpoint *ep,
+  uint32_t threshold,
+  uint32_t base,
+  uint32_t limit
+)
+{
+  edgex_endpoint_pool *pool = ep->pool;
+
+  pthread_mutex_lock (&pool->lock);
+  pool->threshold = threshold;
+  pool->base = base * 1000000ULL;
+  pool->limit = (limit > base ? limit : base) * 1000000ULL;
+  pthread_mutex_unlock (&pool->lock);
+}
+
+/* Ping the service behind an endpoint whose circuit is open */
+
+static bool endpoint_probe (edgex_device_service_endpoint *ep)
+{
+  edgex_endpoint_pool *pool = ep->pool;
+  const char *name = ep->name && *ep->name ? ep->name : pool->fallback.prefix;
+  edgex_error err = EDGEX_OK;
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  edgex_endpoint_url (ep, url, "/api/v1/ping");
+  edgex_http_get (pool->lc, &ctx, url, edgex_http_write_cb, &err);
+  free (ctx.buff);
+
+  pthread_mutex_lock (&pool->lock);
+  pool->probing = false;
+  if (err.code == 0)
+  {
+    __atomic_store_n (&pool->open, false, __ATOMIC_RELAXED);
+    pool->failures = 0;
+    pool->delay = 0;
+    iot_log_info (pool->lc, "Circuit for %s closed", name);
+  }
+  else
+  {
+    pool->reopen = edgex_device_monotime () +
+      edgex_device_backoff (&pool->delay, pool->base, pool->limit);
+    iot_log_debug (pool->lc, "Circuit for %s remains open", name);
+  }
+  pthread_mutex_unlock (&pool->lock);
+  return (err.code == 0);
+}
+
+bool edgex_endpoint_available (edgex_device_service_endpoint *ep)
+{
+  edgex_endpoint_pool *pool = ep->pool;
+  bool probe = false;
+  bool result;
+
+  if (pool == NULL || !edgex_endpoint_isopen (ep))
+  {
+    return true;
+  }
+  pthread_mutex_lock (&pool->lock);
+  result = !pool->open;
+  if
+  (
+    pool->open && !pool->probing && edgex_device_monotime () >= pool->reopen
+  )
+  {
+    pool->probing = probe = true;
+  }
+  pthread_mutex_unlock (&pool->lock);
+
+  if (probe)
+  {
+    result = endpoint_probe (ep);
+  }
+  if (!result)
+  {
+    edgex_stats_count (EDGEX_STATS_CIRCUIT_REJECTS, 1);
+  }
+  return result;
+}
+
+bool edgex_endpoint_isopen (edgex_device_service_endpoint *ep)
+{
+  return ep->pool && __atomic_load_n (&ep->pool->open, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_ENDPOINTS_H_
+#define _EDGEX_DEVICE_ENDPOINTS_H_ 1
+
+#include "config.h"
+#include "edgex/registry.h"
+
+/*
+ * Resolution of the services this one makes requests to. An endpoint with a
+ * Name, where a registry is in use, is resolved to the healthy instances of
+ * that service in the registry; requests are spread across them in turn.
+ * Otherwise, or if the registry has no instances, the configured Host and
+ * Port are used. The "http://host:port" prefix of each instance is formatted
+ * once, when it is found.
+ */
+
+typedef struct edgex_endpoint_pool edgex_endpoint_pool;
+
+/* Prepare an endpoint for use. The registry may be NULL */
+
+extern void edgex_endpoint_init
+(
+  edgex_device_service_endpoint *ep,
+  edgex_registry *registry,
+  iot_logging_client *lc
+);
+
+extern void edgex_endpoint_fini (edgex_device_service_endpoint *ep);
+
+/*
+ * Write the URL (of at most URL_BUF_SIZE bytes) for a request to one of the
+ * endpoint's instances. The path is given as a format string.
+ */
+
+extern void edgex_endpoint_url
+  (edgex_device_service_endpoint *ep, char *url, const char *fmt, ...);
+
+/*
+ * Record the outcome of a request to a URL from edgex_endpoint_url: the HTTP
+ * status, or zero if the request could not be delivered. In that case its
+ * instance is avoided for a time, if others are up.
+ */
+
+extern void edgex_endpoint_result
+  (edgex_device_service_endpoint *ep, const char *url, long status);
+
+/*
+ * Circuit breaking. Once threshold requests in a row to an endpoint have not
+ * been delivered, its circuit opens and requests fail at once. After a delay
+ * starting at base milliseconds, and doubling (with jitter) up to limit each
+ * time the service is still found to be down, the next caller pings the
+ * service: the circuit closes if it responds. A threshold of zero, the
+ * default, disables this.
+ */
+
+extern void edgex_endpoint_breaker
+(
+  edgex_device_service_endpoint *ep,
+  uint32_t threshold,
+  uint32_t base,
+  uint32_t limit
+);
+
+/*
+ * Whether a request to the endpoint may be made, which is not so while its
+ * circuit is open. This may ping the service, if its delay is over.
+ */
+
+extern bool edgex_endpoint_available (edgex_device_service_endpoint *ep);
+
+/* Whether the endpoint's circuit is open. Does not contact the service */
+
+extern bool edgex_endpoint_isopen (edgex_device_service_endpoint *ep);
+
+#endif
@@ -30,4 +30,8 @@
 #define EDGEX_CONSUL_RESPONSE (edgex_error){ .code = 18, .reason = "Unable to process response from consul" }
 #define EDGEX_PROFILES_DIRECTORY (edgex_error){ .code = 19, .reason = "Problem scanning profiles directory" }
 #define EDGEX_ASSERT_FAIL (edgex_error){ .code = 20, .reason = "A reading did not match a specified assertion string" }
+#define EDGEX_POSTQUEUE_START (edgex_error){ .code = 21, .reason = "Unable to start event submission threads" }
+#define EDGEX_NO_DEVICE_PROFILE (edgex_error){ .code = 22, .reason = "Device profile not found" }
+#define EDGEX_EVENTLOG_OPEN (edgex_error){ .code = 23, .reason = "Unable to open event log" }
+#define EDGEX_EVENT_REJECTED (edgex_error){ .code = 24, .reason = "Event rejected by core-data" }
 #endif
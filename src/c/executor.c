@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "executor.h"
+#include "stats.h"
+#include "edgex_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define QUEUE_MIN 16
+
+typedef struct exec_task
+{
+  edgex_exec_fn fn;
+  void *arg;
+} exec_task;
+
+/* Circular double-ended queue. The owner takes from the head, thieves from
+ * the tail.
+ */
+
+typedef struct exec_queue
+{
+  exec_task *tasks;
+  unsigned cap;
+  unsigned head;
+  unsigned count;
+} exec_queue;
+
+typedef struct exec_worker
+{
+  edgex_executor *ex;
+  unsigned index;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  exec_queue queues[EDGEX_EXEC_NCLASSES];
+} exec_worker;
+
+/*
+ * The counts of queued and running tasks are kept under the executor's lock.
+ * A worker reserves a task of a class by decrementing its queued count, and
+ * is then certain to find one in some worker's queue.
+ */
+
+struct edgex_executor
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t idle;
+  unsigned queued[EDGEX_EXEC_NCLASSES];
+  unsigned running[EDGEX_EXEC_NCLASSES];
+  unsigned limits[EDGEX_EXEC_NCLASSES];
+  unsigned sleepers;
+  unsigned next;
+  bool stop;
+  unsigned nworkers;
+  exec_worker *workers;
+};
+
+static __thread exec_worker *exec_current = NULL;
+
+static void queue_push (exec_queue *q, exec_task t)
+{
+  if (q->count == q->cap)
+  {
+    unsigned newcap = q->cap ? q->cap * 2 : QUEUE_MIN;
+    exec_task *tasks = malloc (newcap * sizeof (exec_task));
+    for (unsigned i = 0; i < q->count; i++)
+    {
+      tasks[i] = q->tasks[(q->head + i) % q->cap];
+    }
+    free (q->tasks);
+    q->tasks = tasks;
+    q->cap = newcap;
+    q->head = 0;
+  }
+  q->tasks[(q->head + q->count++) % q->cap] = t;
+}
+
+static bool queue_take (exec_queue *q, exec_task *t)
+{
+  if (q->count == 0)
+  {
+    return false;
+  }
+  *t = q->tasks[q->head];
+  q->head = (q->head + 1) % q->cap;
+  q->count--;
+  return true;
+}
+
+static bool queue_steal (exec_queue *q, exec_task *t)
+{
+  if (q->count == 0)
+  {
+    return false;
+  }
+  *t = q->tasks[(q->head + --q->count) % q->cap];
+  return true;
+}
+
+/* Find a task of a class reserved by this worker */
+
+static exec_task worker_find (exec_worker *w, unsigned cls)
+{
+  edgex_executor *ex = w->ex;
+  exec_task t;
+  bool found;
+
+  pthread_mutex_lock (&w->lock);
+  found = queue_take (&w->queues[cls], &t);
+  pthread_mutex_unlock (&w->lock);
+
+  while (!found)
+  {
+    for (unsigned i = 1; i <= ex->nworkers && !found; i++)
+    {
+      exec_worker *victim = &ex->workers[(w->index + i) % ex->nworkers];
+      pthread_mutex_lock (&victim->lock);
+      found = queue_steal (&victim->queues[cls], &t);
+      pthread_mutex_unlock (&victim->lock);
+    }
+  }
+  return t;
+}
+
+static int runnable_class (edgex_executor *ex)
+{
+  for (unsigned c = 0; c < EDGEX_EXEC_NCLASSES; c++)
+  {
+    if (ex->queued[c] && (ex->limits[c] == 0 || ex->running[c] < ex->limits[c]))
+    {
+      return c;
+    }
+  }
+  return -1;
+}
+
+static bool executor_idle (edgex_executor *ex)
+{
+  for (unsigned c = 0; c < EDGEX_EXEC_NCLASSES; c++)
+  {
+    if (ex->queued[c] || ex->running[c])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void *worker_thread (void *p)
+{
+  exec_worker *w = (exec_worker *) p;
+  edgex_executor *ex = w->ex;
+
+  exec_current = w;
+  pthread_mutex_lock (&ex->lock);
+  for (;;)
+  {
+    int cls = runnable_class (ex);
+    if (cls < 0)
+    {
+      if (ex->stop && executor_idle (ex))
+      {
+        break;
+      }
+      ex->sleepers++;
+      pthread_cond_wait (&ex->work, &ex->lock);
+      ex->sleepers--;
+      continue;
+    }
+    ex->queued[cls]--;
+    ex->running[cls]++;
+    pthread_mutex_unlock (&ex->lock);
+
+    exec_task t = worker_find (w, cls);
+    uint64_t started = edgex_device_monotime ();
+    t.fn (t.arg);
+    edgex_stats_count (EDGEX_STATS_EXEC_TASKS, 1);
+    edgex_stats_count (EDGEX_STATS_EXEC_BUSY, edgex_device_monotime () - started);
+
+    pthread_mutex_lock (&ex->lock);
+    ex->running[cls]--;
+
+    /* Others may be waiting for this class to drop below its limit */
+
+    if (ex->limits[cls] && ex->queued[cls] && ex->sleepers)
+    {
+      pthread_cond_signal (&ex->work);
+    }
+    if (executor_idle (ex))
+    {
+      pthread_cond_broadcast (&ex->idle);
+      if (ex->stop)
+      {
+        pthread_cond_broadcast (&ex->work);
+      }
+    }
+  }
+  pthread_mutex_unlock (&ex->lock);
+  return NULL;
+}
+
+edgex_executor *edgex_executor_create
+(
+  unsigned nthreads,
+  const unsigned *limits,
+  const int *cpus,
+  unsigned ncpus
+)
+{
+  edgex_executor *ex = calloc (1, sizeof (edgex_executor));
+  pthread_mutex_init (&ex->lock, NULL);
+  pthread_cond_init (&ex->work, NULL);
+  pthread_cond_init (&ex->idle, NULL);
+  if (limits)
+  {
+    memcpy (ex->limits, limits, sizeof (ex->limits));
+  }
+  ex->nworkers = nthreads ? nthreads : 1;
+  ex->workers = calloc (ex->nworkers, sizeof (exec_worker));
+  for (unsigned i = 0; i < ex->nworkers; i++)
+  {
+    exec_worker *w = &ex->workers[i];
+    w->ex = ex;
+    w->index = i;
+    pthread_mutex_init (&w->lock, NULL);
+  }
+  for (unsigned i = 0; i < ex->nworkers; i++)
+  {
+    exec_worker *w = &ex->workers[i];
+    pthread_create (&w->thread, NULL, worker_thread, w);
+    if (cpus && ncpus)
+    {
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (cpus[i % ncpus], &set);
+      pthread_setaffinity_np (w->thread, sizeof (set), &set);
+    }
+  }
+  return ex;
+}
+
+void edgex_executor_submit
+  (edgex_executor *ex, edgex_exec_class cls, edgex_exec_fn fn, void *arg)
+{
+  exec_worker *w = exec_current;
+  exec_task t = { fn, arg };
+
+  if (w == NULL || w->ex != ex)
+  {
+    pthread_mutex_lock (&ex->lock);
+    w = &ex->workers[ex->next++ % ex->nworkers];
+    pthread_mutex_unlock (&ex->lock);
+  }
+  pthread_mutex_lock (&w->lock);
+  queue_push (&w->queues[cls], t);
+  pthread_mutex_unlock (&w->lock);
+
+  pthread_mutex_lock (&ex->lock);
+  ex->queued[cls]++;
+  if (ex->sleepers)
+  {
+    pthread_cond_signal (&ex->work);
+  }
+  pthread_mutex_unlock (&ex->lock);
+}
+
+void edgex_executor_wait (edgex_executor *ex)
+{
+  pthread_mutex_lock (&ex->lock);
+  while (!executor_idle (ex))
+  {
+    pthread_cond_wait (&ex->idle, &ex->lock);
+  }
+  pthread_mutex_unlock (&ex->lock);
+}
+
+/*
+ * Indices are claimed in turn by the caller and by the helper tasks. A
+ * helper which starts once every index is claimed only drops its reference,
+ * so the caller never waits on a task which cannot start.
+ */
+
+typedef struct exec_forall
+{
+  edgex_exec_forfn fn;
+  void *arg;
+  unsigned n;
+  unsigned next;
+  unsigned done;
+  unsigned refs;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} exec_forall;
+
+static void forall_unref (exec_forall *f)
+{
+  pthread_mutex_lock (&f->lock);
+  bool last = (--f->refs == 0);
+  pthread_mutex_unlock (&f->lock);
+  if (last)
+  {
+    pthread_cond_destroy (&f->cond);
+    pthread_mutex_destroy (&f->lock);
+    free (f);
+  }
+}
+
+static void forall_claim (exec_forall *f)
+{
+  unsigned i;
+  while ((i = __atomic_fetch_add (&f->next, 1, __ATOMIC_RELAXED)) < f->n)
+  {
+    f->fn (f->arg, i);
+    pthread_mutex_lock (&f->lock);
+    if (++f->done == f->n)
+    {
+      pthread_cond_signal (&f->cond);
+    }
+    pthread_mutex_unlock (&f->lock);
+  }
+}
+
+static void forall_task (void *arg)
+{
+  forall_claim ((exec_forall *) arg);
+  forall_unref ((exec_forall *) arg);
+}
+
+void edgex_executor_forall
+(
+  edgex_executor *ex,
+  edgex_exec_class cls,
+  unsigned n,
+  unsigned width,
+  edgex_exec_forfn fn,
+  void *arg
+)
+{
+  exec_forall *f;
+
+  if (n == 0)
+  {
+    return;
+  }
+  f = calloc (1, sizeof (exec_forall));
+  f->fn = fn;
+  f->arg = arg;
+  f->n = n;
+  f->refs = 1;
+  pthread_mutex_init (&f->lock, NULL);
+  pthread_cond_init (&f->cond, NULL);
+
+  if (width > n)
+  {
+    width = n;
+  }
+  for (unsigned i = 1; i < width; i++)
+  {
+    pthread_mutex_lock (&f->lock);
+    f->refs++;
+    pthread_mutex_unlock (&f->lock);
+    edgex_executor_submit (ex, cls, forall_task, f);
+  }
+  forall_claim (f);
+  pthread_mutex_lock (&f->lock);
+  while (f->done < f->n)
+  {
+    pthread_cond_wait (&f->cond, &f->lock);
+  }
+  pthread_mutex_unlock (&f->lock);
+  forall_unref (f);
+}
+
+void edgex_executor_metrics (edgex_executor *ex, JSON_Object *obj)
+{
+  unsigned queued = 0;
+  unsigned running = 0;
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *eobj = json_value_get_object (val);
+
+  pthread_mutex_lock (&ex->lock);
+  for (unsigned c = 0; c < EDGEX_EXEC_NCLASSES; c++)
+  {
+    queued += ex->queued[c];
+    running += ex->running[c];
+  }
+  pthread_mutex_unlock (&ex->lock);
+  json_object_set_number (eobj, "Threads", ex->nworkers);
+  json_object_set_number (eobj, "Queued", queued);
+  json_object_set_number (eobj, "Running", running);
+  json_object_set_value (obj, "Executor", val);
+}
+
+void edgex_executor_free (edgex_executor *ex)
+{
+  if (ex == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&ex->lock);
+  ex->stop = true;
+  pthread_cond_broadcast (&ex->work);
+  pthread_mutex_unlock (&ex->lock);
+  for (unsigned i = 0; i < ex->nworkers; i++)
+  {
+    pthread_join (ex->workers[i].thread, NULL);
+  }
+  for (unsigned i = 0; i < ex->nworkers; i++)
+  {
+    exec_worker *w = &ex->workers[i];
+    for (unsigned c = 0; c < EDGEX_EXEC_NCLASSES; c++)
+    {
+      free (w->queues[c].tasks);
+    }
+    pthread_mutex_destroy (&w->lock);
+  }
+  free (ex->workers);
+  pthread_cond_destroy (&ex->idle);
+  pthread_cond_destroy (&ex->work);
+  pthread_mutex_destroy (&ex->lock);
+  free (ex);
+}
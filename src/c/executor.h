@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_EXECUTOR_H_
+#define _EDGEX_DEVICE_EXECUTOR_H_ 1
+
+#include "parson.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A pool of worker threads for the service's background tasks. Tasks are
+ * submitted in a class; workers take the highest-priority class available,
+ * and the number of workers which may run tasks of each class at once can be
+ * limited so that slow work of one kind cannot occupy the whole pool. Each
+ * worker has a queue per class, and takes tasks from the other workers'
+ * queues once its own are empty.
+ */
+
+typedef enum
+{
+  EDGEX_EXEC_COMMAND = 0,
+  EDGEX_EXEC_DISCOVERY = 1
+} edgex_exec_class;
+
+#define EDGEX_EXEC_NCLASSES 2
+
+typedef struct edgex_executor edgex_executor;
+
+typedef void (*edgex_exec_fn) (void *arg);
+
+/*
+ * Create an executor. limits gives the maximum number of workers running
+ * tasks of each class, where 0 (or a NULL array) means no limit. If cpus is
+ * non-NULL, worker i is bound to CPU cpus[i % ncpus].
+ */
+
+extern edgex_executor *edgex_executor_create
+(
+  unsigned nthreads,
+  const unsigned *limits,
+  const int *cpus,
+  unsigned ncpus
+);
+
+/* Queue a task. Tasks submitted by a worker go to that worker's own queue */
+
+extern void edgex_executor_submit
+  (edgex_executor *ex, edgex_exec_class cls, edgex_exec_fn fn, void *arg);
+
+/* Wait until all queued tasks have run */
+
+extern void edgex_executor_wait (edgex_executor *ex);
+
+typedef void (*edgex_exec_forfn) (void *arg, unsigned index);
+
+/*
+ * Call fn for each index below n, on up to width threads at once, and return
+ * when every call has finished. The calling thread makes calls itself and the
+ * rest are made by tasks of the given class, so this may be used from within
+ * a task.
+ */
+
+extern void edgex_executor_forall
+(
+  edgex_executor *ex,
+  edgex_exec_class cls,
+  unsigned n,
+  unsigned width,
+  edgex_exec_forfn fn,
+  void *arg
+);
+
+/* Add the numbers of threads, and of queued and running tasks, to metrics */
+
+extern void edgex_executor_metrics (edgex_executor *ex, JSON_Object *obj);
+
+/* Run any queued tasks, then stop and free the executor */
+
+extern void edgex_executor_free (edgex_executor *ex);
+
+#endif
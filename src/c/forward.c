@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "forward.h"
+#include "service.h"
+#include "wal.h"
+#include "endpoints.h"
+#include "errorlist.h"
+#include "edgex_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+
+#define DEFAULT_LIMIT 64
+#define SEGMENT_SIZE (4 * 1024 * 1024)
+#define MIN_SEGMENTS 4
+#define UNLIMITED_BATCH 64
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+
+/* How often to look for events to forward, when last there were none */
+
+#define FORWARD_RETRY NS_PER_SEC
+
+/*
+ * Events are forwarded in batches, one every tick. Without a rate limit,
+ * batches follow each other at once while all are accepted.
+ */
+
+struct edgex_forward
+{
+  edgex_device_service *svc;
+  edgex_wal *wal;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool running;
+  uint32_t batch;
+  uint64_t tick;
+  uint64_t stored;
+  uint64_t forwarded;
+  uint64_t rejected;
+  uint64_t failures;
+};
+
+/*
+ * A stored event rejected by core-data is discarded rather than retried, as
+ * it would block those behind it.
+ */
+
+static bool forward_post
+  (void *arg, uint32_t tag, const void *data, size_t len)
+{
+  edgex_forward *f = (edgex_forward *) arg;
+  edgex_error err = EDGEX_OK;
+  edgex_data_client_add_event
+  (
+    f->svc->logger, &f->svc->config.endpoints, (const char *) data, len,
+    (edgex_event_encoding) tag, &err
+  );
+  if (err.code == EDGEX_EVENT_REJECTED.code)
+  {
+    iot_log_error
+      (f->svc->logger, "Discarding stored event rejected by core-data");
+  }
+  else if (err.code)
+  {
+    return false;
+  }
+  pthread_mutex_lock (&f->lock);
+  if (err.code)
+  {
+    f->rejected++;
+  }
+  else
+  {
+    f->forwarded++;
+  }
+  pthread_mutex_unlock (&f->lock);
+  return true;
+}
+
+static void *forward_thread (void *p)
+{
+  edgex_forward *f = (edgex_forward *) p;
+  edgex_device_service_endpoint *data = &f->svc->config.endpoints.data;
+  edgex_wal_stats stats;
+
+  pthread_mutex_lock (&f->lock);
+  while (f->running)
+  {
+    pthread_mutex_unlock (&f->lock);
+    unsigned max = f->batch ? f->batch : UNLIMITED_BATCH;
+    unsigned n = 0;
+    edgex_wal_getstats (f->wal, &stats);
+    if (stats.records && edgex_endpoint_available (data))
+    {
+      n = edgex_wal_replay (f->wal, max, forward_post, f);
+    }
+    pthread_mutex_lock (&f->lock);
+    if (n == max && f->batch == 0)
+    {
+      continue;
+    }
+    if (f->running)
+    {
+      uint64_t t =
+        edgex_device_monotime () + ((n == max) ? f->tick : FORWARD_RETRY);
+      struct timespec ts;
+      ts.tv_sec = t / NS_PER_SEC;
+      ts.tv_nsec = t % NS_PER_SEC;
+      pthread_cond_timedwait (&f->cond, &f->lock, &ts);
+    }
+  }
+  pthread_mutex_unlock (&f->lock);
+  return NULL;
+}
+
+edgex_forward *edgex_forward_create
+  (edgex_device_service *svc, edgex_error *err)
+{
+  const edgex_device_deviceinfo *conf = &svc->config.device;
+  pthread_condattr_t attr;
+  edgex_wal_stats stats;
+
+  *err = EDGEX_OK;
+  if (conf->eventlogdir == NULL || *conf->eventlogdir == '\0')
+  {
+    return NULL;
+  }
+  uint64_t limit = conf->eventloglimit ? conf->eventloglimit : DEFAULT_LIMIT;
+  limit *= 1024 * 1024;
+  size_t segsize = SEGMENT_SIZE;
+  if (segsize > limit / MIN_SEGMENTS)
+  {
+    segsize = limit / MIN_SEGMENTS;
+  }
+  edgex_wal *wal = edgex_wal_open (conf->eventlogdir, segsize, limit);
+  if (wal == NULL)
+  {
+    iot_log_error
+      (svc->logger, "Unable to open event log in %s", conf->eventlogdir);
+    *err = EDGEX_EVENTLOG_OPEN;
+    return NULL;
+  }
+  edgex_wal_getstats (wal, &stats);
+  if (stats.records)
+  {
+    iot_log_info
+    (
+      svc->logger, "Forwarding %" PRIu64 " stored events from %s",
+      stats.records, conf->eventlogdir
+    );
+  }
+
+  edgex_forward *f = calloc (1, sizeof (edgex_forward));
+  f->svc = svc;
+  f->wal = wal;
+  f->running = true;
+  if (conf->eventlograte)
+  {
+    f->batch = conf->eventlograte > 10 ? conf->eventlograte / 10 : 1;
+    f->tick = NS_PER_SEC * f->batch / conf->eventlograte;
+  }
+  pthread_mutex_init (&f->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&f->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  if (pthread_create (&f->thread, NULL, forward_thread, f) != 0)
+  {
+    iot_log_error (svc->logger, "Unable to start event forwarding thread");
+    pthread_cond_destroy (&f->cond);
+    pthread_mutex_destroy (&f->lock);
+    edgex_wal_close (wal);
+    free (f);
+    *err = EDGEX_EVENTLOG_OPEN;
+    return NULL;
+  }
+  return f;
+}
+
+bool edgex_forward_store
+(
+  edgex_forward *f,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding
+)
+{
+  if (f == NULL)
+  {
+    return false;
+  }
+  bool ok = edgex_wal_append (f->wal, encoding, event, size);
+  __atomic_add_fetch (ok ? &f->stored : &f->failures, 1, __ATOMIC_RELAXED);
+  return ok;
+}
+
+void edgex_forward_metrics (edgex_forward *f, JSON_Object *obj)
+{
+  JSON_Value *lval = json_value_init_object ();
+  JSON_Object *lobj = json_value_get_object (lval);
+  edgex_wal_stats stats;
+
+  edgex_wal_getstats (f->wal, &stats);
+  json_object_set_number (lobj, "Records", stats.records);
+  json_object_set_number (lobj, "Bytes", stats.bytes);
+  json_object_set_number (lobj, "Syncs", stats.syncs);
+  json_object_set_number (lobj, "Evicted", stats.evicted);
+  json_object_set_number
+    (lobj, "Stored", __atomic_load_n (&f->stored, __ATOMIC_RELAXED));
+  json_object_set_number
+    (lobj, "StoreFailures", __atomic_load_n (&f->failures, __ATOMIC_RELAXED));
+  pthread_mutex_lock (&f->lock);
+  json_object_set_number (lobj, "Forwarded", f->forwarded);
+  json_object_set_number (lobj, "Rejected", f->rejected);
+  pthread_mutex_unlock (&f->lock);
+  json_object_set_value (obj, "EventLog", lval);
+}
+
+void edgex_forward_free (edgex_forward *f)
+{
+  if (f)
+  {
+    pthread_mutex_lock (&f->lock);
+    f->running = false;
+    pthread_cond_signal (&f->cond);
+    pthread_mutex_unlock (&f->lock);
+    pthread_join (f->thread, NULL);
+    pthread_cond_destroy (&f->cond);
+    pthread_mutex_destroy (&f->lock);
+    edgex_wal_close (f->wal);
+    free (f);
+  }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_FORWARD_H_
+#define _EDGEX_DEVICE_FORWARD_H_ 1
+
+#include "edgex/devsdk.h"
+#include "data.h"
+#include "parson.h"
+
+/*
+ * Store and forward. Given Device/EventLogDir, events which could not be
+ * submitted to core-data are kept in a write-ahead log (see wal.h), from
+ * which a background thread submits them, oldest first and at no more than
+ * Device/EventLogRate events per second, once core-data can be reached.
+ */
+
+typedef struct edgex_forward edgex_forward;
+
+/*
+ * Open the log and start forwarding. Returns NULL with err EDGEX_OK if no
+ * log is configured, and with an error if it cannot be opened.
+ */
+
+edgex_forward *edgex_forward_create
+  (edgex_device_service *svc, edgex_error *err);
+
+/*
+ * Keep an encoded event for later submission. Returns true once it is on
+ * disk; false if there is no log (f is NULL), or the event is too big for a
+ * segment or could not be written.
+ */
+
+bool edgex_forward_store
+(
+  edgex_forward *f,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding
+);
+
+/* Add statistics for the log to a metrics object. */
+
+void edgex_forward_metrics (edgex_forward *f, JSON_Object *obj);
+
+/* Stop forwarding and close the log. Events not yet forwarded are kept. */
+
+void edgex_forward_free (edgex_forward *f);
+
+#endif
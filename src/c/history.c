@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "history.h"
+#include "map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define HIST_KEYSEP '\x1f'
+
+/*
+ * A slot's value buffer is kept when the slot is reused, and only grown if
+ * a longer reading arrives, so that a steady stream of readings of similar
+ * size does not allocate.
+ */
+
+typedef struct hist_slot
+{
+  uint64_t origin;
+  uint64_t seq;
+  char *value;
+  size_t cap;
+} hist_slot;
+
+typedef struct hist_ring
+{
+  char *resource;
+  uint32_t next;
+  uint32_t count;
+  hist_slot slots[];
+} hist_ring;
+
+struct edgex_history
+{
+  pthread_mutex_t lock;
+  uint32_t size;
+  uint64_t seq;
+  edgex_map_void rings;
+};
+
+edgex_history *edgex_history_create (uint32_t size)
+{
+  edgex_history *h = calloc (1, sizeof (edgex_history));
+  pthread_mutex_init (&h->lock, NULL);
+  h->size = size;
+  edgex_map_init (&h->rings);
+  return h;
+}
+
+/* Form the key of a resource in buf if it fits, otherwise allocate it */
+
+static char *hist_key
+  (const char *device, const char *resource, char *buf, size_t bufsize)
+{
+  size_t dlen = strlen (device);
+  size_t klen = dlen + strlen (resource) + 2;
+  char *key = (klen <= bufsize) ? buf : malloc (klen);
+  memcpy (key, device, dlen);
+  key[dlen] = HIST_KEYSEP;
+  strcpy (key + dlen + 1, resource);
+  return key;
+}
+
+void edgex_history_add
+(
+  edgex_history *h,
+  const char *device,
+  const char *resource,
+  const char *reading,
+  uint64_t origin
+)
+{
+  char kbuf[256];
+  char *key = hist_key (device, resource, kbuf, sizeof (kbuf));
+  size_t len = strlen (reading) + 1;
+
+  pthread_mutex_lock (&h->lock);
+  void **rp = edgex_map_get (&h->rings, key);
+  hist_ring *r = rp ? *rp : NULL;
+  if (r == NULL)
+  {
+    r = calloc (1, sizeof (hist_ring) + h->size * sizeof (hist_slot));
+    r->resource = strdup (resource);
+    edgex_map_set (&h->rings, key, r);
+  }
+  hist_slot *s = &r->slots[r->next];
+  if (s->cap < len)
+  {
+    free (s->value);
+    s->value = malloc (len);
+    s->cap = len;
+  }
+  memcpy (s->value, reading, len);
+  s->origin = origin;
+  s->seq = ++h->seq;
+  r->next = (r->next + 1) % h->size;
+  if (r->count < h->size)
+  {
+    r->count++;
+  }
+  pthread_mutex_unlock (&h->lock);
+
+  if (key != kbuf)
+  {
+    free (key);
+  }
+}
+
+static void hist_write
+  (edgex_strbuf *out, bool first, const char *name, const hist_slot *s)
+{
+  if (!first)
+  {
+    edgex_strbuf_appendchar (out, ',');
+  }
+  edgex_strbuf_appendstr (out, "{\"name\":");
+  edgex_strbuf_appendjson (out, name);
+  edgex_strbuf_appendstr (out, ",\"value\":");
+  edgex_strbuf_appendjson (out, s->value);
+  edgex_strbuf_appendstr (out, ",\"origin\":");
+  edgex_strbuf_appenduint (out, s->origin);
+  edgex_strbuf_appendchar (out, '}');
+}
+
+uint32_t edgex_history_query
+(
+  edgex_history *h,
+  const char *device,
+  const char *resource,
+  uint64_t start,
+  uint64_t end,
+  uint32_t limit,
+  edgex_strbuf *out,
+  bool first,
+  uint64_t *seq
+)
+{
+  char kbuf[256];
+  char *key = hist_key (device, resource, kbuf, sizeof (kbuf));
+  uint32_t n = 0;
+
+  pthread_mutex_lock (&h->lock);
+  void **rp = edgex_map_get (&h->rings, key);
+  hist_ring *r = rp ? *rp : NULL;
+  if (r && r->count)
+  {
+    /* Walk back from the newest reading to find the oldest to be written,
+     * then write forwards from it. Origins need not be in order, so every
+     * reading in the ring is considered.
+     */
+
+    uint32_t last = (r->next + h->size - 1) % h->size;
+    uint32_t back = 0;
+    if (r->slots[last].seq > *seq)
+    {
+      *seq = r->slots[last].seq;
+    }
+    for (; back < r->count && n < limit; back++)
+    {
+      const hist_slot *s = &r->slots[(last + h->size - back) % h->size];
+      if (s->origin >= start && s->origin <= end)
+      {
+        n++;
+      }
+    }
+    while (out && back--)
+    {
+      const hist_slot *s = &r->slots[(last + h->size - back) % h->size];
+      if (s->origin >= start && s->origin <= end)
+      {
+        hist_write (out, first, r->resource, s);
+        first = false;
+      }
+    }
+  }
+  pthread_mutex_unlock (&h->lock);
+
+  if (key != kbuf)
+  {
+    free (key);
+  }
+  return n;
+}
+
+static void hist_ring_free (edgex_history *h, hist_ring *r)
+{
+  for (uint32_t i = 0; i < h->size; i++)
+  {
+    free (r->slots[i].value);
+  }
+  free (r->resource);
+  free (r);
+}
+
+void edgex_history_forget (edgex_history *h, const char *device)
+{
+  const char *key;
+  size_t dlen = strlen (device);
+  unsigned n = 0;
+
+  if (h == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&h->lock);
+  char **keys = malloc ((edgex_map_count (&h->rings) + 1) * sizeof (char *));
+  edgex_map_iter i = edgex_map_iter (&h->rings);
+  while ((key = edgex_map_next (&h->rings, &i)))
+  {
+    if (strncmp (key, device, dlen) == 0 && key[dlen] == HIST_KEYSEP)
+    {
+      keys[n++] = strdup (key);
+    }
+  }
+  while (n--)
+  {
+    hist_ring_free (h, *edgex_map_get (&h->rings, keys[n]));
+    edgex_map_remove (&h->rings, keys[n]);
+    free (keys[n]);
+  }
+  pthread_mutex_unlock (&h->lock);
+  free (keys);
+}
+
+void edgex_history_free (edgex_history *h)
+{
+  if (h)
+  {
+    const char *key;
+    edgex_map_iter i = edgex_map_iter (&h->rings);
+    while ((key = edgex_map_next (&h->rings, &i)))
+    {
+      hist_ring_free (h, *edgex_map_get (&h->rings, key));
+    }
+    edgex_map_deinit (&h->rings);
+    pthread_mutex_destroy (&h->lock);
+    free (h);
+  }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_HISTORY_H_
+#define _EDGEX_DEVICE_HISTORY_H_ 1
+
+#include "strbuf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Recent readings of each device resource, kept in a fixed-size ring so that
+ * they can be returned without reading the device again. Every reading is
+ * given a sequence number, increasing across the whole history, so that a
+ * change to a set of resources' readings can be detected cheaply.
+ */
+
+typedef struct edgex_history edgex_history;
+
+/* The largest number of readings kept per resource */
+
+#define EDGEX_HISTORY_MAXSIZE 65536
+
+/* Create a history keeping the last size readings of each resource */
+
+extern edgex_history *edgex_history_create (uint32_t size);
+
+/* Record a reading, replacing the oldest if the resource's ring is full */
+
+extern void edgex_history_add
+(
+  edgex_history *h,
+  const char *device,
+  const char *resource,
+  const char *reading,
+  uint64_t origin
+);
+
+/*
+ * Append to out the most recent readings of a resource whose origin lies
+ * between start and end inclusive, at most limit of them, oldest first. They
+ * are written as the readings of an event, preceded by a comma unless first
+ * is set. If out is NULL, nothing is written. Returns the number of readings
+ * found, and sets *seq to the sequence number of the latest reading of the
+ * resource if that is greater than its existing value.
+ */
+
+extern uint32_t edgex_history_query
+(
+  edgex_history *h,
+  const char *device,
+  const char *resource,
+  uint64_t start,
+  uint64_t end,
+  uint32_t limit,
+  edgex_strbuf *out,
+  bool first,
+  uint64_t *seq
+);
+
+/* Discard the readings of a device */
+
+extern void edgex_history_forget (edgex_history *h, const char *device);
+
+extern void edgex_history_free (edgex_history *h);
+
+#endif
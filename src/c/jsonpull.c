@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "jsonpull.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The state says what may come next in the current container: any item or
+ * its end (START), an item after a comma (COMMA), the value for a key just
+ * read (KEY), or a comma or the end after an item (DONE). At depth zero,
+ * DONE means that the top-level value has been read. Bit n of objects is set
+ * if the container at depth n + 1 is an object.
+ */
+
+#define ST_START 0
+#define ST_COMMA 1
+#define ST_KEY 2
+#define ST_DONE 3
+
+#define IN_OBJECT(r) ((r)->depth && ((r)->objects >> ((r)->depth - 1)) & 1)
+
+void edgex_jsonpull_init (edgex_jsonpull *r, const char *json, size_t len)
+{
+  memset (r, 0, sizeof (edgex_jsonpull));
+  r->p = json;
+  r->end = json + len;
+  r->state = ST_START;
+}
+
+static void skip_ws (edgex_jsonpull *r)
+{
+  while
+  (
+    r->p < r->end &&
+    (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r')
+  )
+  {
+    r->p++;
+  }
+}
+
+static int hexval (char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+static bool read_string (edgex_jsonpull *r)
+{
+  const char *p = r->p + 1;
+
+  r->tok = p;
+  r->escaped = false;
+  while (p < r->end && *p != '"')
+  {
+    if (*p == '\\')
+    {
+      r->escaped = true;
+      if (++p == r->end)
+      {
+        return false;
+      }
+      if (*p == 'u')
+      {
+        for (int i = 0; i < 4; i++)
+        {
+          if (++p == r->end || hexval (*p) < 0)
+          {
+            return false;
+          }
+        }
+      }
+      else if (strchr ("\"\\/bfnrt", *p) == NULL || *p == '\0')
+      {
+        return false;
+      }
+    }
+    else if ((unsigned char) *p < 0x20)
+    {
+      return false;
+    }
+    p++;
+  }
+  if (p == r->end)
+  {
+    return false;
+  }
+  r->toklen = p - r->tok;
+  r->p = p + 1;
+  return true;
+}
+
+static const char *read_digits (const char *p, const char *end)
+{
+  const char *start = p;
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    p++;
+  }
+  return (p == start) ? NULL : p;
+}
+
+static bool read_number (edgex_jsonpull *r)
+{
+  const char *p = r->p;
+
+  if (*p == '-')
+  {
+    p++;
+  }
+  if (p < r->end && *p == '0')
+  {
+    p++;
+  }
+  else if ((p = read_digits (p, r->end)) == NULL)
+  {
+    return false;
+  }
+  if (p < r->end && *p == '.')
+  {
+    if ((p = read_digits (p + 1, r->end)) == NULL)
+    {
+      return false;
+    }
+  }
+  if (p < r->end && (*p == 'e' || *p == 'E'))
+  {
+    p++;
+    if (p < r->end && (*p == '+' || *p == '-'))
+    {
+      p++;
+    }
+    if ((p = read_digits (p, r->end)) == NULL)
+    {
+      return false;
+    }
+  }
+  r->tok = r->p;
+  r->toklen = p - r->p;
+  r->p = p;
+  return true;
+}
+
+static bool read_literal (edgex_jsonpull *r, const char *lit, size_t len)
+{
+  if ((size_t) (r->end - r->p) < len || memcmp (r->p, lit, len) != 0)
+  {
+    return false;
+  }
+  r->tok = r->p;
+  r->toklen = len;
+  r->p += len;
+  return true;
+}
+
+static edgex_json_token open_container (edgex_jsonpull *r, bool object)
+{
+  if (r->depth == EDGEX_JSONPULL_DEPTH)
+  {
+    return EDGEX_JSON_ERROR;
+  }
+  if (object)
+  {
+    r->objects |= (1ULL << r->depth);
+  }
+  else
+  {
+    r->objects &= ~(1ULL << r->depth);
+  }
+  r->depth++;
+  r->tok = r->p++;
+  r->toklen = 1;
+  r->state = ST_START;
+  return object ? EDGEX_JSON_OBJECT : EDGEX_JSON_ARRAY;
+}
+
+static edgex_json_token close_container (edgex_jsonpull *r)
+{
+  bool object = IN_OBJECT (r);
+  r->depth--;
+  r->tok = r->p++;
+  r->toklen = 1;
+  r->state = ST_DONE;
+  return object ? EDGEX_JSON_OBJECT_END : EDGEX_JSON_ARRAY_END;
+}
+
+edgex_json_token edgex_jsonpull_next (edgex_jsonpull *r)
+{
+  bool object = IN_OBJECT (r);
+  edgex_json_token result;
+
+  skip_ws (r);
+  if (r->state == ST_DONE)
+  {
+    if (r->depth == 0)
+    {
+      return (r->p == r->end || *r->p == '\0') ?
+        EDGEX_JSON_END : EDGEX_JSON_ERROR;
+    }
+    if (r->p < r->end && *r->p == (object ? '}' : ']'))
+    {
+      return close_container (r);
+    }
+    if (r->p == r->end || *r->p != ',')
+    {
+      return EDGEX_JSON_ERROR;
+    }
+    r->p++;
+    r->state = ST_COMMA;
+    skip_ws (r);
+  }
+  if (r->p == r->end)
+  {
+    return EDGEX_JSON_ERROR;
+  }
+
+  if (object && r->state != ST_KEY)
+  {
+    if (*r->p == '}' && r->state == ST_START)
+    {
+      return close_container (r);
+    }
+    if (*r->p != '"' || !read_string (r))
+    {
+      return EDGEX_JSON_ERROR;
+    }
+    skip_ws (r);
+    if (r->p == r->end || *r->p != ':')
+    {
+      return EDGEX_JSON_ERROR;
+    }
+    r->p++;
+    r->state = ST_KEY;
+    return EDGEX_JSON_KEY;
+  }
+
+  switch (*r->p)
+  {
+    case '{':
+      return open_container (r, true);
+    case '[':
+      return open_container (r, false);
+    case ']':
+      return (r->depth && r->state == ST_START) ?
+        close_container (r) : EDGEX_JSON_ERROR;
+    case '"':
+      result = read_string (r) ? EDGEX_JSON_STRING : EDGEX_JSON_ERROR;
+      break;
+    case 't':
+      result = read_literal (r, "true", 4) ? EDGEX_JSON_TRUE : EDGEX_JSON_ERROR;
+      break;
+    case 'f':
+      result =
+        read_literal (r, "false", 5) ? EDGEX_JSON_FALSE : EDGEX_JSON_ERROR;
+      break;
+    case 'n':
+      result = read_literal (r, "null", 4) ? EDGEX_JSON_NULL : EDGEX_JSON_ERROR;
+      break;
+    default:
+      result = read_number (r) ? EDGEX_JSON_NUMBER : EDGEX_JSON_ERROR;
+      break;
+  }
+  if (result != EDGEX_JSON_ERROR)
+  {
+    r->state = ST_DONE;
+  }
+  return result;
+}
+
+bool edgex_jsonpull_skip (edgex_jsonpull *r, edgex_json_token t)
+{
+  if (t == EDGEX_JSON_OBJECT || t == EDGEX_JSON_ARRAY)
+  {
+    const char *start = r->tok;
+    unsigned depth = r->depth - 1;
+    do
+    {
+      t = edgex_jsonpull_next (r);
+      if (t == EDGEX_JSON_ERROR || t == EDGEX_JSON_END)
+      {
+        return false;
+      }
+    } while (r->depth > depth);
+    r->tok = start;
+    r->toklen = r->p - start;
+    return true;
+  }
+  return
+    t == EDGEX_JSON_STRING || t == EDGEX_JSON_NUMBER || t == EDGEX_JSON_TRUE ||
+    t == EDGEX_JSON_FALSE || t == EDGEX_JSON_NULL;
+}
+
+static char *put_utf8 (char *out, uint32_t c)
+{
+  if (c < 0x80)
+  {
+    *out++ = c;
+  }
+  else if (c < 0x800)
+  {
+    *out++ = 0xc0 | (c >> 6);
+    *out++ = 0x80 | (c & 0x3f);
+  }
+  else if (c < 0x10000)
+  {
+    *out++ = 0xe0 | (c >> 12);
+    *out++ = 0x80 | ((c >> 6) & 0x3f);
+    *out++ = 0x80 | (c & 0x3f);
+  }
+  else
+  {
+    *out++ = 0xf0 | (c >> 18);
+    *out++ = 0x80 | ((c >> 12) & 0x3f);
+    *out++ = 0x80 | ((c >> 6) & 0x3f);
+    *out++ = 0x80 | (c & 0x3f);
+  }
+  return out;
+}
+
+static uint32_t get_hex4 (const char *p)
+{
+  return (hexval (p[0]) << 12) | (hexval (p[1]) << 8) |
+    (hexval (p[2]) << 4) | hexval (p[3]);
+}
+
+size_t edgex_jsonpull_decode (const edgex_jsonpull *r, char *buf)
+{
+  const char *p = r->tok;
+  const char *end = r->tok + r->toklen;
+  char *out = buf;
+
+  if (!r->escaped)
+  {
+    memcpy (buf, p, r->toklen);
+    buf[r->toklen] = '\0';
+    return r->toklen;
+  }
+  while (p < end)
+  {
+    if (*p != '\\')
+    {
+      *out++ = *p++;
+      continue;
+    }
+    p++;
+    switch (*p++)
+    {
+      case 'b':
+        *out++ = '\b';
+        break;
+      case 'f':
+        *out++ = '\f';
+        break;
+      case 'n':
+        *out++ = '\n';
+        break;
+      case 'r':
+        *out++ = '\r';
+        break;
+      case 't':
+        *out++ = '\t';
+        break;
+      case 'u':
+      {
+        uint32_t c = get_hex4 (p);
+        p += 4;
+        if (c >= 0xd800 && c < 0xdc00)
+        {
+          /* A high surrogate, which should be followed by a low one */
+
+          uint32_t lo = 0;
+          if (end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+          {
+            lo = get_hex4 (p + 2);
+          }
+          if (lo >= 0xdc00 && lo < 0xe000)
+          {
+            c = 0x10000 + ((c - 0xd800) << 10) + (lo - 0xdc00);
+            p += 6;
+          }
+          else
+          {
+            c = 0xfffd;
+          }
+        }
+        else if (c >= 0xdc00 && c < 0xe000)
+        {
+          c = 0xfffd;
+        }
+        out = put_utf8 (out, c);
+        break;
+      }
+      default:
+        *out++ = p[-1];
+        break;
+    }
+  }
+  *out = '\0';
+  return out - buf;
+}
+
+char *edgex_jsonpull_strdup (const edgex_jsonpull *r)
+{
+  char *result = malloc (r->toklen + 1);
+  edgex_jsonpull_decode (r, result);
+  return result;
+}
+
+bool edgex_jsonpull_is (const edgex_jsonpull *r, const char *s)
+{
+  if (r->escaped)
+  {
+    char buf[64];
+    return
+      r->toklen < sizeof (buf) &&
+      edgex_jsonpull_decode (r, buf) == strlen (s) &&
+      strcmp (buf, s) == 0;
+  }
+  return strncmp (r->tok, s, r->toklen) == 0 && s[r->toklen] == '\0';
+}
+
+double edgex_jsonpull_number (const edgex_jsonpull *r)
+{
+  char buf[64];
+  size_t len = (r->toklen < sizeof (buf)) ? r->toklen : sizeof (buf) - 1;
+  memcpy (buf, r->tok, len);
+  buf[len] = '\0';
+  return strtod (buf, NULL);
+}
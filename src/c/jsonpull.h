@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_JSONPULL_H_
+#define _EDGEX_DEVICE_JSONPULL_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A pull reader for JSON text. Tokens are returned one at a time from the
+ * caller's buffer, without building a document: strings and numbers are
+ * left in place and only decoded if the caller asks for them, and a value of
+ * no interest may be skipped as a whole.
+ */
+
+typedef enum
+{
+  EDGEX_JSON_END,
+  EDGEX_JSON_ERROR,
+  EDGEX_JSON_OBJECT,
+  EDGEX_JSON_OBJECT_END,
+  EDGEX_JSON_ARRAY,
+  EDGEX_JSON_ARRAY_END,
+  EDGEX_JSON_KEY,
+  EDGEX_JSON_STRING,
+  EDGEX_JSON_NUMBER,
+  EDGEX_JSON_TRUE,
+  EDGEX_JSON_FALSE,
+  EDGEX_JSON_NULL
+} edgex_json_token;
+
+/* Maximum nesting of objects and arrays */
+
+#define EDGEX_JSONPULL_DEPTH 64
+
+typedef struct edgex_jsonpull
+{
+  const char *p;
+  const char *end;
+  const char *tok;
+  size_t toklen;
+  bool escaped;
+  unsigned state;
+  unsigned depth;
+  uint64_t objects;
+} edgex_jsonpull;
+
+extern void edgex_jsonpull_init
+  (edgex_jsonpull *r, const char *json, size_t len);
+
+/*
+ * Return the next token. For a key or string, tok and toklen give the text
+ * between the quotes (escaped is set if it contains escapes); for other
+ * tokens, tok is where the token starts. EDGEX_JSON_END is returned once the
+ * top-level value is complete, and EDGEX_JSON_ERROR on malformed input.
+ */
+
+extern edgex_json_token edgex_jsonpull_next (edgex_jsonpull *r);
+
+/*
+ * Skip the rest of the value starting with the token t, just returned. For
+ * an object or array, tok and toklen are then set to the whole of its text.
+ */
+
+extern bool edgex_jsonpull_skip (edgex_jsonpull *r, edgex_json_token t);
+
+/*
+ * Decode the current key or string into buf, which must hold toklen + 1
+ * bytes. Returns the length of the NUL-terminated result.
+ */
+
+extern size_t edgex_jsonpull_decode (const edgex_jsonpull *r, char *buf);
+
+/* As edgex_jsonpull_decode, into a new string */
+
+extern char *edgex_jsonpull_strdup (const edgex_jsonpull *r);
+
+/* Whether the current key or string equals s */
+
+extern bool edgex_jsonpull_is (const edgex_jsonpull *r, const char *s);
+
+/* The value of the current number */
+
+extern double edgex_jsonpull_number (const edgex_jsonpull *r);
+
+#endif
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "logqueue.h"
+#include "strbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define DEFAULT_QUEUE_SIZE 1024
+#define DEFAULT_MAX_BATCH 1
+#define FLUSH_INTERVAL_MS 100
+#define MIN_BACKOFF_MS 100
+#define MAX_BACKOFF_MS 5000
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+
+static const char *levelstrs[] = {"INFO", "TRACE", "DEBUG", "WARNING", "ERROR"};
+
+typedef struct logqueue_entry
+{
+  iot_loglevel level;
+  time_t timestamp;
+  char *subsystem;
+  char message[];
+} logqueue_entry;
+
+/*
+ * The ring is a bounded multi-producer queue. Each slot's sequence number
+ * shows whether it is free for the producer claiming position n (when it is
+ * n) or holds the entry for the consumer at position n (when it is n + 1).
+ */
+
+typedef struct logqueue_slot
+{
+  uint64_t seq;
+  logqueue_entry *entry;
+} logqueue_slot;
+
+struct edgex_logqueue
+{
+  edgex_logqueue_sendfn send;
+  void *ctx;
+  uint32_t mask;
+  uint32_t maxbatch;
+  uint32_t ratelimit;
+  logqueue_slot *slots;
+  uint64_t tail;
+  uint64_t head;
+  uint64_t window;
+  uint64_t inwindow;
+  uint64_t queued;
+  uint64_t sent;
+  uint64_t posts;
+  uint64_t dropped;
+  uint64_t limited;
+  uint64_t failed;
+  bool waiting;
+  bool stopping;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+};
+
+static uint64_t logqueue_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static void logqueue_count (uint64_t *counter, uint64_t n)
+{
+  __atomic_fetch_add (counter, n, __ATOMIC_RELAXED);
+}
+
+/* Take the entry at the head of the ring. Only the sending thread does this */
+
+static logqueue_entry *logqueue_take (edgex_logqueue *q)
+{
+  uint64_t head = q->head;
+  logqueue_slot *slot = &q->slots[head & q->mask];
+  if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != head + 1)
+  {
+    return NULL;
+  }
+  logqueue_entry *e = slot->entry;
+  __atomic_store_n (&slot->seq, head + q->mask + 1, __ATOMIC_RELEASE);
+  __atomic_store_n (&q->head, head + 1, __ATOMIC_RELAXED);
+  return e;
+}
+
+static void logqueue_format (edgex_strbuf *out, const logqueue_entry *e)
+{
+  edgex_strbuf_appendstr (out, "{\"originService\":");
+  edgex_strbuf_appendjson (out, e->subsystem);
+  edgex_strbuf_appendstr (out, ",\"logLevel\":");
+  edgex_strbuf_appendjson (out, levelstrs[e->level]);
+  edgex_strbuf_appendstr (out, ",\"created\":");
+  edgex_strbuf_appenduint (out, e->timestamp);
+  edgex_strbuf_appendstr (out, ",\"message\":");
+  edgex_strbuf_appendjson (out, e->message);
+  edgex_strbuf_appendchar (out, '}');
+}
+
+/* Wait for entries, a stop request or a timeout. Called with the lock held */
+
+static void logqueue_wait (edgex_logqueue *q, uint64_t ms)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_REALTIME, &ts);
+  uint64_t ns = ts.tv_nsec + ms * NS_PER_MS;
+  ts.tv_sec += ns / NS_PER_SEC;
+  ts.tv_nsec = ns % NS_PER_SEC;
+  pthread_cond_timedwait (&q->cond, &q->lock, &ts);
+}
+
+static void *logqueue_thread (void *p)
+{
+  edgex_logqueue *q = (edgex_logqueue *) p;
+  logqueue_entry **batch = malloc (q->maxbatch * sizeof (logqueue_entry *));
+  uint64_t backoff = 0;
+  edgex_strbuf buf;
+
+  edgex_strbuf_init (&buf);
+  while (true)
+  {
+    uint32_t n = 0;
+    logqueue_entry *e;
+    while (n < q->maxbatch && (e = logqueue_take (q)))
+    {
+      batch[n++] = e;
+    }
+
+    if (n)
+    {
+      buf.len = 0;
+      if (n > 1)
+      {
+        edgex_strbuf_appendchar (&buf, '[');
+      }
+      for (uint32_t i = 0; i < n; i++)
+      {
+        if (i)
+        {
+          edgex_strbuf_appendchar (&buf, ',');
+        }
+        logqueue_format (&buf, batch[i]);
+        free (batch[i]);
+      }
+      if (n > 1)
+      {
+        edgex_strbuf_appendchar (&buf, ']');
+      }
+
+      /* Entries of a failed request are discarded. Back off before the next */
+
+      logqueue_count (&q->posts, 1);
+      if (q->send (q->ctx, buf.data))
+      {
+        logqueue_count (&q->sent, n);
+        backoff = 0;
+        continue;
+      }
+      logqueue_count (&q->failed, n);
+      backoff = backoff ? backoff * 2 : MIN_BACKOFF_MS;
+      if (backoff > MAX_BACKOFF_MS)
+      {
+        backoff = MAX_BACKOFF_MS;
+      }
+      pthread_mutex_lock (&q->lock);
+      if (q->stopping)
+      {
+        pthread_mutex_unlock (&q->lock);
+        break;
+      }
+      logqueue_wait (q, backoff);
+      pthread_mutex_unlock (&q->lock);
+      continue;
+    }
+
+    /*
+     * Nothing is queued. A producer that misses the waiting flag leaves its
+     * entry for the next poll, so the wait is bounded.
+     */
+
+    pthread_mutex_lock (&q->lock);
+    if (q->stopping)
+    {
+      pthread_mutex_unlock (&q->lock);
+      break;
+    }
+    __atomic_store_n (&q->waiting, true, __ATOMIC_SEQ_CST);
+    uint64_t head = q->head;
+    if (__atomic_load_n (&q->slots[head & q->mask].seq, __ATOMIC_SEQ_CST) != head + 1)
+    {
+      logqueue_wait (q, FLUSH_INTERVAL_MS);
+    }
+    __atomic_store_n (&q->waiting, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock (&q->lock);
+  }
+  edgex_strbuf_fini (&buf);
+  free (batch);
+  return NULL;
+}
+
+edgex_logqueue *edgex_logqueue_create
+(
+  edgex_logqueue_sendfn send,
+  void *ctx,
+  uint32_t size,
+  uint32_t maxbatch,
+  uint32_t ratelimit
+)
+{
+  uint32_t cap = 1;
+  edgex_logqueue *q = calloc (1, sizeof (edgex_logqueue));
+
+  if (size == 0)
+  {
+    size = DEFAULT_QUEUE_SIZE;
+  }
+  while (cap < size)
+  {
+    cap <<= 1;
+  }
+  q->send = send;
+  q->ctx = ctx;
+  q->mask = cap - 1;
+  q->maxbatch = maxbatch ? maxbatch : DEFAULT_MAX_BATCH;
+  q->ratelimit = ratelimit;
+  q->slots = calloc (cap, sizeof (logqueue_slot));
+  for (uint32_t i = 0; i < cap; i++)
+  {
+    q->slots[i].seq = i;
+  }
+  pthread_mutex_init (&q->lock, NULL);
+  pthread_cond_init (&q->cond, NULL);
+  if (pthread_create (&q->thread, NULL, logqueue_thread, q) != 0)
+  {
+    pthread_cond_destroy (&q->cond);
+    pthread_mutex_destroy (&q->lock);
+    free (q->slots);
+    free (q);
+    return NULL;
+  }
+  return q;
+}
+
+/* Count an entry against the limit for the current second */
+
+static bool logqueue_admit (edgex_logqueue *q)
+{
+  uint64_t now = logqueue_now () / NS_PER_SEC;
+  uint64_t window = __atomic_load_n (&q->window, __ATOMIC_RELAXED);
+  if
+  (
+    window != now && __atomic_compare_exchange_n
+      (&q->window, &window, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+  )
+  {
+    __atomic_store_n (&q->inwindow, 0, __ATOMIC_RELAXED);
+  }
+  return __atomic_fetch_add (&q->inwindow, 1, __ATOMIC_RELAXED) < q->ratelimit;
+}
+
+bool edgex_logqueue_add
+(
+  edgex_logqueue *q,
+  const char *subsystem,
+  iot_loglevel l,
+  time_t timestamp,
+  const char *message
+)
+{
+  if (q->ratelimit && !logqueue_admit (q))
+  {
+    logqueue_count (&q->limited, 1);
+    return false;
+  }
+
+  size_t mlen = strlen (message) + 1;
+  size_t slen = strlen (subsystem ? subsystem : "") + 1;
+  logqueue_entry *e = malloc (sizeof (logqueue_entry) + mlen + slen);
+  e->level = l;
+  e->timestamp = timestamp;
+  memcpy (e->message, message, mlen);
+  e->subsystem = e->message + mlen;
+  memcpy (e->subsystem, subsystem ? subsystem : "", slen);
+
+  uint64_t pos = __atomic_load_n (&q->tail, __ATOMIC_RELAXED);
+  logqueue_slot *slot;
+  while (true)
+  {
+    slot = &q->slots[pos & q->mask];
+    uint64_t seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+    int64_t diff = (int64_t) (seq - pos);
+    if (diff == 0)
+    {
+      if
+      (
+        __atomic_compare_exchange_n
+          (&q->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+      )
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      free (e);
+      logqueue_count (&q->dropped, 1);
+      return false;
+    }
+    else
+    {
+      pos = __atomic_load_n (&q->tail, __ATOMIC_RELAXED);
+    }
+  }
+  slot->entry = e;
+  __atomic_store_n (&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+  logqueue_count (&q->queued, 1);
+
+  if (__atomic_load_n (&q->waiting, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock (&q->lock);
+    pthread_cond_signal (&q->cond);
+    pthread_mutex_unlock (&q->lock);
+  }
+  return true;
+}
+
+void edgex_logqueue_metrics (edgex_logqueue *q, JSON_Object *obj)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *lobj = json_value_get_object (val);
+  uint64_t tail = __atomic_load_n (&q->tail, __ATOMIC_RELAXED);
+  uint64_t head = __atomic_load_n (&q->head, __ATOMIC_RELAXED);
+
+  json_object_set_number (lobj, "Depth", tail > head ? tail - head : 0);
+  json_object_set_number (lobj, "Capacity", q->mask + 1);
+  json_object_set_number
+    (lobj, "Queued", __atomic_load_n (&q->queued, __ATOMIC_RELAXED));
+  json_object_set_number
+    (lobj, "Sent", __atomic_load_n (&q->sent, __ATOMIC_RELAXED));
+  json_object_set_number
+    (lobj, "Posts", __atomic_load_n (&q->posts, __ATOMIC_RELAXED));
+  json_object_set_number
+    (lobj, "Dropped", __atomic_load_n (&q->dropped, __ATOMIC_RELAXED));
+  json_object_set_number
+    (lobj, "RateLimited", __atomic_load_n (&q->limited, __ATOMIC_RELAXED));
+  json_object_set_number
+    (lobj, "Failed", __atomic_load_n (&q->failed, __ATOMIC_RELAXED));
+  json_object_set_value (obj, "Logging", val);
+}
+
+void edgex_logqueue_free (edgex_logqueue *q)
+{
+  if (q)
+  {
+    logqueue_entry *e;
+    pthread_mutex_lock (&q->lock);
+    q->stopping = true;
+    pthread_cond_signal (&q->cond);
+    pthread_mutex_unlock (&q->lock);
+    pthread_join (q->thread, NULL);
+
+    /* Anything left could not be sent */
+
+    while ((e = logqueue_take (q)))
+    {
+      free (e);
+      logqueue_count (&q->dropped, 1);
+    }
+    pthread_cond_destroy (&q->cond);
+    pthread_mutex_destroy (&q->lock);
+    free (q->slots);
+    free (q);
+  }
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_LOGQUEUE_H_
+#define _EDGEX_DEVICE_LOGQUEUE_H_ 1
+
+#include "iot/logging.h"
+#include "parson.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * A queue of log entries for a logging service. Entries are added to a
+ * lock-free ring by the logging threads and sent in batches by a background
+ * thread, so that logging does not wait on the network. If the queue is full
+ * or the rate limit is exceeded, entries are dropped and counted.
+ *
+ * A batch is sent as a JSON array of entries, or as a single entry object if
+ * it holds only one.
+ */
+
+typedef struct edgex_logqueue edgex_logqueue;
+
+/* Send a batch of entries, returning true on success */
+
+typedef bool (*edgex_logqueue_sendfn) (void *ctx, const char *json);
+
+/*
+ * Create a queue holding up to size entries (rounded up to a power of two),
+ * sending up to maxbatch entries at a time. A non-zero ratelimit is the most
+ * entries per second which will be accepted. Zero values select defaults.
+ */
+
+extern edgex_logqueue *edgex_logqueue_create
+(
+  edgex_logqueue_sendfn send,
+  void *ctx,
+  uint32_t size,
+  uint32_t maxbatch,
+  uint32_t ratelimit
+);
+
+/* Queue an entry. Returns false if it was dropped */
+
+extern bool edgex_logqueue_add
+(
+  edgex_logqueue *q,
+  const char *subsystem,
+  iot_loglevel l,
+  time_t timestamp,
+  const char *message
+);
+
+/* Add the queue's counters to a metrics object */
+
+extern void edgex_logqueue_metrics (edgex_logqueue *q, JSON_Object *obj);
+
+/* Send the entries remaining in the queue, then free it */
+
+extern void edgex_logqueue_free (edgex_logqueue *q);
+
+/*
+ * Queues used by edgex_log_torest. Once started, entries logged to the URL are
+ * queued rather than posted as they are logged.
+ */
+
+extern edgex_logqueue *edgex_log_rest_start
+  (const char *url, uint32_t size, uint32_t maxbatch, uint32_t ratelimit);
+
+extern void edgex_log_rest_stop (edgex_logqueue *q);
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "lvcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define LV_MINSLOTS 64
+
+/*
+ * Entries are held in an open-addressing table with linear probing. The key
+ * is the device name and resource name, stored together in one allocation
+ * with the value string following them.
+ */
+
+typedef struct lv_entry
+{
+  uint32_t hash;
+  uint32_t devlen;
+  char *key;
+  char *value;
+  double num;
+  uint64_t sent;
+} lv_entry;
+
+struct edgex_lvcache
+{
+  pthread_mutex_t lock;
+  double deadband;
+  double percent;
+  uint64_t refresh;
+  uint32_t nslots;
+  uint32_t nentries;
+  lv_entry *slots;
+  uint64_t suppressed;
+};
+
+static uint32_t lv_hash (const char *device, const char *resource)
+{
+  uint32_t h = 2166136261u;
+  while (*device)
+  {
+    h = (h ^ (unsigned char) *device++) * 16777619u;
+  }
+  h = (h ^ 0xff) * 16777619u;
+  while (*resource)
+  {
+    h = (h ^ (unsigned char) *resource++) * 16777619u;
+  }
+  return h;
+}
+
+edgex_lvcache *edgex_lvcache_create
+  (double deadband, double percent, uint32_t refresh, uint64_t unit)
+{
+  edgex_lvcache *c = calloc (1, sizeof (edgex_lvcache));
+  pthread_mutex_init (&c->lock, NULL);
+  c->deadband = deadband;
+  c->percent = percent;
+  c->refresh = refresh * 1000ULL * unit;
+  c->nslots = LV_MINSLOTS;
+  c->slots = calloc (c->nslots, sizeof (lv_entry));
+  return c;
+}
+
+static lv_entry *lv_find
+  (edgex_lvcache *c, uint32_t h, const char *device, const char *resource)
+{
+  uint32_t mask = c->nslots - 1;
+  size_t devlen = strlen (device);
+  for (uint32_t i = h & mask; ; i = (i + 1) & mask)
+  {
+    lv_entry *e = &c->slots[i];
+    if (e->key == NULL)
+    {
+      return e;
+    }
+    if
+    (
+      e->hash == h && e->devlen == devlen &&
+      memcmp (e->key, device, devlen) == 0 &&
+      strcmp (e->key + devlen + 1, resource) == 0
+    )
+    {
+      return e;
+    }
+  }
+}
+
+static void lv_insert (lv_entry *slots, uint32_t nslots, const lv_entry *e)
+{
+  uint32_t mask = nslots - 1;
+  uint32_t i = e->hash & mask;
+  while (slots[i].key)
+  {
+    i = (i + 1) & mask;
+  }
+  slots[i] = *e;
+}
+
+static void lv_resize (edgex_lvcache *c, uint32_t nslots)
+{
+  lv_entry *slots = calloc (nslots, sizeof (lv_entry));
+  for (uint32_t i = 0; i < c->nslots; i++)
+  {
+    if (c->slots[i].key)
+    {
+      lv_insert (slots, nslots, &c->slots[i]);
+    }
+  }
+  free (c->slots);
+  c->slots = slots;
+  c->nslots = nslots;
+}
+
+static bool lv_changed
+  (edgex_lvcache *c, const lv_entry *e, const char *reading, const double *num)
+{
+  if (num && !isnan (*num) && !isnan (e->num))
+  {
+    double diff = fabs (*num - e->num);
+    if (c->deadband > 0.0 || c->percent > 0.0)
+    {
+      return diff > c->deadband && diff > fabs (e->num) * c->percent / 100.0;
+    }
+    return diff != 0.0 || strcmp (e->value, reading);
+  }
+  return strcmp (e->value, reading) != 0;
+}
+
+static void lv_store
+(
+  lv_entry *e,
+  const char *device,
+  const char *resource,
+  const char *reading,
+  const double *num,
+  uint64_t now
+)
+{
+  size_t devlen = strlen (device);
+  size_t reslen = strlen (resource);
+  size_t vlen = strlen (reading);
+  char *key = e->key;
+
+  if (key == NULL || strlen (e->value) < vlen)
+  {
+    key = malloc (devlen + reslen + vlen + 3);
+    memcpy (key, device, devlen + 1);
+    memcpy (key + devlen + 1, resource, reslen + 1);
+    free (e->key);
+    e->key = key;
+    e->devlen = devlen;
+    e->value = key + devlen + reslen + 2;
+  }
+  memcpy (e->value, reading, vlen + 1);
+  e->num = num ? *num : NAN;
+  e->sent = now;
+}
+
+bool edgex_lvcache_update
+(
+  edgex_lvcache *c,
+  const char *device,
+  const char *resource,
+  const char *reading,
+  const double *num,
+  uint64_t now
+)
+{
+  bool result = true;
+  uint32_t h = lv_hash (device, resource);
+
+  pthread_mutex_lock (&c->lock);
+  lv_entry *e = lv_find (c, h, device, resource);
+  if (e->key)
+  {
+    if
+    (
+      !lv_changed (c, e, reading, num) &&
+      (c->refresh == 0 || now - e->sent < c->refresh)
+    )
+    {
+      result = false;
+      c->suppressed++;
+    }
+  }
+  else
+  {
+    c->nentries++;
+    e->hash = h;
+  }
+  if (result)
+  {
+    lv_store (e, device, resource, reading, num, now);
+    if (c->nentries * 2 > c->nslots)
+    {
+      lv_resize (c, c->nslots * 2);
+    }
+  }
+  pthread_mutex_unlock (&c->lock);
+  return result;
+}
+
+void edgex_lvcache_forget (edgex_lvcache *c, const char *device)
+{
+  size_t devlen = strlen (device);
+  bool found = false;
+
+  if (c == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&c->lock);
+  for (uint32_t i = 0; i < c->nslots; i++)
+  {
+    lv_entry *e = &c->slots[i];
+    if (e->key && e->devlen == devlen && memcmp (e->key, device, devlen) == 0)
+    {
+      free (e->key);
+      memset (e, 0, sizeof (lv_entry));
+      c->nentries--;
+      found = true;
+    }
+  }
+  if (found)
+  {
+    /* Reinsert the remaining entries so that no probe chain is broken */
+    lv_resize (c, c->nslots);
+  }
+  pthread_mutex_unlock (&c->lock);
+}
+
+uint64_t edgex_lvcache_suppressed (edgex_lvcache *c)
+{
+  uint64_t result;
+  pthread_mutex_lock (&c->lock);
+  result = c->suppressed;
+  pthread_mutex_unlock (&c->lock);
+  return result;
+}
+
+void edgex_lvcache_free (edgex_lvcache *c)
+{
+  if (c)
+  {
+    for (uint32_t i = 0; i < c->nslots; i++)
+    {
+      free (c->slots[i].key);
+    }
+    free (c->slots);
+    pthread_mutex_destroy (&c->lock);
+    free (c);
+  }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_LVCACHE_H_
+#define _EDGEX_DEVICE_LVCACHE_H_ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Cache of the last value sent to core-data for each device resource, used
+ * to suppress readings which have not changed.
+ */
+
+typedef struct edgex_lvcache edgex_lvcache;
+
+/*
+ * Create a cache. A floating-point reading is only considered changed if it
+ * differs from the last value sent by more than the deadband and by more
+ * than the given percentage of that value; with both zero, any difference
+ * counts. Other readings are compared in their string form. If refresh is
+ * nonzero, a reading is always sent when that many seconds have passed
+ * since its last value was sent. Readings' origins have unit per millisecond.
+ */
+
+extern edgex_lvcache *edgex_lvcache_create
+  (double deadband, double percent, uint32_t refresh, uint64_t unit);
+
+/*
+ * Determine whether a reading should be sent, and if so record it as the
+ * last value sent. num should point to the numeric value of floating-point
+ * readings, and be NULL otherwise. now is the reading's origin.
+ */
+
+extern bool edgex_lvcache_update
+(
+  edgex_lvcache *c,
+  const char *device,
+  const char *resource,
+  const char *reading,
+  const double *num,
+  uint64_t now
+);
+
+/* Remove all entries for a device */
+
+extern void edgex_lvcache_forget (edgex_lvcache *c, const char *device);
+
+/* Number of readings suppressed */
+
+extern uint64_t edgex_lvcache_suppressed (edgex_lvcache *c);
+
+extern void edgex_lvcache_free (edgex_lvcache *c);
+
+#endif
@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Based on rxi's type-safe hashmap implementation */
+/* API based on rxi's type-safe hashmap implementation */
 
 /**
  * Copyright (c) 2014 rxi
@@ -12,208 +12,317 @@
  * under the terms of the MIT license. See LICENSE for details.
  */
 
-typedef struct edgex_map_node
+/*
+ * Slots are laid out contiguously, each being a header followed by the value.
+ * A dist of zero marks an empty slot; otherwise dist is one more than the
+ * slot's distance from its ideal position. Robin Hood insertion keeps probe
+ * sequences short, lets lookups stop as soon as they pass an entry closer to
+ * its home than the key being sought would be, and allows deletion by shifting
+ * entries back rather than leaving tombstones.
+ */
+
+typedef struct edgex_map_slot
 {
-  unsigned hash;
-  void *value;
-  edgex_map_node *next;
-} edgex_map_node;
+  uint32_t hash;
+  uint32_t dist;
+  uint32_t koff;
+  uint32_t klen;
+} edgex_map_slot;
+
+#define MAP_MINSLOTS 8
+#define MAP_ALIGN 8
+
+/* Resize when more than 3/4 full */
+
+#define MAP_FULL(n, slots) ((n) * 4 > (slots) * 3)
 
-static unsigned edgex_hash (const char *str)
+uint32_t edgex_map_hash (const char *str)
 {
-  unsigned hash = 5381u;
+  /* FNV-1a followed by the murmur3 finalizer, to spread the low bits */
+  uint32_t h = 2166136261u;
   while (*str)
   {
-    hash = ((hash << 5) + hash) ^ *str++;
+    h = (h ^ (unsigned char) *str++) * 16777619u;
   }
-  return hash;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
 }
 
-static edgex_map_node *edgex_map_newnode
-  (const char *key, void *value, int vsize)
+static inline edgex_map_slot *edgex_map_slot_at (edgex_map_base *m, unsigned i)
 {
-  edgex_map_node *node;
-  int ksize = strlen (key) + 1;
-  int voffset = ksize + ((sizeof (void *) - ksize) % sizeof (void *));
-  node = malloc (sizeof (*node) + voffset + vsize);
-  if (!node)
-  { return NULL; }
-  memcpy (node + 1, key, ksize);
-  node->hash = edgex_hash (key);
-  node->value = ((char *) (node + 1)) + voffset;
-  memcpy (node->value, value, vsize);
-  return node;
+  return (edgex_map_slot *) (m->slots + (size_t) i * m->slotsize);
 }
 
-static int edgex_map_bucketidx (edgex_map_base *m, unsigned hash)
+static inline void *edgex_map_value (edgex_map_slot *s)
 {
-  /* If the implementation is changed to allow a non-power-of-2 bucket count,
-   * the line below should be changed to use mod instead of AND
-   */
-  return hash & (m->nbuckets - 1);
+  return s + 1;
 }
 
-static void edgex_map_addnode (edgex_map_base *m, edgex_map_node *node)
+static void edgex_map_setvsize (edgex_map_base *m, int vsize)
 {
-  int n = edgex_map_bucketidx (m, node->hash);
-  node->next = m->buckets[n];
-  m->buckets[n] = node;
+  if (m->slotsize == 0)
+  {
+    m->vsize = vsize;
+    m->slotsize = sizeof (edgex_map_slot) +
+      ((vsize + MAP_ALIGN - 1) / MAP_ALIGN) * MAP_ALIGN;
+  }
 }
 
-static int edgex_map_resize (edgex_map_base *m, int nbuckets)
+/* Place an entry using Robin Hood displacement. The table must have room */
+
+static void edgex_map_place (edgex_map_base *m, edgex_map_slot *entry)
 {
-  edgex_map_node *nodes, *node, *next;
-  edgex_map_node **buckets;
-  int i;
-  /* Chain all nodes together */
-  nodes = NULL;
-  i = m->nbuckets;
-  while (i--)
+  char tmp[m->slotsize];
+  unsigned mask = m->nslots - 1;
+  unsigned i = entry->hash & mask;
+
+  entry->dist = 1;
+  for (;;)
   {
-    node = (m->buckets)[i];
-    while (node)
+    edgex_map_slot *s = edgex_map_slot_at (m, i);
+    if (s->dist == 0)
     {
-      next = node->next;
-      node->next = nodes;
-      nodes = node;
-      node = next;
+      memcpy (s, entry, m->slotsize);
+      return;
     }
+    if (s->dist < entry->dist)
+    {
+      memcpy (tmp, s, m->slotsize);
+      memcpy (s, entry, m->slotsize);
+      memcpy (entry, tmp, m->slotsize);
+    }
+    i = (i + 1) & mask;
+    entry->dist++;
   }
-  /* Reset buckets */
-  buckets = realloc (m->buckets, sizeof (*m->buckets) * nbuckets);
-  if (buckets != NULL)
+}
+
+static int edgex_map_resize (edgex_map_base *m, unsigned nslots)
+{
+  char *old = m->slots;
+  unsigned oldn = m->nslots;
+  char entry[m->slotsize];
+
+  m->slots = calloc (nslots, m->slotsize);
+  if (m->slots == NULL)
   {
-    m->buckets = buckets;
-    m->nbuckets = nbuckets;
+    m->slots = old;
+    return -1;
   }
-  if (m->buckets)
+  m->nslots = nslots;
+  for (unsigned i = 0; i < oldn; i++)
   {
-    memset (m->buckets, 0, sizeof (*m->buckets) * m->nbuckets);
-    /* Re-add nodes to buckets */
-    node = nodes;
-    while (node)
+    edgex_map_slot *s = (edgex_map_slot *) (old + (size_t) i * m->slotsize);
+    if (s->dist)
     {
-      next = node->next;
-      edgex_map_addnode (m, node);
-      node = next;
+      memcpy (entry, s, m->slotsize);
+      edgex_map_place (m, (edgex_map_slot *) entry);
     }
   }
-  /* Return error code if realloc() failed */
-  return (buckets == NULL) ? -1 : 0;
+  free (old);
+  return 0;
 }
 
-static edgex_map_node **edgex_map_getref (edgex_map_base *m, const char *key)
+static edgex_map_slot *edgex_map_find
+  (edgex_map_base *m, const char *key, uint32_t hash, unsigned *idx)
 {
-  unsigned hash = edgex_hash (key);
-  if (m->nbuckets > 0)
+  if (m->nslots == 0)
+  {
+    return NULL;
+  }
+  size_t klen = strlen (key);
+  unsigned mask = m->nslots - 1;
+  unsigned i = hash & mask;
+  for (uint32_t dist = 1; ; dist++)
   {
-    edgex_map_node **next = &m->buckets[edgex_map_bucketidx (m, hash)];
-    while (*next)
+    edgex_map_slot *s = edgex_map_slot_at (m, i);
+    if (s->dist < dist)
+    {
+      /* Empty, or an entry nearer its home than the key would be */
+      return NULL;
+    }
+    if
+    (
+      s->hash == hash && s->klen == klen &&
+      memcmp (m->keys + s->koff, key, klen) == 0
+    )
     {
-      if ((*next)->hash == hash && !strcmp ((char *) (*next + 1), key))
+      if (idx)
       {
-        return next;
+        *idx = i;
       }
-      next = &(*next)->next;
+      return s;
     }
+    i = (i + 1) & mask;
   }
-  return NULL;
 }
 
-void edgex_map_deinit_ (edgex_map_base *m)
+/* Rebuild the key pool without the keys of removed entries */
+
+static void edgex_map_compact (edgex_map_base *m)
 {
-  edgex_map_node *next, *node;
-  int i;
-  i = m->nbuckets;
-  while (i--)
+  char *keys = malloc (m->keyslen - m->keysdead);
+  size_t len = 0;
+  for (unsigned i = 0; i < m->nslots; i++)
   {
-    node = m->buckets[i];
-    while (node)
+    edgex_map_slot *s = edgex_map_slot_at (m, i);
+    if (s->dist)
     {
-      next = node->next;
-      free (node);
-      node = next;
+      memcpy (keys + len, m->keys + s->koff, s->klen + 1);
+      s->koff = len;
+      len += s->klen + 1;
     }
   }
-  free (m->buckets);
+  free (m->keys);
+  m->keys = keys;
+  m->keyslen = len;
+  m->keyscap = len;
+  m->keysdead = 0;
+}
+
+void edgex_map_deinit_ (edgex_map_base *m)
+{
+  free (m->slots);
+  free (m->keys);
+  memset (m, 0, sizeof (edgex_map_base));
 }
 
 void *edgex_map_get_ (edgex_map_base *m, const char *key)
 {
-  edgex_map_node **next = edgex_map_getref (m, key);
-  return next ? (*next)->value : NULL;
+  return edgex_map_get_hashed_ (m, key, edgex_map_hash (key));
+}
+
+void *edgex_map_get_hashed_ (edgex_map_base *m, const char *key, uint32_t hash)
+{
+  edgex_map_slot *s = edgex_map_find (m, key, hash, NULL);
+  return s ? edgex_map_value (s) : NULL;
+}
+
+int edgex_map_reserve_ (edgex_map_base *m, unsigned n, int vsize)
+{
+  unsigned nslots = m->nslots ? m->nslots : MAP_MINSLOTS;
+  edgex_map_setvsize (m, vsize);
+  while (MAP_FULL (n, nslots))
+  {
+    nslots <<= 1;
+  }
+  return (nslots > m->nslots) ? edgex_map_resize (m, nslots) : 0;
 }
 
 int edgex_map_set_ (edgex_map_base *m, const char *key, void *value, int vsize)
 {
-  int n, err;
-  edgex_map_node **next, *node;
-  /* Find & replace existing node */
-  next = edgex_map_getref (m, key);
-  if (next)
+  uint32_t hash = edgex_map_hash (key);
+  edgex_map_slot *s = edgex_map_find (m, key, hash, NULL);
+
+  /* Replace an existing value */
+  if (s)
   {
-    memcpy ((*next)->value, value, vsize);
+    memcpy (edgex_map_value (s), value, vsize);
     return 0;
   }
-  /* Add new node */
-  node = edgex_map_newnode (key, value, vsize);
-  if (node == NULL)
-  { goto fail; }
-  if (m->nnodes >= m->nbuckets)
+
+  edgex_map_setvsize (m, vsize);
+  if (m->nslots == 0 || MAP_FULL (m->nnodes + 1, m->nslots))
+  {
+    if (edgex_map_resize (m, m->nslots ? m->nslots << 1 : MAP_MINSLOTS))
+    {
+      return -1;
+    }
+  }
+
+  /* Append the key to the pool. It may itself point into the pool */
+  size_t klen = strlen (key);
+  if (m->keyslen + klen + 1 > m->keyscap)
+  {
+    size_t cap = m->keyscap ? m->keyscap : 256;
+    while (m->keyslen + klen + 1 > cap)
+    {
+      cap *= 2;
+    }
+    char *keys = malloc (cap);
+    if (keys == NULL)
+    {
+      return -1;
+    }
+    if (m->keyslen)
+    {
+      memcpy (keys, m->keys, m->keyslen);
+    }
+    memcpy (keys + m->keyslen, key, klen + 1);
+    free (m->keys);
+    m->keys = keys;
+    m->keyscap = cap;
+  }
+  else
   {
-    n = (m->nbuckets > 0) ? (m->nbuckets << 1) : 1;
-    err = edgex_map_resize (m, n);
-    if (err)
-    { goto fail; }
+    memcpy (m->keys + m->keyslen, key, klen + 1);
   }
-  edgex_map_addnode (m, node);
+
+  char entry[m->slotsize];
+  edgex_map_slot *e = (edgex_map_slot *) entry;
+  e->hash = hash;
+  e->koff = m->keyslen;
+  e->klen = klen;
+  memcpy (edgex_map_value (e), value, vsize);
+  m->keyslen += klen + 1;
+
+  edgex_map_place (m, e);
   m->nnodes++;
   return 0;
-  fail:
-  if (node)
-  { free (node); }
-  return -1;
 }
 
 void edgex_map_remove_ (edgex_map_base *m, const char *key)
 {
-  edgex_map_node **next = edgex_map_getref (m, key);
-  if (next)
+  unsigned i;
+  edgex_map_slot *s = edgex_map_find (m, key, edgex_map_hash (key), &i);
+  if (s)
   {
-    edgex_map_node *node = *next;
-    *next = (*next)->next;
-    free (node);
+    unsigned mask = m->nslots - 1;
+    m->keysdead += s->klen + 1;
+
+    /* Shift following entries back until one is found in its home slot */
+    for (;;)
+    {
+      unsigned j = (i + 1) & mask;
+      edgex_map_slot *next = edgex_map_slot_at (m, j);
+      if (next->dist <= 1)
+      {
+        break;
+      }
+      memcpy (s, next, m->slotsize);
+      s->dist--;
+      s = next;
+      i = j;
+    }
+    memset (s, 0, m->slotsize);
     m->nnodes--;
+
+    if (m->keysdead > 4096 && m->keysdead * 2 > m->keyslen)
+    {
+      edgex_map_compact (m);
+    }
   }
 }
 
 edgex_map_iter edgex_map_iter_ (void)
 {
   edgex_map_iter iter;
-  iter.bucketidx = -1;
-  iter.node = NULL;
+  iter.idx = 0;
   return iter;
 }
 
 const char *edgex_map_next_ (edgex_map_base *m, edgex_map_iter *iter)
 {
-  if (iter->node)
-  {
-    iter->node = iter->node->next;
-    if (iter->node == NULL)
-    { goto nextBucket; }
-  }
-  else
+  while (iter->idx < m->nslots)
   {
-    nextBucket:
-    do
+    edgex_map_slot *s = edgex_map_slot_at (m, iter->idx++);
+    if (s->dist)
     {
-      if (++iter->bucketidx >= m->nbuckets)
-      {
-        return NULL;
-      }
-      iter->node = m->buckets[iter->bucketidx];
-    } while (iter->node == NULL);
+      return m->keys + s->koff;
+    }
   }
-  return (char *) (iter->node + 1);
+  return NULL;
 }
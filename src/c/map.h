@@ -1,7 +1,7 @@
 #ifndef _EDGEX_DEVICE_MAP_H_
 #define _EDGEX_DEVICE_MAP_H_ 1
 
-/* Based on rxi's type-safe hashmap implementation */
+/* API based on rxi's type-safe hashmap implementation */
 
 /**
  * Copyright (c) 2014 rxi
@@ -10,20 +10,32 @@
  * under the terms of the MIT license. See LICENSE for details.
  */
 
-struct edgex_map_node;
-typedef struct edgex_map_node edgex_map_node;
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Open-addressing (Robin Hood) hash table. Each slot holds the hash, the
+ * location of the key and the value inline; keys are stored together in a
+ * single pool. Pointers to values and keys returned by the map remain valid
+ * only until the map is next modified.
+ */
 
 typedef struct
 {
-  edgex_map_node **buckets;
-  unsigned nbuckets;
+  char *slots;
+  unsigned nslots;
   unsigned nnodes;
+  unsigned vsize;
+  unsigned slotsize;
+  char *keys;
+  size_t keyslen;
+  size_t keyscap;
+  size_t keysdead;
 } edgex_map_base;
 
 typedef struct
 {
-  unsigned bucketidx;
-  edgex_map_node *node;
+  unsigned idx;
 } edgex_map_iter;
 
 #define edgex_map(T) \
@@ -40,25 +52,46 @@ struct \
 
 #define edgex_map_get(m, key) ((m)->ref = edgex_map_get_(&(m)->base, key))
 
+/* Lookup with a hash previously obtained from edgex_map_hash */
+
+#define edgex_map_get_hashed(m, key, hash) \
+  ((m)->ref = edgex_map_get_hashed_(&(m)->base, key, hash))
+
 #define edgex_map_set(m, key, value) \
   ((m)->tmp = (value), \
   edgex_map_set_(&(m)->base, key, &(m)->tmp, sizeof((m)->tmp)) )
 
 #define edgex_map_remove(m, key) edgex_map_remove_ (&(m)->base, key)
 
+/* Ensure that n entries may be held without resizing */
+
+#define edgex_map_reserve(m, n) \
+  edgex_map_reserve_ (&(m)->base, n, sizeof((m)->tmp))
+
+/* The number of entries in the map */
+
+#define edgex_map_count(m) ((m)->base.nnodes)
+
 #define edgex_map_iter(m) edgex_map_iter_ ()
 
 #define edgex_map_next(m, iter) edgex_map_next_ (&(m)->base, iter)
 
+extern uint32_t edgex_map_hash (const char *key);
+
 extern void edgex_map_deinit_ (edgex_map_base *m);
 
 extern void *edgex_map_get_ (edgex_map_base *m, const char *key);
 
+extern void *edgex_map_get_hashed_
+  (edgex_map_base *m, const char *key, uint32_t hash);
+
 extern int edgex_map_set_
   (edgex_map_base *m, const char *key, void *value, int vsize);
 
 extern void edgex_map_remove_ (edgex_map_base *m, const char *key);
 
+extern int edgex_map_reserve_ (edgex_map_base *m, unsigned n, int vsize);
+
 extern edgex_map_iter edgex_map_iter_ (void);
 
 extern const char *edgex_map_next_ (edgex_map_base *m, edgex_map_iter *iter);
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __GNU_LIBRARY__
+#include <malloc.h>
+#define MEM_SIZE(p) malloc_usable_size (p)
+#else
+#define MEM_SIZE(p) 0
+#endif
+
+/*
+ * The statistics interfaces of jemalloc and mimalloc. These are weak, so are
+ * null unless one of these allocators has been linked in or preloaded.
+ */
+
+extern int mallctl
+  (const char *name, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+  __attribute__ ((weak));
+
+extern void mi_process_info
+(
+  size_t *elapsed, size_t *utime, size_t *stime, size_t *rss,
+  size_t *peakrss, size_t *commit, size_t *peakcommit, size_t *faults
+) __attribute__ ((weak));
+
+typedef struct mem_block
+{
+  edgex_mem_stats counts[EDGEX_MEM_NTAGS];
+  bool inuse;
+  struct mem_block *next;
+} mem_block;
+
+static const char *tagnames[EDGEX_MEM_NTAGS] =
+{
+  "Devices", "Profiles", "Events", "Buffers", "Json"
+};
+
+/*
+ * Blocks are never freed, and a block released by an exiting thread is
+ * taken over by a new one. Memory may be freed by thread-specific data
+ * destructors after a thread's block has been released, so the counts are
+ * updated atomically, but as a block is otherwise used by one thread only
+ * this is uncontended.
+ */
+
+static mem_block *blocks = NULL;
+static pthread_mutex_t blockslock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t keyonce = PTHREAD_ONCE_INIT;
+static pthread_key_t blockkey;
+static __thread mem_block *local = NULL;
+
+static void mem_thread_exit (void *p)
+{
+  __atomic_store_n (&((mem_block *) p)->inuse, false, __ATOMIC_RELEASE);
+}
+
+static void mem_key_init (void)
+{
+  pthread_key_create (&blockkey, mem_thread_exit);
+}
+
+static mem_block *mem_local (void)
+{
+  if (local == NULL)
+  {
+    mem_block *b;
+    pthread_once (&keyonce, mem_key_init);
+    pthread_mutex_lock (&blockslock);
+    for (b = blocks; b; b = b->next)
+    {
+      if (!__atomic_load_n (&b->inuse, __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+    }
+    if (b == NULL)
+    {
+      b = calloc (1, sizeof (mem_block));
+      b->next = blocks;
+      __atomic_store_n (&blocks, b, __ATOMIC_RELEASE);
+    }
+    b->inuse = true;
+    pthread_mutex_unlock (&blockslock);
+    pthread_setspecific (blockkey, b);
+    local = b;
+  }
+  return local;
+}
+
+static void mem_count (edgex_memtag tag, int64_t bytes, int64_t objects)
+{
+  edgex_mem_stats *c = &mem_local ()->counts[tag];
+  __atomic_add_fetch (&c->bytes, bytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&c->objects, objects, __ATOMIC_RELAXED);
+}
+
+void *edgex_mem_malloc (edgex_memtag tag, size_t size)
+{
+  void *result = malloc (size);
+  if (result)
+  {
+    mem_count (tag, MEM_SIZE (result), 1);
+  }
+  return result;
+}
+
+void *edgex_mem_calloc (edgex_memtag tag, size_t n, size_t size)
+{
+  void *result = calloc (n, size);
+  if (result)
+  {
+    mem_count (tag, MEM_SIZE (result), 1);
+  }
+  return result;
+}
+
+void *edgex_mem_realloc (edgex_memtag tag, void *ptr, size_t size)
+{
+  int64_t old = ptr ? (int64_t) MEM_SIZE (ptr) : 0;
+  void *result = realloc (ptr, size);
+  if (result)
+  {
+    mem_count (tag, (int64_t) MEM_SIZE (result) - old, ptr ? 0 : 1);
+  }
+  return result;
+}
+
+char *edgex_mem_strdup (edgex_memtag tag, const char *s)
+{
+  size_t len = strlen (s) + 1;
+  char *result = edgex_mem_malloc (tag, len);
+  if (result)
+  {
+    memcpy (result, s, len);
+  }
+  return result;
+}
+
+void edgex_mem_disown (edgex_memtag tag, void *ptr)
+{
+  if (ptr)
+  {
+    mem_count (tag, -(int64_t) MEM_SIZE (ptr), -1);
+  }
+}
+
+void edgex_mem_free (edgex_memtag tag, void *ptr)
+{
+  edgex_mem_disown (tag, ptr);
+  free (ptr);
+}
+
+static void *mem_json_malloc (size_t size)
+{
+  return edgex_mem_malloc (EDGEX_MEM_JSON, size);
+}
+
+static void mem_json_free (void *ptr)
+{
+  edgex_mem_free (EDGEX_MEM_JSON, ptr);
+}
+
+void edgex_mem_json_init (void)
+{
+  json_set_allocation_functions (mem_json_malloc, mem_json_free);
+}
+
+void edgex_mem_getstats (edgex_memtag tag, edgex_mem_stats *stats)
+{
+  stats->bytes = 0;
+  stats->objects = 0;
+  for
+  (
+    mem_block *b = __atomic_load_n (&blocks, __ATOMIC_ACQUIRE);
+    b;
+    b = b->next
+  )
+  {
+    stats->bytes += __atomic_load_n (&b->counts[tag].bytes, __ATOMIC_RELAXED);
+    stats->objects +=
+      __atomic_load_n (&b->counts[tag].objects, __ATOMIC_RELAXED);
+  }
+}
+
+/* Alloc is the memory in use by the program, Heap that taken from the OS */
+
+static void allocator_metrics (JSON_Object *obj)
+{
+  if (mallctl)
+  {
+    uint64_t epoch = 1;
+    size_t allocated;
+    size_t mapped;
+    size_t sz = sizeof (epoch);
+
+    /* Advancing the epoch refreshes jemalloc's statistics */
+
+    mallctl ("epoch", &epoch, &sz, &epoch, sz);
+    sz = sizeof (size_t);
+    if
+    (
+      mallctl ("stats.allocated", &allocated, &sz, NULL, 0) == 0 &&
+      mallctl ("stats.mapped", &mapped, &sz, NULL, 0) == 0
+    )
+    {
+      json_object_set_number (obj, "Alloc", allocated);
+      json_object_set_number (obj, "Heap", mapped);
+    }
+    json_object_set_string (obj, "Allocator", "jemalloc");
+  }
+  else if (mi_process_info)
+  {
+    size_t elapsed, utime, stime, rss, peakrss, commit, peakcommit, faults;
+    mi_process_info
+      (&elapsed, &utime, &stime, &rss, &peakrss, &commit, &peakcommit, &faults);
+    json_object_set_number (obj, "Heap", commit);
+    json_object_set_string (obj, "Allocator", "mimalloc");
+  }
+  else
+  {
+#ifdef __GNU_LIBRARY__
+#if __GLIBC_PREREQ (2, 33)
+    struct mallinfo2 mi = mallinfo2 ();
+#else
+    struct mallinfo mi = mallinfo ();
+#endif
+    json_object_set_number (obj, "Alloc", mi.uordblks);
+    json_object_set_number (obj, "Heap", mi.arena + mi.hblkhd);
+    json_object_set_string (obj, "Allocator", "glibc");
+#endif
+  }
+}
+
+void edgex_mem_metrics (JSON_Object *obj)
+{
+  edgex_mem_stats stats;
+  JSON_Value *mval = json_value_init_array ();
+  JSON_Array *marr = json_value_get_array (mval);
+
+  allocator_metrics (obj);
+  for (unsigned i = 0; i < EDGEX_MEM_NTAGS; i++)
+  {
+    JSON_Value *val = json_value_init_object ();
+    JSON_Object *o = json_value_get_object (val);
+    edgex_mem_getstats (i, &stats);
+    json_object_set_string (o, "Name", tagnames[i]);
+    json_object_set_number (o, "Bytes", stats.bytes);
+    json_object_set_number (o, "Objects", stats.objects);
+    json_array_append_value (marr, val);
+  }
+  json_object_set_value (obj, "Memory", mval);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_MEMSTATS_H_
+#define _EDGEX_DEVICE_MEMSTATS_H_ 1
+
+#include "parson.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Accounting of the memory held by parts of the SDK. Memory allocated with
+ * these wrappers is counted against a tag, in objects and (where the C
+ * library reports the size of an allocation) bytes, until it is freed with
+ * edgex_mem_free and the same tag. As with the service statistics, each
+ * thread keeps its own counts, which are summed when they are read.
+ */
+
+typedef enum
+{
+  EDGEX_MEM_DEVICES,   // Device records
+  EDGEX_MEM_PROFILES,  // Profile, resource and command records
+  EDGEX_MEM_EVENTS,    // Events made for core-data and queued for posting
+  EDGEX_MEM_BUFFERS,   // String buffers, including REST bodies
+  EDGEX_MEM_JSON,      // Parsed and generated JSON
+  EDGEX_MEM_NTAGS
+} edgex_memtag;
+
+extern void *edgex_mem_malloc (edgex_memtag tag, size_t size);
+
+extern void *edgex_mem_calloc (edgex_memtag tag, size_t n, size_t size);
+
+extern void *edgex_mem_realloc (edgex_memtag tag, void *ptr, size_t size);
+
+extern char *edgex_mem_strdup (edgex_memtag tag, const char *s);
+
+extern void edgex_mem_free (edgex_memtag tag, void *ptr);
+
+/* Stop counting ptr, whose new owner will release it with free () */
+
+extern void edgex_mem_disown (edgex_memtag tag, void *ptr);
+
+/* Count parson's allocations against EDGEX_MEM_JSON */
+
+extern void edgex_mem_json_init (void);
+
+typedef struct edgex_mem_stats
+{
+  int64_t bytes;
+  int64_t objects;
+} edgex_mem_stats;
+
+extern void edgex_mem_getstats (edgex_memtag tag, edgex_mem_stats *stats);
+
+/*
+ * Add the totals of the allocator in use (jemalloc or mimalloc if either is
+ * linked into the process, otherwise the C library's) and the counts for
+ * each tag to a metrics object.
+ */
+
+extern void edgex_mem_metrics (JSON_Object *obj);
+
+#endif
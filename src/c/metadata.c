@@ -8,19 +8,24 @@
 
 #include <curl/curl.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include "metadata.h"
 #include "edgex_rest.h"
 #include "rest.h"
 #include "errorlist.h"
 #include "config.h"
+#include "endpoints.h"
 #include "profiles.h"
+#include "memstats.h"
 
-edgex_deviceprofile *edgex_metadata_client_get_deviceprofile
+edgex_deviceprofile *edgex_metadata_client_get_deviceprofile_since
 (
   iot_logging_client *lc,
   edgex_service_endpoints *endpoints,
   const char *name,
+  uint64_t modified,
+  bool *unchanged,
   edgex_error *err
 )
 {
@@ -28,23 +33,32 @@ edgex_deviceprofile *edgex_metadata_client_get_deviceprofile
   edgex_deviceprofile *result = NULL;
   char *ename;
   char url[URL_BUF_SIZE];
+  long rc;
+
+  *unchanged = false;
+  if (!edgex_endpoint_available (&endpoints->metadata))
+  {
+    *err = EDGEX_REMOTE_SERVER_DOWN;
+    return NULL;
+  }
 
   memset (&ctx, 0, sizeof (edgex_ctx));
+  ctx.if_modified_since = modified;
   ename = curl_easy_escape (NULL, name, 0);
 
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/deviceprofile/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/deviceprofile/name/%s",
     ename
   );
 
-  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  rc = edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  edgex_endpoint_result (&endpoints->metadata, url, rc);
+  *unchanged = (rc == EDGEX_HTTP_NOT_MODIFIED);
 
-  if (err->code == 0)
+  if (err->code == 0 && !*unchanged)
   {
     result = edgex_deviceprofile_read (lc, ctx.buff);
     if (!result)
@@ -57,6 +71,54 @@ edgex_deviceprofile *edgex_metadata_client_get_deviceprofile
   return result;
 }
 
+edgex_deviceprofile *edgex_metadata_client_get_deviceprofile
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const char *name,
+  edgex_error *err
+)
+{
+  bool unchanged;
+  return edgex_metadata_client_get_deviceprofile_since
+    (lc, endpoints, name, 0, &unchanged, err);
+}
+
+edgex_deviceprofile **edgex_metadata_client_get_deviceprofiles
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  unsigned *count,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  edgex_deviceprofile **result = NULL;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  *count = 0;
+  edgex_endpoint_url
+  (
+    &endpoints->metadata,
+    url,
+    "/api/v1/deviceprofile"
+  );
+
+  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+
+  if (err->code == 0)
+  {
+    result = edgex_deviceprofiles_read (lc, ctx.buff, count);
+    if (!result)
+    {
+      *err = EDGEX_PROFILE_PARSE_ERROR;
+    }
+  }
+  free (ctx.buff);
+  return result;
+}
+
 void edgex_metadata_client_set_device_opstate
 (
   iot_logging_client *lc,
@@ -70,13 +132,11 @@ void edgex_metadata_client_set_device_opstate
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/%s/opstate/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/%s/opstate/%s",
     deviceid,
     (opstate == ENABLED) ? "enabled" : "disabled"
   );
@@ -98,13 +158,11 @@ void edgex_metadata_client_set_device_adminstate
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/%s/adminstate/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/%s/adminstate/%s",
     deviceid,
     (adminstate == LOCKED) ? "locked" : "unlocked"
   );
@@ -113,6 +171,32 @@ void edgex_metadata_client_set_device_adminstate
   free (ctx.buff);
 }
 
+void edgex_metadata_client_set_device_lastconnected
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const char *deviceid,
+  uint64_t time,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  edgex_endpoint_url
+  (
+    &endpoints->metadata,
+    url,
+    "/api/v1/device/%s/lastconnected/%" PRIu64,
+    deviceid,
+    time
+  );
+
+  edgex_http_put (lc, &ctx, url, NULL, edgex_http_write_cb, err);
+  free (ctx.buff);
+}
+
 char *edgex_metadata_client_create_deviceprofile
 (
   iot_logging_client *lc,
@@ -126,13 +210,11 @@ char *edgex_metadata_client_create_deviceprofile
   char *json;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/deviceprofile",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/deviceprofile"
   );
   json = edgex_deviceprofile_write (newdp, true);
   edgex_http_post (lc, &ctx, url, json, edgex_http_write_cb, err);
@@ -152,18 +234,48 @@ char *edgex_metadata_client_create_deviceprofile_file
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/deviceprofile/uploadfile",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/deviceprofile/uploadfile"
   );
   edgex_http_postfile (lc, &ctx, url, filename, edgex_http_write_cb, err);
   return ctx.buff;
 }
 
+void edgex_metadata_client_update_deviceprofile_json
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const char *json,
+  edgex_error *err
+)
+{
+  edgex_ctx ctx;
+  char url[URL_BUF_SIZE];
+
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  edgex_endpoint_url
+  (
+    &endpoints->metadata,
+    url,
+    "/api/v1/deviceprofile"
+  );
+  edgex_http_put (lc, &ctx, url, json, edgex_http_write_cb, err);
+  if (err->code != 0)
+  {
+    iot_log_info
+    (
+      lc,
+      "edgex_metadata_client_update_deviceprofile: %s: %s",
+      err->reason,
+      ctx.buff
+    );
+  }
+  free (ctx.buff);
+}
+
 edgex_deviceservice *edgex_metadata_client_get_deviceservice
 (
   iot_logging_client *lc,
@@ -178,13 +290,11 @@ edgex_deviceservice *edgex_metadata_client_get_deviceservice
   long rc;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/deviceservice/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/deviceservice/name/%s",
     name
   );
 
@@ -221,13 +331,11 @@ char *edgex_metadata_client_create_deviceservice
   char *json;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/deviceservice",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/deviceservice"
   );
   json = edgex_deviceservice_write (newds, true);
   edgex_http_post (lc, &ctx, url, json, edgex_http_write_cb, err);
@@ -235,6 +343,17 @@ char *edgex_metadata_client_create_deviceservice
   return ctx.buff;
 }
 
+/*
+ * The device list can be large, so it is read as it is received rather than
+ * being buffered whole: see edgex_http_stream_cb.
+ */
+
+static bool edgex_metadata_device_element
+  (void *data, const char *json, size_t len)
+{
+  return edgex_devices_reader_add ((edgex_devices_reader *) data, json, len);
+}
+
 edgex_device *edgex_metadata_client_get_devices
 (
   iot_logging_client *lc,
@@ -244,31 +363,29 @@ edgex_device *edgex_metadata_client_get_devices
 )
 {
   edgex_ctx ctx;
-  edgex_device *result = 0;
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/servicename/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/servicename/%s",
     servicename
   );
 
-  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  edgex_devices_reader *rd = edgex_devices_reader_create (lc);
+  ctx.element = edgex_metadata_device_element;
+  ctx.elementdata = rd;
+  edgex_http_get (lc, &ctx, url, edgex_http_stream_cb, err);
+  free (ctx.buff);
 
-  if (err->code)
+  if (err->code == 0 && !ctx.split.done)
   {
-    return 0;
+    iot_log_error (lc, "Device list from metadata is incomplete");
+    *err = EDGEX_HTTP_GET_ERROR;
   }
-
-  result = edgex_devices_read (lc, ctx.buff);
-  free (ctx.buff);
-  *err = EDGEX_OK;
-  return result;
+  return edgex_devices_reader_finish (rd, err->code == 0);
 }
 
 edgex_scheduleevent *edgex_metadata_client_get_scheduleevents
@@ -284,13 +401,11 @@ edgex_scheduleevent *edgex_metadata_client_get_scheduleevents
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/scheduleevent/servicename/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/scheduleevent/servicename/%s",
     servicename
   );
 
@@ -327,13 +442,11 @@ edgex_scheduleevent *edgex_metadata_client_create_scheduleevent
 
   memset (result, 0, sizeof (edgex_scheduleevent));
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/scheduleevent",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/scheduleevent"
   );
   result->name = strdup (name);
   result->origin = origin;
@@ -378,13 +491,11 @@ edgex_schedule *edgex_metadata_client_get_schedule
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/schedule/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/schedule/name/%s",
     schedulename
   );
 
@@ -421,13 +532,11 @@ edgex_schedule *edgex_metadata_client_create_schedule
 
   memset (result, 0, sizeof (edgex_schedule));
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/schedule",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/schedule"
   );
   result->name = strdup (name);
   result->origin = origin;
@@ -471,20 +580,19 @@ edgex_device *edgex_metadata_client_add_device
   edgex_error *err
 )
 {
-  edgex_device *result = malloc (sizeof (edgex_device));
+  edgex_device *result =
+    edgex_mem_malloc (EDGEX_MEM_DEVICES, sizeof (edgex_device));
   edgex_ctx ctx;
   char url[URL_BUF_SIZE];
   char *json;
 
   memset (result, 0, sizeof (edgex_device));
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/device"
   );
   result->name = strdup (name);
   result->description = strdup (description);
@@ -497,7 +605,8 @@ edgex_device *edgex_metadata_client_add_device
   result->service = malloc (sizeof (edgex_deviceservice));
   memset (result->service, 0, sizeof (edgex_deviceservice));
   result->service->name = strdup (service_name);
-  result->profile = malloc (sizeof (edgex_deviceprofile));
+  result->profile =
+    edgex_mem_malloc (EDGEX_MEM_PROFILES, sizeof (edgex_deviceprofile));
   memset (result->profile, 0, sizeof (edgex_deviceprofile));
   result->profile->name = strdup (profile_name);
   json = edgex_device_write (result, true);
@@ -522,33 +631,45 @@ edgex_device *edgex_metadata_client_add_device
   return result;
 }
 
-edgex_device *edgex_metadata_client_get_device
+edgex_device *edgex_metadata_client_get_device_since
 (
   iot_logging_client *lc,
   edgex_service_endpoints *endpoints,
   const char *deviceid,
+  uint64_t modified,
+  bool *unchanged,
   edgex_error *err
 )
 {
   edgex_ctx ctx;
   edgex_device *result = 0;
   char url[URL_BUF_SIZE];
+  long rc;
+
+  *unchanged = false;
+  if (!edgex_endpoint_available (&endpoints->metadata))
+  {
+    *err = EDGEX_REMOTE_SERVER_DOWN;
+    return NULL;
+  }
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  ctx.if_modified_since = modified;
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/%s",
     deviceid
   );
 
-  edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  rc = edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  edgex_endpoint_result (&endpoints->metadata, url, rc);
+  *unchanged = (rc == EDGEX_HTTP_NOT_MODIFIED);
 
-  if (err->code)
+  if (err->code || *unchanged)
   {
+    free (ctx.buff);
     return 0;
   }
 
@@ -558,6 +679,19 @@ edgex_device *edgex_metadata_client_get_device
   return result;
 }
 
+edgex_device *edgex_metadata_client_get_device
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const char *deviceid,
+  edgex_error *err
+)
+{
+  bool unchanged;
+  return edgex_metadata_client_get_device_since
+    (lc, endpoints, deviceid, 0, &unchanged, err);
+}
+
 edgex_device *edgex_metadata_client_get_device_byname
 (
   iot_logging_client *lc,
@@ -571,13 +705,11 @@ edgex_device *edgex_metadata_client_get_device_byname
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/name/%s",
     devicename
   );
 
@@ -611,13 +743,11 @@ void edgex_metadata_client_update_device
   char *json;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/device"
   );
 
   json = edgex_device_write_sparse
@@ -650,13 +780,11 @@ void edgex_metadata_client_delete_device
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/id/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/id/%s",
     deviceid
   );
 
@@ -677,13 +805,11 @@ void edgex_metadata_client_delete_device_byname
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/device/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/device/name/%s",
     devicename
   );
 
@@ -692,11 +818,13 @@ void edgex_metadata_client_delete_device_byname
   free (ctx.buff);
 }
 
-edgex_addressable *edgex_metadata_client_get_addressable
+edgex_addressable *edgex_metadata_client_get_addressable_since
 (
   iot_logging_client *lc,
   edgex_service_endpoints *endpoints,
   const char *name,
+  uint64_t modified,
+  bool *unchanged,
   edgex_error *err
 )
 {
@@ -705,20 +833,28 @@ edgex_addressable *edgex_metadata_client_get_addressable
   char url[URL_BUF_SIZE];
   long rc;
 
+  *unchanged = false;
+  if (!edgex_endpoint_available (&endpoints->metadata))
+  {
+    *err = EDGEX_REMOTE_SERVER_DOWN;
+    return NULL;
+  }
+
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  ctx.if_modified_since = modified;
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/addressable/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/addressable/name/%s",
     name
   );
 
   rc = edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
+  edgex_endpoint_result (&endpoints->metadata, url, rc);
+  *unchanged = (rc == EDGEX_HTTP_NOT_MODIFIED);
 
-  if (err->code)
+  if (err->code || *unchanged)
   {
     if (rc == 404)
     {
@@ -734,6 +870,19 @@ edgex_addressable *edgex_metadata_client_get_addressable
   return result;
 }
 
+edgex_addressable *edgex_metadata_client_get_addressable
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints *endpoints,
+  const char *name,
+  edgex_error *err
+)
+{
+  bool unchanged;
+  return edgex_metadata_client_get_addressable_since
+    (lc, endpoints, name, 0, &unchanged, err);
+}
+
 char *edgex_metadata_client_create_addressable
 (
   iot_logging_client *lc,
@@ -747,13 +896,11 @@ char *edgex_metadata_client_create_addressable
   char *json;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/addressable",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/addressable"
   );
   json = edgex_addressable_write (newadd, true);
   edgex_http_post (lc, &ctx, url, json, edgex_http_write_cb, err);
@@ -774,13 +921,11 @@ void edgex_metadata_client_update_addressable
   char *json;
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/addressable",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/addressable"
   );
   json = edgex_addressable_write (addressable, false);
   edgex_http_put (lc, &ctx, url, json, edgex_http_write_cb, err);
@@ -800,13 +945,11 @@ void edgex_metadata_client_delete_addressable
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/addressable/name/%s",
-    endpoints->metadata.host,
-    endpoints->metadata.port,
+    "/api/v1/addressable/name/%s",
     name
   );
 
@@ -826,13 +969,11 @@ bool edgex_metadata_client_ping
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  snprintf
+  edgex_endpoint_url
   (
+    &endpoints->metadata,
     url,
-    URL_BUF_SIZE - 1,
-    "http://%s:%u/api/v1/ping",
-    endpoints->metadata.host,
-    endpoints->metadata.port
+    "/api/v1/ping"
   );
 
   edgex_http_get (lc, &ctx, url, edgex_http_write_cb, err);
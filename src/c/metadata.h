@@ -23,6 +23,30 @@ edgex_deviceprofile * edgex_metadata_client_get_deviceprofile
   const char * name,
   edgex_error * err
 );
+
+/*
+ * Conditional forms of the get functions for single entities. If modified
+ * is nonzero (normally the modified time of a copy already held) and the
+ * entity has not changed since then, NULL is returned with *unchanged set
+ * and err EDGEX_OK. The entity is then not transferred or parsed.
+ */
+
+edgex_deviceprofile * edgex_metadata_client_get_deviceprofile_since
+(
+  iot_logging_client * lc,
+  edgex_service_endpoints * endpoints,
+  const char * name,
+  uint64_t modified,
+  bool * unchanged,
+  edgex_error * err
+);
+edgex_deviceprofile ** edgex_metadata_client_get_deviceprofiles
+(
+  iot_logging_client * lc,
+  edgex_service_endpoints * endpoints,
+  unsigned * count,
+  edgex_error * err
+);
 void edgex_metadata_client_set_device_opstate
 (
   iot_logging_client * lc,
@@ -39,6 +63,14 @@ void edgex_metadata_client_set_device_adminstate
   edgex_device_adminstate adminstate,
   edgex_error *err
 );
+void edgex_metadata_client_set_device_lastconnected
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints * endpoints,
+  const char * deviceid,
+  uint64_t time,
+  edgex_error *err
+);
 char * edgex_metadata_client_create_deviceprofile
 (
   iot_logging_client *lc,
@@ -53,6 +85,14 @@ char * edgex_metadata_client_create_deviceprofile_file
   const char * filename,
   edgex_error *err
 );
+/* Replace a profile, given in JSON, which metadata finds by id or name */
+void edgex_metadata_client_update_deviceprofile_json
+(
+  iot_logging_client *lc,
+  edgex_service_endpoints * endpoints,
+  const char * json,
+  edgex_error *err
+);
 edgex_deviceservice * edgex_metadata_client_get_deviceservice
 (
   iot_logging_client *lc,
@@ -132,6 +172,18 @@ edgex_device * edgex_metadata_client_get_device
   const char * deviceid,
   edgex_error * err
 );
+
+/* Conditional form, as edgex_metadata_client_get_deviceprofile_since */
+
+edgex_device * edgex_metadata_client_get_device_since
+(
+  iot_logging_client * lc,
+  edgex_service_endpoints * endpoints,
+  const char * deviceid,
+  uint64_t modified,
+  bool * unchanged,
+  edgex_error * err
+);
 edgex_device * edgex_metadata_client_get_device_byname
 (
   iot_logging_client * lc,
@@ -171,6 +223,18 @@ edgex_addressable * edgex_metadata_client_get_addressable
   const char * name,
   edgex_error * err
 );
+
+/* Conditional form, as edgex_metadata_client_get_deviceprofile_since */
+
+edgex_addressable * edgex_metadata_client_get_addressable_since
+(
+  iot_logging_client * lc,
+  edgex_service_endpoints * endpoints,
+  const char * name,
+  uint64_t modified,
+  bool * unchanged,
+  edgex_error * err
+);
 char * edgex_metadata_client_create_addressable
 (
   iot_logging_client * lc,
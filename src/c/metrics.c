@@ -8,45 +8,489 @@
 
 #include "metrics.h"
 #include "parson.h"
+#include "rest.h"
+#include "service.h"
+#include "transport.h"
+#include "stats.h"
+#include "cmdplan.h"
+#include "openmetrics.h"
+#include "memstats.h"
 
+#include <string.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
-#ifdef __GNU_LIBRARY__
-#include <malloc.h>
-#endif
-
 #include <microhttpd.h>
 
+/*
+ * Driver calls for each device, and for each command of the profiles in use.
+ * Commands which have not been run are left out.
+ */
+
+static void device_metrics (edgex_device_service *svc, JSON_Object *obj)
+{
+  edgex_device *dev;
+  JSON_Value *dval = json_value_init_object ();
+  JSON_Object *dobj = json_value_get_object (dval);
+  JSON_Value *cval = json_value_init_object ();
+  JSON_Object *cobj = json_value_get_object (cval);
+
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_map_iter i = edgex_map_iter (devices->devices);
+  while ((dev = edgex_devmap_next (devices, &i)))
+  {
+    if (dev->stats)
+    {
+      JSON_Value *val = json_value_init_object ();
+      JSON_Object *o = json_value_get_object (val);
+      json_object_set_value (o, "Get", edgex_stats_calls_json (&dev->stats->get));
+      json_object_set_value (o, "Put", edgex_stats_calls_json (&dev->stats->put));
+      json_object_set_value (dobj, dev->name, val);
+    }
+    if (json_object_get_value (cobj, dev->profile->name))
+    {
+      continue;
+    }
+    const edgex_cmdplan *plan = edgex_cmdplan_get (dev->profile);
+    JSON_Value *pval = json_value_init_object ();
+    JSON_Object *pobj = json_value_get_object (pval);
+    for (uint32_t n = 0; n < edgex_cmdplan_size (plan); n++)
+    {
+      const edgex_cmdplan_cmd *cmd = edgex_cmdplan_at (plan, n);
+      if
+      (
+        __atomic_load_n (&cmd->get.stats->calls, __ATOMIC_RELAXED) ||
+        __atomic_load_n (&cmd->set.stats->calls, __ATOMIC_RELAXED)
+      )
+      {
+        JSON_Value *val = json_value_init_object ();
+        JSON_Object *o = json_value_get_object (val);
+        json_object_set_value (o, "Get", edgex_stats_calls_json (cmd->get.stats));
+        json_object_set_value (o, "Put", edgex_stats_calls_json (cmd->set.stats));
+        json_object_set_value (pobj, cmd->command->name, val);
+      }
+    }
+    json_object_set_value (cobj, dev->profile->name, pval);
+  }
+  edgex_devreg_release (svc->devices);
+
+  json_object_set_value (obj, "Devices", dval);
+  json_object_set_value (obj, "Commands", cval);
+}
+
+/* Metrics other than the driver and request statistics */
+
+static void core_metrics (edgex_device_service *svc, JSON_Object *obj)
+{
+  struct rusage rstats;
+
+  edgex_mem_metrics (obj);
+
+  if (getrusage (RUSAGE_SELF, &rstats) == 0)
+  {
+    double cputime = rstats.ru_utime.tv_sec + rstats.ru_stime.tv_sec;
+    cputime += (rstats.ru_utime.tv_usec + rstats.ru_stime.tv_usec) / 1000000.0;
+    json_object_set_number (obj, "CPU", cputime);
+  }
+
+  edgex_http_stats hstats;
+  edgex_http_getstats (&hstats);
+  JSON_Value *hval = json_value_init_object ();
+  JSON_Object *hobj = json_value_get_object (hval);
+  json_object_set_number (hobj, "PoolHits", hstats.poolhits);
+  json_object_set_number (hobj, "PoolMisses", hstats.poolmisses);
+  json_object_set_number (hobj, "ConnectionsReused", hstats.connsreused);
+  json_object_set_number (hobj, "ConnectionsNew", hstats.connsnew);
+  json_object_set_number (hobj, "Http2", hstats.http2);
+  json_object_set_number (hobj, "Compressed", hstats.compressed);
+  json_object_set_number
+  (
+    hobj, "CompressionRatio",
+    hstats.gzipbytes ? (double) hstats.plainbytes / hstats.gzipbytes : 0.0
+  );
+  json_object_set_number (hobj, "CompressionCPU", hstats.compressns / 1e9);
+  json_object_set_value (obj, "Http", hval);
+
+  /* The REST server's settings, and how far connections are reused */
+
+  if (svc->daemon)
+  {
+    edgex_rest_server_stats ss;
+    edgex_rest_server_getstats (svc->daemon, &ss);
+    JSON_Value *sval = json_value_init_object ();
+    JSON_Object *sobj = json_value_get_object (sval);
+    json_object_set_number
+      (sobj, "Threads", svc->config.service.serverthreads);
+    json_object_set_number
+      (sobj, "MaxConnections", svc->config.service.maxconnections);
+    json_object_set_number
+      (sobj, "MaxConnectionsPerIp", svc->config.service.maxconnectionsperip);
+    json_object_set_number
+      (sobj, "ConnectionTimeout", svc->config.service.connectiontimeout);
+    json_object_set_number
+      (sobj, "ListenBacklog", svc->config.service.listenbacklog);
+    json_object_set_number (sobj, "Connections", ss.connections);
+    json_object_set_number (sobj, "ConnectionsAccepted", ss.accepted);
+    json_object_set_number (sobj, "Requests", ss.requests);
+    json_object_set_number
+    (
+      sobj, "RequestsPerConnection",
+      ss.accepted ? (double) ss.requests / ss.accepted : 0.0
+    );
+    json_object_set_value (obj, "Server", sval);
+  }
+
+  if (svc->executor)
+  {
+    edgex_executor_metrics (svc->executor, obj);
+  }
+
+  if (svc->postq)
+  {
+    edgex_postqueue_metrics (svc->postq, obj);
+  }
+
+  if (svc->forward)
+  {
+    edgex_forward_metrics (svc->forward, obj);
+  }
+
+  if (svc->config.endpoints.transport)
+  {
+    svc->config.endpoints.transport->metrics
+      (svc->config.endpoints.transport->impl, obj);
+  }
+
+  if (svc->logq)
+  {
+    edgex_logqueue_metrics (svc->logq, obj);
+  }
+
+  if (svc->timers)
+  {
+    edgex_timerwheel_metrics (svc->timers, obj);
+  }
+
+  if (svc->lvcache)
+  {
+    json_object_set_number
+      (obj, "ReadingsSuppressed", edgex_lvcache_suppressed (svc->lvcache));
+  }
+
+  if (svc->aggregator)
+  {
+    edgex_aggregator_stats as;
+    edgex_aggregator_getstats (svc->aggregator, &as);
+    if (as.samples)
+    {
+      JSON_Value *aval = json_value_init_object ();
+      JSON_Object *aobj = json_value_get_object (aval);
+      json_object_set_number (aobj, "Windows", as.windows);
+      json_object_set_number (aobj, "Samples", as.samples);
+      json_object_set_number (aobj, "Summaries", as.summaries);
+      json_object_set_value (obj, "Aggregation", aval);
+    }
+  }
+
+  if (svc->devstatus)
+  {
+    edgex_devstatus_stats ds;
+    edgex_devstatus_getstats (svc->devstatus, &ds);
+    JSON_Value *dval = json_value_init_object ();
+    JSON_Object *dobj = json_value_get_object (dval);
+    json_object_set_number (dobj, "Pending", ds.pending);
+    json_object_set_number (dobj, "Sent", ds.sent);
+    json_object_set_number (dobj, "Coalesced", ds.coalesced);
+    json_object_set_number (dobj, "Failed", ds.failed);
+    json_object_set_value (obj, "StatusUpdates", dval);
+  }
+}
+
+/*
+ * In the OpenMetrics format the per-device and per-command series, which may
+ * be numerous, are written as the response is sent rather than assembled in
+ * advance. The devices are pinned for the duration.
+ */
+
+typedef enum { OM_CALLS, OM_FAILURES, OM_SECONDS } om_field;
+
+typedef struct om_family
+{
+  const char *name;
+  bool put;
+  om_field field;
+} om_family;
+
+static const om_family devfamilies[] =
+{
+  { "edgex_device_get_calls", false, OM_CALLS },
+  { "edgex_device_get_failures", false, OM_FAILURES },
+  { "edgex_device_get_seconds", false, OM_SECONDS },
+  { "edgex_device_put_calls", true, OM_CALLS },
+  { "edgex_device_put_failures", true, OM_FAILURES },
+  { "edgex_device_put_seconds", true, OM_SECONDS }
+};
+
+static const om_family cmdfamilies[] =
+{
+  { "edgex_command_get_calls", false, OM_CALLS },
+  { "edgex_command_get_failures", false, OM_FAILURES },
+  { "edgex_command_get_seconds", false, OM_SECONDS },
+  { "edgex_command_put_calls", true, OM_CALLS },
+  { "edgex_command_put_failures", true, OM_FAILURES },
+  { "edgex_command_put_seconds", true, OM_SECONDS }
+};
+
+#define OM_NDEVFAMILIES (sizeof (devfamilies) / sizeof (devfamilies[0]))
+#define OM_NCMDFAMILIES (sizeof (cmdfamilies) / sizeof (cmdfamilies[0]))
+
+/* Output is generated in chunks of roughly this size */
+
+#define OM_CHUNK 16384
+
+typedef struct om_stream
+{
+  edgex_strbuf buf;
+  size_t sent;
+  unsigned ndevices;
+  edgex_device **devices;
+  unsigned nprofiles;
+  edgex_device **profiles;
+  unsigned family;
+  unsigned next;
+  bool done;
+} om_stream;
+
+static void om_sample
+(
+  edgex_strbuf *out,
+  const om_family *f,
+  const edgex_stats_calls *c,
+  const char *labels
+)
+{
+  double val;
+  switch (f->field)
+  {
+    case OM_CALLS:
+      val = __atomic_load_n (&c->calls, __ATOMIC_RELAXED);
+      break;
+    case OM_FAILURES:
+      val = __atomic_load_n (&c->failures, __ATOMIC_RELAXED);
+      break;
+    default:
+      val = __atomic_load_n (&c->time, __ATOMIC_RELAXED) / 1e9;
+  }
+  edgex_strbuf_appendstr (out, f->name);
+  edgex_strbuf_appendstr (out, "_total{");
+  edgex_strbuf_appendstr (out, labels);
+  edgex_strbuf_appendchar (out, '}');
+  edgex_openmetrics_value (out, val);
+}
+
+static void om_refill (om_stream *s)
+{
+  edgex_strbuf *labels = edgex_strbuf_scratch ();
+  s->buf.len = 0;
+  s->sent = 0;
+
+  while (s->buf.len < OM_CHUNK && !s->done)
+  {
+    if (s->family < OM_NDEVFAMILIES)
+    {
+      const om_family *f = &devfamilies[s->family];
+      if (s->next == 0)
+      {
+        edgex_openmetrics_type (&s->buf, f->name, "counter");
+      }
+      if (s->next < s->ndevices)
+      {
+        edgex_device *dev = s->devices[s->next++];
+        labels->len = 0;
+        edgex_strbuf_appendstr (labels, "device=");
+        edgex_openmetrics_label (labels, dev->name);
+        om_sample
+          (&s->buf, f, f->put ? &dev->stats->put : &dev->stats->get, labels->data);
+      }
+      else
+      {
+        s->family++;
+        s->next = 0;
+      }
+    }
+    else if (s->family < OM_NDEVFAMILIES + OM_NCMDFAMILIES)
+    {
+      const om_family *f = &cmdfamilies[s->family - OM_NDEVFAMILIES];
+      if (s->next == 0)
+      {
+        edgex_openmetrics_type (&s->buf, f->name, "counter");
+      }
+      if (s->next < s->nprofiles)
+      {
+        edgex_deviceprofile *prof = s->profiles[s->next++]->profile;
+        const edgex_cmdplan *plan = edgex_cmdplan_get (prof);
+        for (uint32_t n = 0; n < edgex_cmdplan_size (plan); n++)
+        {
+          const edgex_cmdplan_cmd *cmd = edgex_cmdplan_at (plan, n);
+          labels->len = 0;
+          edgex_strbuf_appendstr (labels, "profile=");
+          edgex_openmetrics_label (labels, prof->name);
+          edgex_strbuf_appendstr (labels, ",command=");
+          edgex_openmetrics_label (labels, cmd->command->name);
+          om_sample
+            (&s->buf, f, f->put ? cmd->set.stats : cmd->get.stats, labels->data);
+        }
+      }
+      else
+      {
+        s->family++;
+        s->next = 0;
+      }
+    }
+    else
+    {
+      edgex_strbuf_appendstr (&s->buf, "# EOF\n");
+      s->done = true;
+    }
+  }
+}
+
+static ssize_t om_content (void *ctx, uint64_t pos, char *buf, size_t max)
+{
+  om_stream *s = (om_stream *) ctx;
+  while (s->sent == s->buf.len)
+  {
+    if (s->done)
+    {
+      return MHD_CONTENT_READER_END_OF_STREAM;
+    }
+    om_refill (s);
+  }
+  size_t n = s->buf.len - s->sent;
+  if (n > max)
+  {
+    n = max;
+  }
+  memcpy (buf, s->buf.data + s->sent, n);
+  s->sent += n;
+  return n;
+}
+
+static void om_free (void *ctx)
+{
+  om_stream *s = (om_stream *) ctx;
+  for (unsigned i = 0; i < s->ndevices; i++)
+  {
+    edgex_devreg_unpin (s->devices[i]);
+  }
+  free (s->devices);
+  free (s->profiles);
+  edgex_strbuf_fini (&s->buf);
+  free (s);
+}
+
+static void openmetrics_reply
+  (edgex_device_service *svc, edgex_http_response *reply)
+{
+  edgex_device *dev;
+  edgex_map_int seen;
+  om_stream *s = calloc (1, sizeof (om_stream));
+  edgex_strbuf_init (&s->buf);
+
+  /* The other metrics are few, so are written out now */
+
+  JSON_Value *val = json_value_init_object ();
+  core_metrics (svc, json_value_get_object (val));
+  edgex_stats_openmetrics (&s->buf);
+  edgex_openmetrics_json (&s->buf, json_value_get_object (val));
+  json_value_free (val);
+
+  edgex_map_init (&seen);
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  edgex_map_iter i = edgex_map_iter (devices->devices);
+  while ((dev = edgex_devmap_next (devices, &i)))
+  {
+    s->ndevices++;
+  }
+  s->devices = malloc ((s->ndevices + 1) * sizeof (edgex_device *));
+  s->profiles = malloc ((s->ndevices + 1) * sizeof (edgex_device *));
+  s->ndevices = 0;
+  i = edgex_map_iter (devices->devices);
+  while ((dev = edgex_devmap_next (devices, &i)))
+  {
+    if (dev->stats == NULL)
+    {
+      continue;
+    }
+    edgex_devreg_pin (dev);
+    s->devices[s->ndevices++] = dev;
+    if (edgex_map_get (&seen, dev->profile->name) == NULL)
+    {
+      edgex_map_set (&seen, dev->profile->name, 1);
+      s->profiles[s->nprofiles++] = dev;
+    }
+  }
+  edgex_devreg_release (svc->devices);
+  edgex_map_deinit (&seen);
+
+  edgex_http_response_stream
+  (
+    reply, "application/openmetrics-text; version=1.0.0; charset=utf-8",
+    MHD_SIZE_UNKNOWN, om_content, om_free, s
+  );
+}
+
 int edgex_device_handler_metrics
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
-  struct rusage rstats;
-  JSON_Value *val = json_value_init_object ();
-  JSON_Object *obj = json_value_get_object (val);
-
-#ifdef __GNU_LIBRARY__
-  struct mallinfo mi = mallinfo ();
-  json_object_set_number (obj, "Alloc", mi.uordblks);
-  json_object_set_number (obj, "Heap", mi.arena + mi.hblkhd);
-#endif
+  edgex_device_service *svc = (edgex_device_service *) ctx;
+  const char *accept = edgex_http_request_header (reply, "Accept");
 
-  if (getrusage (RUSAGE_SELF, &rstats) == 0)
+  if (accept && strstr (accept, "application/openmetrics-text"))
   {
-    double cputime = rstats.ru_utime.tv_sec + rstats.ru_stime.tv_sec;
-    cputime += (rstats.ru_utime.tv_usec + rstats.ru_stime.tv_usec) / 1000000.0;
-    json_object_set_number (obj, "CPU", cputime);
+    openmetrics_reply (svc, reply);
+    return MHD_HTTP_OK;
   }
-  *reply = json_serialize_to_string (val);
-  *reply_type = "application/json";
+
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  core_metrics (svc, obj);
+  edgex_stats_metrics (obj);
+  device_metrics (svc, obj);
+  edgex_http_response_json (reply, val);
   json_value_free (val);
   return MHD_HTTP_OK;
 }
+
+#if CSDK_BUILD_TRACE
+
+int edgex_device_handler_trace
+(
+  void *ctx,
+  const edgex_http_params *params,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_http_response *reply
+)
+{
+  edgex_device_service *svc = (edgex_device_service *) ctx;
+  const char *format = edgex_http_request_arg (reply, "format");
+  edgex_trace_export
+  (
+    &reply->body,
+    (format && strcmp (format, "otlp") == 0) ? EDGEX_TRACE_OTLP : EDGEX_TRACE_CHROME,
+    svc->name
+  );
+  reply->type = "application/json";
+  return MHD_HTTP_OK;
+}
+
+#endif
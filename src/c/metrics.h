@@ -10,18 +10,34 @@
 #define _EDGEX_DEVICE_METRICS_H_ 1
 
 #include "rest_server.h"
+#include "trace.h"
 
 #include <stddef.h>
 
 extern int edgex_device_handler_metrics
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 );
 
+#if CSDK_BUILD_TRACE
+
+/* Export the recorded trace spans. The format parameter may be "otlp" */
+
+extern int edgex_device_handler_trace
+(
+  void *ctx,
+  const edgex_http_params *params,
+  edgex_http_method method,
+  const char *upload_data,
+  size_t upload_data_size,
+  edgex_http_response *reply
+);
+
+#endif
+
 #endif
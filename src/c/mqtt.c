@@ -0,0 +1,635 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "mqtt.h"
+#include "edgex_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xc0
+#define MQTT_DISCONNECT 0xe0
+#define MQTT_DUP 0x08
+#define MQTT_CLEAN_SESSION 0x02
+#define MQTT_PASSWORD 0x40
+#define MQTT_USERNAME 0x80
+#define MQTT_LEVEL 4
+#define MQTT_MAX_REMAINING 268435455
+
+#define DEFAULT_PORT 1883
+#define DEFAULT_TOPIC "edgex/events"
+#define DEFAULT_INFLIGHT 64
+#define MAX_INFLIGHT 1024
+
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+#define POLL_MS 500
+#define RECONNECT_BASE (100 * NS_PER_MS)
+#define RECONNECT_LIMIT (30000 * NS_PER_MS)
+
+typedef struct mqtt_msg
+{
+  uint8_t *packet;      // The complete PUBLISH packet; NULL once acked
+  size_t len;
+  uint16_t id;
+} mqtt_msg;
+
+struct edgex_mqtt
+{
+  iot_logging_client *lc;
+  char *host;
+  char port[8];
+  char *topic;
+  char *clientid;
+  char *username;
+  char *password;
+  uint8_t qos;
+  uint16_t keepalive;
+  uint32_t timeout;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+  int fd;               // The connection, or -1
+  bool broken;          // A write has failed: the connection is to be closed
+  uint64_t lastsend;
+  uint64_t lastrecv;
+  mqtt_msg *window;     // Messages in flight, oldest at head
+  unsigned size;
+  uint64_t head;
+  uint64_t tail;
+  uint16_t nextid;
+  bool connectedonce;
+  edgex_mqtt_stats stats;
+};
+
+static char *dupOrNull (const char *s)
+{
+  return (s && *s) ? strdup (s) : NULL;
+}
+
+static void waitUntil (edgex_mqtt *m, uint64_t t)
+{
+  struct timespec ts;
+  ts.tv_sec = t / NS_PER_SEC;
+  ts.tv_nsec = t % NS_PER_SEC;
+  pthread_cond_timedwait (&m->cond, &m->lock, &ts);
+}
+
+/* Encode a remaining length, returning the number of bytes used */
+
+static size_t mqtt_putlen (uint8_t *p, size_t len)
+{
+  size_t n = 0;
+  do
+  {
+    uint8_t b = len % 128;
+    len /= 128;
+    p[n++] = len ? (b | 0x80) : b;
+  } while (len);
+  return n;
+}
+
+static size_t mqtt_putstr (uint8_t *p, const char *s)
+{
+  size_t len = strlen (s);
+  p[0] = len >> 8;
+  p[1] = len & 0xff;
+  memcpy (p + 2, s, len);
+  return len + 2;
+}
+
+static bool mqtt_send (int fd, const void *buf, size_t len)
+{
+  const uint8_t *p = (const uint8_t *) buf;
+  while (len)
+  {
+    ssize_t n = send (fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool mqtt_recv (int fd, void *buf, size_t len)
+{
+  uint8_t *p = (uint8_t *) buf;
+  while (len)
+  {
+    ssize_t n = recv (fd, p, len, 0);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+/*
+ * Read a packet, giving its first byte and length. Only packets with bodies
+ * of up to max bytes are of interest: the bodies of others are discarded.
+ */
+
+static bool mqtt_read_packet
+  (int fd, uint8_t *type, uint8_t *body, size_t max, size_t *len)
+{
+  uint8_t b;
+  size_t remaining = 0;
+  unsigned shift = 0;
+
+  if (!mqtt_recv (fd, type, 1))
+  {
+    return false;
+  }
+  do
+  {
+    if (shift > 21 || !mqtt_recv (fd, &b, 1))
+    {
+      return false;
+    }
+    remaining |= (size_t) (b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+
+  *len = remaining;
+  while (remaining)
+  {
+    size_t n = (remaining < max) ? remaining : max;
+    if (!mqtt_recv (fd, body, n))
+    {
+      return false;
+    }
+    remaining -= n;
+  }
+  return true;
+}
+
+/* Open a connection and establish a session, returning the socket or -1 */
+
+static int mqtt_connect (edgex_mqtt *m)
+{
+  struct addrinfo hints;
+  struct addrinfo *res;
+  struct timeval tv;
+  uint8_t type = 0;
+  uint8_t body[4];
+  size_t len = 0;
+  int fd = -1;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo (m->host, m->port, &hints, &res) != 0)
+  {
+    iot_log_debug (m->lc, "MQTT: unable to resolve %s", m->host);
+    return -1;
+  }
+
+  /* The send timeout also bounds the time taken to connect */
+
+  tv.tv_sec = m->timeout / 1000;
+  tv.tv_usec = (m->timeout % 1000) * 1000;
+  for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next)
+  {
+    fd = socket
+      (ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd >= 0)
+    {
+      setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+      setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+      if (connect (fd, ai->ai_addr, ai->ai_addrlen) != 0)
+      {
+        close (fd);
+        fd = -1;
+      }
+    }
+  }
+  freeaddrinfo (res);
+  if (fd < 0)
+  {
+    iot_log_debug
+      (m->lc, "MQTT: unable to connect to %s:%s", m->host, m->port);
+    return -1;
+  }
+  int one = 1;
+  setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+  size_t remaining = 10 + 2 + strlen (m->clientid);
+  uint8_t flags = MQTT_CLEAN_SESSION;
+  if (m->username)
+  {
+    remaining += 2 + strlen (m->username);
+    flags |= MQTT_USERNAME;
+    if (m->password)
+    {
+      remaining += 2 + strlen (m->password);
+      flags |= MQTT_PASSWORD;
+    }
+  }
+  uint8_t *pkt = malloc (remaining + 5);
+  size_t n = 0;
+  pkt[n++] = MQTT_CONNECT;
+  n += mqtt_putlen (pkt + n, remaining);
+  n += mqtt_putstr (pkt + n, "MQTT");
+  pkt[n++] = MQTT_LEVEL;
+  pkt[n++] = flags;
+  pkt[n++] = m->keepalive >> 8;
+  pkt[n++] = m->keepalive & 0xff;
+  n += mqtt_putstr (pkt + n, m->clientid);
+  if (flags & MQTT_USERNAME)
+  {
+    n += mqtt_putstr (pkt + n, m->username);
+  }
+  if (flags & MQTT_PASSWORD)
+  {
+    n += mqtt_putstr (pkt + n, m->password);
+  }
+
+  bool ok = mqtt_send (fd, pkt, n) &&
+    mqtt_read_packet (fd, &type, body, sizeof (body), &len) &&
+    type == MQTT_CONNACK && len == 2 && body[1] == 0;
+  free (pkt);
+  if (!ok)
+  {
+    if (type == MQTT_CONNACK && len == 2)
+    {
+      iot_log_error
+        (m->lc, "MQTT: connection refused by broker, code %u", body[1]);
+    }
+    close (fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Send the messages in flight again, on a new connection. Called locked */
+
+static void mqtt_resend (edgex_mqtt *m)
+{
+  for (uint64_t i = m->head; i < m->tail && !m->broken; i++)
+  {
+    mqtt_msg *msg = &m->window[i % m->size];
+    if (msg->packet)
+    {
+      msg->packet[0] |= MQTT_DUP;
+      m->broken = !mqtt_send (m->fd, msg->packet, msg->len);
+    }
+  }
+}
+
+/* Handle an acknowledgement. Called locked */
+
+static void mqtt_ack (edgex_mqtt *m, uint16_t id)
+{
+  for (uint64_t i = m->head; i < m->tail; i++)
+  {
+    mqtt_msg *msg = &m->window[i % m->size];
+    if (msg->packet && msg->id == id)
+    {
+      free (msg->packet);
+      msg->packet = NULL;
+      m->stats.acked++;
+      break;
+    }
+  }
+  while (m->head < m->tail && m->window[m->head % m->size].packet == NULL)
+  {
+    m->head++;
+  }
+  pthread_cond_broadcast (&m->cond);
+}
+
+static void *mqtt_thread (void *p)
+{
+  edgex_mqtt *m = (edgex_mqtt *) p;
+  uint64_t delay = 0;
+  uint64_t keepalive = m->keepalive * NS_PER_SEC;
+  uint8_t body[16];
+  uint8_t type;
+  size_t len;
+
+  pthread_mutex_lock (&m->lock);
+  while (m->running)
+  {
+    if (m->fd < 0)
+    {
+      pthread_mutex_unlock (&m->lock);
+      int fd = mqtt_connect (m);
+      pthread_mutex_lock (&m->lock);
+      if (fd >= 0)
+      {
+        iot_log_info (m->lc, "MQTT: connected to %s:%s", m->host, m->port);
+        if (m->connectedonce)
+        {
+          m->stats.reconnects++;
+        }
+        m->connectedonce = true;
+        m->fd = fd;
+        m->broken = false;
+        m->lastsend = m->lastrecv = edgex_device_monotime ();
+        delay = 0;
+        mqtt_resend (m);
+        pthread_cond_broadcast (&m->cond);
+      }
+      else if (m->running)
+      {
+        uint64_t wait =
+          edgex_device_backoff (&delay, RECONNECT_BASE, RECONNECT_LIMIT);
+        waitUntil (m, edgex_device_monotime () + wait);
+      }
+      continue;
+    }
+
+    /* Wait for a packet from the broker, outside the lock */
+
+    int fd = m->fd;
+    bool ok = !m->broken;
+    bool received = false;
+    pthread_mutex_unlock (&m->lock);
+    if (ok)
+    {
+      struct pollfd pfd = { .fd = fd, .events = POLLIN };
+      if (poll (&pfd, 1, POLL_MS) > 0)
+      {
+        received = true;
+        ok = mqtt_read_packet (fd, &type, body, sizeof (body), &len);
+      }
+    }
+    pthread_mutex_lock (&m->lock);
+
+    uint64_t now = edgex_device_monotime ();
+    if (ok && received)
+    {
+      m->lastrecv = now;
+      if ((type & 0xf0) == MQTT_PUBACK && len == 2)
+      {
+        mqtt_ack (m, (body[0] << 8) | body[1]);
+      }
+    }
+    if (ok && keepalive)
+    {
+      if (now - m->lastrecv > keepalive + keepalive / 2)
+      {
+        iot_log_warning (m->lc, "MQTT: no response from %s", m->host);
+        ok = false;
+      }
+      else if (now - m->lastsend >= keepalive / 2)
+      {
+        uint8_t ping[2] = { MQTT_PINGREQ, 0 };
+        ok = mqtt_send (fd, ping, sizeof (ping));
+        m->lastsend = now;
+      }
+    }
+    if (!ok || m->broken)
+    {
+      if (m->running)
+      {
+        iot_log_warning
+          (m->lc, "MQTT: lost connection to %s:%s", m->host, m->port);
+      }
+      close (fd);
+      m->fd = -1;
+      m->broken = false;
+      pthread_cond_broadcast (&m->cond);
+    }
+  }
+  pthread_mutex_unlock (&m->lock);
+  return NULL;
+}
+
+edgex_mqtt *edgex_mqtt_create
+(
+  iot_logging_client *lc,
+  const edgex_device_messagequeueinfo *conf,
+  const char *name,
+  uint32_t timeout
+)
+{
+  pthread_condattr_t attr;
+  edgex_mqtt *m = calloc (1, sizeof (edgex_mqtt));
+
+  m->lc = lc;
+  m->host = strdup (conf->host);
+  snprintf
+    (m->port, sizeof (m->port), "%u", conf->port ? conf->port : DEFAULT_PORT);
+  m->topic = dupOrNull (conf->topic);
+  if (m->topic == NULL)
+  {
+    m->topic = strdup (DEFAULT_TOPIC);
+  }
+  m->clientid = dupOrNull (conf->clientid);
+  if (m->clientid == NULL)
+  {
+    m->clientid = strdup (name);
+  }
+  m->username = dupOrNull (conf->username);
+  m->password = dupOrNull (conf->password);
+  m->qos = conf->qos ? 1 : 0;
+  m->keepalive = conf->keepalive > UINT16_MAX ? UINT16_MAX : conf->keepalive;
+  m->timeout = timeout;
+  m->size = conf->maxinflight ? conf->maxinflight : DEFAULT_INFLIGHT;
+  if (m->size > MAX_INFLIGHT)
+  {
+    m->size = MAX_INFLIGHT;
+  }
+  m->window = calloc (m->size, sizeof (mqtt_msg));
+  m->fd = -1;
+  m->running = true;
+  pthread_mutex_init (&m->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&m->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  pthread_create (&m->thread, NULL, mqtt_thread, m);
+  return m;
+}
+
+bool edgex_mqtt_publish (edgex_mqtt *m, const void *data, size_t len)
+{
+  size_t tlen = strlen (m->topic);
+  size_t remaining = 2 + tlen + (m->qos ? 2 : 0) + len;
+  bool ok = false;
+
+  if (remaining > MQTT_MAX_REMAINING)
+  {
+    pthread_mutex_lock (&m->lock);
+    m->stats.failures++;
+    pthread_mutex_unlock (&m->lock);
+    return false;
+  }
+
+  uint8_t *pkt = malloc (remaining + 5);
+  size_t n = 0;
+  pkt[n++] = MQTT_PUBLISH | (m->qos << 1);
+  n += mqtt_putlen (pkt + n, remaining);
+  n += mqtt_putstr (pkt + n, m->topic);
+  size_t idpos = n;
+  if (m->qos)
+  {
+    n += 2;
+  }
+  memcpy (pkt + n, data, len);
+  n += len;
+
+  pthread_mutex_lock (&m->lock);
+  if (m->qos)
+  {
+    uint64_t deadline = edgex_device_monotime () + m->timeout * NS_PER_MS;
+    while
+    (
+      m->running && m->fd >= 0 && !m->broken &&
+      m->tail - m->head == m->size && edgex_device_monotime () < deadline
+    )
+    {
+      waitUntil (m, deadline);
+    }
+  }
+  bool room = (m->qos == 0 || m->tail - m->head < m->size);
+  if (m->fd >= 0 && !m->broken && room)
+  {
+    const uint8_t *sent = pkt;
+    if (m->qos)
+    {
+      /* Once in the window, a message is sent again if need be */
+
+      m->nextid = m->nextid == UINT16_MAX ? 1 : m->nextid + 1;
+      pkt[idpos] = m->nextid >> 8;
+      pkt[idpos + 1] = m->nextid & 0xff;
+      mqtt_msg *msg = &m->window[m->tail++ % m->size];
+      msg->packet = pkt;
+      msg->len = n;
+      msg->id = m->nextid;
+      pkt = NULL;
+      ok = true;
+    }
+    if (mqtt_send (m->fd, sent, n))
+    {
+      m->lastsend = edgex_device_monotime ();
+      ok = true;
+    }
+    else
+    {
+      m->broken = true;
+      shutdown (m->fd, SHUT_RDWR);
+    }
+  }
+  if (ok)
+  {
+    m->stats.published++;
+  }
+  else
+  {
+    m->stats.failures++;
+  }
+  pthread_mutex_unlock (&m->lock);
+  free (pkt);
+  return ok;
+}
+
+void edgex_mqtt_getstats (edgex_mqtt *m, edgex_mqtt_stats *stats)
+{
+  pthread_mutex_lock (&m->lock);
+  *stats = m->stats;
+  stats->connected = (m->fd >= 0 && !m->broken);
+  stats->inflight = 0;
+  for (uint64_t i = m->head; i < m->tail; i++)
+  {
+    if (m->window[i % m->size].packet)
+    {
+      stats->inflight++;
+    }
+  }
+  pthread_mutex_unlock (&m->lock);
+}
+
+void edgex_mqtt_free (edgex_mqtt *m)
+{
+  if (m == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock (&m->lock);
+  uint64_t deadline = edgex_device_monotime () + m->timeout * NS_PER_MS;
+  while
+  (
+    m->fd >= 0 && !m->broken && m->head < m->tail &&
+    edgex_device_monotime () < deadline
+  )
+  {
+    waitUntil (m, deadline);
+  }
+  m->running = false;
+  if (m->fd >= 0)
+  {
+    if (!m->broken)
+    {
+      uint8_t disconnect[2] = { MQTT_DISCONNECT, 0 };
+      mqtt_send (m->fd, disconnect, sizeof (disconnect));
+    }
+    shutdown (m->fd, SHUT_RDWR);
+  }
+  pthread_cond_broadcast (&m->cond);
+  pthread_mutex_unlock (&m->lock);
+  pthread_join (m->thread, NULL);
+
+  if (m->fd >= 0)
+  {
+    close (m->fd);
+  }
+  unsigned lost = 0;
+  for (uint64_t i = m->head; i < m->tail; i++)
+  {
+    mqtt_msg *msg = &m->window[i % m->size];
+    if (msg->packet)
+    {
+      free (msg->packet);
+      lost++;
+    }
+  }
+  if (lost)
+  {
+    iot_log_warning (m->lc, "MQTT: %u messages were not acknowledged", lost);
+  }
+  free (m->window);
+  free (m->host);
+  free (m->topic);
+  free (m->clientid);
+  free (m->username);
+  free (m->password);
+  pthread_cond_destroy (&m->cond);
+  pthread_mutex_destroy (&m->lock);
+  free (m);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_MQTT_H_
+#define _EDGEX_DEVICE_MQTT_H_ 1
+
+#include "edgex/edgex_logging.h"
+#include "config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A minimal MQTT 3.1.1 publisher. A background thread keeps a connection to
+ * the broker, reconnecting with backoff, and reads its acknowledgements. At
+ * QoS 1, publication does not wait for the broker: up to MaxInFlight
+ * messages may be awaiting acknowledgement, and those not acknowledged when
+ * the connection is lost are sent again once it is restored.
+ */
+
+typedef struct edgex_mqtt edgex_mqtt;
+
+typedef struct edgex_mqtt_stats
+{
+  bool connected;
+  uint64_t published;   // Messages sent
+  uint64_t acked;       // Messages acknowledged by the broker
+  uint64_t inflight;    // Messages awaiting acknowledgement
+  uint64_t reconnects;  // Connections made after the first
+  uint64_t failures;    // Messages refused, having no connection or window
+} edgex_mqtt_stats;
+
+/*
+ * Start publishing to the broker given in conf, identifying as name if no
+ * ClientId is configured. Each publication waits up to timeout milliseconds
+ * for room in the in-flight window.
+ */
+
+extern edgex_mqtt *edgex_mqtt_create
+(
+  iot_logging_client *lc,
+  const edgex_device_messagequeueinfo *conf,
+  const char *name,
+  uint32_t timeout
+);
+
+/*
+ * Publish a message to the configured topic. Returns false if there is no
+ * connection to the broker, or no room was made in the window in time.
+ */
+
+extern bool edgex_mqtt_publish (edgex_mqtt *m, const void *data, size_t len);
+
+extern void edgex_mqtt_getstats (edgex_mqtt *m, edgex_mqtt_stats *stats);
+
+/*
+ * Disconnect, having waited (up to the timeout) for messages in flight to
+ * be acknowledged.
+ */
+
+extern void edgex_mqtt_free (edgex_mqtt *m);
+
+#endif
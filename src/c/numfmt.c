@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+/*
+ * Numbers are formatted without using printf or the heap. Floating point
+ * values use the Grisu2 algorithm (Florian Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers", PLDI 2010), which yields the
+ * shortest, or very nearly shortest, digit string that reads back as the
+ * original value.
+ */
+
+#include "numfmt.h"
+
+#include <string.h>
+#include <math.h>
+
+typedef struct
+{
+  uint64_t f;
+  int e;
+} diyfp;
+
+/* Normalized 64-bit approximations of 10^k for k = -348, -340 ... 340 */
+
+static const diyfp cached_powers[] =
+{
+  { 0xfa8fd5a0081c0288ULL, -1220 },
+  { 0xbaaee17fa23ebf76ULL, -1193 },
+  { 0x8b16fb203055ac76ULL, -1166 },
+  { 0xcf42894a5dce35eaULL, -1140 },
+  { 0x9a6bb0aa55653b2dULL, -1113 },
+  { 0xe61acf033d1a45dfULL, -1087 },
+  { 0xab70fe17c79ac6caULL, -1060 },
+  { 0xff77b1fcbebcdc4fULL, -1034 },
+  { 0xbe5691ef416bd60cULL, -1007 },
+  { 0x8dd01fad907ffc3cULL, -980 },
+  { 0xd3515c2831559a83ULL, -954 },
+  { 0x9d71ac8fada6c9b5ULL, -927 },
+  { 0xea9c227723ee8bcbULL, -901 },
+  { 0xaecc49914078536dULL, -874 },
+  { 0x823c12795db6ce57ULL, -847 },
+  { 0xc21094364dfb5637ULL, -821 },
+  { 0x9096ea6f3848984fULL, -794 },
+  { 0xd77485cb25823ac7ULL, -768 },
+  { 0xa086cfcd97bf97f4ULL, -741 },
+  { 0xef340a98172aace5ULL, -715 },
+  { 0xb23867fb2a35b28eULL, -688 },
+  { 0x84c8d4dfd2c63f3bULL, -661 },
+  { 0xc5dd44271ad3cdbaULL, -635 },
+  { 0x936b9fcebb25c996ULL, -608 },
+  { 0xdbac6c247d62a584ULL, -582 },
+  { 0xa3ab66580d5fdaf6ULL, -555 },
+  { 0xf3e2f893dec3f126ULL, -529 },
+  { 0xb5b5ada8aaff80b8ULL, -502 },
+  { 0x87625f056c7c4a8bULL, -475 },
+  { 0xc9bcff6034c13053ULL, -449 },
+  { 0x964e858c91ba2655ULL, -422 },
+  { 0xdff9772470297ebdULL, -396 },
+  { 0xa6dfbd9fb8e5b88fULL, -369 },
+  { 0xf8a95fcf88747d94ULL, -343 },
+  { 0xb94470938fa89bcfULL, -316 },
+  { 0x8a08f0f8bf0f156bULL, -289 },
+  { 0xcdb02555653131b6ULL, -263 },
+  { 0x993fe2c6d07b7facULL, -236 },
+  { 0xe45c10c42a2b3b06ULL, -210 },
+  { 0xaa242499697392d3ULL, -183 },
+  { 0xfd87b5f28300ca0eULL, -157 },
+  { 0xbce5086492111aebULL, -130 },
+  { 0x8cbccc096f5088ccULL, -103 },
+  { 0xd1b71758e219652cULL, -77 },
+  { 0x9c40000000000000ULL, -50 },
+  { 0xe8d4a51000000000ULL, -24 },
+  { 0xad78ebc5ac620000ULL, 3 },
+  { 0x813f3978f8940984ULL, 30 },
+  { 0xc097ce7bc90715b3ULL, 56 },
+  { 0x8f7e32ce7bea5c70ULL, 83 },
+  { 0xd5d238a4abe98068ULL, 109 },
+  { 0x9f4f2726179a2245ULL, 136 },
+  { 0xed63a231d4c4fb27ULL, 162 },
+  { 0xb0de65388cc8ada8ULL, 189 },
+  { 0x83c7088e1aab65dbULL, 216 },
+  { 0xc45d1df942711d9aULL, 242 },
+  { 0x924d692ca61be758ULL, 269 },
+  { 0xda01ee641a708deaULL, 295 },
+  { 0xa26da3999aef774aULL, 322 },
+  { 0xf209787bb47d6b85ULL, 348 },
+  { 0xb454e4a179dd1877ULL, 375 },
+  { 0x865b86925b9bc5c2ULL, 402 },
+  { 0xc83553c5c8965d3dULL, 428 },
+  { 0x952ab45cfa97a0b3ULL, 455 },
+  { 0xde469fbd99a05fe3ULL, 481 },
+  { 0xa59bc234db398c25ULL, 508 },
+  { 0xf6c69a72a3989f5cULL, 534 },
+  { 0xb7dcbf5354e9beceULL, 561 },
+  { 0x88fcf317f22241e2ULL, 588 },
+  { 0xcc20ce9bd35c78a5ULL, 614 },
+  { 0x98165af37b2153dfULL, 641 },
+  { 0xe2a0b5dc971f303aULL, 667 },
+  { 0xa8d9d1535ce3b396ULL, 694 },
+  { 0xfb9b7cd9a4a7443cULL, 720 },
+  { 0xbb764c4ca7a44410ULL, 747 },
+  { 0x8bab8eefb6409c1aULL, 774 },
+  { 0xd01fef10a657842cULL, 800 },
+  { 0x9b10a4e5e9913129ULL, 827 },
+  { 0xe7109bfba19c0c9dULL, 853 },
+  { 0xac2820d9623bf429ULL, 880 },
+  { 0x80444b5e7aa7cf85ULL, 907 },
+  { 0xbf21e44003acdd2dULL, 933 },
+  { 0x8e679c2f5e44ff8fULL, 960 },
+  { 0xd433179d9c8cb841ULL, 986 },
+  { 0x9e19db92b4e31ba9ULL, 1013 },
+  { 0xeb96bf6ebadf77d9ULL, 1039 },
+  { 0xaf87023b9bf0ee6bULL, 1066 }
+};
+
+static const uint64_t pow10_table[] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536"
+  "37383940414243444546474849505152535455565758596061626364656667686970717273"
+  "74757677787980818283848586878889909192939495969798990";
+
+size_t edgex_fmt_uint (uint64_t val, char *buf)
+{
+  char tmp[20];
+  char *p = tmp + sizeof (tmp);
+
+  while (val >= 100)
+  {
+    unsigned i = (val % 100) * 2;
+    val /= 100;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  }
+  if (val >= 10)
+  {
+    unsigned i = val * 2;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  }
+  else
+  {
+    *--p = '0' + val;
+  }
+  size_t len = tmp + sizeof (tmp) - p;
+  memcpy (buf, p, len);
+  buf[len] = '\0';
+  return len;
+}
+
+size_t edgex_fmt_int (int64_t val, char *buf)
+{
+  if (val < 0)
+  {
+    *buf = '-';
+    return 1 + edgex_fmt_uint (-(uint64_t)val, buf + 1);
+  }
+  return edgex_fmt_uint (val, buf);
+}
+
+static diyfp diyfp_mul (diyfp x, diyfp y)
+{
+  const uint64_t m32 = 0xffffffffULL;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & m32;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & m32;
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+  tmp += 1ULL << 31;
+  diyfp r = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+  return r;
+}
+
+static diyfp diyfp_normalize (diyfp x)
+{
+  while (!(x.f & (1ULL << 63)))
+  {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+static diyfp cached_power (int e, int *K)
+{
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int k = (int) dk;
+  if (dk - k > 0.0)
+  {
+    k++;
+  }
+  unsigned index = (unsigned) ((k >> 3) + 1);
+  *K = -(-348 + (int) (index << 3));
+  return cached_powers[index];
+}
+
+static void grisu_round
+  (char *buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_k, uint64_t wp_w)
+{
+  while (rest < wp_w && delta - rest >= ten_k &&
+         (rest + ten_k < wp_w || wp_w - rest > rest + ten_k - wp_w))
+  {
+    buf[len - 1]--;
+    rest += ten_k;
+  }
+}
+
+static int count_digits (uint32_t n)
+{
+  int d = 1;
+  while (d < 10 && n >= pow10_table[d])
+  {
+    d++;
+  }
+  return d;
+}
+
+static void digit_gen
+  (diyfp w, diyfp mp, uint64_t delta, char *buf, int *len, int *K)
+{
+  diyfp one = { 1ULL << -mp.e, mp.e };
+  uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = count_digits (p1);
+
+  *len = 0;
+  while (kappa > 0)
+  {
+    uint32_t div = (uint32_t) pow10_table[kappa - 1];
+    uint32_t d = p1 / div;
+    p1 %= div;
+    if (d || *len)
+    {
+      buf[(*len)++] = '0' + d;
+    }
+    kappa--;
+    uint64_t tmp = ((uint64_t) p1 << -one.e) + p2;
+    if (tmp <= delta)
+    {
+      *K += kappa;
+      grisu_round (buf, *len, delta, tmp, pow10_table[kappa] << -one.e, wp_w);
+      return;
+    }
+  }
+
+  while (true)
+  {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char) (p2 >> -one.e);
+    if (d || *len)
+    {
+      buf[(*len)++] = '0' + d;
+    }
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta)
+    {
+      *K += kappa;
+      int index = -kappa;
+      grisu_round
+        (buf, *len, delta, p2, one.f, wp_w * (index < 20 ? pow10_table[index] : 0));
+      return;
+    }
+  }
+}
+
+/*
+ * Generate digits for the value f * 2^e, where the significand of the source
+ * type has sigbits explicit bits. The result is buf[0..len) * 10^K.
+ */
+
+static void grisu2
+  (uint64_t f, int e, int sigbits, char *buf, int *len, int *K)
+{
+  uint64_t hidden = 1ULL << sigbits;
+  diyfp v = { f, e };
+
+  /* Boundaries m+ and m- of the rounding interval, with a common exponent */
+
+  diyfp mp = { (f << 1) + 1, e - 1 };
+  while (!(mp.f & (hidden << 1)))
+  {
+    mp.f <<= 1;
+    mp.e--;
+  }
+  mp.f <<= 62 - sigbits;
+  mp.e -= 62 - sigbits;
+
+  diyfp mm = (f == hidden) ?
+    (diyfp) { (f << 2) - 1, e - 2 } : (diyfp) { (f << 1) - 1, e - 1 };
+  mm.f <<= mm.e - mp.e;
+  mm.e = mp.e;
+
+  diyfp c_mk = cached_power (mp.e, K);
+  diyfp W = diyfp_mul (diyfp_normalize (v), c_mk);
+  diyfp Wp = diyfp_mul (mp, c_mk);
+  diyfp Wm = diyfp_mul (mm, c_mk);
+  Wm.f++;
+  Wp.f--;
+  digit_gen (W, Wp, Wp.f - Wm.f, buf, len, K);
+}
+
+/* Lay out digits * 10^K in the style of printf's %e */
+
+static size_t fmt_exponential (char *buf, const char *digits, int len, int K)
+{
+  char *p = buf;
+  int exp = K + len - 1;
+
+  *p++ = digits[0];
+  if (len > 1)
+  {
+    *p++ = '.';
+    memcpy (p, digits + 1, len - 1);
+    p += len - 1;
+  }
+  *p++ = 'e';
+  if (exp < 0)
+  {
+    *p++ = '-';
+    exp = -exp;
+  }
+  else
+  {
+    *p++ = '+';
+  }
+  if (exp >= 100)
+  {
+    *p++ = '0' + exp / 100;
+    exp %= 100;
+  }
+  *p++ = digit_pairs[exp * 2];
+  *p++ = digit_pairs[exp * 2 + 1];
+  *p = '\0';
+  return p - buf;
+}
+
+static size_t fmt_special (double val, char *buf)
+{
+  const char *s;
+  if (isnan (val))
+  {
+    s = "nan";
+  }
+  else if (isinf (val))
+  {
+    s = val < 0 ? "-inf" : "inf";
+  }
+  else
+  {
+    s = signbit (val) ? "-0e+00" : "0e+00";
+  }
+  strcpy (buf, s);
+  return strlen (s);
+}
+
+size_t edgex_fmt_double (double val, char *buf)
+{
+  char digits[20];
+  int len;
+  int K;
+  uint64_t bits;
+  size_t neg = 0;
+
+  if (!isfinite (val) || val == 0.0)
+  {
+    return fmt_special (val, buf);
+  }
+  memcpy (&bits, &val, sizeof (bits));
+  if (bits >> 63)
+  {
+    *buf++ = '-';
+    neg = 1;
+  }
+  uint64_t f = bits & ((1ULL << 52) - 1);
+  int be = (int) ((bits >> 52) & 0x7ff);
+  if (be)
+  {
+    grisu2 (f | (1ULL << 52), be - 1075, 52, digits, &len, &K);
+  }
+  else
+  {
+    grisu2 (f, -1074, 52, digits, &len, &K);
+  }
+  return neg + fmt_exponential (buf, digits, len, K);
+}
+
+size_t edgex_fmt_float (float val, char *buf)
+{
+  char digits[20];
+  int len;
+  int K;
+  uint32_t bits;
+  size_t neg = 0;
+
+  if (!isfinite (val) || val == 0.0f)
+  {
+    return fmt_special (val, buf);
+  }
+  memcpy (&bits, &val, sizeof (bits));
+  if (bits >> 31)
+  {
+    *buf++ = '-';
+    neg = 1;
+  }
+  uint64_t f = bits & ((1U << 23) - 1);
+  int be = (int) ((bits >> 23) & 0xff);
+  if (be)
+  {
+    grisu2 (f | (1U << 23), be - 150, 23, digits, &len, &K);
+  }
+  else
+  {
+    grisu2 (f, -149, 23, digits, &len, &K);
+  }
+  return neg + fmt_exponential (buf, digits, len, K);
+}
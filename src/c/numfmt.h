@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_NUMFMT_H_
+#define _EDGEX_DEVICE_NUMFMT_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Buffer size sufficient for any value formatted by the functions below */
+
+#define EDGEX_FMT_BUFSIZE 32
+
+/*
+ * Each of these writes a NUL-terminated string to buf and returns its length.
+ * Floating point values are written in the exponential form used by %e, with
+ * the fewest digits needed to read back as the same value.
+ */
+
+extern size_t edgex_fmt_uint (uint64_t val, char *buf);
+
+extern size_t edgex_fmt_int (int64_t val, char *buf);
+
+extern size_t edgex_fmt_double (double val, char *buf);
+
+extern size_t edgex_fmt_float (float val, char *buf);
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "openmetrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+/* Convert CamelCase to snake_case, replacing other characters with '_' */
+
+static void append_snake (edgex_strbuf *out, const char *s)
+{
+  bool sep = true;
+  for (size_t i = 0; s[i]; i++)
+  {
+    unsigned char c = s[i];
+    if (isupper (c))
+    {
+      unsigned char prev = i ? s[i - 1] : 0;
+      unsigned char next = s[i + 1];
+      if
+      (
+        !sep && (islower (prev) || isdigit (prev) ||
+        (isupper (prev) && islower (next)))
+      )
+      {
+        edgex_strbuf_appendchar (out, '_');
+      }
+      edgex_strbuf_appendchar (out, tolower (c));
+      sep = false;
+    }
+    else if (isalnum (c))
+    {
+      edgex_strbuf_appendchar (out, c);
+      sep = false;
+    }
+    else if (!sep)
+    {
+      edgex_strbuf_appendchar (out, '_');
+      sep = true;
+    }
+  }
+}
+
+void edgex_openmetrics_name
+  (edgex_strbuf *out, const char *part1, const char *part2)
+{
+  edgex_strbuf_appendstr (out, "edgex");
+  if (part1)
+  {
+    edgex_strbuf_appendchar (out, '_');
+    append_snake (out, part1);
+  }
+  if (part2)
+  {
+    edgex_strbuf_appendchar (out, '_');
+    append_snake (out, part2);
+  }
+}
+
+void edgex_openmetrics_type
+  (edgex_strbuf *out, const char *family, const char *type)
+{
+  edgex_strbuf_appendstr (out, "# TYPE ");
+  edgex_strbuf_appendstr (out, family);
+  edgex_strbuf_appendchar (out, ' ');
+  edgex_strbuf_appendstr (out, type);
+  edgex_strbuf_appendchar (out, '\n');
+}
+
+void edgex_openmetrics_label (edgex_strbuf *out, const char *value)
+{
+  edgex_strbuf_appendchar (out, '"');
+  for (; *value; value++)
+  {
+    switch (*value)
+    {
+      case '\\':
+        edgex_strbuf_appendstr (out, "\\\\");
+        break;
+      case '"':
+        edgex_strbuf_appendstr (out, "\\\"");
+        break;
+      case '\n':
+        edgex_strbuf_appendstr (out, "\\n");
+        break;
+      default:
+        edgex_strbuf_appendchar (out, *value);
+    }
+  }
+  edgex_strbuf_appendchar (out, '"');
+}
+
+void edgex_openmetrics_value (edgex_strbuf *out, double value)
+{
+  char buf[32];
+  snprintf (buf, sizeof (buf), " %.15g\n", value);
+  edgex_strbuf_appendstr (out, buf);
+}
+
+/*
+ * The samples of a family must be contiguous, but the same family may be
+ * met in each element of an array, so samples are collected by family.
+ */
+
+typedef struct om_family
+{
+  char *name;
+  edgex_strbuf samples;
+} om_family;
+
+typedef struct om_families
+{
+  unsigned n;
+  om_family *list;
+} om_families;
+
+static edgex_strbuf *om_family_get (om_families *f, const char *name)
+{
+  for (unsigned i = 0; i < f->n; i++)
+  {
+    if (strcmp (f->list[i].name, name) == 0)
+    {
+      return &f->list[i].samples;
+    }
+  }
+  f->list = realloc (f->list, (f->n + 1) * sizeof (om_family));
+  f->list[f->n].name = strdup (name);
+  edgex_strbuf_init (&f->list[f->n].samples);
+  return &f->list[f->n++].samples;
+}
+
+static void om_walk
+(
+  om_families *f,
+  edgex_strbuf *name,
+  edgex_strbuf *labels,
+  const JSON_Value *val
+)
+{
+  size_t namelen = name->len;
+  size_t labelslen = labels->len;
+
+  switch (json_value_get_type (val))
+  {
+    case JSONNumber:
+    case JSONBoolean:
+    {
+      edgex_strbuf *out = om_family_get (f, name->data);
+      edgex_strbuf_appendstr (out, name->data);
+      if (labels->len)
+      {
+        edgex_strbuf_appendchar (out, '{');
+        edgex_strbuf_append (out, labels->data, labels->len);
+        edgex_strbuf_appendchar (out, '}');
+      }
+      edgex_openmetrics_value
+      (
+        out, json_value_get_type (val) == JSONNumber ?
+          json_value_get_number (val) : json_value_get_boolean (val)
+      );
+      break;
+    }
+    case JSONObject:
+    {
+      const JSON_Object *obj = json_value_get_object (val);
+      for (size_t i = 0; i < json_object_get_count (obj); i++)
+      {
+        edgex_strbuf_appendchar (name, '_');
+        append_snake (name, json_object_get_name (obj, i));
+        om_walk (f, name, labels, json_object_get_value_at (obj, i));
+        name->len = namelen;
+        name->data[namelen] = '\0';
+      }
+      break;
+    }
+    case JSONArray:
+    {
+      const JSON_Array *arr = json_value_get_array (val);
+      for (size_t i = 0; i < json_array_get_count (arr); i++)
+      {
+        const JSON_Object *elem = json_array_get_object (arr, i);
+        if (elem == NULL)
+        {
+          continue;
+        }
+        const char *ename = json_object_get_string (elem, "Name");
+        if (labels->len)
+        {
+          edgex_strbuf_appendchar (labels, ',');
+        }
+        if (ename)
+        {
+          edgex_strbuf_appendstr (labels, "name=");
+          edgex_openmetrics_label (labels, ename);
+        }
+        else
+        {
+          edgex_strbuf_appendstr (labels, "index=\"");
+          edgex_strbuf_appenduint (labels, i);
+          edgex_strbuf_appendchar (labels, '"');
+        }
+        om_walk (f, name, labels, json_array_get_value (arr, i));
+        labels->len = labelslen;
+        if (labels->data)
+        {
+          labels->data[labelslen] = '\0';
+        }
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void edgex_openmetrics_json (edgex_strbuf *out, const JSON_Object *obj)
+{
+  om_families f = { 0, NULL };
+  edgex_strbuf name;
+  edgex_strbuf labels;
+
+  edgex_strbuf_init (&name);
+  edgex_strbuf_init (&labels);
+  edgex_strbuf_appendstr (&name, "edgex");
+  om_walk (&f, &name, &labels, json_object_get_wrapping_value (obj));
+
+  for (unsigned i = 0; i < f.n; i++)
+  {
+    edgex_openmetrics_type (out, f.list[i].name, "unknown");
+    edgex_strbuf_append (out, f.list[i].samples.data, f.list[i].samples.len);
+    edgex_strbuf_fini (&f.list[i].samples);
+    free (f.list[i].name);
+  }
+  free (f.list);
+  edgex_strbuf_fini (&name);
+  edgex_strbuf_fini (&labels);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_OPENMETRICS_H_
+#define _EDGEX_DEVICE_OPENMETRICS_H_ 1
+
+#include "strbuf.h"
+#include "parson.h"
+
+/* Helpers for producing metrics in the OpenMetrics text format */
+
+/* Append a metric name: "edgex_" then the words of each part, in snake case */
+
+extern void edgex_openmetrics_name
+  (edgex_strbuf *out, const char *part1, const char *part2);
+
+/* Append a "# TYPE" line for a metric family */
+
+extern void edgex_openmetrics_type
+  (edgex_strbuf *out, const char *family, const char *type);
+
+/* Append a label value in double quotes, escaped as required */
+
+extern void edgex_openmetrics_label (edgex_strbuf *out, const char *value);
+
+/* Append a numeric sample value, followed by a newline */
+
+extern void edgex_openmetrics_value (edgex_strbuf *out, double value);
+
+/*
+ * Append the numbers in a JSON object as metrics of unknown type, named by
+ * their paths in the object. Objects in arrays are distinguished by a "name"
+ * label taken from their Name member.
+ */
+
+extern void edgex_openmetrics_json (edgex_strbuf *out, const JSON_Object *obj);
+
+#endif
@@ -0,0 +1,792 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "postqueue.h"
+#include "service.h"
+#include "data.h"
+#include "map.h"
+#include "errorlist.h"
+#include "endpoints.h"
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define DEFAULT_BATCH_TIMEOUT 100
+#define DEFAULT_QUEUE_SIZE 1024
+#define DEFAULT_QUEUE_THREADS 4
+#define LATENCY_SAMPLES 1024
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+#define REPLAY_RETRY NS_PER_SEC
+
+typedef enum
+{
+  POLICY_BLOCK,
+  POLICY_DROPOLDEST,
+  POLICY_DROPNEWEST,
+  POLICY_SPILL
+} edgex_postqueue_policy;
+
+typedef struct edgex_postqueue_entry
+{
+  edgex_event_cooked *event;
+  uint64_t queued;
+  struct edgex_postqueue_entry *next;
+} edgex_postqueue_entry;
+
+/*
+ * Events are held in a queue per device. Devices with queued events are
+ * linked in a ring which the dispatchers serve in turn, so that a device
+ * generating events at a high rate does not delay the others.
+ */
+
+typedef struct edgex_postqueue_devq
+{
+  edgex_postqueue_entry *head;
+  edgex_postqueue_entry *tail;
+  uint32_t depth;
+  struct edgex_postqueue_devq *prev;
+  struct edgex_postqueue_devq *next;
+} edgex_postqueue_devq;
+
+typedef edgex_map(edgex_postqueue_devq *) edgex_map_devq;
+
+struct edgex_postqueue
+{
+  edgex_device_service *svc;
+  uint32_t batchsize;
+  uint32_t capacity;
+  uint64_t timeout;
+  edgex_postqueue_policy policy;
+  char *spilldir;
+  uint32_t nthreads;
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_cond_t space;
+  bool running;
+  edgex_map_devq devqs;
+  edgex_postqueue_devq *ring;
+  uint32_t depth;
+  pthread_mutex_t spilllock;
+  uint64_t spillhead;
+  uint64_t spilltail;
+  uint64_t nevents;
+  uint64_t nposts;
+  uint64_t nbatches;
+  uint64_t ndropped;
+  uint64_t nspilled;
+  uint64_t latency[LATENCY_SAMPLES];
+  uint32_t nlatency;
+  uint32_t latencypos;
+};
+
+static uint64_t edgex_postqueue_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* Ring maintenance. All of the following are called with the lock held */
+
+static void edgex_postqueue_ring_add
+  (edgex_postqueue *q, edgex_postqueue_devq *d)
+{
+  if (q->ring)
+  {
+    d->next = q->ring;
+    d->prev = q->ring->prev;
+    d->prev->next = d;
+    q->ring->prev = d;
+  }
+  else
+  {
+    d->next = d->prev = d;
+    q->ring = d;
+  }
+}
+
+static void edgex_postqueue_ring_remove
+  (edgex_postqueue *q, edgex_postqueue_devq *d)
+{
+  if (d->next == d)
+  {
+    q->ring = NULL;
+  }
+  else
+  {
+    d->prev->next = d->next;
+    d->next->prev = d->prev;
+    if (q->ring == d)
+    {
+      q->ring = d->next;
+    }
+  }
+  d->next = d->prev = NULL;
+}
+
+static edgex_postqueue_devq *edgex_postqueue_devq_get
+  (edgex_postqueue *q, const char *device)
+{
+  edgex_postqueue_devq **dp = edgex_map_get (&q->devqs, device);
+  if (dp)
+  {
+    return *dp;
+  }
+  edgex_postqueue_devq *d = malloc (sizeof (edgex_postqueue_devq));
+  memset (d, 0, sizeof (edgex_postqueue_devq));
+  edgex_map_set (&q->devqs, device, d);
+  return d;
+}
+
+static edgex_postqueue_devq *edgex_postqueue_longest (edgex_postqueue *q)
+{
+  edgex_postqueue_devq *result = q->ring;
+  if (result)
+  {
+    for (edgex_postqueue_devq *d = result->next; d != q->ring; d = d->next)
+    {
+      if (d->depth > result->depth)
+      {
+        result = d;
+      }
+    }
+  }
+  return result;
+}
+
+static uint64_t edgex_postqueue_oldest (edgex_postqueue *q)
+{
+  edgex_postqueue_devq *d = q->ring;
+  uint64_t result = d->head->queued;
+  for (d = d->next; d != q->ring; d = d->next)
+  {
+    if (d->head->queued < result)
+    {
+      result = d->head->queued;
+    }
+  }
+  return result;
+}
+
+static void edgex_postqueue_push
+  (edgex_postqueue *q, edgex_postqueue_devq *d, edgex_event_cooked *event)
+{
+  edgex_postqueue_entry *entry =
+    edgex_mem_malloc (EDGEX_MEM_EVENTS, sizeof (edgex_postqueue_entry));
+  entry->event = event;
+  entry->queued = edgex_postqueue_now ();
+  entry->next = NULL;
+  if (d->tail)
+  {
+    d->tail->next = entry;
+  }
+  else
+  {
+    d->head = entry;
+    edgex_postqueue_ring_add (q, d);
+  }
+  d->tail = entry;
+  d->depth++;
+  q->depth++;
+  if (q->depth == 1 || q->depth == q->batchsize)
+  {
+    pthread_cond_signal (&q->ready);
+  }
+}
+
+static edgex_postqueue_entry *edgex_postqueue_pop
+  (edgex_postqueue *q, edgex_postqueue_devq *d)
+{
+  edgex_postqueue_entry *entry = d->head;
+  d->head = entry->next;
+  if (d->head == NULL)
+  {
+    d->tail = NULL;
+    edgex_postqueue_ring_remove (q, d);
+  }
+  entry->next = NULL;
+  d->depth--;
+  q->depth--;
+  return entry;
+}
+
+static void edgex_postqueue_drop_newest
+  (edgex_postqueue *q, edgex_postqueue_devq *d)
+{
+  if (d->head == d->tail)
+  {
+    edgex_postqueue_entry *entry = edgex_postqueue_pop (q, d);
+    edgex_data_event_free (entry->event);
+    edgex_mem_free (EDGEX_MEM_EVENTS, entry);
+  }
+  else
+  {
+    edgex_postqueue_entry *prev = d->head;
+    while (prev->next != d->tail)
+    {
+      prev = prev->next;
+    }
+    edgex_data_event_free (d->tail->event);
+    edgex_mem_free (EDGEX_MEM_EVENTS, d->tail);
+    prev->next = NULL;
+    d->tail = prev;
+    d->depth--;
+    q->depth--;
+  }
+  q->ndropped++;
+}
+
+/*
+ * Spill files are named by sequence number and replayed in order. Their
+ * extension shows the encoding of the event. Files are written one at a time
+ * under spilllock, without the queue lock, and are added to the queue's
+ * range of files to replay once complete.
+ */
+
+static const char *edgex_postqueue_spill_ext (edgex_event_encoding enc)
+{
+  return enc == EDGEX_EVENT_CBOR ? ".cbor" : ".json";
+}
+
+static void edgex_postqueue_spill
+  (edgex_postqueue *q, edgex_event_cooked *event)
+{
+  char path[PATH_MAX];
+  bool ok = false;
+  edgex_strbuf *buf = edgex_strbuf_scratch ();
+  const char *ext = edgex_postqueue_spill_ext (event->encoding);
+
+  edgex_data_event_write (event, buf);
+  edgex_data_event_free (event);
+
+  pthread_mutex_lock (&q->spilllock);
+  uint64_t seq = q->spilltail;
+  snprintf (path, sizeof (path), "%s/%" PRIu64 "%s", q->spilldir, seq, ext);
+  FILE *f = fopen (path, "w");
+  if (f)
+  {
+    ok = (fwrite (buf->data, 1, buf->len, f) == buf->len);
+    ok = (fclose (f) == 0) && ok;
+  }
+
+  /* spilltail changes only with both locks held, so either may be used */
+
+  pthread_mutex_lock (&q->lock);
+  if (ok)
+  {
+    q->spilltail = seq + 1;
+    q->nspilled++;
+  }
+  else
+  {
+    q->ndropped++;
+  }
+  pthread_mutex_unlock (&q->lock);
+  pthread_mutex_unlock (&q->spilllock);
+  if (!ok)
+  {
+    iot_log_error (q->svc->logger, "Unable to write event to %s", path);
+  }
+}
+
+static edgex_event_cooked *edgex_postqueue_unspill_cbor (const char *path)
+{
+  edgex_event_cooked *event = NULL;
+  FILE *f = fopen (path, "r");
+  if (f)
+  {
+    edgex_strbuf *buf = edgex_strbuf_scratch ();
+    char chunk[4096];
+    size_t n;
+    while ((n = fread (chunk, 1, sizeof (chunk), f)) > 0)
+    {
+      edgex_strbuf_append (buf, chunk, n);
+    }
+    if (!ferror (f))
+    {
+      event = edgex_data_event_fromcbor ((const uint8_t *) buf->data, buf->len);
+    }
+    fclose (f);
+  }
+  return event;
+}
+
+static edgex_event_cooked *edgex_postqueue_unspill
+  (edgex_postqueue *q, uint64_t seq)
+{
+  char path[PATH_MAX];
+  edgex_event_cooked *event;
+  snprintf
+  (
+    path, sizeof (path), "%s/%" PRIu64 "%s", q->spilldir, seq,
+    edgex_postqueue_spill_ext (EDGEX_EVENT_CBOR)
+  );
+  if (access (path, F_OK) == 0)
+  {
+    event = edgex_postqueue_unspill_cbor (path);
+  }
+  else
+  {
+    snprintf
+    (
+      path, sizeof (path), "%s/%" PRIu64 "%s", q->spilldir, seq,
+      edgex_postqueue_spill_ext (EDGEX_EVENT_JSON)
+    );
+    JSON_Value *val = json_parse_file (path);
+    event = edgex_data_event_fromjson (val);
+    json_value_free (val);
+  }
+  if (event == NULL)
+  {
+    iot_log_error (q->svc->logger, "Unable to read spilled event %s", path);
+  }
+  unlink (path);
+  return event;
+}
+
+/* Pick up events left on disk by a previous run */
+
+static void edgex_postqueue_spill_scan (edgex_postqueue *q)
+{
+  struct dirent *ent;
+  char *end;
+  bool found = false;
+
+  if (mkdir (q->spilldir, 0700) != 0 && errno != EEXIST)
+  {
+    iot_log_error
+      (q->svc->logger, "Unable to create spill directory %s", q->spilldir);
+    return;
+  }
+  DIR *dir = opendir (q->spilldir);
+  if (dir == NULL)
+  {
+    return;
+  }
+  while ((ent = readdir (dir)))
+  {
+    uint64_t seq = strtoull (ent->d_name, &end, 10);
+    if
+    (
+      end != ent->d_name &&
+      (strcmp (end, ".json") == 0 || strcmp (end, ".cbor") == 0)
+    )
+    {
+      if (!found || seq < q->spillhead)
+      {
+        q->spillhead = seq;
+      }
+      if (!found || seq >= q->spilltail)
+      {
+        q->spilltail = seq + 1;
+      }
+      found = true;
+    }
+  }
+  closedir (dir);
+  if (found)
+  {
+    iot_log_info
+    (
+      q->svc->logger, "Replaying %" PRIu64 " spilled events from %s",
+      q->spilltail - q->spillhead, q->spilldir
+    );
+  }
+}
+
+static uint32_t edgex_postqueue_flush
+  (edgex_postqueue *q, edgex_postqueue_entry *batch)
+{
+  edgex_error err;
+  uint32_t nposts = 0;
+  edgex_strbuf *buf = edgex_strbuf_scratch ();
+
+  for (edgex_postqueue_entry *e = batch; e; e = e->next)
+  {
+    if (e->event == NULL)
+    {
+      continue;
+    }
+    for (edgex_postqueue_entry *f = e->next; f; f = f->next)
+    {
+      if
+      (
+        f->event && f->event->encoding == e->event->encoding &&
+        strcmp (e->event->device, f->event->device) == 0
+      )
+      {
+        edgex_data_event_merge (e->event, f->event);
+        edgex_data_event_free (f->event);
+        f->event = NULL;
+      }
+    }
+
+    /* While core-data's circuit is open, events are kept on disk */
+
+    if
+    (
+      q->spilldir &&
+      !edgex_endpoint_available (&q->svc->config.endpoints.data)
+    )
+    {
+      edgex_postqueue_spill (q, e->event);
+      e->event = NULL;
+      continue;
+    }
+
+    buf->len = 0;
+    edgex_data_event_write (e->event, buf);
+    err = EDGEX_OK;
+    edgex_data_client_add_event
+    (
+      q->svc->logger, &q->svc->config.endpoints, buf->data, buf->len,
+      e->event->encoding, &err
+    );
+    if (err.code && err.code != EDGEX_EVENT_REJECTED.code)
+    {
+      edgex_forward_store
+        (q->svc->forward, buf->data, buf->len, e->event->encoding);
+    }
+    edgex_data_event_free (e->event);
+    e->event = NULL;
+    nposts++;
+  }
+  return nposts;
+}
+
+static void *edgex_postqueue_thread (void *p)
+{
+  edgex_postqueue *q = (edgex_postqueue *) p;
+
+  pthread_mutex_lock (&q->lock);
+  while (true)
+  {
+    /*
+     * Replay spilled events once the queue has drained, and core-data's
+     * circuit (see endpoints.h) is closed. While it is open, look again
+     * from time to time; this is what pings core-data if all events are
+     * going to disk.
+     */
+
+    if (q->running && q->spillhead < q->spilltail && q->depth < q->capacity / 2)
+    {
+      pthread_mutex_unlock (&q->lock);
+      bool up = edgex_endpoint_available (&q->svc->config.endpoints.data);
+      pthread_mutex_lock (&q->lock);
+      if (up && q->spillhead < q->spilltail)
+      {
+        uint64_t seq = q->spillhead++;
+        pthread_mutex_unlock (&q->lock);
+        edgex_event_cooked *event = edgex_postqueue_unspill (q, seq);
+        pthread_mutex_lock (&q->lock);
+        if (event)
+        {
+          edgex_postqueue_push
+            (q, edgex_postqueue_devq_get (q, event->device), event);
+        }
+        continue;
+      }
+      if (!up && q->running && q->ring == NULL)
+      {
+        uint64_t retry = edgex_postqueue_now () + REPLAY_RETRY;
+        struct timespec ts;
+        ts.tv_sec = retry / NS_PER_SEC;
+        ts.tv_nsec = retry % NS_PER_SEC;
+        pthread_cond_timedwait (&q->ready, &q->lock, &ts);
+        continue;
+      }
+    }
+
+    while (q->running && q->depth < q->batchsize)
+    {
+      if (q->ring == NULL)
+      {
+        pthread_cond_wait (&q->ready, &q->lock);
+        continue;
+      }
+      uint64_t deadline = edgex_postqueue_oldest (q) + q->timeout;
+      if (edgex_postqueue_now () >= deadline)
+      {
+        break;
+      }
+      struct timespec ts;
+      ts.tv_sec = deadline / NS_PER_SEC;
+      ts.tv_nsec = deadline % NS_PER_SEC;
+      pthread_cond_timedwait (&q->ready, &q->lock, &ts);
+    }
+    if (q->ring == NULL)
+    {
+      if (q->running)
+      {
+        continue;
+      }
+      break;
+    }
+
+    /* Take a batch, one event from each device in turn */
+
+    edgex_postqueue_entry *batch = NULL;
+    edgex_postqueue_entry *last = NULL;
+    uint32_t n = 0;
+    while (n < q->batchsize && q->ring)
+    {
+      edgex_postqueue_devq *d = q->ring;
+      q->ring = d->next;
+      edgex_postqueue_entry *entry = edgex_postqueue_pop (q, d);
+      if (last)
+      {
+        last->next = entry;
+      }
+      else
+      {
+        batch = entry;
+      }
+      last = entry;
+      n++;
+    }
+    pthread_cond_broadcast (&q->space);
+    if (q->ring)
+    {
+      pthread_cond_signal (&q->ready);
+    }
+    pthread_mutex_unlock (&q->lock);
+
+    uint32_t nposts = edgex_postqueue_flush (q, batch);
+    uint64_t now = edgex_postqueue_now ();
+
+    pthread_mutex_lock (&q->lock);
+    q->nposts += nposts;
+    q->nbatches++;
+    while (batch)
+    {
+      edgex_postqueue_entry *next = batch->next;
+      q->latency[q->latencypos] = now - batch->queued;
+      q->latencypos = (q->latencypos + 1) % LATENCY_SAMPLES;
+      if (q->nlatency < LATENCY_SAMPLES)
+      {
+        q->nlatency++;
+      }
+      edgex_mem_free (EDGEX_MEM_EVENTS, batch);
+      batch = next;
+    }
+  }
+  pthread_cond_signal (&q->ready);
+  pthread_mutex_unlock (&q->lock);
+  return NULL;
+}
+
+edgex_postqueue *edgex_postqueue_create (edgex_device_service *svc)
+{
+  pthread_condattr_t attr;
+  const edgex_device_deviceinfo *conf = &svc->config.device;
+  edgex_postqueue *q = malloc (sizeof (edgex_postqueue));
+
+  memset (q, 0, sizeof (edgex_postqueue));
+  q->svc = svc;
+  if (conf->eventbatchsize > 1)
+  {
+    q->batchsize = conf->eventbatchsize;
+    q->timeout = conf->eventbatchtimeout ?
+      conf->eventbatchtimeout : DEFAULT_BATCH_TIMEOUT;
+    q->timeout *= NS_PER_MS;
+  }
+  else
+  {
+    q->batchsize = 1;
+  }
+  q->capacity = conf->eventqueuesize ? conf->eventqueuesize : DEFAULT_QUEUE_SIZE;
+  if (q->capacity < q->batchsize)
+  {
+    q->capacity = q->batchsize;
+  }
+  q->nthreads =
+    conf->eventqueuethreads ? conf->eventqueuethreads : DEFAULT_QUEUE_THREADS;
+
+  q->policy = POLICY_BLOCK;
+  if (conf->eventqueuepolicy)
+  {
+    if (strcasecmp (conf->eventqueuepolicy, "DropOldest") == 0)
+    {
+      q->policy = POLICY_DROPOLDEST;
+    }
+    else if (strcasecmp (conf->eventqueuepolicy, "DropNewest") == 0)
+    {
+      q->policy = POLICY_DROPNEWEST;
+    }
+    else if (strcasecmp (conf->eventqueuepolicy, "Spill") == 0)
+    {
+      q->policy = POLICY_SPILL;
+    }
+  }
+
+  edgex_map_init (&q->devqs);
+  pthread_mutex_init (&q->lock, NULL);
+  pthread_mutex_init (&q->spilllock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&q->ready, &attr);
+  pthread_condattr_destroy (&attr);
+  pthread_cond_init (&q->space, NULL);
+  q->running = true;
+
+  if (q->policy == POLICY_SPILL)
+  {
+    q->spilldir = strdup (conf->eventqueuespilldir);
+    edgex_postqueue_spill_scan (q);
+  }
+
+  q->threads = malloc (sizeof (pthread_t) * q->nthreads);
+  for (uint32_t i = 0; i < q->nthreads; i++)
+  {
+    if (pthread_create (&q->threads[i], NULL, edgex_postqueue_thread, q) != 0)
+    {
+      iot_log_error (svc->logger, "Unable to start event dispatcher thread");
+      q->nthreads = i;
+      break;
+    }
+  }
+  if (q->nthreads == 0)
+  {
+    edgex_postqueue_free (q);
+    return NULL;
+  }
+  return q;
+}
+
+void edgex_postqueue_submit (edgex_postqueue *q, edgex_event_cooked *event)
+{
+  pthread_mutex_lock (&q->lock);
+  q->nevents++;
+
+  /* While there are events on disk, new events follow them there */
+
+  if (q->spillhead < q->spilltail)
+  {
+    pthread_mutex_unlock (&q->lock);
+    edgex_postqueue_spill (q, event);
+    return;
+  }
+
+  edgex_postqueue_devq *d = edgex_postqueue_devq_get (q, event->device);
+  while (q->running && q->depth >= q->capacity)
+  {
+    edgex_postqueue_devq *longest = edgex_postqueue_longest (q);
+    switch (q->policy)
+    {
+      case POLICY_BLOCK:
+        pthread_cond_wait (&q->space, &q->lock);
+        break;
+      case POLICY_DROPOLDEST:
+      {
+        edgex_postqueue_entry *entry = edgex_postqueue_pop (q, longest);
+        edgex_data_event_free (entry->event);
+        edgex_mem_free (EDGEX_MEM_EVENTS, entry);
+        q->ndropped++;
+        break;
+      }
+      case POLICY_DROPNEWEST:
+        if (d->depth >= longest->depth)
+        {
+          edgex_data_event_free (event);
+          q->ndropped++;
+          pthread_mutex_unlock (&q->lock);
+          return;
+        }
+        edgex_postqueue_drop_newest (q, longest);
+        break;
+      case POLICY_SPILL:
+        pthread_mutex_unlock (&q->lock);
+        edgex_postqueue_spill (q, event);
+        return;
+    }
+  }
+  edgex_postqueue_push (q, d, event);
+  pthread_mutex_unlock (&q->lock);
+}
+
+static int edgex_postqueue_cmp (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+void edgex_postqueue_metrics (edgex_postqueue *q, JSON_Object *obj)
+{
+  uint64_t samples[LATENCY_SAMPLES];
+  JSON_Value *qval = json_value_init_object ();
+  JSON_Object *qobj = json_value_get_object (qval);
+
+  pthread_mutex_lock (&q->lock);
+  uint32_t n = q->nlatency;
+  memcpy (samples, q->latency, n * sizeof (uint64_t));
+  json_object_set_number (qobj, "Depth", q->depth);
+  json_object_set_number (qobj, "Capacity", q->capacity);
+  json_object_set_number (qobj, "Events", q->nevents);
+  json_object_set_number (qobj, "Posts", q->nposts);
+  json_object_set_number (qobj, "Batches", q->nbatches);
+  json_object_set_number (qobj, "Dropped", q->ndropped);
+  json_object_set_number (qobj, "Spilled", q->nspilled);
+  json_object_set_number (qobj, "OnDisk", q->spilltail - q->spillhead);
+  pthread_mutex_unlock (&q->lock);
+
+  if (n)
+  {
+    qsort (samples, n, sizeof (uint64_t), edgex_postqueue_cmp);
+    json_object_set_number
+      (qobj, "LatencyP50", (double)samples[(n - 1) * 50 / 100] / NS_PER_MS);
+    json_object_set_number
+      (qobj, "LatencyP90", (double)samples[(n - 1) * 90 / 100] / NS_PER_MS);
+    json_object_set_number
+      (qobj, "LatencyP99", (double)samples[(n - 1) * 99 / 100] / NS_PER_MS);
+  }
+  json_object_set_value (obj, "EventQueue", qval);
+}
+
+void edgex_postqueue_free (edgex_postqueue *q)
+{
+  if (q)
+  {
+    pthread_mutex_lock (&q->lock);
+    q->running = false;
+    pthread_cond_broadcast (&q->ready);
+    pthread_cond_broadcast (&q->space);
+    pthread_mutex_unlock (&q->lock);
+    for (uint32_t i = 0; i < q->nthreads; i++)
+    {
+      pthread_join (q->threads[i], NULL);
+    }
+
+    const char *key;
+    edgex_map_iter i = edgex_map_iter (q->devqs);
+    while ((key = edgex_map_next (&q->devqs, &i)))
+    {
+      free (*edgex_map_get (&q->devqs, key));
+    }
+    edgex_map_deinit (&q->devqs);
+    pthread_cond_destroy (&q->space);
+    pthread_cond_destroy (&q->ready);
+    pthread_mutex_destroy (&q->spilllock);
+    pthread_mutex_destroy (&q->lock);
+    free (q->threads);
+    free (q->spilldir);
+    free (q);
+  }
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_POSTQUEUE_H_
+#define _EDGEX_DEVICE_POSTQUEUE_H_ 1
+
+#include "edgex/devsdk.h"
+#include "data.h"
+
+/*
+ * The post queue gathers events generated by asynchronous readings and
+ * submits them to core-data from a set of dispatcher threads. If batching is
+ * configured, a batch is flushed when it reaches EventBatchSize events or when
+ * its oldest event has waited for EventBatchTimeout milliseconds. Events for the same device within a batch are merged
+ * so that they are submitted in a single request.
+ *
+ * The queue is bounded. Events for each device are queued separately and
+ * batches are assembled from the devices in turn. When the queue is full the
+ * configured policy either blocks the caller, drops an event (from the
+ * device with the most events queued) or spills events to disk for replay.
+ * With the spill policy, events also go to disk while the circuit for
+ * core-data is open (Service/CircuitThreshold).
+ */
+
+typedef struct edgex_postqueue edgex_postqueue;
+
+edgex_postqueue *edgex_postqueue_create (edgex_device_service *svc);
+
+/* Queue an event for submission. The queue takes ownership of the event. */
+
+void edgex_postqueue_submit (edgex_postqueue *q, edgex_event_cooked *event);
+
+/* Add queue depth and latency statistics to a metrics object. */
+
+void edgex_postqueue_metrics (edgex_postqueue *q, JSON_Object *obj);
+
+/* Submit any events remaining in the queue, then free it. */
+
+void edgex_postqueue_free (edgex_postqueue *q);
+
+#endif
@@ -16,234 +16,827 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include <yaml.h>
 
 #define MAX_PATH_SIZE 256
 
+/*
+ * Profiles are uploaded in parallel on the executor. A manifest in the
+ * profiles directory records the hash of each file and the name of the
+ * profile it holds, so that files which have not changed since they were
+ * last uploaded need not be parsed again.
+ */
+
+#define MANIFEST_FILE ".profiles.manifest"
+#define UPLOAD_TASKS 8
+
+typedef struct manifest_entry
+{
+  uint64_t hash;
+  char *name;
+} manifest_entry;
+
+typedef edgex_map(manifest_entry) edgex_map_manifest;
+
+struct profile_upload;
+
+typedef struct profile_uploads
+{
+  edgex_device_service *svc;
+  bool listed;
+  edgex_map_manifest manifest;
+  pthread_mutex_t vdlock;
+  bool vdlisted;
+  edgex_map_int vdnames;
+  struct profile_upload *jobs;
+} profile_uploads;
+
+typedef struct profile_upload
+{
+  profile_uploads *all;
+  const char *fname;
+  const manifest_entry *prev;
+  char *profname;
+  uint64_t hash;
+  edgex_error err;
+} profile_upload;
+
+bool edgex_device_profile_isfile (const char *fname)
+{
+  size_t len = strlen (fname);
+  return len > 5 && strcasecmp (fname + len - 5, ".yaml") == 0;
+}
+
 static int yamlselect (const struct dirent *d)
 {
-  return strcasecmp (d->d_name + strlen (d->d_name) - 5, ".yaml") == 0 ? 1 : 0;
+  return edgex_device_profile_isfile (d->d_name) ? 1 : 0;
 }
 
-static void generate_value_descriptors
+/* FNV-1a */
+
+static uint64_t profile_hash (const char *data, size_t len)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (unsigned char) data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static void manifest_load (edgex_map_manifest *m, const char *dir)
+{
+  char pathname[MAX_PATH_SIZE];
+  char line[MAX_PATH_SIZE * 2];
+  FILE *f;
+
+  snprintf (pathname, MAX_PATH_SIZE, "%s/%s", dir, MANIFEST_FILE);
+  f = fopen (pathname, "r");
+  if (f == NULL)
+  {
+    return;
+  }
+  while (fgets (line, sizeof (line), f))
+  {
+    manifest_entry e;
+    char *fname;
+    char *tab;
+    char *end;
+
+    line[strcspn (line, "\n")] = '\0';
+    e.hash = strtoull (line, &fname, 16);
+    if (*fname++ != ' ' || (tab = strchr (fname, '\t')) == NULL)
+    {
+      continue;
+    }
+    *tab = '\0';
+    end = tab + 1;
+    manifest_entry *old = edgex_map_get (m, fname);
+    if (old)
+    {
+      free (old->name);
+    }
+    e.name = strdup (end);
+    edgex_map_set (m, fname, e);
+  }
+  fclose (f);
+}
+
+static void manifest_save
+  (iot_logging_client *lc, const char *dir, edgex_map_manifest *m)
+{
+  char pathname[MAX_PATH_SIZE];
+  char tmpname[MAX_PATH_SIZE];
+  const char *fname;
+  FILE *f;
+
+  snprintf (pathname, MAX_PATH_SIZE, "%s/%s", dir, MANIFEST_FILE);
+  snprintf (tmpname, MAX_PATH_SIZE, "%s/%s.tmp", dir, MANIFEST_FILE);
+  f = fopen (tmpname, "w");
+  if (f == NULL)
+  {
+    iot_log_debug (lc, "Unable to write profile manifest: %s", strerror (errno));
+    return;
+  }
+  edgex_map_iter iter = edgex_map_iter (*m);
+  while ((fname = edgex_map_next (m, &iter)))
+  {
+    const manifest_entry *e = edgex_map_get (m, fname);
+    if (strpbrk (e->name, "\t\n") == NULL)
+    {
+      fprintf (f, "%016" PRIx64 " %s\t%s\n", e->hash, fname, e->name);
+    }
+  }
+  if (fclose (f) != 0 || rename (tmpname, pathname) != 0)
+  {
+    iot_log_debug (lc, "Unable to write profile manifest: %s", strerror (errno));
+    unlink (tmpname);
+  }
+}
+
+static void manifest_free (edgex_map_manifest *m)
+{
+  const char *key;
+  edgex_map_iter iter = edgex_map_iter (*m);
+  while ((key = edgex_map_next (m, &iter)))
+  {
+    free (edgex_map_get (m, key)->name);
+  }
+  edgex_map_deinit (m);
+}
+
+void edgex_device_profile_manifest_update
 (
   edgex_device_service *svc,
-  const edgex_deviceprofile *dp
+  const char *fname,
+  uint64_t hash,
+  const char *name
 )
 {
-  uint64_t timenow = edgex_device_millitime ();
+  edgex_map_manifest m;
+  manifest_entry e;
+  manifest_entry *old;
 
-  for (edgex_deviceresource *res = dp->device_resources; res; res = res->next)
+  edgex_map_init (&m);
+  manifest_load (&m, svc->config.device.profilesdir);
+  old = edgex_map_get (&m, fname);
+  if (old)
   {
-    edgex_propertyvalue *pv = res->properties->value;
-    edgex_units *units = res->properties->units;
-    char type[2];
-    edgex_valuedescriptor *vd;
-    edgex_error err;
-    iot_logging_client *lc = svc->logger;
+    free (old->name);
+  }
+  e.hash = hash;
+  e.name = strdup (name);
+  edgex_map_set (&m, fname, e);
+  manifest_save (svc->logger, svc->config.device.profilesdir, &m);
+  manifest_free (&m);
+}
 
-    type[0] = edgex_propertytype_tostring (pv->type)[0];
-    type[1] = '\0';
-    vd = edgex_data_client_add_valuedescriptor
+static bool manifest_current (edgex_map_manifest *m, profile_upload *jobs, int n)
+{
+  int count = 0;
+  edgex_map_iter iter = edgex_map_iter (*m);
+
+  while (edgex_map_next (m, &iter))
+  {
+    count++;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    manifest_entry *e = edgex_map_get (m, jobs[i].fname);
+    if
     (
-      lc,
-      &svc->config.endpoints,
-      res->name,
-      timenow,
-      pv->minimum,
-      pv->maximum,
-      type,
-      units->defaultvalue,
-      pv->defaultvalue,
-      "%s",
-      res->description,
-      &err
-    );
-    if (err.code)
+      jobs[i].err.code || jobs[i].profname == NULL || e == NULL ||
+      e->hash != jobs[i].hash || strcmp (e->name, jobs[i].profname)
+    )
     {
-      iot_log_error (lc, "Unable to create ValueDescriptor for %s", res->name);
+      return false;
     }
-    edgex_valuedescriptor_free (vd);
   }
+  return count == n;
 }
 
-void edgex_device_profiles_upload
+static char *read_file (const char *pathname, size_t *len)
+{
+  char *result = NULL;
+  size_t cap = 0;
+  size_t n;
+  FILE *f = fopen (pathname, "r");
+
+  if (f == NULL)
+  {
+    return NULL;
+  }
+  *len = 0;
+  do
+  {
+    if (*len == cap)
+    {
+      cap = cap ? cap * 2 : 4096;
+      result = realloc (result, cap);
+    }
+    n = fread (result + *len, 1, cap - *len, f);
+    *len += n;
+  } while (n);
+  fclose (f);
+  return result;
+}
+
+/* Find the profile's name, the value of the first "name" key */
+
+static char *profile_name
 (
-  edgex_device_service *svc,
+  iot_logging_client *lc,
+  const char *data,
+  size_t len,
+  const char *fname,
   edgex_error *err
 )
 {
-  struct dirent **filenames = NULL;
-  int n;
-  char *fname;
-  char pathname[MAX_PATH_SIZE];
-  char *profname;
-  FILE *handle;
   yaml_parser_t parser;
   yaml_event_t event;
-  bool lastWasName;
-  edgex_deviceprofile *dp;
-  const char *profileDir = svc->config.device.profilesdir;
-  edgex_service_endpoints *endpoints = &svc->config.endpoints;
-  iot_logging_client *lc = svc->logger;
+  bool lastWasName = false;
+  bool done;
+  char *profname = NULL;
 
-  n = scandir (profileDir, &filenames, yamlselect, NULL);
-  if (n < 0)
+  if (!yaml_parser_initialize (&parser))
   {
-    if (errno == ENOENT || errno == ENOTDIR)
-    {
-       iot_log_error (lc, "No profiles directory found at %s", profileDir);
-    }
-    else
-    {
-      iot_log_error
-        (lc, "Error scanning profiles directory: %s", strerror (errno));
-    }
-    *err = EDGEX_PROFILES_DIRECTORY;
-    return;
+    iot_log_error
+      (lc, "YAML parser did not initialize - DeviceProfile upload disabled");
+    *err = EDGEX_PROFILE_PARSE_ERROR;
+    return NULL;
   }
-
-  while (n--)
+  yaml_parser_set_input_string (&parser, (const unsigned char *) data, len);
+  do
   {
-    profname = NULL;
-
-    if (!yaml_parser_initialize (&parser))
+    if (!yaml_parser_parse (&parser, &event))
     {
       iot_log_error
-        (lc, "YAML parser did not initialize - DeviceProfile upload disabled");
+        (lc, "Parser error %d for file %s", parser.error, fname);
       *err = EDGEX_PROFILE_PARSE_ERROR;
       break;
     }
-
-    fname = filenames[n]->d_name;
-    if (snprintf (pathname, MAX_PATH_SIZE, "%s/%s", profileDir, fname) >=
-        MAX_PATH_SIZE)
+    if (event.type == YAML_SCALAR_EVENT)
     {
-      iot_log_error
-        (lc, "%s: Pathname too long (max %d chars)", fname, MAX_PATH_SIZE - 1);
-      *err = EDGEX_PROFILE_PARSE_ERROR;
-      break;
+      if (lastWasName)
+      {
+        profname = strdup ((char *) event.data.scalar.value);
+      }
+      else
+      {
+        lastWasName =
+          (strcasecmp ((char *) event.data.scalar.value, "name") == 0);
+      }
     }
-
-    handle = fopen (pathname, "r");
-    if (handle)
+    else
     {
       lastWasName = false;
-      yaml_parser_set_input_file (&parser, handle);
-      do
+    }
+    done = (profname || event.type == YAML_STREAM_END_EVENT);
+    yaml_event_delete (&event);
+  } while (!done);
+  yaml_parser_delete (&parser);
+  return profname;
+}
+
+/*
+ * Convert the YAML node which starts with event ev to JSON. Mappings become
+ * objects and sequences arrays; scalars are kept as strings, as the profile
+ * reader expects. Aliases and non-scalar keys are not supported.
+ */
+
+#define YAML_MAXDEPTH 32
+
+static JSON_Value *yaml_node
+  (yaml_parser_t *parser, const yaml_event_t *ev, unsigned depth)
+{
+  JSON_Value *result = NULL;
+  JSON_Value *val;
+  yaml_event_t next;
+  char *key;
+
+  if (depth > YAML_MAXDEPTH)
+  {
+    return NULL;
+  }
+  switch (ev->type)
+  {
+    case YAML_SCALAR_EVENT:
+      return json_value_init_string ((char *) ev->data.scalar.value);
+
+    case YAML_SEQUENCE_START_EVENT:
+      result = json_value_init_array ();
+      while (yaml_parser_parse (parser, &next))
       {
-        if (!yaml_parser_parse (&parser, &event))
+        if (next.type == YAML_SEQUENCE_END_EVENT)
         {
-          iot_log_error
-            (lc, "Parser error %d for file %s", parser.error, fname);
-          *err = EDGEX_PROFILE_PARSE_ERROR;
-          break;
+          yaml_event_delete (&next);
+          return result;
         }
-        if (event.type == YAML_SCALAR_EVENT)
+        val = yaml_node (parser, &next, depth + 1);
+        yaml_event_delete (&next);
+        if (val == NULL)
         {
-          if (lastWasName)
-          {
-            profname = strdup ((char *) event.data.scalar.value);
-            break;
-          }
-          else
-          {
-            lastWasName =
-              (strcasecmp ((char *) event.data.scalar.value, "name") == 0);
-          }
+          break;
         }
-        else
+        json_array_append_value (json_value_get_array (result), val);
+      }
+      break;
+
+    case YAML_MAPPING_START_EVENT:
+      result = json_value_init_object ();
+      while (yaml_parser_parse (parser, &next))
+      {
+        if (next.type == YAML_MAPPING_END_EVENT)
         {
-          lastWasName = false;
+          yaml_event_delete (&next);
+          return result;
         }
-        if (event.type != YAML_STREAM_END_EVENT)
+        if (next.type != YAML_SCALAR_EVENT)
         {
-          yaml_event_delete (&event);
+          yaml_event_delete (&next);
+          break;
         }
-      } while (event.type != YAML_STREAM_END_EVENT);
-      yaml_event_delete (&event);
-
-      fclose (handle);
-      if (err->code)
-      {
-        break;
-      }
-
-      if (profname)
-      {
-        iot_log_debug
-          (lc, "Checking existence of DeviceProfile %s", profname);
-        dp = edgex_metadata_client_get_deviceprofile
-          (lc, endpoints, profname, err);
-        if (err->code == EDGEX_PROFILE_PARSE_ERROR.code)
+        key = strdup ((char *) next.data.scalar.value);
+        yaml_event_delete (&next);
+        if (!yaml_parser_parse (parser, &next))
         {
-          iot_log_error (lc, "Profile %s exists but has errors", profname);
+          free (key);
           break;
         }
-        if (dp)
+        val = yaml_node (parser, &next, depth + 1);
+        yaml_event_delete (&next);
+        if (val)
         {
-          iot_log_debug
-            (lc, "DeviceProfile %s already exists: skipped", profname);
-          if (edgex_map_get (&svc->profiles, profname))
-          {
-            edgex_deviceprofile_free (dp);
-          }
-          else
-          {
-            edgex_map_set (&svc->profiles, profname, dp);
-          }
+          json_object_set_value (json_value_get_object (result), key, val);
         }
-        else
+        free (key);
+        if (val == NULL)
         {
-          *err = EDGEX_OK;
-          iot_log_debug (lc, "Uploading deviceprofile from %s", pathname);
-          free (edgex_metadata_client_create_deviceprofile_file
-                  (lc, endpoints, pathname, err));
-          if (err->code)
-          {
-            iot_log_error (lc, "Error uploading device profile");
-            break;
-          }
-          else
-          {
-            iot_log_debug
-              (lc, "Device profile upload successful, will now retrieve it");
-            dp = edgex_metadata_client_get_deviceprofile
-              (lc, endpoints, profname, err);
-            if (dp)
-            {
-              iot_log_debug
-                (lc, "Generating value descriptors DeviceProfile %s", profname);
-              generate_value_descriptors (svc, dp);
-              edgex_map_set (&svc->profiles, profname, dp);
-            }
-            else
-            {
-              iot_log_error
-                (lc, "Failed to retrieve DeviceProfile %s", profname);
-              break;
-            }
-          }
+          break;
         }
-        free (profname);
       }
-      else
-      {
-        iot_log_error (lc, "No device profile name found in %s", fname);
-        *err = EDGEX_PROFILE_PARSE_ERROR;
+      break;
+
+    default:
+      break;
+  }
+  json_value_free (result);
+  return NULL;
+}
+
+static JSON_Value *yaml_to_json
+  (iot_logging_client *lc, const char *data, size_t len, const char *fname)
+{
+  yaml_parser_t parser;
+  yaml_event_t event;
+  JSON_Value *result = NULL;
+  bool done = false;
+
+  if (!yaml_parser_initialize (&parser))
+  {
+    iot_log_error (lc, "YAML parser did not initialize");
+    return NULL;
+  }
+  yaml_parser_set_input_string (&parser, (const unsigned char *) data, len);
+  while (!done && yaml_parser_parse (&parser, &event))
+  {
+    switch (event.type)
+    {
+      case YAML_SCALAR_EVENT:
+      case YAML_SEQUENCE_START_EVENT:
+      case YAML_MAPPING_START_EVENT:
+        result = yaml_node (&parser, &event, 0);
+        done = true;
+        break;
+      case YAML_STREAM_END_EVENT:
+        done = true;
         break;
+      default:
+        break;
+    }
+    yaml_event_delete (&event);
+  }
+  if (result == NULL)
+  {
+    iot_log_error
+      (lc, "Parser error %d for file %s", parser.error, fname);
+  }
+  yaml_parser_delete (&parser);
+  return result;
+}
+
+JSON_Value *edgex_device_profile_parse
+  (edgex_device_service *svc, const char *fname, uint64_t *hash)
+{
+  const char *dir = svc->config.device.profilesdir;
+  char pathname[MAX_PATH_SIZE];
+  JSON_Value *result;
+  char *data;
+  size_t len;
+
+  if (snprintf (pathname, MAX_PATH_SIZE, "%s/%s", dir, fname) >= MAX_PATH_SIZE)
+  {
+    iot_log_error
+    (
+      svc->logger, "%s: Pathname too long (max %d chars)",
+      fname, MAX_PATH_SIZE - 1
+    );
+    return NULL;
+  }
+  data = read_file (pathname, &len);
+  if (data == NULL)
+  {
+    iot_log_error (svc->logger, "Unable to open %s for reading", fname);
+    return NULL;
+  }
+  *hash = profile_hash (data, len);
+  result = yaml_to_json (svc->logger, data, len, fname);
+  free (data);
+  return result;
+}
+
+/* Add a profile to the service's map, unless one of that name is there */
+
+static void profile_add
+  (edgex_device_service *svc, const char *name, edgex_deviceprofile *dp)
+{
+  pthread_mutex_lock (&svc->profileslock);
+  if (edgex_map_get (&svc->profiles, name))
+  {
+    edgex_deviceprofile_free (dp);
+  }
+  else
+  {
+    edgex_map_set (&svc->profiles, name, dp);
+  }
+  pthread_mutex_unlock (&svc->profileslock);
+}
+
+/*
+ * Value descriptors known to core-data are listed once, and the names of
+ * those created since are added, so that each is only posted by one upload.
+ */
+
+static bool vd_claim (profile_uploads *all, const char *name)
+{
+  bool result = false;
+  pthread_mutex_lock (&all->vdlock);
+  if (!all->vdlisted)
+  {
+    edgex_error err = EDGEX_OK;
+    edgex_data_client_get_valuedescriptor_names
+      (all->svc->logger, &all->svc->config.endpoints, &all->vdnames, &err);
+    all->vdlisted = true;
+  }
+  if (edgex_map_get (&all->vdnames, name) == NULL)
+  {
+    edgex_map_set (&all->vdnames, name, 1);
+    result = true;
+  }
+  pthread_mutex_unlock (&all->vdlock);
+  return result;
+}
+
+void edgex_device_profile_add_valuedescriptor
+(
+  edgex_device_service *svc,
+  const edgex_deviceresource *res,
+  uint64_t timenow
+)
+{
+  edgex_propertyvalue *pv = res->properties->value;
+  edgex_units *units = res->properties->units;
+  char type[2];
+  edgex_valuedescriptor *vd;
+  edgex_error err;
+  iot_logging_client *lc = svc->logger;
+
+  type[0] = edgex_propertytype_tostring (pv->type)[0];
+  type[1] = '\0';
+  vd = edgex_data_client_add_valuedescriptor
+  (
+    lc,
+    &svc->config.endpoints,
+    res->name,
+    timenow,
+    pv->minimum,
+    pv->maximum,
+    type,
+    units->defaultvalue,
+    pv->defaultvalue,
+    "%s",
+    res->description,
+    &err
+  );
+  if (err.code)
+  {
+    iot_log_error (lc, "Unable to create ValueDescriptor for %s", res->name);
+  }
+  edgex_valuedescriptor_free (vd);
+}
+
+edgex_valuedescriptor *edgex_device_profile_valuedescriptor
+  (const edgex_deviceresource *res, uint64_t timenow)
+{
+  edgex_propertyvalue *pv = res->properties->value;
+  edgex_valuedescriptor *vd = calloc (1, sizeof (edgex_valuedescriptor));
+  char type[2];
+
+  type[0] = edgex_propertytype_tostring (pv->type)[0];
+  type[1] = '\0';
+  vd->origin = timenow;
+  vd->name = strdup (res->name);
+  vd->min = strdup (pv->minimum);
+  vd->max = strdup (pv->maximum);
+  vd->type = strdup (type);
+  vd->uomLabel = strdup (res->properties->units->defaultvalue);
+  vd->defaultValue = strdup (pv->defaultvalue);
+  vd->formatting = strdup ("%s");
+  vd->description = strdup (res->description);
+  return vd;
+}
+
+void edgex_device_profile_update_valuedescriptor
+(
+  edgex_device_service *svc,
+  const edgex_deviceresource *res,
+  uint64_t timenow
+)
+{
+  edgex_error err = EDGEX_OK;
+  edgex_valuedescriptor *vd =
+    edgex_device_profile_valuedescriptor (res, timenow);
+
+  edgex_data_client_update_valuedescriptor
+    (svc->logger, &svc->config.endpoints, vd, &err);
+  if (err.code)
+  {
+    iot_log_info
+    (
+      svc->logger, "Unable to update ValueDescriptor for %s, adding",
+      res->name
+    );
+    edgex_device_profile_add_valuedescriptor (svc, res, timenow);
+  }
+  edgex_valuedescriptor_free (vd);
+}
+
+static void generate_value_descriptors
+(
+  profile_uploads *all,
+  const edgex_deviceprofile *dp
+)
+{
+  uint64_t timenow = edgex_device_millitime ();
+
+  for (edgex_deviceresource *res = dp->device_resources; res; res = res->next)
+  {
+    if (vd_claim (all, res->name))
+    {
+      edgex_device_profile_add_valuedescriptor (all->svc, res, timenow);
+    }
+  }
+}
+
+static void profile_upload_run (void *arg)
+{
+  profile_upload *u = (profile_upload *) arg;
+  profile_uploads *all = u->all;
+  edgex_device_service *svc = all->svc;
+  edgex_service_endpoints *endpoints = &svc->config.endpoints;
+  iot_logging_client *lc = svc->logger;
+  const char *profileDir = svc->config.device.profilesdir;
+  char pathname[MAX_PATH_SIZE];
+  edgex_deviceprofile *dp;
+  const manifest_entry *m = u->prev;
+  bool exists;
+  char *data;
+  size_t len;
+
+  if (snprintf (pathname, MAX_PATH_SIZE, "%s/%s", profileDir, u->fname) >=
+      MAX_PATH_SIZE)
+  {
+    iot_log_error
+      (lc, "%s: Pathname too long (max %d chars)", u->fname, MAX_PATH_SIZE - 1);
+    u->err = EDGEX_PROFILE_PARSE_ERROR;
+    return;
+  }
+
+  data = read_file (pathname, &len);
+  if (data == NULL)
+  {
+    iot_log_error (lc, "Unable to open %s for reading", u->fname);
+    u->err = EDGEX_PROFILE_PARSE_ERROR;
+    return;
+  }
+  u->hash = profile_hash (data, len);
+  if (m && m->hash == u->hash)
+  {
+    u->profname = strdup (m->name);
+  }
+  else
+  {
+    u->profname = profile_name (lc, data, len, u->fname, &u->err);
+  }
+  free (data);
+  if (u->profname == NULL)
+  {
+    if (u->err.code == 0)
+    {
+      iot_log_error (lc, "No device profile name found in %s", u->fname);
+      u->err = EDGEX_PROFILE_PARSE_ERROR;
+    }
+    return;
+  }
+
+  if (all->listed)
+  {
+    pthread_mutex_lock (&svc->profileslock);
+    exists = edgex_map_get (&svc->profiles, u->profname) != NULL;
+    pthread_mutex_unlock (&svc->profileslock);
+  }
+  else
+  {
+    iot_log_debug
+      (lc, "Checking existence of DeviceProfile %s", u->profname);
+    dp = edgex_metadata_client_get_deviceprofile
+      (lc, endpoints, u->profname, &u->err);
+    if (u->err.code == EDGEX_PROFILE_PARSE_ERROR.code)
+    {
+      iot_log_error (lc, "Profile %s exists but has errors", u->profname);
+      return;
+    }
+    u->err = EDGEX_OK;
+    exists = (dp != NULL);
+    if (dp)
+    {
+      profile_add (svc, u->profname, dp);
+    }
+  }
+  if (exists)
+  {
+    if (m && m->hash != u->hash)
+    {
+      iot_log_info
+      (
+        lc, "%s has changed, but DeviceProfile %s already exists: skipped",
+        u->fname, u->profname
+      );
+    }
+    iot_log_debug
+      (lc, "DeviceProfile %s already exists: skipped", u->profname);
+    return;
+  }
+
+  iot_log_debug (lc, "Uploading deviceprofile from %s", pathname);
+  free (edgex_metadata_client_create_deviceprofile_file
+          (lc, endpoints, pathname, &u->err));
+  if (u->err.code)
+  {
+    iot_log_error (lc, "Error uploading device profile");
+    return;
+  }
+  iot_log_debug
+    (lc, "Device profile upload successful, will now retrieve it");
+  dp = edgex_metadata_client_get_deviceprofile
+    (lc, endpoints, u->profname, &u->err);
+  if (dp)
+  {
+    iot_log_debug
+      (lc, "Generating value descriptors DeviceProfile %s", u->profname);
+    generate_value_descriptors (all, dp);
+    profile_add (svc, u->profname, dp);
+  }
+  else
+  {
+    iot_log_error
+      (lc, "Failed to retrieve DeviceProfile %s", u->profname);
+    if (u->err.code == 0)
+    {
+      u->err = EDGEX_PROFILE_PARSE_ERROR;
+    }
+  }
+}
+
+static void profile_uploads_run (void *arg, unsigned i)
+{
+  profile_upload_run (&((profile_uploads *) arg)->jobs[i]);
+}
+
+void edgex_device_profiles_upload
+(
+  edgex_device_service *svc,
+  edgex_error *err
+)
+{
+  struct dirent **filenames = NULL;
+  int n;
+  profile_uploads uploads;
+  profile_uploads *all = &uploads;
+  profile_upload *jobs;
+  edgex_deviceprofile **existing;
+  unsigned nexisting;
+  edgex_error e = EDGEX_OK;
+  const char *profileDir = svc->config.device.profilesdir;
+  iot_logging_client *lc = svc->logger;
+
+  n = scandir (profileDir, &filenames, yamlselect, NULL);
+  if (n < 0)
+  {
+    if (errno == ENOENT || errno == ENOTDIR)
+    {
+       iot_log_error (lc, "No profiles directory found at %s", profileDir);
+    }
+    else
+    {
+      iot_log_error
+        (lc, "Error scanning profiles directory: %s", strerror (errno));
+    }
+    *err = EDGEX_PROFILES_DIRECTORY;
+    return;
+  }
+
+  memset (all, 0, sizeof (profile_uploads));
+  all->svc = svc;
+  pthread_mutex_init (&all->vdlock, NULL);
+  edgex_map_init (&all->manifest);
+  edgex_map_init (&all->vdnames);
+  manifest_load (&all->manifest, profileDir);
+
+  /* One listing of the profiles in metadata saves a request per file. If
+   * it is not available, each upload checks for its own profile.
+   */
+
+  if (n)
+  {
+    existing = edgex_metadata_client_get_deviceprofiles
+      (lc, &svc->config.endpoints, &nexisting, &e);
+    if (e.code == 0)
+    {
+      all->listed = true;
+      for (unsigned i = 0; i < nexisting; i++)
+      {
+        profile_add (svc, existing[i]->name, existing[i]);
       }
     }
     else
     {
-      iot_log_error (lc, "Unable to open %s for reading", fname);
-      *err = EDGEX_PROFILE_PARSE_ERROR;
-      break;
+      iot_log_debug (lc, "Listing of DeviceProfiles unavailable");
     }
-    free (filenames[n]);
-    yaml_parser_delete (&parser);
+    free (existing);
+  }
+
+  jobs = calloc (n ? n : 1, sizeof (profile_upload));
+  for (int i = 0; i < n; i++)
+  {
+    jobs[i].all = all;
+    jobs[i].fname = filenames[i]->d_name;
+    jobs[i].prev = edgex_map_get (&all->manifest, jobs[i].fname);
+  }
+  all->jobs = jobs;
+  edgex_executor_forall
+  (
+    svc->executor, EDGEX_EXEC_COMMAND, n, UPLOAD_TASKS, profile_uploads_run,
+    all
+  );
+
+  for (int i = 0; i < n; i++)
+  {
+    if (jobs[i].err.code && err->code == 0)
+    {
+      *err = jobs[i].err;
+    }
+  }
+  if (!manifest_current (&all->manifest, jobs, n))
+  {
+    edgex_map_manifest current;
+    edgex_map_init (&current);
+    for (int i = 0; i < n; i++)
+    {
+      if (jobs[i].err.code == 0 && jobs[i].profname)
+      {
+        manifest_entry e = { jobs[i].hash, strdup (jobs[i].profname) };
+        edgex_map_set (&current, jobs[i].fname, e);
+      }
+    }
+    manifest_save (lc, profileDir, &current);
+    manifest_free (&current);
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    free (jobs[i].profname);
+    free (filenames[i]);
   }
   free (filenames);
+
+  manifest_free (&all->manifest);
+  edgex_map_deinit (&all->vdnames);
+  pthread_mutex_destroy (&all->vdlock);
+  free (jobs);
 }
 
 edgex_deviceprofile *edgex_deviceprofile_get
@@ -264,17 +857,39 @@ edgex_deviceprofile *edgex_deviceprofile_get
       (svc->logger, &svc->config.endpoints, name, err);
     if (dp)
     {
-      edgex_map_set (&svc->profiles, name, edgex_deviceprofile_dup (dp));
+      edgex_map_set (&svc->profiles, name, edgex_deviceprofile_ref (dp));
     }
   }
   else
   {
-    dp = edgex_deviceprofile_dup (*dpp);
+    dp = edgex_deviceprofile_ref (*dpp);
   }
   pthread_mutex_unlock (&svc->profileslock);
   return dp;
 }
 
+edgex_deviceprofile *edgex_deviceprofile_intern
+  (edgex_device_service *svc, edgex_deviceprofile *dp)
+{
+  edgex_deviceprofile **dpp;
+  edgex_deviceprofile *result;
+
+  pthread_mutex_lock (&svc->profileslock);
+  dpp = edgex_map_get (&svc->profiles, dp->name);
+  if (dpp)
+  {
+    result = edgex_deviceprofile_ref (*dpp);
+    edgex_deviceprofile_free (dp);
+  }
+  else
+  {
+    edgex_map_set (&svc->profiles, dp->name, dp);
+    result = edgex_deviceprofile_ref (dp);
+  }
+  pthread_mutex_unlock (&svc->profileslock);
+  return result;
+}
+
 void edgex_device_service_getprofiles
 (
   edgex_device_service *svc,
@@ -301,3 +916,60 @@ void edgex_device_service_getprofiles
   }
   pthread_mutex_unlock (&svc->profileslock);
 }
+
+void edgex_deviceprofile_move_users
+  (edgex_devmap *update, edgex_deviceprofile *profile)
+{
+  edgex_map_iter iter = edgex_map_iter (update->devices);
+  edgex_device **users = NULL;
+  unsigned nusers = 0;
+  edgex_device *dev;
+
+  while ((dev = edgex_devmap_next (update, &iter)))
+  {
+    if
+    (
+      dev->profile != profile &&
+      strcmp (dev->profile->name, profile->name) == 0
+    )
+    {
+      users = realloc (users, (nusers + 1) * sizeof (edgex_device *));
+      users[nusers++] = dev;
+    }
+  }
+  for (unsigned i = 0; i < nusers; i++)
+  {
+    edgex_device *moved = edgex_device_dup (users[i]);
+    edgex_deviceprofile_free (moved->profile);
+    moved->profile = edgex_deviceprofile_ref (profile);
+    edgex_devmap_remove (update, users[i]);
+    edgex_devmap_add (update, moved);
+  }
+  free (users);
+}
+
+void edgex_deviceprofile_replace
+  (edgex_device_service *svc, edgex_deviceprofile *dp)
+{
+  edgex_deviceprofile **dpp;
+  edgex_deviceprofile *old = NULL;
+  edgex_devmap *update;
+
+  pthread_mutex_lock (&svc->profileslock);
+  dpp = edgex_map_get (&svc->profiles, dp->name);
+  if (dpp)
+  {
+    old = *dpp;
+    *dpp = dp;
+  }
+  else
+  {
+    edgex_map_set (&svc->profiles, dp->name, dp);
+  }
+  pthread_mutex_unlock (&svc->profileslock);
+
+  update = edgex_devreg_begin (svc->devices);
+  edgex_deviceprofile_move_users (update, dp);
+  edgex_devreg_commit (svc->devices, update);
+  edgex_deviceprofile_free (old);
+}
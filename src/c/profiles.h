@@ -10,6 +10,7 @@
 #define _EDGEX_DEVICE_PROFILES_H_ 1
 
 #include "service.h"
+#include "parson.h"
 
 extern void edgex_device_profiles_upload
 (
@@ -17,6 +18,14 @@ extern void edgex_device_profiles_upload
   edgex_error *err
 );
 
+/*
+ * Profiles are held once, in svc->profiles, and shared by the devices which
+ * use them. These functions return a reference to the shared instance, to be
+ * released with edgex_deviceprofile_free.
+ */
+
+/* Find a profile, retrieving it from metadata if it is not yet known */
+
 edgex_deviceprofile *edgex_deviceprofile_get
 (
   edgex_device_service *svc,
@@ -24,4 +33,74 @@ edgex_deviceprofile *edgex_deviceprofile_get
   edgex_error *err
 );
 
+/*
+ * Exchange a reference to a profile for one to the shared profile of the
+ * same name. If there is none, the given profile becomes the shared one.
+ */
+
+edgex_deviceprofile *edgex_deviceprofile_intern
+  (edgex_device_service *svc, edgex_deviceprofile *dp);
+
+/* Move devices using an older version of a profile to the newer one */
+
+void edgex_deviceprofile_move_users
+  (edgex_devmap *update, edgex_deviceprofile *profile);
+
+/*
+ * Make a profile the shared one of its name, taking the caller's reference,
+ * and move the devices which use the previous version to it.
+ */
+
+void edgex_deviceprofile_replace
+  (edgex_device_service *svc, edgex_deviceprofile *dp);
+
+/* Whether a file name in the profiles directory is that of a profile */
+
+bool edgex_device_profile_isfile (const char *fname);
+
+/*
+ * Read a profile file from the profiles directory as JSON, also returning
+ * the hash of its contents. Returns NULL, having logged the reason, if the
+ * file can not be read or is not valid YAML.
+ */
+
+JSON_Value *edgex_device_profile_parse
+  (edgex_device_service *svc, const char *fname, uint64_t *hash);
+
+/* Record in the manifest the hash of a file and the profile it holds */
+
+void edgex_device_profile_manifest_update
+(
+  edgex_device_service *svc,
+  const char *fname,
+  uint64_t hash,
+  const char *name
+);
+
+/* Create the value descriptor for a device resource in core-data */
+
+void edgex_device_profile_add_valuedescriptor
+(
+  edgex_device_service *svc,
+  const edgex_deviceresource *res,
+  uint64_t timenow
+);
+
+/* The value descriptor which describes a device resource */
+
+edgex_valuedescriptor *edgex_device_profile_valuedescriptor
+  (const edgex_deviceresource *res, uint64_t timenow);
+
+/*
+ * Replace the value descriptor for a device resource whose definition has
+ * changed, creating it if core-data does not have it.
+ */
+
+void edgex_device_profile_update_valuedescriptor
+(
+  edgex_device_service *svc,
+  const edgex_deviceresource *res,
+  uint64_t timenow
+);
+
 #endif
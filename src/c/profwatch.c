@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "profwatch.h"
+#include "profiles.h"
+#include "service.h"
+#include "metadata.h"
+#include "cmdplan.h"
+#include "edgex_rest.h"
+#include "edgex_time.h"
+#include "errorlist.h"
+#include "parson.h"
+#include "map.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+/*
+ * Editors and copies may write a file in several steps, so changed files
+ * are collected until no event has arrived for this many milliseconds.
+ */
+
+#define PROFWATCH_SETTLE 250
+
+#define MAX_PATH_SIZE 256
+
+/* The last version seen of each profile file */
+
+typedef struct profwatch_file
+{
+  uint64_t hash;
+  JSON_Value *json;
+} profwatch_file;
+
+typedef edgex_map(profwatch_file) edgex_map_profwatch_file;
+
+struct edgex_profwatch
+{
+  edgex_device_service *svc;
+  int fd;
+  int stopfd;
+  edgex_map_profwatch_file files;
+  pthread_t thread;
+};
+
+typedef struct profwatch_diff
+{
+  unsigned added;
+  unsigned changed;
+  unsigned removed;
+  bool other;
+} profwatch_diff;
+
+static JSON_Object *find_resource (JSON_Array *resources, const char *name)
+{
+  size_t count = json_array_get_count (resources);
+  for (size_t i = 0; i < count; i++)
+  {
+    JSON_Object *res = json_array_get_object (resources, i);
+    const char *n = json_object_get_string (res, "name");
+    if (n && strcmp (n, name) == 0)
+    {
+      return res;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Compare two versions of a profile. Device resources are matched by name;
+ * any other difference, in commands or in the profile's own fields, is
+ * noted as a whole.
+ */
+
+static void profwatch_compare
+  (const JSON_Value *oldv, const JSON_Value *newv, profwatch_diff *d)
+{
+  JSON_Object *oldp = json_value_get_object (oldv);
+  JSON_Object *newp = json_value_get_object (newv);
+  JSON_Array *oldres = json_object_get_array (oldp, "deviceResources");
+  JSON_Array *newres = json_object_get_array (newp, "deviceResources");
+  size_t count;
+
+  memset (d, 0, sizeof (profwatch_diff));
+  count = json_array_get_count (newres);
+  for (size_t i = 0; i < count; i++)
+  {
+    JSON_Object *res = json_array_get_object (newres, i);
+    const char *name = json_object_get_string (res, "name");
+    JSON_Object *prev = name ? find_resource (oldres, name) : NULL;
+    if (prev == NULL)
+    {
+      d->added++;
+    }
+    else if
+    (
+      !json_value_equals
+      (
+        json_object_get_wrapping_value (prev),
+        json_object_get_wrapping_value (res)
+      )
+    )
+    {
+      d->changed++;
+    }
+  }
+  count = json_array_get_count (oldres);
+  for (size_t i = 0; i < count; i++)
+  {
+    const char *name =
+      json_object_get_string (json_array_get_object (oldres, i), "name");
+    if (name == NULL || find_resource (newres, name) == NULL)
+    {
+      d->removed++;
+    }
+  }
+
+  count = json_object_get_count (newp);
+  for (size_t i = 0; i < count && !d->other; i++)
+  {
+    const char *key = json_object_get_name (newp, i);
+    if (strcmp (key, "deviceResources"))
+    {
+      d->other = !json_value_equals
+        (json_object_get_value (oldp, key), json_object_get_value (newp, key));
+    }
+  }
+  if (json_object_get_count (oldp) != count)
+  {
+    d->other = true;
+  }
+}
+
+static bool profwatch_streq (const char *a, const char *b)
+{
+  return (a && b) ? strcmp (a, b) == 0 : a == b;
+}
+
+/* Whether two definitions of a resource give the same value descriptor */
+
+static bool profwatch_samevd
+  (const edgex_deviceresource *a, const edgex_deviceresource *b)
+{
+  const edgex_propertyvalue *av = a->properties->value;
+  const edgex_propertyvalue *bv = b->properties->value;
+  const edgex_units *au = a->properties->units;
+  const edgex_units *bu = b->properties->units;
+  return av->type == bv->type &&
+    profwatch_streq (av->minimum, bv->minimum) &&
+    profwatch_streq (av->maximum, bv->maximum) &&
+    profwatch_streq (av->defaultvalue, bv->defaultvalue) &&
+    profwatch_streq (au->defaultvalue, bu->defaultvalue) &&
+    profwatch_streq (a->description, b->description);
+}
+
+edgex_profwatch_change edgex_profwatch_resource_change
+(
+  const edgex_deviceresource *res,
+  const JSON_Value *newv,
+  const JSON_Value *oldv,
+  const edgex_deviceprofile *cached
+)
+{
+  if (oldv)
+  {
+    JSON_Object *prev = find_resource
+    (
+      json_object_get_array (json_value_get_object (oldv), "deviceResources"),
+      res->name
+    );
+    JSON_Object *cur = find_resource
+    (
+      json_object_get_array (json_value_get_object (newv), "deviceResources"),
+      res->name
+    );
+    if (prev == NULL)
+    {
+      return EDGEX_PROFWATCH_ADDED;
+    }
+    return json_value_equals
+    (
+      json_object_get_wrapping_value (prev),
+      json_object_get_wrapping_value (cur)
+    ) ? EDGEX_PROFWATCH_SAME : EDGEX_PROFWATCH_CHANGED;
+  }
+  for (const edgex_deviceresource *r = cached ? cached->device_resources : NULL;
+       r; r = r->next)
+  {
+    if (strcmp (r->name, res->name) == 0)
+    {
+      return profwatch_samevd (r, res) ?
+        EDGEX_PROFWATCH_SAME : EDGEX_PROFWATCH_CHANGED;
+    }
+  }
+  return EDGEX_PROFWATCH_ADDED;
+}
+
+static void profwatch_remember
+  (edgex_profwatch *w, const char *fname, uint64_t hash, JSON_Value *json)
+{
+  profwatch_file *f = edgex_map_get (&w->files, fname);
+  if (f)
+  {
+    json_value_free (f->json);
+    f->hash = hash;
+    f->json = json;
+  }
+  else
+  {
+    profwatch_file entry = { hash, json };
+    edgex_map_set (&w->files, fname, entry);
+  }
+}
+
+/* Send the new version of a profile to metadata */
+
+static void profwatch_upload
+(
+  edgex_profwatch *w,
+  const char *fname,
+  JSON_Value *json,
+  const edgex_deviceprofile *cached,
+  edgex_error *err
+)
+{
+  edgex_device_service *svc = w->svc;
+  char pathname[MAX_PATH_SIZE];
+
+  if (cached)
+  {
+    JSON_Value *body = json_value_deep_copy (json);
+    char *str;
+    if (cached->id)
+    {
+      json_object_set_string (json_value_get_object (body), "id", cached->id);
+    }
+    str = json_serialize_to_string (body);
+    edgex_metadata_client_update_deviceprofile_json
+      (svc->logger, &svc->config.endpoints, str, err);
+    json_free_serialized_string (str);
+    json_value_free (body);
+  }
+  else
+  {
+    snprintf
+      (pathname, MAX_PATH_SIZE, "%s/%s", svc->config.device.profilesdir, fname);
+    free (edgex_metadata_client_create_deviceprofile_file
+            (svc->logger, &svc->config.endpoints, pathname, err));
+  }
+}
+
+static void profwatch_reload (edgex_profwatch *w, const char *fname)
+{
+  edgex_device_service *svc = w->svc;
+  iot_logging_client *lc = svc->logger;
+  edgex_error err = EDGEX_OK;
+  edgex_deviceprofile *dp;
+  edgex_deviceprofile *cached;
+  edgex_deviceprofile *fetched;
+  profwatch_diff diff;
+  uint64_t hash;
+  uint64_t timenow;
+  const char *name;
+  char *str;
+  JSON_Value *json = edgex_device_profile_parse (svc, fname, &hash);
+  profwatch_file *prev = edgex_map_get (&w->files, fname);
+  const JSON_Value *oldv = prev ? prev->json : NULL;
+
+  if (json == NULL || (prev && prev->hash == hash))
+  {
+    json_value_free (json);
+    return;
+  }
+  name = json_object_get_string (json_value_get_object (json), "name");
+  if (name == NULL)
+  {
+    iot_log_error (lc, "No device profile name found in %s", fname);
+    json_value_free (json);
+    return;
+  }
+  if (oldv)
+  {
+    profwatch_compare (oldv, json, &diff);
+    if (!diff.added && !diff.changed && !diff.removed && !diff.other)
+    {
+      iot_log_debug (lc, "%s rewritten with no changes", fname);
+      profwatch_remember (w, fname, hash, json);
+      return;
+    }
+  }
+
+  str = json_serialize_to_string (json);
+  dp = edgex_deviceprofile_read (lc, str);
+  json_free_serialized_string (str);
+  if (dp == NULL)
+  {
+    iot_log_error (lc, "Profile in %s is not valid, not reloaded", fname);
+    json_value_free (json);
+    return;
+  }
+
+  cached = edgex_deviceprofile_get (svc, name, &err);
+  err = EDGEX_OK;
+  profwatch_upload (w, fname, json, cached, &err);
+  if (err.code)
+  {
+    iot_log_error (lc, "Unable to update DeviceProfile %s in metadata", name);
+    edgex_deviceprofile_free (cached);
+    edgex_deviceprofile_free (dp);
+    json_value_free (json);
+    return;
+  }
+
+  /*
+   * Value descriptors for resources which are unchanged are already in
+   * core-data. Those of changed resources are replaced.
+   */
+
+  timenow = edgex_device_millitime ();
+  for (edgex_deviceresource *res = dp->device_resources; res; res = res->next)
+  {
+    switch (edgex_profwatch_resource_change (res, json, oldv, cached))
+    {
+      case EDGEX_PROFWATCH_ADDED:
+        edgex_device_profile_add_valuedescriptor (svc, res, timenow);
+        break;
+      case EDGEX_PROFWATCH_CHANGED:
+        edgex_device_profile_update_valuedescriptor (svc, res, timenow);
+        break;
+      case EDGEX_PROFWATCH_SAME:
+        break;
+    }
+  }
+
+  /* Use metadata's version, which has its id and timestamps, if possible */
+
+  fetched = edgex_metadata_client_get_deviceprofile
+    (lc, &svc->config.endpoints, name, &err);
+  if (fetched)
+  {
+    edgex_deviceprofile_free (dp);
+    dp = fetched;
+  }
+  edgex_cmdplan_get (dp);
+  edgex_deviceprofile_replace (svc, dp);
+  edgex_device_profile_manifest_update (svc, fname, hash, name);
+
+  if (oldv)
+  {
+    iot_log_info
+    (
+      lc, "DeviceProfile %s reloaded from %s: %u resources added, "
+      "%u changed, %u removed%s", name, fname, diff.added, diff.changed,
+      diff.removed, diff.other ? ", other fields changed" : ""
+    );
+  }
+  else
+  {
+    iot_log_info (lc, "DeviceProfile %s loaded from %s", name, fname);
+  }
+  edgex_deviceprofile_free (cached);
+  profwatch_remember (w, fname, hash, json);
+}
+
+/* Record the current version of each file, as uploaded at startup */
+
+static void profwatch_prime (edgex_profwatch *w)
+{
+  struct dirent **filenames = NULL;
+  int n = scandir (w->svc->config.device.profilesdir, &filenames, NULL, NULL);
+
+  for (int i = 0; i < n; i++)
+  {
+    const char *fname = filenames[i]->d_name;
+    if (edgex_device_profile_isfile (fname))
+    {
+      uint64_t hash;
+      JSON_Value *json = edgex_device_profile_parse (w->svc, fname, &hash);
+      if (json)
+      {
+        profwatch_remember (w, fname, hash, json);
+      }
+    }
+    free (filenames[i]);
+  }
+  free (filenames);
+}
+
+/* Add the names of profile files which have been written to the pending set */
+
+static void profwatch_read (edgex_profwatch *w, edgex_map_int *pending)
+{
+  char buf[4096]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  const struct inotify_event *ev;
+  ssize_t len;
+
+  while ((len = read (w->fd, buf, sizeof (buf))) > 0)
+  {
+    for (char *p = buf; p < buf + len; p += sizeof (*ev) + ev->len)
+    {
+      ev = (const struct inotify_event *) p;
+      if (ev->mask & IN_Q_OVERFLOW)
+      {
+        iot_log_warning
+          (w->svc->logger, "Profile changes lost: directory watch overflowed");
+      }
+      else if (ev->len && edgex_device_profile_isfile (ev->name))
+      {
+        edgex_map_set (pending, ev->name, 1);
+      }
+    }
+  }
+}
+
+static void *profwatch_thread (void *arg)
+{
+  edgex_profwatch *w = (edgex_profwatch *) arg;
+  edgex_map_int pending;
+  struct pollfd fds[2];
+  const char *fname;
+  int n;
+
+  profwatch_prime (w);
+  edgex_map_init (&pending);
+  fds[0].fd = w->stopfd;
+  fds[0].events = POLLIN;
+  fds[1].fd = w->fd;
+  fds[1].events = POLLIN;
+
+  while (true)
+  {
+    n = poll (fds, 2, edgex_map_count (&pending) ? PROFWATCH_SETTLE : -1);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      iot_log_error
+        (w->svc->logger, "Profile watch failed: %s", strerror (errno));
+      break;
+    }
+    if (fds[0].revents)
+    {
+      break;
+    }
+    if (n == 0)
+    {
+      edgex_map_iter iter = edgex_map_iter (pending);
+      while ((fname = edgex_map_next (&pending, &iter)))
+      {
+        profwatch_reload (w, fname);
+      }
+      edgex_map_deinit (&pending);
+      edgex_map_init (&pending);
+    }
+    else if (fds[1].revents & POLLIN)
+    {
+      profwatch_read (w, &pending);
+    }
+  }
+  edgex_map_deinit (&pending);
+  return NULL;
+}
+
+edgex_profwatch *edgex_profwatch_start (edgex_device_service *svc)
+{
+  edgex_profwatch *w = calloc (1, sizeof (edgex_profwatch));
+
+  w->svc = svc;
+  w->stopfd = eventfd (0, EFD_CLOEXEC);
+  w->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  edgex_map_init (&w->files);
+  if
+  (
+    w->stopfd < 0 || w->fd < 0 ||
+    inotify_add_watch
+      (w->fd, svc->config.device.profilesdir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0
+  )
+  {
+    iot_log_error
+      (svc->logger, "Unable to watch profiles directory: %s", strerror (errno));
+  }
+  else if (pthread_create (&w->thread, NULL, profwatch_thread, w) == 0)
+  {
+    return w;
+  }
+  else
+  {
+    iot_log_error (svc->logger, "Unable to start profile watcher");
+  }
+  if (w->fd >= 0)
+  {
+    close (w->fd);
+  }
+  if (w->stopfd >= 0)
+  {
+    close (w->stopfd);
+  }
+  edgex_map_deinit (&w->files);
+  free (w);
+  return NULL;
+}
+
+void edgex_profwatch_stop (edgex_profwatch *w)
+{
+  if (w)
+  {
+    const char *fname;
+    uint64_t one = 1;
+
+    if (write (w->stopfd, &one, sizeof (one)) != sizeof (one))
+    {
+      iot_log_error (w->svc->logger, "Unable to stop profile watcher");
+    }
+    pthread_join (w->thread, NULL);
+    close (w->fd);
+    close (w->stopfd);
+
+    edgex_map_iter iter = edgex_map_iter (w->files);
+    while ((fname = edgex_map_next (&w->files, &iter)))
+    {
+      json_value_free (edgex_map_get (&w->files, fname)->json);
+    }
+    edgex_map_deinit (&w->files);
+    free (w);
+  }
+}
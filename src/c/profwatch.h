@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_PROFWATCH_H_
+#define _EDGEX_DEVICE_PROFWATCH_H_ 1
+
+#include "edgex/devsdk.h"
+#include "parson.h"
+
+typedef struct edgex_profwatch edgex_profwatch;
+
+/*
+ * Start a thread which watches the profiles directory and reloads a profile
+ * when its file is written. Only the changed file is parsed; it is compared
+ * with the version last seen and, if it differs, the profile is updated in
+ * metadata and replaced for the devices which use it. Returns NULL if the
+ * directory can not be watched.
+ */
+
+extern edgex_profwatch *edgex_profwatch_start (edgex_device_service *svc);
+
+/* Stop watching. Changes not yet reloaded are abandoned */
+
+extern void edgex_profwatch_stop (edgex_profwatch *w);
+
+typedef enum
+{
+  EDGEX_PROFWATCH_SAME,
+  EDGEX_PROFWATCH_ADDED,
+  EDGEX_PROFWATCH_CHANGED
+} edgex_profwatch_change;
+
+/*
+ * How a device resource in the new version of a profile (newv) differs from
+ * the previous version, as last read from its file (oldv) or, if the file
+ * has not been read before, as held by metadata (cached).
+ */
+
+extern edgex_profwatch_change edgex_profwatch_resource_change
+(
+  const edgex_deviceresource *res,
+  const JSON_Value *newv,
+  const JSON_Value *oldv,
+  const edgex_deviceprofile *cached
+);
+
+#endif
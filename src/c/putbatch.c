@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "putbatch.h"
+#include "map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * A device has a queue in the map while a write to it is in progress. The
+ * writer which finds no queue leads: it takes a batch from the head of the
+ * queue, calls the driver, and completes the writes in the batch. If more
+ * have been queued meanwhile, the first of them is made the leader of the
+ * next batch. Writes are held on the stacks of their (waiting) callers.
+ */
+
+typedef struct putbatch_write
+{
+  uint32_t nreqs;
+  const edgex_device_commandrequest *requests;
+  const edgex_device_commandresult *values;
+  pthread_cond_t cond;
+  bool lead;
+  bool done;
+  bool ok;
+  struct putbatch_write *next;
+} putbatch_write;
+
+typedef struct putbatch_queue
+{
+  putbatch_write *head;
+  putbatch_write **tail;
+} putbatch_queue;
+
+struct edgex_putbatch
+{
+  pthread_mutex_t lock;
+  edgex_map_void queues;
+  uint32_t window;
+};
+
+edgex_putbatch *edgex_putbatch_create (uint32_t window)
+{
+  edgex_putbatch *b = malloc (sizeof (edgex_putbatch));
+  pthread_mutex_init (&b->lock, NULL);
+  edgex_map_init (&b->queues);
+  b->window = window;
+  return b;
+}
+
+/* Make the writes in a batch of count writes and n requests, in order */
+
+static void putbatch_call
+(
+  putbatch_write *first,
+  unsigned count,
+  uint32_t n,
+  const edgex_addressable *addr,
+  edgex_device_handle_put handler,
+  void *impl
+)
+{
+  putbatch_write *w;
+
+  if (count == 1)
+  {
+    first->ok = handler (impl, addr, n, first->requests, first->values);
+    return;
+  }
+
+  edgex_device_commandrequest *requests =
+    malloc (n * sizeof (edgex_device_commandrequest));
+  edgex_device_commandresult *values =
+    malloc (n * sizeof (edgex_device_commandresult));
+  uint32_t i = 0;
+  for (w = first; w; w = w->next)
+  {
+    memcpy (requests + i, w->requests, w->nreqs * sizeof (*requests));
+    memcpy (values + i, w->values, w->nreqs * sizeof (*values));
+    i += w->nreqs;
+  }
+  bool ok = handler (impl, addr, n, requests, values);
+  free (values);
+  free (requests);
+
+  for (w = first; w; w = w->next)
+  {
+    w->ok = ok ? true :
+      handler (impl, addr, w->nreqs, w->requests, w->values);
+  }
+}
+
+bool edgex_putbatch_run
+(
+  edgex_putbatch *b,
+  const char *dev,
+  const edgex_addressable *addr,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values,
+  uint32_t maxops,
+  edgex_device_handle_put handler,
+  void *impl
+)
+{
+  putbatch_write self;
+  putbatch_queue *q;
+
+  memset (&self, 0, sizeof (self));
+  self.nreqs = nreqs;
+  self.requests = requests;
+  self.values = values;
+  pthread_cond_init (&self.cond, NULL);
+
+  pthread_mutex_lock (&b->lock);
+  putbatch_queue **found = (putbatch_queue **) edgex_map_get (&b->queues, dev);
+  if (found)
+  {
+    q = *found;
+    *q->tail = &self;
+    q->tail = &self.next;
+    while (!self.done && !self.lead)
+    {
+      pthread_cond_wait (&self.cond, &b->lock);
+    }
+    if (self.done)
+    {
+      pthread_mutex_unlock (&b->lock);
+      pthread_cond_destroy (&self.cond);
+      return self.ok;
+    }
+  }
+  else
+  {
+    q = malloc (sizeof (putbatch_queue));
+    q->head = &self;
+    q->tail = &self.next;
+    edgex_map_set (&b->queues, dev, q);
+    if (b->window)
+    {
+      struct timespec delay =
+        { .tv_sec = b->window / 1000, .tv_nsec = (b->window % 1000) * 1000000 };
+      pthread_mutex_unlock (&b->lock);
+      nanosleep (&delay, NULL);
+      pthread_mutex_lock (&b->lock);
+    }
+  }
+
+  /* Lead a batch from the head of the queue, which is this write */
+
+  putbatch_write *last = q->head;
+  uint32_t n = last->nreqs;
+  unsigned count = 1;
+  while (last->next && (maxops == 0 || n + last->next->nreqs <= maxops))
+  {
+    last = last->next;
+    n += last->nreqs;
+    count++;
+  }
+  q->head = last->next;
+  if (q->head == NULL)
+  {
+    q->tail = &q->head;
+  }
+  last->next = NULL;
+  pthread_mutex_unlock (&b->lock);
+
+  putbatch_call (&self, count, n, addr, handler, impl);
+
+  pthread_mutex_lock (&b->lock);
+  for (putbatch_write *w = self.next; w; )
+  {
+    putbatch_write *next = w->next;
+    w->done = true;
+    pthread_cond_signal (&w->cond);
+    w = next;
+  }
+  if (q->head)
+  {
+    q->head->lead = true;
+    pthread_cond_signal (&q->head->cond);
+  }
+  else
+  {
+    edgex_map_remove (&b->queues, dev);
+    free (q);
+  }
+  pthread_mutex_unlock (&b->lock);
+  pthread_cond_destroy (&self.cond);
+  return self.ok;
+}
+
+void edgex_putbatch_free (edgex_putbatch *b)
+{
+  if (b)
+  {
+    edgex_map_deinit (&b->queues);
+    pthread_mutex_destroy (&b->lock);
+    free (b);
+  }
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_PUTBATCH_H_
+#define _EDGEX_DEVICE_PUTBATCH_H_ 1
+
+#include "edgex/devsdk.h"
+
+/*
+ * Batching of writes to the same device. A write arriving while the driver
+ * is busy with another for that device is queued, and the queued writes are
+ * passed to the driver together, in the order in which they arrived, in a
+ * single call. With a window set, a write to an idle device also waits that
+ * long for others to join it.
+ *
+ * Each write is acknowledged separately: if a batch of several writes fails,
+ * they are retried one at a time so that each has its own outcome.
+ */
+
+typedef struct edgex_putbatch edgex_putbatch;
+
+/* Create a batcher. The window is in milliseconds, and may be zero */
+
+extern edgex_putbatch *edgex_putbatch_create (uint32_t window);
+
+/*
+ * Perform a write to a device, named dev, at addr. Batches are limited to
+ * maxops requests, or unlimited if maxops is zero; a write which is larger
+ * than this is made on its own.
+ * Returns the outcome of the driver call(s) which included the write.
+ */
+
+extern bool edgex_putbatch_run
+(
+  edgex_putbatch *b,
+  const char *dev,
+  const edgex_addressable *addr,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values,
+  uint32_t maxops,
+  edgex_device_handle_put handler,
+  void *impl
+);
+
+extern void edgex_putbatch_free (edgex_putbatch *b);
+
+#endif
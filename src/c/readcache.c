@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "readcache.h"
+#include "map.h"
+#include "edgex_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <microhttpd.h>
+
+/*
+ * Entries are keyed on "<device>/<command>", and spread over a number of
+ * shards by the top bits of the key's hash, each with its own lock. An entry
+ * stays in its shard's map while a read is in progress or its result is
+ * cached; once removed it is freed by the last thread using it.
+ */
+
+#define READCACHE_SHARD_BITS 4
+#define READCACHE_SHARDS (1 << READCACHE_SHARD_BITS)
+#define READCACHE_KEYSIZE 128
+
+typedef struct readcache_shard
+{
+  pthread_mutex_t lock;
+  edgex_map_void entries;
+} readcache_shard;
+
+struct edgex_readcache_entry
+{
+  char *key;
+  readcache_shard *shard;
+  pthread_cond_t cond;
+  uint64_t ttl;         // Nanoseconds
+  uint64_t expires;     // Monotonic time
+  uint64_t generation;
+  unsigned waiters;
+  bool inflight;
+  bool removed;
+  int status;
+  edgex_strbuf result;
+};
+
+typedef edgex_map(uint64_t) edgex_map_ttl;
+
+struct edgex_readcache
+{
+  readcache_shard shards[READCACHE_SHARDS];
+  edgex_map_ttl ttls;
+};
+
+edgex_readcache *edgex_readcache_create (const edgex_nvpairs *ttls)
+{
+  edgex_readcache *c = malloc (sizeof (edgex_readcache));
+  for (unsigned i = 0; i < READCACHE_SHARDS; i++)
+  {
+    pthread_mutex_init (&c->shards[i].lock, NULL);
+    edgex_map_init (&c->shards[i].entries);
+  }
+  edgex_map_init (&c->ttls);
+  for (; ttls; ttls = ttls->next)
+  {
+    edgex_map_set
+      (&c->ttls, ttls->name, strtoull (ttls->value, NULL, 10) * 1000000ULL);
+  }
+  return c;
+}
+
+static void entry_free (edgex_readcache_entry *e)
+{
+  pthread_cond_destroy (&e->cond);
+  edgex_strbuf_fini (&e->result);
+  free (e->key);
+  free (e);
+}
+
+static void entry_copy (const edgex_readcache_entry *e, edgex_strbuf *out)
+{
+  if (e->result.len)
+  {
+    edgex_strbuf_append (out, e->result.data, e->result.len);
+  }
+}
+
+/* Build the key in buf if it fits, otherwise in allocated memory */
+
+static char *entry_key
+  (char *buf, const char *device, const char *command)
+{
+  size_t dlen = strlen (device);
+  size_t clen = strlen (command);
+  char *key = (dlen + clen + 2 <= READCACHE_KEYSIZE) ?
+    buf : malloc (dlen + clen + 2);
+  memcpy (key, device, dlen);
+  key[dlen] = '/';
+  memcpy (key + dlen + 1, command, clen + 1);
+  return key;
+}
+
+/*
+ * The time for which a command's result is kept: the shortest of the times
+ * configured for its resources, or zero if any of them has none.
+ */
+
+static uint64_t entry_ttl
+  (edgex_readcache *c, uint32_t nreqs, const edgex_device_commandrequest *reqs)
+{
+  uint64_t result = 0;
+  if (edgex_map_count (&c->ttls) == 0)
+  {
+    return 0;
+  }
+  for (uint32_t i = 0; i < nreqs; i++)
+  {
+    uint64_t *ttl = edgex_map_get (&c->ttls, reqs[i].devobj->name);
+    if (ttl == NULL)
+    {
+      return 0;
+    }
+    if (i == 0 || *ttl < result)
+    {
+      result = *ttl;
+    }
+  }
+  return result;
+}
+
+edgex_readcache_entry *edgex_readcache_begin
+(
+  edgex_readcache *c,
+  const char *device,
+  const char *command,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *reqs,
+  edgex_strbuf *out,
+  int *status
+)
+{
+  edgex_readcache_entry *result = NULL;
+  char buf[READCACHE_KEYSIZE];
+  char *key = entry_key (buf, device, command);
+  uint32_t hash = edgex_map_hash (key);
+  readcache_shard *shard =
+    &c->shards[hash >> (32 - READCACHE_SHARD_BITS)];
+
+  pthread_mutex_lock (&shard->lock);
+  edgex_readcache_entry **found = (edgex_readcache_entry **)
+    edgex_map_get_hashed (&shard->entries, key, hash);
+  edgex_readcache_entry *e = found ? *found : NULL;
+
+  if (e && e->inflight)
+  {
+    /* Wait for the read in progress */
+
+    uint64_t gen = e->generation;
+    e->waiters++;
+    while (e->generation == gen)
+    {
+      pthread_cond_wait (&e->cond, &shard->lock);
+    }
+    e->waiters--;
+    entry_copy (e, out);
+    *status = e->status;
+    if (e->removed && e->waiters == 0)
+    {
+      entry_free (e);
+    }
+  }
+  else if (e && edgex_device_monotime () < e->expires)
+  {
+    entry_copy (e, out);
+    *status = e->status;
+  }
+  else
+  {
+    if (e == NULL)
+    {
+      e = calloc (1, sizeof (edgex_readcache_entry));
+      pthread_cond_init (&e->cond, NULL);
+      edgex_strbuf_init (&e->result);
+      e->ttl = entry_ttl (c, nreqs, reqs);
+      e->key = (key == buf) ? strdup (key) : key;
+      e->shard = shard;
+      key = buf;
+      edgex_map_set (&shard->entries, e->key, e);
+    }
+    e->inflight = true;
+    result = e;
+  }
+  pthread_mutex_unlock (&shard->lock);
+  if (key != buf)
+  {
+    free (key);
+  }
+  return result;
+}
+
+void edgex_readcache_end
+(
+  edgex_readcache *c,
+  edgex_readcache_entry *e,
+  const char *result,
+  size_t len,
+  int status
+)
+{
+  readcache_shard *shard = e->shard;
+  pthread_mutex_lock (&shard->lock);
+  e->result.len = 0;
+  if (len)
+  {
+    edgex_strbuf_append (&e->result, result, len);
+  }
+  e->status = status;
+  e->inflight = false;
+  e->generation++;
+  e->expires = (status == MHD_HTTP_OK && e->ttl) ?
+    edgex_device_monotime () + e->ttl : 0;
+  pthread_cond_broadcast (&e->cond);
+
+  /* Results which are not cached only need to live for current waiters */
+
+  if (e->expires == 0 && !e->removed)
+  {
+    edgex_map_remove (&shard->entries, e->key);
+    e->removed = true;
+  }
+  if (e->removed && e->waiters == 0)
+  {
+    entry_free (e);
+  }
+  pthread_mutex_unlock (&shard->lock);
+}
+
+void edgex_readcache_forget (edgex_readcache *c, const char *device)
+{
+  size_t dlen = strlen (device);
+  const char *key;
+
+  if (c == NULL)
+  {
+    return;
+  }
+  for (unsigned s = 0; s < READCACHE_SHARDS; s++)
+  {
+    readcache_shard *shard = &c->shards[s];
+    pthread_mutex_lock (&shard->lock);
+    edgex_map_iter i = edgex_map_iter (shard->entries);
+    while ((key = edgex_map_next (&shard->entries, &i)))
+    {
+      if (strncmp (key, device, dlen) == 0 && key[dlen] == '/')
+      {
+        edgex_readcache_entry *e =
+          *(edgex_readcache_entry **) edgex_map_get (&shard->entries, key);
+        edgex_map_remove (&shard->entries, e->key);
+        i = edgex_map_iter (shard->entries);
+        if (e->inflight || e->waiters)
+        {
+          e->removed = true;
+        }
+        else
+        {
+          entry_free (e);
+        }
+      }
+    }
+    pthread_mutex_unlock (&shard->lock);
+  }
+}
+
+void edgex_readcache_free (edgex_readcache *c)
+{
+  const char *key;
+  if (c)
+  {
+    for (unsigned s = 0; s < READCACHE_SHARDS; s++)
+    {
+      readcache_shard *shard = &c->shards[s];
+      edgex_map_iter i = edgex_map_iter (shard->entries);
+      while ((key = edgex_map_next (&shard->entries, &i)))
+      {
+        entry_free
+          (*(edgex_readcache_entry **) edgex_map_get (&shard->entries, key));
+      }
+      edgex_map_deinit (&shard->entries);
+      pthread_mutex_destroy (&shard->lock);
+    }
+    edgex_map_deinit (&c->ttls);
+    free (c);
+  }
+}
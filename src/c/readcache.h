@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_READCACHE_H_
+#define _EDGEX_DEVICE_READCACHE_H_ 1
+
+#include "edgex/devsdk.h"
+#include "strbuf.h"
+
+/*
+ * Coalescing of reads of the same command on the same device. While a read
+ * is in progress, other readers wait for it and share its result rather than
+ * calling the driver themselves. Successful results may also be kept for a
+ * short time, configured per profile resource.
+ */
+
+typedef struct edgex_readcache edgex_readcache;
+
+typedef struct edgex_readcache_entry edgex_readcache_entry;
+
+/*
+ * Create a cache. ttls maps profile resource names to the time, in
+ * milliseconds, for which their results are kept. A command's result is kept
+ * for the shortest time of the resources it reads, provided all of them are
+ * listed; other results are only shared with readers which arrive while the
+ * read is in progress.
+ */
+
+extern edgex_readcache *edgex_readcache_create (const edgex_nvpairs *ttls);
+
+/*
+ * Start a read of a command, which reads the resources in reqs. If a result
+ * is available, either cached or from a read already in progress (which is
+ * waited for), it is appended to out, its status set in *status, and NULL is
+ * returned. Otherwise the caller is to perform the read, and must pass its
+ * result to edgex_readcache_end.
+ */
+
+extern edgex_readcache_entry *edgex_readcache_begin
+(
+  edgex_readcache *c,
+  const char *device,
+  const char *command,
+  uint32_t nreqs,
+  const edgex_device_commandrequest *reqs,
+  edgex_strbuf *out,
+  int *status
+);
+
+/* Record the result of a read and pass it to any waiting readers */
+
+extern void edgex_readcache_end
+(
+  edgex_readcache *c,
+  edgex_readcache_entry *e,
+  const char *result,
+  size_t len,
+  int status
+);
+
+/* Discard cached results for a device */
+
+extern void edgex_readcache_forget (edgex_readcache *c, const char *device);
+
+extern void edgex_readcache_free (edgex_readcache *c);
+
+#endif
@@ -9,6 +9,7 @@
 #include "edgex/registry.h"
 #include "consul.h"
 #include "map.h"
+#include "errorlist.h"
 
 typedef edgex_map(edgex_registry_impl) edgex_map_registry;
 
@@ -34,6 +35,8 @@ static void reginit (void)
     consulimpl.register_service = edgex_consul_client_register_service;
     consulimpl.parser = edgex_registry_parse_simple_url;
     consulimpl.free_location = edgex_registry_free_simple_url;
+    consulimpl.watch_config = edgex_consul_client_watch_config;
+    consulimpl.query_service = edgex_consul_client_query_service;
     regmap = malloc (sizeof (edgex_map_registry));
     edgex_map_init (regmap);
     edgex_map_set (regmap, "consul", consulimpl);
@@ -128,6 +131,46 @@ edgex_nvpairs *edgex_registry_get_config
     (registry->logger, registry->location, servicename, profile, err);
 }
 
+edgex_nvpairs *edgex_registry_watch_config
+(
+  edgex_registry *registry,
+  const char *servicename,
+  const char *profile,
+  uint64_t *index,
+  const bool *stop,
+  edgex_error *err
+)
+{
+  return registry->impl.watch_config
+  (
+    registry->logger, registry->location, servicename, profile,
+    index, stop, err
+  );
+}
+
+edgex_registry_hostport *edgex_registry_query_service
+(
+  edgex_registry *registry,
+  const char *servicename,
+  unsigned *count,
+  edgex_error *err
+)
+{
+  *count = 0;
+  if (registry->impl.query_service == NULL)
+  {
+    *err = EDGEX_INVALID_ARG;
+    return NULL;
+  }
+  return registry->impl.query_service
+    (registry->logger, registry->location, servicename, count, err);
+}
+
+bool edgex_registry_can_watch (edgex_registry *registry)
+{
+  return registry->impl.watch_config != NULL;
+}
+
 void edgex_registry_put_config
 (
   edgex_registry *registry,
@@ -24,17 +24,386 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
 #include "errorlist.h"
 #include "rest.h"
+#include "stats.h"
 
 #if (LIBCURL_VERSION_NUM >= 0x073800)
 #define USE_CURL_MIME
 #endif
 
+#if (LIBCURL_VERSION_NUM >= 0x073900)
+#define USE_CURL_SHARE_CONNECT
+#endif
+
+/* Maximum number of idle curl handles retained for reuse */
+
+#define HANDLE_POOL_SIZE 16
+
 #define HTTP_UNAUTH 401
 
 #define MAX_TOKEN_LEN 600
 
+/*
+ * Response bodies are read into a buffer which starts at this size and
+ * doubles. If the server gives a Content-Length of up to BUFF_PREALLOC_MAX
+ * the buffer is allocated at that size before the body arrives.
+ */
+
+#define BUFF_INITIAL_SIZE 1024
+#define BUFF_PREALLOC_MAX (64 * 1024 * 1024)
+
+#define CONTENT_LENGTH "Content-Length:"
+#define CONTENT_LENGTH_LEN (sizeof (CONTENT_LENGTH) - 1)
+#define IF_NONE_MATCH "If-None-Match: "
+#define GZIP_WINDOW (15 + 16)
+#define GZIP_MEMLEVEL 8
+#define MUX_WAIT_MS 1000
+
+/*
+ * Handle pool. Idle curl handles are kept for reuse rather than being
+ * cleaned up after each request. All handles are attached to a common share
+ * object, so that DNS lookups, TLS sessions and (on libcurl 7.57 or later)
+ * open connections are cached across requests and threads. This means that
+ * repeated calls to the same endpoint, eg event submission to core-data, do
+ * not incur a new TCP or TLS handshake each time.
+ */
+
+static struct
+{
+  pthread_mutex_t lock;
+  bool initialized;
+  CURLSH *share;
+  pthread_mutex_t sharelocks[CURL_LOCK_DATA_LAST];
+  CURL *handles[HANDLE_POOL_SIZE];
+  unsigned nhandles;
+  uint32_t timeout;
+  edgex_http_stats stats;
+} pool = { .lock = PTHREAD_MUTEX_INITIALIZER, .initialized = false };
+
+static void edgex_http_share_lock
+  (CURL *hnd, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+  pthread_mutex_lock (&pool.sharelocks[data]);
+}
+
+static void edgex_http_share_unlock
+  (CURL *hnd, curl_lock_data data, void *userptr)
+{
+  pthread_mutex_unlock (&pool.sharelocks[data]);
+}
+
+/* Called with the pool lock held */
+
+static void edgex_http_pool_init (void)
+{
+  curl_global_init (CURL_GLOBAL_ALL);
+  for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+  {
+    pthread_mutex_init (&pool.sharelocks[i], NULL);
+  }
+  pool.share = curl_share_init ();
+  curl_share_setopt (pool.share, CURLSHOPT_LOCKFUNC, edgex_http_share_lock);
+  curl_share_setopt (pool.share, CURLSHOPT_UNLOCKFUNC, edgex_http_share_unlock);
+  curl_share_setopt (pool.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt (pool.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#ifdef USE_CURL_SHARE_CONNECT
+  curl_share_setopt (pool.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+  pool.nhandles = 0;
+  memset (&pool.stats, 0, sizeof (pool.stats));
+  pool.initialized = true;
+}
+
+static CURL *edgex_http_handle_acquire (void)
+{
+  CURL *hnd;
+
+  pthread_mutex_lock (&pool.lock);
+  if (!pool.initialized)
+  {
+    edgex_http_pool_init ();
+  }
+  if (pool.nhandles)
+  {
+    hnd = pool.handles[--pool.nhandles];
+    pool.stats.poolhits++;
+  }
+  else
+  {
+    hnd = curl_easy_init ();
+    curl_easy_setopt (hnd, CURLOPT_SHARE, pool.share);
+    pool.stats.poolmisses++;
+  }
+  uint32_t timeout = pool.timeout;
+  pthread_mutex_unlock (&pool.lock);
+  if (timeout)
+  {
+    curl_easy_setopt (hnd, CURLOPT_TIMEOUT_MS, (long) timeout);
+  }
+  return hnd;
+}
+
+void edgex_http_set_timeout (uint32_t ms)
+{
+  pthread_mutex_lock (&pool.lock);
+  pool.timeout = ms;
+  pthread_mutex_unlock (&pool.lock);
+}
+
+/*
+ * HTTP/2 mode. Rather than each requesting thread performing its own
+ * transfer, transfers are handed to a dedicated thread which drives them all
+ * with one multi handle. Concurrent requests to a service which supports
+ * HTTP/2 then share a single connection, instead of one connection each.
+ * The requesting thread sleeps until its transfer completes. Callbacks for
+ * the transfer run on the multi thread, so they must not block.
+ */
+
+typedef struct edgex_http_transfer
+{
+  CURL *hnd;
+  CURLcode result;
+  bool done;
+  struct edgex_http_transfer *next;
+} edgex_http_transfer;
+
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  pthread_t thread;
+  bool running;
+  CURLM *multi;
+  int wake[2];                  // pipe used to interrupt curl_multi_wait
+  edgex_http_transfer *pending; // handed over, not yet added to multi
+} mux = { .lock = PTHREAD_MUTEX_INITIALIZER, .done = PTHREAD_COND_INITIALIZER };
+
+static void *edgex_http_mux_thread (void *arg)
+{
+  struct curl_waitfd wfd = { .fd = mux.wake[0], .events = CURL_WAIT_POLLIN };
+  char drain[64];
+  int active = 0;
+  int nmsgs;
+  CURLMsg *msg;
+
+  /*
+   * Once stopped, no more transfers are handed over, but those already
+   * pending are still run, so that their callers are not left waiting.
+   */
+
+  pthread_mutex_lock (&mux.lock);
+  while (mux.running || active || mux.pending)
+  {
+    edgex_http_transfer *list = mux.pending;
+    mux.pending = NULL;
+    pthread_mutex_unlock (&mux.lock);
+
+    for (edgex_http_transfer *t = list; t; t = t->next)
+    {
+      curl_easy_setopt (t->hnd, CURLOPT_PRIVATE, t);
+      curl_multi_add_handle (mux.multi, t->hnd);
+    }
+    curl_multi_perform (mux.multi, &active);
+
+    while ((msg = curl_multi_info_read (mux.multi, &nmsgs)))
+    {
+      if (msg->msg == CURLMSG_DONE)
+      {
+        edgex_http_transfer *t;
+        CURL *hnd = msg->easy_handle;
+        CURLcode result = msg->data.result;
+        curl_easy_getinfo (hnd, CURLINFO_PRIVATE, (char **) &t);
+        curl_multi_remove_handle (mux.multi, hnd);
+        pthread_mutex_lock (&mux.lock);
+        t->result = result;
+        t->done = true;
+        pthread_cond_broadcast (&mux.done);
+        pthread_mutex_unlock (&mux.lock);
+      }
+    }
+
+    curl_multi_wait (mux.multi, &wfd, 1, MUX_WAIT_MS, NULL);
+    while (read (mux.wake[0], drain, sizeof (drain)) > 0);
+    pthread_mutex_lock (&mux.lock);
+  }
+  pthread_mutex_unlock (&mux.lock);
+  return NULL;
+}
+
+void edgex_http_set_http2 (bool enable)
+{
+  pthread_mutex_lock (&pool.lock);
+  if (!pool.initialized)
+  {
+    edgex_http_pool_init ();
+  }
+  pthread_mutex_unlock (&pool.lock);
+
+  pthread_mutex_lock (&mux.lock);
+  if (enable && !mux.running && pipe2 (mux.wake, O_NONBLOCK | O_CLOEXEC) == 0)
+  {
+    mux.multi = curl_multi_init ();
+    curl_multi_setopt (mux.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    mux.running = true;
+    if (pthread_create (&mux.thread, NULL, edgex_http_mux_thread, NULL) != 0)
+    {
+      mux.running = false;
+      curl_multi_cleanup (mux.multi);
+      close (mux.wake[0]);
+      close (mux.wake[1]);
+    }
+  }
+  pthread_mutex_unlock (&mux.lock);
+}
+
+static void edgex_http_mux_stop (void)
+{
+  pthread_mutex_lock (&mux.lock);
+  bool running = mux.running;
+  mux.running = false;
+  pthread_mutex_unlock (&mux.lock);
+  if (running)
+  {
+    if (write (mux.wake[1], "", 1) < 0) {}
+    pthread_join (mux.thread, NULL);
+    curl_multi_cleanup (mux.multi);
+    mux.multi = NULL;
+    close (mux.wake[0]);
+    close (mux.wake[1]);
+  }
+}
+
+/* Hand a transfer to the multi thread and wait for it, if it is running */
+
+static bool edgex_http_mux_perform (CURL *hnd, CURLcode *result)
+{
+  edgex_http_transfer t = { .hnd = hnd, .done = false };
+
+  pthread_mutex_lock (&mux.lock);
+  if (!mux.running)
+  {
+    pthread_mutex_unlock (&mux.lock);
+    return false;
+  }
+  /*
+   * The multi handle's own caches of connections and DNS lookups are used
+   * rather than those of the pool's share object, as a connection must
+   * belong to the multi handle for its transfers to be multiplexed.
+   */
+  curl_easy_setopt (hnd, CURLOPT_SHARE, NULL);
+  curl_easy_setopt (hnd, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2_0);
+  curl_easy_setopt (hnd, CURLOPT_PIPEWAIT, 1L);
+  t.next = mux.pending;
+  mux.pending = &t;
+  if (write (mux.wake[1], "", 1) < 0) {}
+  while (!t.done)
+  {
+    pthread_cond_wait (&mux.done, &mux.lock);
+  }
+  pthread_mutex_unlock (&mux.lock);
+  *result = t.result;
+  return true;
+}
+
+/* Perform a transfer, counting those abandoned for taking too long */
+
+static CURLcode edgex_http_perform (CURL *hnd)
+{
+  CURLcode rc;
+  if (!edgex_http_mux_perform (hnd, &rc))
+  {
+    rc = curl_easy_perform (hnd);
+  }
+  if (rc == CURLE_OPERATION_TIMEDOUT)
+  {
+    edgex_stats_count (EDGEX_STATS_HTTP_TIMEOUTS, 1);
+  }
+  return rc;
+}
+
+/*
+ * Return a handle to the pool. Its options are reset, but the connection
+ * and session caches are retained. If completed is set, the handle has just
+ * performed a transfer and we record whether it needed a new connection.
+ */
+
+static void edgex_http_handle_release (CURL *hnd, bool completed)
+{
+  long nconns = 0;
+  long version = 0;
+
+  if (completed)
+  {
+    curl_easy_getinfo (hnd, CURLINFO_NUM_CONNECTS, &nconns);
+    curl_easy_getinfo (hnd, CURLINFO_HTTP_VERSION, &version);
+  }
+  curl_easy_reset (hnd);
+
+  pthread_mutex_lock (&pool.lock);
+  if (completed)
+  {
+    if (nconns)
+    {
+      pool.stats.connsnew++;
+    }
+    else
+    {
+      pool.stats.connsreused++;
+    }
+    if (version == CURL_HTTP_VERSION_2_0)
+    {
+      pool.stats.http2++;
+    }
+  }
+  if (pool.nhandles < HANDLE_POOL_SIZE)
+  {
+    pool.handles[pool.nhandles++] = hnd;
+    hnd = NULL;
+  }
+  pthread_mutex_unlock (&pool.lock);
+
+  if (hnd)
+  {
+    curl_easy_cleanup (hnd);
+  }
+}
+
+void edgex_http_getstats (edgex_http_stats *stats)
+{
+  pthread_mutex_lock (&pool.lock);
+  *stats = pool.stats;
+  pthread_mutex_unlock (&pool.lock);
+}
+
+void edgex_http_fini (void)
+{
+  edgex_http_mux_stop ();
+  pthread_mutex_lock (&pool.lock);
+  if (pool.initialized)
+  {
+    while (pool.nhandles)
+    {
+      curl_easy_cleanup (pool.handles[--pool.nhandles]);
+    }
+    curl_share_cleanup (pool.share);
+    pool.share = NULL;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    {
+      pthread_mutex_destroy (&pool.sharelocks[i]);
+    }
+    curl_global_cleanup ();
+    pool.initialized = false;
+  }
+  pthread_mutex_unlock (&pool.lock);
+}
+
 static struct curl_slist *edgex_add_auth_hdr
   (iot_logging_client *lc, edgex_ctx *ctx, struct curl_slist *slist)
 {
@@ -92,12 +461,147 @@ static void edgex_log_peer_cert
   }
 }
 
+/*
+ * Compression of request bodies. Each thread keeps a deflate stream and an
+ * output buffer, which are reset rather than reallocated for each request
+ * and released when the thread exits.
+ */
+
+typedef struct edgex_http_deflater
+{
+  z_stream zs;
+  bool ok;
+  Bytef *out;
+  size_t alloc;
+} edgex_http_deflater;
+
+static pthread_key_t deflater_key;
+static pthread_once_t deflater_once = PTHREAD_ONCE_INIT;
+
+static void deflater_free (void *p)
+{
+  edgex_http_deflater *d = (edgex_http_deflater *) p;
+  if (d->ok)
+  {
+    deflateEnd (&d->zs);
+  }
+  free (d->out);
+  free (d);
+}
+
+static void deflater_init (void)
+{
+  pthread_key_create (&deflater_key, deflater_free);
+}
+
+static edgex_http_deflater *deflater_local (void)
+{
+  pthread_once (&deflater_once, deflater_init);
+  edgex_http_deflater *d = pthread_getspecific (deflater_key);
+  if (d == NULL)
+  {
+    d = calloc (1, sizeof (edgex_http_deflater));
+    d->ok = deflateInit2
+    (
+      &d->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW, GZIP_MEMLEVEL,
+      Z_DEFAULT_STRATEGY
+    ) == Z_OK;
+    pthread_setspecific (deflater_key, d);
+  }
+  return d;
+}
+
+static uint64_t edgex_http_cputime (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Gzip size bytes of data into the thread's buffer, which remains valid
+ * until the thread's next call. Returns the compressed size, or zero if the
+ * data could not be compressed or would not shrink.
+ */
+
+static size_t edgex_http_gzip
+  (const char *data, size_t size, const char **result)
+{
+  uint64_t started = edgex_http_cputime ();
+  size_t len = 0;
+  edgex_http_deflater *d = deflater_local ();
+
+  if (d->ok && deflateReset (&d->zs) == Z_OK)
+  {
+    size_t bound = deflateBound (&d->zs, size);
+    if (bound > d->alloc)
+    {
+      free (d->out);
+      d->out = malloc (bound);
+      d->alloc = d->out ? bound : 0;
+    }
+    if (d->out)
+    {
+      d->zs.next_in = (Bytef *) data;
+      d->zs.avail_in = size;
+      d->zs.next_out = d->out;
+      d->zs.avail_out = d->alloc;
+      if (deflate (&d->zs, Z_FINISH) == Z_STREAM_END && d->zs.total_out < size)
+      {
+        len = d->zs.total_out;
+        *result = (const char *) d->out;
+      }
+    }
+  }
+
+  uint64_t elapsed = edgex_http_cputime () - started;
+  pthread_mutex_lock (&pool.lock);
+  pool.stats.compressns += elapsed;
+  if (len)
+  {
+    pool.stats.compressed++;
+    pool.stats.plainbytes += size;
+    pool.stats.gzipbytes += len;
+  }
+  pthread_mutex_unlock (&pool.lock);
+  return len;
+}
+
+/*
+ * Make room in buff for len bytes and a terminator. The buffer is doubled
+ * as needed, so that a large response costs few reallocations.
+ */
+
+static bool edgex_http_reserve (edgex_ctx *ctx, size_t len)
+{
+  if (len >= ctx->alloc)
+  {
+    size_t alloc = (ctx->alloc > BUFF_INITIAL_SIZE / 2) ?
+      ctx->alloc : BUFF_INITIAL_SIZE / 2;
+    do
+    {
+      alloc *= 2;
+    } while (alloc <= len);
+    char *buff = realloc (ctx->buff, alloc);
+    if (buff == NULL)
+    {
+      return false;
+    }
+    ctx->buff = buff;
+    ctx->alloc = alloc;
+  }
+  return true;
+}
+
 size_t edgex_http_write_cb
   (void *contents, size_t size, size_t nmemb, void *userp)
 {
   edgex_ctx *ctx = (edgex_ctx *) userp;
   size *= nmemb;
-  ctx->buff = realloc (ctx->buff, ctx->size + size + 1);
+  if (!edgex_http_reserve (ctx, ctx->size + size))
+  {
+    return 0;
+  }
   memcpy (&(ctx->buff[ctx->size]), contents, size);
   ctx->size += size;
   ctx->buff[ctx->size] = 0;
@@ -105,6 +609,188 @@ size_t edgex_http_write_cb
   return size;
 }
 
+/*
+ * Scan the new data in buff, passing each complete element of the top-level
+ * array to the callback, then discard all but the element in progress.
+ * Elements are only delimited here; the callback validates their content.
+ */
+
+size_t edgex_http_stream_cb
+  (void *contents, size_t size, size_t nmemb, void *userp)
+{
+  edgex_ctx *ctx = (edgex_ctx *) userp;
+  edgex_http_split *sp = &ctx->split;
+
+  if (edgex_http_write_cb (contents, size, nmemb, userp) == 0)
+  {
+    return 0;
+  }
+  for (size_t i = sp->scanned; i < ctx->size; i++)
+  {
+    char c = ctx->buff[i];
+    bool ws = (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+
+    if (sp->instring)
+    {
+      if (sp->escape)
+      {
+        sp->escape = false;
+      }
+      else if (c == '\\')
+      {
+        sp->escape = true;
+      }
+      else if (c == '"')
+      {
+        sp->instring = false;
+      }
+      continue;
+    }
+    if (sp->depth == 0)
+    {
+      if (c == '[' && !sp->done)
+      {
+        sp->depth = 1;
+      }
+      else if (!ws)
+      {
+        return 0;
+      }
+      continue;
+    }
+    if (sp->depth == 1)
+    {
+      if (c == ',' || c == ']')
+      {
+        if (sp->inelement)
+        {
+          sp->inelement = false;
+          if
+          (
+            !ctx->element
+              (ctx->elementdata, ctx->buff + sp->start, i - sp->start)
+          )
+          {
+            return 0;
+          }
+        }
+        if (c == ']')
+        {
+          sp->depth = 0;
+          sp->done = true;
+        }
+        continue;
+      }
+      if (!ws && !sp->inelement)
+      {
+        sp->inelement = true;
+        sp->start = i;
+      }
+    }
+    if (c == '"')
+    {
+      sp->instring = true;
+    }
+    else if (c == '{' || c == '[')
+    {
+      sp->depth++;
+    }
+    else if (c == '}' || c == ']')
+    {
+      if (sp->depth == 1)
+      {
+        return 0;
+      }
+      sp->depth--;
+    }
+  }
+
+  size_t keep = sp->inelement ? sp->start : ctx->size;
+  memmove (ctx->buff, ctx->buff + keep, ctx->size - keep);
+  ctx->size -= keep;
+  ctx->buff[ctx->size] = 0;
+  sp->start = 0;
+  sp->scanned = ctx->size;
+
+  return size * nmemb;
+}
+
+/*
+ * Header callback for GET. A Content-Length is used to size the buffer for
+ * the body in advance (unless the body is to be streamed), and the header
+ * named in rsp_header, if any, is captured.
+ */
+
+static size_t edgex_http_header_cb
+  (char *buffer, size_t size, size_t nitems, void *userp)
+{
+  edgex_ctx *ctx = (edgex_ctx *) userp;
+  size_t len = size * nitems;
+  size_t hlen = ctx->rsp_header ? strlen (ctx->rsp_header) : 0;
+
+  if
+  (
+    ctx->element == NULL && len > CONTENT_LENGTH_LEN &&
+    strncasecmp (buffer, CONTENT_LENGTH, CONTENT_LENGTH_LEN) == 0
+  )
+  {
+    size_t clen = 0;
+    size_t i = CONTENT_LENGTH_LEN;
+    while (i < len && buffer[i] == ' ')
+    {
+      i++;
+    }
+    while
+    (
+      i < len && buffer[i] >= '0' && buffer[i] <= '9' &&
+      clen <= BUFF_PREALLOC_MAX
+    )
+    {
+      clen = clen * 10 + (buffer[i++] - '0');
+    }
+    if (clen && clen <= BUFF_PREALLOC_MAX)
+    {
+      edgex_http_reserve (ctx, ctx->size + clen);
+    }
+  }
+
+  if
+  (
+    hlen && len > hlen && buffer[hlen] == ':' &&
+    strncasecmp (buffer, ctx->rsp_header, hlen) == 0
+  )
+  {
+    const char *start = buffer + hlen + 1;
+    const char *end = buffer + len;
+    while (start < end && (*start == ' ' || *start == '\t'))
+    {
+      start++;
+    }
+    while (end > start && end[-1] && strchr (" \t\r\n", end[-1]))
+    {
+      end--;
+    }
+    free (ctx->rsp_value);
+    ctx->rsp_value = strndup (start, end - start);
+  }
+  return len;
+}
+
+/* Returning nonzero here makes curl abandon the transfer */
+
+static int edgex_http_cancel_cb
+(
+  void *userp,
+  curl_off_t dltotal,
+  curl_off_t dlnow,
+  curl_off_t ultotal,
+  curl_off_t ulnow
+)
+{
+  edgex_ctx *ctx = (edgex_ctx *) userp;
+  return __atomic_load_n (ctx->cancel, __ATOMIC_ACQUIRE) ? 1 : 0;
+}
+
 /*
  * This function uses libcurl to send a simple HTTP GET
  * request with no Content-Type header.
@@ -118,6 +804,9 @@ size_t edgex_http_write_cb
  *
  * Return value is the HTTP status value from the server
  *	    (e.g. 200 for HTTP OK)
+ *
+ * If the request is conditional (if_none_match or if_modified_since) and the
+ * entity is unchanged, EDGEX_HTTP_NOT_MODIFIED is returned with no body.
  */
 long edgex_http_get (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
                      void *writefunc, edgex_error *err)
@@ -132,17 +821,49 @@ long edgex_http_get (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
    * Create the Authorization header if needed
    */
   slist = edgex_add_auth_hdr (lc, ctx, slist);
+  if (ctx->if_none_match)
+  {
+    char *hdr = malloc (strlen (ctx->if_none_match) + sizeof (IF_NONE_MATCH));
+    strcpy (hdr, IF_NONE_MATCH);
+    strcat (hdr, ctx->if_none_match);
+    slist = curl_slist_append (slist, hdr);
+    free (hdr);
+  }
 
   ctx->buff = malloc (1);
   ctx->size = 0;
+  ctx->alloc = 1;
+  memset (&ctx->split, 0, sizeof (ctx->split));
 
   /*
    * Setup Curl
    */
-  hnd = curl_easy_init ();
+  hnd = edgex_http_handle_acquire ();
   curl_easy_setopt(hnd, CURLOPT_URL, url);
-  curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
+  if (ctx->cancel)
+  {
+    curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(hnd, CURLOPT_XFERINFOFUNCTION, edgex_http_cancel_cb);
+    curl_easy_setopt(hnd, CURLOPT_XFERINFODATA, ctx);
+  }
+  else
+  {
+    curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
+  }
+  curl_easy_setopt(hnd, CURLOPT_HEADERFUNCTION, edgex_http_header_cb);
+  curl_easy_setopt(hnd, CURLOPT_HEADERDATA, ctx);
   curl_easy_setopt(hnd, CURLOPT_USERAGENT, "edgex");
+  if (ctx->if_modified_since)
+  {
+    /*
+     * HTTP dates are in whole seconds, so ask about the second before: a
+     * change later in the same second as the time given is then not missed
+     */
+    curl_easy_setopt
+      (hnd, CURLOPT_TIMECONDITION, (long) CURL_TIMECOND_IFMODSINCE);
+    curl_easy_setopt
+      (hnd, CURLOPT_TIMEVALUE, (long) (ctx->if_modified_since / 1000) - 1);
+  }
   if (slist)
   {
     curl_easy_setopt(hnd, CURLOPT_HTTPHEADER, slist);
@@ -178,11 +899,16 @@ long edgex_http_get (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
   /*
    * Send the HTTP GET request
    */
-  rc = curl_easy_perform (hnd);
+  rc = edgex_http_perform (hnd);
   if (rc != CURLE_OK)
   {
-    iot_log_error (lc, "curl_easy_perform returned: %d\n", (int) rc);
+    if (rc != CURLE_ABORTED_BY_CALLBACK)
+    {
+      iot_log_error (lc, "curl_easy_perform returned: %d\n", (int) rc);
+    }
     *err = EDGEX_HTTP_GET_ERROR;
+    edgex_http_handle_release (hnd, false);
+    curl_slist_free_all (slist);
     return 0;
   }
 
@@ -199,7 +925,31 @@ long edgex_http_get (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
    */
   curl_easy_getinfo(hnd, CURLINFO_RESPONSE_CODE, &http_code);
 
-  if (http_code < 200 || http_code >= 300)
+  /*
+   * A server which ignores If-Modified-Since sends the entity anyway, but
+   * curl then checks its Last-Modified header and discards it if unchanged
+   */
+  if (ctx->if_modified_since)
+  {
+    long unmet = 0;
+    curl_easy_getinfo(hnd, CURLINFO_CONDITION_UNMET, &unmet);
+    if (unmet)
+    {
+      http_code = EDGEX_HTTP_NOT_MODIFIED;
+    }
+  }
+
+  if
+  (
+    http_code == EDGEX_HTTP_NOT_MODIFIED &&
+    (ctx->if_none_match || ctx->if_modified_since)
+  )
+  {
+    ctx->size = 0;
+    ctx->buff[0] = '\0';
+    *err = EDGEX_OK;
+  }
+  else if (http_code < 200 || http_code >= 300)
   {
     iot_log_info (lc, "HTTP response: %d\n", (int) http_code);
     *err = EDGEX_HTTP_GET_ERROR;
@@ -209,7 +959,7 @@ long edgex_http_get (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
     *err = EDGEX_OK;
   }
 
-  curl_easy_cleanup (hnd);
+  edgex_http_handle_release (hnd, true);
   hnd = NULL;
   if (slist)
   {
@@ -250,11 +1000,12 @@ long edgex_http_delete (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
 
   ctx->buff = malloc (1);
   ctx->size = 0;
+  ctx->alloc = 1;
 
   /*
    * Setup Curl
    */
-  hnd = curl_easy_init ();
+  hnd = edgex_http_handle_acquire ();
   curl_easy_setopt(hnd, CURLOPT_URL, url);
   curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
   curl_easy_setopt(hnd, CURLOPT_USERAGENT, "edgex");
@@ -294,11 +1045,13 @@ long edgex_http_delete (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
   /*
    * Send the HTTP DELETE request
    */
-  rc = curl_easy_perform (hnd);
+  rc = edgex_http_perform (hnd);
   if (rc != CURLE_OK)
   {
     iot_log_error (lc, "curl_easy_perform returned: %d\n", (int) rc);
     *err = EDGEX_HTTP_GET_ERROR;
+    edgex_http_handle_release (hnd, false);
+    curl_slist_free_all (slist);
     return 0;
   }
 
@@ -325,7 +1078,7 @@ long edgex_http_delete (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
     *err = EDGEX_OK;
   }
 
-  curl_easy_cleanup (hnd);
+  edgex_http_handle_release (hnd, true);
   hnd = NULL;
   if (slist)
   {
@@ -360,17 +1113,54 @@ long edgex_http_post
   void *writefunc,
   edgex_error *err
 )
+{
+  return edgex_http_post_data
+    (lc, ctx, url, data, strlen (data), "application/json", writefunc, err);
+}
+
+/*
+ * As edgex_http_post, for data of the given length and content type, which
+ * need not be text.
+ */
+long edgex_http_post_data
+(
+  iot_logging_client *lc,
+  edgex_ctx *ctx,
+  const char *url,
+  const char *data,
+  size_t size,
+  const char *type,
+  void *writefunc,
+  edgex_error *err
+)
 {
   long http_code = 0;
   CURL *hnd;
   CURLcode crv;
   struct curl_slist *slist;
+  char typehdr[64];
 
   /*
    * Set the Content-Type header in the HTTP request
    */
+  snprintf (typehdr, sizeof (typehdr), "Content-Type:%s", type);
   slist = NULL;
-  slist = curl_slist_append (slist, "Content-Type:application/json");
+  slist = curl_slist_append (slist, typehdr);
+
+  /*
+   * Compress the body if it is large enough to be worthwhile
+   */
+  if (ctx->compress_min && size >= ctx->compress_min)
+  {
+    const char *gzipped;
+    size_t len = edgex_http_gzip (data, size, &gzipped);
+    if (len)
+    {
+      data = gzipped;
+      size = len;
+      slist = curl_slist_append (slist, "Content-Encoding:gzip");
+    }
+  }
 
   /*
    * Create the Authorization header if needed
@@ -379,11 +1169,12 @@ long edgex_http_post
 
   ctx->buff = malloc (1);
   ctx->size = 0;
+  ctx->alloc = 1;
 
   /*
    * Setup Curl
    */
-  hnd = curl_easy_init ();
+  hnd = edgex_http_handle_acquire ();
   curl_easy_setopt(hnd, CURLOPT_URL, url);
   curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
   curl_easy_setopt(hnd, CURLOPT_USERAGENT, "edgex");
@@ -392,7 +1183,7 @@ long edgex_http_post
   curl_easy_setopt(hnd, CURLOPT_POST, 1L);
   curl_easy_setopt(hnd, CURLOPT_POSTFIELDS, data);
   curl_easy_setopt
-    (hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) strlen (data));
+    (hnd, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) size);
   //FIXME: we should always to TLS peer auth
   if (ctx->verify_peer && ctx->cacerts_file)
   {
@@ -426,12 +1217,14 @@ long edgex_http_post
   /*
    * Send the HTTP POST request
    */
-  crv = curl_easy_perform (hnd);
+  crv = edgex_http_perform (hnd);
   if (crv != CURLE_OK)
   {
     iot_log_error
       (lc, "Curl failed with code %d (%s)\n", crv, curl_easy_strerror (crv));
     *err = EDGEX_HTTP_POST_ERROR;
+    edgex_http_handle_release (hnd, false);
+    curl_slist_free_all (slist);
     return 0;
   }
 
@@ -463,7 +1256,7 @@ long edgex_http_post
     *err = EDGEX_OK;
   }
 
-  curl_easy_cleanup (hnd);
+  edgex_http_handle_release (hnd, true);
   hnd = NULL;
   curl_slist_free_all (slist);
   slist = NULL;
@@ -510,11 +1303,12 @@ edgex_http_postfile (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
 
   ctx->buff = malloc (1);
   ctx->size = 0;
+  ctx->alloc = 1;
 
   /*
    * Setup Curl
    */
-  hnd = curl_easy_init ();
+  hnd = edgex_http_handle_acquire ();
 
 #ifdef USE_CURL_MIME
   form = curl_mime_init (hnd);
@@ -584,7 +1378,7 @@ edgex_http_postfile (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
   /*
    * Send the HTTP POST request
    */
-  crv = curl_easy_perform (hnd);
+  crv = edgex_http_perform (hnd);
   if (crv != CURLE_OK)
   {
     iot_log_error
@@ -618,7 +1412,7 @@ edgex_http_postfile (iot_logging_client *lc, edgex_ctx *ctx, const char *url,
     }
   }
 
-  curl_easy_cleanup (hnd);
+  edgex_http_handle_release (hnd, true);
   hnd = NULL;
 #ifdef USE_CURL_MIME
   curl_mime_free (form);
@@ -684,11 +1478,12 @@ long edgex_http_put
 
   ctx->buff = malloc (1);
   ctx->size = 0;
+  ctx->alloc = 1;
 
   /*
    * Setup Curl
    */
-  hnd = curl_easy_init ();
+  hnd = edgex_http_handle_acquire ();
   curl_easy_setopt(hnd, CURLOPT_URL, url);
   curl_easy_setopt(hnd, CURLOPT_NOPROGRESS, 1L);
   curl_easy_setopt(hnd, CURLOPT_USERAGENT, "edgex");
@@ -738,12 +1533,14 @@ long edgex_http_put
   /*
    * Send the HTTP PUT request
    */
-  crv = curl_easy_perform (hnd);
+  crv = edgex_http_perform (hnd);
   if (crv != CURLE_OK)
   {
     iot_log_error (lc, "Curl failed with code %d (%s)\n", crv,
                    curl_easy_strerror (crv));
     *err = EDGEX_HTTP_PUT_ERROR;
+    edgex_http_handle_release (hnd, false);
+    curl_slist_free_all (slist);
     return 0;
   }
 
@@ -770,7 +1567,7 @@ long edgex_http_put
     *err = EDGEX_OK;
   }
 
-  curl_easy_cleanup (hnd);
+  edgex_http_handle_release (hnd, true);
   hnd = NULL;
   curl_slist_free_all (slist);
   slist = NULL;
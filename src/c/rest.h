@@ -12,6 +12,29 @@
 #include "edgex/edgex_logging.h"
 #include "edgex/error.h"
 
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Streaming consumption of a response which is a JSON array: each element
+ * is passed to the callback as it arrives, and only the element in progress
+ * is buffered. The callback returns false to abandon the transfer.
+ */
+
+typedef bool (*edgex_http_element_fn)
+  (void *data, const char *json, size_t len);
+
+typedef struct edgex_http_split
+{
+  unsigned depth;       // nesting depth in the response
+  bool instring;
+  bool escape;
+  bool done;            // the top-level array has been closed
+  bool inelement;       // an element has been started
+  size_t start;         // offset in buff of the element in progress
+  size_t scanned;       // bytes of buff already examined
+} edgex_http_split;
+
 typedef struct edgex_ctx
 {
   char *cacerts_file;   // Location of CA certificates Curl will use to verify peer
@@ -21,13 +44,66 @@ typedef struct edgex_ctx
   char *jwt_token;      // access_token provided by server for authenticating REST calls
   char *buff;           // used during curl processing
   size_t size;
+  size_t alloc;         // allocated size of buff
+  const char *rsp_header; // GET only: name of a response header to capture
+  char *rsp_value;      // value of the rsp_header header, caller frees
+  const bool *cancel;   // GET only: abandon the transfer when this becomes true
+  const char *if_none_match; // GET only: conditional on this entity tag
+  uint64_t if_modified_since; // GET only: conditional on this time (ms)
+  edgex_http_element_fn element; // GET only: stream the response to this
+  void *elementdata;    // passed to element
+  edgex_http_split split; // state of the streamed response
+  size_t compress_min;  // POST only: gzip bodies of at least this size if set
 } edgex_ctx;
 
 #define URL_BUF_SIZE 512
 
+/* Returned by edgex_http_get, with err EDGEX_OK, for an unmet condition */
+
+#define EDGEX_HTTP_NOT_MODIFIED 304
+
+typedef struct edgex_http_stats
+{
+  uint64_t poolhits;    // Requests which reused a pooled curl handle
+  uint64_t poolmisses;  // Requests for which a new curl handle was created
+  uint64_t connsreused; // Transfers carried over an existing connection
+  uint64_t connsnew;    // Transfers which had to open a new connection
+  uint64_t http2;       // Transfers made over HTTP/2
+  uint64_t compressed;  // Request bodies sent gzipped
+  uint64_t plainbytes;  // Size of those bodies before compression
+  uint64_t gzipbytes;   // Size of those bodies as sent
+  uint64_t compressns;  // CPU time spent compressing (ns), including bodies
+                        // which did not shrink and were sent as they were
+} edgex_http_stats;
+
+void edgex_http_getstats (edgex_http_stats *stats);
+
+/*
+ * Set the time in milliseconds allowed for each request, after which it is
+ * abandoned and fails. Zero (the default) means no limit.
+ */
+
+void edgex_http_set_timeout (uint32_t ms);
+
+/*
+ * Drive all transfers from one thread, multiplexing concurrent requests to
+ * a service over one connection where it supports HTTP/2.
+ */
+
+void edgex_http_set_http2 (bool enable);
+void edgex_http_fini (void);
+
 size_t edgex_http_write_cb
   (void *contents, size_t size, size_t nmemb, void *userp);
 
+/*
+ * Write callback for a streamed response (see edgex_http_element_fn). The
+ * response was a complete array if ctx->split.done is set afterwards.
+ */
+
+size_t edgex_http_stream_cb
+  (void *contents, size_t size, size_t nmemb, void *userp);
+
 long edgex_http_get
 (
   iot_logging_client *lc,
@@ -53,6 +129,17 @@ long edgex_http_post
   void *writefunc,
   edgex_error *err
 );
+long edgex_http_post_data
+(
+  iot_logging_client *lc,
+  edgex_ctx *ctx,
+  const char *url,
+  const char *data,
+  size_t size,
+  const char *type,
+  void *writefunc,
+  edgex_error *err
+);
 long edgex_http_postfile
 (
   iot_logging_client *lc,
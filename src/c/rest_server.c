@@ -9,17 +9,27 @@
 #include "rest_server.h"
 #include "microhttpd.h"
 #include "errorlist.h"
+#include "router.h"
+#include "strbuf.h"
+#include "stats.h"
+#include "edgex_time.h"
+#include "trace.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
 
+#define RESPONSE_POOL_SIZE 16
+#define RESPONSE_POOL_MAXBUF (1024 * 1024)
+
 typedef struct handler_list
 {
   const char *url;
   uint32_t methods;
   void *context;
   http_method_handler_fn handler;
+  http_stream_handler_fn stream;
+  bool blocking;
   struct handler_list *next;
 } handler_list;
 
@@ -28,13 +38,56 @@ struct edgex_rest_server
   iot_logging_client *lc;
   struct MHD_Daemon *daemon;
   handler_list *handlers;
+  edgex_router *router;
   pthread_mutex_t lock;
+  edgex_executor *pool;
+  bool suspend;
+  unsigned pending;
+  pthread_cond_t idle;
+  pthread_cond_t completed;
+  uint64_t maxrequest;
+  uint64_t deadline;
+  edgex_strbuf bufpool[RESPONSE_POOL_SIZE];
+  unsigned nbufs;
+  uint64_t connections;
+  uint64_t accepted;
+  uint64_t requests;
 };
 
-typedef struct http_context_s
+/* The request context is also the handle for a deferred reply */
+
+typedef struct edgex_http_deferred
 {
-  char *m_data;
-  size_t m_size;
+  handler_list *h;
+  edgex_http_params params;
+  edgex_http_method method;
+  edgex_strbuf body;
+
+  /* Per-request state of a streaming handler */
+
+  void *state;
+
+  /* Set once a reply has been queued, eg because the body was too large */
+
+  bool replied;
+  edgex_http_response response;
+
+  /* Used when a request is handled on the thread pool or deferred */
+
+  edgex_rest_server *svr;
+  struct MHD_Connection *conn;
+  int status;
+  uint64_t started;
+#if CSDK_BUILD_TRACE
+  uint64_t trace;
+#endif
+  bool done;
+  bool deferred;
+  bool parked;
+
+  /* The request path, followed by its storage */
+
+  char *path;
 } http_context_t;
 
 static edgex_http_method method_from_string (const char *str)
@@ -52,25 +105,441 @@ static edgex_http_method method_from_string (const char *str)
   return UNKNOWN;
 }
 
-static char *normalizeUrl (const char *url)
+void edgex_http_response_init (edgex_http_response *r)
+{
+  memset (r, 0, sizeof (*r));
+  edgex_strbuf_init (&r->body);
+}
+
+void edgex_http_response_fini (edgex_http_response *r)
+{
+  edgex_strbuf_fini (&r->body);
+  if (r->content_free)
+  {
+    r->content_free (r->content_ctx);
+  }
+  edgex_http_response_init (r);
+}
+
+void edgex_http_response_stream
+(
+  edgex_http_response *r,
+  const char *type,
+  uint64_t size,
+  edgex_http_content_fn content,
+  edgex_http_content_free_fn content_free,
+  void *ctx
+)
+{
+  r->type = type;
+  r->size = size;
+  r->content = content;
+  r->content_free = content_free;
+  r->content_ctx = ctx;
+}
+
+void edgex_http_response_json (edgex_http_response *r, const JSON_Value *val)
+{
+  size_t sz = json_serialization_size (val);
+  edgex_strbuf_reserve (&r->body, sz);
+  char *end = r->body.data + r->body.len;
+  if (sz && json_serialize_to_buffer (val, end, sz) == JSONSuccess)
+  {
+    r->body.len += sz - 1;
+  }
+  r->type = "application/json";
+}
+
+edgex_http_deferred *edgex_http_response_defer (edgex_http_response *r)
+{
+  edgex_http_deferred *d = r->deferrable;
+  if (d)
+  {
+    d->deferred = true;
+  }
+  return d;
+}
+
+const char *edgex_http_request_header
+  (const edgex_http_response *r, const char *name)
+{
+  edgex_http_deferred *d = r->deferrable;
+  return d ?
+    MHD_lookup_connection_value (d->conn, MHD_HEADER_KIND, name) : NULL;
+}
+
+const char *edgex_http_request_arg
+  (const edgex_http_response *r, const char *name)
+{
+  edgex_http_deferred *d = r->deferrable;
+  return d ?
+    MHD_lookup_connection_value (d->conn, MHD_GET_ARGUMENT_KIND, name) : NULL;
+}
+
+bool edgex_http_etag_match (const char *header, const char *etag)
+{
+  size_t len = strlen (etag);
+  const char *p = header;
+
+  while (*p)
+  {
+    while (*p == ' ' || *p == '\t' || *p == ',')
+    {
+      p++;
+    }
+    if (*p == '*')
+    {
+      return true;
+    }
+    if (strncmp (p, "W/", 2) == 0)
+    {
+      p += 2;
+    }
+    if
+    (
+      strncmp (p, etag, len) == 0 &&
+      (p[len] == '\0' || p[len] == ',' || p[len] == ' ' || p[len] == '\t')
+    )
+    {
+      return true;
+    }
+    while (*p && *p != ',')
+    {
+      p++;
+    }
+  }
+  return false;
+}
+
+void edgex_http_deferred_complete (edgex_http_deferred *d, int status)
+{
+  edgex_rest_server *svr = d->svr;
+
+  /* d may be freed by the daemon as soon as the connection is resumed */
+
+  pthread_mutex_lock (&svr->lock);
+  d->status = status;
+  d->done = true;
+  if (d->parked)
+  {
+    MHD_resume_connection (d->conn);
+    if (--svr->pending == 0)
+    {
+      pthread_cond_signal (&svr->idle);
+    }
+  }
+  else
+  {
+    pthread_cond_broadcast (&svr->completed);
+  }
+  pthread_mutex_unlock (&svr->lock);
+}
+
+/*
+ * Called when a handler returns. Unless its reply is deferred and not yet
+ * complete, the status is recorded and true returned. Otherwise the
+ * connection is parked until the reply is completed: suspended if the server
+ * is polling connections, or by waiting here if it has a thread of its own.
+ */
+
+static bool http_handler_done
+  (http_context_t *ctx, int status, bool suspended)
 {
-  /* Only deduplication of '/' is performed */
+  edgex_rest_server *svr = ctx->svr;
+  bool ready = true;
 
-  char *res = malloc (strlen (url) + 1);
-  const char *upos = url;
-  char *rpos = res;
-  while (*upos)
+  pthread_mutex_lock (&svr->lock);
+  if (!ctx->deferred)
   {
-    if ((*rpos++ = *upos++) == '/')
+    ctx->status = status;
+    ctx->done = true;
+  }
+  else if (!ctx->done)
+  {
+    if (suspended || svr->suspend)
     {
-      while (*upos == '/')
+      if (!suspended)
       {
-        upos++;
+        MHD_suspend_connection (ctx->conn);
+        svr->pending++;
       }
+      ctx->parked = true;
+      ready = false;
     }
+    else
+    {
+      while (!ctx->done)
+      {
+        pthread_cond_wait (&svr->completed, &svr->lock);
+      }
+    }
+  }
+  pthread_mutex_unlock (&svr->lock);
+  return ready;
+}
+
+/* Response bodies are built in buffers kept by the server for reuse */
+
+static void response_get (edgex_rest_server *svr, edgex_http_response *r)
+{
+  edgex_http_response_init (r);
+  pthread_mutex_lock (&svr->lock);
+  if (svr->nbufs)
+  {
+    r->body = svr->bufpool[--svr->nbufs];
+  }
+  pthread_mutex_unlock (&svr->lock);
+}
+
+static void response_put (edgex_rest_server *svr, edgex_http_response *r)
+{
+  if (r->body.data && r->body.cap <= RESPONSE_POOL_MAXBUF)
+  {
+    pthread_mutex_lock (&svr->lock);
+    if (svr->nbufs < RESPONSE_POOL_SIZE)
+    {
+      r->body.len = 0;
+      r->body.data[0] = '\0';
+      svr->bufpool[svr->nbufs++] = r->body;
+      edgex_strbuf_init (&r->body);
+    }
+    pthread_mutex_unlock (&svr->lock);
+  }
+  edgex_http_response_fini (r);
+}
+
+/*
+ * Queue a reply. A buffered body remains owned by the request context until
+ * it completes; a content callback is handed over to the daemon.
+ */
+
+static void queue_reply
+  (struct MHD_Connection *conn, int status, edgex_http_response *r)
+{
+  struct MHD_Response *response;
+
+  if (r->content)
+  {
+    response = MHD_create_response_from_callback
+      (r->size, 4096, r->content, r->content_ctx, r->content_free);
+    r->content = NULL;
+    r->content_free = NULL;
+  }
+  else
+  {
+    response = MHD_create_response_from_buffer
+    (
+      r->body.len, r->body.data ? r->body.data : "", MHD_RESPMEM_PERSISTENT
+    );
+  }
+  MHD_add_response_header
+    (response, "Content-Type", r->type ? r->type : "text/plain");
+  if (*r->etag)
+  {
+    MHD_add_response_header (response, "ETag", r->etag);
+  }
+  MHD_queue_response (conn, status, response);
+  MHD_destroy_response (response);
+}
+
+static void http_context_free (http_context_t *ctx)
+{
+  edgex_strbuf_fini (&ctx->body);
+  free (ctx);
+}
+
+/* Run a blocking handler on the thread pool, then resume its connection */
+
+static void http_pool_handler (void *p)
+{
+  http_context_t *ctx = (http_context_t *) p;
+  edgex_rest_server *svr = ctx->svr;
+
+  EDGEX_TRACE_RESUME (ctx->trace);
+  int status = ctx->h->handler
+  (
+    ctx->h->context,
+    &ctx->params,
+    ctx->method,
+    ctx->body.data,
+    ctx->body.len,
+    &ctx->response
+  );
+  if (!http_handler_done (ctx, status, true))
+  {
+    return;
+  }
+
+  /* ctx may be freed by the daemon as soon as the connection is resumed */
+
+  pthread_mutex_lock (&svr->lock);
+  MHD_resume_connection (ctx->conn);
+  if (--svr->pending == 0)
+  {
+    pthread_cond_signal (&svr->idle);
+  }
+  pthread_mutex_unlock (&svr->lock);
+}
+
+static void http_completed
+(
+  void *cls,
+  struct MHD_Connection *conn,
+  void **context,
+  enum MHD_RequestTerminationCode toe
+)
+{
+  http_context_t *ctx = (http_context_t *) *context;
+  edgex_rest_server *svr = (edgex_rest_server *) cls;
+  if (ctx)
+  {
+    __atomic_add_fetch (&svr->requests, 1, __ATOMIC_RELAXED);
+    edgex_stats_count (EDGEX_STATS_HTTP_REQUESTS, 1);
+    if (ctx->status >= 500)
+    {
+      edgex_stats_count (EDGEX_STATS_HTTP_SERVER_ERRORS, 1);
+    }
+    else if (ctx->status >= 400)
+    {
+      edgex_stats_count (EDGEX_STATS_HTTP_CLIENT_ERRORS, 1);
+    }
+    edgex_stats_time
+      (EDGEX_STATS_HTTP, edgex_device_monotime () - ctx->started);
+    EDGEX_TRACE_RESUME (ctx->trace);
+    EDGEX_TRACE_SPAN (EDGEX_TRACE_HTTP, ctx->started, ctx->path);
+
+    /* Let a streaming handler discard a request which did not complete */
+
+    if (ctx->h && ctx->h->stream && ctx->state)
+    {
+      ctx->h->stream
+      (
+        ctx->h->context, &ctx->params, ctx->method, &ctx->state,
+        NULL, 0, NULL
+      );
+    }
+    response_put (svr, &ctx->response);
+    http_context_free (ctx);
+    *context = NULL;
+  }
+}
+
+static void http_reject
+  (struct MHD_Connection *conn, http_context_t *ctx, int status)
+{
+  queue_reply (conn, status, &ctx->response);
+  ctx->status = status;
+  ctx->replied = true;
+}
+
+/*
+ * Set up a request on its first call: find the handler and check the
+ * declared body size, so that bad requests are refused before their body is
+ * received.
+ */
+
+static http_context_t *http_start
+(
+  edgex_rest_server *svr,
+  struct MHD_Connection *conn,
+  const char *url,
+  const char *methodname
+)
+{
+  size_t len = strlen (url);
+  http_context_t *ctx = (http_context_t *) calloc (1, sizeof (*ctx) + len + 1);
+  ctx->path = (char *) (ctx + 1);
+  memcpy (ctx->path, url, len + 1);
+  edgex_strbuf_init (&ctx->body);
+  response_get (svr, &ctx->response);
+  ctx->response.deferrable = ctx;
+  ctx->svr = svr;
+  ctx->conn = conn;
+  ctx->method = method_from_string (methodname);
+  ctx->started = edgex_device_monotime ();
+  if (svr->deadline)
+  {
+    ctx->response.deadline = ctx->started + svr->deadline;
+  }
+#if CSDK_BUILD_TRACE
+  ctx->trace = edgex_trace_root ();
+#endif
+
+  if (len == 0 || strcmp (url, "/") == 0)
+  {
+    return ctx;
+  }
+
+  ctx->h = edgex_router_find (svr->router, ctx->path, &ctx->params);
+  if (ctx->h == NULL)
+  {
+    http_reject (conn, ctx, MHD_HTTP_NOT_FOUND);
+    return ctx;
+  }
+  if ((ctx->method & ctx->h->methods) == 0)
+  {
+    http_reject (conn, ctx, MHD_HTTP_METHOD_NOT_ALLOWED);
+    return ctx;
+  }
+
+  const char *clen = MHD_lookup_connection_value
+    (conn, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_LENGTH);
+  if (clen)
+  {
+    uint64_t size = strtoull (clen, NULL, 10);
+    if (svr->maxrequest && size > svr->maxrequest)
+    {
+      iot_log_error
+        (svr->lc, "Request body of %s bytes exceeds the limit", clen);
+      http_reject (conn, ctx, MHD_HTTP_PAYLOAD_TOO_LARGE);
+    }
+    else if (size && ctx->h->stream == NULL)
+    {
+      edgex_strbuf_reserve (&ctx->body, size);
+      ctx->body.data[0] = '\0';
+    }
+  }
+  return ctx;
+}
+
+/* Take a chunk of the request body */
+
+static void http_receive
+(
+  edgex_rest_server *svr,
+  struct MHD_Connection *conn,
+  http_context_t *ctx,
+  const char *data,
+  size_t size
+)
+{
+  if (ctx->replied)
+  {
+    return;
+  }
+  if (svr->maxrequest && ctx->body.len + size > svr->maxrequest)
+  {
+    iot_log_error (svr->lc, "Request body exceeds the limit");
+    http_reject (conn, ctx, MHD_HTTP_PAYLOAD_TOO_LARGE);
+    return;
+  }
+  if (ctx->h && ctx->h->stream)
+  {
+    int status = ctx->h->stream
+    (
+      ctx->h->context, &ctx->params, ctx->method, &ctx->state,
+      data, size, NULL
+    );
+    ctx->body.len += size;
+    if (status)
+    {
+      http_reject (conn, ctx, status);
+    }
+  }
+  else
+  {
+    edgex_strbuf_append (&ctx->body, data, size);
   }
-  *rpos = '\0';
-  return res;
 }
 
 static int http_handler
@@ -88,19 +557,25 @@ static int http_handler
   int status = MHD_HTTP_OK;
   http_context_t *ctx = (http_context_t *) *context;
   edgex_rest_server *svr = (edgex_rest_server *) this;
-  struct MHD_Response *response = NULL;
-  char *reply = NULL;
-  const char *reply_type = NULL;
   handler_list *h;
 
-  /* First call used to create call context */
+  /* First call used to create call context. The context is freed when the
+   * request completes, in http_completed.
+   */
 
   if (ctx == 0)
   {
-    ctx = (http_context_t *) malloc (sizeof (*ctx));
-    ctx->m_size = 0;
-    ctx->m_data = NULL;
-    *context = (void *) ctx;
+    *context = http_start (svr, conn, url, methodname);
+    return MHD_YES;
+  }
+
+  /* Called again once a request run on the thread pool, or a deferred
+   * reply, has completed
+   */
+
+  if (ctx->done)
+  {
+    queue_reply (conn, ctx->status, &ctx->response);
     return MHD_YES;
   }
 
@@ -108,36 +583,30 @@ static int http_handler
 
   if (*upload_data_size)
   {
-    ctx->m_data = (char *) realloc
-      (ctx->m_data, ctx->m_size + (*upload_data_size) + 1);
-    memcpy (ctx->m_data + ctx->m_size, upload_data, (*upload_data_size) + 1);
-    ctx->m_size += *upload_data_size;
+    http_receive (svr, conn, ctx, upload_data, *upload_data_size);
     *upload_data_size = 0;
     return MHD_YES;
   }
-  *context = 0;
 
   /* Last call with no data handles request */
 
-  edgex_http_method method = method_from_string (methodname);
+  if (ctx->replied)
+  {
+    return MHD_YES;
+  }
+  h = ctx->h;
+  EDGEX_TRACE_RESUME (ctx->trace);
 
-  if (strlen (url) == 0 || strcmp (url, "/") == 0)
+  if (h == NULL)
   {
-    if (method == GET)
+    if (ctx->method == GET)
     {
       /* List available handlers */
-      int rsize = 1;
       pthread_mutex_lock (&svr->lock);
       for (h = svr->handlers; h; h = h->next)
       {
-        rsize += strlen (h->url) + 1;
-      }
-      reply = malloc (rsize);
-      reply[0] = '\0';
-      for (h = svr->handlers; h; h = h->next)
-      {
-        strcat (reply, h->url);
-        strcat (reply, "\n");
+        edgex_strbuf_appendstr (&ctx->response.body, h->url);
+        edgex_strbuf_appendchar (&ctx->response.body, '\n');
       }
       pthread_mutex_unlock (&svr->lock);
     }
@@ -146,88 +615,175 @@ static int http_handler
       status = MHD_HTTP_METHOD_NOT_ALLOWED;
     }
   }
-  else
+  else if (h->stream)
+  {
+    status = h->stream
+    (
+      h->context, &ctx->params, ctx->method, &ctx->state,
+      NULL, ctx->body.len, &ctx->response
+    );
+    ctx->state = NULL;
+  }
+  else if (h->blocking && svr->pool)
   {
-    status = MHD_HTTP_NOT_FOUND;
-    char *nurl = normalizeUrl (url);
+    /* Free the daemon's thread while the handler runs */
+
     pthread_mutex_lock (&svr->lock);
-    for (h = svr->handlers; h; h = h->next)
-    {
-      if
-      (
-        (h->url[strlen (h->url) - 1] == '/') ?
-        (strncmp (nurl, h->url, strlen (h->url)) == 0) :
-        (strcmp (nurl, h->url) == 0)
-      )
-      {
-        break;
-      }
-    }
+    svr->pending++;
     pthread_mutex_unlock (&svr->lock);
-    if (h)
-    {
-      if (method & h->methods)
-      {
-        status = h->handler
-        (
-          h->context,
-          nurl + strlen (h->url),
-          method,
-          ctx->m_data,
-          ctx->m_size,
-          &reply,
-          &reply_type
-        );
-      }
-      else
-      {
-        status = MHD_HTTP_METHOD_NOT_ALLOWED;
-      }
-    }
-    free (nurl);
+    MHD_suspend_connection (conn);
+    edgex_executor_submit (svr->pool, EDGEX_EXEC_COMMAND, http_pool_handler, ctx);
+    return MHD_YES;
   }
-
-  /* Send reply */
-
-  if (reply_type == NULL)
+  else
   {
-    reply_type = "text/plain";
+    status = h->handler
+    (
+      h->context,
+      &ctx->params,
+      ctx->method,
+      ctx->body.data,
+      ctx->body.len,
+      &ctx->response
+    );
   }
-  if (reply == NULL)
+
+  if (http_handler_done (ctx, status, false))
   {
-    reply = strdup ("");
+    queue_reply (conn, ctx->status, &ctx->response);
   }
-  response = MHD_create_response_from_buffer
-    (strlen (reply), reply, MHD_RESPMEM_MUST_FREE);
-  MHD_add_response_header (response, "Content-Type", reply_type);
-  MHD_queue_response (conn, status, response);
-  MHD_destroy_response (response);
+  return MHD_YES;
+}
 
-  /* Clean up */
+#if MHD_VERSION >= 0x00095300
 
-  if (ctx->m_data)
-  { free (ctx->m_data); }
-  free (ctx);
-  return MHD_YES;
+/* Count connections, so that reuse by keep-alive can be seen in metrics */
+
+static void http_connection
+(
+  void *cls,
+  struct MHD_Connection *conn,
+  void **context,
+  enum MHD_ConnectionNotificationCode toe
+)
+{
+  edgex_rest_server *svr = (edgex_rest_server *) cls;
+  if (toe == MHD_CONNECTION_NOTIFY_STARTED)
+  {
+    __atomic_add_fetch (&svr->accepted, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&svr->connections, 1, __ATOMIC_RELAXED);
+  }
+  else
+  {
+    __atomic_sub_fetch (&svr->connections, 1, __ATOMIC_RELAXED);
+  }
 }
 
+#define EDGEX_MHD_EPOLL MHD_USE_EPOLL_INTERNAL_THREAD
+#define EDGEX_MHD_SELECT MHD_USE_INTERNAL_POLLING_THREAD
+#define EDGEX_MHD_SUSPEND MHD_ALLOW_SUSPEND_RESUME
+#else
+#define EDGEX_MHD_EPOLL MHD_USE_EPOLL_INTERNALLY
+#define EDGEX_MHD_SELECT MHD_USE_SELECT_INTERNALLY
+#define EDGEX_MHD_SUSPEND MHD_USE_SUSPEND_RESUME
+#endif
+
 edgex_rest_server *edgex_rest_server_create
-  (iot_logging_client *lc, uint16_t port, edgex_error *err)
+(
+  iot_logging_client *lc,
+  uint16_t port,
+  const edgex_rest_server_options *opts,
+  edgex_error *err
+)
 {
   edgex_rest_server *svr;
-  uint16_t flags = MHD_USE_THREAD_PER_CONNECTION;
+  unsigned int flags;
+  struct MHD_OptionItem options[8];
+  int nopts = 0;
   /* config: flags |= MHD_USE_IPv6 ? */
 
   svr = malloc (sizeof (edgex_rest_server));
   svr->lc = lc;
   svr->handlers = NULL;
+  svr->router = edgex_router_create ();
+  svr->pool = NULL;
+  svr->suspend = false;
+  svr->pending = 0;
+  svr->maxrequest = opts->maxrequestsize;
+  svr->deadline = opts->deadline * 1000000ULL;
+  svr->nbufs = 0;
+  svr->connections = 0;
+  svr->accepted = 0;
+  svr->requests = 0;
   pthread_mutex_init (&svr->lock, NULL);
+  pthread_cond_init (&svr->idle, NULL);
+  pthread_cond_init (&svr->completed, NULL);
+
+  options[nopts++] = (struct MHD_OptionItem)
+    { MHD_OPTION_NOTIFY_COMPLETED, (intptr_t) http_completed, svr };
+#if MHD_VERSION >= 0x00095300
+  options[nopts++] = (struct MHD_OptionItem)
+    { MHD_OPTION_NOTIFY_CONNECTION, (intptr_t) http_connection, svr };
+#endif
+  if (opts->maxconnections)
+  {
+    options[nopts++] = (struct MHD_OptionItem)
+      { MHD_OPTION_CONNECTION_LIMIT, opts->maxconnections, NULL };
+  }
+  if (opts->maxperip)
+  {
+    options[nopts++] = (struct MHD_OptionItem)
+      { MHD_OPTION_PER_IP_CONNECTION_LIMIT, opts->maxperip, NULL };
+  }
+  if (opts->timeout)
+  {
+    options[nopts++] = (struct MHD_OptionItem)
+      { MHD_OPTION_CONNECTION_TIMEOUT, opts->timeout, NULL };
+  }
+#if MHD_VERSION >= 0x00095300
+  if (opts->backlog)
+  {
+    options[nopts++] = (struct MHD_OptionItem)
+      { MHD_OPTION_LISTEN_BACKLOG_SIZE, opts->backlog, NULL };
+  }
+#endif
+  if (opts->threads)
+  {
+    /* Event loop mode: a fixed set of threads polls all connections */
+
+    flags = EDGEX_MHD_EPOLL | EDGEX_MHD_SUSPEND;
+    svr->pool = opts->pool;
+    svr->suspend = true;
+    if (opts->threads > 1)
+    {
+      options[nopts++] = (struct MHD_OptionItem)
+        { MHD_OPTION_THREAD_POOL_SIZE, opts->threads, NULL };
+    }
+  }
+  else
+  {
+    flags = MHD_USE_THREAD_PER_CONNECTION;
+  }
+  options[nopts] = (struct MHD_OptionItem) { MHD_OPTION_END, 0, NULL };
 
   /* Start http server */
 
   iot_log_debug (lc, "Starting HTTP server on port %d", port);
-  svr->daemon =
-    MHD_start_daemon (flags, port, 0, 0, http_handler, svr, MHD_OPTION_END);
+  svr->daemon = MHD_start_daemon
+  (
+    flags, port, 0, 0, http_handler, svr,
+    MHD_OPTION_ARRAY, options, MHD_OPTION_END
+  );
+  if (svr->daemon == NULL && opts->threads)
+  {
+    iot_log_debug (lc, "epoll not available, falling back to select");
+    flags = EDGEX_MHD_SELECT | EDGEX_MHD_SUSPEND;
+    svr->daemon = MHD_start_daemon
+    (
+      flags, port, 0, 0, http_handler, svr,
+      MHD_OPTION_ARRAY, options, MHD_OPTION_END
+    );
+  }
   if (svr->daemon == NULL)
   {
     *err = EDGEX_HTTP_SERVER_FAIL;
@@ -241,6 +797,31 @@ edgex_rest_server *edgex_rest_server_create
   }
 }
 
+void edgex_rest_server_getstats
+  (edgex_rest_server *svr, edgex_rest_server_stats *stats)
+{
+  stats->connections = __atomic_load_n (&svr->connections, __ATOMIC_RELAXED);
+  stats->accepted = __atomic_load_n (&svr->accepted, __ATOMIC_RELAXED);
+  stats->requests = __atomic_load_n (&svr->requests, __ATOMIC_RELAXED);
+}
+
+static void rest_server_add (edgex_rest_server *svr, handler_list *entry)
+{
+  const char *url = entry->url;
+  pthread_mutex_lock (&svr->lock);
+  if (edgex_router_add (svr->router, url, entry))
+  {
+    entry->next = svr->handlers;
+    svr->handlers = entry;
+  }
+  else
+  {
+    iot_log_error (svr->lc, "Unable to register handler for %s", url);
+    free (entry);
+  }
+  pthread_mutex_unlock (&svr->lock);
+}
+
 void edgex_rest_server_register_handler
 (
   edgex_rest_server *svr,
@@ -249,16 +830,55 @@ void edgex_rest_server_register_handler
   void *context,
   http_method_handler_fn handler
 )
+{
+  edgex_rest_server_register_handler_ex
+    (svr, url, methods, context, handler, false);
+}
+
+void edgex_rest_server_register_handler_ex
+(
+  edgex_rest_server *svr,
+  const char *url,
+  uint32_t methods,
+  void *context,
+  http_method_handler_fn handler,
+  bool blocking
+)
 {
   handler_list *entry = malloc (sizeof (handler_list));
   entry->handler = handler;
+  entry->stream = NULL;
   entry->url = url;
   entry->methods = methods;
   entry->context = context;
-  pthread_mutex_lock (&svr->lock);
-  entry->next = svr->handlers;
-  svr->handlers = entry;
-  pthread_mutex_unlock (&svr->lock);
+  entry->blocking = blocking;
+  rest_server_add (svr, entry);
+}
+
+void edgex_rest_server_register_stream_handler
+(
+  edgex_rest_server *svr,
+  const char *url,
+  uint32_t methods,
+  void *context,
+  http_stream_handler_fn handler
+)
+{
+  handler_list *entry = malloc (sizeof (handler_list));
+  entry->handler = NULL;
+  entry->stream = handler;
+  entry->url = url;
+  entry->methods = methods;
+  entry->context = context;
+  entry->blocking = false;
+  rest_server_add (svr, entry);
+}
+
+http_method_handler_fn edgex_rest_server_find
+  (edgex_rest_server *svr, char *path, edgex_http_params *params)
+{
+  handler_list *h = edgex_router_find (svr->router, path, params);
+  return h ? h->handler : NULL;
 }
 
 void edgex_rest_server_destroy (edgex_rest_server *svr)
@@ -266,6 +886,16 @@ void edgex_rest_server_destroy (edgex_rest_server *svr)
   handler_list *tmp;
   if (svr->daemon)
   {
+    /* Suspended connections must be resumed before the daemon can stop,
+     * so any deferred replies must be completed
+     */
+
+    pthread_mutex_lock (&svr->lock);
+    while (svr->pending)
+    {
+      pthread_cond_wait (&svr->idle, &svr->lock);
+    }
+    pthread_mutex_unlock (&svr->lock);
     MHD_stop_daemon (svr->daemon);
   }
   pthread_mutex_lock (&svr->lock);
@@ -276,6 +906,13 @@ void edgex_rest_server_destroy (edgex_rest_server *svr)
     svr->handlers = tmp;
   }
   pthread_mutex_unlock (&svr->lock);
+  edgex_router_free (svr->router);
+  while (svr->nbufs)
+  {
+    edgex_strbuf_fini (&svr->bufpool[--svr->nbufs]);
+  }
   pthread_mutex_destroy (&svr->lock);
+  pthread_cond_destroy (&svr->idle);
+  pthread_cond_destroy (&svr->completed);
   free (svr);
 }
@@ -12,6 +12,12 @@
 #include "edgex/edgex.h"
 #include "edgex/edgex_logging.h"
 #include "edgex/error.h"
+#include "executor.h"
+#include "router.h"
+#include "strbuf.h"
+#include "parson.h"
+
+#include <sys/types.h>
 
 struct edgex_rest_server;
 typedef struct edgex_rest_server edgex_rest_server;
@@ -26,19 +32,173 @@ typedef enum
   UNKNOWN = 1024
 } edgex_http_method;
 
+/*
+ * Produce up to max bytes of a streamed response body at offset pos. Returns
+ * the number of bytes written, MHD_CONTENT_READER_END_OF_STREAM or
+ * MHD_CONTENT_READER_END_WITH_ERROR.
+ */
+
+struct edgex_http_deferred;
+typedef struct edgex_http_deferred edgex_http_deferred;
+
+typedef ssize_t (*edgex_http_content_fn)
+  (void *ctx, uint64_t pos, char *buf, size_t max);
+
+typedef void (*edgex_http_content_free_fn) (void *ctx);
+
+/* Space for an entity tag, including its quotes and terminator */
+
+#define EDGEX_HTTP_ETAG_SIZE 40
+
+/*
+ * The reply to a request. Handlers append the body to the buffer provided,
+ * which is reused across requests, or set a content callback to generate it
+ * as it is sent. type defaults to text/plain. If etag is set, it is sent as
+ * the ETag header. deadline is set by the server to the monotonic time (in
+ * nanoseconds) by which the reply is due, or zero if there is none.
+ */
+
+typedef struct edgex_http_response
+{
+  const char *type;
+  edgex_strbuf body;
+  uint64_t size;
+  edgex_http_content_fn content;
+  edgex_http_content_free_fn content_free;
+  void *content_ctx;
+  char etag[EDGEX_HTTP_ETAG_SIZE];
+  uint64_t deadline;
+
+  /* Set by the server when the reply may be deferred */
+
+  edgex_http_deferred *deferrable;
+} edgex_http_response;
+
+extern void edgex_http_response_init (edgex_http_response *r);
+
+extern void edgex_http_response_fini (edgex_http_response *r);
+
+/* Append the serialized form of a JSON value to the body */
+
+extern void edgex_http_response_json
+  (edgex_http_response *r, const JSON_Value *val);
+
+/*
+ * Generate the body with a callback. size may be MHD_SIZE_UNKNOWN. The server
+ * calls content_free, if set, when the response has been sent.
+ */
+
+extern void edgex_http_response_stream
+(
+  edgex_http_response *r,
+  const char *type,
+  uint64_t size,
+  edgex_http_content_fn content,
+  edgex_http_content_free_fn content_free,
+  void *ctx
+);
+
+/*
+ * Defer the reply to a request. The handler's return value is ignored and
+ * the reply is sent when edgex_http_deferred_complete is called, which may
+ * be done from any thread; the response remains valid until then. Returns
+ * NULL if the reply cannot be deferred, eg if the response is not for a
+ * request received by the server.
+ */
+
+extern edgex_http_deferred *edgex_http_response_defer
+  (edgex_http_response *r);
+
+/* Send a deferred reply, with the given status */
+
+extern void edgex_http_deferred_complete (edgex_http_deferred *d, int status);
+
+/*
+ * Return the value of a header of the request being replied to, or NULL if
+ * there is no such header or the response is not for a request received by
+ * the server.
+ */
+
+extern const char *edgex_http_request_header
+  (const edgex_http_response *r, const char *name);
+
+/* As above, for an argument in the query string of the request */
+
+extern const char *edgex_http_request_arg
+  (const edgex_http_response *r, const char *name);
+
+/*
+ * Whether an If-None-Match header value matches an entity tag, ie if it is
+ * "*" or lists the tag, which may be given as weak.
+ */
+
+extern bool edgex_http_etag_match (const char *header, const char *etag);
+
 typedef int (*http_method_handler_fn)
 (
   void *context,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 );
 
+/*
+ * A handler which receives the request body incrementally. It is called with
+ * each chunk of data as it arrives, with reply NULL; a nonzero
+ * return fails the request with that status. It is then called once with
+ * data NULL and size set to the total length received, and returns the
+ * status for the reply as for an http_method_handler_fn. If the request is
+ * abandoned, the final call has reply NULL. state is initially NULL and may
+ * be used to hold per-request data.
+ */
+
+typedef int (*http_stream_handler_fn)
+(
+  void *context,
+  const edgex_http_params *params,
+  edgex_http_method method,
+  void **state,
+  const char *data,
+  size_t size,
+  edgex_http_response *reply
+);
+
+typedef struct edgex_rest_server_options
+{
+  /*
+   * Number of threads polling connections. Zero selects one thread per
+   * connection; otherwise handlers registered as blocking are run on pool.
+   */
+  uint32_t threads;
+  /* Maximum concurrent connections, zero for the library default */
+  uint32_t maxconnections;
+  /* Maximum concurrent connections from one address, zero for no limit */
+  uint32_t maxperip;
+  /* Seconds after which an idle connection is closed, zero for never */
+  uint32_t timeout;
+  /* Length of the queue of connections awaiting accept, zero for default */
+  uint32_t backlog;
+  /* Largest request body accepted, zero for no limit */
+  uint64_t maxrequestsize;
+  /* Milliseconds allowed to reply to a request, zero for no limit */
+  uint32_t deadline;
+  edgex_executor *pool;
+} edgex_rest_server_options;
+
 extern edgex_rest_server *edgex_rest_server_create
-  (iot_logging_client *lc, uint16_t port, edgex_error *err);
+(
+  iot_logging_client *lc,
+  uint16_t port,
+  const edgex_rest_server_options *opts,
+  edgex_error *err
+);
+
+/*
+ * Register a handler for a URL pattern. Segments of the form {name} match any
+ * path segment and are passed to the handler as parameters.
+ */
 
 extern void edgex_rest_server_register_handler
 (
@@ -49,6 +209,53 @@ extern void edgex_rest_server_register_handler
   http_method_handler_fn handler
 );
 
+/*
+ * Register a handler, indicating whether it may block for long periods (eg
+ * waiting on a device). When the server is polling connections, blocking
+ * handlers are run on the thread pool so as not to hold up other requests.
+ */
+
+extern void edgex_rest_server_register_handler_ex
+(
+  edgex_rest_server *svr,
+  const char *url,
+  edgex_http_method method,
+  void *context,
+  http_method_handler_fn handler,
+  bool blocking
+);
+
+/*
+ * Find the handler for a path, as for an incoming request. The path is
+ * modified as for edgex_router_find.
+ */
+
+extern http_method_handler_fn edgex_rest_server_find
+  (edgex_rest_server *svr, char *path, edgex_http_params *params);
+
+/* Register a handler which takes the request body as it is received */
+
+extern void edgex_rest_server_register_stream_handler
+(
+  edgex_rest_server *svr,
+  const char *url,
+  edgex_http_method method,
+  void *context,
+  http_stream_handler_fn handler
+);
+
+typedef struct edgex_rest_server_stats
+{
+  uint64_t connections;  // Connections currently open
+  uint64_t accepted;     // Connections accepted
+  uint64_t requests;     // Requests completed
+} edgex_rest_server_stats;
+
+/* Connections are counted with libmicrohttpd 0.9.53 and later */
+
+extern void edgex_rest_server_getstats
+  (edgex_rest_server *svr, edgex_rest_server_stats *stats);
+
 extern void edgex_rest_server_destroy (edgex_rest_server *svr);
 
 #endif
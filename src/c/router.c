@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "router.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each node holds its literal children in an array sorted by label. Adding a
+ * child replaces the array with an extended copy, published atomically; the
+ * old array is kept until the router is freed, so a concurrent lookup never
+ * sees it disappear. Nodes are likewise freed only with the router.
+ */
+
+typedef struct router_node router_node;
+
+typedef struct router_edge
+{
+  char *label;
+  router_node *node;
+} router_edge;
+
+typedef struct router_edges
+{
+  unsigned n;
+  struct router_edges *garbage;
+  router_edge e[];
+} router_edges;
+
+struct router_node
+{
+  router_edges *edges;
+  router_node *param;
+  char *pname;
+  void *target;
+};
+
+struct edgex_router
+{
+  router_node root;
+  router_edges *garbage;
+};
+
+const char *edgex_http_param (const edgex_http_params *params, const char *name)
+{
+  for (unsigned i = 0; i < params->n; i++)
+  {
+    if (strcmp (params->names[i], name) == 0)
+    {
+      return params->values[i];
+    }
+  }
+  return NULL;
+}
+
+edgex_router *edgex_router_create (void)
+{
+  return calloc (1, sizeof (edgex_router));
+}
+
+static void router_node_fini (router_node *n)
+{
+  if (n->edges)
+  {
+    for (unsigned i = 0; i < n->edges->n; i++)
+    {
+      router_node_fini (n->edges->e[i].node);
+      free (n->edges->e[i].node);
+      free (n->edges->e[i].label);
+    }
+    free (n->edges);
+  }
+  if (n->param)
+  {
+    router_node_fini (n->param);
+    free (n->param);
+  }
+  free (n->pname);
+}
+
+void edgex_router_free (edgex_router *r)
+{
+  if (r)
+  {
+    router_node_fini (&r->root);
+    while (r->garbage)
+    {
+      router_edges *g = r->garbage;
+      r->garbage = g->garbage;
+      free (g);
+    }
+    free (r);
+  }
+}
+
+/* Split a path into its non-empty segments, in place */
+
+static unsigned router_split (char *path, char **segs)
+{
+  unsigned n = 0;
+  char *p = path;
+  while (*p)
+  {
+    while (*p == '/')
+    {
+      *p++ = '\0';
+    }
+    if (*p == '\0')
+    {
+      break;
+    }
+    if (n == EDGEX_HTTP_MAXSEGMENTS)
+    {
+      return EDGEX_HTTP_MAXSEGMENTS + 1;
+    }
+    segs[n++] = p;
+    while (*p && *p != '/')
+    {
+      p++;
+    }
+  }
+  return n;
+}
+
+static router_node *router_edge_find
+  (const router_edges *edges, const char *label, unsigned *pos)
+{
+  unsigned lo = 0;
+  unsigned hi = edges ? edges->n : 0;
+  while (lo < hi)
+  {
+    unsigned mid = (lo + hi) / 2;
+    int c = strcmp (label, edges->e[mid].label);
+    if (c == 0)
+    {
+      return edges->e[mid].node;
+    }
+    if (c < 0)
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  if (pos)
+  {
+    *pos = lo;
+  }
+  return NULL;
+}
+
+static router_node *router_child_add
+  (edgex_router *r, router_node *n, const char *label, unsigned pos)
+{
+  router_edges *old = n->edges;
+  unsigned count = old ? old->n : 0;
+  router_edges *edges =
+    malloc (sizeof (router_edges) + (count + 1) * sizeof (router_edge));
+  router_node *child = calloc (1, sizeof (router_node));
+
+  edges->n = count + 1;
+  edges->garbage = NULL;
+  if (pos)
+  {
+    memcpy (edges->e, old->e, pos * sizeof (router_edge));
+  }
+  edges->e[pos].label = strdup (label);
+  edges->e[pos].node = child;
+  if (count > pos)
+  {
+    memcpy
+      (edges->e + pos + 1, old->e + pos, (count - pos) * sizeof (router_edge));
+  }
+  __atomic_store_n (&n->edges, edges, __ATOMIC_RELEASE);
+  if (old)
+  {
+    old->garbage = r->garbage;
+    r->garbage = old;
+  }
+  return child;
+}
+
+bool edgex_router_add (edgex_router *r, const char *pattern, void *target)
+{
+  char *segs[EDGEX_HTTP_MAXSEGMENTS + 1];
+  char *copy = strdup (pattern);
+  unsigned nsegs = router_split (copy, segs);
+  router_node *n = &r->root;
+  bool result = (nsegs <= EDGEX_HTTP_MAXSEGMENTS);
+
+  for (unsigned i = 0; result && i < nsegs; i++)
+  {
+    size_t len = strlen (segs[i]);
+    if (len > 2 && segs[i][0] == '{' && segs[i][len - 1] == '}')
+    {
+      segs[i][len - 1] = '\0';
+      const char *pname = segs[i] + 1;
+      if (n->param == NULL)
+      {
+        router_node *child = calloc (1, sizeof (router_node));
+        child->pname = strdup (pname);
+        __atomic_store_n (&n->param, child, __ATOMIC_RELEASE);
+      }
+      else if (strcmp (n->param->pname, pname))
+      {
+        result = false;
+      }
+      n = n->param;
+    }
+    else
+    {
+      unsigned pos;
+      router_node *child = router_edge_find (n->edges, segs[i], &pos);
+      n = child ? child : router_child_add (r, n, segs[i], pos);
+    }
+  }
+  if (result)
+  {
+    __atomic_store_n (&n->target, target, __ATOMIC_RELEASE);
+  }
+  free (copy);
+  return result;
+}
+
+static void *router_match
+(
+  const router_node *n,
+  char **segs,
+  unsigned nsegs,
+  edgex_http_params *params
+)
+{
+  if (nsegs == 0)
+  {
+    return __atomic_load_n (&n->target, __ATOMIC_ACQUIRE);
+  }
+
+  const router_edges *edges = __atomic_load_n (&n->edges, __ATOMIC_ACQUIRE);
+  const router_node *child = router_edge_find (edges, segs[0], NULL);
+  if (child)
+  {
+    void *result = router_match (child, segs + 1, nsegs - 1, params);
+    if (result)
+    {
+      return result;
+    }
+  }
+
+  child = __atomic_load_n (&n->param, __ATOMIC_ACQUIRE);
+  if (child && params->n < EDGEX_HTTP_MAXPARAMS)
+  {
+    unsigned i = params->n++;
+    params->names[i] = child->pname;
+    params->values[i] = segs[0];
+    void *result = router_match (child, segs + 1, nsegs - 1, params);
+    if (result)
+    {
+      return result;
+    }
+    params->n = i;
+  }
+  return NULL;
+}
+
+void *edgex_router_find
+  (const edgex_router *r, char *path, edgex_http_params *params)
+{
+  char *segs[EDGEX_HTTP_MAXSEGMENTS + 1];
+  unsigned nsegs = router_split (path, segs);
+
+  params->n = 0;
+  if (nsegs > EDGEX_HTTP_MAXSEGMENTS)
+  {
+    return NULL;
+  }
+  return router_match (&r->root, segs, nsegs, params);
+}
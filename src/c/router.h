@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_ROUTER_H_
+#define _EDGEX_DEVICE_ROUTER_H_ 1
+
+#include <stdbool.h>
+
+#define EDGEX_HTTP_MAXPARAMS 4
+#define EDGEX_HTTP_MAXSEGMENTS 16
+
+/* Parameters extracted from a request path */
+
+typedef struct edgex_http_params
+{
+  unsigned n;
+  const char *names[EDGEX_HTTP_MAXPARAMS];
+  const char *values[EDGEX_HTTP_MAXPARAMS];
+} edgex_http_params;
+
+/* Return the value of the named parameter, or NULL if it was not matched */
+
+extern const char *edgex_http_param
+  (const edgex_http_params *params, const char *name);
+
+/*
+ * A trie of path segments mapping URL patterns to targets. A pattern segment
+ * of the form {name} matches any non-empty segment, which is then available
+ * as a parameter. Literal segments take precedence over parameters.
+ *
+ * Routes may be added while lookups are in progress, but additions must be
+ * serialized by the caller. Lookups take no locks.
+ */
+
+typedef struct edgex_router edgex_router;
+
+extern edgex_router *edgex_router_create (void);
+
+extern void edgex_router_free (edgex_router *r);
+
+/*
+ * Add a route. Returns false if the pattern names a parameter differently
+ * from an existing pattern at the same position, or is too long.
+ */
+
+extern bool edgex_router_add
+  (edgex_router *r, const char *pattern, void *target);
+
+/*
+ * Find the target for a path. The path is normalized and split in place, and
+ * any parameters point into it. Returns NULL if no route matches.
+ */
+
+extern void *edgex_router_find
+  (const edgex_router *r, char *path, edgex_http_params *params);
+
+#endif
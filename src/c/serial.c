@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "serial.h"
+#include "map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ * A key has a mailbox in the map while it has users: queued work, a drain
+ * task, or a caller of edgex_serial_run. The run lock is held while any work for the
+ * key is done. At most one drain task is scheduled for a mailbox at a time;
+ * it runs a limited number of items before resubmitting itself, so that a
+ * busy key does not keep a worker from the others.
+ */
+
+#define SERIAL_BATCH 8
+
+typedef struct serial_item
+{
+  edgex_exec_fn fn;
+  void *arg;
+  struct serial_item *next;
+} serial_item;
+
+typedef struct serial_box
+{
+  edgex_serial *owner;
+  char *key;
+  pthread_mutex_t run;
+  serial_item *head;
+  serial_item **tail;
+  unsigned users;
+  bool draining;
+} serial_box;
+
+struct edgex_serial
+{
+  pthread_mutex_t lock;
+  edgex_map_void boxes;
+  edgex_executor *ex;
+};
+
+edgex_serial *edgex_serial_create (edgex_executor *ex)
+{
+  edgex_serial *s = malloc (sizeof (edgex_serial));
+  pthread_mutex_init (&s->lock, NULL);
+  edgex_map_init (&s->boxes);
+  s->ex = ex;
+  return s;
+}
+
+/* Find or create the mailbox for a key, as a new user. Called locked */
+
+static serial_box *serial_acquire (edgex_serial *s, const char *key)
+{
+  serial_box *box;
+  void **found = edgex_map_get (&s->boxes, key);
+  if (found)
+  {
+    box = (serial_box *) *found;
+  }
+  else
+  {
+    box = calloc (1, sizeof (serial_box));
+    box->owner = s;
+    box->key = strdup (key);
+    pthread_mutex_init (&box->run, NULL);
+    box->tail = &box->head;
+    edgex_map_set (&s->boxes, key, box);
+  }
+  box->users++;
+  return box;
+}
+
+/* Remove a user, freeing the mailbox if it was the last. Called locked */
+
+static void serial_release (edgex_serial *s, serial_box *box)
+{
+  if (--box->users == 0)
+  {
+    edgex_map_remove (&s->boxes, box->key);
+    pthread_mutex_destroy (&box->run);
+    free (box->key);
+    free (box);
+  }
+}
+
+static void serial_drain (void *arg)
+{
+  serial_box *box = (serial_box *) arg;
+  edgex_serial *s = box->owner;
+  unsigned n = 0;
+
+  pthread_mutex_lock (&s->lock);
+  while (box->head && n++ < SERIAL_BATCH)
+  {
+    serial_item *item = box->head;
+    box->head = item->next;
+    if (box->head == NULL)
+    {
+      box->tail = &box->head;
+    }
+    pthread_mutex_unlock (&s->lock);
+
+    pthread_mutex_lock (&box->run);
+    item->fn (item->arg);
+    pthread_mutex_unlock (&box->run);
+    free (item);
+
+    pthread_mutex_lock (&s->lock);
+    box->users--;
+  }
+  if (box->head)
+  {
+    edgex_executor_submit (s->ex, EDGEX_EXEC_COMMAND, serial_drain, box);
+  }
+  else
+  {
+    box->draining = false;
+    serial_release (s, box);
+  }
+  pthread_mutex_unlock (&s->lock);
+}
+
+void edgex_serial_submit
+  (edgex_serial *s, const char *key, edgex_exec_fn fn, void *arg)
+{
+  serial_item *item = malloc (sizeof (serial_item));
+  item->fn = fn;
+  item->arg = arg;
+  item->next = NULL;
+
+  pthread_mutex_lock (&s->lock);
+  serial_box *box = serial_acquire (s, key);
+  *box->tail = item;
+  box->tail = &item->next;
+  if (!box->draining)
+  {
+    box->draining = true;
+    box->users++;
+    edgex_executor_submit (s->ex, EDGEX_EXEC_COMMAND, serial_drain, box);
+  }
+  pthread_mutex_unlock (&s->lock);
+}
+
+void edgex_serial_run
+  (edgex_serial *s, const char *key, edgex_exec_fn fn, void *arg)
+{
+  pthread_mutex_lock (&s->lock);
+  serial_box *box = serial_acquire (s, key);
+  pthread_mutex_unlock (&s->lock);
+
+  pthread_mutex_lock (&box->run);
+  fn (arg);
+  pthread_mutex_unlock (&box->run);
+
+  pthread_mutex_lock (&s->lock);
+  serial_release (s, box);
+  pthread_mutex_unlock (&s->lock);
+}
+
+void edgex_serial_free (edgex_serial *s)
+{
+  if (s)
+  {
+    edgex_map_deinit (&s->boxes);
+    pthread_mutex_destroy (&s->lock);
+    free (s);
+  }
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_SERIAL_H_
+#define _EDGEX_DEVICE_SERIAL_H_ 1
+
+#include "executor.h"
+
+/*
+ * Serialization of work by key. Each key has a mailbox: work submitted for
+ * a key is queued there and run in order by a task on the executor, so
+ * submitting never blocks, and work for different keys runs in parallel.
+ * Work may also be run directly by a caller which is to wait for it anyway;
+ * it still never runs at the same time as other work for its key.
+ */
+
+typedef struct edgex_serial edgex_serial;
+
+extern edgex_serial *edgex_serial_create (edgex_executor *ex);
+
+/* Queue fn (arg) to run after the work already submitted for key */
+
+extern void edgex_serial_submit
+  (edgex_serial *s, const char *key, edgex_exec_fn fn, void *arg);
+
+/* Call fn (arg) on this thread, when no other work for key is running */
+
+extern void edgex_serial_run
+  (edgex_serial *s, const char *key, edgex_exec_fn fn, void *arg);
+
+/* Free the serializer. No work may be queued or running */
+
+extern void edgex_serial_free (edgex_serial *s);
+
+#endif
@@ -14,23 +14,38 @@
 #include "errorlist.h"
 #include "rest_server.h"
 #include "profiles.h"
+#include "snapshot.h"
 #include "metadata.h"
 #include "data.h"
+#include "endpoints.h"
+#include "transport.h"
 #include "rest.h"
 #include "edgex_rest.h"
 #include "edgex_time.h"
+#include "trace.h"
+#include "startup.h"
+#include "memstats.h"
 #include "edgex/csdk-defs.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <dirent.h>
+#include <sched.h>
 
 #include <microhttpd.h>
 
 #define EDGEX_DEV_API_PING "/api/v1/ping"
+#define EDGEX_DEV_API_TRACE "/api/v1/trace"
 #define EDGEX_DEV_API_DISCOVERY "/api/v1/discovery"
 #define EDGEX_DEV_API_DEVICE "/api/v1/device/"
+#define EDGEX_DEV_API_DEVICE_ID EDGEX_DEV_API_DEVICE "{id}/{command}"
+#define EDGEX_DEV_API_DEVICE_NAME EDGEX_DEV_API_DEVICE "name/{name}/{command}"
+#define EDGEX_DEV_API_DEVICE_ALL EDGEX_DEV_API_DEVICE "all/{command}"
+#define EDGEX_DEV_API_HISTORY "/api/v1/history/"
+#define EDGEX_DEV_API_HISTORY_ID EDGEX_DEV_API_HISTORY "{id}/{command}"
+#define EDGEX_DEV_API_HISTORY_NAME EDGEX_DEV_API_HISTORY "name/{name}/{command}"
 #define EDGEX_DEV_API_CALLBACK "/api/v1/callback"
 #define EDGEX_DEV_API_CONFIG "/api/v1/config"
 #define EDGEX_DEV_API_METRICS "/api/v1/metrics"
@@ -39,19 +54,45 @@
 
 #define POOL_THREADS 8
 
-typedef struct postparams
-{
-  edgex_device_service *svc;
-  JSON_Value *jevent;
-} postparams;
+/* Maximum number of Schedules or ScheduleEvents created at once */
+
+#define SCHEDULE_TASKS 8
+
+/* Events smaller than this (in bytes) are not worth compressing */
+
+#define DEFAULT_COMPRESS_MIN 1024
+
+typedef struct edgex_device_service_jobgroup edgex_device_service_jobgroup;
 
 typedef struct edgex_device_service_job
 {
   edgex_device_service *svc;
+  char *name;
   char *url;
+  char *path;
+  edgex_http_params params;
+  bool bound;
+  edgex_device_binding binding;
+  uint64_t interval;
+  bool merge;
+  uint64_t every;
+  edgex_device_service_jobgroup *group;
   struct edgex_device_service_job *next;
 } edgex_device_service_job;
 
+/* Scheduled reads of one device, run together. See scheduleMerged. */
+
+struct edgex_device_service_jobgroup
+{
+  edgex_device_service *svc;
+  const char *device;
+  bool byName;
+  uint64_t ticks;
+  unsigned njobs;
+  edgex_device_service_job **jobs;
+  struct edgex_device_service_jobgroup *next;
+};
+
 edgex_device_service *edgex_device_service_new
 (
   const char *name,
@@ -84,160 +125,253 @@ edgex_device_service *edgex_device_service_new
   }
 
   *err = EDGEX_OK;
+  edgex_mem_json_init ();
   edgex_device_service *result = malloc (sizeof (edgex_device_service));
   memset (result, 0, sizeof (edgex_device_service));
   result->name = name;
   result->version = version;
   result->userdata = impldata;
   result->userfns = implfns;
-  pthread_rwlockattr_t rwatt;
-  pthread_rwlockattr_init (&rwatt);
-#ifdef  __GLIBC_PREREQ
-#if __GLIBC_PREREQ(2, 1)
-  /* Avoid heavy readlock use (eg spammed "all" commands) blocking discovery */
-  pthread_rwlockattr_setkind_np
-    (&rwatt, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
-#endif
-#endif
-  pthread_rwlock_init (&result->deviceslock, &rwatt);
   pthread_mutex_init (&result->discolock, NULL);
   pthread_mutex_init (&result->profileslock, NULL);
-  edgex_map_init (&result->devices);
-  edgex_map_init (&result->name_to_id);
+  pthread_mutex_init (&result->configreply.lock, NULL);
+  pthread_mutex_init (&result->asynclock, NULL);
+  pthread_cond_init (&result->asynccond, NULL);
+  result->devices = edgex_devreg_create ();
   result->sjobs = NULL;
-  result->thpool = thpool_init (POOL_THREADS);
-  result->scheduler = iot_scheduler_init (&result->thpool);
   return result;
 }
 
 static int ping_handler
 (
   void *ctx,
-  char *url,
+  const edgex_http_params *params,
   edgex_http_method method,
   const char *upload_data,
   size_t upload_data_size,
-  char **reply,
-  const char **reply_type
+  edgex_http_response *reply
 )
 {
-  *reply = strdup ("{\"value\":\"pong\"}\n");
-  *reply_type = "application/json";
+  edgex_strbuf_appendstr (&reply->body, "{\"value\":\"pong\"}\n");
+  reply->type = "application/json";
   return MHD_HTTP_OK;
 }
 
 static void dev_invoker (void *p)
 {
   int rc;
-  char *reply = NULL;
-  const char *reply_type;
   edgex_device_service_job *job = (edgex_device_service_job *) p;
 
-  rc = edgex_device_handler_device
-    (job->svc, job->url, GET, NULL, 0, &reply, &reply_type);
+  EDGEX_TRACE_ROOT ();
+  EDGEX_TRACE_START (traced);
+  if (job->bound)
+  {
+    rc = edgex_device_get_bound (job->svc, &job->binding);
+  }
+  else
+  {
+    edgex_http_response reply;
+    edgex_http_response_init (&reply);
+    rc = edgex_device_handler_device
+      (job->svc, &job->params, GET, NULL, 0, &reply);
+    edgex_http_response_fini (&reply);
+  }
+  EDGEX_TRACE_SPAN (EDGEX_TRACE_SCHEDULE, traced, job->name);
 
   if (rc != MHD_HTTP_OK)
   {
     iot_log_error
     (
       job->svc->logger,
-      "Scheduled request to " EDGEX_DEV_API_DEVICE "%s: HTTP %d",
+      "Scheduled request to %s: HTTP %d",
       job->url, rc
     );
   }
-  free (reply);
 }
 
-static void startConfigured
-(
-  edgex_device_service *svc,
-  edgex_registry *registry,
-  toml_table_t *config,
-  const char *profile,
-  edgex_error *err
-)
+static void group_invoker (void *p)
 {
-  edgex_device_validateConfig (svc, err);
-  if (err->code)
+  edgex_device_service_jobgroup *g = (edgex_device_service_jobgroup *) p;
+  uint64_t tick = __atomic_fetch_add (&g->ticks, 1, __ATOMIC_RELAXED);
+  edgex_device_binding *bindings[g->njobs];
+  unsigned n = 0;
+
+  for (unsigned i = 0; i < g->njobs; i++)
   {
-    return;
+    if (tick % g->jobs[i]->every == 0)
+    {
+      bindings[n++] = &g->jobs[i]->binding;
+    }
   }
-
-  if (svc->config.logging.file)
+  if (n)
   {
-    iot_log_addlogger
-      (svc->logger, iot_log_tofile, svc->config.logging.file);
+    EDGEX_TRACE_ROOT ();
+    EDGEX_TRACE_START (traced);
+    edgex_device_get_merged
+      (g->svc, n, bindings, g->svc->config.device.combinescheduledevents);
+    EDGEX_TRACE_SPAN (EDGEX_TRACE_SCHEDULE, traced, bindings[0]->id);
   }
-  if (svc->config.logging.remoteurl)
+}
+
+static uint64_t gcd (uint64_t a, uint64_t b)
+{
+  while (b)
   {
-    iot_log_addlogger
-      (svc->logger, edgex_log_torest, svc->config.logging.remoteurl);
+    uint64_t t = a % b;
+    a = b;
+    b = t;
   }
+  return a;
+}
 
-  if (profile)
+/*
+ * Combine the scheduled reads of each device. A group's schedule ticks at
+ * the greatest common divisor of its members' intervals, and on each tick
+ * those members which are due are read together.
+ */
+
+static void scheduleMerged (edgex_device_service *svc)
+{
+  for (edgex_device_service_job *job = svc->sjobs; job; job = job->next)
   {
-    iot_log_info (svc->logger, "Uploading configuration to registry.");
-    edgex_nvpairs *c = edgex_device_getConfig (svc);
-    edgex_registry_put_config (registry, svc->name, profile, c, err);
-    edgex_nvpairs_free (c);
-    if (err->code)
+    if (!job->merge || job->group)
     {
-      iot_log_error (svc->logger, "Unable to upload config: %s", err->reason);
-      return;
+      continue;
+    }
+    const char *name = edgex_http_param (&job->params, "name");
+    edgex_device_service_jobgroup *g =
+      calloc (1, sizeof (edgex_device_service_jobgroup));
+    g->svc = svc;
+    g->byName = (name != NULL);
+    g->device = name ? name : edgex_http_param (&job->params, "id");
+
+    uint64_t interval = 0;
+    for (edgex_device_service_job *j = job; j; j = j->next)
+    {
+      const char *dev = edgex_http_param
+        (&j->params, g->byName ? "name" : "id");
+      if (j->merge && !j->group && dev && strcmp (dev, g->device) == 0)
+      {
+        j->group = g;
+        g->njobs++;
+        interval = gcd (interval, j->interval);
+      }
+    }
+
+    if (g->njobs == 1)
+    {
+      job->group = NULL;
+      job->merge = false;
+      free (g);
+      edgex_timerwheel_add
+      (
+        svc->timers, job->name, job->interval,
+        EDGEX_EXEC_COMMAND, dev_invoker, job
+      );
+      continue;
+    }
+
+    unsigned n = 0;
+    g->jobs = malloc (g->njobs * sizeof (edgex_device_service_job *));
+    for (edgex_device_service_job *j = job; j; j = j->next)
+    {
+      if (j->group == g)
+      {
+        j->every = j->interval / interval;
+        g->jobs[n++] = j;
+      }
     }
+    g->next = svc->sgroups;
+    svc->sgroups = g;
+    iot_log_debug
+    (
+      svc->logger, "Merging %u scheduled events for device %s",
+      g->njobs, g->device
+    );
+    edgex_timerwheel_add
+      (svc->timers, g->device, interval, EDGEX_EXEC_COMMAND, group_invoker, g);
   }
+}
 
-  iot_log_debug
-  (
-    svc->logger,
-    "Starting %s device service, version %s",
-    svc->name, svc->version
-  );
-  iot_log_debug
-    (svc->logger, "EdgeX device SDK for C, version " CSDK_VERSION_STR);
-  edgex_device_dumpConfig (svc);
+/*
+ * Create the executor. Discovery is limited to one thread, so that it never
+ * holds up scheduled events and device commands.
+ */
 
-  svc->adminstate = UNLOCKED;
-  svc->opstate = ENABLED;
+static edgex_executor *createExecutor (edgex_device_service *svc)
+{
+  unsigned limits[EDGEX_EXEC_NCLASSES] = { 0, 1 };
+  unsigned nthreads = svc->config.service.workerthreads;
+  const char *cpulist = svc->config.service.workercpus;
+  int *cpus = NULL;
+  unsigned ncpus = 0;
+
+  if (cpulist && *cpulist)
+  {
+    cpus = malloc ((strlen (cpulist) / 2 + 1) * sizeof (int));
+    for (const char *p = cpulist; *p; )
+    {
+      char *end;
+      long cpu = strtol (p, &end, 10);
+      if (end == p || cpu < 0 || cpu >= CPU_SETSIZE)
+      {
+        iot_log_error
+          (svc->logger, "Invalid CPU list \"%s\" in WorkerCPUs", cpulist);
+        ncpus = 0;
+        break;
+      }
+      cpus[ncpus++] = cpu;
+      p = (*end == ',') ? end + 1 : end;
+    }
+  }
+  edgex_executor *result = edgex_executor_create
+    (nthreads ? nthreads : POOL_THREADS, limits, cpus, ncpus);
+  free (cpus);
+  return result;
+}
+
+/* Wait for a service to respond to ping, retrying as configured */
 
-  /* Wait for metadata and data to be available */
+typedef bool (*pingFn)
+  (iot_logging_client *lc, edgex_service_endpoints *endpoints, edgex_error *err);
 
+static void waitForService
+  (edgex_device_service *svc, pingFn ping, const char *name, edgex_error *err)
+{
   int retries = svc->config.service.connectretries;
-  struct timespec delay =
-  {
-    .tv_sec = svc->config.service.timeout / 1000,
-    .tv_nsec = 1000000 * (svc->config.service.timeout % 1000)
-  };
-  while (!edgex_data_client_ping (svc->logger, &svc->config.endpoints, err) &&
-         --retries)
+  uint64_t base = svc->config.service.timeout * 1000000ULL;
+  uint64_t limit = svc->config.service.backofflimit * 1000000ULL;
+  uint64_t step = 0;
+  while (!ping (svc->logger, &svc->config.endpoints, err) &&
+         --retries && !__atomic_load_n (&svc->stopping, __ATOMIC_RELAXED))
   {
+    uint64_t ns = edgex_device_backoff (&step, base, limit);
+    struct timespec delay =
+      { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
     nanosleep (&delay, NULL);
   }
-  if (retries == 0)
+  if (err->code)
   {
-    iot_log_error (svc->logger, "core-data service not running");
+    iot_log_error (svc->logger, "%s service not running", name);
     *err = EDGEX_REMOTE_SERVER_DOWN;
-    return;
   }
+}
+
+/* Wait for metadata and data to be available */
 
-  retries = svc->config.service.connectretries;
-  while (
-    !edgex_metadata_client_ping (svc->logger, &svc->config.endpoints, err) &&
-    --retries)
+static void waitForServices (edgex_device_service *svc, edgex_error *err)
+{
+  waitForService (svc, edgex_data_client_ping, "core-data", err);
+  if (err->code == 0)
   {
-    nanosleep (&delay, NULL);
+    waitForService (svc, edgex_metadata_client_ping, "core-metadata", err);
   }
-  if (retries == 0)
-  {
-    iot_log_error (svc->logger, "core-metadata service not running");
-    *err = EDGEX_REMOTE_SERVER_DOWN;
-    return;
-  }
-
-  *err = EDGEX_OK;
+}
 
-  /* Register device service in metadata */
+/* Register device service in metadata */
 
+static void registerService (edgex_device_service *svc, edgex_error *err)
+{
   edgex_deviceservice *ds;
   ds = edgex_metadata_client_get_deviceservice
     (svc->logger, &svc->config.endpoints, svc->name, err);
@@ -304,27 +438,534 @@ static void startConfigured
     }
   }
   edgex_deviceservice_free (ds);
+}
 
-  /* Load DeviceProfiles from files and register in metadata */
+static void freeScheduleEvents (edgex_scheduleevent *events)
+{
+  while (events)
+  {
+    edgex_scheduleevent *next = events->next;
+    edgex_scheduleevent_free (events);
+    events = next;
+  }
+}
 
-  edgex_device_profiles_upload (svc, err);
-  if (err->code)
+/*
+ * Start the ScheduleEvents for this service. The interval of each Schedule
+ * is retrieved from metadata once, and recorded in intervals.
+ */
+
+typedef edgex_map(uint64_t) schedule_intervals;
+
+static void startScheduleEvents
+(
+  edgex_device_service *svc,
+  const edgex_scheduleevent *events,
+  schedule_intervals *intervals,
+  edgex_error *err
+)
+{
+  uint64_t interval;
+  edgex_device_service_job *job;
+
+  for (; events; events = events->next)
   {
+    uint64_t *found = edgex_map_get (intervals, events->schedule);
+    if (found)
+    {
+      interval = *found;
+    }
+    else
+    {
+      edgex_schedule *schedule = edgex_metadata_client_get_schedule
+      (
+        svc->logger,
+        &svc->config.endpoints,
+        events->schedule,
+        err
+      );
+      if (err->code)
+      {
+        iot_log_error
+        (
+          svc->logger,
+          "Unable to obtain Schedule %s from metadata",
+          events->schedule
+        );
+        return;
+      }
+      const char *estr =
+        edgex_device_config_parse8601 (schedule->frequency, &interval);
+      edgex_schedule_free (schedule);
+      if (estr)
+      {
+        iot_log_error (svc->logger, "Unable to parse frequency for schedule %s, %s", events->schedule, estr);
+        *err = EDGEX_BAD_CONFIG;
+        return;
+      }
+      edgex_map_set (intervals, events->schedule, interval);
+    }
+
+    if (strcmp (events->addressable->path, EDGEX_DEV_API_DISCOVERY) == 0)
+    {
+      edgex_timerwheel_add
+      (
+        svc->timers, events->name, interval,
+        EDGEX_EXEC_DISCOVERY, edgex_device_handler_do_discovery, svc
+      );
+    }
+    else if (strncmp (events->addressable->path, EDGEX_DEV_API_DEVICE,
+                      strlen (EDGEX_DEV_API_DEVICE)) == 0)
+    {
+      job = malloc (sizeof (edgex_device_service_job));
+      job->svc = svc;
+      job->name = strdup (events->name);
+      job->url = strdup (events->addressable->path);
+      job->path = strdup (events->addressable->path);
+      job->interval = interval;
+      job->every = 1;
+      job->bound = false;
+      job->merge = false;
+      job->group = NULL;
+      job->next = svc->sjobs;
+      svc->sjobs = job;
+      if
+      (
+        edgex_rest_server_find (svc->daemon, job->path, &job->params) !=
+        edgex_device_handler_device
+      )
+      {
+        iot_log_error
+        (
+          svc->logger, "Scheduled Event %s: invalid device command",
+          events->name
+        );
+        *err = EDGEX_BAD_CONFIG;
+        return;
+      }
+      /* Commands on a single device are resolved in advance */
+
+      const char *id = edgex_http_param (&job->params, "id");
+      const char *name = edgex_http_param (&job->params, "name");
+      job->bound = (id || name);
+      if (job->bound)
+      {
+        edgex_device_binding_init
+        (
+          &job->binding, id ? id : name, id == NULL,
+          edgex_http_param (&job->params, "command")
+        );
+      }
+      job->merge = svc->config.device.mergeschedules && job->bound;
+      if (!job->merge)
+      {
+        edgex_timerwheel_add
+          (svc->timers, job->name, interval, EDGEX_EXEC_COMMAND, dev_invoker, job);
+      }
+    }
+    else
+    {
+      iot_log_error (svc->logger, "Scheduled Event %s is invalid, only discovery and device commands are allowed", events->name);
+      *err = EDGEX_BAD_CONFIG;
+      return;
+    }
+  }
+
+  scheduleMerged (svc);
+
+  /* Start scheduled events */
+
+  edgex_timerwheel_start (svc->timers);
+}
+
+/*
+ * Schedules and ScheduleEvents are created in metadata concurrently, as a
+ * service may have a great many ScheduleEvents.
+ */
+
+typedef struct schedule_batch
+{
+  edgex_device_service *svc;
+  const char **names;
+  edgex_error *errs;
+} schedule_batch;
+
+static void schedule_create_run (void *arg, unsigned i)
+{
+  schedule_batch *b = (schedule_batch *) arg;
+  edgex_device_service *svc = b->svc;
+  const char *key = b->names[i];
+  edgex_error *err = &b->errs[i];
+
+  *err = EDGEX_OK;
+  edgex_schedule_free (edgex_metadata_client_create_schedule
+  (
+    svc->logger,
+    &svc->config.endpoints,
+    key,
+    0,
+    *edgex_map_get (&svc->config.schedules, key),
+    "",
+    "",
+    false,
+    err
+  ));
+  if (err->code == 0)
+  {
+    iot_log_info (svc->logger, "Created schedule %s", key);
+  }
+  else if (err->code == EDGEX_HTTP_CONFLICT.code)
+  {
+    iot_log_info (svc->logger, "Skipping already existing schedule %s", key);
+    *err = EDGEX_OK;
+  }
+  else
+  {
+    iot_log_error (svc->logger, "Unable to create schedule %s", key);
+  }
+}
+
+static void scheduleevent_create_run (void *arg, unsigned i)
+{
+  schedule_batch *b = (schedule_batch *) arg;
+  edgex_device_service *svc = b->svc;
+  const char *key = b->names[i];
+  edgex_error *err = &b->errs[i];
+  edgex_device_scheduleeventinfo *schedevt =
+    edgex_map_get (&svc->config.scheduleevents, key);
+
+  *err = EDGEX_OK;
+  edgex_addressable add;
+  char *addr_name = malloc (strlen (key) + strlen (ADDR_EXT) + 1);
+  strcpy (addr_name, key);
+  strcat (addr_name, ADDR_EXT);
+  memset (&add, 0, sizeof (edgex_addressable));
+  add.name = addr_name;
+  add.address = svc->config.service.host;
+  add.method = "GET";
+  add.path = schedevt->path;
+  add.port = svc->config.service.port;
+  add.protocol = "HTTP";
+  free
+    (edgex_metadata_client_create_addressable
+      (svc->logger, &svc->config.endpoints, &add, err));
+  if (err->code == 0)
+  {
+    iot_log_info (svc->logger, "Created addressable %s", addr_name);
+  }
+  else if (err->code == EDGEX_HTTP_CONFLICT.code)
+  {
+    iot_log_info
+      (svc->logger, "Skipping already existing addressable %s", addr_name);
+  }
+  else
+  {
+    iot_log_error (svc->logger, "Unable to create addressable %s", addr_name);
+    free (addr_name);
     return;
   }
 
-  /* Obtain Devices from metadata */
+  *err = EDGEX_OK;
+  edgex_scheduleevent_free (edgex_metadata_client_create_scheduleevent
+  (
+    svc->logger,
+    &svc->config.endpoints,
+    key,
+    0,
+    schedevt->schedule,
+    addr_name,
+    "",
+    svc->name,
+    err
+  ));
+  free (addr_name);
+  if (err->code == 0)
+  {
+    iot_log_info (svc->logger, "Created ScheduleEvent %s", key);
+  }
+  else if (err->code == EDGEX_HTTP_CONFLICT.code)
+  {
+    iot_log_info
+      (svc->logger, "Skipping already existing ScheduleEvent %s", key);
+    *err = EDGEX_OK;
+  }
+  else
+  {
+    iot_log_error (svc->logger, "Unable to create ScheduleEvent %s", key);
+  }
+}
+
+/* Run a batch of creations, returning the first error if any failed */
+
+static void schedule_batch_run
+(
+  schedule_batch *b,
+  unsigned n,
+  edgex_exec_forfn fn,
+  edgex_error *err
+)
+{
+  edgex_executor_forall
+    (b->svc->executor, EDGEX_EXEC_COMMAND, n, SCHEDULE_TASKS, fn, b);
+  *err = EDGEX_OK;
+  for (unsigned i = 0; i < n && err->code == 0; i++)
+  {
+    *err = b->errs[i];
+  }
+}
+
+/*
+ * Upload Schedules and ScheduleEvents, then start those for this service.
+ * The ScheduleEvents already in metadata are retrieved first, so that only
+ * those missing from it are created.
+ */
+
+static void startSchedules (edgex_device_service *svc, edgex_error *err)
+{
+  const char *key;
+  edgex_map_iter i;
+  edgex_map_int existing;
+  schedule_intervals intervals;
+  schedule_batch b;
+  unsigned n = 0;
 
-  edgex_device_free (edgex_device_devices (svc, err));
+  *err = EDGEX_OK;
+  edgex_scheduleevent *events = edgex_metadata_client_get_scheduleevents
+    (svc->logger, &svc->config.endpoints, svc->name, err);
   if (err->code)
   {
+    iot_log_error
+      (svc->logger, "Unable to obtain ScheduleEvents from metadata");
     return;
   }
 
-  /* Start REST server */
+  unsigned max = edgex_map_count (&svc->config.schedules);
+  if (edgex_map_count (&svc->config.scheduleevents) > max)
+  {
+    max = edgex_map_count (&svc->config.scheduleevents);
+  }
+  b.svc = svc;
+  b.names = calloc (max ? max : 1, sizeof (char *));
+  b.errs = calloc (max ? max : 1, sizeof (edgex_error));
+  edgex_map_init (&existing);
+  edgex_map_init (&intervals);
+
+  i = edgex_map_iter (svc->config.schedules);
+  while ((key = edgex_map_next (&svc->config.schedules, &i)))
+  {
+    b.names[n++] = key;
+  }
+  schedule_batch_run (&b, n, schedule_create_run, err);
+  if (err->code)
+  {
+    goto done;
+  }
+
+  for (edgex_scheduleevent *e = events; e; e = e->next)
+  {
+    edgex_map_set (&existing, e->name, 1);
+  }
+  n = 0;
+  i = edgex_map_iter (svc->config.scheduleevents);
+  while ((key = edgex_map_next (&svc->config.scheduleevents, &i)))
+  {
+    edgex_device_scheduleeventinfo *schedevt =
+      edgex_map_get (&svc->config.scheduleevents, key);
+    if
+    (
+      strcmp (schedevt->path, EDGEX_DEV_API_DISCOVERY) &&
+      strncmp (schedevt->path, EDGEX_DEV_API_DEVICE,
+        strlen (EDGEX_DEV_API_DEVICE))
+    )
+    {
+      iot_log_error
+        (svc->logger, "Scheduled Event %s not valid, only discovery and device commands are allowed", key);
+      *err = EDGEX_BAD_CONFIG;
+      goto done;
+    }
+    if (edgex_map_get (&existing, key))
+    {
+      iot_log_info
+        (svc->logger, "Skipping already existing ScheduleEvent %s", key);
+    }
+    else
+    {
+      b.names[n++] = key;
+    }
+  }
+  schedule_batch_run (&b, n, scheduleevent_create_run, err);
+  if (err->code)
+  {
+    goto done;
+  }
+
+  /* Retrieve schedule events, if any have been added */
+
+  if (n)
+  {
+    freeScheduleEvents (events);
+    events = edgex_metadata_client_get_scheduleevents
+      (svc->logger, &svc->config.endpoints, svc->name, err);
+    if (err->code)
+    {
+      iot_log_error
+        (svc->logger, "Unable to obtain ScheduleEvents from metadata");
+      goto done;
+    }
+  }
+
+  startScheduleEvents (svc, events, &intervals, err);
+
+done:
+  edgex_map_deinit (&intervals);
+  edgex_map_deinit (&existing);
+  freeScheduleEvents (events);
+  free (b.errs);
+  free (b.names);
+}
+
+
+/*
+ * Contact metadata for a service which was started from a snapshot. The
+ * steps which a normal start performs before it handles requests are carried
+ * out here, and the snapshot is brought up to date.
+ */
+
+typedef struct startupSync
+{
+  edgex_device_service *svc;
+  toml_table_t *config;
+} startupSync;
+
+static void syncTask (void *arg)
+{
+  startupSync *sync = (startupSync *) arg;
+  edgex_device_service *svc = sync->svc;
+  edgex_error err = EDGEX_OK;
+
+  waitForServices (svc, &err);
+  if (err.code == 0)
+  {
+    registerService (svc, &err);
+  }
+  if (err.code == 0)
+  {
+    edgex_device_profiles_upload (svc, &err);
+  }
+  if (err.code == 0 && svc->config.device.watchprofiles)
+  {
+    svc->profwatch = edgex_profwatch_start (svc);
+  }
+  if (err.code == 0)
+  {
+    edgex_snapshot_reconcile (svc, &err);
+  }
+  if (err.code == 0 && sync->config)
+  {
+    edgex_device_process_configured_devices
+      (svc, toml_array_in (sync->config, "DeviceList"), &err);
+  }
+  if (err.code == 0 && !__atomic_load_n (&svc->stopping, __ATOMIC_RELAXED))
+  {
+    startSchedules (svc, &err);
+  }
+  if (err.code)
+  {
+    iot_log_error
+    (
+      svc->logger,
+      "Unable to synchronize with metadata (%s), continuing from snapshot",
+      err.reason
+    );
+  }
+  else
+  {
+    iot_log_info (svc->logger, "Synchronized with metadata");
+    edgex_snapshot_save (svc, svc->config.device.snapshotfile);
+  }
+  toml_free (sync->config);
+  free (sync);
+}
+
+/*
+ * Startup steps. Those contacting metadata are not needed when starting from
+ * a snapshot, as syncTask performs them later.
+ */
+
+typedef enum
+{
+  STEP_DATA,
+  STEP_METADATA,
+  STEP_REGISTER,
+  STEP_PROFILES,
+  STEP_DEVICES,
+  STEP_SERVER,
+  STEP_CONFIGURED,
+  STEP_EVENTS,
+  STEP_DRIVER,
+  STEP_SCHEDULES,
+  STEP_COUNT
+} startupStepId;
+
+typedef struct startupState
+{
+  edgex_device_service *svc;
+  toml_table_t *config;
+} startupState;
+
+static void stepData (void *arg, edgex_error *err)
+{
+  startupState *st = (startupState *) arg;
+  waitForService (st->svc, edgex_data_client_ping, "core-data", err);
+}
+
+static void stepMetadata (void *arg, edgex_error *err)
+{
+  startupState *st = (startupState *) arg;
+  waitForService (st->svc, edgex_metadata_client_ping, "core-metadata", err);
+}
+
+static void stepRegister (void *arg, edgex_error *err)
+{
+  registerService (((startupState *) arg)->svc, err);
+}
+
+/* Load DeviceProfiles from files and register in metadata */
+
+static void stepProfiles (void *arg, edgex_error *err)
+{
+  edgex_device_service *svc = ((startupState *) arg)->svc;
+  edgex_device_profiles_upload (svc, err);
+  if (err->code == 0 && svc->config.device.watchprofiles)
+  {
+    svc->profwatch = edgex_profwatch_start (svc);
+  }
+}
+
+/* Obtain Devices from metadata */
+
+static void stepDevices (void *arg, edgex_error *err)
+{
+  edgex_device_free (edgex_device_devices (((startupState *) arg)->svc, err));
+}
 
+/* Start REST server */
+
+static void stepServer (void *arg, edgex_error *err)
+{
+  edgex_device_service *svc = ((startupState *) arg)->svc;
+  edgex_rest_server_options opts;
+
+  opts.threads = svc->config.service.serverthreads;
+  opts.maxconnections = svc->config.service.maxconnections;
+  opts.maxperip = svc->config.service.maxconnectionsperip;
+  opts.timeout = svc->config.service.connectiontimeout;
+  opts.backlog = svc->config.service.listenbacklog;
+  opts.maxrequestsize = svc->config.service.maxrequestsize;
+  opts.deadline = svc->config.service.requesttimeout;
+  opts.pool = svc->executor;
   svc->daemon = edgex_rest_server_create
-    (svc->logger, svc->config.service.port, err);
+    (svc->logger, svc->config.service.port, &opts, err);
   if (err->code)
   {
     return;
@@ -335,20 +976,68 @@ static void startConfigured
     svc->daemon, EDGEX_DEV_API_CALLBACK, PUT | POST | DELETE, svc,
     edgex_device_handler_callback
   );
+}
+
+/* Obtain Devices from configuration */
+
+static void stepConfigured (void *arg, edgex_error *err)
+{
+  startupState *st = (startupState *) arg;
+  edgex_device_process_configured_devices
+    (st->svc, toml_array_in (st->config, "DeviceList"), err);
+}
+
+/* Start event submission */
 
-  /* Obtain Devices from configuration */
+static void stepEvents (void *arg, edgex_error *err)
+{
+  edgex_device_service *svc = ((startupState *) arg)->svc;
 
-  if (config)
+  if (svc->config.device.sendreadingsonchanged)
   {
-    edgex_device_process_configured_devices
-      (svc, toml_array_in (config, "DeviceList"), err);
-    if (err->code)
-    {
-      return;
-    }
+    svc->lvcache = edgex_lvcache_create
+    (
+      svc->config.device.onchangedeadband,
+      svc->config.device.onchangepercent,
+      svc->config.device.onchangerefresh, edgex_device_originunit ()
+    );
+  }
+  svc->aggregator = edgex_aggregator_create (edgex_device_originunit ());
+  if (svc->config.device.historysize)
+  {
+    svc->history = edgex_history_create (svc->config.device.historysize);
+  }
+  svc->readcache = edgex_readcache_create (svc->config.readcache);
+  if (svc->config.device.putbatching)
+  {
+    svc->putbatch = edgex_putbatch_create (svc->config.device.putbatchwindow);
+  }
+  if (svc->config.device.allcommandthreads > 1)
+  {
+    svc->cmdpool = thpool_init (svc->config.device.allcommandthreads);
+  }
+  svc->config.endpoints.transport = edgex_transport_create (svc, err);
+  if (err->code)
+  {
+    return;
+  }
+  svc->forward = edgex_forward_create (svc, err);
+  if (err->code)
+  {
+    return;
   }
+  svc->postq = edgex_postqueue_create (svc);
+  if (svc->postq == NULL)
+  {
+    *err = EDGEX_POSTQUEUE_START;
+  }
+}
+
+/* Driver configuration, then handle device and discovery requests */
 
-  /* Driver configuration */
+static void stepDriver (void *arg, edgex_error *err)
+{
+  edgex_device_service *svc = ((startupState *) arg)->svc;
 
   if (!svc->userfns.init (svc->userdata, svc->logger, svc->config.driverconf))
   {
@@ -357,219 +1046,258 @@ static void startConfigured
     return;
   }
 
-  /* Handle device and discovery requests */
-
+  edgex_rest_server_register_handler_ex
+  (
+    svc->daemon, EDGEX_DEV_API_DEVICE_ID, GET | PUT | POST, svc,
+    edgex_device_handler_device, true
+  );
+  edgex_rest_server_register_handler_ex
+  (
+    svc->daemon, EDGEX_DEV_API_DEVICE_NAME, GET | PUT | POST, svc,
+    edgex_device_handler_device, true
+  );
+  edgex_rest_server_register_handler_ex
+  (
+    svc->daemon, EDGEX_DEV_API_DEVICE_ALL, GET | PUT | POST, svc,
+    edgex_device_handler_device, true
+  );
   edgex_rest_server_register_handler
   (
-    svc->daemon, EDGEX_DEV_API_DEVICE, GET | PUT | POST, svc,
-    edgex_device_handler_device
+    svc->daemon, EDGEX_DEV_API_HISTORY_ID, GET, svc,
+    edgex_device_handler_history
+  );
+  edgex_rest_server_register_handler
+  (
+    svc->daemon, EDGEX_DEV_API_HISTORY_NAME, GET, svc,
+    edgex_device_handler_history
   );
   edgex_rest_server_register_handler
   (
     svc->daemon, EDGEX_DEV_API_DISCOVERY, POST, svc,
     edgex_device_handler_discovery
   );
+}
 
-  /* Upload Schedules and ScheduleEvents */
+static void stepSchedules (void *arg, edgex_error *err)
+{
+  startSchedules (((startupState *) arg)->svc, err);
+}
 
-  const char *key;
-  edgex_map_iter i = edgex_map_iter (svc->config.schedules);
+#define AFTER EDGEX_STARTUP_AFTER
 
-  while ((key = edgex_map_next (&svc->config.schedules, &i)))
-  {
-    *err = EDGEX_OK;
-    edgex_schedule_free (edgex_metadata_client_create_schedule
-    (
-      svc->logger,
-      &svc->config.endpoints,
-      key,
-      0,
-      *edgex_map_get (&svc->config.schedules, key),
-      "",
-      "",
-      false,
-      err
-    ));
-    if (err->code == 0)
-    {
-      iot_log_info (svc->logger, "Created schedule %s", key);
-    }
-    else if (err->code == EDGEX_HTTP_CONFLICT.code)
-    {
-      iot_log_info (svc->logger, "Skipping already existing schedule %s", key);
-    }
-    else
-    {
-      iot_log_error (svc->logger, "Unable to create schedule %s", key);
-      return;
-    }
-  }
+/*
+ * Run the startup steps, each as soon as those it depends on are complete,
+ * and log the time taken by each. Configured devices are added once the
+ * callback handler is available, as metadata calls back when they are
+ * created. The driver is initialized once the devices are known and
+ * core-data is available, and the schedules are started once the driver can
+ * handle their requests.
+ */
 
-  i = edgex_map_iter (svc->config.scheduleevents);
-  while ((key = edgex_map_next (&svc->config.scheduleevents, &i)))
+static bool runStartup
+(
+  edgex_device_service *svc,
+  toml_table_t *config,
+  bool fromSnapshot,
+  edgex_error *err
+)
+{
+  startupState st = { .svc = svc, .config = config };
+  uint64_t elapsed[STEP_COUNT];
+  uint64_t started = edgex_device_monotime ();
+  bool sync = !fromSnapshot;
+
+  edgex_startup_step steps[STEP_COUNT] =
   {
-    edgex_device_scheduleeventinfo *schedevt =
-      edgex_map_get (&svc->config.scheduleevents, key);
-    if
-    (
-      strcmp (schedevt->path, EDGEX_DEV_API_DISCOVERY) &&
-      strncmp (schedevt->path, EDGEX_DEV_API_DEVICE,
-        strlen (EDGEX_DEV_API_DEVICE))
-    )
+    [STEP_DATA] =
+      { "core-data", sync ? stepData : NULL, 0 },
+    [STEP_METADATA] =
+      { "core-metadata", sync ? stepMetadata : NULL, 0 },
+    [STEP_REGISTER] =
+      { "registration", sync ? stepRegister : NULL, AFTER (STEP_METADATA) },
+    [STEP_PROFILES] =
+      { "profiles", sync ? stepProfiles : NULL, AFTER (STEP_METADATA) },
+    [STEP_DEVICES] =
+      { "devices", sync ? stepDevices : NULL, AFTER (STEP_PROFILES) },
+    [STEP_SERVER] =
+      { "REST server", stepServer, 0 },
+    [STEP_CONFIGURED] =
     {
-      iot_log_error
-        (svc->logger, "Scheduled Event %s not valid, only discovery and device commands are allowed", key);
-      *err = EDGEX_BAD_CONFIG;
-      return;
-    }
-
-    *err = EDGEX_OK;
-    edgex_addressable add;
-    char *addr_name = malloc (strlen (key) + strlen (ADDR_EXT) + 1);
-    strcpy (addr_name, key);
-    strcat (addr_name, ADDR_EXT);
-    memset (&add, 0, sizeof (edgex_addressable));
-    add.name = addr_name;
-    add.address = svc->config.service.host;
-    add.method = "GET";
-    add.path = schedevt->path;
-    add.port = svc->config.service.port;
-    add.protocol = "HTTP";
-    free
-      (edgex_metadata_client_create_addressable
-        (svc->logger, &svc->config.endpoints, &add, err));
-    if (err->code == 0)
-    {
-      iot_log_info (svc->logger, "Created addressable %s", addr_name);
-    }
-    else if (err->code == EDGEX_HTTP_CONFLICT.code)
+      "configured devices", (sync && config) ? stepConfigured : NULL,
+      AFTER (STEP_REGISTER) | AFTER (STEP_DEVICES) | AFTER (STEP_SERVER)
+    },
+    [STEP_EVENTS] =
+      { "event submission", stepEvents, 0 },
+    [STEP_DRIVER] =
     {
-      iot_log_info
-        (svc->logger, "Skipping already existing addressable %s", addr_name);
-    }
-    else
+      "driver", stepDriver,
+      AFTER (STEP_DATA) | AFTER (STEP_DEVICES) | AFTER (STEP_CONFIGURED) |
+        AFTER (STEP_SERVER) | AFTER (STEP_EVENTS)
+    },
+    [STEP_SCHEDULES] =
     {
-      iot_log_error (svc->logger, "Unable to create addressable %s", addr_name);
-      free (addr_name);
-      return;
+      "schedules", sync ? stepSchedules : NULL,
+      AFTER (STEP_REGISTER) | AFTER (STEP_DRIVER)
     }
+  };
 
-    *err = EDGEX_OK;
-    edgex_scheduleevent_free (edgex_metadata_client_create_scheduleevent 
-    (
-      svc->logger,
-      &svc->config.endpoints,
-      key,
-      0,
-      schedevt->schedule,
-      addr_name,
-      "",
-      svc->name,
-      err
-    ));
-    free (addr_name);
-    if (err->code == 0)
-    {
-      iot_log_info (svc->logger, "Created ScheduleEvent %s", key);
-    }
-    else if (err->code == EDGEX_HTTP_CONFLICT.code)
+  edgex_startup_run (svc->executor, steps, STEP_COUNT, &st, elapsed, err);
+
+  for (unsigned i = 0; i < STEP_COUNT; i++)
+  {
+    if (elapsed[i])
     {
       iot_log_info
-        (svc->logger, "Skipping already existing ScheduleEvent %s", key);
-    }
-    else
-    {
-      iot_log_error (svc->logger, "Unable to create ScheduleEvent %s", key);
-      return;
+      (
+        svc->logger, "Startup: %s took %" PRIu64 " ms",
+        steps[i].name, elapsed[i] / 1000000
+      );
     }
   }
+  if (err->code)
+  {
+    return false;
+  }
+  iot_log_info
+  (
+    svc->logger, "Startup steps completed in %" PRIu64 " ms",
+    (edgex_device_monotime () - started) / 1000000
+  );
+  return true;
+}
 
-  /* Retrieve schedule events */
-
-  int interval;
-  iot_schedule sched = NULL;
-  edgex_device_service_job *job;
-  *err = EDGEX_OK;
-  edgex_scheduleevent *events = edgex_metadata_client_get_scheduleevents
-    (svc->logger, &svc->config.endpoints, svc->name, err);
+static void startConfigured
+(
+  edgex_device_service *svc,
+  edgex_registry *registry,
+  toml_table_t **config,
+  const char *profile,
+  edgex_error *err
+)
+{
+  edgex_device_validateConfig (svc, err);
   if (err->code)
+  {
+    return;
+  }
+  if
+  (
+    svc->config.device.eventencoding &&
+    strcasecmp (svc->config.device.eventencoding, "CBOR") == 0
+  )
+  {
+    svc->eventencoding = EDGEX_EVENT_CBOR;
+  }
+  if (!edgex_device_setclock (svc->config.device.clock))
   {
     iot_log_error
-      (svc->logger, "Unable to obtain ScheduleEvents from metadata");
+      (svc->logger, "Unable to read clock %s", svc->config.device.clock);
+    *err = EDGEX_BAD_CONFIG;
     return;
   }
+  edgex_device_setoriginnanos (svc->config.device.originnanos);
 
-  while (events)
+  if (svc->config.logging.file)
   {
-    sched = NULL;
-    edgex_schedule *schedule = edgex_metadata_client_get_schedule
+    iot_log_addlogger
+      (svc->logger, iot_log_tofile, svc->config.logging.file);
+  }
+  if (svc->config.logging.remoteurl)
+  {
+    svc->logq = edgex_log_rest_start
     (
-      svc->logger,
-      &svc->config.endpoints,
-      events->schedule,
-      err
+      svc->config.logging.remoteurl, svc->config.logging.queuesize,
+      svc->config.logging.maxbatch, svc->config.logging.ratelimit
     );
+    iot_log_addlogger
+      (svc->logger, edgex_log_torest, svc->config.logging.remoteurl);
+  }
+
+  if (profile)
+  {
+    iot_log_info (svc->logger, "Uploading configuration to registry.");
+    edgex_nvpairs *c = edgex_device_getConfig (svc);
+    edgex_registry_put_config (registry, svc->name, profile, c, err);
+    edgex_nvpairs_free (c);
     if (err->code)
     {
-      iot_log_error
-      (
-        svc->logger,
-        "Unable to obtain Schedule %s from metadata",
-        events->schedule
-      );
-      return;
-    }
-    const char *estr =
-      edgex_device_config_parse8601 (schedule->frequency, &interval);
-    edgex_schedule_free (schedule);
-    if (estr)
-    {
-      iot_log_error (svc->logger, "Unable to parse frequency for schedule %s, %s", events->schedule, estr);
-      *err = EDGEX_BAD_CONFIG;
+      iot_log_error (svc->logger, "Unable to upload config: %s", err->reason);
       return;
     }
+  }
 
-    if (strcmp (events->addressable->path, EDGEX_DEV_API_DISCOVERY) == 0)
-    {
-      sched = iot_schedule_create
-      (
-        svc->scheduler,
-        edgex_device_handler_do_discovery,
-        svc,
-        IOT_SEC_TO_NS (interval),
-        0,
-        0
-      );
-    }
-    else if (strncmp (events->addressable->path, EDGEX_DEV_API_DEVICE,
-                      strlen (EDGEX_DEV_API_DEVICE)) == 0)
-    {
-      job = malloc (sizeof (edgex_device_service_job));
-      job->svc = svc;
-      job->url =
-        strdup (events->addressable->path + strlen (EDGEX_DEV_API_DEVICE));
-      job->next = svc->sjobs;
-      svc->sjobs = job;
-      sched = iot_schedule_create
-        (svc->scheduler, dev_invoker, job, IOT_SEC_TO_NS (interval), 0, 0);
-    }
-    else
-    {
-      iot_log_error (svc->logger, "Scheduled Event %s is invalid, only discovery and device commands are allowed", key);
-      *err = EDGEX_BAD_CONFIG;
-      return;
-    }
+  iot_log_debug
+  (
+    svc->logger,
+    "Starting %s device service, version %s",
+    svc->name, svc->version
+  );
+  iot_log_debug
+    (svc->logger, "EdgeX device SDK for C, version " CSDK_VERSION_STR);
+  edgex_device_dumpConfig (svc);
 
-    iot_schedule_add (svc->scheduler, sched);
+  edgex_endpoint_init (&svc->config.endpoints.data, registry, svc->logger);
+  edgex_endpoint_init (&svc->config.endpoints.metadata, registry, svc->logger);
+  edgex_endpoint_breaker
+  (
+    &svc->config.endpoints.data, svc->config.service.circuitthreshold,
+    svc->config.service.timeout, svc->config.service.backofflimit
+  );
+  edgex_endpoint_breaker
+  (
+    &svc->config.endpoints.metadata, svc->config.service.circuitthreshold,
+    svc->config.service.timeout, svc->config.service.backofflimit
+  );
 
-    edgex_scheduleevent *tmp = events->next;
-    edgex_scheduleevent_free (events);
-    events = tmp;
-  }
+  svc->adminstate = UNLOCKED;
+  svc->opstate = ENABLED;
 
-  /* Start scheduled events */
+  /*
+   * Start the executor. Given a snapshot of the devices and profiles, the
+   * service handles requests at once and contacts metadata in the
+   * background; otherwise it does so first.
+   */
+
+  svc->executor = createExecutor (svc);
+  edgex_http_set_timeout (svc->config.service.requesttimeout);
+  edgex_http_set_http2 (svc->config.service.http2);
+  const char *comp = svc->config.device.eventcompression;
+  if (comp && strcasecmp (comp, "Gzip") == 0)
+  {
+    uint32_t min = svc->config.device.eventcompressionmin;
+    svc->config.endpoints.data.compressmin = min ? min : DEFAULT_COMPRESS_MIN;
+  }
+  if (svc->config.device.serializecommands)
+  {
+    svc->serial = edgex_serial_create (svc->executor);
+  }
+  svc->timers = edgex_timerwheel_create (svc->executor);
+  if (svc->config.service.requesttimeout)
+  {
+    edgex_timerwheel_add
+    (
+      svc->timers, "RequestDeadlines", EDGEX_DEVICE_EXPIRE_PERIOD,
+      EDGEX_EXEC_COMMAND, edgex_device_async_expire, svc
+    );
+  }
+  svc->discovery = edgex_discovery_create (svc);
+  svc->updates = edgex_device_updates_create (svc);
+  uint32_t statusms = svc->config.device.statusinterval;
+  svc->devstatus = edgex_devstatus_create (svc);
+  edgex_timerwheel_add
+  (
+    svc->timers, "StatusUpdates",
+    (statusms ? statusms : EDGEX_DEVSTATUS_INTERVAL) * 1000000ULL,
+    EDGEX_EXEC_COMMAND, edgex_devstatus_flush, svc->devstatus
+  );
+  bool fromSnapshot =
+    svc->config.device.snapshotfile && *svc->config.device.snapshotfile &&
+    edgex_snapshot_load (svc, svc->config.device.snapshotfile);
 
-  iot_scheduler_start (svc->scheduler);
+  if (!runStartup (svc, *config, fromSnapshot, err))
+  {
+    return;
+  }
 
   /* Ready. Enable SMA handlers and log that we have started */
 
@@ -585,6 +1313,12 @@ static void startConfigured
   (
     svc->daemon, EDGEX_DEV_API_PING, GET, svc, ping_handler
   );
+#if CSDK_BUILD_TRACE
+  edgex_rest_server_register_handler
+  (
+    svc->daemon, EDGEX_DEV_API_TRACE, GET, svc, edgex_device_handler_trace
+  );
+#endif
 
   if (registry && svc->config.service.checkinterval)
   {
@@ -604,6 +1338,19 @@ static void startConfigured
     }
   }
 
+  if (fromSnapshot)
+  {
+    startupSync *sync = malloc (sizeof (startupSync));
+    sync->svc = svc;
+    sync->config = *config;
+    *config = NULL;
+    edgex_executor_submit (svc->executor, EDGEX_EXEC_DISCOVERY, syncTask, sync);
+  }
+  else if (svc->config.device.snapshotfile && *svc->config.device.snapshotfile)
+  {
+    edgex_snapshot_save (svc, svc->config.device.snapshotfile);
+  }
+
   if (svc->config.service.startupmsg)
   {
     iot_log_debug (svc->logger, svc->config.service.startupmsg);
@@ -682,14 +1429,13 @@ void edgex_device_service_start
 
   if (uploadConfig || (registry == NULL))
   {
-    config = edgex_device_loadConfig (svc->logger, confDir, profile, err);
+    config = edgex_device_loadConfig (svc, confDir, profile, err);
     if (err->code)
     {
+      toml_free (config);
       edgex_registry_free (registry);
       return;
     }
-
-    edgex_device_populateConfig (svc, config, err);
   }
 
   if (svc->config.device.profilesdir == NULL)
@@ -697,26 +1443,36 @@ void edgex_device_service_start
     svc->config.device.profilesdir = strdup (confDir);
   }
 
-  startConfigured (svc, registry, config, uploadConfig ? profile : NULL, err);
+  startConfigured (svc, registry, &config, uploadConfig ? profile : NULL, err);
+
+  if (err->code == 0)
+  {
+    /* The registry is kept for endpoint resolution and the config watch */
 
-  edgex_registry_free (registry);
+    svc->registry = registry;
+    if (registry)
+    {
+      svc->confwatch = edgex_confwatch_start (svc, registry, profile);
+    }
+  }
+  else
+  {
+    edgex_endpoint_fini (&svc->config.endpoints.data);
+    edgex_endpoint_fini (&svc->config.endpoints.metadata);
+    edgex_registry_free (registry);
+  }
   toml_free (config);
 }
 
-static void doPost (void *p)
+void edgex_device_service_set_async_handlers
+(
+  edgex_device_service *svc,
+  edgex_device_handle_get_async gethandler,
+  edgex_device_handle_put_async puthandler
+)
 {
-  postparams *pp = (postparams *) p;
-  edgex_error err = EDGEX_OK;
-  edgex_data_client_add_event
-  (
-    pp->svc->logger,
-    &pp->svc->config.endpoints,
-    pp->jevent,
-    &err
-  );
-
-  json_value_free (pp->jevent);
-  free (pp);
+  svc->asyncget = gethandler;
+  svc->asyncput = puthandler;
 }
 
 void edgex_device_post_readings
@@ -728,15 +1484,16 @@ void edgex_device_post_readings
   const edgex_device_commandresult *values
 )
 {
-  JSON_Value *jevent = edgex_data_generate_event
-    (device_name, nreadings, sources, values, svc->config.device.datatransform);
+  edgex_event_cooked *event = edgex_data_process_event
+  (
+    device_name, nreadings, sources, values,
+    svc->config.device.datatransform, svc->lvcache, svc->aggregator,
+    svc->history, svc->eventencoding
+  );
 
-  if (jevent)
+  if (event)
   {
-    postparams *pp = malloc (sizeof (postparams));
-    pp->svc = svc;
-    pp->jevent = jevent;
-    thpool_add_work (svc->thpool, doPost, pp);
+    edgex_postqueue_submit (svc->postq, event);
   }
 }
 
@@ -745,38 +1502,73 @@ void edgex_device_service_stop
 {
   *err = EDGEX_OK;
   iot_log_debug (svc->logger, "Stop device service");
-  if (svc->scheduler)
+  __atomic_store_n (&svc->stopping, true, __ATOMIC_RELAXED);
+  edgex_confwatch_stop (svc->confwatch);
+  edgex_profwatch_stop (svc->profwatch);
+  if (svc->timers)
   {
-    iot_scheduler_stop (svc->scheduler);
-    iot_scheduler_fini (svc->scheduler);
+    edgex_timerwheel_stop (svc->timers);
   }
   if (svc->daemon)
   {
     edgex_rest_server_destroy (svc->daemon);
   }
+  edgex_executor_free (svc->executor);
+  edgex_timerwheel_free (svc->timers);
+  edgex_discovery_free (svc->discovery);
+  edgex_device_updates_free (svc->updates);
+  if (svc->config.device.snapshotfile && *svc->config.device.snapshotfile)
+  {
+    edgex_snapshot_save (svc, svc->config.device.snapshotfile);
+  }
   svc->userfns.stop (svc->userdata, force);
-  thpool_destroy (svc->thpool);
+  edgex_device_async_drain (svc);
+  edgex_devstatus_free (svc->devstatus);
+  svc->devstatus = NULL;
+  edgex_postqueue_free (svc->postq);
+  edgex_forward_free (svc->forward);
+  edgex_transport_free (svc->config.endpoints.transport);
+  svc->config.endpoints.transport = NULL;
+  edgex_lvcache_free (svc->lvcache);
+  edgex_aggregator_free (svc->aggregator);
+  edgex_history_free (svc->history);
+  edgex_readcache_free (svc->readcache);
+  edgex_putbatch_free (svc->putbatch);
+  edgex_serial_free (svc->serial);
+  if (svc->cmdpool)
+  {
+    thpool_destroy (svc->cmdpool);
+  }
   iot_log_debug (svc->logger, "Stopped device service");
+  while (svc->sgroups)
+  {
+    edgex_device_service_jobgroup *g = svc->sgroups->next;
+    free (svc->sgroups->jobs);
+    free (svc->sgroups);
+    svc->sgroups = g;
+  }
   edgex_device_service_job *j;
   while (svc->sjobs)
   {
     j = svc->sjobs->next;
+    free (svc->sjobs->name);
     free (svc->sjobs->url);
+    free (svc->sjobs->path);
     free (svc->sjobs);
     svc->sjobs = j;
   }
+  if (svc->logq)
+  {
+    edgex_log_rest_stop (svc->logq);
+  }
+  edgex_endpoint_fini (&svc->config.endpoints.data);
+  edgex_endpoint_fini (&svc->config.endpoints.metadata);
+  edgex_registry_free (svc->registry);
   edgex_device_freeConfig (svc);
   iot_logging_client_destroy (svc->logger);
-  edgex_map_deinit (&svc->name_to_id);
-  edgex_map_iter i = edgex_map_iter (svc->devices);
+  edgex_devreg_free (svc->devices);
   const char *key;
-  while ((key = edgex_map_next (&svc->devices, &i)))
-  {
-    edgex_device **e = edgex_map_get (&svc->devices, key);
-    edgex_device_free (*e);
-  }
-  edgex_map_deinit (&svc->devices);
-  i = edgex_map_iter (svc->profiles);
+  edgex_map_iter i = edgex_map_iter (svc->profiles);
   while ((key = edgex_map_next (&svc->profiles, &i)))
   {
     edgex_deviceprofile **p = edgex_map_get (&svc->profiles, key);
@@ -784,5 +1576,6 @@ void edgex_device_service_stop
   }
   edgex_map_deinit (&svc->profiles);
   edgex_registry_fini ();
+  edgex_http_fini ();
   free (svc);
 }
@@ -14,13 +14,29 @@
 #include "config.h"
 #include "map.h"
 #include "rest_server.h"
+#include "postqueue.h"
+#include "lvcache.h"
+#include "aggregate.h"
+#include "history.h"
+#include "devstatus.h"
+#include "readcache.h"
+#include "putbatch.h"
+#include "serial.h"
+#include "forward.h"
+#include "devmap.h"
 #include "thpool.h"
-#include "iot/scheduler.h"
+#include "executor.h"
+#include "timerwheel.h"
+#include "logqueue.h"
+#include "discovery.h"
+#include "callback.h"
+#include "confwatch.h"
+#include "profwatch.h"
 
-typedef edgex_map(edgex_device *) edgex_map_device;
 typedef edgex_map(edgex_deviceprofile *) edgex_map_profile;
 
 struct edgex_device_service_job;
+struct edgex_device_service_jobgroup;
 
 struct edgex_device_service
 {
@@ -28,23 +44,47 @@ struct edgex_device_service
   const char *version;
   void *userdata;
   edgex_device_callbacks userfns;
+  edgex_device_handle_get_async asyncget;
+  edgex_device_handle_put_async asyncput;
   iot_logging_client *logger;
   edgex_device_config config;
+  edgex_device_configreply configreply;
   edgex_rest_server *daemon;
   edgex_device_operatingstate opstate;
   edgex_device_adminstate adminstate;
 
-  edgex_map_device devices;
-  edgex_map_string name_to_id;
-  pthread_rwlock_t deviceslock;
+  edgex_devreg *devices;
 
   edgex_map_profile profiles;
   pthread_mutex_t profileslock;
 
-  threadpool thpool;
-  iot_scheduler scheduler;
+  edgex_executor *executor;
+  threadpool cmdpool;
+  edgex_postqueue *postq;
+  edgex_forward *forward;
+  edgex_logqueue *logq;
+  edgex_event_encoding eventencoding;
+  edgex_lvcache *lvcache;
+  edgex_aggregator *aggregator;
+  edgex_history *history;
+  edgex_readcache *readcache;
+  edgex_putbatch *putbatch;
+  edgex_serial *serial;
+  pthread_mutex_t asynclock;
+  pthread_cond_t asynccond;
+  edgex_device_async_request *asyncpending;
+  unsigned asyncexpired;
+  edgex_timerwheel *timers;
   struct edgex_device_service_job *sjobs;
+  struct edgex_device_service_jobgroup *sgroups;
   pthread_mutex_t discolock;
+  edgex_discovery *discovery;
+  edgex_device_updates *updates;
+  edgex_devstatus *devstatus;
+  edgex_registry *registry;
+  edgex_confwatch *confwatch;
+  edgex_profwatch *profwatch;
+  bool stopping;
 };
 
 #endif
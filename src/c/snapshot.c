@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "snapshot.h"
+#include "profiles.h"
+#include "metadata.h"
+#include "edgex_rest.h"
+#include "errorlist.h"
+#include "strbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAPSHOT_VERSION 1
+
+bool edgex_snapshot_load (edgex_device_service *svc, const char *file)
+{
+  struct stat st;
+  const char *data;
+  JSON_Value *val;
+  JSON_Object *obj;
+  unsigned nprofiles = 0;
+  edgex_deviceprofile **profiles;
+  edgex_device *devices;
+  unsigned ndevices = 0;
+  int fd;
+
+  fd = open (file, O_RDONLY);
+  if (fd == -1)
+  {
+    if (errno != ENOENT)
+    {
+      iot_log_error
+        (svc->logger, "Unable to open snapshot %s: %s", file, strerror (errno));
+    }
+    return false;
+  }
+  if (fstat (fd, &st) != 0 || st.st_size == 0)
+  {
+    close (fd);
+    return false;
+  }
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+  {
+    iot_log_error
+      (svc->logger, "Unable to map snapshot %s: %s", file, strerror (errno));
+    return false;
+  }
+  val = (data[st.st_size - 1] == '\0') ? json_parse_string (data) : NULL;
+  munmap ((void *) data, st.st_size);
+
+  obj = json_value_get_object (val);
+  if
+  (
+    obj == NULL ||
+    json_object_get_number (obj, "version") != SNAPSHOT_VERSION
+  )
+  {
+    iot_log_warning (svc->logger, "Ignoring invalid snapshot %s", file);
+    json_value_free (val);
+    return false;
+  }
+
+  profiles = edgex_deviceprofiles_read_value
+    (svc->logger, json_object_get_value (obj, "profiles"), &nprofiles);
+  pthread_mutex_lock (&svc->profileslock);
+  for (unsigned i = 0; i < nprofiles; i++)
+  {
+    if (edgex_map_get (&svc->profiles, profiles[i]->name))
+    {
+      edgex_deviceprofile_free (profiles[i]);
+    }
+    else
+    {
+      edgex_map_set (&svc->profiles, profiles[i]->name, profiles[i]);
+    }
+  }
+  pthread_mutex_unlock (&svc->profileslock);
+  free (profiles);
+
+  devices = edgex_devices_read_value
+    (svc->logger, json_object_get_value (obj, "devices"));
+  json_value_free (val);
+  for (edgex_device *d = devices; d; d = d->next)
+  {
+    d->profile = edgex_deviceprofile_intern (svc, d->profile);
+  }
+
+  edgex_devmap *update = edgex_devreg_begin (svc->devices);
+  while (devices)
+  {
+    edgex_device *next = devices->next;
+    devices->next = NULL;
+    if (edgex_devmap_findbyname (update, devices->name))
+    {
+      edgex_device_free (devices);
+    }
+    else
+    {
+      edgex_devmap_add (update, devices);
+      ndevices++;
+    }
+    devices = next;
+  }
+  edgex_devreg_commit (svc->devices, update);
+
+  iot_log_info
+  (
+    svc->logger, "Loaded %u devices and %u profiles from snapshot %s",
+    ndevices, nprofiles, file
+  );
+  return true;
+}
+
+void edgex_snapshot_save (edgex_device_service *svc, const char *file)
+{
+  edgex_strbuf buf;
+  edgex_map_iter iter;
+  const char *key;
+  bool first = true;
+  char *json;
+  char *tmpname;
+  FILE *f;
+
+  edgex_strbuf_init (&buf);
+  edgex_strbuf_appendstr (&buf, "{\"version\":");
+  edgex_strbuf_appenduint (&buf, SNAPSHOT_VERSION);
+
+  edgex_strbuf_appendstr (&buf, ",\"profiles\":[");
+  pthread_mutex_lock (&svc->profileslock);
+  iter = edgex_map_iter (svc->profiles);
+  while ((key = edgex_map_next (&svc->profiles, &iter)))
+  {
+    json = edgex_deviceprofile_write
+      (*edgex_map_get (&svc->profiles, key), false);
+    if (!first)
+    {
+      edgex_strbuf_appendchar (&buf, ',');
+    }
+    edgex_strbuf_appendstr (&buf, json);
+    json_free_serialized_string (json);
+    first = false;
+  }
+  pthread_mutex_unlock (&svc->profileslock);
+
+  edgex_strbuf_appendstr (&buf, "],\"devices\":[");
+  first = true;
+  const edgex_devmap *devices = edgex_devreg_acquire (svc->devices);
+  iter = edgex_map_iter (devices->devices);
+  edgex_device *dev;
+  while ((dev = edgex_devmap_next (devices, &iter)))
+  {
+    json = edgex_device_write (dev, false);
+    if (!first)
+    {
+      edgex_strbuf_appendchar (&buf, ',');
+    }
+    edgex_strbuf_appendstr (&buf, json);
+    json_free_serialized_string (json);
+    first = false;
+  }
+  edgex_devreg_release (svc->devices);
+  edgex_strbuf_appendstr (&buf, "]}");
+
+  tmpname = malloc (strlen (file) + 5);
+  strcpy (tmpname, file);
+  strcat (tmpname, ".tmp");
+  f = fopen (tmpname, "w");
+  if
+  (
+    f == NULL ||
+    fwrite (buf.data, 1, buf.len + 1, f) != buf.len + 1 ||
+    fclose (f) != 0 ||
+    rename (tmpname, file) != 0
+  )
+  {
+    iot_log_error
+      (svc->logger, "Unable to write snapshot %s: %s", file, strerror (errno));
+    unlink (tmpname);
+  }
+  free (tmpname);
+  edgex_strbuf_fini (&buf);
+}
+
+void edgex_snapshot_reconcile (edgex_device_service *svc, edgex_error *err)
+{
+  edgex_map_int current;
+  edgex_device *dev;
+  edgex_map_iter iter;
+  unsigned added = 0;
+  unsigned updated = 0;
+  unsigned removed = 0;
+
+  *err = EDGEX_OK;
+  edgex_device *list = edgex_metadata_client_get_devices
+    (svc->logger, &svc->config.endpoints, svc->name, err);
+  if (err->code)
+  {
+    iot_log_error (svc->logger, "Unable to retrieve device list from metadata");
+    return;
+  }
+
+  edgex_map_init (&current);
+  edgex_devmap *update = edgex_devreg_begin (svc->devices);
+  for (edgex_device *d = list; d; d = d->next)
+  {
+    edgex_map_set (&current, d->name, 1);
+    edgex_device *existing = edgex_devmap_findbyname (update, d->name);
+    if (existing)
+    {
+      if
+      (
+        existing->modified == d->modified && strcmp (existing->id, d->id) == 0
+      )
+      {
+        continue;
+      }
+      edgex_devmap_remove (update, existing);
+      updated++;
+    }
+    else
+    {
+      added++;
+    }
+    edgex_device *dup = edgex_device_dup (d);
+    dup->profile = edgex_deviceprofile_intern (svc, dup->profile);
+    edgex_devmap_add (update, dup);
+  }
+
+  /* Devices which were in the snapshot, but are no longer in metadata */
+
+  iter = edgex_map_iter (update->devices);
+  edgex_device **gone = NULL;
+  unsigned ngone = 0;
+  while ((dev = edgex_devmap_next (update, &iter)))
+  {
+    if (edgex_map_get (&current, dev->name) == NULL)
+    {
+      gone = realloc (gone, (ngone + 1) * sizeof (edgex_device *));
+      gone[ngone++] = dev;
+    }
+  }
+  for (unsigned i = 0; i < ngone; i++)
+  {
+    edgex_devmap_remove (update, gone[i]);
+    removed++;
+  }
+  free (gone);
+  edgex_devreg_commit (svc->devices, update);
+  edgex_map_deinit (&current);
+
+  edgex_device_free (list);
+
+  iot_log_info
+  (
+    svc->logger,
+    "Devices reconciled with metadata: %u added, %u updated, %u removed",
+    added, updated, removed
+  );
+}
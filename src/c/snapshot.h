@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_SNAPSHOT_H_
+#define _EDGEX_DEVICE_SNAPSHOT_H_ 1
+
+#include "service.h"
+
+/*
+ * A copy of the service's devices and profiles (with their addressables),
+ * kept on disk so that a restarted service can handle commands without
+ * waiting for metadata. The file holds a JSON document followed by a NUL, so
+ * that it can be parsed directly from a read-only mapping.
+ */
+
+/* Load the snapshot into the service's device registry and profile map */
+
+extern bool edgex_snapshot_load (edgex_device_service *svc, const char *file);
+
+/* Write the current devices and profiles, replacing the file atomically */
+
+extern void edgex_snapshot_save (edgex_device_service *svc, const char *file);
+
+/*
+ * Bring the device registry into line with metadata: devices loaded from a
+ * snapshot are replaced by their current versions, or removed if metadata no
+ * longer has them, and devices added since are loaded.
+ */
+
+extern void edgex_snapshot_reconcile
+  (edgex_device_service *svc, edgex_error *err);
+
+#endif
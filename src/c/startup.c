@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "startup.h"
+#include "errorlist.h"
+#include "edgex_time.h"
+
+#include <string.h>
+#include <pthread.h>
+
+typedef struct startup_run startup_run;
+
+typedef struct startup_task
+{
+  startup_run *run;
+  unsigned index;
+} startup_task;
+
+struct startup_run
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  const edgex_startup_step *steps;
+  unsigned n;
+  void *arg;
+  uint64_t *elapsed;
+  uint32_t started;
+  uint32_t done;
+  unsigned running;
+  bool failed;
+  edgex_error err;
+  startup_task tasks[EDGEX_STARTUP_MAXSTEPS];
+};
+
+/* Run a step, and record its completion. Called without the lock held */
+
+static void startup_step (startup_run *run, unsigned i)
+{
+  edgex_error err = EDGEX_OK;
+  uint64_t started = edgex_device_monotime ();
+
+  run->steps[i].fn (run->arg, &err);
+  run->elapsed[i] = edgex_device_monotime () - started;
+
+  pthread_mutex_lock (&run->lock);
+  if (err.code)
+  {
+    if (!run->failed)
+    {
+      run->failed = true;
+      run->err = err;
+    }
+  }
+  else
+  {
+    run->done |= EDGEX_STARTUP_AFTER (i);
+  }
+  run->running--;
+  pthread_cond_broadcast (&run->cond);
+  pthread_mutex_unlock (&run->lock);
+}
+
+static void startup_task_fn (void *arg)
+{
+  startup_task *task = (startup_task *) arg;
+  startup_step (task->run, task->index);
+}
+
+void edgex_startup_run
+(
+  edgex_executor *ex,
+  const edgex_startup_step *steps,
+  unsigned n,
+  void *arg,
+  uint64_t *elapsed,
+  edgex_error *err
+)
+{
+  startup_run run;
+  uint64_t times[EDGEX_STARTUP_MAXSTEPS];
+
+  memset (&run, 0, sizeof (run));
+  pthread_mutex_init (&run.lock, NULL);
+  pthread_cond_init (&run.cond, NULL);
+  run.steps = steps;
+  run.n = (n < EDGEX_STARTUP_MAXSTEPS) ? n : EDGEX_STARTUP_MAXSTEPS;
+  run.arg = arg;
+  run.elapsed = elapsed ? elapsed : times;
+  memset (run.elapsed, 0, run.n * sizeof (uint64_t));
+  run.err = EDGEX_OK;
+
+  pthread_mutex_lock (&run.lock);
+  while (true)
+  {
+    int mine = -1;
+
+    /* Steps which are not needed are complete at once */
+
+    for (unsigned i = 0; i < run.n; i++)
+    {
+      if (steps[i].fn == NULL)
+      {
+        run.started |= EDGEX_STARTUP_AFTER (i);
+        run.done |= EDGEX_STARTUP_AFTER (i);
+      }
+    }
+
+    /* Start the steps which are ready, keeping the first for this thread */
+
+    for (unsigned i = 0; i < run.n && !run.failed; i++)
+    {
+      if
+      (
+        (run.started & EDGEX_STARTUP_AFTER (i)) == 0 &&
+        (steps[i].after & run.done) == steps[i].after
+      )
+      {
+        run.started |= EDGEX_STARTUP_AFTER (i);
+        run.running++;
+        if (mine == -1)
+        {
+          mine = i;
+        }
+        else
+        {
+          run.tasks[i].run = &run;
+          run.tasks[i].index = i;
+          edgex_executor_submit
+            (ex, EDGEX_EXEC_DISCOVERY, startup_task_fn, &run.tasks[i]);
+        }
+      }
+    }
+
+    if (mine != -1)
+    {
+      pthread_mutex_unlock (&run.lock);
+      startup_step (&run, mine);
+      pthread_mutex_lock (&run.lock);
+    }
+    else if (run.running)
+    {
+      pthread_cond_wait (&run.cond, &run.lock);
+    }
+    else
+    {
+      break;
+    }
+  }
+  pthread_mutex_unlock (&run.lock);
+
+  /*
+   * Without a failure, steps can only be left unstarted if their
+   * dependencies cannot be met (eg they form a cycle)
+   */
+
+  uint32_t all = (run.n == EDGEX_STARTUP_MAXSTEPS) ?
+    UINT32_MAX : EDGEX_STARTUP_AFTER (run.n) - 1;
+  if (!run.failed && run.done != all)
+  {
+    run.failed = true;
+    run.err = EDGEX_INVALID_ARG;
+  }
+  *err = run.err;
+  pthread_cond_destroy (&run.cond);
+  pthread_mutex_destroy (&run.lock);
+}
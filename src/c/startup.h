@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_STARTUP_H_
+#define _EDGEX_DEVICE_STARTUP_H_ 1
+
+#include "executor.h"
+#include "edgex/error.h"
+
+/*
+ * Run a set of startup steps, each once the steps it depends on have
+ * completed, so that independent steps (eg waiting for core-data and for
+ * metadata) proceed at the same time.
+ */
+
+#define EDGEX_STARTUP_MAXSTEPS 32
+
+#define EDGEX_STARTUP_AFTER(n) (1u << (n))
+
+typedef void (*edgex_startup_fn) (void *arg, edgex_error *err);
+
+typedef struct edgex_startup_step
+{
+  const char *name;
+  edgex_startup_fn fn;  // NULL for a step which is not needed
+  uint32_t after;       // EDGEX_STARTUP_AFTER of each step this depends on
+} edgex_startup_step;
+
+/*
+ * Run the n steps, passing arg to each. The calling thread runs steps itself
+ * and others are run by tasks of the discovery class. Once a step fails, no
+ * more are started; the error of the first to fail is returned when those
+ * running have finished. If elapsed is non-NULL, the time in nanoseconds
+ * taken by each step is stored there (0 for a step which did not run).
+ */
+
+extern void edgex_startup_run
+(
+  edgex_executor *ex,
+  const edgex_startup_step *steps,
+  unsigned n,
+  void *arg,
+  uint64_t *elapsed,
+  edgex_error *err
+);
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "stats.h"
+#include "openmetrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+ * Values below 8ns have a bucket each. Above that, a value whose most
+ * significant bit is b falls into one of eight buckets for that power of
+ * two, selected by the next three bits. Values of 2^40ns (about 18 minutes)
+ * and more share the last bucket.
+ */
+
+#define SUB_BITS 3
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define MAX_BIT 40
+#define HIST_BUCKETS ((MAX_BIT - SUB_BITS + 2) * SUB_BUCKETS)
+
+typedef struct stats_hist
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[HIST_BUCKETS];
+} stats_hist;
+
+typedef struct stats_block
+{
+  uint64_t counters[EDGEX_STATS_NCOUNTERS];
+  stats_hist hists[EDGEX_STATS_NHISTS];
+  bool inuse;
+  struct stats_block *next;
+} stats_block;
+
+static const char *counternames[EDGEX_STATS_NCOUNTERS] =
+{
+  "HttpRequests", "HttpClientErrors", "HttpServerErrors",
+  "DriverGetFailures", "DriverPutFailures", "DataPostFailures",
+  "ExecutorTasks", "ExecutorBusy", "DeadlineMisses", "HttpTimeouts",
+  "CircuitRejects"
+};
+
+static const char *histnames[EDGEX_STATS_NHISTS] =
+{
+  "Http", "DriverGet", "DriverPut", "DataPost"
+};
+
+/* Names for the OpenMetrics format. Times there are in seconds */
+
+static const char *countermetrics[EDGEX_STATS_NCOUNTERS] =
+{
+  "edgex_http_requests", "edgex_http_client_errors",
+  "edgex_http_server_errors", "edgex_driver_get_failures",
+  "edgex_driver_put_failures", "edgex_data_post_failures",
+  "edgex_executor_tasks", "edgex_executor_busy_seconds",
+  "edgex_deadline_misses", "edgex_http_timeouts", "edgex_circuit_rejects"
+};
+
+static const char *histmetrics[EDGEX_STATS_NHISTS] =
+{
+  "edgex_http_request_seconds", "edgex_driver_get_seconds",
+  "edgex_driver_put_seconds", "edgex_data_post_seconds"
+};
+
+static const unsigned quantiles[] = { 500, 900, 990, 999 };
+
+#define NQUANTILES (sizeof (quantiles) / sizeof (quantiles[0]))
+
+/*
+ * Blocks are never freed. When a thread exits its block is released for use
+ * by a new thread, which carries on from the counts already there.
+ */
+
+static stats_block *blocks = NULL;
+static pthread_mutex_t blockslock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t keyonce = PTHREAD_ONCE_INIT;
+static pthread_key_t blockkey;
+static __thread stats_block *local = NULL;
+
+static void stats_thread_exit (void *p)
+{
+  __atomic_store_n (&((stats_block *) p)->inuse, false, __ATOMIC_RELEASE);
+}
+
+static void stats_key_init (void)
+{
+  pthread_key_create (&blockkey, stats_thread_exit);
+}
+
+static stats_block *stats_local (void)
+{
+  if (local == NULL)
+  {
+    stats_block *b;
+    pthread_once (&keyonce, stats_key_init);
+    pthread_mutex_lock (&blockslock);
+    for (b = blocks; b; b = b->next)
+    {
+      if (!__atomic_load_n (&b->inuse, __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+    }
+    if (b == NULL)
+    {
+      b = calloc (1, sizeof (stats_block));
+      b->next = blocks;
+      __atomic_store_n (&blocks, b, __ATOMIC_RELEASE);
+    }
+    b->inuse = true;
+    pthread_mutex_unlock (&blockslock);
+    pthread_setspecific (blockkey, b);
+    local = b;
+  }
+  return local;
+}
+
+/* Only the owning thread writes to a block, so a plain add is safe */
+
+#define STATS_ADD(x, n) \
+  __atomic_store_n (&(x), (x) + (n), __ATOMIC_RELAXED)
+
+void edgex_stats_count (edgex_stats_counter c, uint64_t n)
+{
+  stats_block *b = stats_local ();
+  STATS_ADD (b->counters[c], n);
+}
+
+static unsigned bucket_index (uint64_t v)
+{
+  if (v < SUB_BUCKETS)
+  {
+    return v;
+  }
+  unsigned bit = 63 - __builtin_clzll (v);
+  if (bit > MAX_BIT)
+  {
+    return HIST_BUCKETS - 1;
+  }
+  unsigned sub = (v >> (bit - SUB_BITS)) & (SUB_BUCKETS - 1);
+  return (bit - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+/* The largest value which falls into a bucket */
+
+static uint64_t bucket_limit (unsigned i)
+{
+  if (i < SUB_BUCKETS)
+  {
+    return i;
+  }
+  unsigned bit = i / SUB_BUCKETS + SUB_BITS - 1;
+  uint64_t base = (uint64_t) (SUB_BUCKETS + i % SUB_BUCKETS) << (bit - SUB_BITS);
+  return base + (1ULL << (bit - SUB_BITS)) - 1;
+}
+
+void edgex_stats_time (edgex_stats_hist h, uint64_t ns)
+{
+  stats_hist *hist = &stats_local ()->hists[h];
+  STATS_ADD (hist->count, 1);
+  STATS_ADD (hist->sum, ns);
+  STATS_ADD (hist->buckets[bucket_index (ns)], 1);
+  if (ns > hist->max)
+  {
+    __atomic_store_n (&hist->max, ns, __ATOMIC_RELAXED);
+  }
+}
+
+void edgex_stats_calls_note (edgex_stats_calls *c, bool ok, uint64_t ns)
+{
+  __atomic_fetch_add (&c->calls, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&c->time, ns, __ATOMIC_RELAXED);
+  if (!ok)
+  {
+    __atomic_fetch_add (&c->failures, 1, __ATOMIC_RELAXED);
+  }
+}
+
+JSON_Value *edgex_stats_calls_json (const edgex_stats_calls *c)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  uint64_t calls = __atomic_load_n (&c->calls, __ATOMIC_RELAXED);
+  uint64_t time = __atomic_load_n (&c->time, __ATOMIC_RELAXED);
+  json_object_set_number (obj, "Calls", calls);
+  json_object_set_number
+    (obj, "Failures", __atomic_load_n (&c->failures, __ATOMIC_RELAXED));
+  json_object_set_number
+    (obj, "MeanTime", calls ? (double) time / calls / 1000000.0 : 0.0);
+  return val;
+}
+
+edgex_stats_device *edgex_stats_device_new (void)
+{
+  edgex_stats_device *s = calloc (1, sizeof (edgex_stats_device));
+  s->refs = 1;
+  return s;
+}
+
+edgex_stats_device *edgex_stats_device_ref (edgex_stats_device *s)
+{
+  __atomic_add_fetch (&s->refs, 1, __ATOMIC_RELAXED);
+  return s;
+}
+
+void edgex_stats_device_unref (edgex_stats_device *s)
+{
+  if (s && __atomic_sub_fetch (&s->refs, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    free (s);
+  }
+}
+
+static uint64_t percentile (const stats_hist *h, unsigned pc)
+{
+  uint64_t target = (h->count * pc + 999) / 1000;
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < HIST_BUCKETS; i++)
+  {
+    seen += h->buckets[i];
+    if (seen >= target && seen)
+    {
+      uint64_t limit = bucket_limit (i);
+      return limit < h->max ? limit : h->max;
+    }
+  }
+  return h->max;
+}
+
+/* Sum the blocks of all threads */
+
+static void stats_collect (uint64_t *counters, stats_hist *hists)
+{
+  memset (counters, 0, EDGEX_STATS_NCOUNTERS * sizeof (uint64_t));
+  memset (hists, 0, EDGEX_STATS_NHISTS * sizeof (stats_hist));
+  for
+  (
+    stats_block *b = __atomic_load_n (&blocks, __ATOMIC_ACQUIRE);
+    b;
+    b = b->next
+  )
+  {
+    for (unsigned c = 0; c < EDGEX_STATS_NCOUNTERS; c++)
+    {
+      counters[c] += __atomic_load_n (&b->counters[c], __ATOMIC_RELAXED);
+    }
+    for (unsigned h = 0; h < EDGEX_STATS_NHISTS; h++)
+    {
+      stats_hist *src = &b->hists[h];
+      hists[h].count += __atomic_load_n (&src->count, __ATOMIC_RELAXED);
+      hists[h].sum += __atomic_load_n (&src->sum, __ATOMIC_RELAXED);
+      uint64_t max = __atomic_load_n (&src->max, __ATOMIC_RELAXED);
+      if (max > hists[h].max)
+      {
+        hists[h].max = max;
+      }
+      for (unsigned i = 0; i < HIST_BUCKETS; i++)
+      {
+        hists[h].buckets[i] +=
+          __atomic_load_n (&src->buckets[i], __ATOMIC_RELAXED);
+      }
+    }
+  }
+}
+
+void edgex_stats_metrics (JSON_Object *obj)
+{
+  uint64_t counters[EDGEX_STATS_NCOUNTERS];
+  stats_hist *hists = malloc (EDGEX_STATS_NHISTS * sizeof (stats_hist));
+  stats_collect (counters, hists);
+
+  JSON_Value *cval = json_value_init_object ();
+  JSON_Object *cobj = json_value_get_object (cval);
+  for (unsigned c = 0; c < EDGEX_STATS_NCOUNTERS; c++)
+  {
+    json_object_set_number
+    (
+      cobj, counternames[c],
+      c == EDGEX_STATS_EXEC_BUSY ? counters[c] / 1e9 : counters[c]
+    );
+  }
+  json_object_set_value (obj, "Counters", cval);
+
+  /* Latencies are reported in milliseconds */
+
+  JSON_Value *lval = json_value_init_object ();
+  JSON_Object *lobj = json_value_get_object (lval);
+  for (unsigned h = 0; h < EDGEX_STATS_NHISTS; h++)
+  {
+    const stats_hist *hist = &hists[h];
+    JSON_Value *hval = json_value_init_object ();
+    JSON_Object *hobj = json_value_get_object (hval);
+    json_object_set_number (hobj, "Count", hist->count);
+    if (hist->count)
+    {
+      json_object_set_number
+        (hobj, "Mean", (double) hist->sum / hist->count / 1e6);
+      json_object_set_number (hobj, "P50", percentile (hist, 500) / 1e6);
+      json_object_set_number (hobj, "P90", percentile (hist, 900) / 1e6);
+      json_object_set_number (hobj, "P99", percentile (hist, 990) / 1e6);
+      json_object_set_number (hobj, "P999", percentile (hist, 999) / 1e6);
+      json_object_set_number (hobj, "Max", hist->max / 1e6);
+    }
+    json_object_set_value (lobj, histnames[h], hval);
+  }
+  json_object_set_value (obj, "Latency", lval);
+  free (hists);
+}
+
+void edgex_stats_openmetrics (edgex_strbuf *out)
+{
+  uint64_t counters[EDGEX_STATS_NCOUNTERS];
+  stats_hist *hists = malloc (EDGEX_STATS_NHISTS * sizeof (stats_hist));
+  stats_collect (counters, hists);
+
+  for (unsigned c = 0; c < EDGEX_STATS_NCOUNTERS; c++)
+  {
+    edgex_openmetrics_type (out, countermetrics[c], "counter");
+    edgex_strbuf_appendstr (out, countermetrics[c]);
+    edgex_strbuf_appendstr (out, "_total");
+    edgex_openmetrics_value
+    (
+      out, c == EDGEX_STATS_EXEC_BUSY ? counters[c] / 1e9 : counters[c]
+    );
+  }
+
+  for (unsigned h = 0; h < EDGEX_STATS_NHISTS; h++)
+  {
+    const stats_hist *hist = &hists[h];
+    edgex_openmetrics_type (out, histmetrics[h], "summary");
+    if (hist->count)
+    {
+      for (unsigned q = 0; q < NQUANTILES; q++)
+      {
+        char label[32];
+        snprintf
+          (label, sizeof (label), "{quantile=\"%g\"}", quantiles[q] / 1000.0);
+        edgex_strbuf_appendstr (out, histmetrics[h]);
+        edgex_strbuf_appendstr (out, label);
+        edgex_openmetrics_value (out, percentile (hist, quantiles[q]) / 1e9);
+      }
+    }
+    edgex_strbuf_appendstr (out, histmetrics[h]);
+    edgex_strbuf_appendstr (out, "_sum");
+    edgex_openmetrics_value (out, hist->sum / 1e9);
+    edgex_strbuf_appendstr (out, histmetrics[h]);
+    edgex_strbuf_appendstr (out, "_count");
+    edgex_openmetrics_value (out, hist->count);
+  }
+  free (hists);
+}
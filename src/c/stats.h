@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_STATS_H_
+#define _EDGEX_DEVICE_STATS_H_ 1
+
+#include "parson.h"
+#include "strbuf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Service-wide counters and latency histograms. Each thread updates its own
+ * copy without locks or atomic read-modify-write operations; the copies are
+ * summed when the metrics are read. Histograms are log-linear, with eight
+ * buckets per power of two, so percentiles are accurate to within 12.5%.
+ */
+
+typedef enum
+{
+  EDGEX_STATS_HTTP_REQUESTS,
+  EDGEX_STATS_HTTP_CLIENT_ERRORS,
+  EDGEX_STATS_HTTP_SERVER_ERRORS,
+  EDGEX_STATS_DRIVER_GET_FAILURES,
+  EDGEX_STATS_DRIVER_PUT_FAILURES,
+  EDGEX_STATS_DATA_POST_FAILURES,
+  EDGEX_STATS_EXEC_TASKS,
+  EDGEX_STATS_EXEC_BUSY,
+  EDGEX_STATS_DEADLINE_MISSES,
+  EDGEX_STATS_HTTP_TIMEOUTS,
+  EDGEX_STATS_CIRCUIT_REJECTS,
+  EDGEX_STATS_NCOUNTERS
+} edgex_stats_counter;
+
+typedef enum
+{
+  EDGEX_STATS_HTTP,
+  EDGEX_STATS_DRIVER_GET,
+  EDGEX_STATS_DRIVER_PUT,
+  EDGEX_STATS_DATA_POST,
+  EDGEX_STATS_NHISTS
+} edgex_stats_hist;
+
+extern void edgex_stats_count (edgex_stats_counter c, uint64_t n);
+
+/* Record a duration, in nanoseconds */
+
+extern void edgex_stats_time (edgex_stats_hist h, uint64_t ns);
+
+/*
+ * Counts of calls to the driver, kept for each device and for each command
+ * of a profile. These are shared between threads and updated atomically.
+ */
+
+typedef struct edgex_stats_calls
+{
+  uint64_t calls;
+  uint64_t failures;
+  uint64_t time;
+} edgex_stats_calls;
+
+extern void edgex_stats_calls_note
+  (edgex_stats_calls *c, bool ok, uint64_t ns);
+
+extern JSON_Value *edgex_stats_calls_json (const edgex_stats_calls *c);
+
+/*
+ * Statistics for a device. These are shared by successive versions of the
+ * device, so that they survive updates, and are reference counted.
+ */
+
+typedef struct edgex_stats_device
+{
+  uint32_t refs;
+  edgex_stats_calls get;
+  edgex_stats_calls put;
+} edgex_stats_device;
+
+extern edgex_stats_device *edgex_stats_device_new (void);
+
+extern edgex_stats_device *edgex_stats_device_ref (edgex_stats_device *s);
+
+extern void edgex_stats_device_unref (edgex_stats_device *s);
+
+/* Add the service-wide statistics to a metrics object */
+
+extern void edgex_stats_metrics (JSON_Object *obj);
+
+/* Append the service-wide statistics in the OpenMetrics text format */
+
+extern void edgex_stats_openmetrics (edgex_strbuf *out);
+
+#endif
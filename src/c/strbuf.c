@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "strbuf.h"
+#include "numfmt.h"
+#include "memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define STRBUF_MIN 256
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+void edgex_strbuf_init (edgex_strbuf *b)
+{
+  b->data = NULL;
+  b->len = 0;
+  b->cap = 0;
+}
+
+void edgex_strbuf_fini (edgex_strbuf *b)
+{
+  edgex_mem_free (EDGEX_MEM_BUFFERS, b->data);
+  edgex_strbuf_init (b);
+}
+
+void edgex_strbuf_reserve (edgex_strbuf *b, size_t extra)
+{
+  if (b->len + extra + 1 > b->cap)
+  {
+    size_t newcap = b->cap ? b->cap : STRBUF_MIN;
+    while (newcap < b->len + extra + 1)
+    {
+      newcap *= 2;
+    }
+    b->data = edgex_mem_realloc (EDGEX_MEM_BUFFERS, b->data, newcap);
+    b->cap = newcap;
+  }
+}
+
+void edgex_strbuf_append (edgex_strbuf *b, const char *s, size_t len)
+{
+  edgex_strbuf_reserve (b, len);
+  memcpy (b->data + b->len, s, len);
+  b->len += len;
+  b->data[b->len] = '\0';
+}
+
+void edgex_strbuf_appendstr (edgex_strbuf *b, const char *s)
+{
+  edgex_strbuf_append (b, s, strlen (s));
+}
+
+void edgex_strbuf_appendchar (edgex_strbuf *b, char c)
+{
+  edgex_strbuf_reserve (b, 1);
+  b->data[b->len++] = c;
+  b->data[b->len] = '\0';
+}
+
+void edgex_strbuf_appenduint (edgex_strbuf *b, uint64_t val)
+{
+  edgex_strbuf_reserve (b, EDGEX_FMT_BUFSIZE);
+  b->len += edgex_fmt_uint (val, b->data + b->len);
+}
+
+void edgex_strbuf_appendjson (edgex_strbuf *b, const char *s)
+{
+  static const char hex[] = "0123456789abcdef";
+  const char *run = s;
+
+  edgex_strbuf_appendchar (b, '"');
+  for (; *s; s++)
+  {
+    unsigned char c = (unsigned char) *s;
+    if (c >= 0x20 && c != '"' && c != '\\')
+    {
+      continue;
+    }
+    edgex_strbuf_append (b, run, s - run);
+    run = s + 1;
+    switch (c)
+    {
+      case '"': edgex_strbuf_append (b, "\\\"", 2); break;
+      case '\\': edgex_strbuf_append (b, "\\\\", 2); break;
+      case '\b': edgex_strbuf_append (b, "\\b", 2); break;
+      case '\f': edgex_strbuf_append (b, "\\f", 2); break;
+      case '\n': edgex_strbuf_append (b, "\\n", 2); break;
+      case '\r': edgex_strbuf_append (b, "\\r", 2); break;
+      case '\t': edgex_strbuf_append (b, "\\t", 2); break;
+      default:
+      {
+        char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+        edgex_strbuf_append (b, esc, 6);
+      }
+    }
+  }
+  edgex_strbuf_append (b, run, s - run);
+  edgex_strbuf_appendchar (b, '"');
+}
+
+char *edgex_strbuf_dup (const edgex_strbuf *b)
+{
+  char *result = malloc (b->len + 1);
+  if (b->len)
+  {
+    memcpy (result, b->data, b->len);
+  }
+  result[b->len] = '\0';
+  return result;
+}
+
+static void scratch_free (void *p)
+{
+  edgex_strbuf_fini ((edgex_strbuf *) p);
+  free (p);
+}
+
+static void scratch_init (void)
+{
+  pthread_key_create (&scratch_key, scratch_free);
+}
+
+edgex_strbuf *edgex_strbuf_scratch (void)
+{
+  pthread_once (&scratch_once, scratch_init);
+  edgex_strbuf *b = pthread_getspecific (scratch_key);
+  if (b == NULL)
+  {
+    b = malloc (sizeof (edgex_strbuf));
+    edgex_strbuf_init (b);
+    pthread_setspecific (scratch_key, b);
+  }
+  b->len = 0;
+  if (b->data)
+  {
+    b->data[0] = '\0';
+  }
+  return b;
+}
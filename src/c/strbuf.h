@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_STRBUF_H_
+#define _EDGEX_DEVICE_STRBUF_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Growable character buffer, always kept NUL-terminated */
+
+typedef struct edgex_strbuf
+{
+  char *data;
+  size_t len;
+  size_t cap;
+} edgex_strbuf;
+
+extern void edgex_strbuf_init (edgex_strbuf *b);
+
+extern void edgex_strbuf_fini (edgex_strbuf *b);
+
+extern void edgex_strbuf_reserve (edgex_strbuf *b, size_t extra);
+
+extern void edgex_strbuf_append (edgex_strbuf *b, const char *s, size_t len);
+
+extern void edgex_strbuf_appendstr (edgex_strbuf *b, const char *s);
+
+extern void edgex_strbuf_appendchar (edgex_strbuf *b, char c);
+
+extern void edgex_strbuf_appenduint (edgex_strbuf *b, uint64_t val);
+
+/* Append s as a quoted JSON string, escaping as required */
+
+extern void edgex_strbuf_appendjson (edgex_strbuf *b, const char *s);
+
+/* Return a malloc'd copy of the contents */
+
+extern char *edgex_strbuf_dup (const edgex_strbuf *b);
+
+/* Return the calling thread's scratch buffer, emptied. The buffer is kept
+ * between calls so that its storage is reused.
+ */
+
+extern edgex_strbuf *edgex_strbuf_scratch (void);
+
+#endif
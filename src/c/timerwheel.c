@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "timerwheel.h"
+#include "edgex_time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define SLOT_NS 1000000ULL
+#define NSLOTS 1024
+#define NWORDS (NSLOTS / 64)
+
+/* Histogram bucket bounds, in nanoseconds. The last bucket is unbounded */
+
+#define NBUCKETS 6
+
+static const uint64_t bucketlimits[NBUCKETS - 1] =
+  { 10000, 100000, 1000000, 10000000, 100000000 };
+
+static const char *bucketnames[NBUCKETS] =
+  { "10us", "100us", "1ms", "10ms", "100ms", "+Inf" };
+
+struct edgex_timer
+{
+  char *name;
+  edgex_timerwheel *wheel;
+  edgex_exec_class cls;
+  edgex_exec_fn fn;
+  void *arg;
+  uint64_t period;
+  uint64_t deadline;
+  uint64_t due;
+  uint64_t lastdue;
+  uint64_t laststart;
+  bool pending;
+  bool removed;
+  uint64_t runs;
+  uint64_t missed;
+  uint64_t maxlate;
+  uint64_t maxjitter;
+  uint64_t lateness[NBUCKETS];
+  uint64_t jitter[NBUCKETS];
+  struct edgex_timer *next;
+  struct edgex_timer *prev;
+};
+
+struct edgex_timerwheel
+{
+  edgex_executor *ex;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+  bool started;
+  uint64_t tick;
+  unsigned count;
+  uint64_t occupied[NWORDS];
+  edgex_timer *slots[NSLOTS];
+};
+
+edgex_timerwheel *edgex_timerwheel_create (edgex_executor *ex)
+{
+  pthread_condattr_t attr;
+  edgex_timerwheel *w = calloc (1, sizeof (edgex_timerwheel));
+  w->ex = ex;
+  w->tick = edgex_device_monotime () / SLOT_NS;
+  pthread_mutex_init (&w->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&w->cond, &attr);
+  pthread_condattr_destroy (&attr);
+  return w;
+}
+
+static void timer_link (edgex_timerwheel *w, edgex_timer *t)
+{
+  unsigned s = (t->deadline / SLOT_NS) % NSLOTS;
+  t->prev = NULL;
+  t->next = w->slots[s];
+  if (t->next)
+  {
+    t->next->prev = t;
+  }
+  w->slots[s] = t;
+  w->occupied[s / 64] |= 1ULL << (s % 64);
+}
+
+static void timer_unlink (edgex_timerwheel *w, edgex_timer *t)
+{
+  unsigned s = (t->deadline / SLOT_NS) % NSLOTS;
+  if (t->prev)
+  {
+    t->prev->next = t->next;
+  }
+  else
+  {
+    w->slots[s] = t->next;
+  }
+  if (t->next)
+  {
+    t->next->prev = t->prev;
+  }
+  if (w->slots[s] == NULL)
+  {
+    w->occupied[s / 64] &= ~(1ULL << (s % 64));
+  }
+}
+
+static void timer_free (edgex_timer *t)
+{
+  free (t->name);
+  free (t);
+}
+
+static void record (uint64_t *hist, uint64_t *max, uint64_t val)
+{
+  unsigned b = 0;
+  while (b < NBUCKETS - 1 && val > bucketlimits[b])
+  {
+    b++;
+  }
+  hist[b]++;
+  if (val > *max)
+  {
+    *max = val;
+  }
+}
+
+static void timer_run (void *p)
+{
+  edgex_timer *t = (edgex_timer *) p;
+  edgex_timerwheel *w = t->wheel;
+  uint64_t start = edgex_device_monotime ();
+
+  pthread_mutex_lock (&w->lock);
+  t->runs++;
+  record (t->lateness, &t->maxlate, start > t->due ? start - t->due : 0);
+  if (t->laststart)
+  {
+    /* Jitter is the difference between the actual and intended intervals */
+
+    uint64_t actual = start - t->laststart;
+    uint64_t intended = t->due - t->lastdue;
+    record
+    (
+      t->jitter, &t->maxjitter,
+      actual > intended ? actual - intended : intended - actual
+    );
+  }
+  t->laststart = start;
+  t->lastdue = t->due;
+  pthread_mutex_unlock (&w->lock);
+
+  t->fn (t->arg);
+
+  pthread_mutex_lock (&w->lock);
+  t->pending = false;
+  if (t->removed)
+  {
+    timer_free (t);
+  }
+  pthread_mutex_unlock (&w->lock);
+}
+
+static void timer_fire (edgex_timerwheel *w, edgex_timer *t, uint64_t now)
+{
+  if (t->pending)
+  {
+    t->missed++;
+  }
+  else
+  {
+    t->pending = true;
+    t->due = t->deadline;
+    edgex_executor_submit (w->ex, t->cls, timer_run, t);
+  }
+
+  /* Advance from the deadline rather than from now, skipping any runs missed */
+
+  t->deadline += t->period;
+  if (t->deadline <= now)
+  {
+    uint64_t skip = (now - t->deadline) / t->period + 1;
+    t->missed += skip;
+    t->deadline += skip * t->period;
+  }
+}
+
+/*
+ * Find the earliest deadline in the coming rotation of the wheel. Returns
+ * zero if there are no timers at all.
+ */
+
+static uint64_t timer_next (edgex_timerwheel *w, uint64_t nowtick)
+{
+  for (uint64_t tick = nowtick; tick < nowtick + NSLOTS; )
+  {
+    unsigned s = tick % NSLOTS;
+    uint64_t bits = w->occupied[s / 64] >> (s % 64);
+    if (bits == 0)
+    {
+      tick += 64 - (s % 64);
+      continue;
+    }
+    tick += __builtin_ctzll (bits);
+    if (tick >= nowtick + NSLOTS)
+    {
+      break;
+    }
+    s = tick % NSLOTS;
+    uint64_t result = UINT64_MAX;
+    for (edgex_timer *t = w->slots[s]; t; t = t->next)
+    {
+      if (t->deadline < (tick + 1) * SLOT_NS && t->deadline < result)
+      {
+        result = t->deadline;
+      }
+    }
+    if (result != UINT64_MAX)
+    {
+      return result;
+    }
+    tick++;
+  }
+  return w->count ? (nowtick + NSLOTS) * SLOT_NS : 0;
+}
+
+static void *timerwheel_thread (void *p)
+{
+  edgex_timerwheel *w = (edgex_timerwheel *) p;
+
+  pthread_mutex_lock (&w->lock);
+  while (w->running)
+  {
+    uint64_t now = edgex_device_monotime ();
+    uint64_t nowtick = now / SLOT_NS;
+    uint64_t tick = w->tick;
+    edgex_timer *due = NULL;
+
+    if (nowtick - tick >= NSLOTS)
+    {
+      tick = nowtick - NSLOTS + 1;
+    }
+    for (; tick <= nowtick; tick++)
+    {
+      edgex_timer *next;
+      for (edgex_timer *t = w->slots[tick % NSLOTS]; t; t = next)
+      {
+        next = t->next;
+        if (t->deadline <= now)
+        {
+          timer_unlink (w, t);
+          t->next = due;
+          due = t;
+        }
+      }
+    }
+    w->tick = nowtick;
+
+    while (due)
+    {
+      edgex_timer *t = due;
+      due = t->next;
+      timer_fire (w, t, now);
+      timer_link (w, t);
+    }
+
+    uint64_t wake = timer_next (w, nowtick);
+    if (wake)
+    {
+      struct timespec ts;
+      ts.tv_sec = wake / 1000000000ULL;
+      ts.tv_nsec = wake % 1000000000ULL;
+      pthread_cond_timedwait (&w->cond, &w->lock, &ts);
+    }
+    else
+    {
+      pthread_cond_wait (&w->cond, &w->lock);
+    }
+  }
+  pthread_mutex_unlock (&w->lock);
+  return NULL;
+}
+
+void edgex_timerwheel_start (edgex_timerwheel *w)
+{
+  pthread_mutex_lock (&w->lock);
+  if (!w->started)
+  {
+    w->running = true;
+    w->started = true;
+    pthread_create (&w->thread, NULL, timerwheel_thread, w);
+  }
+  pthread_mutex_unlock (&w->lock);
+}
+
+edgex_timer *edgex_timerwheel_add
+(
+  edgex_timerwheel *w,
+  const char *name,
+  uint64_t period,
+  edgex_exec_class cls,
+  edgex_exec_fn fn,
+  void *arg
+)
+{
+  edgex_timer *t = calloc (1, sizeof (edgex_timer));
+  t->name = strdup (name);
+  t->wheel = w;
+  t->cls = cls;
+  t->fn = fn;
+  t->arg = arg;
+  t->period = period ? period : 1;
+
+  pthread_mutex_lock (&w->lock);
+  t->deadline = edgex_device_monotime () + t->period;
+  timer_link (w, t);
+  w->count++;
+  pthread_cond_signal (&w->cond);
+  pthread_mutex_unlock (&w->lock);
+  return t;
+}
+
+void edgex_timerwheel_remove (edgex_timerwheel *w, edgex_timer *t)
+{
+  pthread_mutex_lock (&w->lock);
+  timer_unlink (w, t);
+  w->count--;
+  if (t->pending)
+  {
+    t->removed = true;
+  }
+  else
+  {
+    timer_free (t);
+  }
+  pthread_mutex_unlock (&w->lock);
+}
+
+static JSON_Value *histogram (const uint64_t *hist)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  for (unsigned i = 0; i < NBUCKETS; i++)
+  {
+    json_object_set_number (obj, bucketnames[i], hist[i]);
+  }
+  return val;
+}
+
+void edgex_timerwheel_metrics (edgex_timerwheel *w, JSON_Object *obj)
+{
+  JSON_Value *arrval = json_value_init_array ();
+  JSON_Array *arr = json_value_get_array (arrval);
+
+  pthread_mutex_lock (&w->lock);
+  for (unsigned s = 0; s < NSLOTS; s++)
+  {
+    for (edgex_timer *t = w->slots[s]; t; t = t->next)
+    {
+      JSON_Value *tval = json_value_init_object ();
+      JSON_Object *tobj = json_value_get_object (tval);
+      json_object_set_string (tobj, "Name", t->name);
+      json_object_set_number (tobj, "Interval", (double)t->period / SLOT_NS);
+      json_object_set_number (tobj, "Runs", t->runs);
+      json_object_set_number (tobj, "Missed", t->missed);
+      json_object_set_number
+        (tobj, "LatenessMax", (double)t->maxlate / SLOT_NS);
+      json_object_set_value (tobj, "Lateness", histogram (t->lateness));
+      json_object_set_number
+        (tobj, "JitterMax", (double)t->maxjitter / SLOT_NS);
+      json_object_set_value (tobj, "Jitter", histogram (t->jitter));
+      json_array_append_value (arr, tval);
+    }
+  }
+  pthread_mutex_unlock (&w->lock);
+  json_object_set_value (obj, "Schedules", arrval);
+}
+
+void edgex_timerwheel_stop (edgex_timerwheel *w)
+{
+  bool started;
+  pthread_mutex_lock (&w->lock);
+  started = w->started;
+  w->running = false;
+  w->started = false;
+  pthread_cond_signal (&w->cond);
+  pthread_mutex_unlock (&w->lock);
+  if (started)
+  {
+    pthread_join (w->thread, NULL);
+  }
+}
+
+void edgex_timerwheel_free (edgex_timerwheel *w)
+{
+  if (w)
+  {
+    edgex_timerwheel_stop (w);
+    for (unsigned s = 0; s < NSLOTS; s++)
+    {
+      while (w->slots[s])
+      {
+        edgex_timer *t = w->slots[s];
+        w->slots[s] = t->next;
+        timer_free (t);
+      }
+    }
+    pthread_cond_destroy (&w->cond);
+    pthread_mutex_destroy (&w->lock);
+    free (w);
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_TIMERWHEEL_H_
+#define _EDGEX_DEVICE_TIMERWHEEL_H_ 1
+
+#include "executor.h"
+#include "parson.h"
+
+/*
+ * Periodic timers for scheduled events. Deadlines are absolute times on the
+ * monotonic clock, each advanced by exactly one period when it fires, so
+ * that timers do not drift. A timer whose previous run has not started or
+ * finished when it falls due skips that run, which is counted as missed.
+ * Timers are held in a hashed timing wheel with millisecond slots.
+ */
+
+typedef struct edgex_timerwheel edgex_timerwheel;
+
+typedef struct edgex_timer edgex_timer;
+
+/* Create a timer wheel whose timers run on the given executor */
+
+extern edgex_timerwheel *edgex_timerwheel_create (edgex_executor *ex);
+
+/* Start the thread which dispatches due timers */
+
+extern void edgex_timerwheel_start (edgex_timerwheel *w);
+
+/*
+ * Add a timer which runs fn (arg) every period nanoseconds, in the given
+ * class. The first run is due one period from now. The name identifies the
+ * timer in metrics, and is copied.
+ */
+
+extern edgex_timer *edgex_timerwheel_add
+(
+  edgex_timerwheel *w,
+  const char *name,
+  uint64_t period,
+  edgex_exec_class cls,
+  edgex_exec_fn fn,
+  void *arg
+);
+
+/* Remove a timer. A run already submitted may still take place */
+
+extern void edgex_timerwheel_remove (edgex_timerwheel *w, edgex_timer *t);
+
+/* Add lateness and jitter statistics for each timer to a metrics object */
+
+extern void edgex_timerwheel_metrics (edgex_timerwheel *w, JSON_Object *obj);
+
+/* Stop dispatching timers */
+
+extern void edgex_timerwheel_stop (edgex_timerwheel *w);
+
+/* Free the wheel and its timers. The executor must have been stopped */
+
+extern void edgex_timerwheel_free (edgex_timerwheel *w);
+
+#endif
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "trace.h"
+
+#if CSDK_BUILD_TRACE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+/* Spans held for each thread. This must be a power of two */
+
+#define TRACE_RING 2048
+#define TRACE_DETAIL 4
+
+typedef struct trace_span
+{
+  uint64_t trace;
+  uint64_t start;
+  uint64_t end;
+  uint64_t stage;
+  uint64_t detail[TRACE_DETAIL];
+} trace_span;
+
+/*
+ * A ring is written only by its thread. Readers copy the spans, then discard
+ * any which the writer may have overwritten meanwhile, as shown by the head.
+ * Fields are accessed atomically so that such a race is well defined.
+ */
+
+typedef struct trace_ring
+{
+  uint64_t head;
+  unsigned id;
+  bool inuse;
+  struct trace_ring *next;
+  trace_span spans[TRACE_RING];
+} trace_ring;
+
+static const char *stagenames[EDGEX_TRACE_NSTAGES] =
+{
+  "http", "command", "driver.get", "driver.put", "event", "post", "schedule"
+};
+
+/* As with statistics blocks, the rings of exited threads are reused */
+
+static trace_ring *rings = NULL;
+static unsigned nrings = 0;
+static uint64_t lasttrace = 0;
+static pthread_mutex_t ringslock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t keyonce = PTHREAD_ONCE_INIT;
+static pthread_key_t ringkey;
+static __thread trace_ring *local = NULL;
+static __thread uint64_t current = 0;
+
+static void trace_thread_exit (void *p)
+{
+  __atomic_store_n (&((trace_ring *) p)->inuse, false, __ATOMIC_RELEASE);
+}
+
+static void trace_key_init (void)
+{
+  pthread_key_create (&ringkey, trace_thread_exit);
+}
+
+static trace_ring *trace_local (void)
+{
+  if (local == NULL)
+  {
+    trace_ring *r;
+    pthread_once (&keyonce, trace_key_init);
+    pthread_mutex_lock (&ringslock);
+    for (r = rings; r; r = r->next)
+    {
+      if (!__atomic_load_n (&r->inuse, __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+    }
+    if (r == NULL)
+    {
+      r = calloc (1, sizeof (trace_ring));
+      r->id = ++nrings;
+      r->next = rings;
+      __atomic_store_n (&rings, r, __ATOMIC_RELEASE);
+    }
+    r->inuse = true;
+    pthread_mutex_unlock (&ringslock);
+    pthread_setspecific (ringkey, r);
+    local = r;
+  }
+  return local;
+}
+
+uint64_t edgex_trace_root (void)
+{
+  current = __atomic_add_fetch (&lasttrace, 1, __ATOMIC_RELAXED);
+  return current;
+}
+
+uint64_t edgex_trace_current (void)
+{
+  return current;
+}
+
+void edgex_trace_resume (uint64_t trace)
+{
+  current = trace;
+}
+
+#define TRACE_SET(x, v) __atomic_store_n (&(x), (v), __ATOMIC_RELAXED)
+#define TRACE_GET(x) __atomic_load_n (&(x), __ATOMIC_RELAXED)
+
+void edgex_trace_span
+  (edgex_trace_stage stage, uint64_t start, const char *detail)
+{
+  uint64_t words[TRACE_DETAIL] = { 0 };
+  trace_ring *r = trace_local ();
+  uint64_t head = r->head;
+  trace_span *s = &r->spans[head & (TRACE_RING - 1)];
+
+  if (detail)
+  {
+    strncpy ((char *) words, detail, sizeof (words) - 1);
+  }
+
+  /* Keep the span's contents from being seen before the previous head */
+
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  TRACE_SET (s->trace, current);
+  TRACE_SET (s->start, start);
+  TRACE_SET (s->end, edgex_device_monotime ());
+  TRACE_SET (s->stage, stage);
+  for (unsigned i = 0; i < TRACE_DETAIL; i++)
+  {
+    TRACE_SET (s->detail[i], words[i]);
+  }
+  __atomic_store_n (&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copy the complete spans of a ring into buf, returning how many there are
+ * and the sequence number of the first.
+ */
+
+static unsigned trace_copy (trace_ring *r, trace_span *buf, uint64_t *seq)
+{
+  uint64_t head = __atomic_load_n (&r->head, __ATOMIC_ACQUIRE);
+  uint64_t from = head > TRACE_RING ? head - TRACE_RING : 0;
+  for (uint64_t i = from; i < head; i++)
+  {
+    trace_span *s = &r->spans[i & (TRACE_RING - 1)];
+    trace_span *d = &buf[i - from];
+    d->trace = TRACE_GET (s->trace);
+    d->start = TRACE_GET (s->start);
+    d->end = TRACE_GET (s->end);
+    d->stage = TRACE_GET (s->stage);
+    for (unsigned j = 0; j < TRACE_DETAIL; j++)
+    {
+      d->detail[j] = TRACE_GET (s->detail[j]);
+    }
+  }
+
+  /* The span at the head may be partly written over the oldest one copied */
+
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+  uint64_t now = __atomic_load_n (&r->head, __ATOMIC_RELAXED);
+  uint64_t valid = now >= TRACE_RING ? now - TRACE_RING + 1 : 0;
+  if (valid > from)
+  {
+    if (valid >= head)
+    {
+      return 0;
+    }
+    memmove (buf, buf + (valid - from), (head - valid) * sizeof (trace_span));
+    from = valid;
+  }
+  *seq = from;
+  return head - from;
+}
+
+static void append_hex (edgex_strbuf *out, uint64_t hi, uint64_t lo, bool wide)
+{
+  char buf[40];
+  if (wide)
+  {
+    snprintf (buf, sizeof (buf), "\"%016llx%016llx\"",
+      (unsigned long long) hi, (unsigned long long) lo);
+  }
+  else
+  {
+    snprintf (buf, sizeof (buf), "\"%016llx\"", (unsigned long long) lo);
+  }
+  edgex_strbuf_appendstr (out, buf);
+}
+
+/* Chrome trace timestamps are in microseconds */
+
+static void append_micros (edgex_strbuf *out, uint64_t ns)
+{
+  char buf[32];
+  snprintf (buf, sizeof (buf), "%llu.%03u",
+    (unsigned long long) (ns / 1000), (unsigned) (ns % 1000));
+  edgex_strbuf_appendstr (out, buf);
+}
+
+static void chrome_span
+  (edgex_strbuf *out, unsigned tid, const trace_span *s, bool first)
+{
+  edgex_strbuf_appendstr (out, first ? "{\"name\":" : ",{\"name\":");
+  edgex_strbuf_appendjson (out, stagenames[s->stage]);
+  edgex_strbuf_appendstr (out, ",\"cat\":\"edgex\",\"ph\":\"X\",\"ts\":");
+  append_micros (out, s->start);
+  edgex_strbuf_appendstr (out, ",\"dur\":");
+  append_micros (out, s->end - s->start);
+  edgex_strbuf_appendstr (out, ",\"pid\":1,\"tid\":");
+  edgex_strbuf_appenduint (out, tid);
+  edgex_strbuf_appendstr (out, ",\"args\":{\"trace\":");
+  edgex_strbuf_appenduint (out, s->trace);
+  if (s->detail[0])
+  {
+    edgex_strbuf_appendstr (out, ",\"detail\":");
+    edgex_strbuf_appendjson (out, (const char *) s->detail);
+  }
+  edgex_strbuf_appendstr (out, "}}");
+}
+
+static void otlp_span
+(
+  edgex_strbuf *out,
+  unsigned tid,
+  uint64_t seq,
+  int64_t offset,
+  const trace_span *s,
+  bool first
+)
+{
+  edgex_strbuf_appendstr (out, first ? "{\"traceId\":" : ",{\"traceId\":");
+  append_hex (out, 0, s->trace, true);
+  edgex_strbuf_appendstr (out, ",\"spanId\":");
+  append_hex (out, 0, ((uint64_t) tid << 32) | (seq & 0xffffffff), false);
+  edgex_strbuf_appendstr (out, ",\"name\":");
+  edgex_strbuf_appendjson (out, stagenames[s->stage]);
+  edgex_strbuf_appendstr (out, ",\"kind\":1,\"startTimeUnixNano\":\"");
+  edgex_strbuf_appenduint (out, s->start + offset);
+  edgex_strbuf_appendstr (out, "\",\"endTimeUnixNano\":\"");
+  edgex_strbuf_appenduint (out, s->end + offset);
+  edgex_strbuf_appendstr
+    (out, "\",\"attributes\":[{\"key\":\"thread.id\",\"value\":{\"intValue\":\"");
+  edgex_strbuf_appenduint (out, tid);
+  edgex_strbuf_appendstr (out, "\"}}");
+  if (s->detail[0])
+  {
+    edgex_strbuf_appendstr
+      (out, ",{\"key\":\"edgex.detail\",\"value\":{\"stringValue\":");
+    edgex_strbuf_appendjson (out, (const char *) s->detail);
+    edgex_strbuf_appendstr (out, "}}");
+  }
+  edgex_strbuf_appendstr (out, "]}");
+}
+
+void edgex_trace_export
+  (edgex_strbuf *out, edgex_trace_format format, const char *service)
+{
+  struct timespec ts;
+  bool first = true;
+  trace_span *buf = malloc (TRACE_RING * sizeof (trace_span));
+
+  /* OTLP requires wall-clock times, so find the offset from monotonic time */
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+  int64_t offset = (int64_t) ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec)
+    - (int64_t) edgex_device_monotime ();
+
+  if (format == EDGEX_TRACE_OTLP)
+  {
+    edgex_strbuf_appendstr
+    (
+      out, "{\"resourceSpans\":[{\"resource\":{\"attributes\":"
+      "[{\"key\":\"service.name\",\"value\":{\"stringValue\":"
+    );
+    edgex_strbuf_appendjson (out, service ? service : "");
+    edgex_strbuf_appendstr
+      (out, "}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"edgex-device-sdk\"},\"spans\":[");
+  }
+  else
+  {
+    edgex_strbuf_appendstr (out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  }
+
+  for
+  (
+    trace_ring *r = __atomic_load_n (&rings, __ATOMIC_ACQUIRE);
+    r;
+    r = r->next
+  )
+  {
+    uint64_t seq = 0;
+    unsigned n = trace_copy (r, buf, &seq);
+    for (unsigned i = 0; i < n; i++)
+    {
+      if (buf[i].stage >= EDGEX_TRACE_NSTAGES)
+      {
+        continue;
+      }
+      if (format == EDGEX_TRACE_OTLP)
+      {
+        otlp_span (out, r->id, seq + i, offset, &buf[i], first);
+      }
+      else
+      {
+        chrome_span (out, r->id, &buf[i], first);
+      }
+      first = false;
+    }
+  }
+
+  edgex_strbuf_appendstr (out, format == EDGEX_TRACE_OTLP ? "]}]}]}" : "]}");
+  free (buf);
+}
+
+#endif
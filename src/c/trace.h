@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_TRACE_H_
+#define _EDGEX_DEVICE_TRACE_H_ 1
+
+#include "edgex/csdk-defs.h"
+#include "strbuf.h"
+#include "edgex_time.h"
+
+#include <stdint.h>
+
+/*
+ * Tracing of the stages of request handling. Each thread records spans in
+ * its own ring buffer, overwriting the oldest, and the buffers are read only
+ * when a trace is exported. Spans recorded by a thread belong to the trace
+ * most recently started or resumed on it, so that the stages of one command
+ * can be told apart from those of others running at the same time.
+ *
+ * Tracing is built only if CSDK_BUILD_TRACE is set; otherwise the macros
+ * below do nothing and their arguments are not evaluated.
+ */
+
+typedef enum
+{
+  EDGEX_TRACE_HTTP,
+  EDGEX_TRACE_COMMAND,
+  EDGEX_TRACE_DRIVER_GET,
+  EDGEX_TRACE_DRIVER_PUT,
+  EDGEX_TRACE_EVENT,
+  EDGEX_TRACE_POST,
+  EDGEX_TRACE_SCHEDULE,
+  EDGEX_TRACE_NSTAGES
+} edgex_trace_stage;
+
+typedef enum
+{
+  EDGEX_TRACE_CHROME,
+  EDGEX_TRACE_OTLP
+} edgex_trace_format;
+
+#if CSDK_BUILD_TRACE
+
+/* Start a new trace on the calling thread, returning its identifier */
+
+extern uint64_t edgex_trace_root (void);
+
+/* Return the identifier of the calling thread's current trace */
+
+extern uint64_t edgex_trace_current (void);
+
+/* Continue a trace, eg one started on another thread */
+
+extern void edgex_trace_resume (uint64_t trace);
+
+/*
+ * Record a span of the current trace which began at the given monotonic time
+ * and ends now. The detail, which may be NULL, is truncated if long.
+ */
+
+extern void edgex_trace_span
+  (edgex_trace_stage stage, uint64_t start, const char *detail);
+
+/*
+ * Append the spans held as a Chrome trace (JSON Trace Event format), or as an
+ * OpenTelemetry (OTLP/JSON) traces request.
+ */
+
+extern void edgex_trace_export
+  (edgex_strbuf *out, edgex_trace_format format, const char *service);
+
+#define EDGEX_TRACE_START(var) uint64_t var = edgex_device_monotime ()
+#define EDGEX_TRACE_SPAN(stage, start, detail) \
+  edgex_trace_span (stage, start, detail)
+#define EDGEX_TRACE_ROOT() edgex_trace_root ()
+#define EDGEX_TRACE_RESUME(trace) edgex_trace_resume (trace)
+
+#else
+
+#define EDGEX_TRACE_START(var)
+#define EDGEX_TRACE_SPAN(stage, start, detail) ((void) 0)
+#define EDGEX_TRACE_ROOT() ((void) 0)
+#define EDGEX_TRACE_RESUME(trace) ((void) 0)
+
+#endif
+
+#endif
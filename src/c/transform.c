@@ -0,0 +1,512 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "transform.h"
+
+#include <math.h>
+#include <limits.h>
+#include <float.h>
+#include <string.h>
+#include <assert.h>
+
+/* Values are transformed in chunks of this size, held on the stack */
+
+#define XFORM_CHUNK 64
+
+static bool isNumericType (edgex_propertytype type)
+{
+  return (type != Bool && type != String && type != Binary);
+}
+
+bool edgex_transform_enabled (const edgex_propertyvalue *props)
+{
+  return isNumericType (props->type) &&
+    (props->offset.enabled || props->scale.enabled || props->base.enabled ||
+     props->shift.enabled || props->mask.enabled);
+}
+
+static inline long long int loadInt
+  (const edgex_device_resultvalue *value, edgex_propertytype type)
+{
+  switch (type)
+  {
+    case Uint8: return value->ui8_result;
+    case Uint16: return value->ui16_result;
+    case Uint32: return value->ui32_result;
+    case Uint64: return value->ui64_result;
+    case Int8: return value->i8_result;
+    case Int16: return value->i16_result;
+    case Int32: return value->i32_result;
+    case Int64: return value->i64_result;
+    default: assert (0);
+  }
+  return 0;
+}
+
+static inline bool storeInt
+  (edgex_device_resultvalue *value, edgex_propertytype type, long long int result)
+{
+  switch (type)
+  {
+    case Uint8:
+      if (result >= 0 && result <= UCHAR_MAX)
+      {
+        value->ui8_result = (uint8_t)result;
+        return true;
+      }
+      break;
+    case Uint16:
+      if (result >= 0 && result <= USHRT_MAX)
+      {
+        value->ui16_result = (uint16_t)result;
+        return true;
+      }
+      break;
+    case Uint32:
+      if (result >= 0 && result <= UINT_MAX)
+      {
+        value->ui32_result = (uint32_t)result;
+        return true;
+      }
+      break;
+    case Uint64:
+      if (result >= 0 && result <= ULLONG_MAX)
+      {
+        value->ui64_result = (uint64_t)result;
+        return true;
+      }
+      break;
+    case Int8:
+      if (result >= SCHAR_MIN && result <= SCHAR_MAX)
+      {
+        value->i8_result = (int8_t)result;
+        return true;
+      }
+      break;
+    case Int16:
+      if (result >= SHRT_MIN && result <= SHRT_MAX)
+      {
+        value->i16_result = (int16_t)result;
+        return true;
+      }
+      break;
+    case Int32:
+      if (result >= INT_MIN && result <= INT_MAX)
+      {
+        value->i32_result = (int32_t)result;
+        return true;
+      }
+      break;
+    case Int64:
+      value->i64_result = (int64_t)result;
+      return true;
+    default:
+      assert (0);
+  }
+  return false;
+}
+
+bool edgex_transform_value
+  (edgex_device_resultvalue *value, const edgex_propertyvalue *props)
+{
+  if (props->type == Float64 || props->type == Float32)
+  {
+    long double result =
+      (props->type == Float64) ? value->f64_result : value->f32_result;
+    if (props->base.enabled) result = powl (props->base.value.dval, result);
+    if (props->scale.enabled) result *= props->scale.value.dval;
+    if (props->offset.enabled) result += props->offset.value.dval;
+    if (props->type == Float64)
+    {
+      if (result <= DBL_MAX && result >= -DBL_MAX)
+      {
+        value->f64_result = (double)result;
+        return true;
+      }
+      return false;
+    }
+    else
+    {
+      if (result <= FLT_MAX && result >= -FLT_MAX)
+      {
+        value->f32_result = (float)result;
+        return true;
+      }
+      return false;
+    }
+  }
+  else
+  {
+    long long int result = loadInt (value, props->type);
+    if (props->mask.enabled) result &= props->mask.value.ival;
+    if (props->shift.enabled)
+    {
+      if (props->shift.value.ival < 0)
+      {
+        result <<= -props->shift.value.ival;
+      }
+      else
+      {
+        result >>= props->shift.value.ival;
+      }
+    }
+    if (props->base.enabled) result = powl (props->base.value.ival, result);
+    if (props->scale.enabled) result *= props->scale.value.ival;
+    if (props->offset.enabled) result += props->offset.value.ival;
+    return storeInt (value, props->type, result);
+  }
+}
+
+/*
+ * Specialised kernels. Each applies one fixed combination of transforms to
+ * one type, so that with the type and transforms known at compile time the
+ * loads, stores and tests of the enabled flags are all folded away. The
+ * arithmetic, and so the result, is that of edgex_transform_value. Profiles
+ * with a base transform (which needs powl) use edgex_transform_value itself.
+ */
+
+#define XF_MASK 1
+#define XF_SHL 2
+#define XF_SHR 4
+#define XF_SCALE 8
+#define XF_OFFSET 16
+#define XF_OPS 32
+
+#define XF_GENERIC 1
+#define XF_INDEX(T, OPS) (2 + ((T) - Uint8) * XF_OPS + (OPS))
+
+static inline __attribute__ ((always_inline)) bool xformInt
+(
+  edgex_device_resultvalue *value,
+  const edgex_propertyvalue *props,
+  edgex_propertytype type,
+  unsigned ops
+)
+{
+  long long int result = loadInt (value, type);
+  if (ops & XF_MASK) result &= props->mask.value.ival;
+  if (ops & XF_SHL) result <<= -props->shift.value.ival;
+  if (ops & XF_SHR) result >>= props->shift.value.ival;
+  if (ops & XF_SCALE) result *= props->scale.value.ival;
+  if (ops & XF_OFFSET) result += props->offset.value.ival;
+  return storeInt (value, type, result);
+}
+
+static inline __attribute__ ((always_inline)) bool xformFloat
+(
+  edgex_device_resultvalue *value,
+  const edgex_propertyvalue *props,
+  edgex_propertytype type,
+  unsigned ops
+)
+{
+  long double result =
+    (type == Float64) ? value->f64_result : value->f32_result;
+  if (ops & XF_SCALE) result *= props->scale.value.dval;
+  if (ops & XF_OFFSET) result += props->offset.value.dval;
+  if (type == Float64)
+  {
+    if (result <= DBL_MAX && result >= -DBL_MAX)
+    {
+      value->f64_result = (double)result;
+      return true;
+    }
+  }
+  else if (result <= FLT_MAX && result >= -FLT_MAX)
+  {
+    value->f32_result = (float)result;
+    return true;
+  }
+  return false;
+}
+
+/* The combinations of transforms valid for each integer and float type */
+
+#define XF_INT_OPS(M, T) \
+  M (T, 1) M (T, 2) M (T, 3) M (T, 4) M (T, 5) M (T, 8) M (T, 9) \
+  M (T, 10) M (T, 11) M (T, 12) M (T, 13) M (T, 16) M (T, 17) M (T, 18) \
+  M (T, 19) M (T, 20) M (T, 21) M (T, 24) M (T, 25) M (T, 26) M (T, 27) \
+  M (T, 28) M (T, 29)
+
+#define XF_FLOAT_OPS(M, T) M (T, 8) M (T, 16) M (T, 24)
+
+#define XF_INT_KERNEL(T, OPS) \
+  static bool xf_##T##_##OPS \
+    (edgex_device_resultvalue *value, const edgex_propertyvalue *props) \
+  { \
+    return xformInt (value, props, T, OPS); \
+  }
+
+#define XF_FLOAT_KERNEL(T, OPS) \
+  static bool xf_##T##_##OPS \
+    (edgex_device_resultvalue *value, const edgex_propertyvalue *props) \
+  { \
+    return xformFloat (value, props, T, OPS); \
+  }
+
+#define XF_ENTRY(T, OPS) [XF_INDEX (T, OPS)] = xf_##T##_##OPS,
+
+XF_INT_OPS (XF_INT_KERNEL, Uint8)
+XF_INT_OPS (XF_INT_KERNEL, Uint16)
+XF_INT_OPS (XF_INT_KERNEL, Uint32)
+XF_INT_OPS (XF_INT_KERNEL, Uint64)
+XF_INT_OPS (XF_INT_KERNEL, Int8)
+XF_INT_OPS (XF_INT_KERNEL, Int16)
+XF_INT_OPS (XF_INT_KERNEL, Int32)
+XF_INT_OPS (XF_INT_KERNEL, Int64)
+XF_FLOAT_OPS (XF_FLOAT_KERNEL, Float32)
+XF_FLOAT_OPS (XF_FLOAT_KERNEL, Float64)
+
+static bool xf_identity
+  (edgex_device_resultvalue *value, const edgex_propertyvalue *props)
+{
+  return true;
+}
+
+const edgex_transform_kernel edgex_transform_kernels[EDGEX_TRANSFORM_KERNELS] =
+{
+  [0] = xf_identity,
+  [XF_GENERIC] = edgex_transform_value,
+  XF_INT_OPS (XF_ENTRY, Uint8)
+  XF_INT_OPS (XF_ENTRY, Uint16)
+  XF_INT_OPS (XF_ENTRY, Uint32)
+  XF_INT_OPS (XF_ENTRY, Uint64)
+  XF_INT_OPS (XF_ENTRY, Int8)
+  XF_INT_OPS (XF_ENTRY, Int16)
+  XF_INT_OPS (XF_ENTRY, Int32)
+  XF_INT_OPS (XF_ENTRY, Int64)
+  XF_FLOAT_OPS (XF_ENTRY, Float32)
+  XF_FLOAT_OPS (XF_ENTRY, Float64)
+};
+
+void edgex_transform_select (edgex_propertyvalue *props)
+{
+  unsigned ops = 0;
+  bool isFloat = (props->type == Float32 || props->type == Float64);
+
+  if (!edgex_transform_enabled (props))
+  {
+    props->xform = 0;
+    return;
+  }
+  if
+  (
+    props->base.enabled ||
+    (isFloat && (props->mask.enabled || props->shift.enabled))
+  )
+  {
+    props->xform = XF_GENERIC;
+    return;
+  }
+  if (props->mask.enabled)
+  {
+    ops |= XF_MASK;
+  }
+  if (props->shift.enabled)
+  {
+    ops |= (props->shift.value.ival < 0) ? XF_SHL : XF_SHR;
+  }
+  if (props->scale.enabled)
+  {
+    ops |= XF_SCALE;
+  }
+  if (props->offset.enabled)
+  {
+    ops |= XF_OFFSET;
+  }
+  props->xform = XF_INDEX (props->type, ops);
+}
+
+static bool sameArg (const edgex_transformArg *a, const edgex_transformArg *b)
+{
+  return a->enabled == b->enabled &&
+    (!a->enabled || a->value.ival == b->value.ival);
+}
+
+/* True if two properties specify the same type and transforms */
+
+static bool sameTransform
+  (const edgex_propertyvalue *a, const edgex_propertyvalue *b)
+{
+  return a == b ||
+  (
+    a->type == b->type && sameArg (&a->mask, &b->mask) &&
+    sameArg (&a->shift, &b->shift) && sameArg (&a->base, &b->base) &&
+    sameArg (&a->scale, &b->scale) && sameArg (&a->offset, &b->offset)
+  );
+}
+
+/*
+ * The kernels below apply each enabled transform as a separate pass over the
+ * chunk, so that every loop body is branch-free and may be vectorized.
+ */
+
+static void transformInts
+(
+  const edgex_propertyvalue *props,
+  uint32_t n,
+  edgex_device_resultvalue *values,
+  bool *ok
+)
+{
+  long long int v[XFORM_CHUNK];
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    v[i] = loadInt (&values[i], props->type);
+  }
+  if (props->mask.enabled)
+  {
+    long long int mask = props->mask.value.ival;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] &= mask;
+    }
+  }
+  if (props->shift.enabled)
+  {
+    long long int shift = props->shift.value.ival;
+    if (shift < 0)
+    {
+      for (uint32_t i = 0; i < n; i++)
+      {
+        v[i] <<= -shift;
+      }
+    }
+    else
+    {
+      for (uint32_t i = 0; i < n; i++)
+      {
+        v[i] >>= shift;
+      }
+    }
+  }
+  if (props->base.enabled)
+  {
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] = powl (props->base.value.ival, v[i]);
+    }
+  }
+  if (props->scale.enabled)
+  {
+    long long int scale = props->scale.value.ival;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] *= scale;
+    }
+  }
+  if (props->offset.enabled)
+  {
+    long long int offset = props->offset.value.ival;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] += offset;
+    }
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    ok[i] = storeInt (&values[i], props->type, v[i]);
+  }
+}
+
+static void transformFloats
+(
+  const edgex_propertyvalue *props,
+  uint32_t n,
+  edgex_device_resultvalue *values,
+  bool *ok
+)
+{
+  double v[XFORM_CHUNK];
+  bool f64 = (props->type == Float64);
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    v[i] = f64 ? values[i].f64_result : values[i].f32_result;
+  }
+  if (props->base.enabled)
+  {
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] = pow (props->base.value.dval, v[i]);
+    }
+  }
+  if (props->scale.enabled)
+  {
+    double scale = props->scale.value.dval;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] *= scale;
+    }
+  }
+  if (props->offset.enabled)
+  {
+    double offset = props->offset.value.dval;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      v[i] += offset;
+    }
+  }
+  double max = f64 ? DBL_MAX : FLT_MAX;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    ok[i] = (v[i] <= max && v[i] >= -max);
+    if (ok[i])
+    {
+      if (f64)
+      {
+        values[i].f64_result = v[i];
+      }
+      else
+      {
+        values[i].f32_result = (float)v[i];
+      }
+    }
+  }
+}
+
+void edgex_transform_batch
+(
+  uint32_t n,
+  const edgex_device_commandrequest *reqs,
+  edgex_device_resultvalue *values,
+  bool *ok
+)
+{
+  uint32_t i = 0;
+  while (i < n)
+  {
+    const edgex_propertyvalue *props = reqs[i].devobj->properties->value;
+    if (!edgex_transform_enabled (props))
+    {
+      ok[i++] = true;
+      continue;
+    }
+
+    uint32_t end = i + 1;
+    while
+    (
+      end < n && end - i < XFORM_CHUNK &&
+      sameTransform (props, reqs[end].devobj->properties->value)
+    )
+    {
+      end++;
+    }
+
+    if (props->type == Float32 || props->type == Float64)
+    {
+      transformFloats (props, end - i, values + i, ok + i);
+    }
+    else
+    {
+      transformInts (props, end - i, values + i, ok + i);
+    }
+    i = end;
+  }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_TRANSFORM_H_
+#define _EDGEX_DEVICE_TRANSFORM_H_ 1
+
+#include "edgex/devsdk.h"
+
+/* True if the property specifies any transform of numeric values */
+
+extern bool edgex_transform_enabled (const edgex_propertyvalue *props);
+
+/*
+ * Apply the mask, shift, base, scale and offset transforms specified by a
+ * property to a value. Returns false if the result overflows the type.
+ */
+
+extern bool edgex_transform_value
+  (edgex_device_resultvalue *value, const edgex_propertyvalue *props);
+
+/*
+ * Transform n values in place, each according to the properties of the
+ * corresponding request's device resource. Consecutive values which share a
+ * type and set of transforms are processed together, one transform at a time
+ * across the group. ok[i] is set false where the transformed value overflows.
+ * Integer results are identical to those of edgex_transform_value; floating
+ * point values are computed in double rather than long double precision.
+ */
+
+extern void edgex_transform_batch
+(
+  uint32_t n,
+  const edgex_device_commandrequest *reqs,
+  edgex_device_resultvalue *values,
+  bool *ok
+);
+
+/*
+ * A transform specialised for one type and combination of transforms,
+ * selected for each property when its profile is read and indexed by the
+ * property's xform field. Kernel 0 leaves the value unchanged.
+ */
+
+typedef bool (*edgex_transform_kernel)
+  (edgex_device_resultvalue *value, const edgex_propertyvalue *props);
+
+#define EDGEX_TRANSFORM_KERNELS 322
+
+extern const edgex_transform_kernel edgex_transform_kernels[];
+
+/* Set props->xform to the kernel for the property's type and transforms */
+
+extern void edgex_transform_select (edgex_propertyvalue *props);
+
+#endif
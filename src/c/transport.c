@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "transport.h"
+#include "service.h"
+#include "mqtt.h"
+#include "errorlist.h"
+
+#include <stdlib.h>
+#include <strings.h>
+
+#define DEFAULT_PUBLISH_TIMEOUT 5000
+
+static void mqtt_publish
+(
+  void *impl,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding,
+  edgex_error *err
+)
+{
+  *err = edgex_mqtt_publish ((edgex_mqtt *) impl, event, size) ?
+    EDGEX_OK : EDGEX_REMOTE_SERVER_DOWN;
+}
+
+static void mqtt_metrics (void *impl, JSON_Object *obj)
+{
+  JSON_Value *qval = json_value_init_object ();
+  JSON_Object *qobj = json_value_get_object (qval);
+  edgex_mqtt_stats stats;
+
+  edgex_mqtt_getstats ((edgex_mqtt *) impl, &stats);
+  json_object_set_string (qobj, "Type", "MQTT");
+  json_object_set_boolean (qobj, "Connected", stats.connected);
+  json_object_set_number (qobj, "Published", stats.published);
+  json_object_set_number (qobj, "Acknowledged", stats.acked);
+  json_object_set_number (qobj, "InFlight", stats.inflight);
+  json_object_set_number (qobj, "Reconnects", stats.reconnects);
+  json_object_set_number (qobj, "Failures", stats.failures);
+  json_object_set_value (obj, "MessageQueue", qval);
+}
+
+static void mqtt_free (void *impl)
+{
+  edgex_mqtt_free ((edgex_mqtt *) impl);
+}
+
+edgex_transport *edgex_transport_create
+  (edgex_device_service *svc, edgex_error *err)
+{
+  const edgex_device_messagequeueinfo *conf = &svc->config.messagequeue;
+  edgex_transport *t = NULL;
+
+  *err = EDGEX_OK;
+  if (conf->type && strcasecmp (conf->type, "MQTT") == 0)
+  {
+    uint32_t timeout = svc->config.service.requesttimeout;
+    t = malloc (sizeof (edgex_transport));
+    t->name = "MQTT";
+    t->impl = edgex_mqtt_create
+    (
+      svc->logger, conf, svc->name,
+      timeout ? timeout : DEFAULT_PUBLISH_TIMEOUT
+    );
+    t->publish = mqtt_publish;
+    t->metrics = mqtt_metrics;
+    t->free = mqtt_free;
+    iot_log_info
+      (svc->logger, "Events will be published by MQTT to %s", conf->host);
+  }
+  return t;
+}
+
+void edgex_transport_free (edgex_transport *t)
+{
+  if (t)
+  {
+    t->free (t->impl);
+    free (t);
+  }
+}
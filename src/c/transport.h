@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_TRANSPORT_H_
+#define _EDGEX_DEVICE_TRANSPORT_H_ 1
+
+#include "edgex/devsdk.h"
+#include "data.h"
+#include "parson.h"
+
+/*
+ * Export transports. Events are normally submitted to core-data by HTTP
+ * POST, one request each. Given a [MessageQueue] section with a Type other
+ * than HTTP, edgex_data_client_add_event instead passes them, encoded as
+ * usual, to a transport which streams them over a persistent connection.
+ */
+
+typedef struct edgex_transport
+{
+  const char *name;
+  void *impl;
+
+  /* Send an event, setting err if it could not be accepted */
+
+  void (*publish)
+  (
+    void *impl,
+    const char *event,
+    size_t size,
+    edgex_event_encoding encoding,
+    edgex_error *err
+  );
+
+  /* Add statistics to a metrics object */
+
+  void (*metrics) (void *impl, JSON_Object *obj);
+
+  void (*free) (void *impl);
+} edgex_transport;
+
+/*
+ * Create the configured transport. Returns NULL with err EDGEX_OK if events
+ * are to be posted over HTTP.
+ */
+
+edgex_transport *edgex_transport_create
+  (edgex_device_service *svc, edgex_error *err);
+
+void edgex_transport_free (edgex_transport *t);
+
+#endif
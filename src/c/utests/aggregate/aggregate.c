@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "aggregate.h"
+#include "../src/c/aggregate.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static edgex_nvpairs attrs[3];
+static edgex_deviceresource res;
+
+static int suite_init (void)
+{
+  res.name = "Vibration";
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Configure the resource with attributes given as name, value pairs */
+
+static void configure (const char *stats, const char *window, const char *n)
+{
+  const char *names[] = { "aggregate", "aggregateWindow", "aggregateSamples" };
+  const char *values[] = { stats, window, n };
+  edgex_nvpairs **next = &res.attributes;
+
+  *next = NULL;
+  for (unsigned i = 0; i < 3; i++)
+  {
+    if (values[i])
+    {
+      attrs[i].name = (char *) names[i];
+      attrs[i].value = (char *) values[i];
+      attrs[i].next = NULL;
+      *next = &attrs[i];
+      next = &attrs[i].next;
+    }
+  }
+}
+
+static double stat (const edgex_aggregate_summary *sum, const char *name)
+{
+  for (uint32_t i = 0; i < sum->n; i++)
+  {
+    if (strcmp (sum->stats[i].name, name) == 0)
+    {
+      return sum->stats[i].value;
+    }
+  }
+  return NAN;
+}
+
+static edgex_aggregate_result add
+(
+  edgex_aggregator *a,
+  const char *device,
+  double value,
+  uint64_t origin,
+  edgex_aggregate_summary *sum
+)
+{
+  return edgex_aggregator_add (a, device, &res, value, origin, sum);
+}
+
+static void test_samples (void)
+{
+  edgex_aggregate_summary sum;
+  edgex_aggregator *a = edgex_aggregator_create (1);
+
+  configure ("count, min,max,mean,stddev", NULL, "4");
+  CU_ASSERT (edgex_aggregate_wanted (&res));
+  double v[] = { 2.0, 4.0, 4.0, 6.0, 10.0 };
+  for (unsigned i = 0; i < 3; i++)
+  {
+    CU_ASSERT (add (a, "dev", v[i], i, &sum) == EDGEX_AGG_HELD);
+  }
+  CU_ASSERT_FATAL (add (a, "dev", v[3], 3, &sum) == EDGEX_AGG_SUMMARY);
+  CU_ASSERT (sum.n == 5);
+  CU_ASSERT (sum.origin == 3);
+  CU_ASSERT (strcmp (sum.stats[0].name, "count") == 0);
+  CU_ASSERT (sum.stats[0].integer);
+  CU_ASSERT (stat (&sum, "count") == 4.0);
+  CU_ASSERT (stat (&sum, "min") == 2.0);
+  CU_ASSERT (stat (&sum, "max") == 6.0);
+  CU_ASSERT (stat (&sum, "mean") == 4.0);
+  CU_ASSERT (fabs (stat (&sum, "stddev") - sqrt (2.0)) < 1e-9);
+
+  /* The next window starts afresh */
+
+  CU_ASSERT (add (a, "dev", v[4], 4, &sum) == EDGEX_AGG_HELD);
+  for (unsigned i = 0; i < 3; i++)
+  {
+    add (a, "dev", 1.0, 5 + i, &sum);
+  }
+  CU_ASSERT (stat (&sum, "max") == 10.0);
+  CU_ASSERT (stat (&sum, "min") == 1.0);
+
+  edgex_aggregator_stats stats;
+  edgex_aggregator_getstats (a, &stats);
+  CU_ASSERT (stats.windows == 1);
+  CU_ASSERT (stats.samples == 8);
+  CU_ASSERT (stats.summaries == 2);
+  edgex_aggregator_free (a);
+}
+
+static void test_window (void)
+{
+  edgex_aggregate_summary sum;
+  edgex_aggregator *a = edgex_aggregator_create (1);
+
+  /* Windows of one second, aligned to whole seconds */
+
+  configure ("count,mean", "1s", NULL);
+  CU_ASSERT (add (a, "dev", 1.0, 10500, &sum) == EDGEX_AGG_HELD);
+  CU_ASSERT (add (a, "dev", 3.0, 10999, &sum) == EDGEX_AGG_HELD);
+  CU_ASSERT_FATAL (add (a, "dev", 7.0, 11000, &sum) == EDGEX_AGG_SUMMARY);
+  CU_ASSERT (stat (&sum, "count") == 2.0);
+  CU_ASSERT (stat (&sum, "mean") == 2.0);
+  CU_ASSERT (sum.origin == 10999);
+
+  /* The reading which completed the window begins the next */
+
+  CU_ASSERT_FATAL (add (a, "dev", 9.0, 13000, &sum) == EDGEX_AGG_SUMMARY);
+  CU_ASSERT (stat (&sum, "count") == 1.0);
+  CU_ASSERT (stat (&sum, "mean") == 7.0);
+
+  /* Windows are kept per device */
+
+  CU_ASSERT (add (a, "other", 5.0, 13001, &sum) == EDGEX_AGG_HELD);
+  edgex_aggregator_stats stats;
+  edgex_aggregator_getstats (a, &stats);
+  CU_ASSERT (stats.windows == 2);
+  edgex_aggregator_forget (a, "dev");
+  edgex_aggregator_getstats (a, &stats);
+  CU_ASSERT (stats.windows == 1);
+  CU_ASSERT (add (a, "dev", 1.0, 13500, &sum) == EDGEX_AGG_HELD);
+  edgex_aggregator_free (a);
+}
+
+static void test_percentiles (void)
+{
+  edgex_aggregate_summary sum;
+  edgex_aggregator *a = edgex_aggregator_create (1);
+
+  configure ("p50,p90,p100", NULL, "100");
+  edgex_aggregate_result r = EDGEX_AGG_HELD;
+  for (unsigned i = 100; i > 0; i--)
+  {
+    r = add (a, "dev", i, 0, &sum);
+  }
+  CU_ASSERT_FATAL (r == EDGEX_AGG_SUMMARY);
+  CU_ASSERT (stat (&sum, "p50") == 50.0);
+  CU_ASSERT (stat (&sum, "p90") == 90.0);
+  CU_ASSERT (stat (&sum, "p100") == 100.0);
+  edgex_aggregator_free (a);
+}
+
+static void test_config (void)
+{
+  edgex_aggregate_summary sum;
+  edgex_aggregator *a = edgex_aggregator_create (1);
+
+  configure (NULL, NULL, NULL);
+  CU_ASSERT (!edgex_aggregate_wanted (&res));
+  CU_ASSERT (add (a, "dev", 1.0, 0, &sum) == EDGEX_AGG_PASS);
+
+  /* Invalid configurations pass readings through */
+
+  const char *bad[][3] =
+  {
+    { "mean", NULL, NULL }, { "median", "1s", NULL }, { "p0", "1s", NULL },
+    { "p101", "1s", NULL }, { "mean", "1h", NULL }, { "mean", NULL, "1" },
+    { "mean", "-5", NULL }, { "", "1s", NULL }, { "mean,,max", "1s", NULL }
+  };
+  for (unsigned i = 0; i < sizeof (bad) / sizeof (bad[0]); i++)
+  {
+    configure (bad[i][0], bad[i][1], bad[i][2]);
+    CU_ASSERT (add (a, "dev", 1.0, 0, &sum) == EDGEX_AGG_PASS);
+  }
+
+  /* A change of configuration restarts the window */
+
+  configure ("count", NULL, "3");
+  add (a, "dev", 1.0, 0, &sum);
+  add (a, "dev", 1.0, 0, &sum);
+  configure ("count", NULL, "2");
+  CU_ASSERT (add (a, "dev", 1.0, 0, &sum) == EDGEX_AGG_HELD);
+  CU_ASSERT (add (a, "dev", 1.0, 0, &sum) == EDGEX_AGG_SUMMARY);
+  CU_ASSERT (stat (&sum, "count") == 2.0);
+  edgex_aggregator_free (a);
+}
+
+void cunit_aggregate_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("aggregate", suite_init, suite_clean);
+  CU_add_test (suite, "test_samples", test_samples);
+  CU_add_test (suite, "test_window", test_window);
+  CU_add_test (suite, "test_percentiles", test_percentiles);
+  CU_add_test (suite, "test_config", test_config);
+}
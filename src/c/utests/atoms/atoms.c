@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "atoms.h"
+#include "../src/c/atoms.h"
+#include "../src/c/map.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NATOMS 5000
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void test_shared (void)
+{
+  char name[] = "Temperature";
+  char *a1 = edgex_atom (name);
+  char *a2 = edgex_atom ("Temperature");
+  char *a3 = edgex_atom (a1);
+  char *b = edgex_atom ("Humidity");
+
+  CU_ASSERT (a1 != name);
+  CU_ASSERT (strcmp (a1, name) == 0);
+  CU_ASSERT (a1 == a2);
+  CU_ASSERT (a1 == a3);
+  CU_ASSERT (a1 != b);
+  CU_ASSERT (edgex_atom_hash (a1) == edgex_map_hash (name));
+  CU_ASSERT (edgex_atom_hash (b) == edgex_map_hash ("Humidity"));
+
+  edgex_atom_free (a1);
+  edgex_atom_free (a2);
+  CU_ASSERT (strcmp (a3, "Temperature") == 0);
+  edgex_atom_free (a3);
+  edgex_atom_free (b);
+}
+
+static void test_not_atom (void)
+{
+  char *a = edgex_atom ("RW");
+  char *copy = strdup ("RW");
+
+  /* A string with the same content is freed, not taken as the atom */
+  edgex_atom_free (copy);
+  CU_ASSERT (strcmp (a, "RW") == 0);
+  CU_ASSERT (edgex_atom ("RW") == a);
+  edgex_atom_free (a);
+  edgex_atom_free (a);
+  edgex_atom_free (NULL);
+}
+
+static void test_many (void)
+{
+  char name[32];
+  char **atoms = malloc (NATOMS * sizeof (char *));
+  bool ok = true;
+
+  for (unsigned i = 0; i < NATOMS; i++)
+  {
+    sprintf (name, "device-%u", i);
+    atoms[i] = edgex_atom (name);
+  }
+
+  /* Release every other atom, those remaining must still be found */
+
+  for (unsigned i = 0; i < NATOMS; i += 2)
+  {
+    edgex_atom_free (atoms[i]);
+  }
+  for (unsigned i = 1; i < NATOMS; i += 2)
+  {
+    sprintf (name, "device-%u", i);
+    char *again = edgex_atom (name);
+    ok = ok && (again == atoms[i]);
+    edgex_atom_free (again);
+  }
+  CU_ASSERT (ok);
+
+  ok = true;
+  for (unsigned i = 0; i < NATOMS; i += 2)
+  {
+    sprintf (name, "device-%u", i);
+    atoms[i] = edgex_atom (name);
+    ok = ok && (strcmp (atoms[i], name) == 0);
+  }
+  for (unsigned i = 0; i < NATOMS; i++)
+  {
+    sprintf (name, "device-%u", i);
+    ok = ok && (strcmp (atoms[i], name) == 0);
+    edgex_atom_free (atoms[i]);
+  }
+  CU_ASSERT (ok);
+  free (atoms);
+}
+
+void cunit_atoms_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("atoms", suite_init, suite_clean);
+  CU_add_test (suite, "test_shared", test_shared);
+  CU_add_test (suite, "test_not_atom", test_not_atom);
+  CU_add_test (suite, "test_many", test_many);
+}
@@ -39,8 +39,122 @@ static void test_rtrip1 (void)
   }
 }
 
+/* Sizes either side of the block sizes of the vector kernels */
+
+static void test_rtrip_sizes (void)
+{
+  uint8_t input[1100];
+  char encoded[1500];
+  uint8_t decoded[1100];
+  size_t outlen;
+
+  for (size_t i = 0; i < sizeof (input); i++)
+  {
+    input[i] = (i * 7919) >> 3;
+  }
+  for (size_t size = 0; size <= sizeof (input); size++)
+  {
+    CU_ASSERT (edgex_b64_encode (input, size, encoded, sizeof (encoded)));
+    CU_ASSERT (strlen (encoded) + 1 == edgex_b64_encodesize (size));
+    outlen = edgex_b64_maxdecodesize (encoded);
+    CU_ASSERT (edgex_b64_decode (encoded, decoded, &outlen));
+    CU_ASSERT (size == outlen);
+    CU_ASSERT (memcmp (input, decoded, size) == 0);
+  }
+}
+
+static void test_known (void)
+{
+  const char *text = "The quick brown fox jumps over the lazy dog. 0123456789?";
+  const char *expected =
+    "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4gMDEyMzQ1Njc4OT8=";
+  char encoded[100];
+  char decoded[100];
+  size_t outlen = sizeof (decoded);
+
+  CU_ASSERT (edgex_b64_encode (text, strlen (text), encoded, sizeof (encoded)));
+  CU_ASSERT (strcmp (encoded, expected) == 0);
+  CU_ASSERT (edgex_b64_decode (expected, decoded, &outlen));
+  CU_ASSERT (outlen == strlen (text));
+  CU_ASSERT (strncmp (decoded, text, outlen) == 0);
+}
+
+static void test_whitespace (void)
+{
+  uint8_t input[300];
+  char encoded[500];
+  char wrapped[600];
+  uint8_t decoded[300];
+  size_t outlen = sizeof (decoded);
+  size_t j = 0;
+
+  for (size_t i = 0; i < sizeof (input); i++)
+  {
+    input[i] = i;
+  }
+  edgex_b64_encode (input, sizeof (input), encoded, sizeof (encoded));
+  for (size_t i = 0; encoded[i]; i++)
+  {
+    if (i && i % 76 == 0)
+    {
+      wrapped[j++] = '\n';
+    }
+    wrapped[j++] = encoded[i];
+  }
+  wrapped[j] = '\0';
+  CU_ASSERT (edgex_b64_decode (wrapped, decoded, &outlen));
+  CU_ASSERT (outlen == sizeof (input));
+  CU_ASSERT (memcmp (input, decoded, outlen) == 0);
+}
+
+static void test_invalid (void)
+{
+  char encoded[129];
+  uint8_t decoded[96];
+  size_t outlen;
+
+  for (size_t pos = 0; pos < 128; pos++)
+  {
+    memset (encoded, 'A', 128);
+    encoded[128] = '\0';
+    encoded[pos] = (pos % 2) ? '*' : '\x80';
+    outlen = sizeof (decoded);
+    CU_ASSERT (!edgex_b64_decode (encoded, decoded, &outlen));
+  }
+}
+
+static void test_overflow (void)
+{
+  char encoded[129];
+  uint8_t decoded[96];
+  size_t outlen = sizeof (decoded) - 1;
+
+  memset (encoded, 'A', 128);
+  encoded[128] = '\0';
+  CU_ASSERT (!edgex_b64_decode (encoded, decoded, &outlen));
+}
+
+static void test_append (void)
+{
+  edgex_strbuf buf;
+
+  edgex_strbuf_init (&buf);
+  edgex_strbuf_appendchar (&buf, '"');
+  edgex_b64_encode_append (&buf, "hello", 5);
+  edgex_strbuf_appendchar (&buf, '"');
+  CU_ASSERT (strcmp (buf.data, "\"aGVsbG8=\"") == 0);
+  CU_ASSERT (buf.len == 10);
+  edgex_strbuf_fini (&buf);
+}
+
 void cunit_base64_test_init (void)
 {
   CU_pSuite suite = CU_add_suite ("base64", suite_init, suite_clean);
   CU_add_test (suite, "test_rtrip1", test_rtrip1);
+  CU_add_test (suite, "test_rtrip_sizes", test_rtrip_sizes);
+  CU_add_test (suite, "test_known", test_known);
+  CU_add_test (suite, "test_whitespace", test_whitespace);
+  CU_add_test (suite, "test_invalid", test_invalid);
+  CU_add_test (suite, "test_overflow", test_overflow);
+  CU_add_test (suite, "test_append", test_append);
 }
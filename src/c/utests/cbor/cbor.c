@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "cbor.h"
+#include "../src/c/cbor.h"
+
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static bool encoded (edgex_strbuf *b, const char *expect, size_t len)
+{
+  bool result = (b->len == len && memcmp (b->data, expect, len) == 0);
+  b->len = 0;
+  return result;
+}
+
+/* Examples are from RFC 7049 appendix A */
+
+static void test_uint (void)
+{
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  edgex_cbor_uint (&b, 0);
+  CU_ASSERT (encoded (&b, "\x00", 1));
+  edgex_cbor_uint (&b, 23);
+  CU_ASSERT (encoded (&b, "\x17", 1));
+  edgex_cbor_uint (&b, 24);
+  CU_ASSERT (encoded (&b, "\x18\x18", 2));
+  edgex_cbor_uint (&b, 1000);
+  CU_ASSERT (encoded (&b, "\x19\x03\xe8", 3));
+  edgex_cbor_uint (&b, 1000000);
+  CU_ASSERT (encoded (&b, "\x1a\x00\x0f\x42\x40", 5));
+  edgex_cbor_uint (&b, 1000000000000);
+  CU_ASSERT (encoded (&b, "\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00", 9));
+  edgex_cbor_uint (&b, UINT64_MAX);
+  CU_ASSERT (encoded (&b, "\x1b\xff\xff\xff\xff\xff\xff\xff\xff", 9));
+  edgex_strbuf_fini (&b);
+}
+
+static void test_strings (void)
+{
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  edgex_cbor_text (&b, "");
+  CU_ASSERT (encoded (&b, "\x60", 1));
+  edgex_cbor_text (&b, "IETF");
+  CU_ASSERT (encoded (&b, "\x64IETF", 5));
+  edgex_cbor_bytes (&b, (const uint8_t *) "\x01\x02\x03\x04", 4);
+  CU_ASSERT (encoded (&b, "\x44\x01\x02\x03\x04", 5));
+  edgex_cbor_bytes (&b, (const uint8_t *) "\0\0", 2);
+  CU_ASSERT (encoded (&b, "\x42\0\0", 3));
+  edgex_strbuf_fini (&b);
+}
+
+static void test_containers (void)
+{
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  edgex_cbor_map (&b, 1);
+  edgex_cbor_text (&b, "a");
+  edgex_cbor_array_open (&b);
+  edgex_cbor_uint (&b, 1);
+  edgex_cbor_uint (&b, 2);
+  edgex_cbor_break (&b);
+  CU_ASSERT (encoded (&b, "\xa1\x61\x61\x9f\x01\x02\xff", 7));
+  edgex_strbuf_fini (&b);
+}
+
+static void test_read (void)
+{
+  edgex_strbuf b;
+  uint64_t n;
+  const char *s;
+  size_t len;
+
+  edgex_strbuf_init (&b);
+  edgex_cbor_map (&b, 2);
+  edgex_cbor_text (&b, "origin");
+  edgex_cbor_uint (&b, 1559034050000);
+  edgex_cbor_text (&b, "readings");
+  edgex_cbor_array_open (&b);
+
+  edgex_cbor_reader r = { (const uint8_t *) b.data, b.len, 0 };
+  CU_ASSERT (!edgex_cbor_read_uint (&r, &n));
+  CU_ASSERT (edgex_cbor_read_map (&r, &n) && n == 2);
+  CU_ASSERT (edgex_cbor_read_text (&r, &s, &len));
+  CU_ASSERT (len == 6 && memcmp (s, "origin", 6) == 0);
+  CU_ASSERT (edgex_cbor_read_uint (&r, &n) && n == 1559034050000);
+  CU_ASSERT (edgex_cbor_read_text (&r, &s, &len) && len == 8);
+  CU_ASSERT (edgex_cbor_read_array_open (&r));
+  CU_ASSERT (r.pos == b.len);
+  CU_ASSERT (!edgex_cbor_read_map (&r, &n));
+
+  /* Truncated text */
+
+  edgex_cbor_reader t = { (const uint8_t *) "\x64IE", 3, 0 };
+  CU_ASSERT (!edgex_cbor_read_text (&t, &s, &len));
+  CU_ASSERT (t.pos == 0);
+  edgex_strbuf_fini (&b);
+}
+
+void cunit_cbor_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("cbor", suite_init, suite_clean);
+  CU_add_test (suite, "test_uint", test_uint);
+  CU_add_test (suite, "test_strings", test_strings);
+  CU_add_test (suite, "test_containers", test_containers);
+  CU_add_test (suite, "test_read", test_read);
+}
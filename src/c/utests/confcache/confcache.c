@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "confcache.h"
+#include "../src/c/confcache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char path[64];
+
+static int suite_init (void)
+{
+  snprintf (path, sizeof (path), "/tmp/confcache-test-%d", (int) getpid ());
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  unlink (path);
+  return 0;
+}
+
+static void write_sample (uint64_t hash)
+{
+  edgex_confcache_writer w;
+  const char *pair[] = { "Service/Host", "localhost" };
+  const char *nulls[] = { "Watcher", NULL, "", NULL };
+
+  edgex_confcache_writer_init (&w);
+  edgex_confcache_add (&w, 1, 2, pair);
+  edgex_confcache_add (&w, 2, 4, nulls);
+  edgex_confcache_add (&w, 3, 0, NULL);
+  CU_ASSERT (edgex_confcache_write (&w, path, hash));
+}
+
+static void test_hash (void)
+{
+  uint64_t h = edgex_confcache_hash (EDGEX_CONFCACHE_HASH_INIT, "", 0);
+  CU_ASSERT (h == EDGEX_CONFCACHE_HASH_INIT);
+  h = edgex_confcache_hash (EDGEX_CONFCACHE_HASH_INIT, "a", 1);
+  CU_ASSERT (h == 0xaf63dc4c8601ec8cULL);
+  h = edgex_confcache_hash (h, "bc", 2);
+  CU_ASSERT (h == edgex_confcache_hash (EDGEX_CONFCACHE_HASH_INIT, "abc", 3));
+}
+
+static void test_roundtrip (void)
+{
+  edgex_confcache c;
+  const char *strs[4];
+  uint32_t kind;
+  unsigned n;
+
+  write_sample (42);
+  CU_ASSERT_FATAL (edgex_confcache_open (&c, path, 42));
+
+  CU_ASSERT (edgex_confcache_next (&c, &kind, &n, strs, 4));
+  CU_ASSERT (kind == 1 && n == 2);
+  CU_ASSERT (strcmp (strs[0], "Service/Host") == 0);
+  CU_ASSERT (strcmp (strs[1], "localhost") == 0);
+
+  CU_ASSERT (edgex_confcache_next (&c, &kind, &n, strs, 4));
+  CU_ASSERT (kind == 2 && n == 4);
+  CU_ASSERT (strcmp (strs[0], "Watcher") == 0);
+  CU_ASSERT (strs[1] == NULL && strs[3] == NULL);
+  CU_ASSERT (strs[2] && *strs[2] == '\0');
+
+  CU_ASSERT (edgex_confcache_next (&c, &kind, &n, strs, 1));
+  CU_ASSERT (kind == 3 && n == 0);
+
+  CU_ASSERT (!edgex_confcache_next (&c, &kind, &n, strs, 4));
+  edgex_confcache_close (&c);
+
+  /* A record with more strings than the caller has room for */
+
+  CU_ASSERT_FATAL (edgex_confcache_open (&c, path, 42));
+  CU_ASSERT (edgex_confcache_next (&c, &kind, &n, strs, 1));
+  CU_ASSERT (n == 1 && strcmp (strs[0], "Service/Host") == 0);
+  CU_ASSERT (edgex_confcache_next (&c, &kind, &n, strs, 1));
+  CU_ASSERT (kind == 2 && n == 1);
+  edgex_confcache_close (&c);
+}
+
+static void test_invalid (void)
+{
+  edgex_confcache c;
+  FILE *fp;
+  char buf[256];
+  size_t len;
+
+  write_sample (42);
+  CU_ASSERT (!edgex_confcache_open (&c, path, 43));
+  CU_ASSERT (!edgex_confcache_open (&c, "/nonexistent/confcache", 42));
+
+  fp = fopen (path, "rb");
+  len = fread (buf, 1, sizeof (buf), fp);
+  fclose (fp);
+
+  /* Truncated, and with a corrupted string terminator */
+
+  fp = fopen (path, "wb");
+  fwrite (buf, 1, len - 1, fp);
+  fclose (fp);
+  CU_ASSERT (!edgex_confcache_open (&c, path, 42));
+
+  char *term = memchr (buf + 40, '\0', len - 40);
+  CU_ASSERT_FATAL (term != NULL);
+  *term = 'x';
+  fp = fopen (path, "wb");
+  fwrite (buf, 1, len, fp);
+  fclose (fp);
+  CU_ASSERT (!edgex_confcache_open (&c, path, 42));
+}
+
+void cunit_confcache_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("confcache", suite_init, suite_clean);
+  CU_add_test (suite, "test_hash", test_hash);
+  CU_add_test (suite, "test_roundtrip", test_roundtrip);
+  CU_add_test (suite, "test_invalid", test_invalid);
+}
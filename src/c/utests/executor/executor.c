@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "executor.h"
+#include "../src/c/executor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static unsigned counter;
+static unsigned active;
+static unsigned maxactive;
+static unsigned slowdone;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void count (void *arg)
+{
+  __atomic_fetch_add (&counter, 1, __ATOMIC_RELAXED);
+}
+
+static void slow (void *arg)
+{
+  unsigned now = __atomic_add_fetch (&active, 1, __ATOMIC_SEQ_CST);
+  unsigned max = __atomic_load_n (&maxactive, __ATOMIC_SEQ_CST);
+  while (now > max &&
+    !__atomic_compare_exchange_n
+      (&maxactive, &max, now, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+  usleep (10000);
+  __atomic_sub_fetch (&active, 1, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch (&slowdone, 1, __ATOMIC_SEQ_CST);
+}
+
+static void spawn (void *arg)
+{
+  edgex_executor *ex = (edgex_executor *) arg;
+  for (int i = 0; i < 10; i++)
+  {
+    edgex_executor_submit (ex, EDGEX_EXEC_COMMAND, count, NULL);
+  }
+}
+
+static void test_run (void)
+{
+  edgex_executor *ex = edgex_executor_create (4, NULL, NULL, 0);
+  counter = 0;
+  for (int i = 0; i < 1000; i++)
+  {
+    edgex_executor_submit (ex, EDGEX_EXEC_COMMAND, count, NULL);
+  }
+  edgex_executor_wait (ex);
+  CU_ASSERT (counter == 1000);
+  edgex_executor_free (ex);
+}
+
+static void test_nested (void)
+{
+  edgex_executor *ex = edgex_executor_create (4, NULL, NULL, 0);
+  counter = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    edgex_executor_submit (ex, EDGEX_EXEC_COMMAND, spawn, ex);
+  }
+  edgex_executor_free (ex);
+  CU_ASSERT (counter == 1000);
+}
+
+static void test_limit (void)
+{
+  unsigned limits[EDGEX_EXEC_NCLASSES] = { 0, 1 };
+  edgex_executor *ex = edgex_executor_create (4, limits, NULL, 0);
+  counter = 0;
+  maxactive = 0;
+  slowdone = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    edgex_executor_submit (ex, EDGEX_EXEC_DISCOVERY, slow, NULL);
+  }
+
+  /* Commands are not held up by the queued discovery tasks */
+
+  for (int i = 0; i < 100; i++)
+  {
+    edgex_executor_submit (ex, EDGEX_EXEC_COMMAND, count, NULL);
+  }
+  for (int i = 0; i < 50 && __atomic_load_n (&counter, __ATOMIC_SEQ_CST) < 100; i++)
+  {
+    usleep (1000);
+  }
+  CU_ASSERT (__atomic_load_n (&counter, __ATOMIC_SEQ_CST) == 100);
+  CU_ASSERT (__atomic_load_n (&slowdone, __ATOMIC_SEQ_CST) < 8);
+  edgex_executor_wait (ex);
+  CU_ASSERT (maxactive == 1);
+  edgex_executor_free (ex);
+}
+
+static unsigned seen[100];
+
+static void mark (void *arg, unsigned i)
+{
+  __atomic_add_fetch (&seen[i], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&counter, 1, __ATOMIC_RELAXED);
+}
+
+static void forall (void *arg)
+{
+  edgex_executor_forall
+    ((edgex_executor *) arg, EDGEX_EXEC_COMMAND, 100, 4, mark, NULL);
+}
+
+static void test_forall (void)
+{
+  edgex_executor *ex = edgex_executor_create (4, NULL, NULL, 0);
+  counter = 0;
+  memset (seen, 0, sizeof (seen));
+  forall (ex);
+  CU_ASSERT (counter == 100);
+  for (int i = 0; i < 100; i++)
+  {
+    CU_ASSERT (seen[i] == 1);
+  }
+  edgex_executor_free (ex);
+
+  /* Within a task on a single worker, the caller makes every call */
+
+  ex = edgex_executor_create (1, NULL, NULL, 0);
+  counter = 0;
+  memset (seen, 0, sizeof (seen));
+  edgex_executor_submit (ex, EDGEX_EXEC_DISCOVERY, forall, ex);
+  edgex_executor_wait (ex);
+  CU_ASSERT (counter == 100);
+  edgex_executor_free (ex);
+}
+
+void cunit_executor_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("executor", suite_init, suite_clean);
+  CU_add_test (suite, "test_run", test_run);
+  CU_add_test (suite, "test_nested", test_nested);
+  CU_add_test (suite, "test_limit", test_limit);
+  CU_add_test (suite, "test_forall", test_forall);
+}
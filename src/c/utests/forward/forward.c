@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "forward.h"
+#include "../src/c/forward.h"
+#include "../src/c/service.h"
+#include "../src/c/transport.h"
+#include "../src/c/errorlist.h"
+#include "../src/c/wal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define FW_MAXPOSTS 16
+
+static char dir[PATH_MAX];
+
+/*
+ * A transport which records the events given to it, rejecting any which
+ * begin with 'x'.
+ */
+
+static char posted[FW_MAXPOSTS][16];
+static unsigned nposts;
+static pthread_mutex_t postlock = PTHREAD_MUTEX_INITIALIZER;
+
+static void clear_dir (void)
+{
+  char path[PATH_MAX];
+  struct dirent *ent;
+  DIR *d = opendir (dir);
+  if (d)
+  {
+    while ((ent = readdir (d)))
+    {
+      if (ent->d_name[0] != '.')
+      {
+        snprintf (path, sizeof (path), "%s/%s", dir, ent->d_name);
+        unlink (path);
+      }
+    }
+    closedir (d);
+  }
+}
+
+static int suite_init (void)
+{
+  snprintf (dir, sizeof (dir), "/tmp/forward-test-%d", (int) getpid ());
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  clear_dir ();
+  rmdir (dir);
+  return 0;
+}
+
+static void fw_publish
+(
+  void *impl,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding,
+  edgex_error *err
+)
+{
+  pthread_mutex_lock (&postlock);
+  if (nposts < FW_MAXPOSTS)
+  {
+    snprintf (posted[nposts], 16, "%.*s", (int) size, event);
+  }
+  nposts++;
+  pthread_mutex_unlock (&postlock);
+  if (size && event[0] == 'x')
+  {
+    *err = EDGEX_EVENT_REJECTED;
+  }
+}
+
+/* Read a number from the log's metrics */
+
+static double fw_metric (edgex_forward *f, const char *name)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  edgex_forward_metrics (f, obj);
+  double result = json_object_dotget_number (obj, name);
+  json_value_free (val);
+  return result;
+}
+
+static void test_rejected (void)
+{
+  edgex_device_service svc;
+  edgex_transport transport;
+  edgex_error err;
+  const char *events[] = { "e1", "x2", "e3" };
+
+  /* Log three events, of which core-data will reject the second */
+
+  clear_dir ();
+  edgex_wal *w = edgex_wal_open (dir, 4096, 65536);
+  CU_ASSERT_FATAL (w != NULL);
+  for (unsigned i = 0; i < 3; i++)
+  {
+    edgex_wal_append (w, EDGEX_EVENT_JSON, events[i], strlen (events[i]));
+  }
+  edgex_wal_close (w);
+
+  memset (&svc, 0, sizeof (svc));
+  memset (&transport, 0, sizeof (transport));
+  transport.name = "test";
+  transport.publish = fw_publish;
+  svc.config.endpoints.transport = &transport;
+  svc.config.device.eventlogdir = dir;
+  nposts = 0;
+  edgex_forward *f = edgex_forward_create (&svc, &err);
+  CU_ASSERT_FATAL (f != NULL);
+
+  /* The rejected event is discarded, and does not hold up the one after */
+
+  for (unsigned i = 0; i < 500 && fw_metric (f, "EventLog.Records"); i++)
+  {
+    usleep (10000);
+  }
+  CU_ASSERT (fw_metric (f, "EventLog.Records") == 0);
+  CU_ASSERT (fw_metric (f, "EventLog.Forwarded") == 2);
+  CU_ASSERT (fw_metric (f, "EventLog.Rejected") == 1);
+  edgex_forward_free (f);
+
+  CU_ASSERT_FATAL (nposts == 3);
+  for (unsigned i = 0; i < 3; i++)
+  {
+    CU_ASSERT_STRING_EQUAL (posted[i], events[i]);
+  }
+}
+
+void cunit_forward_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("forward", suite_init, suite_clean);
+  CU_add_test (suite, "test_rejected", test_rejected);
+}
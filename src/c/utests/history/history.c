@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "history.h"
+#include "../src/c/history.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Query a resource of device "dev", returning the readings as JSON */
+
+static uint32_t query
+(
+  edgex_history *h,
+  const char *resource,
+  uint64_t start,
+  uint64_t end,
+  uint32_t limit,
+  edgex_strbuf *out,
+  uint64_t *seq
+)
+{
+  out->len = 0;
+  return edgex_history_query
+    (h, "dev", resource, start, end, limit, out, true, seq);
+}
+
+static void test_ring (void)
+{
+  edgex_strbuf out;
+  uint64_t seq = 0;
+  char value[8];
+  edgex_history *h = edgex_history_create (3);
+
+  edgex_strbuf_init (&out);
+  CU_ASSERT (query (h, "temp", 0, UINT64_MAX, 10, &out, &seq) == 0);
+  CU_ASSERT (seq == 0);
+
+  for (unsigned i = 1; i <= 5; i++)
+  {
+    sprintf (value, "%u", i * 10);
+    edgex_history_add (h, "dev", "temp", value, 1000 + i);
+  }
+  CU_ASSERT (query (h, "temp", 0, UINT64_MAX, 10, &out, &seq) == 3);
+  CU_ASSERT (seq == 5);
+  CU_ASSERT_STRING_EQUAL
+  (
+    out.data,
+    "{\"name\":\"temp\",\"value\":\"30\",\"origin\":1003},"
+    "{\"name\":\"temp\",\"value\":\"40\",\"origin\":1004},"
+    "{\"name\":\"temp\",\"value\":\"50\",\"origin\":1005}"
+  );
+
+  /* The latest reading only */
+
+  CU_ASSERT (query (h, "temp", 0, UINT64_MAX, 1, &out, &seq) == 1);
+  CU_ASSERT_STRING_EQUAL
+    (out.data, "{\"name\":\"temp\",\"value\":\"50\",\"origin\":1005}");
+
+  /* A longer reading replaces the oldest */
+
+  edgex_history_add (h, "dev", "temp", "a much longer value", 1006);
+  CU_ASSERT (query (h, "temp", 1006, 1006, 10, &out, &seq) == 1);
+  CU_ASSERT (seq == 6);
+  CU_ASSERT (strstr (out.data, "a much longer value") != NULL);
+
+  edgex_strbuf_fini (&out);
+  edgex_history_free (h);
+}
+
+static void test_range (void)
+{
+  edgex_strbuf out;
+  uint64_t seq = 0;
+  edgex_history *h = edgex_history_create (8);
+
+  edgex_strbuf_init (&out);
+  edgex_history_add (h, "dev", "temp", "1", 100);
+  edgex_history_add (h, "dev", "temp", "2", 200);
+  edgex_history_add (h, "dev", "temp", "3", 300);
+  edgex_history_add (h, "dev", "temp", "4", 400);
+  edgex_history_add (h, "dev", "humidity", "\"wet\"", 250);
+
+  CU_ASSERT (query (h, "temp", 200, 300, 10, &out, &seq) == 2);
+  CU_ASSERT_STRING_EQUAL
+  (
+    out.data,
+    "{\"name\":\"temp\",\"value\":\"2\",\"origin\":200},"
+    "{\"name\":\"temp\",\"value\":\"3\",\"origin\":300}"
+  );
+
+  /* A limit keeps the most recent readings in the range */
+
+  CU_ASSERT (query (h, "temp", 150, 450, 2, &out, &seq) == 2);
+  CU_ASSERT (strstr (out.data, "\"3\"") && strstr (out.data, "\"4\""));
+
+  /* Values are escaped, and appended after a comma unless first */
+
+  out.len = 0;
+  edgex_strbuf_appendstr (&out, "X");
+  CU_ASSERT
+  (
+    edgex_history_query
+      (h, "dev", "humidity", 0, UINT64_MAX, 1, &out, false, &seq) == 1
+  );
+  CU_ASSERT_STRING_EQUAL
+  (
+    out.data,
+    "X,{\"name\":\"humidity\",\"value\":\"\\\"wet\\\"\",\"origin\":250}"
+  );
+
+  /* Without a buffer only the sequence number is found */
+
+  seq = 0;
+  CU_ASSERT (edgex_history_query
+    (h, "dev", "temp", 0, 0, 0, NULL, true, &seq) == 0);
+  CU_ASSERT (seq == 4);
+  edgex_history_query (h, "dev", "humidity", 0, 0, 0, NULL, true, &seq);
+  CU_ASSERT (seq == 5);
+
+  edgex_strbuf_fini (&out);
+  edgex_history_free (h);
+}
+
+static void test_forget (void)
+{
+  edgex_strbuf out;
+  uint64_t seq = 0;
+  edgex_history *h = edgex_history_create (4);
+
+  edgex_strbuf_init (&out);
+  edgex_history_add (h, "dev", "temp", "1", 100);
+  edgex_history_add (h, "device2", "temp", "2", 100);
+  edgex_history_add (h, "de", "temp", "3", 100);
+  edgex_history_forget (h, "dev");
+  CU_ASSERT (query (h, "temp", 0, UINT64_MAX, 10, &out, &seq) == 0);
+  CU_ASSERT (edgex_history_query
+    (h, "device2", "temp", 0, UINT64_MAX, 10, NULL, true, &seq) == 1);
+  CU_ASSERT (edgex_history_query
+    (h, "de", "temp", 0, UINT64_MAX, 10, NULL, true, &seq) == 1);
+
+  /* Sequence numbers continue after a device is forgotten */
+
+  edgex_history_add (h, "dev", "temp", "4", 200);
+  seq = 0;
+  CU_ASSERT (query (h, "temp", 0, UINT64_MAX, 10, &out, &seq) == 1);
+  CU_ASSERT (seq == 4);
+
+  edgex_history_forget (NULL, "dev");
+  edgex_strbuf_fini (&out);
+  edgex_history_free (h);
+}
+
+void cunit_history_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("history", suite_init, suite_clean);
+  CU_add_test (suite, "test_ring", test_ring);
+  CU_add_test (suite, "test_range", test_range);
+  CU_add_test (suite, "test_forget", test_forget);
+}
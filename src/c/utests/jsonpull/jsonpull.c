@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "jsonpull.h"
+#include "../src/c/jsonpull.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Read all of a document, returning the number of tokens or -1 on error */
+
+static int count_tokens (const char *json)
+{
+  edgex_jsonpull r;
+  edgex_json_token t;
+  int n = 0;
+
+  edgex_jsonpull_init (&r, json, strlen (json));
+  while ((t = edgex_jsonpull_next (&r)) != EDGEX_JSON_END)
+  {
+    if (t == EDGEX_JSON_ERROR)
+    {
+      return -1;
+    }
+    n++;
+  }
+  return n;
+}
+
+static void test_tokens (void)
+{
+  const char *json =
+    " { \"a\" : [ 1, -2.5e3, true, false, null, \"s\" ], \"b\": {} } ";
+  edgex_json_token expect[] =
+  {
+    EDGEX_JSON_OBJECT, EDGEX_JSON_KEY, EDGEX_JSON_ARRAY, EDGEX_JSON_NUMBER,
+    EDGEX_JSON_NUMBER, EDGEX_JSON_TRUE, EDGEX_JSON_FALSE, EDGEX_JSON_NULL,
+    EDGEX_JSON_STRING, EDGEX_JSON_ARRAY_END, EDGEX_JSON_KEY, EDGEX_JSON_OBJECT,
+    EDGEX_JSON_OBJECT_END, EDGEX_JSON_OBJECT_END, EDGEX_JSON_END
+  };
+  edgex_jsonpull r;
+  bool ok = true;
+
+  edgex_jsonpull_init (&r, json, strlen (json));
+  for (unsigned i = 0; i < sizeof (expect) / sizeof (expect[0]); i++)
+  {
+    edgex_json_token t = edgex_jsonpull_next (&r);
+    ok = ok && (t == expect[i]);
+    if (i == 1)
+    {
+      CU_ASSERT (edgex_jsonpull_is (&r, "a"));
+    }
+    if (i == 4)
+    {
+      CU_ASSERT (edgex_jsonpull_number (&r) == -2500.0);
+    }
+    if (i == 8)
+    {
+      CU_ASSERT (r.toklen == 1 && r.tok[0] == 's');
+    }
+  }
+  CU_ASSERT (ok);
+  CU_ASSERT (count_tokens ("[]") == 2);
+  CU_ASSERT (count_tokens ("\"top\"") == 1);
+  CU_ASSERT (count_tokens ("0") == 1);
+}
+
+static void test_errors (void)
+{
+  const char *bad[] =
+  {
+    "", "[", "]", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "[1,]", "[1 2]",
+    "{1:2}", "[01]", "[1.]", "[-]", "[1e]", "[tru]", "[\"a]", "[\"\\x\"]",
+    "[\"\\u12g4\"]", "[\"a\nb\"]", "[1] [2]", "{\"a\":1]", "[1}"
+  };
+  for (unsigned i = 0; i < sizeof (bad) / sizeof (bad[0]); i++)
+  {
+    CU_ASSERT (count_tokens (bad[i]) == -1);
+  }
+}
+
+static void test_strings (void)
+{
+  const char *json =
+    "[\"plain\", \"q\\\"b\\\\s\\/n\\n\", \"\\u00e9\\u20ac\", "
+    "\"\\ud83d\\ude00\", \"\\udc00\"]";
+  const char *expect[] =
+    { "plain", "q\"b\\s/n\n", "\xc3\xa9\xe2\x82\xac", "\xf0\x9f\x98\x80",
+      "\xef\xbf\xbd" };
+  edgex_jsonpull r;
+
+  edgex_jsonpull_init (&r, json, strlen (json));
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_ARRAY);
+  for (unsigned i = 0; i < sizeof (expect) / sizeof (expect[0]); i++)
+  {
+    CU_ASSERT_FATAL (edgex_jsonpull_next (&r) == EDGEX_JSON_STRING);
+    CU_ASSERT (r.escaped == (i != 0));
+    char *s = edgex_jsonpull_strdup (&r);
+    CU_ASSERT (strcmp (s, expect[i]) == 0);
+    CU_ASSERT (edgex_jsonpull_is (&r, expect[i]));
+    free (s);
+  }
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_ARRAY_END);
+}
+
+static void test_skip (void)
+{
+  const char *json =
+    "{\"skip\":{\"x\":[1,{\"y\":[]}],\"z\":\"}\"},\"keep\":42}";
+  edgex_jsonpull r;
+  edgex_json_token t;
+
+  edgex_jsonpull_init (&r, json, strlen (json));
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_OBJECT);
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_KEY);
+  t = edgex_jsonpull_next (&r);
+  CU_ASSERT_FATAL (t == EDGEX_JSON_OBJECT);
+  CU_ASSERT (edgex_jsonpull_skip (&r, t));
+  CU_ASSERT (r.toklen == strlen ("{\"x\":[1,{\"y\":[]}],\"z\":\"}\"}"));
+  CU_ASSERT (strncmp (r.tok, "{\"x\"", 4) == 0);
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_KEY);
+  CU_ASSERT (edgex_jsonpull_is (&r, "keep"));
+  t = edgex_jsonpull_next (&r);
+  CU_ASSERT (t == EDGEX_JSON_NUMBER);
+  CU_ASSERT (edgex_jsonpull_skip (&r, t));
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_OBJECT_END);
+  CU_ASSERT (edgex_jsonpull_next (&r) == EDGEX_JSON_END);
+
+  edgex_jsonpull_init (&r, "[[1,2", 5);
+  edgex_jsonpull_next (&r);
+  t = edgex_jsonpull_next (&r);
+  CU_ASSERT (!edgex_jsonpull_skip (&r, t));
+}
+
+static void test_depth (void)
+{
+  char deep[2 * EDGEX_JSONPULL_DEPTH + 3];
+
+  memset (deep, '[', EDGEX_JSONPULL_DEPTH);
+  memset (deep + EDGEX_JSONPULL_DEPTH, ']', EDGEX_JSONPULL_DEPTH);
+  deep[2 * EDGEX_JSONPULL_DEPTH] = '\0';
+  CU_ASSERT (count_tokens (deep) == 2 * EDGEX_JSONPULL_DEPTH);
+
+  memset (deep, '[', EDGEX_JSONPULL_DEPTH + 1);
+  memset (deep + EDGEX_JSONPULL_DEPTH + 1, ']', EDGEX_JSONPULL_DEPTH + 1);
+  deep[2 * EDGEX_JSONPULL_DEPTH + 2] = '\0';
+  CU_ASSERT (count_tokens (deep) == -1);
+}
+
+void cunit_jsonpull_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("jsonpull", suite_init, suite_clean);
+  CU_add_test (suite, "test_tokens", test_tokens);
+  CU_add_test (suite, "test_errors", test_errors);
+  CU_add_test (suite, "test_strings", test_strings);
+  CU_add_test (suite, "test_skip", test_skip);
+  CU_add_test (suite, "test_depth", test_depth);
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "logqueue.h"
+#include "../src/c/logqueue.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* A sender which records the entries it is given */
+
+typedef struct sink
+{
+  pthread_mutex_t lock;
+  unsigned posts;
+  unsigned entries;
+  unsigned arrays;
+  bool fail;
+  bool bad;
+  bool block;
+} sink;
+
+static bool sink_send (void *ctx, const char *json)
+{
+  sink *s = (sink *) ctx;
+  while (__atomic_load_n (&s->block, __ATOMIC_ACQUIRE))
+  {
+    usleep (1000);
+  }
+  JSON_Value *val = json_parse_string (json);
+  pthread_mutex_lock (&s->lock);
+  s->posts++;
+  if (val == NULL)
+  {
+    s->bad = true;
+  }
+  else if (json_value_get_type (val) == JSONArray)
+  {
+    s->arrays++;
+    s->entries += json_array_get_count (json_value_get_array (val));
+  }
+  else
+  {
+    JSON_Object *obj = json_value_get_object (val);
+    if (strcmp (json_object_get_string (obj, "logLevel"), "ERROR") ||
+      strcmp (json_object_get_string (obj, "originService"), "svc"))
+    {
+      s->bad = true;
+    }
+    s->entries++;
+  }
+  pthread_mutex_unlock (&s->lock);
+  json_value_free (val);
+  return !s->fail;
+}
+
+static void sink_init (sink *s)
+{
+  memset (s, 0, sizeof (sink));
+  pthread_mutex_init (&s->lock, NULL);
+}
+
+static double metric (edgex_logqueue *q, const char *name)
+{
+  JSON_Value *val = json_value_init_object ();
+  edgex_logqueue_metrics (q, json_value_get_object (val));
+  double result = json_object_dotget_number
+    (json_value_get_object (val), name);
+  json_value_free (val);
+  return result;
+}
+
+static void test_single (void)
+{
+  sink s;
+  sink_init (&s);
+  edgex_logqueue *q = edgex_logqueue_create (sink_send, &s, 16, 1, 0);
+  for (int i = 0; i < 10; i++)
+  {
+    CU_ASSERT (edgex_logqueue_add (q, "svc", IOT_LOG_ERROR, 1000, "msg \"quoted\""));
+  }
+  edgex_logqueue_free (q);
+  CU_ASSERT (s.entries == 10);
+  CU_ASSERT (s.posts == 10);
+  CU_ASSERT (s.arrays == 0);
+  CU_ASSERT (!s.bad);
+}
+
+static void test_batch (void)
+{
+  sink s;
+  sink_init (&s);
+  s.block = true;
+  edgex_logqueue *q = edgex_logqueue_create (sink_send, &s, 64, 8, 0);
+  for (int i = 0; i < 33; i++)
+  {
+    edgex_logqueue_add (q, "svc", IOT_LOG_ERROR, 1000, "msg");
+  }
+  __atomic_store_n (&s.block, false, __ATOMIC_RELEASE);
+  edgex_logqueue_free (q);
+  CU_ASSERT (s.entries == 33);
+  CU_ASSERT (s.posts <= 6);
+  CU_ASSERT (s.arrays >= 4);
+  CU_ASSERT (!s.bad);
+}
+
+static void test_full (void)
+{
+  sink s;
+  sink_init (&s);
+  s.block = true;
+  edgex_logqueue *q = edgex_logqueue_create (sink_send, &s, 8, 1, 0);
+  unsigned added = 0;
+  for (int i = 0; i < 20; i++)
+  {
+    added += edgex_logqueue_add (q, "svc", IOT_LOG_ERROR, 1000, "msg");
+  }
+  CU_ASSERT (added < 20);
+  CU_ASSERT (metric (q, "Logging.Dropped") == 20 - added);
+  __atomic_store_n (&s.block, false, __ATOMIC_RELEASE);
+  edgex_logqueue_free (q);
+  CU_ASSERT (s.entries == added);
+}
+
+static void test_ratelimit (void)
+{
+  sink s;
+  sink_init (&s);
+  edgex_logqueue *q = edgex_logqueue_create (sink_send, &s, 64, 1, 5);
+  unsigned added = 0;
+  for (int i = 0; i < 20; i++)
+  {
+    added += edgex_logqueue_add (q, "svc", IOT_LOG_ERROR, 1000, "msg");
+  }
+
+  /* The limit's window may have rolled over once during the loop */
+
+  CU_ASSERT (added >= 5 && added <= 10);
+  CU_ASSERT (metric (q, "Logging.RateLimited") == 20 - added);
+  edgex_logqueue_free (q);
+}
+
+static void test_failed (void)
+{
+  sink s;
+  sink_init (&s);
+  s.fail = true;
+  edgex_logqueue *q = edgex_logqueue_create (sink_send, &s, 16, 4, 0);
+  edgex_logqueue_add (q, "svc", IOT_LOG_ERROR, 1000, "msg");
+  while (metric (q, "Logging.Failed") == 0)
+  {
+    usleep (1000);
+  }
+  CU_ASSERT (metric (q, "Logging.Sent") == 0);
+  edgex_logqueue_free (q);
+}
+
+static edgex_logqueue *shared;
+
+static void *add_thread (void *arg)
+{
+  for (int i = 0; i < 500; i++)
+  {
+    while (!edgex_logqueue_add (shared, "svc", IOT_LOG_ERROR, 1000, "msg"))
+    {
+      usleep (100);
+    }
+  }
+  return NULL;
+}
+
+static void test_concurrent (void)
+{
+  sink s;
+  pthread_t threads[4];
+  sink_init (&s);
+  shared = edgex_logqueue_create (sink_send, &s, 128, 16, 0);
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_create (&threads[i], NULL, add_thread, NULL);
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_join (threads[i], NULL);
+  }
+  edgex_logqueue_free (shared);
+  CU_ASSERT (s.entries == 2000);
+  CU_ASSERT (!s.bad);
+}
+
+void cunit_logqueue_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("logqueue", suite_init, suite_clean);
+  CU_add_test (suite, "test_single", test_single);
+  CU_add_test (suite, "test_batch", test_batch);
+  CU_add_test (suite, "test_full", test_full);
+  CU_add_test (suite, "test_ratelimit", test_ratelimit);
+  CU_add_test (suite, "test_failed", test_failed);
+  CU_add_test (suite, "test_concurrent", test_concurrent);
+}
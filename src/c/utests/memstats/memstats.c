@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "memstats.h"
+#include "../src/c/memstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Sizes are only known where the C library reports them */
+
+static void check_bytes (const edgex_mem_stats *now, int64_t least)
+{
+#ifdef __GNU_LIBRARY__
+  CU_ASSERT (now->bytes >= least);
+#endif
+}
+
+static void test_counts (void)
+{
+  edgex_mem_stats base;
+  edgex_mem_stats now;
+
+  edgex_mem_getstats (EDGEX_MEM_DEVICES, &base);
+  char *p = edgex_mem_malloc (EDGEX_MEM_DEVICES, 100);
+  char *q = edgex_mem_calloc (EDGEX_MEM_DEVICES, 10, 20);
+  char *s = edgex_mem_strdup (EDGEX_MEM_DEVICES, "a string");
+  edgex_mem_getstats (EDGEX_MEM_DEVICES, &now);
+  CU_ASSERT (now.objects == base.objects + 3);
+  check_bytes (&now, base.bytes + 309);
+  CU_ASSERT_STRING_EQUAL (s, "a string");
+
+  /* Growing an allocation adds bytes but not objects */
+
+  p = edgex_mem_realloc (EDGEX_MEM_DEVICES, p, 4000);
+  edgex_mem_getstats (EDGEX_MEM_DEVICES, &now);
+  CU_ASSERT (now.objects == base.objects + 3);
+  check_bytes (&now, base.bytes + 4209);
+
+  /* Reallocating from NULL is a new object */
+
+  char *r = edgex_mem_realloc (EDGEX_MEM_DEVICES, NULL, 50);
+  edgex_mem_getstats (EDGEX_MEM_DEVICES, &now);
+  CU_ASSERT (now.objects == base.objects + 4);
+
+  edgex_mem_free (EDGEX_MEM_DEVICES, p);
+  edgex_mem_free (EDGEX_MEM_DEVICES, q);
+  edgex_mem_free (EDGEX_MEM_DEVICES, r);
+  edgex_mem_free (EDGEX_MEM_DEVICES, NULL);
+
+  /* A disowned allocation is no longer counted, and is freed normally */
+
+  edgex_mem_disown (EDGEX_MEM_DEVICES, s);
+  edgex_mem_getstats (EDGEX_MEM_DEVICES, &now);
+  CU_ASSERT (now.objects == base.objects);
+  CU_ASSERT (now.bytes == base.bytes);
+  free (s);
+}
+
+static void *alloc_thread (void *arg)
+{
+  return edgex_mem_malloc (EDGEX_MEM_EVENTS, 128);
+}
+
+static void test_threads (void)
+{
+  edgex_mem_stats base;
+  edgex_mem_stats now;
+  pthread_t threads[4];
+  void *ptrs[4];
+
+  edgex_mem_getstats (EDGEX_MEM_EVENTS, &base);
+  for (unsigned i = 0; i < 4; i++)
+  {
+    pthread_create (&threads[i], NULL, alloc_thread, NULL);
+  }
+  for (unsigned i = 0; i < 4; i++)
+  {
+    pthread_join (threads[i], &ptrs[i]);
+  }
+
+  /* Counts remain after the allocating threads have exited */
+
+  edgex_mem_getstats (EDGEX_MEM_EVENTS, &now);
+  CU_ASSERT (now.objects == base.objects + 4);
+  check_bytes (&now, base.bytes + 512);
+
+  for (unsigned i = 0; i < 4; i++)
+  {
+    edgex_mem_free (EDGEX_MEM_EVENTS, ptrs[i]);
+  }
+  edgex_mem_getstats (EDGEX_MEM_EVENTS, &now);
+  CU_ASSERT (now.objects == base.objects);
+  CU_ASSERT (now.bytes == base.bytes);
+}
+
+static void test_json (void)
+{
+  edgex_mem_stats base;
+  edgex_mem_stats now;
+
+  edgex_mem_json_init ();
+  edgex_mem_getstats (EDGEX_MEM_JSON, &base);
+  JSON_Value *val = json_parse_string ("{\"a\":[1,2,3],\"b\":\"text\"}");
+  edgex_mem_getstats (EDGEX_MEM_JSON, &now);
+  CU_ASSERT (now.objects > base.objects);
+
+  char *str = json_serialize_to_string (val);
+  json_value_free (val);
+  json_free_serialized_string (str);
+  edgex_mem_getstats (EDGEX_MEM_JSON, &now);
+  CU_ASSERT (now.objects == base.objects);
+  CU_ASSERT (now.bytes == base.bytes);
+}
+
+static void test_metrics (void)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  char *p = edgex_mem_malloc (EDGEX_MEM_PROFILES, 64);
+
+  edgex_mem_metrics (obj);
+  JSON_Array *mem = json_object_get_array (obj, "Memory");
+  CU_ASSERT_FATAL (json_array_get_count (mem) == EDGEX_MEM_NTAGS);
+  JSON_Object *prof = json_array_get_object (mem, EDGEX_MEM_PROFILES);
+  CU_ASSERT_STRING_EQUAL (json_object_get_string (prof, "Name"), "Profiles");
+  CU_ASSERT (json_object_get_number (prof, "Objects") >= 1);
+#ifdef __GNU_LIBRARY__
+  CU_ASSERT (json_object_get_string (obj, "Allocator") != NULL);
+#endif
+
+  edgex_mem_free (EDGEX_MEM_PROFILES, p);
+  json_value_free (val);
+}
+
+void cunit_memstats_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("memstats", suite_init, suite_clean);
+  CU_add_test (suite, "test_counts", test_counts);
+  CU_add_test (suite, "test_threads", test_threads);
+  CU_add_test (suite, "test_json", test_json);
+  CU_add_test (suite, "test_metrics", test_metrics);
+}
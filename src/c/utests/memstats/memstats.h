@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _CUNIT_MEMSTATS_H_
+#define _CUNIT_MEMSTATS_H_
+
+extern void cunit_memstats_test_init (void);
+
+#endif
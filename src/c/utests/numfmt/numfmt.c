@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "numfmt.h"
+#include "../src/c/numfmt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static uint64_t rnd (void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+static void test_integers (void)
+{
+  char buf[EDGEX_FMT_BUFSIZE];
+
+  CU_ASSERT (edgex_fmt_uint (0, buf) == 1 && strcmp (buf, "0") == 0);
+  CU_ASSERT (edgex_fmt_uint (UINT64_MAX, buf) == 20);
+  CU_ASSERT (strcmp (buf, "18446744073709551615") == 0);
+  CU_ASSERT (edgex_fmt_int (INT64_MIN, buf) == 20);
+  CU_ASSERT (strcmp (buf, "-9223372036854775808") == 0);
+  CU_ASSERT (edgex_fmt_int (-7, buf) == 2 && strcmp (buf, "-7") == 0);
+  CU_ASSERT (edgex_fmt_int (100, buf) == 3 && strcmp (buf, "100") == 0);
+}
+
+static void test_fixed (void)
+{
+  char buf[EDGEX_FMT_BUFSIZE];
+
+  edgex_fmt_double (1.0, buf);
+  CU_ASSERT (strcmp (buf, "1e+00") == 0);
+  edgex_fmt_double (-2.5, buf);
+  CU_ASSERT (strcmp (buf, "-2.5e+00") == 0);
+  edgex_fmt_double (123456.789, buf);
+  CU_ASSERT (strcmp (buf, "1.23456789e+05") == 0);
+  edgex_fmt_double (1.7976931348623157e308, buf);
+  CU_ASSERT (strcmp (buf, "1.7976931348623157e+308") == 0);
+  edgex_fmt_double (5e-324, buf);
+  CU_ASSERT (strcmp (buf, "5e-324") == 0);
+  edgex_fmt_double (0.0, buf);
+  CU_ASSERT (strcmp (buf, "0e+00") == 0);
+  edgex_fmt_double (NAN, buf);
+  CU_ASSERT (strcmp (buf, "nan") == 0);
+  edgex_fmt_double (-INFINITY, buf);
+  CU_ASSERT (strcmp (buf, "-inf") == 0);
+  edgex_fmt_float (0.1f, buf);
+  CU_ASSERT (strcmp (buf, "1e-01") == 0);
+  edgex_fmt_float (3.4028235e38f, buf);
+  CU_ASSERT (strcmp (buf, "3.4028235e+38") == 0);
+}
+
+static void test_rtrip_double (void)
+{
+  char buf[EDGEX_FMT_BUFSIZE];
+  double val;
+
+  for (int i = 0; i < 100000; i++)
+  {
+    uint64_t bits = rnd ();
+    memcpy (&val, &bits, sizeof (val));
+    if (isfinite (val))
+    {
+      CU_ASSERT (edgex_fmt_double (val, buf) < EDGEX_FMT_BUFSIZE);
+      CU_ASSERT (strtod (buf, NULL) == val);
+    }
+  }
+}
+
+static void test_rtrip_float (void)
+{
+  char buf[EDGEX_FMT_BUFSIZE];
+  float val;
+
+  for (int i = 0; i < 100000; i++)
+  {
+    uint32_t bits = (uint32_t) rnd ();
+    memcpy (&val, &bits, sizeof (val));
+    if (isfinite (val))
+    {
+      CU_ASSERT (edgex_fmt_float (val, buf) < EDGEX_FMT_BUFSIZE);
+      CU_ASSERT (strtof (buf, NULL) == val);
+    }
+  }
+}
+
+void cunit_numfmt_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("numfmt", suite_init, suite_clean);
+  CU_add_test (suite, "test_integers", test_integers);
+  CU_add_test (suite, "test_fixed", test_fixed);
+  CU_add_test (suite, "test_rtrip_double", test_rtrip_double);
+  CU_add_test (suite, "test_rtrip_float", test_rtrip_float);
+}
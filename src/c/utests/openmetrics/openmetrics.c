@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "openmetrics.h"
+#include "../src/c/openmetrics.h"
+
+#include <string.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void test_name (void)
+{
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  edgex_openmetrics_name (&b, "Http", "PoolHits");
+  CU_ASSERT (strcmp (b.data, "edgex_http_pool_hits") == 0);
+  b.len = 0;
+  edgex_openmetrics_name (&b, "CPU", "HTTPRequests");
+  CU_ASSERT (strcmp (b.data, "edgex_cpu_http_requests") == 0);
+  b.len = 0;
+  edgex_openmetrics_name (&b, "Event Queue", NULL);
+  CU_ASSERT (strcmp (b.data, "edgex_event_queue") == 0);
+  edgex_strbuf_fini (&b);
+}
+
+static void test_label (void)
+{
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  edgex_openmetrics_label (&b, "a\"b\\c\nd");
+  CU_ASSERT (strcmp (b.data, "\"a\\\"b\\\\c\\nd\"") == 0);
+  edgex_strbuf_fini (&b);
+}
+
+static void test_json (void)
+{
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  JSON_Value *val = json_parse_string
+    ("{\"CPU\":1.5,\"Schedules\":[{\"Name\":\"s1\",\"Runs\":2},"
+     "{\"Name\":\"s2\",\"Runs\":3}],\"Label\":\"x\"}");
+  edgex_openmetrics_json (&b, json_value_get_object (val));
+  CU_ASSERT_STRING_EQUAL
+  (
+    b.data,
+    "# TYPE edgex_cpu unknown\n"
+    "edgex_cpu 1.5\n"
+    "# TYPE edgex_schedules_runs unknown\n"
+    "edgex_schedules_runs{name=\"s1\"} 2\n"
+    "edgex_schedules_runs{name=\"s2\"} 3\n"
+  );
+  json_value_free (val);
+  edgex_strbuf_fini (&b);
+}
+
+void cunit_openmetrics_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("openmetrics", suite_init, suite_clean);
+  CU_add_test (suite, "test_name", test_name);
+  CU_add_test (suite, "test_label", test_label);
+  CU_add_test (suite, "test_json", test_json);
+}
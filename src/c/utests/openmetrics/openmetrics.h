@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _CUNIT_OPENMETRICS_H_
+#define _CUNIT_OPENMETRICS_H_
+
+extern void cunit_openmetrics_test_init (void);
+
+#endif
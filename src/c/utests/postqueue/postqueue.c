@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "postqueue.h"
+#include "../src/c/postqueue.h"
+#include "../src/c/service.h"
+#include "../src/c/transport.h"
+#include "../src/c/memstats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define PQ_CAPACITY 2
+#define PQ_MAXPOSTS 16
+
+/*
+ * A transport whose first publish blocks until opened, so that events
+ * submitted meanwhile stay queued. It records the reading of each event it
+ * is given, in order.
+ */
+
+typedef struct pq_sink
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool open;
+  unsigned nposts;
+  int readings[PQ_MAXPOSTS];
+} pq_sink;
+
+typedef struct pq_test
+{
+  edgex_device_service svc;
+  edgex_transport transport;
+  pq_sink sink;
+  edgex_postqueue *queue;
+} pq_test;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void pq_publish
+(
+  void *impl,
+  const char *event,
+  size_t size,
+  edgex_event_encoding encoding,
+  edgex_error *err
+)
+{
+  pq_sink *sink = (pq_sink *) impl;
+  JSON_Value *val = json_parse_string (event);
+  JSON_Array *readings =
+    json_object_get_array (json_value_get_object (val), "readings");
+
+  pthread_mutex_lock (&sink->lock);
+  if (sink->nposts < PQ_MAXPOSTS)
+  {
+    sink->readings[sink->nposts] = json_array_get_number (readings, 0);
+  }
+  sink->nposts++;
+  pthread_cond_broadcast (&sink->cond);
+  while (!sink->open)
+  {
+    pthread_cond_wait (&sink->cond, &sink->lock);
+  }
+  pthread_mutex_unlock (&sink->lock);
+  json_value_free (val);
+}
+
+/* An event from a device with a single reading, the number n */
+
+static edgex_event_cooked *pq_event (const char *device, int n)
+{
+  char readings[16];
+  edgex_event_cooked *e =
+    edgex_mem_malloc (EDGEX_MEM_EVENTS, sizeof (edgex_event_cooked));
+  e->device = edgex_mem_strdup (EDGEX_MEM_EVENTS, device);
+  e->origin = 0;
+  e->encoding = EDGEX_EVENT_JSON;
+  e->size = snprintf (readings, sizeof (readings), "%d", n);
+  e->readings = edgex_mem_strdup (EDGEX_MEM_EVENTS, readings);
+  return e;
+}
+
+/*
+ * Create a queue of PQ_CAPACITY events with a single dispatcher, and submit
+ * one event for it to hold in the blocked transport.
+ */
+
+static void pq_start (pq_test *t, const char *policy, const char *spilldir)
+{
+  memset (t, 0, sizeof (pq_test));
+  pthread_mutex_init (&t->sink.lock, NULL);
+  pthread_cond_init (&t->sink.cond, NULL);
+  t->transport.name = "test";
+  t->transport.impl = &t->sink;
+  t->transport.publish = pq_publish;
+  t->svc.config.endpoints.transport = &t->transport;
+  t->svc.config.device.eventqueuesize = PQ_CAPACITY;
+  t->svc.config.device.eventqueuethreads = 1;
+  t->svc.config.device.eventqueuepolicy = (char *) policy;
+  t->svc.config.device.eventqueuespilldir = (char *) spilldir;
+  t->queue = edgex_postqueue_create (&t->svc);
+
+  edgex_postqueue_submit (t->queue, pq_event ("a", 0));
+  pthread_mutex_lock (&t->sink.lock);
+  while (t->sink.nposts == 0)
+  {
+    pthread_cond_wait (&t->sink.cond, &t->sink.lock);
+  }
+  pthread_mutex_unlock (&t->sink.lock);
+}
+
+/* Read a counter from the queue's metrics */
+
+static double pq_metric (pq_test *t, const char *name)
+{
+  JSON_Value *val = json_value_init_object ();
+  JSON_Object *obj = json_value_get_object (val);
+  edgex_postqueue_metrics (t->queue, obj);
+  double result = json_object_dotget_number (obj, name);
+  json_value_free (val);
+  return result;
+}
+
+/* Let the transport proceed, and post whatever remains queued */
+
+static void pq_finish (pq_test *t)
+{
+  pthread_mutex_lock (&t->sink.lock);
+  t->sink.open = true;
+  pthread_cond_broadcast (&t->sink.cond);
+  pthread_mutex_unlock (&t->sink.lock);
+  edgex_postqueue_free (t->queue);
+  pthread_cond_destroy (&t->sink.cond);
+  pthread_mutex_destroy (&t->sink.lock);
+}
+
+static void test_dropoldest (void)
+{
+  pq_test t;
+
+  /* The oldest event of the device with the most queued is dropped */
+
+  pq_start (&t, "DropOldest", NULL);
+  edgex_postqueue_submit (t.queue, pq_event ("a", 1));
+  edgex_postqueue_submit (t.queue, pq_event ("a", 2));
+  edgex_postqueue_submit (t.queue, pq_event ("b", 3));
+  edgex_postqueue_submit (t.queue, pq_event ("a", 4));
+  CU_ASSERT (pq_metric (&t, "EventQueue.Depth") == PQ_CAPACITY);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Events") == 5);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Dropped") == 2);
+
+  pq_finish (&t);
+  CU_ASSERT_FATAL (t.sink.nposts == 3);
+  CU_ASSERT (t.sink.readings[0] == 0);
+  CU_ASSERT (t.sink.readings[1] == 3);
+  CU_ASSERT (t.sink.readings[2] == 4);
+}
+
+static void test_dropnewest (void)
+{
+  pq_test t;
+
+  /*
+   * The newest event of the device with the most queued is dropped, or the
+   * incoming event if its own device has as many.
+   */
+
+  pq_start (&t, "DropNewest", NULL);
+  edgex_postqueue_submit (t.queue, pq_event ("a", 1));
+  edgex_postqueue_submit (t.queue, pq_event ("a", 2));
+  edgex_postqueue_submit (t.queue, pq_event ("b", 3));
+  edgex_postqueue_submit (t.queue, pq_event ("a", 4));
+  CU_ASSERT (pq_metric (&t, "EventQueue.Depth") == PQ_CAPACITY);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Events") == 5);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Dropped") == 2);
+
+  pq_finish (&t);
+  CU_ASSERT_FATAL (t.sink.nposts == 3);
+  CU_ASSERT (t.sink.readings[0] == 0);
+  CU_ASSERT (t.sink.readings[1] == 1);
+  CU_ASSERT (t.sink.readings[2] == 3);
+}
+
+typedef struct pq_submitter
+{
+  pq_test *test;
+  bool returned;
+} pq_submitter;
+
+static void *pq_submit (void *arg)
+{
+  pq_submitter *s = (pq_submitter *) arg;
+  edgex_postqueue_submit (s->test->queue, pq_event ("a", 3));
+  __atomic_store_n (&s->returned, true, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void test_block (void)
+{
+  pq_test t;
+  pq_submitter s;
+  pthread_t thread;
+
+  /* Submitting to a full queue waits for space, and nothing is dropped */
+
+  pq_start (&t, "Block", NULL);
+  edgex_postqueue_submit (t.queue, pq_event ("a", 1));
+  edgex_postqueue_submit (t.queue, pq_event ("b", 2));
+  s.test = &t;
+  s.returned = false;
+  pthread_create (&thread, NULL, pq_submit, &s);
+  usleep (50000);
+  CU_ASSERT (!__atomic_load_n (&s.returned, __ATOMIC_ACQUIRE));
+  CU_ASSERT (pq_metric (&t, "EventQueue.Depth") == PQ_CAPACITY);
+
+  pthread_mutex_lock (&t.sink.lock);
+  t.sink.open = true;
+  pthread_cond_broadcast (&t.sink.cond);
+  pthread_mutex_unlock (&t.sink.lock);
+  pthread_join (thread, NULL);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Dropped") == 0);
+
+  pq_finish (&t);
+  CU_ASSERT_FATAL (t.sink.nposts == 4);
+  CU_ASSERT (t.sink.readings[0] == 0);
+  CU_ASSERT (t.sink.readings[1] == 1);
+  CU_ASSERT (t.sink.readings[2] == 2);
+  CU_ASSERT (t.sink.readings[3] == 3);
+}
+
+static void test_spill (void)
+{
+  pq_test t;
+  char dir[PATH_MAX];
+
+  /* Events beyond the bound go to disk, and are replayed in order */
+
+  snprintf (dir, sizeof (dir), "/tmp/postqueue-test-%d", (int) getpid ());
+  pq_start (&t, "Spill", dir);
+  edgex_postqueue_submit (t.queue, pq_event ("a", 1));
+  edgex_postqueue_submit (t.queue, pq_event ("a", 2));
+  edgex_postqueue_submit (t.queue, pq_event ("a", 3));
+  edgex_postqueue_submit (t.queue, pq_event ("b", 4));
+  CU_ASSERT (pq_metric (&t, "EventQueue.Depth") == PQ_CAPACITY);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Spilled") == 2);
+  CU_ASSERT (pq_metric (&t, "EventQueue.OnDisk") == 2);
+  CU_ASSERT (pq_metric (&t, "EventQueue.Dropped") == 0);
+
+  pthread_mutex_lock (&t.sink.lock);
+  t.sink.open = true;
+  pthread_cond_broadcast (&t.sink.cond);
+  pthread_mutex_unlock (&t.sink.lock);
+  for (unsigned i = 0; i < 500 && pq_metric (&t, "EventQueue.OnDisk"); i++)
+  {
+    usleep (10000);
+  }
+  CU_ASSERT (pq_metric (&t, "EventQueue.OnDisk") == 0);
+
+  pq_finish (&t);
+  rmdir (dir);
+  CU_ASSERT_FATAL (t.sink.nposts == 5);
+  for (int i = 0; i < 5; i++)
+  {
+    CU_ASSERT (t.sink.readings[i] == i);
+  }
+}
+
+void cunit_postqueue_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("postqueue", suite_init, suite_clean);
+  CU_add_test (suite, "test_dropoldest", test_dropoldest);
+  CU_add_test (suite, "test_dropnewest", test_dropnewest);
+  CU_add_test (suite, "test_block", test_block);
+  CU_add_test (suite, "test_spill", test_spill);
+}
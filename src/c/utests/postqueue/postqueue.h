@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _CUNIT_POSTQUEUE_H_
+#define _CUNIT_POSTQUEUE_H_
+
+extern void cunit_postqueue_test_init (void);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "profwatch.h"
+#include "../src/c/profwatch.h"
+#include "../src/c/profiles.h"
+#include "../src/c/edgex_rest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A profile with a Temperature resource in the given units, and Humidity */
+
+static char *pw_profile (const char *units, bool pressure)
+{
+  static const char *res =
+    "{\"name\":\"%s\",\"description\":\"%s\",\"properties\":{"
+    "\"value\":{\"type\":\"Float32\",\"readWrite\":\"R\","
+    "\"minimum\":\"-40\",\"maximum\":\"100\",\"defaultValue\":\"0\"},"
+    "\"units\":{\"type\":\"String\",\"readWrite\":\"R\","
+    "\"defaultValue\":\"%s\"}}}";
+  char r1[512];
+  char r2[512];
+  char r3[512];
+  char *result = malloc (2048);
+
+  snprintf (r1, sizeof (r1), res, "Temperature", "Temperature", units);
+  snprintf (r2, sizeof (r2), res, "Humidity", "Humidity", "%RH");
+  snprintf (r3, sizeof (r3), res, "Pressure", "Pressure", "hPa");
+  snprintf
+  (
+    result, 2048, "{\"name\":\"Weather\",\"deviceResources\":[%s,%s%s%s]}",
+    r1, r2, pressure ? "," : "", pressure ? r3 : ""
+  );
+  return result;
+}
+
+static edgex_deviceresource *pw_find
+  (edgex_deviceprofile *dp, const char *name)
+{
+  for (edgex_deviceresource *r = dp->device_resources; r; r = r->next)
+  {
+    if (strcmp (r->name, name) == 0)
+    {
+      return r;
+    }
+  }
+  return NULL;
+}
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void test_changed_units (void)
+{
+  char *oldstr = pw_profile ("degC", false);
+  char *newstr = pw_profile ("degF", true);
+  JSON_Value *oldv = json_parse_string (oldstr);
+  JSON_Value *newv = json_parse_string (newstr);
+  edgex_deviceprofile *dp = edgex_deviceprofile_read (NULL, newstr);
+  edgex_deviceprofile *cached = edgex_deviceprofile_read (NULL, oldstr);
+  CU_ASSERT_FATAL (dp != NULL && cached != NULL);
+  edgex_deviceresource *temp = pw_find (dp, "Temperature");
+  edgex_deviceresource *hum = pw_find (dp, "Humidity");
+  edgex_deviceresource *pres = pw_find (dp, "Pressure");
+  CU_ASSERT_FATAL (temp && hum && pres);
+
+  /* Against the previous version of the file */
+
+  CU_ASSERT
+  (
+    edgex_profwatch_resource_change (temp, newv, oldv, NULL) ==
+    EDGEX_PROFWATCH_CHANGED
+  );
+  CU_ASSERT
+  (
+    edgex_profwatch_resource_change (hum, newv, oldv, NULL) ==
+    EDGEX_PROFWATCH_SAME
+  );
+  CU_ASSERT
+  (
+    edgex_profwatch_resource_change (pres, newv, oldv, NULL) ==
+    EDGEX_PROFWATCH_ADDED
+  );
+
+  /* Against the version held by metadata */
+
+  CU_ASSERT
+  (
+    edgex_profwatch_resource_change (temp, newv, NULL, cached) ==
+    EDGEX_PROFWATCH_CHANGED
+  );
+  CU_ASSERT
+  (
+    edgex_profwatch_resource_change (hum, newv, NULL, cached) ==
+    EDGEX_PROFWATCH_SAME
+  );
+  CU_ASSERT
+  (
+    edgex_profwatch_resource_change (pres, newv, NULL, cached) ==
+    EDGEX_PROFWATCH_ADDED
+  );
+
+  /* The replacement descriptor has the new units */
+
+  edgex_valuedescriptor *vd = edgex_device_profile_valuedescriptor (temp, 1);
+  CU_ASSERT_STRING_EQUAL (vd->name, "Temperature");
+  CU_ASSERT_STRING_EQUAL (vd->uomLabel, "degF");
+  CU_ASSERT_STRING_EQUAL (vd->min, "-40");
+  CU_ASSERT_STRING_EQUAL (vd->max, "100");
+  CU_ASSERT_STRING_EQUAL (vd->type, "f");
+  edgex_valuedescriptor_free (vd);
+
+  edgex_deviceprofile_free (cached);
+  edgex_deviceprofile_free (dp);
+  json_value_free (newv);
+  json_value_free (oldv);
+  free (newstr);
+  free (oldstr);
+}
+
+void cunit_profwatch_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("profwatch", suite_init, suite_clean);
+  CU_add_test (suite, "test_changed_units", test_changed_units);
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "putbatch.h"
+#include "../src/c/putbatch.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define PB_WRITERS 3
+#define PB_BAD -1
+
+/*
+ * A driver whose first call blocks until opened, so that later writes queue
+ * behind it. It refuses any call including the value PB_BAD.
+ */
+
+typedef struct pb_driver
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool open;
+  unsigned ncalls;
+  uint32_t sizes[16];
+} pb_driver;
+
+typedef struct pb_writer
+{
+  edgex_putbatch *batch;
+  pb_driver *drv;
+  uint32_t maxops;
+  edgex_device_commandrequest req;
+  edgex_device_commandresult val;
+  bool ok;
+  pthread_t thread;
+} pb_writer;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static bool pb_put
+(
+  void *impl,
+  const edgex_addressable *devaddr,
+  uint32_t nvalues,
+  const edgex_device_commandrequest *requests,
+  const edgex_device_commandresult *values
+)
+{
+  pb_driver *drv = (pb_driver *) impl;
+  bool ok = true;
+
+  pthread_mutex_lock (&drv->lock);
+  drv->sizes[drv->ncalls++] = nvalues;
+  pthread_cond_broadcast (&drv->cond);
+  while (!drv->open)
+  {
+    pthread_cond_wait (&drv->cond, &drv->lock);
+  }
+  pthread_mutex_unlock (&drv->lock);
+
+  for (uint32_t i = 0; i < nvalues; i++)
+  {
+    ok = ok && values[i].value.i32_result != PB_BAD;
+  }
+  return ok;
+}
+
+static void *pb_write (void *arg)
+{
+  pb_writer *w = (pb_writer *) arg;
+  w->ok = edgex_putbatch_run
+    (w->batch, "dev", NULL, 1, &w->req, &w->val, w->maxops, pb_put, w->drv);
+  return NULL;
+}
+
+/*
+ * Start a write, wait until the driver is busy with it, queue the others
+ * behind it in turn, then let the driver proceed.
+ */
+
+static void pb_run
+(
+  pb_driver *drv,
+  uint32_t maxops,
+  const int32_t *values,
+  bool *results
+)
+{
+  edgex_putbatch *b = edgex_putbatch_create (0);
+  pb_writer w[PB_WRITERS];
+
+  memset (drv, 0, sizeof (pb_driver));
+  pthread_mutex_init (&drv->lock, NULL);
+  pthread_cond_init (&drv->cond, NULL);
+  memset (w, 0, sizeof (w));
+  for (unsigned i = 0; i < PB_WRITERS; i++)
+  {
+    w[i].batch = b;
+    w[i].drv = drv;
+    w[i].maxops = maxops;
+    w[i].val.type = Int32;
+    w[i].val.value.i32_result = values[i];
+    pthread_create (&w[i].thread, NULL, pb_write, &w[i]);
+    if (i == 0)
+    {
+      pthread_mutex_lock (&drv->lock);
+      while (drv->ncalls == 0)
+      {
+        pthread_cond_wait (&drv->cond, &drv->lock);
+      }
+      pthread_mutex_unlock (&drv->lock);
+    }
+    else
+    {
+      usleep (20000);
+    }
+  }
+
+  pthread_mutex_lock (&drv->lock);
+  drv->open = true;
+  pthread_cond_broadcast (&drv->cond);
+  pthread_mutex_unlock (&drv->lock);
+  for (unsigned i = 0; i < PB_WRITERS; i++)
+  {
+    pthread_join (w[i].thread, NULL);
+    results[i] = w[i].ok;
+  }
+
+  edgex_putbatch_free (b);
+  pthread_cond_destroy (&drv->cond);
+  pthread_mutex_destroy (&drv->lock);
+}
+
+static void test_coalesce (void)
+{
+  pb_driver drv;
+  const int32_t values[PB_WRITERS] = { 1, 2, 3 };
+  bool ok[PB_WRITERS];
+
+  /* Writes queued while the driver is busy are made in one call */
+
+  pb_run (&drv, 8, values, ok);
+  CU_ASSERT (drv.ncalls == 2);
+  CU_ASSERT (drv.sizes[0] == 1);
+  CU_ASSERT (drv.sizes[1] == 2);
+  CU_ASSERT (ok[0] && ok[1] && ok[2]);
+}
+
+static void test_maxops (void)
+{
+  pb_driver drv;
+  const int32_t values[PB_WRITERS] = { 1, 2, 3 };
+  bool ok[PB_WRITERS];
+
+  /* A batch may not exceed maxops requests */
+
+  pb_run (&drv, 1, values, ok);
+  CU_ASSERT (drv.ncalls == 3);
+  CU_ASSERT (drv.sizes[1] == 1);
+  CU_ASSERT (drv.sizes[2] == 1);
+  CU_ASSERT (ok[0] && ok[1] && ok[2]);
+}
+
+static void test_unlimited (void)
+{
+  pb_driver drv;
+  const int32_t values[PB_WRITERS] = { 1, 2, 3 };
+  bool ok[PB_WRITERS];
+
+  /* With MaxCmdOps unset, batches are not limited */
+
+  pb_run (&drv, 0, values, ok);
+  CU_ASSERT (drv.ncalls == 2);
+  CU_ASSERT (drv.sizes[1] == 2);
+  CU_ASSERT (ok[0] && ok[1] && ok[2]);
+}
+
+static void test_fanout (void)
+{
+  pb_driver drv;
+  const int32_t values[PB_WRITERS] = { 1, 2, PB_BAD };
+  bool ok[PB_WRITERS];
+
+  /* A failed batch is retried a write at a time, each with its own result */
+
+  pb_run (&drv, 8, values, ok);
+  CU_ASSERT (drv.ncalls == 4);
+  CU_ASSERT (drv.sizes[1] == 2);
+  CU_ASSERT (drv.sizes[2] == 1);
+  CU_ASSERT (drv.sizes[3] == 1);
+  CU_ASSERT (ok[0]);
+  CU_ASSERT (ok[1]);
+  CU_ASSERT (!ok[2]);
+}
+
+void cunit_putbatch_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("putbatch", suite_init, suite_clean);
+  CU_add_test (suite, "test_coalesce", test_coalesce);
+  CU_add_test (suite, "test_maxops", test_maxops);
+  CU_add_test (suite, "test_unlimited", test_unlimited);
+  CU_add_test (suite, "test_fanout", test_fanout);
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "readcache.h"
+#include "../src/c/readcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <microhttpd.h>
+
+static edgex_readcache *cache;
+
+/* Reads of single resources, named as their commands, and of two */
+
+static edgex_deviceresource temperature = { .name = "Temperature" };
+static edgex_deviceresource pressure = { .name = "Pressure" };
+static edgex_deviceresource humidity = { .name = "Humidity" };
+static edgex_device_commandrequest temperature_req = { NULL, &temperature };
+static edgex_device_commandrequest pressure_req = { NULL, &pressure };
+static edgex_device_commandrequest humidity_req = { NULL, &humidity };
+static edgex_device_commandrequest weather_reqs[] =
+  { { NULL, &temperature }, { NULL, &pressure } };
+static edgex_device_commandrequest climate_reqs[] =
+  { { NULL, &temperature }, { NULL, &humidity } };
+
+static int suite_init (void)
+{
+  static edgex_nvpairs shortttl = { "Pressure", "50", NULL };
+  static edgex_nvpairs ttl = { "Temperature", "60000", &shortttl };
+  cache = edgex_readcache_create (&ttl);
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  edgex_readcache_free (cache);
+  return 0;
+}
+
+static void test_uncached (void)
+{
+  edgex_strbuf out;
+  int status;
+  edgex_strbuf_init (&out);
+
+  edgex_readcache_entry *e = edgex_readcache_begin
+    (cache, "dev1", "Humidity", 1, &humidity_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, "{}", 2, MHD_HTTP_OK);
+  e = edgex_readcache_begin
+    (cache, "dev1", "Humidity", 1, &humidity_req, &out, &status);
+  CU_ASSERT (e != NULL);
+  CU_ASSERT (out.len == 0);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_OK);
+  edgex_strbuf_fini (&out);
+}
+
+static void test_ttl (void)
+{
+  edgex_strbuf out;
+  int status = 0;
+  edgex_strbuf_init (&out);
+
+  edgex_readcache_entry *e = edgex_readcache_begin
+    (cache, "dev1", "Temperature", 1, &temperature_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, "{\"t\":1}", 7, MHD_HTTP_OK);
+  e = edgex_readcache_begin
+    (cache, "dev1", "Temperature", 1, &temperature_req, &out, &status);
+  CU_ASSERT (e == NULL);
+  CU_ASSERT (status == MHD_HTTP_OK);
+  CU_ASSERT_STRING_EQUAL (out.data, "{\"t\":1}");
+
+  /* Other devices have their own results */
+
+  out.len = 0;
+  e = edgex_readcache_begin
+    (cache, "dev2", "Temperature", 1, &temperature_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_INTERNAL_SERVER_ERROR);
+
+  /* Failures are not kept */
+
+  e = edgex_readcache_begin
+    (cache, "dev2", "Temperature", 1, &temperature_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_OK);
+
+  edgex_readcache_forget (cache, "dev1");
+  e = edgex_readcache_begin
+    (cache, "dev1", "Temperature", 1, &temperature_req, &out, &status);
+  CU_ASSERT (e != NULL);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_INTERNAL_SERVER_ERROR);
+  edgex_strbuf_fini (&out);
+}
+
+static void test_expiry (void)
+{
+  edgex_strbuf out;
+  int status = 0;
+  edgex_strbuf_init (&out);
+
+  /* Results expire after their TTL, which may be less than a second */
+
+  edgex_readcache_entry *e = edgex_readcache_begin
+    (cache, "dev1", "Pressure", 1, &pressure_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, "{\"p\":1}", 7, MHD_HTTP_OK);
+  e = edgex_readcache_begin
+    (cache, "dev1", "Pressure", 1, &pressure_req, &out, &status);
+  CU_ASSERT (e == NULL);
+  usleep (100000);
+  e = edgex_readcache_begin
+    (cache, "dev1", "Pressure", 1, &pressure_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_INTERNAL_SERVER_ERROR);
+  edgex_strbuf_fini (&out);
+}
+
+static void test_resources (void)
+{
+  edgex_strbuf out;
+  int status = 0;
+  edgex_strbuf_init (&out);
+
+  /* A command is kept for the shortest time of its resources */
+
+  edgex_readcache_entry *e = edgex_readcache_begin
+    (cache, "dev4", "Weather", 2, weather_reqs, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, "{\"w\":1}", 7, MHD_HTTP_OK);
+  e = edgex_readcache_begin
+    (cache, "dev4", "Weather", 2, weather_reqs, &out, &status);
+  CU_ASSERT (e == NULL);
+  usleep (100000);
+  e = edgex_readcache_begin
+    (cache, "dev4", "Weather", 2, weather_reqs, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_INTERNAL_SERVER_ERROR);
+
+  /* and not at all if any of them is not listed */
+
+  e = edgex_readcache_begin
+    (cache, "dev4", "Climate", 2, climate_reqs, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  edgex_readcache_end (cache, e, "{\"c\":1}", 7, MHD_HTTP_OK);
+  out.len = 0;
+  e = edgex_readcache_begin
+    (cache, "dev4", "Climate", 2, climate_reqs, &out, &status);
+  CU_ASSERT (e != NULL);
+  CU_ASSERT (out.len == 0);
+  edgex_readcache_end (cache, e, NULL, 0, MHD_HTTP_OK);
+  edgex_strbuf_fini (&out);
+}
+
+typedef struct
+{
+  edgex_readcache_entry *entry;
+  edgex_strbuf out;
+  int status;
+} follower;
+
+static void *follow (void *p)
+{
+  follower *f = (follower *) p;
+  f->entry = edgex_readcache_begin
+    (cache, "dev3", "Humidity", 1, &humidity_req, &f->out, &f->status);
+  return NULL;
+}
+
+static void test_coalesce (void)
+{
+  edgex_strbuf out;
+  int status;
+  pthread_t threads[4];
+  follower f[4];
+  edgex_strbuf_init (&out);
+
+  edgex_readcache_entry *e = edgex_readcache_begin
+    (cache, "dev3", "Humidity", 1, &humidity_req, &out, &status);
+  CU_ASSERT_FATAL (e != NULL);
+  for (int i = 0; i < 4; i++)
+  {
+    edgex_strbuf_init (&f[i].out);
+    f[i].entry = NULL;
+    pthread_create (&threads[i], NULL, follow, &f[i]);
+  }
+  usleep (100000);
+  edgex_readcache_end (cache, e, "{\"h\":2}", 7, MHD_HTTP_OK);
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_join (threads[i], NULL);
+    CU_ASSERT (f[i].entry == NULL);
+    CU_ASSERT (f[i].status == MHD_HTTP_OK);
+    CU_ASSERT_STRING_EQUAL (f[i].out.data, "{\"h\":2}");
+    edgex_strbuf_fini (&f[i].out);
+  }
+  edgex_strbuf_fini (&out);
+}
+
+void cunit_readcache_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("readcache", suite_init, suite_clean);
+  CU_add_test (suite, "test_uncached", test_uncached);
+  CU_add_test (suite, "test_ttl", test_ttl);
+  CU_add_test (suite, "test_expiry", test_expiry);
+  CU_add_test (suite, "test_resources", test_resources);
+  CU_add_test (suite, "test_coalesce", test_coalesce);
+}
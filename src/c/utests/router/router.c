@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "router.h"
+#include "../src/c/router.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static edgex_router *router;
+static int ping, byid, byname, all, callback;
+
+static int suite_init (void)
+{
+  router = edgex_router_create ();
+  edgex_router_add (router, "/api/v1/ping", &ping);
+  edgex_router_add (router, "/api/v1/device/{id}/{command}", &byid);
+  edgex_router_add (router, "/api/v1/device/name/{name}/{command}", &byname);
+  edgex_router_add (router, "/api/v1/device/all/{command}", &all);
+  edgex_router_add (router, "/api/v1/callback", &callback);
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  edgex_router_free (router);
+  return 0;
+}
+
+static void *find (const char *url, edgex_http_params *params)
+{
+  static char buf[256];
+  strcpy (buf, url);
+  return edgex_router_find (router, buf, params);
+}
+
+static void test_literal (void)
+{
+  edgex_http_params params;
+  CU_ASSERT (find ("/api/v1/ping", &params) == &ping);
+  CU_ASSERT (params.n == 0);
+  CU_ASSERT (find ("//api/v1//ping/", &params) == &ping);
+  CU_ASSERT (find ("/api/v1/callback", &params) == &callback);
+  CU_ASSERT (find ("/api/v1/pong", &params) == NULL);
+  CU_ASSERT (find ("/api/v1", &params) == NULL);
+  CU_ASSERT (find ("/api/v1/ping/more", &params) == NULL);
+}
+
+static void test_params (void)
+{
+  edgex_http_params params;
+  CU_ASSERT (find ("/api/v1/device/1234/reading", &params) == &byid);
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "id"), "1234");
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "command"), "reading");
+  CU_ASSERT (edgex_http_param (&params, "name") == NULL);
+
+  CU_ASSERT (find ("/api/v1/device/name/dev1/reading", &params) == &byname);
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "name"), "dev1");
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "command"), "reading");
+  CU_ASSERT (edgex_http_param (&params, "id") == NULL);
+
+  CU_ASSERT (find ("/api/v1/device/all/reading", &params) == &all);
+  CU_ASSERT (params.n == 1);
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "command"), "reading");
+
+  CU_ASSERT (find ("/api/v1/device/1234", &params) == NULL);
+  CU_ASSERT (find ("/api/v1/device/name", &params) == NULL);
+}
+
+static void test_backtrack (void)
+{
+  edgex_http_params params;
+
+  /* "name" is tried as a literal first, then as a device id */
+
+  CU_ASSERT (find ("/api/v1/device/name/reading", &params) == &byid);
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "id"), "name");
+  CU_ASSERT_STRING_EQUAL (edgex_http_param (&params, "command"), "reading");
+}
+
+static void test_conflict (void)
+{
+  edgex_http_params params;
+  CU_ASSERT (!edgex_router_add (router, "/api/v1/device/{dev}/x", &ping));
+  CU_ASSERT (find ("/api/v1/device/1234/x", &params) == &byid);
+}
+
+void cunit_router_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("router", suite_init, suite_clean);
+  CU_add_test (suite, "test_literal", test_literal);
+  CU_add_test (suite, "test_params", test_params);
+  CU_add_test (suite, "test_backtrack", test_backtrack);
+  CU_add_test (suite, "test_conflict", test_conflict);
+}
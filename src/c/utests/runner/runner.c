@@ -2,6 +2,30 @@
 #include "../../cunit/Automated.h"
 
 #include "../base64/base64.h"
+#include "../numfmt/numfmt.h"
+#include "../transform/transform.h"
+#include "../router/router.h"
+#include "../readcache/readcache.h"
+#include "../executor/executor.h"
+#include "../timerwheel/timerwheel.h"
+#include "../stats/stats.h"
+#include "../openmetrics/openmetrics.h"
+#include "../trace/trace.h"
+#include "../logqueue/logqueue.h"
+#include "../cbor/cbor.h"
+#include "../atoms/atoms.h"
+#include "../jsonpull/jsonpull.h"
+#include "../startup/startup.h"
+#include "../confcache/confcache.h"
+#include "../serial/serial.h"
+#include "../wal/wal.h"
+#include "../aggregate/aggregate.h"
+#include "../history/history.h"
+#include "../memstats/memstats.h"
+#include "../putbatch/putbatch.h"
+#include "../postqueue/postqueue.h"
+#include "../forward/forward.h"
+#include "../profwatch/profwatch.h"
 
 #include <stdbool.h>
 
@@ -60,6 +84,30 @@ int main (int argc, char *argv[])
   }
 
   cunit_base64_test_init ();
+  cunit_numfmt_test_init ();
+  cunit_transform_test_init ();
+  cunit_router_test_init ();
+  cunit_readcache_test_init ();
+  cunit_executor_test_init ();
+  cunit_timerwheel_test_init ();
+  cunit_stats_test_init ();
+  cunit_openmetrics_test_init ();
+  cunit_trace_test_init ();
+  cunit_logqueue_test_init ();
+  cunit_cbor_test_init ();
+  cunit_atoms_test_init ();
+  cunit_jsonpull_test_init ();
+  cunit_startup_test_init ();
+  cunit_confcache_test_init ();
+  cunit_serial_test_init ();
+  cunit_wal_test_init ();
+  cunit_aggregate_test_init ();
+  cunit_history_test_init ();
+  cunit_memstats_test_init ();
+  cunit_putbatch_test_init ();
+  cunit_postqueue_test_init ();
+  cunit_forward_test_init ();
+  cunit_profwatch_test_init ();
 
   CU_set_error_action (error_action);
 
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "serial.h"
+#include "../src/c/serial.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NKEYS 4
+#define NITEMS 50
+
+typedef struct serial_work
+{
+  unsigned key;
+  unsigned seq;
+} serial_work;
+
+static unsigned active[NKEYS];
+static unsigned overlaps;
+static unsigned next[NKEYS];
+static unsigned misordered;
+static unsigned concurrent;
+static unsigned maxconcurrent;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void reset (void)
+{
+  memset (active, 0, sizeof (active));
+  memset (next, 0, sizeof (next));
+  overlaps = misordered = concurrent = maxconcurrent = 0;
+}
+
+static void work (void *arg)
+{
+  serial_work *w = (serial_work *) arg;
+
+  if (__atomic_add_fetch (&active[w->key], 1, __ATOMIC_SEQ_CST) != 1)
+  {
+    __atomic_add_fetch (&overlaps, 1, __ATOMIC_SEQ_CST);
+  }
+  unsigned now = __atomic_add_fetch (&concurrent, 1, __ATOMIC_SEQ_CST);
+  unsigned max = __atomic_load_n (&maxconcurrent, __ATOMIC_SEQ_CST);
+  while (now > max &&
+    !__atomic_compare_exchange_n
+      (&maxconcurrent, &max, now, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+  if (w->seq != UINT32_MAX)
+  {
+    if (next[w->key] != w->seq)
+    {
+      __atomic_add_fetch (&misordered, 1, __ATOMIC_SEQ_CST);
+    }
+    next[w->key] = w->seq + 1;
+  }
+  usleep (500);
+  __atomic_sub_fetch (&concurrent, 1, __ATOMIC_SEQ_CST);
+  __atomic_sub_fetch (&active[w->key], 1, __ATOMIC_SEQ_CST);
+}
+
+static const char *keyname (unsigned k)
+{
+  static const char *names[NKEYS] = { "bus0", "bus1", "bus2", "bus3" };
+  return names[k];
+}
+
+static void test_submit (void)
+{
+  static serial_work items[NKEYS][NITEMS];
+  edgex_executor *ex = edgex_executor_create (8, NULL, NULL, 0);
+  edgex_serial *s = edgex_serial_create (ex);
+
+  reset ();
+  for (unsigned i = 0; i < NITEMS; i++)
+  {
+    for (unsigned k = 0; k < NKEYS; k++)
+    {
+      items[k][i].key = k;
+      items[k][i].seq = i;
+      edgex_serial_submit (s, keyname (k), work, &items[k][i]);
+    }
+  }
+  edgex_executor_wait (ex);
+
+  CU_ASSERT (overlaps == 0);
+  CU_ASSERT (misordered == 0);
+  for (unsigned k = 0; k < NKEYS; k++)
+  {
+    CU_ASSERT (next[k] == NITEMS);
+  }
+  CU_ASSERT (maxconcurrent > 1);
+  CU_ASSERT (maxconcurrent <= NKEYS);
+
+  edgex_executor_free (ex);
+  edgex_serial_free (s);
+}
+
+typedef struct serial_caller
+{
+  edgex_serial *s;
+  serial_work w;
+} serial_caller;
+
+static void direct (void *arg)
+{
+  serial_caller *c = (serial_caller *) arg;
+  for (unsigned i = 0; i < NITEMS / 5; i++)
+  {
+    edgex_serial_run (c->s, keyname (c->w.key), work, &c->w);
+  }
+}
+
+static void test_run (void)
+{
+  static serial_work items[NITEMS];
+  serial_caller callers[4];
+  edgex_executor *ex = edgex_executor_create (8, NULL, NULL, 0);
+  edgex_serial *s = edgex_serial_create (ex);
+
+  reset ();
+
+  /* Direct callers for one key race with work queued for it */
+
+  for (unsigned i = 0; i < 4; i++)
+  {
+    callers[i].s = s;
+    callers[i].w.key = 0;
+    callers[i].w.seq = UINT32_MAX;
+    edgex_executor_submit (ex, EDGEX_EXEC_DISCOVERY, direct, &callers[i]);
+  }
+  for (unsigned i = 0; i < NITEMS; i++)
+  {
+    items[i].key = 0;
+    items[i].seq = i;
+    edgex_serial_submit (s, keyname (0), work, &items[i]);
+  }
+  edgex_executor_wait (ex);
+
+  CU_ASSERT (overlaps == 0);
+  CU_ASSERT (misordered == 0);
+  CU_ASSERT (next[0] == NITEMS);
+  CU_ASSERT (maxconcurrent == 1);
+
+  edgex_executor_free (ex);
+  edgex_serial_free (s);
+}
+
+void cunit_serial_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("serial", suite_init, suite_clean);
+  CU_add_test (suite, "test_submit", test_submit);
+  CU_add_test (suite, "test_run", test_run);
+}
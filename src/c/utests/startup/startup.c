@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "startup.h"
+#include "../src/c/startup.h"
+#include "../src/c/errorlist.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static edgex_executor *ex;
+
+/* Record of the order in which the steps ran */
+
+typedef struct testRun
+{
+  unsigned order[EDGEX_STARTUP_MAXSTEPS];
+  unsigned count;
+  unsigned active;
+  unsigned maxactive;
+  int fail;
+} testRun;
+
+static testRun run;
+
+static int suite_init (void)
+{
+  ex = edgex_executor_create (4, NULL, NULL, 0);
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  edgex_executor_free (ex);
+  return 0;
+}
+
+static void record (unsigned id, edgex_error *err)
+{
+  unsigned now = __atomic_add_fetch (&run.active, 1, __ATOMIC_SEQ_CST);
+  unsigned max = __atomic_load_n (&run.maxactive, __ATOMIC_SEQ_CST);
+  while (now > max &&
+    !__atomic_compare_exchange_n
+      (&run.maxactive, &max, now, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+  usleep (20000);
+  __atomic_sub_fetch (&run.active, 1, __ATOMIC_SEQ_CST);
+  unsigned i = __atomic_fetch_add (&run.count, 1, __ATOMIC_SEQ_CST);
+  run.order[i] = id;
+  if ((int) id == run.fail)
+  {
+    *err = EDGEX_REMOTE_SERVER_DOWN;
+  }
+}
+
+#define STEP(n) \
+  static void step##n (void *arg, edgex_error *err) { record (n, err); }
+
+STEP (0)
+STEP (1)
+STEP (2)
+STEP (3)
+STEP (4)
+
+static int position (unsigned id)
+{
+  for (unsigned i = 0; i < run.count; i++)
+  {
+    if (run.order[i] == id)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void reset (int fail)
+{
+  memset (&run, 0, sizeof (run));
+  run.fail = fail;
+}
+
+#define AFTER EDGEX_STARTUP_AFTER
+
+static void test_order (void)
+{
+  edgex_startup_step steps[] =
+  {
+    { "a", step0, AFTER (2) },
+    { "b", step1, 0 },
+    { "c", step2, AFTER (1) },
+    { "d", step3, AFTER (0) | AFTER (1) },
+    { "e", step4, 0 }
+  };
+  uint64_t elapsed[5];
+  edgex_error err;
+
+  reset (-1);
+  edgex_startup_run (ex, steps, 5, NULL, elapsed, &err);
+  CU_ASSERT (err.code == 0);
+  CU_ASSERT (run.count == 5);
+  CU_ASSERT (position (1) < position (2));
+  CU_ASSERT (position (2) < position (0));
+  CU_ASSERT (position (0) < position (3));
+  for (unsigned i = 0; i < 5; i++)
+  {
+    CU_ASSERT (elapsed[i] >= 10000000);
+  }
+}
+
+static void test_parallel (void)
+{
+  edgex_startup_step steps[] =
+  {
+    { "a", step0, 0 },
+    { "b", step1, 0 },
+    { "c", step2, 0 },
+    { "d", step3, AFTER (0) | AFTER (1) | AFTER (2) }
+  };
+  edgex_error err;
+
+  reset (-1);
+  edgex_startup_run (ex, steps, 4, NULL, NULL, &err);
+  CU_ASSERT (err.code == 0);
+  CU_ASSERT (run.count == 4);
+  CU_ASSERT (run.maxactive > 1);
+  CU_ASSERT (position (3) == 3);
+}
+
+static void test_fail (void)
+{
+  edgex_startup_step steps[] =
+  {
+    { "a", step0, 0 },
+    { "b", step1, AFTER (0) },
+    { "c", step2, AFTER (1) },
+    { "d", step3, 0 }
+  };
+  uint64_t elapsed[4];
+  edgex_error err;
+
+  reset (1);
+  edgex_startup_run (ex, steps, 4, NULL, elapsed, &err);
+  CU_ASSERT (err.code == EDGEX_REMOTE_SERVER_DOWN.code);
+  CU_ASSERT (position (2) == -1);
+  CU_ASSERT (position (3) != -1);
+  CU_ASSERT (elapsed[2] == 0);
+}
+
+static void test_skip (void)
+{
+  edgex_startup_step steps[] =
+  {
+    { "a", NULL, 0 },
+    { "b", step1, AFTER (0) },
+    { "c", step2, AFTER (3) },
+    { "d", step3, AFTER (2) }
+  };
+  edgex_error err;
+
+  reset (-1);
+  edgex_startup_run (ex, steps, 2, NULL, NULL, &err);
+  CU_ASSERT (err.code == 0);
+  CU_ASSERT (run.count == 1 && position (1) == 0);
+
+  reset (-1);
+  edgex_startup_run (ex, steps, 4, NULL, NULL, &err);
+  CU_ASSERT (err.code == EDGEX_INVALID_ARG.code);
+  CU_ASSERT (run.count == 1);
+}
+
+void cunit_startup_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("startup", suite_init, suite_clean);
+  CU_add_test (suite, "test_order", test_order);
+  CU_add_test (suite, "test_parallel", test_parallel);
+  CU_add_test (suite, "test_fail", test_fail);
+  CU_add_test (suite, "test_skip", test_skip);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "stats.h"
+#include "../src/c/stats.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Statistics are cumulative, so each test compares before and after */
+
+static JSON_Value *snapshot (void)
+{
+  JSON_Value *val = json_value_init_object ();
+  edgex_stats_metrics (json_value_get_object (val));
+  return val;
+}
+
+static double stat (JSON_Value *val, const char *name)
+{
+  return json_object_dotget_number (json_value_get_object (val), name);
+}
+
+static void *count_thread (void *arg)
+{
+  for (int i = 0; i < 1000; i++)
+  {
+    edgex_stats_count (EDGEX_STATS_HTTP_REQUESTS, 1);
+  }
+  return NULL;
+}
+
+static void test_counters (void)
+{
+  pthread_t threads[4];
+  JSON_Value *before = snapshot ();
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_create (&threads[i], NULL, count_thread, NULL);
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_join (threads[i], NULL);
+  }
+
+  /* Blocks of exited threads are reused */
+
+  pthread_create (&threads[0], NULL, count_thread, NULL);
+  pthread_join (threads[0], NULL);
+
+  JSON_Value *after = snapshot ();
+  CU_ASSERT
+  (
+    stat (after, "Counters.HttpRequests") -
+    stat (before, "Counters.HttpRequests") == 5000
+  );
+  json_value_free (before);
+  json_value_free (after);
+}
+
+static void test_percentiles (void)
+{
+  for (uint64_t i = 1; i <= 1000; i++)
+  {
+    edgex_stats_time (EDGEX_STATS_DATA_POST, i * 1000000);
+  }
+  JSON_Value *val = snapshot ();
+  double p50 = stat (val, "Latency.DataPost.P50");
+  double p99 = stat (val, "Latency.DataPost.P99");
+  CU_ASSERT (stat (val, "Latency.DataPost.Count") == 1000);
+  CU_ASSERT (stat (val, "Latency.DataPost.Max") == 1000);
+  CU_ASSERT (stat (val, "Latency.DataPost.Mean") == 500.5);
+  CU_ASSERT (p50 >= 500 && p50 <= 500 * 1.125);
+  CU_ASSERT (p99 >= 990 && p99 <= 1000);
+  json_value_free (val);
+}
+
+static void test_calls (void)
+{
+  edgex_stats_calls c = { 0, 0, 0 };
+  edgex_stats_calls_note (&c, true, 1000000);
+  edgex_stats_calls_note (&c, false, 3000000);
+  JSON_Value *val = edgex_stats_calls_json (&c);
+  JSON_Object *obj = json_value_get_object (val);
+  CU_ASSERT (json_object_get_number (obj, "Calls") == 2);
+  CU_ASSERT (json_object_get_number (obj, "Failures") == 1);
+  CU_ASSERT (json_object_get_number (obj, "MeanTime") == 2.0);
+  json_value_free (val);
+}
+
+void cunit_stats_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("stats", suite_init, suite_clean);
+  CU_add_test (suite, "test_counters", test_counters);
+  CU_add_test (suite, "test_percentiles", test_percentiles);
+  CU_add_test (suite, "test_calls", test_calls);
+}
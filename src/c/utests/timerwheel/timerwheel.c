@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "timerwheel.h"
+#include "../src/c/timerwheel.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MS 1000000ULL
+
+static unsigned counter;
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+static void count (void *arg)
+{
+  __atomic_fetch_add (&counter, 1, __ATOMIC_SEQ_CST);
+}
+
+static void slow (void *arg)
+{
+  __atomic_fetch_add (&counter, 1, __ATOMIC_SEQ_CST);
+  usleep (20000);
+}
+
+static double schedule_stat (edgex_timerwheel *w, const char *name)
+{
+  JSON_Value *val = json_value_init_object ();
+  edgex_timerwheel_metrics (w, json_value_get_object (val));
+  JSON_Array *arr = json_object_get_array (json_value_get_object (val), "Schedules");
+  double result = -1;
+  if (arr && json_array_get_count (arr) == 1)
+  {
+    result = json_object_get_number (json_array_get_object (arr, 0), name);
+  }
+  json_value_free (val);
+  return result;
+}
+
+static void test_periodic (void)
+{
+  edgex_executor *ex = edgex_executor_create (2, NULL, NULL, 0);
+  edgex_timerwheel *w = edgex_timerwheel_create (ex);
+  counter = 0;
+  edgex_timerwheel_add (w, "fast", 5 * MS, EDGEX_EXEC_COMMAND, count, NULL);
+  edgex_timerwheel_start (w);
+  usleep (102000);
+  edgex_timerwheel_stop (w);
+  edgex_executor_free (ex);
+  CU_ASSERT (counter >= 15 && counter <= 21);
+  CU_ASSERT (schedule_stat (w, "Runs") == counter);
+  CU_ASSERT (schedule_stat (w, "Interval") == 5.0);
+  edgex_timerwheel_free (w);
+}
+
+static void test_remove (void)
+{
+  edgex_executor *ex = edgex_executor_create (2, NULL, NULL, 0);
+  edgex_timerwheel *w = edgex_timerwheel_create (ex);
+  counter = 0;
+  edgex_timer *t = edgex_timerwheel_add
+    (w, "removed", 2 * MS, EDGEX_EXEC_COMMAND, count, NULL);
+  edgex_timerwheel_start (w);
+  usleep (20000);
+  edgex_timerwheel_remove (w, t);
+  edgex_executor_wait (ex);
+  unsigned n = __atomic_load_n (&counter, __ATOMIC_SEQ_CST);
+  CU_ASSERT (n > 0);
+  usleep (20000);
+  CU_ASSERT (__atomic_load_n (&counter, __ATOMIC_SEQ_CST) == n);
+  CU_ASSERT (schedule_stat (w, "Runs") == -1);
+  edgex_timerwheel_free (w);
+  edgex_executor_free (ex);
+}
+
+static void test_overrun (void)
+{
+  edgex_executor *ex = edgex_executor_create (2, NULL, NULL, 0);
+  edgex_timerwheel *w = edgex_timerwheel_create (ex);
+  counter = 0;
+  edgex_timerwheel_add (w, "slow", 5 * MS, EDGEX_EXEC_COMMAND, slow, NULL);
+  edgex_timerwheel_start (w);
+  usleep (100000);
+  edgex_timerwheel_stop (w);
+  edgex_executor_free (ex);
+
+  /* Runs do not overlap: those falling due while the timer is busy are missed */
+
+  CU_ASSERT (counter >= 3 && counter <= 6);
+  CU_ASSERT (schedule_stat (w, "Missed") >= 10);
+  edgex_timerwheel_free (w);
+}
+
+void cunit_timerwheel_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("timerwheel", suite_init, suite_clean);
+  CU_add_test (suite, "test_periodic", test_periodic);
+  CU_add_test (suite, "test_remove", test_remove);
+  CU_add_test (suite, "test_overrun", test_overrun);
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "trace.h"
+#include "../src/c/trace.h"
+#include "../src/c/parson.h"
+
+#include <string.h>
+#include <pthread.h>
+
+static int suite_init (void)
+{
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+#if CSDK_BUILD_TRACE
+
+/* Count the exported spans of a trace, checking they are well formed */
+
+static unsigned count_chrome (uint64_t trace, const char *name)
+{
+  unsigned n = 0;
+  edgex_strbuf b;
+  edgex_strbuf_init (&b);
+  edgex_trace_export (&b, EDGEX_TRACE_CHROME, "test");
+  JSON_Value *val = json_parse_string (b.data);
+  CU_ASSERT_FATAL (val != NULL);
+  JSON_Array *events =
+    json_object_get_array (json_value_get_object (val), "traceEvents");
+  for (size_t i = 0; i < json_array_get_count (events); i++)
+  {
+    JSON_Object *ev = json_array_get_object (events, i);
+    if
+    (
+      json_object_dotget_number (ev, "args.trace") == trace &&
+      strcmp (json_object_get_string (ev, "name"), name) == 0
+    )
+    {
+      CU_ASSERT (json_object_get_number (ev, "dur") >= 0);
+      n++;
+    }
+  }
+  json_value_free (val);
+  edgex_strbuf_fini (&b);
+  return n;
+}
+
+static void test_spans (void)
+{
+  uint64_t trace = edgex_trace_root ();
+  CU_ASSERT (edgex_trace_current () == trace);
+  uint64_t start = edgex_device_monotime ();
+  edgex_trace_span (EDGEX_TRACE_DRIVER_GET, start, "dev1");
+  edgex_trace_span (EDGEX_TRACE_DRIVER_GET, start, "dev2");
+  edgex_trace_span (EDGEX_TRACE_COMMAND, start, NULL);
+  CU_ASSERT (count_chrome (trace, "driver.get") == 2);
+  CU_ASSERT (count_chrome (trace, "command") == 1);
+  CU_ASSERT (count_chrome (trace, "post") == 0);
+}
+
+static void test_otlp (void)
+{
+  edgex_strbuf b;
+  uint64_t trace = edgex_trace_root ();
+  edgex_trace_span (EDGEX_TRACE_POST, edgex_device_monotime (), "a\"b");
+  edgex_strbuf_init (&b);
+  edgex_trace_export (&b, EDGEX_TRACE_OTLP, "test");
+  JSON_Value *val = json_parse_string (b.data);
+  CU_ASSERT_FATAL (val != NULL);
+  JSON_Object *obj = json_value_get_object (val);
+  JSON_Array *rs = json_object_get_array (obj, "resourceSpans");
+  JSON_Object *scope = json_array_get_object
+    (json_object_get_array (json_array_get_object (rs, 0), "scopeSpans"), 0);
+  JSON_Array *spans = json_object_get_array (scope, "spans");
+  CU_ASSERT (json_array_get_count (spans) > 0);
+  JSON_Object *last = json_array_get_object (spans, 0);
+  for (size_t i = 0; i < json_array_get_count (spans); i++)
+  {
+    JSON_Object *s = json_array_get_object (spans, i);
+    CU_ASSERT (strlen (json_object_get_string (s, "traceId")) == 32);
+    CU_ASSERT (strlen (json_object_get_string (s, "spanId")) == 16);
+    if (strcmp (json_object_get_string (s, "name"), "post") == 0)
+    {
+      last = s;
+    }
+  }
+  char id[33];
+  snprintf (id, sizeof (id), "%032llx", (unsigned long long) trace);
+  CU_ASSERT (strcmp (json_object_get_string (last, "traceId"), id) == 0);
+  json_value_free (val);
+  edgex_strbuf_fini (&b);
+}
+
+/* Spans written while a trace is exported are either complete or omitted */
+
+static bool running;
+
+static void *span_thread (void *arg)
+{
+  edgex_trace_root ();
+  while (__atomic_load_n (&running, __ATOMIC_RELAXED))
+  {
+    edgex_trace_span (EDGEX_TRACE_EVENT, edgex_device_monotime (), "device-name");
+  }
+  return NULL;
+}
+
+static void test_concurrent (void)
+{
+  pthread_t threads[2];
+  running = true;
+  for (int i = 0; i < 2; i++)
+  {
+    pthread_create (&threads[i], NULL, span_thread, NULL);
+  }
+  for (int i = 0; i < 20; i++)
+  {
+    edgex_strbuf b;
+    edgex_strbuf_init (&b);
+    edgex_trace_export (&b, EDGEX_TRACE_CHROME, "test");
+    JSON_Value *val = json_parse_string (b.data);
+    CU_ASSERT (val != NULL);
+    json_value_free (val);
+    edgex_strbuf_fini (&b);
+  }
+  __atomic_store_n (&running, false, __ATOMIC_RELAXED);
+  for (int i = 0; i < 2; i++)
+  {
+    pthread_join (threads[i], NULL);
+  }
+}
+
+#endif
+
+void cunit_trace_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("trace", suite_init, suite_clean);
+#if CSDK_BUILD_TRACE
+  CU_add_test (suite, "test_spans", test_spans);
+  CU_add_test (suite, "test_otlp", test_otlp);
+  CU_add_test (suite, "test_concurrent", test_concurrent);
+#else
+  (void) suite;
+#endif
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "transform.h"
+#include "../src/c/transform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NVALUES 300
+#define NPROPS 6
+
+static edgex_propertyvalue props[NPROPS];
+static edgex_deviceresource resources[NVALUES];
+static edgex_profileproperty properties[NVALUES];
+static edgex_device_commandrequest reqs[NVALUES];
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static uint64_t rnd (void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+static void setArg (edgex_transformArg *arg, int64_t val)
+{
+  arg->enabled = true;
+  arg->value.ival = val;
+}
+
+static int suite_init (void)
+{
+  memset (props, 0, sizeof (props));
+  setArg (&props[1].mask, 0x0ff0);
+  setArg (&props[1].shift, 4);
+  setArg (&props[2].scale, 3);
+  setArg (&props[2].offset, -100);
+  setArg (&props[3].shift, -2);
+  setArg (&props[3].scale, 1000);
+  setArg (&props[4].base, 2);
+  setArg (&props[4].mask, 0x1f);
+  props[5] = props[2];
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  return 0;
+}
+
+/* Assign properties in runs, so that the batch sees groups of varying size */
+
+static void setupRequests (edgex_propertytype type)
+{
+  int p = 0;
+  for (int i = 0; i < NVALUES; i++)
+  {
+    if (rnd () % 16 == 0)
+    {
+      p = rnd () % NPROPS;
+    }
+    props[p].type = type;
+    properties[i].value = &props[p];
+    resources[i].properties = &properties[i];
+    reqs[i].devobj = &resources[i];
+  }
+}
+
+static void setValue (edgex_device_resultvalue *v, edgex_propertytype type)
+{
+  uint64_t r = rnd ();
+  memset (v, 0, sizeof (*v));
+  switch (type)
+  {
+    case Uint8: v->ui8_result = r; break;
+    case Uint16: v->ui16_result = r; break;
+    case Uint32: v->ui32_result = r; break;
+    case Int8: v->i8_result = r; break;
+    case Int16: v->i16_result = r; break;
+    case Int32: v->i32_result = r; break;
+    case Uint64: v->ui64_result = r; break;
+    case Int64: v->i64_result = r; break;
+    case Float32: v->f32_result = (float)(r % 100000) / 8; break;
+    case Float64: v->f64_result = (double)r / 1024; break;
+    default: break;
+  }
+}
+
+static void test_integers (void)
+{
+  edgex_propertytype types[] = { Uint8, Uint16, Uint32, Int8, Int16, Int32 };
+  edgex_device_resultvalue batch[NVALUES];
+  edgex_device_resultvalue scalar[NVALUES];
+  bool ok[NVALUES];
+
+  for (int t = 0; t < sizeof (types) / sizeof (types[0]); t++)
+  {
+    setupRequests (types[t]);
+    for (int i = 0; i < NVALUES; i++)
+    {
+      setValue (&batch[i], types[t]);
+    }
+    memcpy (scalar, batch, sizeof (batch));
+
+    edgex_transform_batch (NVALUES, reqs, batch, ok);
+    for (int i = 0; i < NVALUES; i++)
+    {
+      const edgex_propertyvalue *pv = reqs[i].devobj->properties->value;
+      bool sok = edgex_transform_enabled (pv) ?
+        edgex_transform_value (&scalar[i], pv) : true;
+      CU_ASSERT (ok[i] == sok);
+      CU_ASSERT (memcmp (&batch[i], &scalar[i], sizeof (batch[i])) == 0);
+    }
+  }
+}
+
+static void test_float_overflow (void)
+{
+  edgex_propertyvalue fprops;
+  edgex_device_resultvalue vals[2];
+  bool ok[2];
+
+  memset (&fprops, 0, sizeof (fprops));
+  fprops.type = Float32;
+  fprops.scale.enabled = true;
+  fprops.scale.value.dval = 1e30;
+  for (int i = 0; i < 2; i++)
+  {
+    properties[i].value = &fprops;
+    resources[i].properties = &properties[i];
+    reqs[i].devobj = &resources[i];
+  }
+  vals[0].f32_result = 2.0f;
+  vals[1].f32_result = 1e10f;
+
+  edgex_transform_batch (2, reqs, vals, ok);
+  CU_ASSERT (ok[0]);
+  CU_ASSERT (vals[0].f32_result == 2e30f);
+  CU_ASSERT (!ok[1]);
+  CU_ASSERT (vals[1].f32_result == 1e10f);
+}
+
+/* The specialised kernels give the same results as edgex_transform_value */
+
+static void test_kernels (void)
+{
+  edgex_propertytype types[] =
+    { Uint8, Uint16, Uint32, Uint64, Int8, Int16, Int32, Int64 };
+  edgex_propertyvalue fprops[3];
+  edgex_device_resultvalue kval;
+  edgex_device_resultvalue sval;
+
+  for (int t = 0; t < sizeof (types) / sizeof (types[0]); t++)
+  {
+    for (int p = 0; p < NPROPS; p++)
+    {
+      props[p].type = types[t];
+      edgex_transform_select (&props[p]);
+      CU_ASSERT ((props[p].xform == 0) == (p == 0));
+      for (int i = 0; i < 50; i++)
+      {
+        setValue (&kval, types[t]);
+        sval = kval;
+        bool kok = edgex_transform_kernels[props[p].xform] (&kval, &props[p]);
+        bool sok = (p == 0) ? true : edgex_transform_value (&sval, &props[p]);
+        CU_ASSERT (kok == sok);
+        CU_ASSERT (memcmp (&kval, &sval, sizeof (kval)) == 0);
+      }
+    }
+  }
+
+  memset (fprops, 0, sizeof (fprops));
+  fprops[0].scale.enabled = true;
+  fprops[0].scale.value.dval = 0.1;
+  fprops[1].offset.enabled = true;
+  fprops[1].offset.value.dval = -273.15;
+  fprops[2].scale = fprops[0].scale;
+  fprops[2].offset = fprops[1].offset;
+  for (int t = Float32; t <= Float64; t++)
+  {
+    for (int p = 0; p < 3; p++)
+    {
+      fprops[p].type = t;
+      edgex_transform_select (&fprops[p]);
+      for (int i = 0; i < 50; i++)
+      {
+        setValue (&kval, t);
+        sval = kval;
+        CU_ASSERT
+          (edgex_transform_kernels[fprops[p].xform] (&kval, &fprops[p]));
+        CU_ASSERT (edgex_transform_value (&sval, &fprops[p]));
+        CU_ASSERT (memcmp (&kval, &sval, sizeof (kval)) == 0);
+      }
+    }
+  }
+}
+
+void cunit_transform_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("transform", suite_init, suite_clean);
+  CU_add_test (suite, "test_integers", test_integers);
+  CU_add_test (suite, "test_float_overflow", test_float_overflow);
+  CU_add_test (suite, "test_kernels", test_kernels);
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "CUnit.h"
+#include "wal.h"
+#include "../src/c/wal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define SEGSIZE 4096
+#define NTHREADS 4
+#define NAPPENDS 50
+
+static char dir[PATH_MAX];
+
+/* Records replayed, as "tag:data" */
+
+static char seen[1024][32];
+static unsigned nseen;
+static unsigned accept;
+
+static void clear_dir (void)
+{
+  char path[PATH_MAX];
+  struct dirent *ent;
+  DIR *d = opendir (dir);
+  if (d)
+  {
+    while ((ent = readdir (d)))
+    {
+      if (ent->d_name[0] != '.')
+      {
+        snprintf (path, sizeof (path), "%s/%s", dir, ent->d_name);
+        unlink (path);
+      }
+    }
+    closedir (d);
+  }
+}
+
+static int suite_init (void)
+{
+  snprintf (dir, sizeof (dir), "/tmp/wal-test-%d", (int) getpid ());
+  return 0;
+}
+
+static int suite_clean (void)
+{
+  clear_dir ();
+  rmdir (dir);
+  return 0;
+}
+
+static bool note (void *arg, uint32_t tag, const void *data, size_t len)
+{
+  if (accept == 0 || nseen == 1024)
+  {
+    return false;
+  }
+  accept--;
+  snprintf (seen[nseen++], 32, "%u:%.*s", tag, (int) len, (const char *) data);
+  return true;
+}
+
+static void append_n (edgex_wal *w, unsigned from, unsigned to)
+{
+  char rec[32];
+  for (unsigned i = from; i < to; i++)
+  {
+    int n = snprintf (rec, sizeof (rec), "record-%u", i);
+    CU_ASSERT (edgex_wal_append (w, i % 3, rec, n));
+  }
+}
+
+static bool seen_is (unsigned i, unsigned rec)
+{
+  char expect[32];
+  snprintf (expect, sizeof (expect), "%u:record-%u", rec % 3, rec);
+  return strcmp (seen[i], expect) == 0;
+}
+
+static void test_replay (void)
+{
+  edgex_wal_stats stats;
+
+  clear_dir ();
+  edgex_wal *w = edgex_wal_open (dir, SEGSIZE, 64 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  CU_ASSERT (!edgex_wal_append (w, 0, "", 0));
+  CU_ASSERT (!edgex_wal_append (w, 0, dir, SEGSIZE));
+
+  /* Enough records to fill several segments */
+
+  append_n (w, 0, 500);
+  edgex_wal_getstats (w, &stats);
+  CU_ASSERT (stats.records == 500);
+  CU_ASSERT (stats.appended == 500);
+  CU_ASSERT (stats.bytes > SEGSIZE);
+
+  nseen = 0;
+  accept = 100;
+  CU_ASSERT (edgex_wal_replay (w, 1000, note, NULL) == 100);
+  accept = 1000;
+  CU_ASSERT (edgex_wal_replay (w, 150, note, NULL) == 150);
+  CU_ASSERT (edgex_wal_replay (w, 1000, note, NULL) == 250);
+  CU_ASSERT (edgex_wal_replay (w, 1000, note, NULL) == 0);
+  CU_ASSERT_FATAL (nseen == 500);
+  bool ordered = true;
+  for (unsigned i = 0; i < 500; i++)
+  {
+    ordered = ordered && seen_is (i, i);
+  }
+  CU_ASSERT (ordered);
+
+  /* Consumed segments are removed, other than the one being written */
+
+  edgex_wal_getstats (w, &stats);
+  CU_ASSERT (stats.records == 0);
+  CU_ASSERT (stats.bytes == SEGSIZE);
+  edgex_wal_close (w);
+}
+
+static void test_reopen (void)
+{
+  edgex_wal_stats stats;
+
+  clear_dir ();
+  edgex_wal *w = edgex_wal_open (dir, SEGSIZE, 64 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  append_n (w, 0, 300);
+  nseen = 0;
+  accept = 120;
+  CU_ASSERT (edgex_wal_replay (w, 1000, note, NULL) == 120);
+  edgex_wal_close (w);
+
+  /* Replay continues from where it stopped, after records appended later */
+
+  w = edgex_wal_open (dir, SEGSIZE, 64 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  edgex_wal_getstats (w, &stats);
+  CU_ASSERT (stats.records == 180);
+  append_n (w, 300, 310);
+  nseen = 0;
+  accept = 1000;
+  CU_ASSERT (edgex_wal_replay (w, 1000, note, NULL) == 190);
+  CU_ASSERT_FATAL (nseen == 190);
+  bool ordered = true;
+  for (unsigned i = 0; i < 190; i++)
+  {
+    ordered = ordered && seen_is (i, i + 120);
+  }
+  CU_ASSERT (ordered);
+  edgex_wal_close (w);
+}
+
+static void test_evict (void)
+{
+  edgex_wal_stats stats;
+
+  clear_dir ();
+  edgex_wal *w = edgex_wal_open (dir, SEGSIZE, 4 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  append_n (w, 0, 1000);
+  edgex_wal_getstats (w, &stats);
+  CU_ASSERT (stats.bytes <= 4 * SEGSIZE);
+  CU_ASSERT (stats.evicted > 0);
+  CU_ASSERT (stats.records + stats.evicted == 1000);
+
+  /* The newest records are kept */
+
+  nseen = 0;
+  accept = 1000;
+  unsigned n = edgex_wal_replay (w, 1000, note, NULL);
+  CU_ASSERT (n == stats.records);
+  CU_ASSERT (n && seen_is (n - 1, 999));
+  CU_ASSERT (n && seen_is (0, 1000 - n));
+  edgex_wal_close (w);
+}
+
+static void test_torn (void)
+{
+  char path[PATH_MAX];
+
+  clear_dir ();
+  edgex_wal *w = edgex_wal_open (dir, SEGSIZE, 64 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  append_n (w, 0, 10);
+  edgex_wal_close (w);
+
+  /* Corrupt the last byte of the last record */
+
+  snprintf (path, sizeof (path), "%s/%020u.wal", dir, 0);
+  FILE *f = fopen (path, "r+");
+  CU_ASSERT_FATAL (f != NULL);
+  size_t off = 10 * 12 + strlen ("record-0") * 10 - 1;
+  fseek (f, off, SEEK_SET);
+  fputc ('X', f);
+  fclose (f);
+
+  w = edgex_wal_open (dir, SEGSIZE, 64 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  append_n (w, 10, 12);
+  nseen = 0;
+  accept = 1000;
+  CU_ASSERT (edgex_wal_replay (w, 1000, note, NULL) == 11);
+  CU_ASSERT (nseen == 11 && seen_is (8, 8) && seen_is (9, 10));
+  edgex_wal_close (w);
+}
+
+static unsigned failures;
+
+static void *appender (void *p)
+{
+  edgex_wal *w = (edgex_wal *) p;
+  for (unsigned i = 0; i < NAPPENDS; i++)
+  {
+    if (!edgex_wal_append (w, 1, "concurrent", 10))
+    {
+      __atomic_add_fetch (&failures, 1, __ATOMIC_RELAXED);
+    }
+  }
+  return NULL;
+}
+
+static void test_group (void)
+{
+  pthread_t threads[NTHREADS];
+  edgex_wal_stats stats;
+
+  clear_dir ();
+  edgex_wal *w = edgex_wal_open (dir, SEGSIZE, 64 * SEGSIZE);
+  CU_ASSERT_FATAL (w != NULL);
+  for (unsigned i = 0; i < NTHREADS; i++)
+  {
+    pthread_create (&threads[i], NULL, appender, w);
+  }
+  for (unsigned i = 0; i < NTHREADS; i++)
+  {
+    pthread_join (threads[i], NULL);
+  }
+  CU_ASSERT (failures == 0);
+  edgex_wal_getstats (w, &stats);
+  CU_ASSERT (stats.records == NTHREADS * NAPPENDS);
+  CU_ASSERT (stats.syncs <= NTHREADS * NAPPENDS);
+  edgex_wal_close (w);
+}
+
+void cunit_wal_test_init (void)
+{
+  CU_pSuite suite = CU_add_suite ("wal", suite_init, suite_clean);
+  CU_add_test (suite, "test_replay", test_replay);
+  CU_add_test (suite, "test_reopen", test_reopen);
+  CU_add_test (suite, "test_evict", test_evict);
+  CU_add_test (suite, "test_torn", test_torn);
+  CU_add_test (suite, "test_group", test_group);
+}
@@ -0,0 +1,573 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "wal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * A record is a header of three words, giving the length of its data, its
+ * tag and a check value over both, followed by the data. Segments are
+ * allocated in full when created, so that writing to the mapping cannot
+ * fail for lack of space, and are zero-filled: a zero length marks where
+ * the records in a segment end. Segment files are named by sequence number.
+ */
+
+#define WAL_HDR (3 * sizeof (uint32_t))
+#define WAL_EXT ".wal"
+#define WAL_POSITION "position"
+
+typedef struct wal_segment
+{
+  uint64_t seq;
+  char *map;
+  size_t size;
+  size_t used;
+  size_t synced;
+  uint64_t nrecs;
+  unsigned refs;
+  bool dropped;
+  struct wal_segment *next;
+} wal_segment;
+
+/* Part of a segment to be synced */
+
+typedef struct wal_range
+{
+  wal_segment *seg;
+  size_t from;
+  size_t to;
+} wal_range;
+
+/*
+ * Records are read from the head segment and appended to the tail. Each
+ * append takes a ticket; the sync which commits it sets committed to at
+ * least that ticket, and failed is the last ticket of a sync that failed.
+ * A segment is referenced while a sync outside the lock is using it, and
+ * unmapped once the last reference goes if it was removed meanwhile.
+ */
+
+struct edgex_wal
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  char *dir;
+  size_t segsize;
+  size_t pagesize;
+  unsigned maxsegs;
+  unsigned nsegs;
+  wal_segment *head;
+  wal_segment *tail;
+  uint64_t nextseq;
+  size_t roff;
+  uint64_t rrecs;
+  uint64_t drops;
+  uint64_t tickets;
+  uint64_t committed;
+  uint64_t failed;
+  bool syncing;
+  int posfd;
+  edgex_wal_stats stats;
+};
+
+/* FNV-1a, over the length and tag and then the data */
+
+static uint32_t wal_check (uint32_t len, uint32_t tag, const void *data)
+{
+  uint32_t words[2] = { len, tag };
+  const uint8_t *p = (const uint8_t *) words;
+  uint32_t h = 2166136261u;
+
+  for (size_t i = 0; i < sizeof (words); i++)
+  {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  p = (const uint8_t *) data;
+  for (size_t i = 0; i < len; i++)
+  {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void wal_path (const edgex_wal *w, uint64_t seq, char *path)
+{
+  snprintf (path, PATH_MAX, "%s/%020" PRIu64 WAL_EXT, w->dir, seq);
+}
+
+static wal_segment *wal_map (edgex_wal *w, uint64_t seq, bool create)
+{
+  char path[PATH_MAX];
+  struct stat st;
+  void *map = MAP_FAILED;
+
+  wal_path (w, seq, path);
+  int fd = open (path, create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0600);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  if (!create || posix_fallocate (fd, 0, w->segsize) == 0)
+  {
+    if (fstat (fd, &st) == 0 && st.st_size > WAL_HDR)
+    {
+      map = mmap
+        (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+  }
+  close (fd);
+  if (map == MAP_FAILED)
+  {
+    if (create)
+    {
+      unlink (path);
+    }
+    return NULL;
+  }
+  wal_segment *seg = calloc (1, sizeof (wal_segment));
+  seg->seq = seq;
+  seg->map = map;
+  seg->size = st.st_size;
+  return seg;
+}
+
+static void wal_unmap (wal_segment *seg)
+{
+  munmap (seg->map, seg->size);
+  free (seg);
+}
+
+/* Find the records in a segment found when opening the log */
+
+static void wal_scan (wal_segment *seg)
+{
+  size_t off = 0;
+  uint32_t hdr[3];
+
+  while (off + WAL_HDR <= seg->size)
+  {
+    memcpy (hdr, seg->map + off, WAL_HDR);
+    if
+    (
+      hdr[0] == 0 || hdr[0] > seg->size - off - WAL_HDR ||
+      wal_check (hdr[0], hdr[1], seg->map + off + WAL_HDR) != hdr[2]
+    )
+    {
+      break;
+    }
+    off += WAL_HDR + hdr[0];
+    seg->nrecs++;
+  }
+  seg->used = seg->synced = off;
+}
+
+static void wal_link (edgex_wal *w, wal_segment *seg)
+{
+  if (w->tail)
+  {
+    w->tail->next = seg;
+  }
+  else
+  {
+    w->head = seg;
+  }
+  w->tail = seg;
+  w->nsegs++;
+  w->stats.bytes += seg->size;
+  w->nextseq = seg->seq + 1;
+}
+
+/*
+ * Remove the head segment, whose records, from the read position on, are
+ * accounted for by the caller. Called with the lock held.
+ */
+
+static void wal_drop_head (edgex_wal *w)
+{
+  wal_segment *seg = w->head;
+  char path[PATH_MAX];
+
+  w->head = seg->next;
+  if (w->tail == seg)
+  {
+    w->tail = NULL;
+  }
+  w->nsegs--;
+  w->stats.bytes -= seg->size;
+  w->roff = 0;
+  w->rrecs = 0;
+  w->drops++;
+  wal_path (w, seg->seq, path);
+  unlink (path);
+  if (seg->refs)
+  {
+    seg->dropped = true;
+  }
+  else
+  {
+    wal_unmap (seg);
+  }
+}
+
+/* Remove the head segment to make space, losing its unconsumed records */
+
+static void wal_evict (edgex_wal *w)
+{
+  uint64_t lost = w->head->nrecs - w->rrecs;
+  w->stats.records -= lost;
+  w->stats.evicted += lost;
+  wal_drop_head (w);
+}
+
+static bool wal_rotate (edgex_wal *w)
+{
+  while (w->nsegs >= w->maxsegs)
+  {
+    wal_evict (w);
+  }
+  wal_segment *seg = wal_map (w, w->nextseq, true);
+  if (seg)
+  {
+    wal_link (w, seg);
+  }
+  return seg != NULL;
+}
+
+/* Wait until the append with the given ticket is synced. Called locked */
+
+static void wal_commit (edgex_wal *w, uint64_t ticket)
+{
+  while (w->committed < ticket)
+  {
+    if (w->syncing)
+    {
+      pthread_cond_wait (&w->cond, &w->lock);
+      continue;
+    }
+
+    /* Lead a sync of everything appended so far */
+
+    w->syncing = true;
+    uint64_t upto = w->tickets;
+    wal_range *ranges = malloc (w->nsegs * sizeof (wal_range));
+    unsigned n = 0;
+    for (wal_segment *seg = w->head; seg; seg = seg->next)
+    {
+      if (seg->synced < seg->used)
+      {
+        ranges[n].seg = seg;
+        ranges[n].from = seg->synced;
+        ranges[n].to = seg->used;
+        seg->refs++;
+        n++;
+      }
+    }
+    pthread_mutex_unlock (&w->lock);
+
+    bool ok = true;
+    for (unsigned i = 0; i < n; i++)
+    {
+      size_t start = ranges[i].from & ~(w->pagesize - 1);
+      ok = msync
+        (ranges[i].seg->map + start, ranges[i].to - start, MS_SYNC) == 0 && ok;
+    }
+
+    pthread_mutex_lock (&w->lock);
+    for (unsigned i = 0; i < n; i++)
+    {
+      wal_segment *seg = ranges[i].seg;
+      if (seg->synced < ranges[i].to)
+      {
+        seg->synced = ranges[i].to;
+      }
+      if (--seg->refs == 0 && seg->dropped)
+      {
+        wal_unmap (seg);
+      }
+    }
+    free (ranges);
+    w->stats.syncs++;
+    if (!ok)
+    {
+      w->failed = upto;
+    }
+    w->committed = upto;
+    w->syncing = false;
+    pthread_cond_broadcast (&w->cond);
+  }
+}
+
+static int wal_cmp (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+/* Skip the records consumed before the log was last closed */
+
+static void wal_restore_position (edgex_wal *w)
+{
+  uint64_t pos[2];
+  uint32_t len;
+
+  if (pread (w->posfd, pos, sizeof (pos), 0) != sizeof (pos))
+  {
+    return;
+  }
+  while (w->head && w->head->seq < pos[0])
+  {
+    w->stats.records -= w->head->nrecs;
+    wal_drop_head (w);
+  }
+  if (w->head && w->head->seq == pos[0])
+  {
+    wal_segment *seg = w->head;
+    while (w->roff < pos[1] && w->roff < seg->used)
+    {
+      memcpy (&len, seg->map + w->roff, sizeof (len));
+      w->roff += WAL_HDR + len;
+      w->rrecs++;
+    }
+    w->stats.records -= w->rrecs;
+  }
+}
+
+static void wal_save_position (edgex_wal *w)
+{
+  if (w->head)
+  {
+    uint64_t pos[2] = { w->head->seq, w->roff };
+    if (pwrite (w->posfd, pos, sizeof (pos), 0) != sizeof (pos))
+    {
+      /* Records consumed since the last save may be replayed again */
+    }
+  }
+}
+
+edgex_wal *edgex_wal_open (const char *dir, size_t segsize, uint64_t limit)
+{
+  char path[PATH_MAX];
+  struct dirent *ent;
+  char *end;
+  uint64_t *seqs = NULL;
+  size_t nseqs = 0;
+  size_t maxseqs = 0;
+
+  if (segsize <= WAL_HDR || (mkdir (dir, 0700) != 0 && errno != EEXIST))
+  {
+    return NULL;
+  }
+  DIR *d = opendir (dir);
+  if (d == NULL)
+  {
+    return NULL;
+  }
+  while ((ent = readdir (d)))
+  {
+    uint64_t seq = strtoull (ent->d_name, &end, 10);
+    if (end != ent->d_name && strcmp (end, WAL_EXT) == 0)
+    {
+      if (nseqs == maxseqs)
+      {
+        maxseqs = maxseqs ? maxseqs * 2 : 16;
+        seqs = realloc (seqs, maxseqs * sizeof (uint64_t));
+      }
+      seqs[nseqs++] = seq;
+    }
+  }
+  closedir (d);
+  qsort (seqs, nseqs, sizeof (uint64_t), wal_cmp);
+
+  edgex_wal *w = calloc (1, sizeof (edgex_wal));
+  pthread_mutex_init (&w->lock, NULL);
+  pthread_cond_init (&w->cond, NULL);
+  w->dir = strdup (dir);
+  w->segsize = segsize;
+  w->pagesize = sysconf (_SC_PAGESIZE);
+  w->maxsegs = (limit / segsize > 2) ? limit / segsize : 2;
+
+  for (size_t i = 0; i < nseqs; i++)
+  {
+    wal_segment *seg = wal_map (w, seqs[i], false);
+    if (seg)
+    {
+      wal_scan (seg);
+      wal_link (w, seg);
+      w->stats.records += seg->nrecs;
+    }
+  }
+  free (seqs);
+
+  snprintf (path, sizeof (path), "%s/" WAL_POSITION, dir);
+  w->posfd = open (path, O_RDWR | O_CREAT, 0600);
+  if (w->posfd < 0)
+  {
+    edgex_wal_close (w);
+    return NULL;
+  }
+  wal_restore_position (w);
+
+  /* Clear what may be left of a record torn by a crash */
+
+  wal_segment *tail = w->tail;
+  if (tail && tail->used < tail->size)
+  {
+    size_t n = tail->size - tail->used;
+    const char *p = tail->map + tail->used;
+    if (memcmp (p, "\0\0\0\0", n < 4 ? n : 4) != 0)
+    {
+      memset (tail->map + tail->used, 0, n);
+      msync (tail->map, tail->size, MS_SYNC);
+    }
+  }
+  while (w->nsegs > w->maxsegs)
+  {
+    wal_evict (w);
+  }
+  return w;
+}
+
+bool edgex_wal_append
+  (edgex_wal *w, uint32_t tag, const void *data, size_t len)
+{
+  uint32_t hdr[3];
+
+  if (len == 0 || len > w->segsize - WAL_HDR)
+  {
+    return false;
+  }
+  hdr[0] = len;
+  hdr[1] = tag;
+  hdr[2] = wal_check (len, tag, data);
+
+  pthread_mutex_lock (&w->lock);
+  if
+  (
+    (w->tail == NULL || w->tail->size - w->tail->used < WAL_HDR + len) &&
+    !wal_rotate (w)
+  )
+  {
+    pthread_mutex_unlock (&w->lock);
+    return false;
+  }
+  wal_segment *seg = w->tail;
+  memcpy (seg->map + seg->used + WAL_HDR, data, len);
+  memcpy (seg->map + seg->used, hdr, WAL_HDR);
+  seg->used += WAL_HDR + len;
+  seg->nrecs++;
+  w->stats.records++;
+  w->stats.appended++;
+  uint64_t ticket = ++w->tickets;
+  wal_commit (w, ticket);
+  bool ok = (ticket > w->failed);
+  pthread_mutex_unlock (&w->lock);
+  return ok;
+}
+
+unsigned edgex_wal_replay
+  (edgex_wal *w, unsigned max, edgex_wal_fn fn, void *arg)
+{
+  unsigned n = 0;
+  char *buf = NULL;
+  size_t bufsize = 0;
+  uint32_t hdr[3];
+
+  pthread_mutex_lock (&w->lock);
+  while (n < max && w->head)
+  {
+    wal_segment *seg = w->head;
+    if (w->roff + WAL_HDR > seg->used)
+    {
+      /* All of the head segment has been consumed */
+
+      if (seg == w->tail)
+      {
+        break;
+      }
+      wal_drop_head (w);
+      continue;
+    }
+    memcpy (hdr, seg->map + w->roff, WAL_HDR);
+    if (hdr[0] > bufsize)
+    {
+      bufsize = hdr[0];
+      buf = realloc (buf, bufsize);
+    }
+    memcpy (buf, seg->map + w->roff + WAL_HDR, hdr[0]);
+    uint64_t drops = w->drops;
+    pthread_mutex_unlock (&w->lock);
+
+    bool ok = fn (arg, hdr[1], buf, hdr[0]);
+
+    pthread_mutex_lock (&w->lock);
+    if (!ok)
+    {
+      break;
+    }
+    n++;
+
+    /* Unless its segment was evicted meanwhile, consume the record */
+
+    if (drops == w->drops)
+    {
+      w->roff += WAL_HDR + hdr[0];
+      w->rrecs++;
+      w->stats.records--;
+    }
+  }
+  if (n)
+  {
+    wal_save_position (w);
+  }
+  pthread_mutex_unlock (&w->lock);
+  free (buf);
+  return n;
+}
+
+void edgex_wal_getstats (edgex_wal *w, edgex_wal_stats *stats)
+{
+  pthread_mutex_lock (&w->lock);
+  *stats = w->stats;
+  pthread_mutex_unlock (&w->lock);
+}
+
+void edgex_wal_close (edgex_wal *w)
+{
+  if (w)
+  {
+    pthread_mutex_lock (&w->lock);
+    wal_commit (w, w->tickets);
+    pthread_mutex_unlock (&w->lock);
+    while (w->head)
+    {
+      wal_segment *seg = w->head;
+      w->head = seg->next;
+      wal_unmap (seg);
+    }
+    if (w->posfd >= 0)
+    {
+      close (w->posfd);
+    }
+    pthread_cond_destroy (&w->cond);
+    pthread_mutex_destroy (&w->lock);
+    free (w->dir);
+    free (w);
+  }
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_DEVICE_WAL_H_
+#define _EDGEX_DEVICE_WAL_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * An append-only log of records on disk, kept in a directory as a series of
+ * fixed-size segments which are mapped into memory. Each record has a tag
+ * and a checksum, so that a record torn by a crash is discarded when the log
+ * is reopened. Records are consumed oldest first, and a segment is removed
+ * once all of its records have been consumed. The position reached is saved
+ * in the directory, without syncing: after a crash, the last records
+ * consumed may be seen again.
+ */
+
+typedef struct edgex_wal edgex_wal;
+
+/*
+ * Open the log in a directory, which is created if need be, recovering any
+ * records left there. New segments are segsize bytes. Once the segments
+ * would take more than limit bytes, the oldest segment is removed, with any
+ * records in it not yet consumed. Returns NULL if the log cannot be opened.
+ */
+
+extern edgex_wal *edgex_wal_open
+  (const char *dir, size_t segsize, uint64_t limit);
+
+/*
+ * Append a record, returning once it is on disk. Appends made while a sync
+ * is in progress are synced together by the next one (group commit).
+ * Returns false if the record is too big for a segment, or could not be
+ * written.
+ */
+
+extern bool edgex_wal_append
+  (edgex_wal *w, uint32_t tag, const void *data, size_t len);
+
+/*
+ * Called for each record replayed. Returns true if the record has been
+ * dealt with, and may be consumed.
+ */
+
+typedef bool (*edgex_wal_fn)
+  (void *arg, uint32_t tag, const void *data, size_t len);
+
+/*
+ * Pass up to max of the oldest records to fn in turn, stopping at the first
+ * for which it returns false. The records it accepts are consumed. The log
+ * is not locked while fn runs. Returns the number of records consumed.
+ */
+
+extern unsigned edgex_wal_replay
+  (edgex_wal *w, unsigned max, edgex_wal_fn fn, void *arg);
+
+typedef struct edgex_wal_stats
+{
+  uint64_t records;     // Records held and not yet consumed
+  uint64_t bytes;       // Disk space taken by the segments
+  uint64_t appended;    // Records appended since the log was opened
+  uint64_t syncs;       // Syncs made for appends
+  uint64_t evicted;     // Records removed unconsumed, to bound the space
+} edgex_wal_stats;
+
+extern void edgex_wal_getstats (edgex_wal *w, edgex_wal_stats *stats);
+
+/* Sync and close the log */
+
+extern void edgex_wal_close (edgex_wal *w);
+
+#endif